@@ -30,7 +30,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <benchmark.h>
+#include <benchmark_pattern.h>
 #include <conf_board.h>
+#include <sleepmgr.h>
 #include <string.h>
 
 #define HAS_CRITICAL_SECTION()  irqflags_t flags
@@ -40,61 +42,99 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define EP_TX_INDEX (0)
 #define EP_RX_INDEX (1)
 
-/** BMARK MACROS ****************************************************/
-#define mSetWritePacketID(BufferPtr, BufferSize, FillCount, NextPacketKey)	\
-	if ((BufferSize)>0)														\
-	{																		\
-		if (FillCount < ((BM_BANK_COUNT*2)*(BM_MAX_TRANSFER_SIZE/BM_EP_MAX_PACKET_SIZE)))	\
-		{																	\
-			FillCount++;													\
-			Bm_FillBuffer(BufferPtr,BufferSize);							\
-		}																	\
-		BufferPtr[1]=NextPacketKey++;										\
-	}
+#if (BM_RING_SIZE < 2) || (BM_RING_SIZE > 128) || (BM_RING_SIZE & (BM_RING_SIZE-1))
+#error "BM_RING_SIZE must be a power of 2 between 2 and 128."
+#endif
 
+/** BMARK MACROS ****************************************************/
 #define Bm_SubmitTransfer(ep,shortPacketEn,buffer,bufferLength,callbackFn) udd_ep_run(ep,shortPacketEn,buffer,bufferLength,callbackFn)
-#define Bm_SubmitRead(ep,xferEL,callbackFn) Bm_SubmitTransfer(ep,false,(xferEL)->Buffer,BM_MAX_TRANSFER_SIZE,callbackFn)
-#define Bm_SubmitWrite(ep,xferEL,callbackFn) Bm_SubmitTransfer(ep,false,(xferEL)->Buffer,(xferEL)->Transferred,callbackFn)
-
-#define Bm_XferMove(fromList, toList,  moveEL) do {		\
-	DL_DELETE(fromList, moveEL);						\
-	DL_APPEND(toList, moveEL);							\
- } while(0)
+#define Bm_SubmitRead(ep,xferEP,length,callbackFn) Bm_SubmitTransfer(ep,false,Bm_RingBuffer(xferEP),length,callbackFn)
+#define Bm_SubmitWrite(ep,xferEP,callbackFn) Bm_SubmitTransfer(ep,false,Bm_RingBuffer(xferEP),Bm_RingTransferred(xferEP),callbackFn)
 
 #define Bm_IsNewTest() (Bm_TestType != Bm_PrevTestType)
 
-typedef struct _BM_XFER_BUFFER
-{
-	COMPILER_WORD_ALIGNED uint8_t Buffer[BM_BUFFER_SIZE];
-	uint16_t Transferred;
-	
-}BM_XFER_BUFFER;
-
-typedef struct _BM_XFER_QUEUE_EL
-{
-	BM_XFER_BUFFER* Buffer;
-	struct _BM_XFER_QUEUE_EL* next;
-	struct _BM_XFER_QUEUE_EL* prev;
-}BM_XFER_QUEUE_EL;
+//! Counts a transfer completed without error. (GET_STATS)
+#define Bm_CountTransfer(dir,nb_transfered) { bm.Stats.Transfers[dir]++; bm.Stats.Bytes[dir]+=(nb_transfered); }
+//! Counts a completion that left the endpoint without a job; the host is NAKed until it is restarted.
+#define Bm_CountStarved(dir,xferEP) if (!(xferEP).Busy) bm.Stats.Starved[dir]++
+
+//! Ring buffer at the endpoint's cursor and the length received into it.
+#define Bm_RingBuffer(xferEP) (bm.Buffers[(xferEP).Index & (BM_RING_SIZE-1)])
+#define Bm_RingTransferred(xferEP) (bm.Transferred[(xferEP).Index & (BM_RING_SIZE-1)])
+//! Loop test; buffers received and not yet sent back.
+#define Bm_RingFilled() ((uint8_t)(bm.Rx.Index - bm.Tx.Index))
+
+// Pacing replaces the SOF period; the credit decides when to submit.
+#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_RX)
+	#define Bm_RxNeedsService() (Bm_Pacing.Rate || bm.Rx.NeedsService)
+#else
+	#define Bm_RxNeedsService() (true)
+#endif
+#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_TX)
+	#define Bm_TxNeedsService() (Bm_Pacing.Rate || bm.Tx.NeedsService)
+#else
+	#define Bm_TxNeedsService() (true)
+#endif
 
 typedef struct _BM_XFER_EP
 {
-	BM_XFER_QUEUE_EL* Queued;
+	//! Ring cursor; counts completed transfers and wraps. (see BM_TEST_CONTEXT)
+	volatile uint8_t Index;
 	volatile bool Busy;
 	uint8_t SofPeriod;
-	uint8_t NeedsService;
+	volatile uint8_t NeedsService;
+	//! Paced tests; bytes the endpoint may still start. (see BM_PACING)
+	volatile uint32_t Credit;
 	
 	udd_callback_trans_t OnXferComplete;
 } BM_XFER_EP;
 
+/*
+* Paced streaming (PICFW_SET_PACING) is a token bucket per endpoint. Rate is
+* split into whole bytes per (micro)frame and a remainder; the remainder is
+* carried from tick to tick so the credit adds up to exactly Rate bytes a
+* second with integer math. The SOF and MSOF interrupts add the credit, the
+* submit functions take it in whole packets. An endpoint that is busy or
+* waiting for the host saves at most Limit bytes, one tick and one packet,
+* so the device never catches up with a burst.
+*/
+typedef struct _BM_PACING
+{
+	uint32_t Rate;				//!< Target bytes per second; 0 when unpaced.
+	uint32_t TickBytes;
+	uint16_t TickRemainder;
+	uint16_t TicksPerSecond;	//!< 8000 microframes at high-speed, 1000 frames at full-speed.
+	uint16_t Remainder;
+	uint32_t Limit;
+} BM_PACING;
+
+/*
+* The transfer buffers are a ring of BM_RING_SIZE DMA buffers.
+* Rx.Index and Tx.Index are the producer and consumer cursors. In loop mode
+* buffer Rx.Index is the next to receive into and buffer Tx.Index the next
+* to send back, so Rx of one buffer overlaps Tx of the one before it. The
+* read and write tests only use their own cursor.
+*
+* Each endpoint has at most one job. The completion callbacks advance the
+* cursors and resubmit from the ISR; the main loop only starts an idle
+* endpoint with interrupts masked. No buffer is ever moved.
+*
+* The buffers are one contiguous block; the control test (TEST_CONTROL)
+* uses the whole ring as the data stage buffer of its requests.
+*/
 typedef struct _BM_TEST_CONTEXT
 {
-	BM_XFER_BUFFER Buffers[BM_BANK_COUNT*BM_EP_COUNT];
-	BM_XFER_QUEUE_EL BufferElements[BM_BANK_COUNT*BM_EP_COUNT];
+	COMPILER_WORD_ALIGNED uint8_t Buffers[BM_RING_SIZE][BM_BUFFER_SIZE];
+	uint16_t Transferred[BM_RING_SIZE];
 
 	BM_XFER_EP Rx;
 	BM_XFER_EP Tx;
 
+	//! Device counters; cleared by PICFW_SET_TEST, updated from the ISR.
+	BM_STATS Stats;
+	uint16_t LastFrameNumber;
+	bool LastFrameNumberValid;
+
 } BM_TEST_CONTEXT;
 
 volatile Bm_RunTestDelegate Bm_SofEvent = NULL;
@@ -104,258 +144,296 @@ static BM_TEST_CONTEXT bm;
 
 static volatile uint8_t Bm_TestType = TEST_LOOP;
 static volatile uint8_t Bm_PrevTestType = TEST_NONE;
-static volatile uint8_t Bm_FillCount = 0;
 static volatile uint8_t Bm_NextPacketKey = 0;
 static volatile uint8_t Bm_Led_Counter = 0;
 
+static BM_PACING Bm_Pacing;
+
 COMPILER_WORD_ALIGNED static uint8_t Bm_VendorBuffer[8];
+COMPILER_WORD_ALIGNED static uint8_t Bm_PacingBuffer[BM_PACING_LENGTH];
+
+//! Control test; data stage length of the request being served.
+static uint16_t Bm_ControlLength;
 
 void RunApplication(void);
+void Bm_Task(void);
 
 static void Bm_Init(void);
+static void Bm_ResetStats(void);
+static void Bm_StampLatency(uint8_t* Buffer, iram_size_t Length);
+static bool Bm_Control_OverUnderRun(void);
+static void Bm_Control_Complete(void);
+
+static void Bm_Pacing_Init(void);
+static void Bm_Pacing_Tick(void);
+static void Bm_Pacing_Set(void);
+static uint16_t Bm_Pacing_Take(BM_XFER_EP* XferEP);
 
 static void Bm_XferLoopCompleteTx(udd_ep_status_t status, iram_size_t nb_transfered);
 static void Bm_XferLoopCompleteRx(udd_ep_status_t status, iram_size_t nb_transfered);
 static void Bm_XferCompleteTx(udd_ep_status_t status, iram_size_t nb_transfered);
 static void Bm_XferCompleteRx(udd_ep_status_t status, iram_size_t nb_transfered);
 
+static void Bm_Loop_SubmitRx(void);
+static void Bm_Loop_SubmitTx(void);
+static void Bm_Read_SubmitTx(void);
+static void Bm_Write_SubmitRx(void);
+
 static void Bm_RunTest_Loop(void);
 static void Bm_RunTest_Read(void);
 static void Bm_RunTest_Write(void);
 
-static void Bm_FillBuffer(uint8_t* pBuffer, uint16_t size);
-static void Bm_InitXferBuffers(BM_XFER_QUEUE_EL** Bank1_AddListRef, BM_XFER_QUEUE_EL** Bank2_AddListRef);
-static void Bm_InitWritePackets(BM_XFER_QUEUE_EL* QueueEL);
+static void Bm_InitXferBuffers(void);
+static void Bm_InitWritePackets(uint8_t* Buffer, uint16_t Length);
 
 #if defined(BM_MANAGE_SOF_PERIOD_RX) || defined(BM_MANAGE_SOF_PERIOD_TX)
 static void Bm_Sof_Handler_HS(void);
 static void Bm_Sof_Handler_FS(void);
 #endif
 
-static void Bm_FillBuffer(uint8_t* pBuffer, uint16_t size)
+// Ring buffers are filled with the test pattern when the test starts; only
+// the packet keys are stamped before each transfer.
+static void Bm_InitWritePackets(uint8_t* Buffer, uint16_t Length)
 {
-	uint8_t dataByte = 0;
-	uint16_t counter;
-
-	for (counter = 0; counter < size; counter++)
+	int i;
+	for(i=0; i < Length; i+=BM_EP_MAX_PACKET_SIZE)
 	{
-		pBuffer[counter] = dataByte++;
-		if (dataByte == 0) dataByte++;
+		Bm_PatternStampKey(&Buffer[i], Bm_NextPacketKey++);
 	}
 }
 
-static void Bm_InitWritePackets(BM_XFER_QUEUE_EL* QueueEL)
+// The Bm_xxx_SubmitXx functions are called from the completion callbacks or
+// with interrupts masked. They queue the buffer at the endpoint's cursor if
+// the endpoint is idle and the ring allows it.
+static void Bm_Loop_SubmitRx(void)
 {
-	int i;
-	for(i=0; i < BM_MAX_TRANSFER_SIZE; i+=BM_EP_MAX_PACKET_SIZE)
-	{
-		mSetWritePacketID((&QueueEL->Buffer->Buffer[i]), BM_EP_MAX_PACKET_SIZE, Bm_FillCount, Bm_NextPacketKey);
-	}
+	uint16_t length;
+
+	if (bm.Rx.Busy || Bm_IsNewTest() || !Bm_RxNeedsService())
+		return;
+
+	// The buffer Tx.Index+BM_RING_SIZE is still being sent back.
+	if (Bm_RingFilled() >= BM_RING_SIZE)
+		return;
+
+	if ((length = Bm_Pacing_Take(&bm.Rx)) == 0)
+		return;
+
+	bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx, length, Bm_XferLoopCompleteRx);
+	bm.Rx.NeedsService=0;
 }
 
-static void Bm_XferLoopCompleteTx(udd_ep_status_t status, iram_size_t nb_transfered)
+static void Bm_Loop_SubmitTx(void)
+{
+	if (bm.Tx.Busy || Bm_IsNewTest() || !Bm_TxNeedsService())
+		return;
+
+	if (!Bm_RingFilled())
+		return;
+
+	bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx, Bm_XferLoopCompleteTx);
+	bm.Tx.NeedsService=0;
+}
+
+static void Bm_Read_SubmitTx(void)
+{
+	uint16_t length;
+
+	if (bm.Tx.Busy || Bm_IsNewTest() || !Bm_TxNeedsService())
+		return;
+
+	if ((length = Bm_Pacing_Take(&bm.Tx)) == 0)
+		return;
+
+	Bm_InitWritePackets(Bm_RingBuffer(bm.Tx), length);
+	Bm_RingTransferred(bm.Tx) = length;
+	bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx, Bm_XferCompleteTx);
+	bm.Tx.NeedsService=0;
+}
+
+static void Bm_Write_SubmitRx(void)
 {
-	BM_XFER_QUEUE_EL* moveEL = bm.Tx.Queued;
+	uint16_t length;
+
+	if (bm.Rx.Busy || Bm_IsNewTest() || !Bm_RxNeedsService())
+		return;
+
+	if ((length = Bm_Pacing_Take(&bm.Rx)) == 0)
+		return;
+
+	bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx, length, Bm_XferCompleteRx);
+	bm.Rx.NeedsService=0;
+}
 
+static void Bm_XferLoopCompleteTx(udd_ep_status_t status, iram_size_t nb_transfered)
+{
 	if (++Bm_Led_Counter==0)
 		LED1_TGL();
 
+	bm.Tx.Busy = false;
 	if (status)
-	{
-		
-		bm.Tx.Busy = false;
 		return;
-	}
 
-	// moveEL->Queued->Buffer->Transferred=nb_transfered;
-	Bm_XferMove(bm.Tx.Queued, bm.Rx.Queued, moveEL);
-	
-	bm.Tx.Busy = false;
+	Bm_CountTransfer(BM_STATS_IN, nb_transfered);
+
+	// Frees the buffer for Rx.
+	bm.Tx.Index++;
+
+	Bm_Loop_SubmitTx();
+	Bm_Loop_SubmitRx();
+	Bm_CountStarved(BM_STATS_IN, bm.Tx);
 }
 
 static void Bm_XferLoopCompleteRx(udd_ep_status_t status, iram_size_t nb_transfered)
 {
-	BM_XFER_QUEUE_EL* moveEL = bm.Rx.Queued;
-	
 	if (++Bm_Led_Counter==0)
 		LED1_TGL();
 
+	bm.Rx.Busy = false;
 	if (status)
-	{
-		bm.Rx.Busy = false;
 		return;
-	}
 
-	moveEL->Buffer->Transferred=nb_transfered;
-	Bm_XferMove(bm.Rx.Queued, bm.Tx.Queued, moveEL);
-	
-	bm.Rx.Busy = false;
+	Bm_CountTransfer(BM_STATS_OUT, nb_transfered);
+
+	if (Bm_TestType == TEST_LATENCY)
+		Bm_StampLatency(Bm_RingBuffer(bm.Rx), nb_transfered);
+
+	Bm_RingTransferred(bm.Rx)=nb_transfered;
+	bm.Rx.Index++;
+
+	Bm_Loop_SubmitRx();
+	Bm_Loop_SubmitTx();
+	Bm_CountStarved(BM_STATS_OUT, bm.Rx);
 }
 
 static void Bm_XferCompleteRx(udd_ep_status_t status, iram_size_t nb_transfered)
 {
-	BM_XFER_QUEUE_EL* moveEL = bm.Rx.Queued;
-
 	if (++Bm_Led_Counter==0)
 		LED1_TGL();
 
+	bm.Rx.Busy = false;
 	if (status)
-	{
-		bm.Rx.Busy = false;
 		return;
-	}
 
-	bm.Rx.Queued->Buffer->Transferred=nb_transfered;
-	Bm_XferMove(bm.Rx.Queued, bm.Rx.Queued, moveEL);
-	
-	bm.Rx.Busy = false;
+	Bm_CountTransfer(BM_STATS_OUT, nb_transfered);
+
+	Bm_RingTransferred(bm.Rx)=nb_transfered;
+	bm.Rx.Index++;
+
+	Bm_Write_SubmitRx();
+	Bm_CountStarved(BM_STATS_OUT, bm.Rx);
 }
 
 static void Bm_XferCompleteTx(udd_ep_status_t status, iram_size_t nb_transfered)
 {
-	BM_XFER_QUEUE_EL* moveEL = bm.Tx.Queued;
-
 	if (++Bm_Led_Counter==0)
 		LED1_TGL();
 
+	bm.Tx.Busy = false;
 	if (status)
-	{
-		bm.Tx.Busy = false;
 		return;
-	}
 
-	bm.Tx.Queued->Buffer->Transferred=nb_transfered;
-	Bm_XferMove(bm.Tx.Queued, bm.Tx.Queued, moveEL);
-	
-	bm.Tx.Busy = false;
+	Bm_CountTransfer(BM_STATS_IN, nb_transfered);
+
+	bm.Tx.Index++;
+
+	Bm_Read_SubmitTx();
+	Bm_CountStarved(BM_STATS_IN, bm.Tx);
 }
 
 static void Bm_RunTest_Loop(void)
 {
-	if (!bm.Rx.Busy && bm.Rx.Queued)
-	{
-		#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_RX)
-		if (bm.Rx.NeedsService)
-		{
-			bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx.Queued->Buffer, Bm_XferLoopCompleteRx);
-			bm.Rx.NeedsService=0;
-		}
-		#else
-			bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx.Queued->Buffer, Bm_XferLoopCompleteRx);
-		#endif
-	}
-	if (!bm.Tx.Busy &&  bm.Tx.Queued)
-	{
-		#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_TX)
-		if (bm.Tx.NeedsService)
-		{
-			bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx.Queued->Buffer, Bm_XferLoopCompleteTx);
-			bm.Tx.NeedsService=0;
-		}
-		#else
-			bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx.Queued->Buffer, Bm_XferLoopCompleteTx);
-		#endif
-	}
+	HAS_CRITICAL_SECTION();
+
+	ENTER_CRITICAL_SECTION();
+	Bm_Loop_SubmitRx();
+	Bm_Loop_SubmitTx();
+	LEAVE_CRITICAL_SECTION();
 }
 
 static void Bm_RunTest_Read(void)
 {
-	if (!bm.Rx.Busy && bm.Rx.Queued)
-	{
-		#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_RX)
-		if (bm.Rx.NeedsService)
-		{
-			bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx.Queued->Buffer, Bm_XferCompleteRx);
-			bm.Rx.NeedsService=0;
-		}
-		#else
-			bm.Rx.Busy = Bm_SubmitRead(BM_EP_RX, bm.Rx.Queued->Buffer, Bm_XferCompleteRx);
-		#endif
-	}
+	HAS_CRITICAL_SECTION();
+
+	ENTER_CRITICAL_SECTION();
+	Bm_Read_SubmitTx();
+	LEAVE_CRITICAL_SECTION();
 }
 
 static void Bm_RunTest_Write(void)
 {
-	if (!bm.Tx.Busy && bm.Tx.Queued)
-	{
-		#if (BM_EP_TYPE==EP_TYPE_ISO) && defined(BM_MANAGE_SOF_PERIOD_TX)
-		if (bm.Tx.NeedsService)
-		{
-			Bm_InitWritePackets(bm.Tx.Queued);
-			bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx.Queued->Buffer, Bm_XferCompleteTx);
-			bm.Tx.NeedsService=0;
-		}
-		#else
-			Bm_InitWritePackets(bm.Tx.Queued);
-			bm.Tx.Busy = Bm_SubmitWrite(BM_EP_TX, bm.Tx.Queued->Buffer, Bm_XferCompleteTx);
-		#endif
-	}
+	HAS_CRITICAL_SECTION();
+
+	ENTER_CRITICAL_SECTION();
+	Bm_Write_SubmitRx();
+	LEAVE_CRITICAL_SECTION();
 }
 
 void RunApplication(void)
 {
-	HAS_CRITICAL_SECTION();
-	
+	Bm_ResetStats();
 	Bm_Init();
 
 	while(true)
 	{
-		if (Bm_IsNewTest())
+		Bm_Task();
+	}
+}
+
+//! One main loop iteration. (also stepped by the host simulation, see Sim/udd_sim.h)
+void Bm_Task(void)
+{
+	HAS_CRITICAL_SECTION();
+
+	if (Bm_IsNewTest())
+	{
+		if (bm.Rx.Busy)
 		{
-			if (bm.Rx.Busy)
-			{
-				udd_ep_abort(BM_EP_RX);
-				continue;
-			}
-			else if (bm.Tx.Busy)
-			{
-				udd_ep_abort(BM_EP_TX);
-				continue;
-			}
-			else
-			{
-				ENTER_CRITICAL_SECTION();
-				
-				Bm_Init();
-				
-				LEAVE_CRITICAL_SECTION();
-				continue;
-			}
+			udd_ep_abort(BM_EP_RX);
 		}
+		else if (bm.Tx.Busy)
+		{
+			udd_ep_abort(BM_EP_TX);
+		}
+		else
+		{
+			ENTER_CRITICAL_SECTION();
+			
+			Bm_Init();
+			
+			LEAVE_CRITICAL_SECTION();
+		}
+		return;
+	}
 
+	if (Bm_Pacing.Rate)
+	{
+		// Paced; after this pass only an interrupt (SOF credit or a
+		// completion) can give the test more to do. Interrupts stay masked
+		// until the sleep instruction so none is missed in between.
+		cpu_irq_disable();
 		if (Bm_RunTest) Bm_RunTest();
-	
+		sleepmgr_enter_sleep();
+		return;
 	}
+
+	if (Bm_RunTest) Bm_RunTest();
 }
 
-static void Bm_InitXferBuffers(BM_XFER_QUEUE_EL** Bank1_AddListRef, BM_XFER_QUEUE_EL** Bank2_AddListRef)
+static void Bm_InitXferBuffers(void)
 {
-	int i,j;
+	int i, j;
 
-	for(i = 0; i < (BM_BANK_COUNT); i++)
+	for(i = 0; i < (BM_RING_SIZE); i++)
 	{
-		for(j = 0; j < (BM_EP_COUNT); j++)
-		{
-			bm.Buffers[i*j].Transferred=BM_MAX_TRANSFER_SIZE;
-			bm.BufferElements[i*j].Buffer=&bm.Buffers[i*j];
-			bm.BufferElements[i*j].next=NULL;
-			bm.BufferElements[i*j].prev=NULL;
-			Bm_InitWritePackets(&bm.BufferElements[i*j]);
-			if (j & (BM_EP_COUNT-1))
-			{
-				DL_APPEND(*Bank2_AddListRef, &bm.BufferElements[i*j]);
-			}
-			else
-			{
-				DL_APPEND(*Bank1_AddListRef, &bm.BufferElements[i*j]);
-			}
-		}
+		bm.Transferred[i]=BM_MAX_TRANSFER_SIZE;
+		for(j = 0; j < BM_MAX_TRANSFER_SIZE; j+=BM_EP_MAX_PACKET_SIZE)
+			Bm_PatternFill(&bm.Buffers[i][j], BM_EP_MAX_PACKET_SIZE);
 	}	
 }
 
 static void Bm_Init(void)
 {
-	Bm_FillCount = 0;
 	Bm_Led_Counter = 0;
 	LED1_OFF();
 	
@@ -374,23 +452,28 @@ static void Bm_Init(void)
 	#endif
 #endif
 	
+	Bm_InitXferBuffers();
+	Bm_Pacing_Init();
 	
 	switch (Bm_TestType)
 	{
 	case TEST_NONE:
-		Bm_InitXferBuffers(&bm.Rx.Queued, &bm.Rx.Queued);
 		Bm_RunTest = NULL;
 		break;
 	case TEST_PCREAD:
-		Bm_InitXferBuffers(&bm.Tx.Queued, &bm.Tx.Queued);
-		Bm_RunTest = Bm_RunTest_Write;
+		Bm_RunTest = Bm_RunTest_Read;
 		break;
 	case TEST_PCWRITE:
-		Bm_InitXferBuffers(&bm.Rx.Queued, &bm.Rx.Queued);
-		Bm_RunTest = Bm_RunTest_Read;
+		Bm_RunTest = Bm_RunTest_Write;
+		break;
+	case TEST_LATENCY:
+		Bm_RunTest = Bm_RunTest_Loop;
+		break;
+	case TEST_CONTROL:
+		// The endpoints stay idle; the ring is served from Bm_Vendor_Handler.
+		Bm_RunTest = NULL;
 		break;
 	default:
-		Bm_InitXferBuffers(&bm.Rx.Queued, &bm.Rx.Queued);
 		Bm_TestType = TEST_LOOP;
 		Bm_RunTest = Bm_RunTest_Loop;
 		break;
@@ -401,6 +484,132 @@ static void Bm_Init(void)
 	Bm_PrevTestType = Bm_TestType;
 }
 
+static void Bm_ResetStats(void)
+{
+	memset(&bm.Stats,0,sizeof(bm.Stats));
+	bm.Stats.Length = sizeof(bm.Stats);
+	bm.Stats.Version = BM_STATS_VERSION;
+	bm.Stats.Flags = BM_STATS_FLAG_SOFS;
+}
+
+// Latency test; stamps every packet of a received transfer with the frame
+// (and at high-speed the microframe) the transfer completed in.
+static void Bm_StampLatency(uint8_t* Buffer, iram_size_t Length)
+{
+	uint16_t frame;
+	iram_size_t i;
+
+	if (udd_is_high_speed())
+	{
+		// FNUM:MFNUM, as laid out in UDFNUM.
+		frame = udd_get_micro_frame_number();
+		frame = ((frame >> 3) & BM_LATENCY_FRAME_MASK) | ((frame & 7) << BM_LATENCY_FRAME_MICRO_SHIFT) | BM_LATENCY_FRAME_MICROFRAME;
+	}
+	else
+	{
+		frame = udd_get_frame_number() & BM_LATENCY_FRAME_MASK;
+	}
+	frame |= BM_LATENCY_FRAME_STAMPED;
+
+	for (i = 0; i + BM_LATENCY_STAMP_LENGTH <= Length; i += BM_EP_MAX_PACKET_SIZE)
+	{
+		Buffer[i + BM_LATENCY_FRAME_OFFSET] = (uint8_t)frame;
+		Buffer[i + BM_LATENCY_FRAME_OFFSET + 1] = (uint8_t)(frame >> 8);
+	}
+}
+
+// Control test; an OUT data stage longer than the ring starts over at its
+// first buffer. The USBB driver also calls this at the end of the OUT data
+// stage; the data is not used.
+static bool Bm_Control_OverUnderRun(void)
+{
+	udd_set_setup_payload(bm.Buffers[0], Min(udd_g_ctrlreq.req.wLength, sizeof(bm.Buffers)));
+	return true;
+}
+
+// Control test; status stage of a PICFW_CONTROL_READ/WRITE request.
+static void Bm_Control_Complete(void)
+{
+	Bm_CountTransfer(Udd_setup_is_in() ? BM_STATS_IN : BM_STATS_OUT, Bm_ControlLength);
+}
+
+// Splits the pacing target into (micro)frame ticks for the bus speed.
+static void Bm_Pacing_Init(void)
+{
+	Bm_Pacing.TicksPerSecond = udd_is_high_speed() ? 8000 : 1000;
+	Bm_Pacing.TickBytes = Bm_Pacing.Rate / Bm_Pacing.TicksPerSecond;
+	Bm_Pacing.TickRemainder = (uint16_t)(Bm_Pacing.Rate % Bm_Pacing.TicksPerSecond);
+	Bm_Pacing.Remainder = 0;
+	Bm_Pacing.Limit = Bm_Pacing.TickBytes + 1 + BM_EP_MAX_PACKET_SIZE;
+}
+
+// Adds one (micro)frame of credit to both endpoints.
+static void Bm_Pacing_Tick(void)
+{
+	uint32_t bytes = Bm_Pacing.TickBytes;
+
+	if (!Bm_Pacing.Rate)
+		return;
+
+	Bm_Pacing.Remainder += Bm_Pacing.TickRemainder;
+	if (Bm_Pacing.Remainder >= Bm_Pacing.TicksPerSecond)
+	{
+		Bm_Pacing.Remainder -= Bm_Pacing.TicksPerSecond;
+		bytes++;
+	}
+	bm.Rx.Credit = Min(bm.Rx.Credit + bytes, Bm_Pacing.Limit);
+	bm.Tx.Credit = Min(bm.Tx.Credit + bytes, Bm_Pacing.Limit);
+}
+
+// Status stage of PICFW_SET_PACING; the endpoints start over with no credit.
+static void Bm_Pacing_Set(void)
+{
+	Bm_Pacing.Rate = (uint32_t)Bm_PacingBuffer[0] | ((uint32_t)Bm_PacingBuffer[1] << 8) |
+	                 ((uint32_t)Bm_PacingBuffer[2] << 16) | ((uint32_t)Bm_PacingBuffer[3] << 24);
+	Bm_Pacing_Init();
+	bm.Rx.Credit = 0;
+	bm.Tx.Credit = 0;
+}
+
+// Length of the next transfer on XferEP; the whole packets of its credit
+// (taken) or 0 to wait for more. Unpaced, always BM_MAX_TRANSFER_SIZE.
+static uint16_t Bm_Pacing_Take(BM_XFER_EP* XferEP)
+{
+	uint32_t length;
+
+	if (!Bm_Pacing.Rate)
+		return BM_MAX_TRANSFER_SIZE;
+
+	length = Min(XferEP->Credit, BM_MAX_TRANSFER_SIZE);
+	length -= length % BM_EP_MAX_PACKET_SIZE;
+	XferEP->Credit -= length;
+	return (uint16_t)length;
+}
+
+// UDC_SOF_EVENT; once per 1ms frame at both speeds. A gap in the frame number
+// is a frame whose SOF interrupt was not taken.
+void Bm_Sof_Handler(void)
+{
+	uint16_t frameNumber = udd_get_frame_number();
+
+	if (bm.LastFrameNumberValid && frameNumber != bm.LastFrameNumber)
+		bm.Stats.MissedSofs += (uint16_t)(frameNumber - bm.LastFrameNumber - 1) & 0x7FF;
+	bm.LastFrameNumber = frameNumber;
+	bm.LastFrameNumberValid = true;
+	bm.Stats.Sofs++;
+
+	Bm_Pacing_Tick();
+	if (Bm_SofEvent) Bm_SofEvent();
+}
+
+// udi sof_notify; at high-speed the seven MSOFs of a frame. At full-speed
+// it fires with Bm_Sof_Handler and adds nothing.
+void Bm_MicroSof_Handler(void)
+{
+	if (udd_is_high_speed())
+		Bm_Pacing_Tick();
+}
+
 #if defined(BM_MANAGE_SOF_PERIOD_RX) || defined(BM_MANAGE_SOF_PERIOD_TX)
 static void Bm_Sof_Handler_HS(void)
 {
@@ -422,6 +631,8 @@ static void Bm_Sof_Handler_FS(void)
 bool Bm_Vendor_Handler(void)
 {
 	static uint8_t testType;
+	COMPILER_WORD_ALIGNED static BM_STATS stats;
+	uint8_t i;
 
 	if (Udd_setup_type() != USB_REQ_TYPE_VENDOR)
 		return false;
@@ -440,12 +651,95 @@ bool Bm_Vendor_Handler(void)
 		{
 			Bm_TestType = (uint8_t)udd_g_ctrlreq.req.wValue;
 			Bm_PrevTestType = 0xFF;	
+			Bm_ResetStats();
 		}
 		testType = Bm_TestType;
 		udd_set_setup_payload(&testType, 1);
 		return true;
 	}
 
+	// handles device counter reads; sent as a little-endian snapshot
+	if (udd_g_ctrlreq.req.bRequest == PICFW_GET_STATS)
+	{
+		if (!Udd_setup_is_in())
+			return false;
+
+		stats.Length = bm.Stats.Length;
+		stats.Version = bm.Stats.Version;
+		stats.Flags = cpu_to_le16(bm.Stats.Flags);
+		for (i = 0; i < 2; i++)
+		{
+			stats.Transfers[i] = cpu_to_le32(bm.Stats.Transfers[i]);
+			stats.Bytes[i] = cpu_to_le32(bm.Stats.Bytes[i]);
+			stats.Starved[i] = cpu_to_le32(bm.Stats.Starved[i]);
+		}
+		stats.Sofs = cpu_to_le32(bm.Stats.Sofs);
+		stats.MissedSofs = cpu_to_le32(bm.Stats.MissedSofs);
+
+		udd_set_setup_payload((uint8_t*)&stats, Min(udd_g_ctrlreq.req.wLength, sizeof(stats)));
+		return true;
+	}
+
+	// handles control test transfers; the data stage uses the transfer ring
+	// in place. (see BM_CONTROL_MAX_TRANSFER_SIZE)
+	if (udd_g_ctrlreq.req.bRequest == PICFW_CONTROL_READ ||
+	        udd_g_ctrlreq.req.bRequest == PICFW_CONTROL_WRITE)
+	{
+		// The ring belongs to the endpoints until Bm_Task has started the test.
+		if (Bm_TestType != TEST_CONTROL || Bm_IsNewTest())
+			return false;
+
+		if (udd_g_ctrlreq.req.wLength == 0 || udd_g_ctrlreq.req.wLength > BM_CONTROL_MAX_TRANSFER_SIZE)
+			return false;
+
+		if (Udd_setup_is_in() && udd_g_ctrlreq.req.bRequest != PICFW_CONTROL_READ)
+			return false;
+		if (Udd_setup_is_out() && udd_g_ctrlreq.req.bRequest != PICFW_CONTROL_WRITE)
+			return false;
+
+		// The USBB driver takes a single IN payload buffer; with a ring
+		// smaller than wLength the IN data stage is short.
+		udd_set_setup_payload(bm.Buffers[0], Min(udd_g_ctrlreq.req.wLength, sizeof(bm.Buffers)));
+		if (Udd_setup_is_in())
+		{
+			Bm_ControlLength = udd_g_ctrlreq.payload_size;
+		}
+		else
+		{
+			Bm_ControlLength = udd_g_ctrlreq.req.wLength;
+			udd_g_ctrlreq.over_under_run = Bm_Control_OverUnderRun;
+		}
+		udd_g_ctrlreq.callback = Bm_Control_Complete;
+		return true;
+	}
+
+	// handles the paced streaming target. (see BM_PACING_LENGTH)
+	if (udd_g_ctrlreq.req.bRequest == PICFW_SET_PACING ||
+	        udd_g_ctrlreq.req.bRequest == PICFW_GET_PACING)
+	{
+		if (udd_g_ctrlreq.req.wLength != BM_PACING_LENGTH)
+			return false;
+
+		if (Udd_setup_is_in() && udd_g_ctrlreq.req.bRequest != PICFW_GET_PACING)
+			return false;
+		if (Udd_setup_is_out() && udd_g_ctrlreq.req.bRequest != PICFW_SET_PACING)
+			return false;
+
+		if (Udd_setup_is_in())
+		{
+			Bm_PacingBuffer[0] = (uint8_t)Bm_Pacing.Rate;
+			Bm_PacingBuffer[1] = (uint8_t)(Bm_Pacing.Rate >> 8);
+			Bm_PacingBuffer[2] = (uint8_t)(Bm_Pacing.Rate >> 16);
+			Bm_PacingBuffer[3] = (uint8_t)(Bm_Pacing.Rate >> 24);
+		}
+		else
+		{
+			udd_g_ctrlreq.callback = Bm_Pacing_Set;
+		}
+		udd_set_setup_payload(Bm_PacingBuffer, BM_PACING_LENGTH);
+		return true;
+	}
+
 	// handles vendor buffer ctrl read/writes
 	if (udd_g_ctrlreq.req.bRequest == PICFW_GET_VENDOR_BUFFER ||
 	        udd_g_ctrlreq.req.bRequest == PICFW_SET_VENDOR_BUFFER)
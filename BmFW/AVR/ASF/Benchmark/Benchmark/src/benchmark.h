@@ -42,7 +42,9 @@ enum TestType
     TEST_NONE,
     TEST_PCREAD,
     TEST_PCWRITE,
-    TEST_LOOP
+    TEST_LOOP,
+    TEST_LATENCY	= 0x07,
+    TEST_CONTROL	= 0x08,
 };
 
 // PicFW Vendor-Specific Requests
@@ -52,8 +54,70 @@ enum PICFW_COMMANDS
     PICFW_GET_TEST		= 0x0F,
     PICFW_SET_VENDOR_BUFFER = 0x10,
     PICFW_GET_VENDOR_BUFFER = 0x11,
+    PICFW_GET_STATS		= 0x12,
+    PICFW_CONTROL_READ	= 0x13,
+    PICFW_CONTROL_WRITE	= 0x14,
+    PICFW_SET_PACING	= 0x15,
+    PICFW_GET_PACING	= 0x16,
 };
 
+//! Largest data stage of the control test. (TEST_CONTROL)
+/*!
+* PICFW_CONTROL_READ (IN) and PICFW_CONTROL_WRITE (OUT) move wLength bytes
+* while the control test is selected; the bulk/iso endpoints are idle. The
+* limit is the libusbK driver's MAX_CONTROL_TRANSFER_SIZE.
+*/
+#define BM_CONTROL_MAX_TRANSFER_SIZE	4096
+
+//! Data stage length of PICFW_SET_PACING (OUT) and PICFW_GET_PACING (IN).
+/*!
+* The target bandwidth of the read, write and loop tests in bytes per second,
+* little-endian; 0 (the default) runs them unpaced. While paced, every SOF
+* and (at high-speed) MSOF adds one (micro)frame of the target to each
+* endpoint's credit, a transfer is only started for the whole packets of the
+* credit and the main loop sleeps between interrupts. The target is kept
+* across PICFW_SET_TEST.
+*/
+#define BM_PACING_LENGTH	4
+
+//! GET_STATS counter block. (see libusbK/src/kBench/kBench_stats.h)
+/*!
+* Sent little-endian; the firmware keeps it in native byte order and
+* converts it when the request is answered.
+*/
+#define BM_STATS_VERSION		1
+#define BM_STATS_FLAG_SOFS		0x0001
+#define BM_STATS_FLAG_NAK_FLAGS	0x0002
+
+//! Transfers, Bytes and Starved index.
+#define BM_STATS_OUT			0
+#define BM_STATS_IN				1
+
+typedef struct _BM_STATS
+{
+	uint8_t  Length;
+	uint8_t  Version;
+	uint16_t Flags;
+	uint32_t Transfers[2];	//!< Transfers completed by the udd layer.
+	uint32_t Bytes[2];
+	uint32_t Starved[2];	//!< Completions that left the endpoint without a job.
+	uint32_t Sofs;
+	uint32_t MissedSofs;	//!< Frame numbers skipped between two SOF interrupts.
+} BM_STATS;
+
+//! Latency test stamp. (see libusbK/src/kBench/kBench_latency.h)
+/*!
+* The latency test runs the loop test; the host stamps the first six bytes
+* of every packet and the firmware writes the frame it received the packet
+* in at BM_LATENCY_FRAME_OFFSET (little-endian) before echoing it.
+*/
+#define BM_LATENCY_STAMP_LENGTH			8
+#define BM_LATENCY_FRAME_OFFSET			6
+#define BM_LATENCY_FRAME_MASK			0x07FF
+#define BM_LATENCY_FRAME_MICRO_SHIFT	11
+#define BM_LATENCY_FRAME_MICROFRAME		0x4000
+#define BM_LATENCY_FRAME_STAMPED		0x8000
+
 /******************************************************************************
  * doubly linked list macros (non-circular)                                   *
  *****************************************************************************/
@@ -162,8 +162,9 @@ uint8_t udi_usbk_getsetting(void)
 	return 0;
 }
 
-//! [INACTIVATED BY TRAVIS]
-//!
+//! Called by UDC on every SOF at full-speed and on the MSOFs between the
+//! frame SOFs at high-speed.
 void udi_usbk_data_sof_notify(void)
 {
+	Bm_MicroSof_Handler();
 }
@@ -0,0 +1,92 @@
+/*! benchmark_pattern.h
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef BENCHMARK_PATTERN_H_
+#define BENCHMARK_PATTERN_H_
+
+#include <string.h>
+#include <compiler.h>
+
+/*
+* Benchmark test pattern.
+*
+* Every packet sent in a read test starts over with the pattern kBench's
+* VerifyData expects: 0,1,2..255, then 1..255 repeating (0 is skipped after
+* the first wrap). Byte 1 is replaced with the packet key, which increments
+* with every packet.
+*
+* The pattern is copied from a const table instead of being generated a byte
+* at a time, and the key is stamped together with byte 0 (always 0) in one
+* 16-bit store. Buffers are filled once when a test starts; after that only
+* the key is stamped. (see Bm_InitXferBuffers)
+*/
+
+#define BM_PATTERN_16(n) \
+	(n)+0x0,(n)+0x1,(n)+0x2,(n)+0x3,(n)+0x4,(n)+0x5,(n)+0x6,(n)+0x7,\
+	(n)+0x8,(n)+0x9,(n)+0xA,(n)+0xB,(n)+0xC,(n)+0xD,(n)+0xE,(n)+0xF
+
+//! First 256 bytes of a packet; bytes 256+ repeat entries 1..255.
+static const uint8_t Bm_PatternTable[256] =
+{
+	BM_PATTERN_16(0x00),
+	BM_PATTERN_16(0x10),
+	BM_PATTERN_16(0x20),
+	BM_PATTERN_16(0x30),
+	BM_PATTERN_16(0x40),
+	BM_PATTERN_16(0x50),
+	BM_PATTERN_16(0x60),
+	BM_PATTERN_16(0x70),
+	BM_PATTERN_16(0x80),
+	BM_PATTERN_16(0x90),
+	BM_PATTERN_16(0xA0),
+	BM_PATTERN_16(0xB0),
+	BM_PATTERN_16(0xC0),
+	BM_PATTERN_16(0xD0),
+	BM_PATTERN_16(0xE0),
+	BM_PATTERN_16(0xF0)
+};
+
+//! Fills one packet with the test pattern.
+static inline void Bm_PatternFill(uint8_t* pPacket, uint16_t size)
+{
+	uint16_t length = Min(size, sizeof(Bm_PatternTable));
+
+	memcpy(pPacket, Bm_PatternTable, length);
+	for (pPacket += length, size -= length; size; pPacket += length, size -= length)
+	{
+		length = Min(size, sizeof(Bm_PatternTable)-1);
+		memcpy(pPacket, &Bm_PatternTable[1], length);
+	}
+}
+
+//! Stamps the packet key; bytes 0 and 1 in one store. The packet must be 16-bit aligned.
+#define Bm_PatternStampKey(pPacket, key) \
+	(*((le16_t*)(pPacket)) = cpu_to_le16((uint16_t)((uint8_t)(key)) << 8))
+
+#endif /* BENCHMARK_PATTERN_H_ */
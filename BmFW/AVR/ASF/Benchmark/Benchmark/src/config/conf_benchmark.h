@@ -36,6 +36,9 @@
 
 typedef void (*Bm_RunTestDelegate) (void);
 
+//! Settings defined here (e.g. by BmFW/DescGen) replace the User Assignable defaults below.
+#include "conf_benchmark_external.h"
+
 #define MAKE_INTERVAL_SIZE(Size, SizeMultiplier, Interval) ((((Size*SizeMultiplier)*Interval)+(Interval-1))/Interval)
 
 /*!
@@ -75,32 +78,42 @@ typedef void (*Bm_RunTestDelegate) (void);
 #define  BM_EP_RX					(2 | USB_EP_DIR_OUT)
 
 //! Benchmark RX/TX endpoint type.							(User Assignable)
+#ifndef BM_EP_TYPE
 #define BM_EP_TYPE					EP_TYPE_ISO
 //#define BM_EP_TYPE					EP_TYPE_BULK
 //#define BM_EP_TYPE					EP_TYPE_INT
+#endif
 
 //! Benchmark interface number.
 #define  BM_INTF_NUMBER				0
 
 //! Benchmark TX/RX endpoint packet size.					(User Assignable)
+#ifndef BM_EP_MAX_PACKET_SIZE
 #define BM_EP_MAX_PACKET_SIZE       64
+#endif
 
 /*!
 * Endpoint type-specific configuration options.				(User Assignable)
 */
 #if (BM_EP_TYPE==EP_TYPE_BULK)
 	#define BM_EP_ATTRIBUTES	BM_EP_TYPE
+	#ifndef BM_EP_INTERVAL
 	#define BM_EP_INTERVAL		0
+	#endif
 #elif (BM_EP_TYPE==EP_TYPE_INT)
 	#define BM_EP_ATTRIBUTES	BM_EP_TYPE
+	#ifndef BM_EP_INTERVAL
 	#define BM_EP_INTERVAL		4
+	#endif
 #elif (BM_EP_TYPE==EP_TYPE_ISO)
 	#define BM_EP_ATTRIBUTES	BM_EP_TYPE|EP_ISO_SYNC_NS|EP_ISO_USAGE_DE
+	#ifndef BM_EP_INTERVAL
 	#ifdef USB_DEVICE_HS_SUPPORT
 	#define BM_EP_INTERVAL		4
 	#else
 	#define BM_EP_INTERVAL		1
 	#endif
+	#endif
 #endif
 
 //! Number of benchmark endpoints.
@@ -112,19 +125,28 @@ typedef void (*Bm_RunTestDelegate) (void);
 //! Configured endpoint bank size.
 #define BM_BANK_SIZE	512
 
+//! Number of DMA buffers in the transfer ring shared by both endpoints.	(User Assignable)
+//! Must be a power of 2 (2-128); deeper rings absorb more main loop latency.
+#ifndef BM_RING_SIZE
+#define BM_RING_SIZE	(BM_BANK_COUNT*BM_EP_COUNT)
+#endif
+
 //! Benchmark VBus event handler.
 extern void Bm_VBus_Handler(bool bIsAttached);
 
 //! Benchmark vendor request event handler.
 extern bool Bm_Vendor_Handler(void);
 
+//! Benchmark SOF event handler; counts SOFs, then calls Bm_SofEvent.
+extern void Bm_Sof_Handler(void);
+
+//! Benchmark MSOF handler; the udi sof_notify, paces the high-speed microframes.
+extern void Bm_MicroSof_Handler(void);
+
 extern volatile Bm_RunTestDelegate Bm_SofEvent;
 #define USB_DEVICE_SPECIFIC_REQUEST()	Bm_Vendor_Handler()
 #define  UDC_VBUS_EVENT(bIsAttached)	Bm_VBus_Handler(bIsAttached)
-
-#if (BM_EP_TYPE==EP_TYPE_ISO)
-	#define  UDC_SOF_EVENT()			if (Bm_SofEvent)(Bm_SofEvent())
-#endif
+#define  UDC_SOF_EVENT()				Bm_Sof_Handler()
 
 #include "conf_bm_iso.h"
 
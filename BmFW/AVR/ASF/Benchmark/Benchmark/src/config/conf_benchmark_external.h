@@ -0,0 +1,3 @@
+#ifndef _CONF_BENCHMARK_EXTERNAL_H_
+#define _CONF_BENCHMARK_EXTERNAL_H_
+#endif
@@ -39,8 +39,8 @@
 #ifndef _CONF_USB_H_
 #define _CONF_USB_H_
 
-//! UDC patched by Travis to disable interface  level SOF handlers.
-#define UDC_INTERFACE_SOF_HANDLERS_DISABLED
+//! The interface level SOF handler paces the benchmark per microframe.
+//! (see Bm_MicroSof_Handler; UDC_INTERFACE_SOF_HANDLERS_DISABLED removes it)
 
 #include "compiler.h"
 
@@ -11,6 +11,7 @@
  */
 #include <asf.h>
 #include "conf_board.h"
+#include "sleepmgr.h"
 
 volatile uint8_t g_IsUsbAttached = 0;
 
@@ -46,6 +47,10 @@ int main (void)
 	sysclk_init();
 	board_init();
 
+	// The benchmark sleeps between interrupts while paced; the USBB driver
+	// locks the modes that keep the USB clock running.
+	sleepmgr_init();
+
 	// Initialize interrupt vector table support.
 	irq_initialize_vectors();
 	
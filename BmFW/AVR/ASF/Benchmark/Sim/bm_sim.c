@@ -0,0 +1,482 @@
+/*! bm_sim.c
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Host simulation of the ASF benchmark firmware.
+//
+// Builds benchmark.c, benchmark_desc.c and the ASF udc.c against udd_sim,
+// enumerates the device, selects a test with PICFW_SET_TEST (the same
+// request kBench sends) and runs the firmware main loop against the
+// simulated bus. Reports per endpoint throughput, idle bus slots and how
+// the firmware cycled its buffers.
+//
+// Usage: bm_sim [test=loop|read|write|latency|ctrlread|ctrlwrite]
+//               [speed=hs|fs] [time=<ms>] [bw=<bus bytes per interval>]
+//               [overhead=<bytes per packet>]
+//               [steps=<main loop iterations per interval>]
+//               [length=<control test data stage bytes>]
+//               [rate=<paced KB/s>]
+//
+// Also reads the firmware's GET_STATS counters before and after the run,
+// decoded the way kBench does, and prints the difference. The latency test
+// stamps and decodes packets with kBench_latency.c and prints the latency
+// distributions. The control tests repeat PICFW_CONTROL_READ/WRITE
+// requests of length bytes (4096 by default) and print the distribution of
+// the control transfer times. With rate the target bandwidth is set with
+// PICFW_SET_PACING before the test starts; the throughput and the largest
+// burst in a 1ms frame are checked against it and the share of main loop
+// iterations the firmware slept through is printed. The target must be
+// below what the test moves unpaced.
+//
+// Returns non-zero if the device fails to enumerate, no data is moved,
+// a bulk/interrupt endpoint sees a sequence error, the firmware counters
+// disagree with what the bus moved, a latency test packet is lost,
+// reordered or not stamped, a control test request is stalled or a paced
+// endpoint misses its target or never sleeps.
+//
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "udd_sim.h"
+#include "benchmark.h"
+#include "kBench_stats.h"
+#include "kBench_latency.h"
+
+extern void Bm_Task(void);
+
+#define Bm_SimIsLoop(testType) ((testType) == TEST_LOOP || (testType) == TEST_LATENCY)
+
+typedef struct
+{
+	const char *name;
+	uint8_t type;
+	//! Control tests; the request the host repeats.
+	uint8_t request;
+} BM_SIM_TEST;
+
+static const BM_SIM_TEST Bm_SimTests[] =
+{
+	{ "loop",	TEST_LOOP },
+	{ "latency",	TEST_LATENCY },
+	{ "read",	TEST_PCREAD },
+	{ "write",	TEST_PCWRITE },
+	{ "ctrlread",	TEST_CONTROL,	PICFW_CONTROL_READ },
+	{ "ctrlwrite",	TEST_CONTROL,	PICFW_CONTROL_WRITE },
+	{ "none",	TEST_NONE },
+};
+
+static const char* Bm_SimEpType(uint8_t type)
+{
+	switch (type)
+	{
+	case USB_EP_TYPE_ISOCHRONOUS:
+		return "iso";
+	case USB_EP_TYPE_BULK:
+		return "bulk";
+	case USB_EP_TYPE_INTERRUPT:
+		return "int";
+	default:
+		return "ctrl";
+	}
+}
+
+static bool Bm_SimReport(udd_ep_id_t ep, uint64_t elapsedUs)
+{
+	udd_sim_ep_stats_t *stats = udd_sim_get_ep_stats(ep);
+	uint8_t i;
+
+	if (!stats)
+	{
+		printf("ep %02Xh: not configured\n", ep);
+		return false;
+	}
+
+	printf("ep %02Xh %-3s %-4s size %u interval %u\n",
+	       stats->ep, (stats->ep & USB_EP_DIR_IN) ? "IN" : "OUT",
+	       Bm_SimEpType(stats->type), stats->size, stats->interval);
+	printf("  transfers %" PRIu32 " bytes %" PRIu64 " (%.2f KB/s) aborted %" PRIu32 "\n",
+	       stats->transfers, stats->bytes,
+	       elapsedUs ? ((double)stats->bytes * 1000000.0 / (double)elapsedUs) / 1024.0 : 0.0,
+	       stats->aborted);
+	printf("  idle slots %" PRIu32 "/%" PRIu32 " (%.1f%%) sequence errors %" PRIu32 "\n",
+	       stats->idle_slots, stats->slots,
+	       stats->slots ? (100.0 * stats->idle_slots) / stats->slots : 0.0,
+	       stats->seq_errors);
+	printf("  buffers %u:", stats->buffer_count);
+	for (i = 0; i < stats->buffer_count; i++)
+		printf(" %" PRIu32, stats->buffers[i].submitted);
+	printf("\n");
+
+	if (!stats->bytes)
+		return false;
+	if (stats->seq_errors && stats->type != USB_EP_TYPE_ISOCHRONOUS)
+		return false;
+	if (stats->aborted && stats->type == USB_EP_TYPE_CONTROL)
+		return false;
+	return true;
+}
+
+// kBench Bench_GetStats
+static bool Bm_SimGetStats(BM_DEVICE_STATS* stats)
+{
+	uint8_t data[BM_STATS_LENGTH];
+	uint16_t nb_trans = 0;
+
+	if (!udd_sim_control(USB_REQ_DIR_IN | USB_REQ_TYPE_VENDOR | USB_REQ_RECIP_DEVICE,
+	                     PICFW_GET_STATS, 0, BM_INTF_NUMBER, sizeof(data), data, &nb_trans))
+		return false;
+	return BmStats_Decode(stats, data, nb_trans) == 0;
+}
+
+// The firmware counts in the completion callbacks; the counts must match the
+// bus exactly. Every 1ms frame has one SOF, seen or missed.
+static bool Bm_SimCheckStats(const BM_DEVICE_STATS* delta, uint8_t testType, uint32_t timeMs)
+{
+	udd_sim_ep_stats_t *tx = udd_sim_get_ep_stats(BM_EP_TX);
+	udd_sim_ep_stats_t *rx = udd_sim_get_ep_stats(BM_EP_RX);
+	udd_sim_ep_stats_t *ctrl = udd_sim_get_ep_stats(0);
+	bool success = true;
+	char line[256];
+	long frames;
+	int i;
+
+	BmStats_Format(line, sizeof(line), delta);
+	printf("%s\n", line);
+
+	if ((Bm_SimIsLoop(testType) || testType == TEST_PCREAD) && tx &&
+	        (delta->Transfers[BM_STATS_IN] != tx->transfers || delta->Bytes[BM_STATS_IN] != (uint32_t)tx->bytes))
+		success = false;
+	if ((Bm_SimIsLoop(testType) || testType == TEST_PCWRITE) && rx &&
+	        (delta->Transfers[BM_STATS_OUT] != rx->transfers || delta->Bytes[BM_STATS_OUT] != (uint32_t)rx->bytes))
+		success = false;
+	if (testType == TEST_CONTROL && ctrl)
+	{
+		i = (ctrl->ep & USB_EP_DIR_IN) ? BM_STATS_IN : BM_STATS_OUT;
+		if (delta->Transfers[i] != ctrl->transfers || delta->Bytes[i] != (uint32_t)ctrl->bytes ||
+		        delta->Transfers[!i] || delta->Bytes[!i])
+			success = false;
+	}
+
+	frames = (long)(delta->Sofs + delta->MissedSofs);
+	if (!(delta->Flags & BM_STATS_FLAG_SOFS) || frames < (long)timeMs - 1 || frames > (long)timeMs + 1)
+		success = false;
+
+	if (!success)
+		printf("device counters do not match the bus\n");
+	return success;
+}
+
+// Every echoed packet must carry the host and device stamps, in order. The
+// simulated clock is exact at each (micro)frame start, so one-way times are
+// good to half a device (micro)frame. A round trip under twice that is not
+// split; the others are split at the middle of the (micro)frame, so they add
+// up to it exactly and neither exceeds it.
+static bool Bm_SimCheckLatency(const BM_LATENCY_RESULT* latency, bool highSpeed)
+{
+	int resolutionUs = highSpeed ? 125 / 2 : 1000 / 2;
+	char line[256];
+
+	BmLatency_Format(line, sizeof(line), latency);
+	printf("latency: %s\n", line);
+	BmLatency_FormatHistogram(line, sizeof(line), &latency->RoundTrip);
+	printf("  round trip     %s\n", line);
+	BmLatency_FormatHistogram(line, sizeof(line), &latency->OutLatency);
+	printf("  host to device %s\n", line);
+	BmLatency_FormatHistogram(line, sizeof(line), &latency->InLatency);
+	printf("  device to host %s\n", line);
+
+	if (!latency->Packets || latency->Lost || latency->Reordered || latency->Unstamped)
+		return false;
+	if (latency->OutLatency.Count + latency->OneWaySkipped != latency->Packets || latency->RoundTrip.MinUs <= 0)
+		return false;
+
+	if (latency->ResolutionUs != resolutionUs)
+	{
+		printf("one-way resolution is +/-%dus, expected +/-%dus\n", latency->ResolutionUs, resolutionUs);
+		return false;
+	}
+	if ((latency->RoundTrip.MaxUs < 2 * resolutionUs && latency->OutLatency.Count) ||
+	        (latency->RoundTrip.MinUs >= 2 * resolutionUs && latency->OneWaySkipped))
+	{
+		printf("round trips under +/-%dus x 2 must not be split, and only those\n", resolutionUs);
+		return false;
+	}
+	if ((!latency->OneWaySkipped && latency->OutLatency.TotalUs + latency->InLatency.TotalUs != latency->RoundTrip.TotalUs) ||
+	        latency->OutLatency.MaxUs > latency->RoundTrip.MaxUs ||
+	        latency->InLatency.MaxUs > latency->RoundTrip.MaxUs)
+	{
+		printf("one-way latencies do not split the round trip time\n");
+		return false;
+	}
+	return true;
+}
+
+// Every control transfer must move the whole data stage; an IN data stage
+// is at most the firmware's transfer ring. The SETUP, data and status
+// transactions may not exceed the USB 2.0 control limit per interval.
+static bool Bm_SimCheckControl(const udd_sim_ep_stats_t* stats, uint16_t length, uint64_t elapsedUs, bool highSpeed)
+{
+	uint32_t expected = length;
+	uint64_t transactions, limit;
+	char line[256];
+
+	if ((stats->ep & USB_EP_DIR_IN) && expected > BM_RING_SIZE * BM_BUFFER_SIZE)
+		expected = BM_RING_SIZE * BM_BUFFER_SIZE;
+
+	BmLatency_FormatHistogram(line, sizeof(line), &stats->latency.RoundTrip);
+	printf("  control transfer %s\n", line);
+
+	if (!stats->transfers || stats->bytes != (uint64_t)stats->transfers * expected)
+	{
+		printf("control transfers moved %" PRIu64 " bytes, expected %" PRIu32 " each\n", stats->bytes, expected);
+		return false;
+	}
+
+	transactions = (uint64_t)stats->transfers * ((expected + USB_DEVICE_EP_CTRL_SIZE - 1) / USB_DEVICE_EP_CTRL_SIZE + 2);
+	limit = highSpeed ? (elapsedUs / 125) * UDD_SIM_CTRL_HS_TRANSACTIONS : (elapsedUs / 1000) * UDD_SIM_CTRL_FS_TRANSACTIONS;
+	if (transactions > limit)
+	{
+		printf("control transfers took %" PRIu64 " transactions, the bus allows %" PRIu64 "\n", transactions, limit);
+		return false;
+	}
+	return true;
+}
+
+// Paced tests; an endpoint must move the target to within 1% and two
+// credit limits. No 1ms frame may carry more than a frame of credit and two
+// limits; one saved up, one in flight from the frame before.
+static bool Bm_SimCheckPacing(udd_ep_id_t ep, uint32_t rate, uint64_t elapsedUs, bool highSpeed)
+{
+	udd_sim_ep_stats_t *stats = udd_sim_get_ep_stats(ep);
+	double limit = rate / (highSpeed ? 8000 : 1000) + 1 + BM_EP_MAX_PACKET_SIZE;
+	double expected = (double)rate * (double)elapsedUs / 1000000.0;
+	double maxFrame = rate / 1000.0 + 1 + 2 * limit;
+
+	if (!stats)
+		return false;
+
+	printf("  paced %.1f%% of %.2f KB/s, at most %" PRIu32 " bytes in a frame (limit %.0f)\n",
+	       expected ? (100.0 * stats->bytes) / expected : 0.0, rate / 1024.0,
+	       stats->max_frame_bytes, maxFrame);
+
+	if (fabs((double)stats->bytes - expected) > expected / 100.0 + 2 * limit)
+	{
+		printf("ep %02Xh missed the paced target\n", ep);
+		return false;
+	}
+	if (stats->max_frame_bytes > maxFrame)
+	{
+		printf("ep %02Xh burst above the paced target\n", ep);
+		return false;
+	}
+	return true;
+}
+
+// kBench sends the target the same way; le32 bytes per second.
+static bool Bm_SimSetPacing(uint32_t rate)
+{
+	uint8_t data[BM_PACING_LENGTH];
+	uint16_t nb_trans = 0;
+
+	data[0] = (uint8_t)rate;
+	data[1] = (uint8_t)(rate >> 8);
+	data[2] = (uint8_t)(rate >> 16);
+	data[3] = (uint8_t)(rate >> 24);
+	if (!udd_sim_control(USB_REQ_DIR_OUT | USB_REQ_TYPE_VENDOR | USB_REQ_RECIP_DEVICE,
+	                     PICFW_SET_PACING, 0, BM_INTF_NUMBER, sizeof(data), data, NULL))
+		return false;
+
+	memset(data, 0, sizeof(data));
+	if (!udd_sim_control(USB_REQ_DIR_IN | USB_REQ_TYPE_VENDOR | USB_REQ_RECIP_DEVICE,
+	                     PICFW_GET_PACING, 0, BM_INTF_NUMBER, sizeof(data), data, &nb_trans) || nb_trans != sizeof(data))
+		return false;
+	return ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24)) == rate;
+}
+
+int main(int argc, char* argv[])
+{
+	udd_sim_config_t config;
+	uint8_t testType = TEST_LOOP;
+	uint8_t controlRequest = 0;
+	uint16_t controlLength = BM_CONTROL_MAX_TRANSFER_SIZE;
+	const char* testName = Bm_SimTests[0].name;
+	uint8_t response = 0;
+	uint32_t timeMs = 1000;
+	uint32_t rate = 0;
+	uint32_t intervals;
+	uint32_t steps, sleepSteps, stepsBefore, sleepStepsBefore;
+	uint64_t elapsedUs;
+	BM_DEVICE_STATS before, after, delta;
+	bool success = true;
+	int i;
+	size_t t;
+
+	memset(&config, 0, sizeof(config));
+	config.high_speed = true;
+	config.task_steps = 16;
+	config.task = Bm_Task;
+
+	for (i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = strchr(arg, '=');
+
+		if (!value)
+			goto Usage;
+		value++;
+
+		if (!strncmp(arg, "test=", 5))
+		{
+			for (t = 0; t < sizeof(Bm_SimTests) / sizeof(Bm_SimTests[0]); t++)
+			{
+				if (!strcmp(value, Bm_SimTests[t].name)) break;
+			}
+			if (t == sizeof(Bm_SimTests) / sizeof(Bm_SimTests[0]))
+				goto Usage;
+			testType = Bm_SimTests[t].type;
+			testName = Bm_SimTests[t].name;
+			controlRequest = Bm_SimTests[t].request;
+		}
+		else if (!strncmp(arg, "speed=", 6))
+			config.high_speed = strcmp(value, "fs") ? true : false;
+		else if (!strncmp(arg, "time=", 5))
+			timeMs = (uint32_t)strtoul(value, NULL, 0);
+		else if (!strncmp(arg, "bw=", 3))
+			config.bus_bytes = (uint16_t)strtoul(value, NULL, 0);
+		else if (!strncmp(arg, "overhead=", 9))
+			config.packet_overhead = (uint16_t)strtoul(value, NULL, 0);
+		else if (!strncmp(arg, "steps=", 6))
+			config.task_steps = (uint16_t)strtoul(value, NULL, 0);
+		else if (!strncmp(arg, "length=", 7))
+			controlLength = (uint16_t)strtoul(value, NULL, 0);
+		else if (!strncmp(arg, "rate=", 5))
+			rate = (uint32_t)(strtod(value, NULL) * 1024.0);
+		else
+			goto Usage;
+	}
+
+	// Defaults allow 13 512 byte packets per microframe (high-speed) or
+	// 19 64 byte packets per frame (full-speed). Control transactions are
+	// charged by udd_sim; see UDD_SIM_CTRL_HS_TRANSACTIONS.
+	if (!config.packet_overhead)
+		config.packet_overhead = 8;
+	if (!config.bus_bytes)
+		config.bus_bytes = config.high_speed ? 13 * (512 + 8) : 19 * (64 + 8);
+
+	config.latency = (testType == TEST_LATENCY);
+	config.control = (testType == TEST_CONTROL);
+	config.control_request_type = USB_REQ_TYPE_VENDOR | USB_REQ_RECIP_DEVICE |
+	                              (controlRequest == PICFW_CONTROL_READ ? USB_REQ_DIR_IN : USB_REQ_DIR_OUT);
+	config.control_request = controlRequest;
+	config.control_index = BM_INTF_NUMBER;
+	config.control_length = controlLength;
+	udd_sim_init(&config);
+
+	cpu_irq_enable();
+	udc_start();
+	udc_attach();
+
+	if (!udd_sim_enumerate())
+	{
+		printf("enumeration failed\n");
+		return 1;
+	}
+	if (rate && !Bm_SimSetPacing(rate))
+	{
+		printf("PICFW_SET_PACING failed\n");
+		return 1;
+	}
+	if (!udd_sim_control(USB_REQ_DIR_IN | USB_REQ_TYPE_VENDOR | USB_REQ_RECIP_DEVICE,
+	                     PICFW_SET_TEST, testType, BM_INTF_NUMBER, 1, &response, NULL) || response != testType)
+	{
+		printf("PICFW_SET_TEST failed\n");
+		return 1;
+	}
+	// The control test requests are stalled until the main loop has started the test.
+	if (testType == TEST_CONTROL)
+		Bm_Task();
+	if (!Bm_SimGetStats(&before))
+	{
+		printf("PICFW_GET_STATS failed\n");
+		return 1;
+	}
+
+	printf("%s-speed %s test, %" PRIu32 " ms, bus %u bytes per %s, %u main loop steps\n",
+	       config.high_speed ? "high" : "full",
+	       testName, timeMs, config.bus_bytes,
+	       config.high_speed ? "microframe" : "frame", config.task_steps);
+	if (rate)
+		printf("paced at %.2f KB/s\n", rate / 1024.0);
+
+	udd_sim_get_cpu_stats(&stepsBefore, &sleepStepsBefore);
+	intervals = config.high_speed ? timeMs * 8 : timeMs;
+	while (intervals--)
+		udd_sim_run_interval();
+	udd_sim_get_cpu_stats(&steps, &sleepSteps);
+	steps -= stepsBefore;
+	sleepSteps -= sleepStepsBefore;
+
+	elapsedUs = udd_sim_time_us();
+	if (Bm_SimIsLoop(testType) || testType == TEST_PCREAD)
+	{
+		success = Bm_SimReport(BM_EP_TX, elapsedUs) && success;
+		if (rate)
+			success = Bm_SimCheckPacing(BM_EP_TX, rate, elapsedUs, config.high_speed) && success;
+	}
+	if (Bm_SimIsLoop(testType) || testType == TEST_PCWRITE)
+	{
+		success = Bm_SimReport(BM_EP_RX, elapsedUs) && success;
+		if (rate)
+			success = Bm_SimCheckPacing(BM_EP_RX, rate, elapsedUs, config.high_speed) && success;
+	}
+	if (testType == TEST_LATENCY && udd_sim_get_ep_stats(BM_EP_TX))
+		success = Bm_SimCheckLatency(&udd_sim_get_ep_stats(BM_EP_TX)->latency, config.high_speed) && success;
+	if (testType == TEST_CONTROL)
+		success = Bm_SimReport(0, elapsedUs) && Bm_SimCheckControl(udd_sim_get_ep_stats(0), controlLength, elapsedUs, config.high_speed) && success;
+
+	printf("main loop: %" PRIu32 " steps, asleep %.1f%%\n",
+	       steps, steps ? (100.0 * sleepSteps) / steps : 0.0);
+	if (rate && !sleepSteps)
+		success = false;
+
+	if (!Bm_SimGetStats(&after))
+	{
+		printf("PICFW_GET_STATS failed\n");
+		return 1;
+	}
+	BmStats_Delta(&delta, &after, &before);
+	success = Bm_SimCheckStats(&delta, testType, timeMs) && success;
+
+	udc_stop();
+	return success ? 0 : 1;
+
+Usage:
+	printf("usage: %s [test=loop|read|write|latency|ctrlread|ctrlwrite] [speed=hs|fs] [time=<ms>] [bw=<bytes>] [overhead=<bytes>] [steps=<count>] [length=<bytes>] [rate=<KB/s>]\n", argv[0]);
+	return 1;
+}
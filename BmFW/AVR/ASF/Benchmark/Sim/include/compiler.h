@@ -0,0 +1,96 @@
+/*! compiler.h
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Host replacement for the AVR32 compiler.h used by the benchmark
+// simulation (see udd_sim.h). It provides only what benchmark.c, the
+// descriptors and udc.c use. The host is little-endian, so the USB
+// byte order macros are no-ops.
+//
+#ifndef _COMPILER_AVR32_H_
+#define _COMPILER_AVR32_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define COMPILER_PRAGMA(arg)			_Pragma(#arg)
+#define COMPILER_PACK_SET(alignment)	COMPILER_PRAGMA(pack(alignment))
+#define COMPILER_PACK_RESET()			COMPILER_PRAGMA(pack())
+#define COMPILER_WORD_ALIGNED			__attribute__((__aligned__(4)))
+
+#define UNUSED(v)	(void)(v)
+#define Assert(expr) assert(expr)
+
+typedef uint16_t	le16_t;
+typedef uint32_t	le32_t;
+typedef uint32_t	iram_size_t;
+
+#define LE16(x)				((uint16_t)(x))
+#define le16_to_cpu(x)		((uint16_t)(x))
+#define cpu_to_le16(x)		((uint16_t)(x))
+#define LE16_TO_CPU(x)		((uint16_t)(x))
+#define CPU_TO_LE16(x)		((uint16_t)(x))
+#define le32_to_cpu(x)		((uint32_t)(x))
+#define cpu_to_le32(x)		((uint32_t)(x))
+
+#define MSB(u16)	(((uint8_t*)&(u16))[1])
+#define LSB(u16)	(((uint8_t*)&(u16))[0])
+
+#define Min(a, b)	(((a) < (b)) ?  (a) : (b))
+#define Max(a, b)	(((a) > (b)) ?  (a) : (b))
+#define min(a, b)	Min(a, b)
+#define max(a, b)	Max(a, b)
+
+#define barrier()	__asm__ __volatile__("" ::: "memory")
+
+// Interrupts are simulated; udd_sim only raises them between main loop
+// iterations and never while they are masked.
+typedef uint32_t irqflags_t;
+
+extern volatile bool udd_sim_irq_enabled;
+
+static inline irqflags_t cpu_irq_save(void)
+{
+	irqflags_t flags = udd_sim_irq_enabled;
+	udd_sim_irq_enabled = false;
+	return flags;
+}
+
+static inline void cpu_irq_restore(irqflags_t flags)
+{
+	udd_sim_irq_enabled = flags ? true : false;
+}
+
+#define cpu_irq_enable()	(udd_sim_irq_enabled = true)
+#define cpu_irq_disable()	(udd_sim_irq_enabled = false)
+#define cpu_irq_is_enabled() (udd_sim_irq_enabled)
+
+#endif // _COMPILER_AVR32_H_
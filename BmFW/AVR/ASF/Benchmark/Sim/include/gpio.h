@@ -0,0 +1,45 @@
+/*! gpio.h
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Host replacement for the AVR32 gpio driver used by the benchmark
+// simulation. Pin levels are kept so LED activity can be inspected.
+//
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+#include "compiler.h"
+
+extern volatile uint32_t udd_sim_gpio;
+extern volatile uint32_t udd_sim_gpio_toggles;
+
+#define gpio_set_pin_low(pin)	(udd_sim_gpio &= ~(1UL << (pin)))
+#define gpio_set_pin_high(pin)	(udd_sim_gpio |= (1UL << (pin)))
+#define gpio_tgl_gpio_pin(pin)	(udd_sim_gpio ^= (1UL << (pin)), udd_sim_gpio_toggles++)
+
+#endif // _GPIO_H_
@@ -0,0 +1,221 @@
+/*! pattern_sim.c
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Host check of the benchmark test pattern. (see benchmark_pattern.h)
+//
+// Verifies that packets filled from the pattern table and stamped with
+// Bm_PatternStampKey are bit-exact with the byte loop the firmware used
+// before (Bm_FillBuffer and mSetWritePacketID) and pass kBench's
+// VerifyData check, for every packet size from 8 to 1024 bytes and across
+// packet key wraps. Then reports the cost per packet of each fill and
+// stamp method in host cycles (rdtsc on x86, nanoseconds elsewhere).
+//
+// Usage: pattern_sim [size=<packet size>] [loops=<count>]
+//
+// Returns non-zero if any packet differs.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "benchmark_pattern.h"
+
+#define PATTERN_SIM_MAX_SIZE	1024
+#define PATTERN_SIM_PACKETS		600
+
+static COMPILER_WORD_ALIGNED uint8_t Pattern_Buffer[PATTERN_SIM_PACKETS * PATTERN_SIM_MAX_SIZE];
+static COMPILER_WORD_ALIGNED uint8_t Pattern_Legacy[PATTERN_SIM_PACKETS * PATTERN_SIM_MAX_SIZE];
+
+// The fill the firmware used before the pattern table.
+static void Legacy_FillBuffer(uint8_t* pBuffer, uint16_t size)
+{
+	uint8_t dataByte = 0;
+	uint16_t counter;
+
+	for (counter = 0; counter < size; counter++)
+	{
+		pBuffer[counter] = dataByte++;
+		if (dataByte == 0) dataByte++;
+	}
+}
+
+// kBench CreateVerifyBuffer and VerifyData; returns the number of bad packets.
+static int KBench_VerifyData(const uint8_t* data, int dataLength, uint16_t packetSize)
+{
+	uint8_t verifyData[PATTERN_SIM_MAX_SIZE];
+	uint8_t indexC = 0;
+	uint8_t keyC = 0;
+	bool seedKey = true;
+	int dataLeft = dataLength;
+	int dataIndex = 0;
+	int errors = 0;
+	int verifySize;
+	int i;
+
+	for (i = 0; i < packetSize; i++)
+	{
+		verifyData[i] = indexC++;
+		if (indexC == 0) indexC = 1;
+	}
+
+	while (dataLeft > 1)
+	{
+		verifySize = dataLeft > packetSize ? packetSize : dataLeft;
+
+		if (seedKey)
+			keyC = data[dataIndex + 1];
+		else if (data[dataIndex + 1] == 0)
+			keyC = 0;
+		else
+			keyC++;
+		seedKey = false;
+		verifyData[1] = keyC;
+
+		if (memcmp(&data[dataIndex], verifyData, verifySize) != 0)
+		{
+			seedKey = true;
+			errors++;
+		}
+
+		dataLeft -= verifySize;
+		dataIndex += verifySize;
+	}
+
+	return errors;
+}
+
+static bool Pattern_Verify(uint16_t packetSize)
+{
+	uint8_t legacyKey = 0, key = 0;
+	int length = PATTERN_SIM_PACKETS * packetSize;
+	int i, errors;
+
+	// Prefilled once, stamped per packet.
+	for (i = 0; i < length; i += packetSize)
+		Bm_PatternFill(&Pattern_Buffer[i], packetSize);
+	for (i = 0; i < length; i += packetSize)
+		Bm_PatternStampKey(&Pattern_Buffer[i], key++);
+
+	for (i = 0; i < length; i += packetSize)
+	{
+		Legacy_FillBuffer(&Pattern_Legacy[i], packetSize);
+		Pattern_Legacy[i + 1] = legacyKey++;
+	}
+
+	if (memcmp(Pattern_Buffer, Pattern_Legacy, length) != 0)
+	{
+		printf("size %u: table pattern differs from the byte loop\n", packetSize);
+		return false;
+	}
+
+	errors = KBench_VerifyData(Pattern_Buffer, length, packetSize);
+	if (errors)
+	{
+		printf("size %u: %d packets failed VerifyData\n", packetSize, errors);
+		return false;
+	}
+	return true;
+}
+
+static inline uint64_t Pattern_Ticks(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#define PATTERN_TIME(name, loops, statement)							\
+	do {																\
+		uint64_t start, ticks;											\
+		uint32_t n;														\
+		start = Pattern_Ticks();										\
+		for (n = 0; n < (loops); n++) { statement; }					\
+		ticks = Pattern_Ticks() - start;								\
+		printf("  %-28s %10.1f\n", name, (double)ticks / (loops));		\
+	} while(0)
+
+int main(int argc, char* argv[])
+{
+	volatile uint8_t key = 0;
+	uint16_t timeSize = 512;
+	uint32_t loops = 200000;
+	uint8_t* packet = Pattern_Buffer;
+	bool success = true;
+	uint16_t size;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "size=", 5))
+			timeSize = (uint16_t)strtoul(argv[i] + 5, NULL, 0);
+		else if (!strncmp(argv[i], "loops=", 6))
+			loops = (uint32_t)strtoul(argv[i] + 6, NULL, 0);
+		else
+		{
+			printf("Usage: pattern_sim [size=<packet size>] [loops=<count>]\n");
+			return 1;
+		}
+	}
+	if (timeSize < 2 || timeSize > PATTERN_SIM_MAX_SIZE || !loops)
+	{
+		printf("size must be 2-%u\n", PATTERN_SIM_MAX_SIZE);
+		return 1;
+	}
+
+	for (size = 8; size <= PATTERN_SIM_MAX_SIZE; size++)
+		success &= Pattern_Verify(size);
+	printf("pattern: sizes 8-%u, %u packets each: %s\n",
+	       PATTERN_SIM_MAX_SIZE, PATTERN_SIM_PACKETS, success ? "bit-exact" : "FAILED");
+
+	printf("%u byte packet, %s per packet:\n", timeSize,
+#if defined(__i386__) || defined(__x86_64__)
+	       "cycles"
+#else
+	       "ns"
+#endif
+	      );
+	PATTERN_TIME("byte loop fill + byte key", loops,
+	             Legacy_FillBuffer(packet, timeSize); packet[1] = key++; __asm__ volatile("" ::: "memory"));
+	PATTERN_TIME("table fill + word key", loops,
+	             Bm_PatternFill(packet, timeSize); Bm_PatternStampKey(packet, key++); __asm__ volatile("" ::: "memory"));
+	PATTERN_TIME("prefilled, byte key", loops,
+	             packet[1] = key++; __asm__ volatile("" ::: "memory"));
+	PATTERN_TIME("prefilled, word key", loops,
+	             Bm_PatternStampKey(packet, key++); __asm__ volatile("" ::: "memory"));
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,788 @@
+/*! udd_sim.c
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include "udd_sim.h"
+#include "udc.h"
+#include "udc_desc.h"
+
+//! Endpoint job and host side state.
+typedef struct
+{
+	bool allocated;
+	bool halted;
+	bool busy;
+	bool b_send_zlp;
+	uint8_t *buf;
+	iram_size_t buf_size;
+	iram_size_t nb_trans;
+	udd_callback_trans_t call_trans;
+
+	//! Next OUT sequence number sent / IN sequence number expected by the host.
+	uint8_t seq;
+	bool seq_valid;
+
+	//! Latency mode; next OUT stamp sequence number.
+	unsigned int latency_seq;
+
+	//! Bytes moved in the current 1ms frame.
+	uint32_t frame_bytes;
+
+	udd_sim_ep_stats_t stats;
+} udd_sim_ep_t;
+
+typedef enum
+{
+	UDD_SIM_CTRL_SETUP,
+	UDD_SIM_CTRL_DATA,
+	UDD_SIM_CTRL_STATUS,
+} udd_sim_ctrl_stage_t;
+
+//! Host side of a control transfer.
+typedef struct
+{
+	uint8_t *data;
+	//! Data stage bytes moved and the position in the device's payload buffer.
+	uint16_t nb_trans;
+	uint16_t pos;
+
+	//! Control mode; stage of the transfer on the bus and the bus time it started at.
+	udd_sim_ctrl_stage_t stage;
+	uint32_t start_us;
+	udd_sim_ep_stats_t stats;
+} udd_sim_ctrl_t;
+
+volatile bool udd_sim_irq_enabled = false;
+volatile bool udd_sim_sleeping = false;
+volatile uint32_t udd_sim_gpio = 0;
+volatile uint32_t udd_sim_gpio_toggles = 0;
+
+udd_ctrl_request_t udd_g_ctrlreq;
+
+static udd_sim_config_t udd_sim_cfg;
+static udd_sim_ep_t udd_sim_ep[USB_DEVICE_MAX_EP];
+static udd_sim_ctrl_t udd_sim_ctrl;
+COMPILER_WORD_ALIGNED static uint8_t udd_sim_ctrl_data[UDD_SIM_MAX_CONTROL_LENGTH];
+
+static bool udd_sim_attached;
+static uint8_t udd_sim_address;
+static uint32_t udd_sim_intervals;
+static uint32_t udd_sim_cpu_credit;
+static uint32_t udd_sim_cpu_steps;
+static uint32_t udd_sim_sleep_steps;
+static uint32_t udd_sim_interval_used;
+static uint8_t udd_sim_bulk_next;
+static BM_LATENCY_CLOCK udd_sim_latency_clock;
+static uint8_t udd_sim_ctrl_max;
+
+#define udd_sim_is_in(ptr)		(((ptr)->stats.ep & USB_EP_DIR_IN) ? true : false)
+#define udd_sim_is_bulk(ptr)	((ptr)->allocated && (ptr)->stats.type == USB_EP_TYPE_BULK)
+
+static udd_sim_ep_t *udd_sim_get_ep(udd_ep_id_t ep)
+{
+	ep &= USB_EP_ADDR_MASK;
+	if (ep == 0 || ep > USB_DEVICE_MAX_EP)
+		return NULL;
+	return &udd_sim_ep[ep - 1];
+}
+
+//! Runs the firmware main loop for the time it takes to move \a bytes on the bus.
+static void udd_sim_elapse(uint32_t bytes)
+{
+	udd_sim_interval_used += bytes;
+	udd_sim_cpu_credit += bytes * udd_sim_cfg.task_steps;
+	while (udd_sim_cpu_credit >= udd_sim_cfg.bus_bytes) {
+		udd_sim_cpu_credit -= udd_sim_cfg.bus_bytes;
+		udd_sim_cpu_steps++;
+		if (udd_sim_sleeping)
+			udd_sim_sleep_steps++;
+		else if (udd_sim_cfg.task)
+			udd_sim_cfg.task();
+	}
+}
+
+//! Every simulated interrupt ends a sleep; see include/sleepmgr.h.
+static void udd_sim_interrupt(void)
+{
+	udd_sim_sleeping = false;
+}
+
+//! Latency mode host clock; the bus time \a bytes after what the current interval has used.
+static uint32_t udd_sim_now_us(uint32_t bytes)
+{
+	uint32_t interval_us = udd_sim_cfg.high_speed ? 125 : 1000;
+	uint32_t used = Min(udd_sim_interval_used + bytes, udd_sim_cfg.bus_bytes);
+
+	return (uint32_t)(udd_sim_intervals * interval_us) + (used * interval_us) / udd_sim_cfg.bus_bytes;
+}
+
+//! Counts a buffer passed to the device; see udd_sim_ep_stats_t.
+static void udd_sim_track_buffer(udd_sim_ep_stats_t *stats, void *buf)
+{
+	uint8_t i;
+
+	for (i = 0; i < stats->buffer_count; i++) {
+		if (stats->buffers[i].buffer == buf)
+			break;
+	}
+	if (i < UDD_SIM_MAX_BUFFERS) {
+		if (i == stats->buffer_count) {
+			stats->buffers[i].buffer = buf;
+			stats->buffer_count++;
+		}
+		stats->buffers[i].submitted++;
+	}
+}
+
+static void udd_sim_finish_job(udd_sim_ep_t *ptr, udd_ep_status_t status)
+{
+	udd_callback_trans_t call_trans = ptr->call_trans;
+
+	ptr->busy = false;
+	udd_sim_interrupt();
+	if (status == UDD_EP_TRANSFER_OK) {
+		ptr->stats.transfers++;
+		ptr->stats.bytes += ptr->nb_trans;
+	} else {
+		ptr->stats.aborted++;
+	}
+	if (call_trans)
+		call_trans(status, ptr->nb_trans);
+}
+
+//! Payload of the next packet of the job on \a ptr.
+static uint16_t udd_sim_packet_size(udd_sim_ep_t *ptr)
+{
+	iram_size_t remaining = ptr->buf_size - ptr->nb_trans;
+	return (remaining < ptr->stats.size) ? (uint16_t)remaining : ptr->stats.size;
+}
+
+//! Moves one packet of the job on \a ptr and raises its completion.
+static void udd_sim_transfer_packet(udd_sim_ep_t *ptr, uint16_t n)
+{
+	uint8_t *packet = &ptr->buf[ptr->nb_trans];
+	bool b_done;
+
+	if (udd_sim_cfg.latency) {
+		if (udd_sim_is_in(ptr)) {
+			BmLatency_Echo(&ptr->stats.latency, &udd_sim_latency_clock, packet, n,
+					ptr->stats.size, udd_sim_now_us(n + udd_sim_cfg.packet_overhead));
+		} else {
+			BmLatency_Stamp(packet, n, ptr->stats.size, &ptr->latency_seq, udd_sim_now_us(0));
+		}
+	} else if (n >= 2) {
+		if (udd_sim_is_in(ptr)) {
+			if (ptr->seq_valid && packet[1] != ptr->seq)
+				ptr->stats.seq_errors++;
+			ptr->seq = packet[1] + 1;
+			ptr->seq_valid = true;
+		} else {
+			packet[0] = 0;
+			packet[1] = ptr->seq++;
+		}
+	}
+	ptr->nb_trans += n;
+	ptr->frame_bytes += n;
+	if (ptr->frame_bytes > ptr->stats.max_frame_bytes)
+		ptr->stats.max_frame_bytes = ptr->frame_bytes;
+
+	udd_sim_elapse(n + udd_sim_cfg.packet_overhead);
+	if (!ptr->busy)
+		return;	// Aborted by the main loop meanwhile
+
+	if (udd_sim_is_in(ptr)) {
+		b_done = (ptr->nb_trans >= ptr->buf_size);
+		if (b_done && ptr->b_send_zlp && n == ptr->stats.size) {
+			ptr->b_send_zlp = false;
+			b_done = false;
+		}
+	} else {
+		// The host always sends full packets; a short one ends the transfer.
+		b_done = (ptr->nb_trans >= ptr->buf_size) || (n < ptr->stats.size);
+	}
+	if (b_done)
+		udd_sim_finish_job(ptr, UDD_EP_TRANSFER_OK);
+}
+
+static bool udd_sim_is_due(udd_sim_ep_t *ptr)
+{
+	uint8_t interval = ptr->stats.interval ? ptr->stats.interval : 1;
+	uint32_t period;
+
+	if (udd_sim_cfg.high_speed || ptr->stats.type == USB_EP_TYPE_ISOCHRONOUS)
+		period = 1UL << (Min(interval, 16) - 1);
+	else
+		period = interval;
+
+	return (udd_sim_intervals % period) == 0;
+}
+
+//! Services a periodic endpoint; one packet or an empty slot.
+static uint16_t udd_sim_service_periodic(udd_sim_ep_t *ptr)
+{
+	uint16_t n;
+
+	ptr->stats.slots++;
+	if (ptr->busy) {
+		n = udd_sim_packet_size(ptr);
+		udd_sim_transfer_packet(ptr, n);
+		return n + udd_sim_cfg.packet_overhead;
+	}
+
+	ptr->stats.idle_slots++;
+	if (ptr->stats.type == USB_EP_TYPE_ISOCHRONOUS && !udd_sim_is_in(ptr)) {
+		// The host sends the packet anyway; it is lost.
+		ptr->seq++;
+		udd_sim_elapse(ptr->stats.size + udd_sim_cfg.packet_overhead);
+		return ptr->stats.size + udd_sim_cfg.packet_overhead;
+	}
+	udd_sim_elapse(udd_sim_cfg.packet_overhead);
+	return udd_sim_cfg.packet_overhead;
+}
+
+//! Next bulk endpoint with a job (round-robin) or NULL.
+static udd_sim_ep_t *udd_sim_next_bulk(void)
+{
+	uint8_t i, ep;
+
+	for (i = 0; i < USB_DEVICE_MAX_EP; i++) {
+		ep = (udd_sim_bulk_next + i) % USB_DEVICE_MAX_EP;
+		if (udd_sim_is_bulk(&udd_sim_ep[ep]) && udd_sim_ep[ep].busy) {
+			udd_sim_bulk_next = (ep + 1) % USB_DEVICE_MAX_EP;
+			return &udd_sim_ep[ep];
+		}
+	}
+	return NULL;
+}
+
+void udd_sim_init(const udd_sim_config_t *config)
+{
+	udd_sim_cfg = *config;
+	if (!udd_sim_cfg.bus_bytes)
+		udd_sim_cfg.bus_bytes = 1;
+
+	memset(udd_sim_ep, 0, sizeof(udd_sim_ep));
+	memset(&udd_g_ctrlreq, 0, sizeof(udd_g_ctrlreq));
+	udd_sim_attached = false;
+	udd_sim_address = 0;
+	udd_sim_intervals = 0;
+	udd_sim_cpu_credit = 0;
+	udd_sim_cpu_steps = 0;
+	udd_sim_sleep_steps = 0;
+	udd_sim_sleeping = false;
+	udd_sim_interval_used = 0;
+	udd_sim_bulk_next = 0;
+	memset(&udd_sim_latency_clock, 0, sizeof(udd_sim_latency_clock));
+
+	memset(&udd_sim_ctrl, 0, sizeof(udd_sim_ctrl));
+	udd_sim_ctrl.stats.ep = (udd_sim_cfg.control_request_type & USB_REQ_DIR_IN) ? USB_EP_DIR_IN : 0;
+	udd_sim_ctrl.stats.type = USB_EP_TYPE_CONTROL;
+	udd_sim_ctrl.stats.size = USB_DEVICE_EP_CTRL_SIZE;
+	if (udd_sim_cfg.control_length > UDD_SIM_MAX_CONTROL_LENGTH)
+		udd_sim_cfg.control_length = UDD_SIM_MAX_CONTROL_LENGTH;
+
+	udd_sim_ctrl_max = udd_sim_cfg.high_speed ? UDD_SIM_CTRL_HS_TRANSACTIONS : UDD_SIM_CTRL_FS_TRANSACTIONS;
+	if (!udd_sim_cfg.control_cost)
+		udd_sim_cfg.control_cost = Max(udd_sim_cfg.bus_bytes / udd_sim_ctrl_max, 1);
+}
+
+void udd_sim_reset(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < USB_DEVICE_MAX_EP; i++) {
+		if (udd_sim_ep[i].busy)
+			udd_sim_finish_job(&udd_sim_ep[i], UDD_EP_TRANSFER_ABORT);
+	}
+	udd_sim_address = 0;
+	udc_reset();
+}
+
+//! SETUP stage; false if the device stalled the request.
+static bool udd_sim_ctrl_setup(udd_sim_ctrl_t *ctrl, uint8_t bmRequestType, uint8_t bRequest,
+		uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data)
+{
+	ctrl->data = data;
+	ctrl->nb_trans = 0;
+	ctrl->pos = 0;
+	udd_sim_interrupt();
+
+	udd_g_ctrlreq.req.bmRequestType = bmRequestType;
+	udd_g_ctrlreq.req.bRequest = bRequest;
+	udd_g_ctrlreq.req.wValue = wValue;
+	udd_g_ctrlreq.req.wIndex = wIndex;
+	udd_g_ctrlreq.req.wLength = wLength;
+	udd_g_ctrlreq.payload = NULL;
+
+	return udc_process_setup();
+}
+
+//! Moves the next data stage packet.
+//! \return its payload, 0 at the end of the data stage or -1 if the device stalled.
+static int udd_sim_ctrl_packet(udd_sim_ctrl_t *ctrl)
+{
+	uint16_t wLength = udd_g_ctrlreq.req.wLength;
+	uint16_t n;
+
+	if (ctrl->nb_trans >= wLength)
+		return 0;
+	udd_sim_interrupt();
+
+	if (ctrl->pos >= udd_g_ctrlreq.payload_size) {
+		// The USBB driver ends an IN data stage with the payload buffer.
+		if (Udd_setup_is_in())
+			return 0;
+		// Buffer full; the device must give another one or stall.
+		udd_g_ctrlreq.payload_size = ctrl->pos;
+		if (!udd_g_ctrlreq.over_under_run || !udd_g_ctrlreq.over_under_run())
+			return -1;
+		ctrl->pos = 0;
+		if (!udd_g_ctrlreq.payload_size)
+			return -1;
+	}
+
+	n = Min(udd_g_ctrlreq.payload_size - ctrl->pos, wLength - ctrl->nb_trans);
+	n = Min(n, USB_DEVICE_EP_CTRL_SIZE);
+	if (Udd_setup_is_in())
+		memcpy(&ctrl->data[ctrl->nb_trans], &udd_g_ctrlreq.payload[ctrl->pos], n);
+	else
+		memcpy(&udd_g_ctrlreq.payload[ctrl->pos], &ctrl->data[ctrl->nb_trans], n);
+	ctrl->pos += n;
+	ctrl->nb_trans += n;
+	return n;
+}
+
+//! Status stage; false if the device stalled it.
+static bool udd_sim_ctrl_status(udd_sim_ctrl_t *ctrl)
+{
+	udd_sim_interrupt();
+	if (Udd_setup_is_out() && udd_g_ctrlreq.req.wLength) {
+		// The USBB driver reports the end of an OUT data stage through
+		// over_under_run too.
+		udd_g_ctrlreq.payload_size = ctrl->pos;
+		if (udd_g_ctrlreq.over_under_run && !udd_g_ctrlreq.over_under_run())
+			return false;
+	}
+
+	if (udd_g_ctrlreq.callback)
+		udd_g_ctrlreq.callback();
+	return true;
+}
+
+bool udd_sim_control(uint8_t bmRequestType, uint8_t bRequest,
+		uint16_t wValue, uint16_t wIndex, uint16_t wLength,
+		uint8_t *data, uint16_t *transferred)
+{
+	udd_sim_ctrl_t ctrl;
+	int n;
+
+	if (transferred)
+		*transferred = 0;
+
+	if (!udd_sim_ctrl_setup(&ctrl, bmRequestType, bRequest, wValue, wIndex, wLength, data))
+		return false;
+
+	while ((n = udd_sim_ctrl_packet(&ctrl)) > 0)
+		;
+	if (n < 0)
+		return false;
+
+	if (transferred)
+		*transferred = ctrl.nb_trans;
+
+	return udd_sim_ctrl_status(&ctrl);
+}
+
+//! Control mode; runs the host's control transfers in \a budget bus bytes.
+//! Every transaction costs control_cost; at most udd_sim_ctrl_max run.
+//! \return the bus bytes used.
+static uint16_t udd_sim_run_control(uint16_t budget)
+{
+	udd_sim_ctrl_t *ctrl = &udd_sim_ctrl;
+	uint16_t cost = udd_sim_cfg.control_cost;
+	uint16_t used = 0;
+	uint8_t transactions = 0;
+	int n;
+
+	while (transactions < udd_sim_ctrl_max && cost <= budget - used) {
+		switch (ctrl->stage) {
+		case UDD_SIM_CTRL_SETUP:
+			ctrl->start_us = udd_sim_now_us(0);
+			ctrl->stats.slots++;
+			if (udd_sim_ctrl_setup(ctrl, udd_sim_cfg.control_request_type, udd_sim_cfg.control_request,
+					0, udd_sim_cfg.control_index, udd_sim_cfg.control_length, udd_sim_ctrl_data)) {
+				ctrl->stage = UDD_SIM_CTRL_DATA;
+				udd_sim_track_buffer(&ctrl->stats, udd_g_ctrlreq.payload);
+			} else {
+				ctrl->stats.aborted++;
+			}
+			break;
+
+		case UDD_SIM_CTRL_DATA:
+			n = udd_sim_ctrl_packet(ctrl);
+			if (n == 0) {
+				// The status stage takes this transaction.
+				ctrl->stage = UDD_SIM_CTRL_STATUS;
+				continue;
+			}
+			if (n < 0) {
+				// The stalled packet is a handshake.
+				ctrl->stats.aborted++;
+				ctrl->stage = UDD_SIM_CTRL_SETUP;
+			}
+			break;
+
+		default:
+			ctrl->stage = UDD_SIM_CTRL_SETUP;
+			if (!udd_sim_ctrl_status(ctrl)) {
+				ctrl->stats.aborted++;
+				break;
+			}
+			ctrl->stats.transfers++;
+			ctrl->stats.bytes += ctrl->nb_trans;
+			BmLatency_Add(&ctrl->stats.latency.RoundTrip,
+					(long long)udd_sim_now_us(cost) - ctrl->start_us);
+			break;
+		}
+
+		udd_sim_elapse(cost);
+		used += cost;
+		transactions++;
+	}
+	return used;
+}
+
+bool udd_sim_enumerate(void)
+{
+	COMPILER_WORD_ALIGNED uint8_t desc[512];
+	uint16_t nb_trans;
+
+	udd_sim_reset();
+
+	if (!udd_sim_control(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_DEVICE << 8, 0, sizeof(usb_dev_desc_t), desc, &nb_trans)
+			|| nb_trans != sizeof(usb_dev_desc_t))
+		return false;
+
+	if (!udd_sim_control(USB_REQ_DIR_OUT, USB_REQ_SET_ADDRESS,
+			1, 0, 0, NULL, NULL) || udd_sim_address != 1)
+		return false;
+
+	if (!udd_sim_control(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_CONFIGURATION << 8, 0, sizeof(desc), desc, &nb_trans)
+			|| nb_trans < sizeof(usb_conf_desc_t))
+		return false;
+
+	return udd_sim_control(USB_REQ_DIR_OUT, USB_REQ_SET_CONFIGURATION,
+			((usb_conf_desc_t*)desc)->bConfigurationValue, 0, 0, NULL, NULL);
+}
+
+void udd_sim_run_interval(void)
+{
+	uint16_t budget = udd_sim_cfg.bus_bytes;
+	uint16_t cost, poll_cost = 0;
+	udd_sim_ep_t *ptr;
+	uint8_t i;
+
+	udd_sim_interval_used = 0;
+	if (!udd_sim_cfg.high_speed || (udd_sim_intervals & 7) == 0) {
+		for (i = 0; i < USB_DEVICE_MAX_EP; i++)
+			udd_sim_ep[i].frame_bytes = 0;
+		BmLatency_SetFrameStart(&udd_sim_latency_clock, (uint32_t)udd_sim_time_us(),
+				udd_sim_cfg.high_speed ? (udd_sim_intervals >> 3) : udd_sim_intervals);
+	}
+
+	// SOF/MSOF interrupts; the same events the USBB driver raises.
+	if (udd_sim_attached) {
+		udd_sim_interrupt();
+		if (!udd_sim_cfg.high_speed || (udd_sim_intervals & 7) == 0) {
+			if (!udd_sim_cfg.high_speed)
+				udc_sof_notify();
+#ifdef UDC_SOF_EVENT
+			UDC_SOF_EVENT();
+#endif
+		} else {
+			udc_sof_notify();
+		}
+	}
+
+	// Periodic endpoints first
+	for (i = 0; i < USB_DEVICE_MAX_EP; i++) {
+		ptr = &udd_sim_ep[i];
+		if (!ptr->allocated || ptr->halted || udd_sim_is_bulk(ptr))
+			continue;
+		if (!udd_sim_is_due(ptr))
+			continue;
+		cost = udd_sim_service_periodic(ptr);
+		budget -= Min(cost, budget);
+	}
+
+	// Control transfers are scheduled ahead of bulk. (USB 2.0 5.5.4)
+	if (udd_sim_cfg.control && udd_sim_attached)
+		budget -= udd_sim_run_control(budget);
+
+	// Bulk endpoints share the rest; polls are NAK'd when no job is pending.
+	for (i = 0; i < USB_DEVICE_MAX_EP; i++) {
+		if (udd_sim_is_bulk(&udd_sim_ep[i]) && !udd_sim_ep[i].halted)
+			poll_cost = Max(poll_cost, udd_sim_ep[i].stats.size + udd_sim_cfg.packet_overhead);
+	}
+	while (poll_cost) {
+		ptr = udd_sim_next_bulk();
+		cost = ptr ? udd_sim_packet_size(ptr) + udd_sim_cfg.packet_overhead : poll_cost;
+		if (!cost)
+			cost = 1;
+		if (cost > budget)
+			break;
+
+		for (i = 0; i < USB_DEVICE_MAX_EP; i++) {
+			if (!udd_sim_is_bulk(&udd_sim_ep[i]))
+				continue;
+			udd_sim_ep[i].stats.slots++;
+			if (!udd_sim_ep[i].busy)
+				udd_sim_ep[i].stats.idle_slots++;
+		}
+		budget -= cost;
+
+		if (ptr)
+			udd_sim_transfer_packet(ptr, udd_sim_packet_size(ptr));
+		else
+			udd_sim_elapse(cost);
+	}
+
+	// Rest of the interval
+	udd_sim_elapse(budget);
+	udd_sim_intervals++;
+}
+
+uint64_t udd_sim_time_us(void)
+{
+	return (uint64_t)udd_sim_intervals * (udd_sim_cfg.high_speed ? 125 : 1000);
+}
+
+udd_sim_ep_stats_t *udd_sim_get_ep_stats(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!(ep & USB_EP_ADDR_MASK))
+		return udd_sim_cfg.control ? &udd_sim_ctrl.stats : NULL;
+	return (ptr && ptr->allocated) ? &ptr->stats : NULL;
+}
+
+void udd_sim_get_cpu_stats(uint32_t *steps, uint32_t *sleep_steps)
+{
+	*steps = udd_sim_cpu_steps;
+	*sleep_steps = udd_sim_sleep_steps;
+}
+
+/******************************************************************************
+ * udd.h API
+ *****************************************************************************/
+
+bool udd_include_vbus_monitoring(void)
+{
+	return false;
+}
+
+void udd_enable(void)
+{
+}
+
+void udd_disable(void)
+{
+	udd_sim_attached = false;
+}
+
+void udd_attach(void)
+{
+	udd_sim_attached = true;
+}
+
+void udd_detach(void)
+{
+	udd_sim_attached = false;
+}
+
+bool udd_is_high_speed(void)
+{
+	return udd_sim_cfg.high_speed;
+}
+
+void udd_set_address(uint8_t address)
+{
+	udd_sim_address = address;
+}
+
+uint8_t udd_getaddress(void)
+{
+	return udd_sim_address;
+}
+
+uint16_t udd_get_frame_number(void)
+{
+	return (uint16_t)((udd_sim_cfg.high_speed ? (udd_sim_intervals >> 3) : udd_sim_intervals) & 0x7FF);
+}
+
+//! FNUM:MFNUM, the way the USBB driver reads UDFNUM.
+uint16_t udd_get_micro_frame_number(void)
+{
+	return (uint16_t)((udd_sim_cfg.high_speed ? udd_sim_intervals : (udd_sim_intervals << 3)) & 0x3FFF);
+}
+
+void udd_send_wake_up(void)
+{
+}
+
+void udd_set_setup_payload(uint8_t *payload, uint16_t payload_size)
+{
+	udd_g_ctrlreq.payload = payload;
+	udd_g_ctrlreq.payload_size = payload_size;
+}
+
+bool udd_ep_alloc(udd_ep_id_t ep, uint8_t bmAttributes, uint16_t MaxEndpointSize)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+	uint8_t UDC_DESC_STORAGE *desc;
+
+	if (!ptr || ptr->allocated)
+		return false;
+
+	memset(ptr, 0, sizeof(*ptr));
+	ptr->allocated = true;
+	ptr->stats.ep = ep;
+	ptr->stats.type = bmAttributes & USB_EP_TYPE_MASK;
+	ptr->stats.size = MaxEndpointSize;
+
+	// bInterval is not passed to the udd; take it from the interface being enabled.
+	desc = (uint8_t UDC_DESC_STORAGE*)udc_get_interface_desc();
+	if (desc) {
+		for (desc += desc[0]; desc[0] && desc[1] != USB_DT_INTERFACE; desc += desc[0]) {
+			if (desc[1] == USB_DT_ENDPOINT && ((usb_ep_desc_t UDC_DESC_STORAGE*)desc)->bEndpointAddress == ep) {
+				ptr->stats.interval = ((usb_ep_desc_t UDC_DESC_STORAGE*)desc)->bInterval;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void udd_ep_free(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!ptr || !ptr->allocated)
+		return;
+	udd_ep_abort(ep);
+	ptr->allocated = false;
+}
+
+bool udd_ep_is_halted(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+	return ptr ? ptr->halted : false;
+}
+
+bool udd_ep_set_halt(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!ptr || !ptr->allocated)
+		return false;
+	ptr->halted = true;
+	udd_ep_abort(ep);
+	return true;
+}
+
+bool udd_ep_clear_halt(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!ptr || !ptr->allocated)
+		return false;
+	ptr->halted = false;
+	return true;
+}
+
+bool udd_ep_wait_stall_clear(udd_ep_id_t ep, udd_callback_halt_cleared_t callback)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!ptr || !ptr->allocated)
+		return false;
+	if (!ptr->halted && callback)
+		callback();
+	return true;
+}
+
+bool udd_ep_run(udd_ep_id_t ep, bool b_shortpacket,
+		uint8_t * buf, iram_size_t buf_size,
+		udd_callback_trans_t callback)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (!ptr || !ptr->allocated || ptr->halted || ptr->busy)
+		return false;
+
+	ptr->busy = true;
+	ptr->buf = buf;
+	ptr->buf_size = buf_size;
+	ptr->nb_trans = 0;
+	ptr->call_trans = callback;
+	// Same rules as the USBB driver; an IN job that is not a multiple of
+	// the endpoint size ends with a short packet anyway.
+	ptr->b_send_zlp = udd_sim_is_in(ptr) && (buf_size == 0 || (b_shortpacket && (buf_size % ptr->stats.size) == 0));
+
+	udd_sim_track_buffer(&ptr->stats, buf);
+	return true;
+}
+
+void udd_ep_abort(udd_ep_id_t ep)
+{
+	udd_sim_ep_t *ptr = udd_sim_get_ep(ep);
+
+	if (ptr && ptr->busy)
+		udd_sim_finish_job(ptr, UDD_EP_TRANSFER_ABORT);
+}
+
+#ifdef USB_DEVICE_HS_SUPPORT
+void udd_test_mode_j(void)
+{
+}
+
+void udd_test_mode_k(void)
+{
+}
+
+void udd_test_mode_se0_nak(void)
+{
+}
+
+void udd_test_mode_packet(void)
+{
+}
+#endif
@@ -0,0 +1,193 @@
+/*! udd_sim.h
+
+ - Copyright (c) 2011, Travis Lee Robinson
+ - All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Travis Lee Robinson nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL TRAVIS ROBINSON BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef UDD_SIM_H_
+#define UDD_SIM_H_
+
+#include "conf_usb.h"
+#include "udd.h"
+#include "kBench_latency.h"
+
+/******************************************************************************
+ * Simulated USB device driver (udd) for host builds of the benchmark firmware.
+ *
+ * udd_sim implements the udd.h API on the host so benchmark.c and udc.c can
+ * run unmodified. Time advances in bus intervals (a 125us microframe at
+ * high-speed, a 1ms frame at full-speed). In every interval:
+ *   - SOF/MSOF events are raised the way the USBB driver raises them.
+ *   - Periodic (iso/int) endpoints get one packet when their bInterval is due.
+ *   - Bulk endpoints share what is left of the interval's bus budget one
+ *     packet at a time (round-robin). If no bulk endpoint has a transfer
+ *     pending the host is NAK'd and the bus time is spent polling.
+ * The firmware main loop is stepped in proportion to the bus time used, so
+ * a completion callback (the DMA interrupt) is raised at the packet that
+ * finishes the transfer and the main loop sees it as soon as it would on the
+ * board.
+ *
+ * The host always has OUT data ready and always accepts IN data. Byte 1 of
+ * every OUT packet is a running sequence number; byte 1 of every IN packet is
+ * checked against the same kind of sequence. (see udd_sim_ep_stats_t)
+ *
+ * In latency mode the host acts as kBench does for the latency test instead:
+ * every OUT packet gets a kBench_latency.h stamp carrying the bus time it
+ * starts at, and every IN packet is decoded when it ends. The host frame
+ * clock is resampled at each frame start.
+ *
+ * In control mode the host repeats one control transfer back to back on the
+ * bus, ahead of the bulk endpoints. Every transaction is charged to the
+ * interval: the SETUP transaction, each data stage packet of up to
+ * USB_DEVICE_EP_CTRL_SIZE and the status stage. A control transaction
+ * carries far more protocol overhead than its payload, so it has its own
+ * cost (control_cost) whatever its length, and no more than the USB 2.0
+ * limit of UDD_SIM_CTRL_HS_TRANSACTIONS (UDD_SIM_CTRL_FS_TRANSACTIONS) run
+ * in an interval. Each transfer is timed from its SETUP packet to the end
+ * of its status stage. The data stage follows the USBB driver: an
+ * IN data stage ends with the payload buffer the device gave, an OUT data
+ * stage asks for another one with over_under_run.
+ *
+ * The firmware may sleep with sleepmgr_enter_sleep() (include/sleepmgr.h).
+ * A sleeping CPU skips its main loop iterations until the next SOF/MSOF,
+ * transfer completion or control request wakes it.
+ *****************************************************************************/
+
+//! Maximum number of distinct buffers tracked per endpoint.
+#define UDD_SIM_MAX_BUFFERS		16
+
+//! Largest control mode data stage.
+#define UDD_SIM_MAX_CONTROL_LENGTH	4096
+
+//! Most 64 byte control transactions in a microframe (high-speed) or frame
+//! (full-speed); USB 2.0 tables 5-8 and 5-7.
+#define UDD_SIM_CTRL_HS_TRANSACTIONS	31
+#define UDD_SIM_CTRL_FS_TRANSACTIONS	13
+
+typedef struct
+{
+	//! Simulate a high-speed (true) or full-speed (false) bus.
+	bool high_speed;
+
+	//! Bus bytes available to the device per interval; packet payload plus packet_overhead.
+	uint16_t bus_bytes;
+
+	//! Bus bytes charged to each packet in addition to its payload.
+	uint16_t packet_overhead;
+
+	//! Firmware main loop iterations per interval.
+	uint16_t task_steps;
+
+	//! Firmware main loop. (e.g. Bm_Task)
+	void (*task)(void);
+
+	//! Stamp OUT packets and decode IN packets as the latency test does.
+	bool latency;
+
+	//! Control mode; the request the host repeats. (wValue is 0)
+	bool control;
+	uint8_t control_request_type;
+	uint8_t control_request;
+	uint16_t control_index;
+	uint16_t control_length;
+
+	//! Control mode; bus bytes charged to each control transaction. 0 splits
+	//! bus_bytes between the most control transactions an interval allows.
+	uint16_t control_cost;
+} udd_sim_config_t;
+
+typedef struct
+{
+	void *buffer;
+	uint32_t submitted;
+} udd_sim_buffer_t;
+
+typedef struct
+{
+	uint8_t ep;
+	uint8_t type;
+	uint16_t size;
+	uint8_t interval;
+
+	//! Completed transfers and their bytes.
+	uint32_t transfers;
+	uint64_t bytes;
+	uint32_t aborted;
+
+	//! Packet slots the endpoint was offered and the slots it had no transfer pending for.
+	//! (NAK'd for bulk/int, a lost or empty packet for iso)
+	uint32_t slots;
+	uint32_t idle_slots;
+
+	//! IN packets with an unexpected sequence number (and iso OUT packets lost before them).
+	uint32_t seq_errors;
+
+	//! Most bytes moved in one 1ms frame.
+	uint32_t max_frame_bytes;
+
+	//! Latency mode only; echoed IN packets. In control mode RoundTrip holds
+	//! the control transfer times.
+	BM_LATENCY_RESULT latency;
+
+	//! Distinct buffers passed to udd_ep_run, in submit order.
+	uint8_t buffer_count;
+	udd_sim_buffer_t buffers[UDD_SIM_MAX_BUFFERS];
+} udd_sim_ep_stats_t;
+
+//! Interrupt mask state used by the host compiler.h.
+extern volatile bool udd_sim_irq_enabled;
+
+//! Set by the host sleepmgr.h; cleared by the next interrupt.
+extern volatile bool udd_sim_sleeping;
+
+void udd_sim_init(const udd_sim_config_t *config);
+
+//! Bus reset; aborts all jobs and resets the UDC.
+void udd_sim_reset(void);
+
+//! Runs a control transfer through udc_process_setup().
+//! \return false if the device stalled the request.
+bool udd_sim_control(uint8_t bmRequestType, uint8_t bRequest,
+		uint16_t wValue, uint16_t wIndex, uint16_t wLength,
+		uint8_t *data, uint16_t *transferred);
+
+//! Resets the bus, addresses and configures the device.
+bool udd_sim_enumerate(void);
+
+//! Advances the bus by one interval.
+void udd_sim_run_interval(void);
+
+//! Elapsed bus time in microseconds.
+uint64_t udd_sim_time_us(void);
+
+//! Statistics of an allocated endpoint or NULL.
+//! Endpoint 0 has the control mode transfers; stalls count as aborted.
+udd_sim_ep_stats_t *udd_sim_get_ep_stats(udd_ep_id_t ep);
+
+//! Main loop iterations the bus time allowed and how many of them the CPU slept through.
+void udd_sim_get_cpu_stats(uint32_t *steps, uint32_t *sleep_steps);
+
+#endif /* UDD_SIM_H_ */
@@ -38,9 +38,12 @@
 
 #include "Benchmark.h"
 #include "USB_Config.h"
+#include <util/atomic.h>
 
 /* Debugging */
+#if !defined(NO_SERIAL_DEBUG)
 #define SERIAL_DEBUG
+#endif
 #if defined(SERIAL_DEBUG)
 #include <LUFA/Drivers/Peripheral/Serial.h>
 #define bm_dbg printf
@@ -48,14 +51,14 @@
 #define bm_dbg(...) do {} while (0)
 #endif
 
-/* Data buffers */
-volatile uint8_t BenchmarkBuffers_INTF0[2][PP_COUNT][USBGEN_EP_SIZE_INTF0];
+/* Data buffers
+ * One packet per interface. It holds the test pattern in a read test and the
+ * packet being sent back in a loop test. */
+static uint8_t BenchmarkBuffer_INTF0[USBGEN_EP_SIZE_INTF0];
 #ifdef DUAL_INTERFACE
-volatile uint8_t BenchmarkBuffers_INTF1[2][PP_COUNT][USBGEN_EP_SIZE_INTF1];
+static uint8_t BenchmarkBuffer_INTF1[USBGEN_EP_SIZE_INTF1];
 #endif
 
-#define GetBenchmarkBuffer(IntfSuffix, Direction, IsOdd) BenchmarkBuffers_##IntfSuffix[Direction][IsOdd]
-
 #ifdef ENABLE_VENDOR_BUFFER_AND_SET_DESCRIPTOR
 uint8_t VendorBuffer[8];
 #endif
@@ -64,79 +67,68 @@ uint8_t VendorBuffer[8];
 uint16_t counter;
 
 /* Internal test variables */
-volatile uint8_t TestType_INTF0;
-volatile uint8_t PrevTestType_INTF0;
-
-volatile uint8_t FillCount_INTF0;
-volatile uint8_t NextPacketKey_INTF0;
-
+typedef struct
+{
+	const uint8_t InterfaceNumber;
+	const uint8_t OutEndpoint;
+	const uint8_t InEndpoint;
+	const Benchmark_USB_Descriptor_AltSetting_t* const AltSettings;	/* In FLASH */
+	uint8_t* const Buffer;
+
+	/* Selected alt setting, its endpoint type and wMaxPacketSize. (see Benchmark_ConfigureEndpoints) */
+	uint8_t AltSetting;
+	uint8_t EpType;
+	uint16_t EpSize;
+
+	volatile uint8_t TestType;
+	uint8_t PrevTestType;
+	uint8_t NextPacketKey;
+
+	/* Loop test; Buffer holds LoopLength bytes to send back. */
+	bool LoopPending;
+	uint16_t LoopLength;
+
+	/* Device counters; cleared by FW_SET_TEST. The SOF counts are updated from the USB interrupt. */
+	BM_STATS Stats;
+} Benchmark_Interface_t;
+
+static Benchmark_Interface_t Benchmark_Interfaces[BM_INTERFACE_COUNT] =
+{
+	{
+		.InterfaceNumber = INTF0_NUMBER,
+		.OutEndpoint     = USBGEN_EP_OUT_INTF0,
+		.InEndpoint      = USBGEN_EP_IN_INTF0,
+		.AltSettings     = Benchmark_ConfigurationDescriptor.Benchmark_Intf0,
+		.Buffer          = BenchmarkBuffer_INTF0,
+	},
 #ifdef DUAL_INTERFACE
-	volatile uint8_t TestType_INTF1;
-	volatile uint8_t PrevTestType_INTF1;
-
-	volatile uint8_t FillCount_INTF1;
-	volatile uint8_t NextPacketKey_INTF1;
+	{
+		.InterfaceNumber = INTF1_NUMBER,
+		.OutEndpoint     = USBGEN_EP_OUT_INTF1,
+		.InEndpoint      = USBGEN_EP_IN_INTF1,
+		.AltSettings     = Benchmark_ConfigurationDescriptor.Benchmark_Intf1,
+		.Buffer          = BenchmarkBuffer_INTF1,
+	},
 #endif
+};
 
-/* Externs */
-extern void BlinkUSBStatus(void);
-extern volatile uint8_t USBAlternateInterface[USB_MAX_NUM_INT];
-extern volatile uint16_t led_count;
+/* Frame number of the last SOF event */
+static uint16_t LastFrameNumber;
+static bool LastFrameNumberValid;
 
 /* Benchmark functions */
-void doBenchmarkLoop_INTF0(void);
-void doBenchmarkWrite_INTF0(void);
-void doBenchmarkRead_INTF0(void);
+static void doBenchmarkLoop(Benchmark_Interface_t* Intf);
+static void doBenchmarkWrite(Benchmark_Interface_t* Intf);
+static void doBenchmarkRead(Benchmark_Interface_t* Intf);
 
-#ifdef DUAL_INTERFACE
-	void doBenchmarkLoop_INTF1(void);
-	void doBenchmarkWrite_INTF1(void);
-	void doBenchmarkRead_INTF1(void);
-#endif
+static Benchmark_Interface_t* Benchmark_GetInterface(uint16_t InterfaceNumber);
+static bool Benchmark_ConfigureEndpoints(void);
+static void Benchmark_StartTest(Benchmark_Interface_t* Intf);
+static void Benchmark_ResetStats(Benchmark_Interface_t* Intf);
+static void Benchmark_CountNAKs(Benchmark_Interface_t* Intf);
 
 void fillBuffer(uint8_t* pBuffer, uint16_t size);
 
-/* Benchmark macros */
-#define mBenchMarkInit(IntfSuffix)				\
-{												\
-	TestType_##IntfSuffix=TEST_LOOP;			\
-	PrevTestType_##IntfSuffix=TEST_LOOP;		\
-	FillCount_##IntfSuffix=0;					\
-	NextPacketKey_##IntfSuffix=0;				\
-}
-
-#define mSetWritePacketID(BufferPtr, BufferSize, FillCount, NextPacketKey)	\
-{																			\
-	if ((BufferSize)>0)														\
-	{																		\
-		if (FillCount < 3)													\
-		{																	\
-			FillCount++;													\
-			fillBuffer((uint8_t*)BufferPtr,BufferSize);						\
-		}																	\
-		BufferPtr[1]=NextPacketKey++;										\
-	}																		\
-}
-
-// If interface #0 is iso, use an iso specific submit macro
-#if (EP_INTF0 == EP_TYPE_ISOCHRONOUS)
-	#define mSubmitTransfer_INTF0(BdtPtr, BufferLength) mBDT_SubmitIsoTransfer(BdtPtr, BufferLength)
-#else
-	#define mSubmitTransfer_INTF0(BdtPtr, BufferLength) mBDT_SubmitTransfer(BdtPtr)
-#endif
-
-// If interface #1 is iso, use an iso specific submit macro
-#if (EP_INTF1 == EP_TYPE_ISOCHRONOUS)
-	#define mSubmitTransfer_INTF1(BdtPtr, BufferLength) mBDT_SubmitIsoTransfer(BdtPtr, BufferLength)
-#else
-	#define mSubmitTransfer_INTF1(BdtPtr, BufferLength) mBDT_SubmitTransfer(BdtPtr)
-#endif
-
-#define GetBenchmarkBuffer(IntfSuffix, Direction, IsOdd) BenchmarkBuffers_##IntfSuffix[Direction][IsOdd]
-
-// Swaps byte pointers
-#define Swap(r1,r2) { pSwapBufferTemp = r1; r1 = r2; r2 = pSwapBufferTemp; }
-
 
 /** Main program entry point. This routine contains the overall program flow, including initial
  *  setup of all components and the main program loop.
@@ -192,18 +184,20 @@ void EVENT_USB_Device_Disconnect(void)
 /* Do not add debug statements or any delay to this call! */
 void EVENT_USB_Device_ConfigurationChanged(void)
 {
-	bool ConfigSuccess = true;
+	bool ConfigSuccess;
 	int i;
 
 	LEDs_SetAllLEDs(LEDMASK_BUSY);
-	// TODO: good place to call USBCBInitEP?
 
-	/* Setup Data Endpoint(s) */
-	ConfigSuccess &= Endpoint_ConfigureEndpoint(USBGEN_EP_NUM_INTF0, EP_TYPE_BULK, ENDPOINT_DIR_OUT,
-												USBGEN_EP_SIZE_INTF0_ALT0, ENDPOINT_BANK_SINGLE);
+	/* Setup Data Endpoint(s) for alt setting 0 of every interface */
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		Benchmark_Interfaces[i].AltSetting = 0;
+	}
+	ConfigSuccess = Benchmark_ConfigureEndpoints();
 
-	ConfigSuccess &= Endpoint_ConfigureEndpoint(USBGEN_EP_NUM_INTF0, EP_TYPE_BULK, ENDPOINT_DIR_IN,
-												USBGEN_EP_SIZE_INTF0_ALT0, ENDPOINT_BANK_SINGLE);
+	/* SOFs are counted for GET_STATS */
+	LastFrameNumberValid = false;
+	USB_Device_EnableSOFEvents();
 
 	while (!ConfigSuccess) {
 		LEDs_SetAllLEDs(LEDMASK_USB_ERROR);
@@ -227,8 +221,8 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 /** Event handler for the library USB Control Request reception event. */
 void EVENT_USB_Device_ControlRequest(void)
 {
-	volatile uint8_t* dataToSend = GetBenchmarkBuffer(INTF0, 1, 0);
-	
+	Benchmark_Interface_t* Intf;
+
 	bm_dbg("Ctrl=%x\r\n", USB_ControlRequest.bRequest);
 
 	/* Process General control requests */
@@ -236,27 +230,189 @@ void EVENT_USB_Device_ControlRequest(void)
 		case REQ_SetInterface:
 			/* Set Interface is not handled by the library, as its function is application-specific */
 			if (USB_ControlRequest.bmRequestType == (REQDIR_HOSTTODEVICE | REQTYPE_STANDARD | REQREC_INTERFACE)) {
+				/* Unknown interfaces and alt settings are left to the library, which stalls them */
+				Intf = Benchmark_GetInterface(USB_ControlRequest.wIndex);
+				if (!Intf || USB_ControlRequest.wValue >= BM_ALTSETTING_COUNT) {
+					break;
+				}
+
 				Endpoint_ClearSETUP();
+				Intf->AltSetting = USB_ControlRequest.wValue;
+				if (!Benchmark_ConfigureEndpoints()) {
+					bm_dbg("SetInt failed\r\n");
+				}
 				Endpoint_ClearStatusStage();
-				bm_dbg("SetInt=%x\r\n", USB_ControlRequest.wIndex);
+				bm_dbg("SetInt=%x Alt=%x\r\n", USB_ControlRequest.wIndex, USB_ControlRequest.wValue);
+			}
+			break;
+		case REQ_GetInterface:
+			if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_STANDARD | REQREC_INTERFACE)) {
+				Intf = Benchmark_GetInterface(USB_ControlRequest.wIndex);
+				if (!Intf) {
+					break;
+				}
+
+				Endpoint_ClearSETUP();
+				Endpoint_Write_Control_Stream_LE(&Intf->AltSetting, 1);
+				Endpoint_ClearOUT();
 			}
 			break;
 		case FW_SET_TEST:
-			// TODO: is REQDIR_DEVICETOHOST expected here?
-			if (USB_ControlRequest.bmRequestType & REQTYPE_VENDOR) {
-				TestType_INTF0 = USB_ControlRequest.wValue & 0xff;
-			
+		case FW_GET_TEST:
+			if ((USB_ControlRequest.bmRequestType & (CONTROL_REQTYPE_DIRECTION | CONTROL_REQTYPE_TYPE)) == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR)) {
+				/* wIndex selects the interface; like the Microchip firmware, anything else is interface #0 */
+				Intf = Benchmark_GetInterface(USB_ControlRequest.wIndex);
+				if (!Intf) {
+					Intf = &Benchmark_Interfaces[0];
+				}
+				if (USB_ControlRequest.bRequest == FW_SET_TEST) {
+					Intf->TestType = USB_ControlRequest.wValue & 0xff;
+					Benchmark_ResetStats(Intf);
+				}
+
 				/* Write a one byte packet to acknowledge the test */
-				dataToSend[0] = TestType_INTF0;
 				Endpoint_ClearSETUP();
-				Endpoint_Write_Control_Stream_LE(&dataToSend, 1);
+				Endpoint_Write_Control_Stream_LE((const void*)&Intf->TestType, 1);
+				Endpoint_ClearOUT();
+				bm_dbg("SetTest=%d Intf=%d\r\n", Intf->TestType, Intf->InterfaceNumber);
+			}
+			break;
+		case FW_GET_STATS:
+			if ((USB_ControlRequest.bmRequestType & (CONTROL_REQTYPE_DIRECTION | CONTROL_REQTYPE_TYPE)) == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR)) {
+				BM_STATS Stats;
+
+				Intf = Benchmark_GetInterface(USB_ControlRequest.wIndex);
+				if (!Intf) {
+					Intf = &Benchmark_Interfaces[0];
+				}
+
+				/* Snapshot; the SOF event can update the counters while they are being sent */
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					Stats = Intf->Stats;
+				}
+
+				Endpoint_ClearSETUP();
+				Endpoint_Write_Control_Stream_LE(&Stats, sizeof(Stats));
 				Endpoint_ClearOUT();
-				bm_dbg("SetTest=%d\r\n", TestType_INTF0);
 			}
 			break;
 	}
 }
 
+/** Event handler for the library USB Start of Frame event; once per 1ms frame. A gap in the
+ *  frame number is a frame whose SOF interrupt was not taken.
+ */
+void EVENT_USB_Device_StartOfFrame(void)
+{
+	uint16_t FrameNumber = USB_Device_GetFrameNumber();
+	uint16_t Missed = 0;
+	uint8_t i;
+
+	if (LastFrameNumberValid && FrameNumber != LastFrameNumber) {
+		Missed = (FrameNumber - LastFrameNumber - 1) & 0x7FF;
+	}
+	LastFrameNumber = FrameNumber;
+	LastFrameNumberValid = true;
+
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		Benchmark_Interfaces[i].Stats.Sofs++;
+		Benchmark_Interfaces[i].Stats.MissedSofs += Missed;
+	}
+}
+
+static Benchmark_Interface_t* Benchmark_GetInterface(uint16_t InterfaceNumber)
+{
+	uint8_t i;
+
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		if (Benchmark_Interfaces[i].InterfaceNumber == InterfaceNumber) {
+			return &Benchmark_Interfaces[i];
+		}
+	}
+	return NULL;
+}
+
+/** Configures the data endpoints of every interface for its selected alt setting. The endpoint
+ *  type and size are read from the configuration descriptor. The AVR8 USB controller allocates
+ *  endpoint memory in endpoint order, so changing one endpoint means freeing every data endpoint
+ *  (highest first) and configuring them again in ascending order.
+ */
+static bool Benchmark_ConfigureEndpoints(void)
+{
+	bool ConfigSuccess = true;
+	const USB_Descriptor_Endpoint_t* EpDescriptor;
+	Benchmark_Interface_t* Intf;
+	uint8_t i;
+
+	for (i = USB_MAX_EP_NUMBER; i > 0; i--) {
+		Endpoint_SelectEndpoint(i);
+		Endpoint_DisableEndpoint();
+		UECFG1X &= ~(1 << ALLOC);
+	}
+
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		Intf = &Benchmark_Interfaces[i];
+		EpDescriptor = &Intf->AltSettings[Intf->AltSetting].DataOutEndpoint;
+
+		Intf->EpType = pgm_read_byte(&EpDescriptor->Attributes) & EP_TYPE_MASK;
+		Intf->EpSize = pgm_read_word(&EpDescriptor->EndpointSize);
+
+		/* Zero bandwidth alt setting; the endpoints stay disabled */
+		if (Intf->EpSize) {
+			ConfigSuccess &= Endpoint_ConfigureEndpoint(Intf->OutEndpoint, Intf->EpType, ENDPOINT_DIR_OUT,
+														Intf->EpSize, USBGEN_EP_BANKS);
+
+			ConfigSuccess &= Endpoint_ConfigureEndpoint(Intf->InEndpoint, Intf->EpType, ENDPOINT_DIR_IN,
+														Intf->EpSize, USBGEN_EP_BANKS);
+		}
+
+		Benchmark_StartTest(Intf);
+	}
+
+	return ConfigSuccess;
+}
+
+/** Restarts the selected test of an interface; called when the test or the alt setting changes. */
+static void Benchmark_StartTest(Benchmark_Interface_t* Intf)
+{
+	Intf->PrevTestType = Intf->TestType;
+	Intf->NextPacketKey = 0;
+	Intf->LoopPending = false;
+
+	/* The pattern is written once; only the packet key changes per packet */
+	if (Intf->TestType == TEST_PCREAD) {
+		fillBuffer(Intf->Buffer, Intf->EpSize);
+	}
+}
+
+static void Benchmark_ResetStats(Benchmark_Interface_t* Intf)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		memset(&Intf->Stats, 0, sizeof(Intf->Stats));
+		Intf->Stats.Length = sizeof(Intf->Stats);
+		Intf->Stats.Version = BM_STATS_VERSION;
+		Intf->Stats.Flags = BM_STATS_FLAG_SOFS | BM_STATS_FLAG_NAK_FLAGS;
+	}
+}
+
+/** The controller sets NAKOUTI/NAKINI when it NAKs the host. Each poll that finds one set counts
+ *  as a starved period of that endpoint; isochronous endpoints never NAK.
+ */
+static void Benchmark_CountNAKs(Benchmark_Interface_t* Intf)
+{
+	Endpoint_SelectEndpoint(Intf->OutEndpoint);
+	if (UEINTX & (1 << NAKOUTI)) {
+		UEINTX &= ~(1 << NAKOUTI);
+		Intf->Stats.Starved[BM_STATS_OUT]++;
+	}
+
+	Endpoint_SelectEndpoint(Intf->InEndpoint);
+	if (UEINTX & (1 << NAKINI)) {
+		UEINTX &= ~(1 << NAKINI);
+		Intf->Stats.Starved[BM_STATS_IN]++;
+	}
+}
+
 void fillBuffer(uint8_t* pBuffer, uint16_t size)
 {
 	uint8_t dataByte = 0;
@@ -266,111 +422,140 @@ void fillBuffer(uint8_t* pBuffer, uint16_t size)
 	}
 }
 
-void doBenchmarkRead_INTF0(void)
+/* Host writes; the data is discarded. */
+static void doBenchmarkRead(Benchmark_Interface_t* Intf)
 {
-	uint8_t ErrorCode;
-	volatile uint8_t* pBufferRx = GetBenchmarkBuffer(INTF0, 0, 0);
-	
-	LEDs_SetAllLEDs(LEDMASK_BUSY);
-	
-	Endpoint_SelectEndpoint(USBGEN_EP_NUM_INTF0);
+	Endpoint_SelectEndpoint(Intf->OutEndpoint);
 
-	if (!Endpoint_IsConfigured()) {
-		return;
-	}
-
-	Endpoint_SetEndpointDirection(ENDPOINT_DIR_OUT);
-	if (Endpoint_IsOUTReceived() && Endpoint_IsReadWriteAllowed()) {
-		ErrorCode = Endpoint_Read_Stream_LE((void*)pBufferRx, USBGEN_EP_SIZE_INTF0_ALT0, NULL);
-		if (ErrorCode != ENDPOINT_RWSTREAM_NoError) {
-			bm_dbg("RRerr %d\r\n", ErrorCode);
-		} else {
-//			bm_dbg("RRead %d\r\n", USBGEN_EP_SIZE_INTF0_ALT0);
-		}
+	if (Endpoint_IsOUTReceived()) {
+		LEDs_SetAllLEDs(LEDMASK_BUSY);
+		Intf->Stats.Transfers[BM_STATS_OUT]++;
+		Intf->Stats.Bytes[BM_STATS_OUT] += Endpoint_BytesInEndpoint();
 		Endpoint_ClearOUT();
+		LEDs_SetAllLEDs(LEDMASK_USB_READY);
 	}
-
-	LEDs_SetAllLEDs(LEDMASK_USB_READY);
 }
 
-void doBenchmarkWrite_INTF0(void)
+/* Host reads; every packet carries the test pattern and the next packet key. */
+static void doBenchmarkWrite(Benchmark_Interface_t* Intf)
 {
 	uint8_t ErrorCode;
-	volatile uint8_t* pBufferTx = GetBenchmarkBuffer(INTF0, 0, 0);
-	
-	LEDs_SetAllLEDs(LEDMASK_BUSY);
-	
-	Endpoint_SelectEndpoint(USBGEN_EP_NUM_INTF0);
 
-	if (!Endpoint_IsConfigured()) {
-		return;
-	}	
+	Endpoint_SelectEndpoint(Intf->InEndpoint);
 
-	Endpoint_SetEndpointDirection(ENDPOINT_DIR_IN);
-	if (Endpoint_IsINReady() && Endpoint_IsReadWriteAllowed()) {
-		ErrorCode = Endpoint_Write_Stream_LE((void*)pBufferTx, USBGEN_EP_SIZE_INTF0_ALT0, NULL);
+	if (Endpoint_IsINReady()) {
+		LEDs_SetAllLEDs(LEDMASK_BUSY);
+
+		Intf->Buffer[1] = Intf->NextPacketKey++;
+		ErrorCode = Endpoint_Write_Stream_LE(Intf->Buffer, Intf->EpSize, NULL);
 		if (ErrorCode != ENDPOINT_RWSTREAM_NoError) {
 			bm_dbg("WWerr %d\r\n", ErrorCode);
-		} else {
-//			bm_dbg("WWrote %d\r\n", USBGEN_EP_SIZE_INTF0_ALT0);
 		}
 		Endpoint_ClearIN();
-	}
+		Intf->Stats.Transfers[BM_STATS_IN]++;
+		Intf->Stats.Bytes[BM_STATS_IN] += Intf->EpSize;
 
-	LEDs_SetAllLEDs(LEDMASK_USB_READY);
+		LEDs_SetAllLEDs(LEDMASK_USB_READY);
+	}
 }
 
-
-void doBenchmarkLoop_INTF0(void)
+/* Host writes and reads; every packet received is sent back. The latency test stamps it with the
+ * frame it was received in. */
+static void doBenchmarkLoop(Benchmark_Interface_t* Intf)
 {
-	uint8_t ErrorCode;
-	volatile uint8_t* pBufferTx = GetBenchmarkBuffer(INTF0, 1, 0);
-	volatile uint8_t* pBufferRx = GetBenchmarkBuffer(INTF0, 0, 0);
-	
-	Endpoint_SelectEndpoint(USBGEN_EP_NUM_INTF0);
+	uint8_t  ErrorCode;
+	uint16_t Frame;
 
-	if (!Endpoint_IsConfigured()) {
-//		bm_dbg("NOCF\r\n");
-		return;
+	if (!Intf->LoopPending) {
+		Endpoint_SelectEndpoint(Intf->OutEndpoint);
+
+		if (!Endpoint_IsOUTReceived()) {
+			return;
+		}
+
+		Intf->LoopLength = Endpoint_BytesInEndpoint();
+		ErrorCode = Endpoint_Read_Stream_LE(Intf->Buffer, Intf->LoopLength, NULL);
+		if (ErrorCode != ENDPOINT_RWSTREAM_NoError) {
+			bm_dbg("LRerr %d\r\n", ErrorCode);
+		}
+		Endpoint_ClearOUT();
+		Intf->Stats.Transfers[BM_STATS_OUT]++;
+		Intf->Stats.Bytes[BM_STATS_OUT] += Intf->LoopLength;
+		Intf->LoopPending = true;
+
+		if (Intf->TestType == TEST_LATENCY && Intf->LoopLength >= BM_LATENCY_STAMP_LENGTH) {
+			Frame = USB_Device_GetFrameNumber() | BM_LATENCY_FRAME_STAMPED;
+			Intf->Buffer[BM_LATENCY_FRAME_OFFSET] = Frame & 0xFF;
+			Intf->Buffer[BM_LATENCY_FRAME_OFFSET + 1] = Frame >> 8;
+		}
+	}
+
+	Endpoint_SelectEndpoint(Intf->InEndpoint);
+
+	if (Endpoint_IsINReady()) {
+		ErrorCode = Endpoint_Write_Stream_LE(Intf->Buffer, Intf->LoopLength, NULL);
+		if (ErrorCode != ENDPOINT_RWSTREAM_NoError) {
+			bm_dbg("LWerr %d\r\n", ErrorCode);
+		}
+		Endpoint_ClearIN();
+		Intf->Stats.Transfers[BM_STATS_IN]++;
+		Intf->Stats.Bytes[BM_STATS_IN] += Intf->LoopLength;
+		Intf->LoopPending = false;
 	}
-	
 }
 
 void Benchmark_Init(void)
 {
-		mBenchMarkInit(INTF0);
-#ifdef DUAL_INTERFACE
-		mBenchMarkInit(INTF1);
-#endif
+	uint8_t i;
+
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		Benchmark_Interfaces[i].TestType = TEST_LOOP;
+		Benchmark_Interfaces[i].PrevTestType = TEST_LOOP;
+		Benchmark_Interfaces[i].NextPacketKey = 0;
+		Benchmark_Interfaces[i].LoopPending = false;
+		Benchmark_ResetStats(&Benchmark_Interfaces[i]);
+	}
 }
 
 void Benchmark_ProcessIO(void)
 {
+	Benchmark_Interface_t* Intf;
+	uint8_t i;
+
 	/* Device must be connected and configured for the task to run */
 	if (USB_DeviceState != DEVICE_STATE_Configured) {
 		Benchmark_Init();
 		return;
 	}
 
-	if (TestType_INTF0 != PrevTestType_INTF0)
-	{
-		FillCount_INTF0 = 0;
-		NextPacketKey_INTF0 = 0;
-		PrevTestType_INTF0 = TestType_INTF0;
-	}
+	for (i = 0; i < BM_INTERFACE_COUNT; i++) {
+		Intf = &Benchmark_Interfaces[i];
+
+		if (Intf->TestType != Intf->PrevTestType) {
+			Benchmark_StartTest(Intf);
+		}
+
+		/* Zero bandwidth alt setting */
+		if (!Intf->EpSize) {
+			continue;
+		}
+
+		switch(Intf->TestType) {
+		case TEST_PCREAD:
+			doBenchmarkWrite(Intf);
+			break;
+		case TEST_PCWRITE:
+			doBenchmarkRead(Intf);
+			break;
+		case TEST_LOOP:
+		case TEST_LATENCY:
+			doBenchmarkLoop(Intf);
+			break;
+		default:
+			doBenchmarkRead(Intf);
+			break;
+		}
 
-	switch(TestType_INTF0) {
-	case TEST_PCREAD:
-		doBenchmarkWrite_INTF0();
-		break;
-	case TEST_PCWRITE:
-		doBenchmarkRead_INTF0();
-		break;
-	case TEST_LOOP:
-//		doBenchmarkLoop_INTF0();
-		break;
-	default:
-		doBenchmarkRead_INTF0();
-		break;
+		Benchmark_CountNAKs(Intf);
 	}
 }
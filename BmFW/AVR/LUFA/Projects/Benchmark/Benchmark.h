@@ -64,17 +64,48 @@
 			TEST_NONE,
 			TEST_PCREAD,
 			TEST_PCWRITE,
-			TEST_LOOP
+			TEST_LOOP,
+			TEST_LATENCY = 0x07
 		};
 
+	/* Latency test stamp (see libusbK/src/kBench/kBench_latency.h). The loop test, with the frame the
+	 * packet was received in written to bytes 6-7 of the packet; the AVR8 controller is full-speed
+	 * only, so there is no microframe. */
+		#define BM_LATENCY_STAMP_LENGTH  8
+		#define BM_LATENCY_FRAME_OFFSET  6
+		#define BM_LATENCY_FRAME_STAMPED 0x8000
+
 		enum FW_COMMANDS
 		{
 			FW_SET_TEST		= 0x0E,
 			FW_GET_TEST		= 0x0F,
 			FW_SET_VENDOR_BUFFER= 0x10,
 			FW_GET_VENDOR_BUFFER= 0x11,
+			FW_GET_STATS		= 0x12,
 		};
 
+	/* GET_STATS counter block (see libusbK/src/kBench/kBench_stats.h); the AVR is little-endian,
+	 * so it is sent as is. */
+		#define BM_STATS_VERSION        1
+		#define BM_STATS_FLAG_SOFS      0x0001
+		#define BM_STATS_FLAG_NAK_FLAGS 0x0002
+
+		/** Transfers, Bytes and Starved index. */
+		#define BM_STATS_OUT            0
+		#define BM_STATS_IN             1
+
+		typedef struct
+		{
+			uint8_t  Length;
+			uint8_t  Version;
+			uint16_t Flags;
+			uint32_t Transfers[2];	/**< Banks handed back to the controller. */
+			uint32_t Bytes[2];
+			uint32_t Starved[2];	/**< Main loop polls that found NAKINI/NAKOUTI set. */
+			uint32_t Sofs;
+			uint32_t MissedSofs;	/**< Frame numbers skipped between two SOF events. */
+		} ATTR_PACKED BM_STATS;
+
 	/* Macros: */
 		/** LED mask for the library LED driver, to indicate that the USB interface is not ready. */
 		#define LEDMASK_USB_NOTREADY      LEDS_LED2
@@ -96,12 +127,14 @@
 
 	/* Function Prototypes: */
 		void SetupHardware(void);
+		void Benchmark_Init(void);
 		void Benchmark_ProcessIO(void);
 
 		void EVENT_USB_Device_Connect(void);
 		void EVENT_USB_Device_Disconnect(void);
-//		void EVENT_USB_Device_ConfigurationChanged(void);
+		void EVENT_USB_Device_ConfigurationChanged(void);
 		void EVENT_USB_Device_ControlRequest(void);
+		void EVENT_USB_Device_StartOfFrame(void);
 
 #endif
 
@@ -40,6 +40,60 @@
 #include "Descriptors.h"
 #include "USB_Config.h"
 
+/** Descriptors for one alt setting of a benchmark interface. */
+#define BENCHMARK_ALTSETTING(IntfNumber, AltNumber, OutEpNum, InEpNum, EpType, EpSize)		\
+	{																						\
+		.Interface =																		\
+			{																				\
+				.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},	\
+																							\
+				.InterfaceNumber        = IntfNumber,										\
+				.AlternateSetting       = AltNumber,										\
+																							\
+				.TotalEndpoints         = 2,												\
+																							\
+				.Class                  = 0x00,												\
+				.SubClass               = 0x00,												\
+				.Protocol               = 0x00,												\
+																							\
+				.InterfaceStrIndex      = NO_DESCRIPTOR										\
+			},																				\
+		.DataOutEndpoint =																	\
+			{																				\
+				.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},	\
+																							\
+				.EndpointAddress        = (ENDPOINT_DIR_OUT | (OutEpNum)),					\
+				.Attributes             = USBGEN_EP_ATTRIBUTES(EpType),						\
+				.EndpointSize           = (EpSize),											\
+				.PollingIntervalMS      = USBGEN_EP_INTERVAL(EpType)						\
+			},																				\
+		.DataInEndpoint =																	\
+			{																				\
+				.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},	\
+																							\
+				.EndpointAddress        = (ENDPOINT_DIR_IN | (InEpNum)),					\
+				.Attributes             = USBGEN_EP_ATTRIBUTES(EpType),						\
+				.EndpointSize           = (EpSize),											\
+				.PollingIntervalMS      = USBGEN_EP_INTERVAL(EpType)						\
+			}																				\
+	}
+
+/** All alt settings of a benchmark interface. (see INTERFACE_ALTSETTINGS in USB_Config.h) */
+#if defined(INTERFACE_ALTSETTINGS)
+	#define BENCHMARK_ALTSETTINGS(IntfNumber, OutEpNum, InEpNum, EpType, EpSize)							\
+	{																										\
+		BENCHMARK_ALTSETTING(IntfNumber, 0, OutEpNum, InEpNum, EpType, USBGEN_EP_SIZE_ALT0(EpType, EpSize)),	\
+		BENCHMARK_ALTSETTING(IntfNumber, 1, OutEpNum, InEpNum, EpType, EpSize),							\
+		BENCHMARK_ALTSETTING(IntfNumber, 2, OutEpNum, InEpNum, EP_TYPE_INTERRUPT, EpSize),					\
+		BENCHMARK_ALTSETTING(IntfNumber, 3, OutEpNum, InEpNum, EP_TYPE_ISOCHRONOUS, EpSize)				\
+	}
+#else
+	#define BENCHMARK_ALTSETTINGS(IntfNumber, OutEpNum, InEpNum, EpType, EpSize)							\
+	{																										\
+		BENCHMARK_ALTSETTING(IntfNumber, 0, OutEpNum, InEpNum, EpType, EpSize)							\
+	}
+#endif
+
 /** Device descriptor structure. This descriptor, located in FLASH memory, describes the overall
  *  device characteristics, including the supported USB version, control endpoint size and the
  *  number of device configurations. The descriptor is read out by the USB host when the enumeration
@@ -79,11 +133,7 @@ Benchmark_USB_Descriptor_Configuration_t PROGMEM Benchmark_ConfigurationDescript
 			.Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
 
 			.TotalConfigurationSize = sizeof(Benchmark_USB_Descriptor_Configuration_t),
-#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS)
-			.TotalInterfaces        = 1,
-#else
-			.TotalInterfaces        = 2,	// TODO: !!
-#endif
+			.TotalInterfaces        = BM_INTERFACE_COUNT,
 
 			.ConfigurationNumber    = 1,
 			.ConfigurationStrIndex  = NO_DESCRIPTOR,
@@ -93,79 +143,11 @@ Benchmark_USB_Descriptor_Configuration_t PROGMEM Benchmark_ConfigurationDescript
 			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(100)
 		},
 
-	.Benchmark_Interface_Alt0 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
-
-			.InterfaceNumber        = INTF0_NUMBER,
-			.AlternateSetting       = 0,
-
-			.TotalEndpoints         = 2,
+	.Benchmark_Intf0 = BENCHMARK_ALTSETTINGS(INTF0_NUMBER, USBGEN_EP_OUT_INTF0, USBGEN_EP_IN_INTF0, EP_INTF0, USBGEN_EP_SIZE_INTF0),
+#if defined(DUAL_INTERFACE)
 
-			.Class                  = 0x00,
-			.SubClass               = 0x00,
-			.Protocol               = 0x00,
-
-			.InterfaceStrIndex      = NO_DESCRIPTOR
-		},
-
-	.Benchmark_DataOutEndpoint_Alt0 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
-
-			.EndpointAddress        = (ENDPOINT_DIR_OUT | USBGEN_EP_NUM_INTF0),
-			.Attributes             = USBGEN_EP_ATTRIBUTES_INTF0,
-			.EndpointSize           = USBGEN_EP_SIZE_INTF0_ALT0,
-			.PollingIntervalMS      = USBGEN_EP_INTERVAL_INTF0
-		},
-
-	.Benchmark_DataInEndpoint_Alt0 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
-
-			.EndpointAddress        = (ENDPOINT_DIR_IN | USBGEN_EP_NUM_INTF0),
-			.Attributes             = USBGEN_EP_ATTRIBUTES_INTF0,
-			.EndpointSize           = USBGEN_EP_SIZE_INTF0_ALT0,
-			.PollingIntervalMS      = USBGEN_EP_INTERVAL_INTF0
-		},
-		
-#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS)		
-	.Benchmark_Interface_Alt1 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
-
-			.InterfaceNumber        = INTF0_NUMBER,
-			.AlternateSetting       = 1,
-
-			.TotalEndpoints         = 2,
-
-			.Class                  = 0x00,
-			.SubClass               = 0x00,
-			.Protocol               = 0x00,
-
-			.InterfaceStrIndex      = NO_DESCRIPTOR
-		},
-
-	.Benchmark_DataOutEndpoint_Alt1 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
-
-			.EndpointAddress        = (ENDPOINT_DIR_OUT | USBGEN_EP_NUM_INTF0),
-			.Attributes             = USBGEN_EP_ATTRIBUTES_INTF0,
-			.EndpointSize           = USBGEN_EP_SIZE_INTF0_ALT1,
-			.PollingIntervalMS      = USBGEN_EP_INTERVAL_INTF0
-		},
-
-	.Benchmark_DataInEndpoint_Alt1 =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
-
-			.EndpointAddress        = (ENDPOINT_DIR_IN | USBGEN_EP_NUM_INTF0),
-			.Attributes             = USBGEN_EP_ATTRIBUTES_INTF0,
-			.EndpointSize           = USBGEN_EP_SIZE_INTF0_ALT1,
-			.PollingIntervalMS      = USBGEN_EP_INTERVAL_INTF0
-		}		
-#endif	
+	.Benchmark_Intf1 = BENCHMARK_ALTSETTINGS(INTF1_NUMBER, USBGEN_EP_OUT_INTF1, USBGEN_EP_IN_INTF1, EP_INTF1, USBGEN_EP_SIZE_INTF1),
+#endif
 };
 
 /** Language descriptor structure. This descriptor, located in FLASH memory, is returned when the host requests
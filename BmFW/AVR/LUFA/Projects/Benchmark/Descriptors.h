@@ -44,6 +44,16 @@
 		#include "USB_Config.h"
 
 	/* Type Defines: */
+		/** Type define for one alternate setting of a benchmark interface; the interface descriptor and
+		 *  its data OUT and IN endpoints.
+		 */
+		typedef struct
+		{
+			USB_Descriptor_Interface_t               Interface;
+			USB_Descriptor_Endpoint_t                DataOutEndpoint;
+			USB_Descriptor_Endpoint_t                DataInEndpoint;
+		} Benchmark_USB_Descriptor_AltSetting_t;
+
 		/** Type define for the device configuration descriptor structure. This must be defined in the
 		 *  application code, as the configuration descriptor contains several sub-descriptors which
 		 *  vary between devices, and which describe the device's usage to the host.
@@ -51,16 +61,16 @@
 		typedef struct
 		{
 			USB_Descriptor_Configuration_Header_t    Config;
-			USB_Descriptor_Interface_t               Benchmark_Interface_Alt0;
-			USB_Descriptor_Endpoint_t                Benchmark_DataOutEndpoint_Alt0;
-			USB_Descriptor_Endpoint_t                Benchmark_DataInEndpoint_Alt0;
-#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS)
-			USB_Descriptor_Interface_t               Benchmark_Interface_Alt1;
-			USB_Descriptor_Endpoint_t                Benchmark_DataOutEndpoint_Alt1;
-			USB_Descriptor_Endpoint_t                Benchmark_DataInEndpoint_Alt1;			
+			Benchmark_USB_Descriptor_AltSetting_t    Benchmark_Intf0[BM_ALTSETTING_COUNT];
+#if defined(DUAL_INTERFACE)
+			Benchmark_USB_Descriptor_AltSetting_t    Benchmark_Intf1[BM_ALTSETTING_COUNT];
 #endif
 		} Benchmark_USB_Descriptor_Configuration_t;
 
+	/* External Variables: */
+		/** The benchmark firmware reads the endpoint type and size of the selected alt setting from here. */
+		extern Benchmark_USB_Descriptor_Configuration_t PROGMEM Benchmark_ConfigurationDescriptor;
+
 	/* Function Prototypes: */
 		uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
 		                                    const uint8_t wIndex,
@@ -0,0 +1,442 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *
+ *  Host build of the LUFA benchmark firmware. (see lufa_sim.h)
+ *
+ *  Enumerates the firmware, then for every interface, alt setting and test
+ *  selects them the way kBench does (SET_INTERFACE, then the SET_TEST vendor
+ *  request with wIndex = interface number) and runs the bus for a while.
+ *
+ *  bm_sim [test=loop|read|write|latency|all] [intf=<n>] [alt=<n>] [time=<ms>]
+ *         [bw=<bus bytes per frame>] [overhead=<bytes per packet>]
+ *         [task=<bus bytes per main loop iteration>]
+ *
+ *  The firmware's GET_STATS counters are read before and after every run,
+ *  decoded the way kBench does, and compared with what the bus moved. The
+ *  latency test also prints the latency distributions.
+ *
+ *  Exits non-zero if a transfer fails verification, an alt setting with
+ *  endpoints moves no data, the device counters disagree with the bus, a
+ *  latency test packet is reordered, not stamped or (bulk/interrupt) lost,
+ *  or endpoint memory is misallocated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Benchmark.h"
+#include "lufa_sim.h"
+#include "kBench_stats.h"
+#include "kBench_latency.h"
+
+#define BM_SIM_MAX_ALTSETTINGS		16
+
+typedef struct
+{
+	uint8_t  InterfaceNumber;
+	uint8_t  AltSetting;
+	uint8_t  EpType;
+	uint16_t EpSize;
+	uint8_t  OutEndpoint;
+	uint8_t  InEndpoint;
+} Bm_Sim_AltSetting_t;
+
+static Bm_Sim_AltSetting_t Bm_Sim_AltSettings[BM_SIM_MAX_ALTSETTINGS];
+static int Bm_Sim_AltSettingCount;
+
+static const uint8_t Bm_Sim_Tests[] = { TEST_PCREAD, TEST_PCWRITE, TEST_LOOP, TEST_LATENCY };
+static const char* const Bm_Sim_TestNames[] = { "none", "read", "write", "loop" };
+static const char* const Bm_Sim_EpTypeNames[] = { "ctrl", "iso", "bulk", "int" };
+
+static void Bm_Sim_Task(void)
+{
+	Benchmark_ProcessIO();
+	USB_USBTask();
+}
+
+/* Collects the interfaces, alt settings and data endpoints the host sees. */
+static bool Bm_Sim_ParseConfig(void)
+{
+	const USB_Descriptor_Interface_t* Interface;
+	const USB_Descriptor_Endpoint_t* Endpoint;
+	Bm_Sim_AltSetting_t* Alt = NULL;
+	const uint8_t* Config;
+	uint16_t Length;
+	uint16_t Offset;
+
+	Config = LUFA_Sim_GetConfigDescriptor(&Length);
+
+	for (Offset = 0; Offset + 2 <= Length && Config[Offset] >= 2; Offset += Config[Offset])
+	{
+		switch (Config[Offset + 1])
+		{
+		case DTYPE_Interface:
+			if (Bm_Sim_AltSettingCount == BM_SIM_MAX_ALTSETTINGS)
+				return false;
+			Interface = (const USB_Descriptor_Interface_t*)&Config[Offset];
+			Alt = &Bm_Sim_AltSettings[Bm_Sim_AltSettingCount++];
+			memset(Alt, 0, sizeof(*Alt));
+			Alt->InterfaceNumber = Interface->InterfaceNumber;
+			Alt->AltSetting = Interface->AlternateSetting;
+			break;
+		case DTYPE_Endpoint:
+			if (!Alt)
+				return false;
+			Endpoint = (const USB_Descriptor_Endpoint_t*)&Config[Offset];
+			Alt->EpType = Endpoint->Attributes & EP_TYPE_MASK;
+			Alt->EpSize = Endpoint->EndpointSize;
+			if (Endpoint->EndpointAddress & ENDPOINT_DIR_IN)
+				Alt->InEndpoint = Endpoint->EndpointAddress;
+			else
+				Alt->OutEndpoint = Endpoint->EndpointAddress;
+			break;
+		}
+	}
+
+	return Offset == Length && Bm_Sim_AltSettingCount > 0;
+}
+
+static bool Bm_Sim_Select(const Bm_Sim_AltSetting_t* Alt, uint8_t TestType)
+{
+	uint8_t Response = 0xFF;
+	uint16_t Transferred;
+
+	if (!LUFA_Sim_Control(REQDIR_HOSTTODEVICE | REQTYPE_STANDARD | REQREC_INTERFACE, REQ_SetInterface,
+	                      Alt->AltSetting, Alt->InterfaceNumber, 0, NULL, NULL))
+	{
+		printf("SET_INTERFACE %u/%u stalled\n", Alt->InterfaceNumber, Alt->AltSetting);
+		return false;
+	}
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_STANDARD | REQREC_INTERFACE, REQ_GetInterface,
+	                      0, Alt->InterfaceNumber, 1, &Response, &Transferred) ||
+	        Transferred != 1 || Response != Alt->AltSetting)
+	{
+		printf("GET_INTERFACE %u returned %u\n", Alt->InterfaceNumber, Response);
+		return false;
+	}
+
+	/* kBench Bench_SetTestType */
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_VENDOR | REQREC_DEVICE, FW_SET_TEST,
+	                      TestType, Alt->InterfaceNumber, 1, &Response, &Transferred) ||
+	        Transferred != 1 || Response != TestType)
+	{
+		printf("SET_TEST %u on interface %u failed\n", TestType, Alt->InterfaceNumber);
+		return false;
+	}
+
+	return true;
+}
+
+/* Checks one endpoint after a run; returns the number of problems found. */
+static int Bm_Sim_CheckEndpoint(const Bm_Sim_AltSetting_t* Alt, uint8_t EndpointAddress,
+                                bool Active, bool SequenceErrorsAllowed)
+{
+	LUFA_Sim_EpStats_t* Stats = LUFA_Sim_GetEpStats(EndpointAddress);
+	int Problems = 0;
+
+	if (!Alt->EpSize)
+		return Stats->Enabled ? 1 : 0;
+
+	if (!Stats->Enabled || Stats->Type != Alt->EpType || Stats->Size != Alt->EpSize)
+	{
+		printf("  %02X: configured %s/%u, descriptor says %s/%u\n", EndpointAddress,
+		       Bm_Sim_EpTypeNames[Stats->Type & EP_TYPE_MASK], Stats->Size,
+		       Bm_Sim_EpTypeNames[Alt->EpType], Alt->EpSize);
+		Problems++;
+	}
+	if (Active && !Stats->Packets)
+		Problems++;
+	if (Stats->Errors && !SequenceErrorsAllowed)
+		Problems++;
+
+	return Problems;
+}
+
+/* kBench Bench_GetStats */
+static bool Bm_Sim_GetStats(const Bm_Sim_AltSetting_t* Alt, BM_DEVICE_STATS* Stats)
+{
+	uint8_t Data[BM_STATS_LENGTH];
+	uint16_t Transferred;
+
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_VENDOR | REQREC_DEVICE, FW_GET_STATS,
+	                      0, Alt->InterfaceNumber, sizeof(Data), Data, &Transferred))
+		return false;
+	return BmStats_Decode(Stats, Data, Transferred) == 0;
+}
+
+/* The firmware counts a bank when it hands it back to the controller, so it can be one packet
+ * either side of the host. It counts a NAK flag once per main loop poll, however many NAKs
+ * set it. Every frame starts with an SOF, seen or missed. Returns the number of problems found.
+ */
+static int Bm_Sim_CheckStats(const Bm_Sim_AltSetting_t* Alt, const BM_DEVICE_STATS* Delta, uint32_t Frames)
+{
+	LUFA_Sim_EpStats_t* Ep[2];
+	int Problems = 0;
+	int Dir;
+
+	Ep[BM_STATS_OUT] = LUFA_Sim_GetEpStats(Alt->OutEndpoint);
+	Ep[BM_STATS_IN] = LUFA_Sim_GetEpStats(Alt->InEndpoint);
+
+	for (Dir = BM_STATS_OUT; Dir <= BM_STATS_IN; Dir++)
+	{
+		if (labs((long)Delta->Transfers[Dir] - (long)Ep[Dir]->Packets) > 1 ||
+		        labs((long)Delta->Bytes[Dir] - (long)Ep[Dir]->Bytes) > (long)Alt->EpSize ||
+		        Delta->Starved[Dir] > Ep[Dir]->NAKs + 1)
+			Problems++;
+	}
+
+	if (!(Delta->Flags & BM_STATS_FLAG_SOFS) || !(Delta->Flags & BM_STATS_FLAG_NAK_FLAGS) ||
+	        Delta->Sofs + Delta->MissedSofs != Frames)
+		Problems++;
+
+	return Problems;
+}
+
+static const char* Bm_Sim_TestName(uint8_t TestType)
+{
+	return (TestType == TEST_LATENCY) ? "lat" : Bm_Sim_TestNames[TestType & 3];
+}
+
+/* Every echoed packet must carry both stamps, in order; iso packets the device was not ready for
+ * are lost. The simulated clock is exact at each frame start, so one-way times are good to half a
+ * full speed frame. A round trip under twice that is not split; the others are split at the middle
+ * of the frame, so they add up to it exactly and neither exceeds it. Returns the number of
+ * problems found.
+ */
+static int Bm_Sim_CheckLatency(const BM_LATENCY_RESULT* Latency, bool Iso)
+{
+	if (!Latency->Packets || Latency->Reordered || Latency->Unstamped || (Latency->Lost && !Iso))
+		return 1;
+	if (Latency->OutLatency.Count + Latency->OneWaySkipped != Latency->Packets || Latency->RoundTrip.MinUs <= 0)
+		return 1;
+	if (Latency->ResolutionUs != 500)
+		return 1;
+
+	if (Latency->RoundTrip.MaxUs < 2 * 500 && Latency->OutLatency.Count)
+		return 1;
+	if (Latency->RoundTrip.MinUs >= 2 * 500 && Latency->OneWaySkipped)
+		return 1;
+	if (!Latency->OneWaySkipped && Latency->OutLatency.TotalUs + Latency->InLatency.TotalUs != Latency->RoundTrip.TotalUs)
+		return 1;
+	return (Latency->OutLatency.MaxUs > Latency->RoundTrip.MaxUs || Latency->InLatency.MaxUs > Latency->RoundTrip.MaxUs) ? 1 : 0;
+}
+
+static void Bm_Sim_PrintLatency(const BM_LATENCY_RESULT* Latency)
+{
+	char Line[256];
+
+	BmLatency_Format(Line, sizeof(Line), Latency);
+	printf("          Latency: %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->RoundTrip);
+	printf("            round trip     %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->OutLatency);
+	printf("            host to device %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->InLatency);
+	printf("            device to host %s\n", Line);
+}
+
+static int Bm_Sim_Run(const Bm_Sim_AltSetting_t* Alt, uint8_t TestType, uint32_t Frames)
+{
+	LUFA_Sim_EpStats_t* Out;
+	LUFA_Sim_EpStats_t* In;
+	BM_DEVICE_STATS Before, After, Delta;
+	char Line[256];
+	bool IsoLoop;
+	int Problems;
+	uint32_t i;
+
+	if (!Bm_Sim_Select(Alt, TestType))
+		return 1;
+
+	LUFA_Sim_ClearHostModes();
+	switch (TestType)
+	{
+	case TEST_PCREAD:
+		LUFA_Sim_SetHostMode(Alt->InEndpoint, LUFA_SIM_HOST_PATTERN);
+		break;
+	case TEST_PCWRITE:
+		LUFA_Sim_SetHostMode(Alt->OutEndpoint, LUFA_SIM_HOST_PATTERN);
+		break;
+	case TEST_LOOP:
+		LUFA_Sim_SetHostMode(Alt->OutEndpoint, LUFA_SIM_HOST_SEQUENCE);
+		LUFA_Sim_SetHostMode(Alt->InEndpoint, LUFA_SIM_HOST_SEQUENCE);
+		break;
+	case TEST_LATENCY:
+		LUFA_Sim_SetHostMode(Alt->OutEndpoint, LUFA_SIM_HOST_LATENCY);
+		LUFA_Sim_SetHostMode(Alt->InEndpoint, LUFA_SIM_HOST_LATENCY);
+		break;
+	}
+
+	/* Let the firmware pick up the new test before counting. */
+	LUFA_Sim_RunFrame();
+	LUFA_Sim_ResetStats();
+	if (!Bm_Sim_GetStats(Alt, &Before))
+	{
+		printf("GET_STATS on interface %u failed\n", Alt->InterfaceNumber);
+		return 1;
+	}
+	for (i = 0; i < Frames; i++)
+		LUFA_Sim_RunFrame();
+	if (!Bm_Sim_GetStats(Alt, &After))
+	{
+		printf("GET_STATS on interface %u failed\n", Alt->InterfaceNumber);
+		return 1;
+	}
+	BmStats_Delta(&Delta, &After, &Before);
+
+	/* Iso packets the device was not ready for are lost; the loop sequence has gaps. */
+	IsoLoop = ((TestType == TEST_LOOP || TestType == TEST_LATENCY) && Alt->EpType == EP_TYPE_ISOCHRONOUS);
+
+	Problems  = Bm_Sim_CheckEndpoint(Alt, Alt->OutEndpoint, TestType != TEST_PCREAD, IsoLoop);
+	Problems += Bm_Sim_CheckEndpoint(Alt, Alt->InEndpoint, TestType != TEST_PCWRITE, IsoLoop);
+	Problems += Bm_Sim_CheckStats(Alt, &Delta, Frames);
+
+	Out = LUFA_Sim_GetEpStats(Alt->OutEndpoint);
+	In = LUFA_Sim_GetEpStats(Alt->InEndpoint);
+	if (TestType == TEST_LATENCY && Alt->EpSize)
+		Problems += Bm_Sim_CheckLatency(&In->Latency, IsoLoop);
+	printf("%4u %4u  %-5s %4u  %-5s %8.1f %8.1f %7u %7u %6u %6u%s\n",
+	       Alt->InterfaceNumber, Alt->AltSetting, Bm_Sim_EpTypeNames[Alt->EpType], Alt->EpSize,
+	       Bm_Sim_TestName(TestType),
+	       (double)Out->Bytes * 1000.0 / 1024.0 / Frames,
+	       (double)In->Bytes * 1000.0 / 1024.0 / Frames,
+	       Out->NAKs + In->NAKs, Out->Missed + In->Missed, Out->Errors, In->Errors,
+	       Problems ? "  FAIL" : "");
+	BmStats_Format(Line, sizeof(Line), &Delta);
+	printf("          %s\n", Line);
+	if (TestType == TEST_LATENCY && Alt->EpSize)
+		Bm_Sim_PrintLatency(&In->Latency);
+
+	/* Leave the interface idle for the next run. */
+	LUFA_Sim_ClearHostModes();
+	Bm_Sim_Select(Alt, TEST_NONE);
+
+	return Problems;
+}
+
+int main(int argc, char** argv)
+{
+	LUFA_Sim_Config_t Config;
+	int TestType = -1;
+	int InterfaceNumber = -1;
+	int AltSetting = -1;
+	uint32_t TimeMs = 200;
+	int Failures = 0;
+	int Runs = 0;
+	int i, Test;
+
+	Config.BusBytes = 1500;
+	Config.PacketOverhead = 13;
+	Config.TaskBytes = 72;
+	Config.Task = Bm_Sim_Task;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "test=loop"))
+			TestType = TEST_LOOP;
+		else if (!strcmp(argv[i], "test=read"))
+			TestType = TEST_PCREAD;
+		else if (!strcmp(argv[i], "test=write"))
+			TestType = TEST_PCWRITE;
+		else if (!strcmp(argv[i], "test=latency"))
+			TestType = TEST_LATENCY;
+		else if (!strcmp(argv[i], "test=all"))
+			TestType = -1;
+		else if (!strncmp(argv[i], "intf=", 5))
+			InterfaceNumber = atoi(argv[i] + 5);
+		else if (!strncmp(argv[i], "alt=", 4))
+			AltSetting = atoi(argv[i] + 4);
+		else if (!strncmp(argv[i], "time=", 5))
+			TimeMs = strtoul(argv[i] + 5, NULL, 0);
+		else if (!strncmp(argv[i], "bw=", 3))
+			Config.BusBytes = (uint16_t)strtoul(argv[i] + 3, NULL, 0);
+		else if (!strncmp(argv[i], "overhead=", 9))
+			Config.PacketOverhead = (uint16_t)strtoul(argv[i] + 9, NULL, 0);
+		else if (!strncmp(argv[i], "task=", 5))
+			Config.TaskBytes = (uint16_t)strtoul(argv[i] + 5, NULL, 0);
+		else
+		{
+			printf("usage: bm_sim [test=loop|read|write|latency|all] [intf=<n>] [alt=<n>] [time=<ms>]\n"
+			       "              [bw=<bytes>] [overhead=<bytes>] [task=<bytes>]\n");
+			return 2;
+		}
+	}
+	if (!TimeMs)
+		TimeMs = 1;
+
+	LUFA_Sim_Init(&Config);
+	Benchmark_Init();
+	SetupHardware();
+
+	if (!LUFA_Sim_Enumerate() || !Bm_Sim_ParseConfig())
+	{
+		printf("enumeration failed\n");
+		return 1;
+	}
+
+	printf("intf  alt  type  size  test   out KB/s  in KB/s    naks  missed oerrs  ierrs\n");
+	for (i = 0; i < Bm_Sim_AltSettingCount; i++)
+	{
+		const Bm_Sim_AltSetting_t* Alt = &Bm_Sim_AltSettings[i];
+
+		if (InterfaceNumber >= 0 && Alt->InterfaceNumber != InterfaceNumber)
+			continue;
+		if (AltSetting >= 0 && Alt->AltSetting != AltSetting)
+			continue;
+
+		for (Test = 0; Test < (int)sizeof(Bm_Sim_Tests); Test++)
+		{
+			if (TestType >= 0 && Bm_Sim_Tests[Test] != TestType)
+				continue;
+			Failures += Bm_Sim_Run(Alt, Bm_Sim_Tests[Test], TimeMs) ? 1 : 0;
+			Runs++;
+		}
+	}
+
+	/* Alt settings past the last one must stall. */
+	if (LUFA_Sim_Control(REQDIR_HOSTTODEVICE | REQTYPE_STANDARD | REQREC_INTERFACE, REQ_SetInterface,
+	                     BM_ALTSETTING_COUNT, 0, 0, NULL, NULL))
+	{
+		printf("SET_INTERFACE to alt setting %u was accepted\n", BM_ALTSETTING_COUNT);
+		Failures++;
+	}
+	if (LUFA_Sim_MemoryConflicts())
+	{
+		printf("%u endpoint memory conflicts\n", LUFA_Sim_MemoryConflicts());
+		Failures++;
+	}
+
+	printf("%d runs, %d failed\n", Runs, Failures);
+	return Failures ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/* Host replacement for the LUFA board LED driver. (see lufa_sim.h) */
+
+#ifndef __LEDS_H__
+#define __LEDS_H__
+
+	#include <stdint.h>
+
+	#define LEDS_LED1               (1 << 0)
+	#define LEDS_LED2               (1 << 1)
+	#define LEDS_LED3               (1 << 2)
+	#define LEDS_ALL_LEDS           (LEDS_LED1 | LEDS_LED2 | LEDS_LED3)
+	#define LEDS_NO_LEDS            0
+
+	extern uint8_t LUFA_Sim_LEDs;
+
+	#define LEDs_Init()                 do { LUFA_Sim_LEDs = 0; } while (0)
+	#define LEDs_SetAllLEDs(LEDMask)    do { LUFA_Sim_LEDs = (LEDMask); } while (0)
+
+#endif
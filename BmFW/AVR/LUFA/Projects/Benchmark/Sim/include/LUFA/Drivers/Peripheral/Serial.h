@@ -0,0 +1,44 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/* Host replacement for the LUFA serial driver; printf goes to stdout. */
+
+#ifndef __SERIAL_H__
+#define __SERIAL_H__
+
+	#include <stdio.h>
+	#include <stdbool.h>
+
+	#define Serial_Init(BaudRate, DoubleSpeed)  do { (void)(BaudRate); (void)(DoubleSpeed); } while (0)
+	#define Serial_CreateStream(Stream)         do { (void)(Stream); } while (0)
+
+#endif
@@ -0,0 +1,264 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/* Host replacement for <LUFA/Drivers/USB/USB.h>.
+ *
+ * Declares the part of the LUFA 2011 device API the benchmark firmware and
+ * its descriptors use. The endpoint functions are implemented by lufa_sim.c
+ * on a simulated AVR8 USB controller. Descriptor layouts match LUFA's, so
+ * the configuration descriptor the firmware builds is the one the host sees.
+ */
+
+#ifndef __USB_H__
+#define __USB_H__
+
+	/* Includes: */
+		#include <stdint.h>
+		#include <stdbool.h>
+		#include <stddef.h>
+		#include <string.h>
+		#include <wchar.h>
+		#include <util/delay.h>
+
+	/* Attributes: */
+		#define ATTR_PACKED                     __attribute__ ((packed))
+		#define ATTR_WARN_UNUSED_RESULT         __attribute__ ((warn_unused_result))
+		#define ATTR_NON_NULL_PTR_ARG(...)      __attribute__ ((nonnull (__VA_ARGS__)))
+
+	/* Descriptor Macros: */
+		#define NO_DESCRIPTOR                   0
+		#define USB_CONFIG_POWER_MA(mA)         ((mA) >> 1)
+		#define USB_STRING_LEN(UnicodeChars)    (sizeof(USB_Descriptor_Header_t) + ((UnicodeChars) << 1))
+		#define VERSION_BCD(x)                  ((((int)((x) / 10) % 10) << 12) | (((int)(x) % 10) << 8) | \
+		                                         (((int)((x) * 10) % 10) << 4) | ((int)((x) * 100) % 10))
+		#define LANGUAGE_ID_ENG                 0x0409
+
+		#define USB_CONFIG_ATTR_BUSPOWERED      0x80
+		#define USB_CONFIG_ATTR_SELFPOWERED     0x40
+
+		#define USB_CSCP_NoDeviceClass          0x00
+		#define USB_CSCP_NoDeviceSubclass       0x00
+		#define USB_CSCP_NoDeviceProtocol       0x00
+
+		#define ENDPOINT_ATTR_NO_SYNC           (0 << 2)
+		#define ENDPOINT_ATTR_ASYNC             (1 << 2)
+		#define ENDPOINT_USAGE_DATA             (0 << 4)
+
+		enum USB_DescriptorTypes_t
+		{
+			DTYPE_Device        = 0x01,
+			DTYPE_Configuration = 0x02,
+			DTYPE_String        = 0x03,
+			DTYPE_Interface     = 0x04,
+			DTYPE_Endpoint      = 0x05,
+		};
+
+	/* Descriptor Types: */
+		typedef struct
+		{
+			uint8_t Size;
+			uint8_t Type;
+		} ATTR_PACKED USB_Descriptor_Header_t;
+
+		typedef struct
+		{
+			USB_Descriptor_Header_t Header;
+			uint16_t USBSpecification;
+			uint8_t  Class;
+			uint8_t  SubClass;
+			uint8_t  Protocol;
+			uint8_t  Endpoint0Size;
+			uint16_t VendorID;
+			uint16_t ProductID;
+			uint16_t ReleaseNumber;
+			uint8_t  ManufacturerStrIndex;
+			uint8_t  ProductStrIndex;
+			uint8_t  SerialNumStrIndex;
+			uint8_t  NumberOfConfigurations;
+		} ATTR_PACKED USB_Descriptor_Device_t;
+
+		typedef struct
+		{
+			USB_Descriptor_Header_t Header;
+			uint16_t TotalConfigurationSize;
+			uint8_t  TotalInterfaces;
+			uint8_t  ConfigurationNumber;
+			uint8_t  ConfigurationStrIndex;
+			uint8_t  ConfigAttributes;
+			uint8_t  MaxPowerConsumption;
+		} ATTR_PACKED USB_Descriptor_Configuration_Header_t;
+
+		typedef struct
+		{
+			USB_Descriptor_Header_t Header;
+			uint8_t InterfaceNumber;
+			uint8_t AlternateSetting;
+			uint8_t TotalEndpoints;
+			uint8_t Class;
+			uint8_t SubClass;
+			uint8_t Protocol;
+			uint8_t InterfaceStrIndex;
+		} ATTR_PACKED USB_Descriptor_Interface_t;
+
+		typedef struct
+		{
+			USB_Descriptor_Header_t Header;
+			uint8_t  EndpointAddress;
+			uint8_t  Attributes;
+			uint16_t EndpointSize;
+			uint8_t  PollingIntervalMS;
+		} ATTR_PACKED USB_Descriptor_Endpoint_t;
+
+		/* Build with -fshort-wchar so wide strings are UTF-16 as on the AVR. */
+		typedef struct
+		{
+			USB_Descriptor_Header_t Header;
+			wchar_t UnicodeString[];
+		} ATTR_PACKED USB_Descriptor_String_t;
+
+	/* Control Requests: */
+		typedef struct
+		{
+			uint8_t  bmRequestType;
+			uint8_t  bRequest;
+			uint16_t wValue;
+			uint16_t wIndex;
+			uint16_t wLength;
+		} ATTR_PACKED USB_Request_Header_t;
+
+		#define CONTROL_REQTYPE_DIRECTION       0x80
+		#define CONTROL_REQTYPE_TYPE            0x60
+		#define CONTROL_REQTYPE_RECIPIENT       0x1F
+
+		#define REQDIR_HOSTTODEVICE             (0 << 7)
+		#define REQDIR_DEVICETOHOST             (1 << 7)
+		#define REQTYPE_STANDARD                (0 << 5)
+		#define REQTYPE_CLASS                   (1 << 5)
+		#define REQTYPE_VENDOR                  (2 << 5)
+		#define REQREC_DEVICE                   (0 << 0)
+		#define REQREC_INTERFACE                (1 << 0)
+		#define REQREC_ENDPOINT                 (2 << 0)
+
+		enum USB_Control_Request_t
+		{
+			REQ_GetStatus           = 0,
+			REQ_ClearFeature        = 1,
+			REQ_SetFeature          = 3,
+			REQ_SetAddress          = 5,
+			REQ_GetDescriptor       = 6,
+			REQ_SetDescriptor       = 7,
+			REQ_GetConfiguration    = 8,
+			REQ_SetConfiguration    = 9,
+			REQ_GetInterface        = 10,
+			REQ_SetInterface        = 11,
+			REQ_SynchFrame          = 12,
+		};
+
+		extern USB_Request_Header_t USB_ControlRequest;
+
+	/* Device State: */
+		enum USB_Device_States_t
+		{
+			DEVICE_STATE_Unattached = 0,
+			DEVICE_STATE_Powered    = 1,
+			DEVICE_STATE_Default    = 2,
+			DEVICE_STATE_Addressed  = 3,
+			DEVICE_STATE_Configured = 4,
+			DEVICE_STATE_Suspended  = 5,
+		};
+
+		extern volatile uint8_t USB_DeviceState;
+
+		void USB_Init(void);
+		void USB_USBTask(void);
+
+		/** SOF events are raised at the start of every simulated frame once enabled. */
+		void     USB_Device_EnableSOFEvents(void);
+		void     USB_Device_DisableSOFEvents(void);
+		uint16_t USB_Device_GetFrameNumber(void);
+
+	/* Endpoints: */
+		#define ENDPOINT_CONTROLEP              0
+		#define ENDPOINT_DIR_OUT                (0 << 7)
+		#define ENDPOINT_DIR_IN                 (1 << 7)
+		#define ENDPOINT_BANK_SINGLE            (0 << 1)
+		#define ENDPOINT_BANK_DOUBLE            (1 << 1)
+
+		#define EP_TYPE_CONTROL                 0x00
+		#define EP_TYPE_ISOCHRONOUS             0x01
+		#define EP_TYPE_BULK                    0x02
+		#define EP_TYPE_INTERRUPT               0x03
+		#define EP_TYPE_MASK                    0x03
+
+		enum Endpoint_Stream_RW_ErrorCodes_t
+		{
+			ENDPOINT_RWSTREAM_NoError           = 0,
+			ENDPOINT_RWSTREAM_EndpointStalled   = 1,
+			ENDPOINT_RWSTREAM_DeviceDisconnected= 2,
+			ENDPOINT_RWSTREAM_BusSuspended      = 3,
+			ENDPOINT_RWSTREAM_Timeout           = 4,
+			ENDPOINT_RWSTREAM_IncompleteTransfer= 5,
+		};
+
+		bool Endpoint_ConfigureEndpoint(const uint8_t Number,
+		                                const uint8_t Type,
+		                                const uint8_t Direction,
+		                                const uint16_t Size,
+		                                const uint8_t Banks);
+
+		void     Endpoint_SelectEndpoint(const uint8_t EndpointNumber);
+		uint8_t  Endpoint_GetCurrentEndpoint(void);
+		bool     Endpoint_IsConfigured(void);
+		void     Endpoint_DisableEndpoint(void);
+
+		bool     Endpoint_IsINReady(void);
+		bool     Endpoint_IsOUTReceived(void);
+		bool     Endpoint_IsReadWriteAllowed(void);
+		uint16_t Endpoint_BytesInEndpoint(void);
+		void     Endpoint_ClearIN(void);
+		void     Endpoint_ClearOUT(void);
+
+		uint8_t  Endpoint_Write_Stream_LE(const void* Buffer, uint16_t Length, uint16_t* const BytesProcessed);
+		uint8_t  Endpoint_Read_Stream_LE(void* Buffer, uint16_t Length, uint16_t* const BytesProcessed);
+
+		void     Endpoint_ClearSETUP(void);
+		void     Endpoint_ClearStatusStage(void);
+		uint8_t  Endpoint_Write_Control_Stream_LE(const void* const Buffer, uint16_t Length);
+
+	/* Application Callbacks: */
+		void EVENT_USB_Device_Connect(void);
+		void EVENT_USB_Device_Disconnect(void);
+		void EVENT_USB_Device_ConfigurationChanged(void);
+		void EVENT_USB_Device_ControlRequest(void);
+		void EVENT_USB_Device_StartOfFrame(void);
+
+#endif
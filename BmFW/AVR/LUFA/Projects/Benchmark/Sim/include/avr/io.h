@@ -0,0 +1,54 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/* Host replacement for <avr/io.h> used by the benchmark simulation. (see lufa_sim.h) */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+	#include <stdint.h>
+
+	extern volatile uint8_t MCUSR;
+	#define WDRF                0
+
+	/* UECFG1X of the selected endpoint; only ALLOC is simulated. */
+	volatile uint8_t* LUFA_Sim_UECFG1X(void);
+	#define UECFG1X             (*LUFA_Sim_UECFG1X())
+	#define ALLOC               1
+
+	/* UEINTX of the selected endpoint; only the NAK flags are simulated. */
+	volatile uint8_t* LUFA_Sim_UEINTX(void);
+	#define UEINTX              (*LUFA_Sim_UEINTX())
+	#define NAKINI              6
+	#define NAKOUTI             4
+
+#endif
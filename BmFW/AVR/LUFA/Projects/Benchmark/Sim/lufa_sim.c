@@ -0,0 +1,652 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *
+ *  Simulated AVR8 USB controller and host. (see lufa_sim.h)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <LUFA/Drivers/USB/USB.h>
+#include <LUFA/Drivers/Board/LEDs.h>
+#include "Descriptors.h"
+#include "lufa_sim.h"
+
+typedef struct
+{
+	/* Controller */
+	uint8_t  Cfg1X;
+	bool     Enabled;
+	bool     Configured;
+	uint8_t  Type;
+	uint8_t  Direction;
+	uint16_t Size;
+	uint16_t Offset;
+	uint16_t Memory;		/* Size times the number of banks. */
+
+	/* The bank belongs to the firmware while BankCPU is set; for an IN endpoint
+	 * it is free to be written, for an OUT endpoint it holds a received packet. */
+	uint8_t  Bank[LUFA_SIM_MAX_EP_SIZE];
+	uint16_t Count;
+	uint16_t Position;
+	bool     BankCPU;
+	uint8_t  IntX;
+
+	/* Host */
+	uint8_t  HostMode;
+	uint8_t  Key;
+	bool     KeySeeded;
+	unsigned int LatencySeq;
+
+	LUFA_Sim_EpStats_t Stats;
+} LUFA_Sim_Endpoint_t;
+
+static struct
+{
+	LUFA_Sim_Config_t   Config;
+	LUFA_Sim_Endpoint_t Endpoints[LUFA_SIM_ENDPOINTS];
+	uint8_t  Selected;
+	uint8_t  BulkNext;
+	uint32_t Frames;
+	uint16_t FrameNumber;
+	bool     SOFEvents;
+	uint32_t TaskCredit;
+	uint32_t MemoryConflicts;
+
+	/* Latency test host clock; frames run since LUFA_Sim_Init. */
+	uint32_t ClockFrames;
+	BM_LATENCY_CLOCK LatencyClock;
+
+	bool     SetupPending;
+	uint8_t  ControlData[256];
+	uint16_t ControlLength;
+
+	uint8_t  ConfigDescriptor[256];
+	uint16_t ConfigDescriptorLength;
+} Sim;
+
+volatile uint8_t MCUSR;
+uint8_t LUFA_Sim_LEDs;
+
+USB_Request_Header_t USB_ControlRequest;
+volatile uint8_t USB_DeviceState;
+
+/* Benchmark pattern; 0..255, then 1..255 repeating. Byte 1 is the packet key. */
+static uint8_t LUFA_Sim_Pattern(uint16_t Index)
+{
+	return (Index < 256) ? (uint8_t)Index : (uint8_t)(((Index - 256) % 255) + 1);
+}
+
+#define LUFA_Sim_Allocated(Ep)	((Ep)->Cfg1X & (1 << ALLOC))
+
+/*****************************************************************************
+ * Controller
+ *****************************************************************************/
+volatile uint8_t* LUFA_Sim_UECFG1X(void)
+{
+	return &Sim.Endpoints[Sim.Selected].Cfg1X;
+}
+
+volatile uint8_t* LUFA_Sim_UEINTX(void)
+{
+	return &Sim.Endpoints[Sim.Selected].IntX;
+}
+
+void USB_Device_EnableSOFEvents(void)
+{
+	Sim.SOFEvents = true;
+}
+
+void USB_Device_DisableSOFEvents(void)
+{
+	Sim.SOFEvents = false;
+}
+
+uint16_t USB_Device_GetFrameNumber(void)
+{
+	return Sim.FrameNumber;
+}
+
+bool Endpoint_ConfigureEndpoint(const uint8_t Number,
+                                const uint8_t Type,
+                                const uint8_t Direction,
+                                const uint16_t Size,
+                                const uint8_t Banks)
+{
+	LUFA_Sim_Endpoint_t* Ep;
+	uint16_t Offset = 0;
+	uint16_t Memory = (Banks & ENDPOINT_BANK_DOUBLE) ? (Size * 2) : Size;
+	uint8_t i;
+
+	if (Number >= LUFA_SIM_ENDPOINTS)
+		return false;
+
+	/* Memory is allocated in endpoint order; a double bank endpoint takes twice its size. Data
+	 * moves through one bank either way. */
+	for (i = 0; i < Number; i++)
+	{
+		if (LUFA_Sim_Allocated(&Sim.Endpoints[i]))
+			Offset += Sim.Endpoints[i].Memory;
+	}
+	for (i = Number + 1; i < LUFA_SIM_ENDPOINTS; i++)
+	{
+		Ep = &Sim.Endpoints[i];
+		if (LUFA_Sim_Allocated(Ep) && Offset < Ep->Offset + Ep->Memory && Ep->Offset < Offset + Memory)
+		{
+			printf("endpoint %u memory overlaps endpoint %u\n", Number, i);
+			Sim.MemoryConflicts++;
+		}
+	}
+
+	Sim.Selected = Number;
+	Ep = &Sim.Endpoints[Number];
+	Ep->Cfg1X |= (1 << ALLOC);
+	Ep->Enabled = true;
+	Ep->Type = Type;
+	Ep->Direction = Direction;
+	Ep->Size = Size;
+	Ep->Offset = Offset;
+	Ep->Memory = Memory;
+	Ep->Count = 0;
+	Ep->Position = 0;
+	Ep->BankCPU = (Direction == ENDPOINT_DIR_IN);
+	Ep->Configured = (Size >= 8) && (Size <= LUFA_SIM_MAX_EP_SIZE) && !(Size & (Size - 1)) &&
+	                 (Offset + Memory <= LUFA_SIM_DPRAM_SIZE);
+
+	return Ep->Configured;
+}
+
+void Endpoint_SelectEndpoint(const uint8_t EndpointNumber)
+{
+	Sim.Selected = EndpointNumber % LUFA_SIM_ENDPOINTS;
+}
+
+uint8_t Endpoint_GetCurrentEndpoint(void)
+{
+	return Sim.Selected;
+}
+
+bool Endpoint_IsConfigured(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	return Ep->Enabled && Ep->Configured;
+}
+
+void Endpoint_DisableEndpoint(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	Ep->Enabled = false;
+	Ep->Configured = false;
+	Ep->Count = 0;
+	Ep->Position = 0;
+	Ep->BankCPU = false;
+	Ep->IntX = 0;
+}
+
+bool Endpoint_IsINReady(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	return Endpoint_IsConfigured() && Ep->Direction == ENDPOINT_DIR_IN && Ep->BankCPU;
+}
+
+bool Endpoint_IsOUTReceived(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	return Endpoint_IsConfigured() && Ep->Direction == ENDPOINT_DIR_OUT && Ep->BankCPU;
+}
+
+bool Endpoint_IsReadWriteAllowed(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (!Ep->BankCPU)
+		return false;
+	if (Ep->Direction == ENDPOINT_DIR_IN)
+		return Ep->Count < Ep->Size;
+	return Ep->Position < Ep->Count;
+}
+
+uint16_t Endpoint_BytesInEndpoint(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (Ep->Direction == ENDPOINT_DIR_IN)
+		return Ep->Count;
+	return Ep->Count - Ep->Position;
+}
+
+void Endpoint_ClearIN(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (Sim.Selected == ENDPOINT_CONTROLEP)
+		return;
+	Ep->BankCPU = false;
+}
+
+void Endpoint_ClearOUT(void)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (Sim.Selected == ENDPOINT_CONTROLEP)
+		return;
+	Ep->BankCPU = false;
+	Ep->Count = 0;
+	Ep->Position = 0;
+}
+
+uint8_t Endpoint_Write_Stream_LE(const void* Buffer, uint16_t Length, uint16_t* const BytesProcessed)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (!Ep->BankCPU || Ep->Direction != ENDPOINT_DIR_IN || Ep->Count + Length > Ep->Size)
+	{
+		printf("endpoint %u: bad write of %u bytes\n", Sim.Selected, Length);
+		Ep->Stats.Errors++;
+		return ENDPOINT_RWSTREAM_IncompleteTransfer;
+	}
+
+	memcpy(&Ep->Bank[Ep->Count], Buffer, Length);
+	Ep->Count += Length;
+	if (BytesProcessed)
+		*BytesProcessed = Length;
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t Endpoint_Read_Stream_LE(void* Buffer, uint16_t Length, uint16_t* const BytesProcessed)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[Sim.Selected];
+
+	if (!Ep->BankCPU || Ep->Direction != ENDPOINT_DIR_OUT || Ep->Position + Length > Ep->Count)
+	{
+		printf("endpoint %u: bad read of %u bytes\n", Sim.Selected, Length);
+		Ep->Stats.Errors++;
+		return ENDPOINT_RWSTREAM_IncompleteTransfer;
+	}
+
+	memcpy(Buffer, &Ep->Bank[Ep->Position], Length);
+	Ep->Position += Length;
+	if (BytesProcessed)
+		*BytesProcessed = Length;
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+void Endpoint_ClearSETUP(void)
+{
+	Sim.SetupPending = false;
+}
+
+void Endpoint_ClearStatusStage(void)
+{
+}
+
+uint8_t Endpoint_Write_Control_Stream_LE(const void* const Buffer, uint16_t Length)
+{
+	if (Length > USB_ControlRequest.wLength)
+		Length = USB_ControlRequest.wLength;
+	if (Length > sizeof(Sim.ControlData))
+		Length = sizeof(Sim.ControlData);
+
+	memcpy(Sim.ControlData, Buffer, Length);
+	Sim.ControlLength = Length;
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+void USB_Init(void)
+{
+	memset(Sim.Endpoints, 0, sizeof(Sim.Endpoints));
+	Endpoint_ConfigureEndpoint(ENDPOINT_CONTROLEP, EP_TYPE_CONTROL, ENDPOINT_DIR_OUT, 8, ENDPOINT_BANK_SINGLE);
+	USB_DeviceState = DEVICE_STATE_Powered;
+}
+
+void USB_USBTask(void)
+{
+}
+
+/*****************************************************************************
+ * Host
+ *****************************************************************************/
+void LUFA_Sim_Init(const LUFA_Sim_Config_t* Config)
+{
+	memset(&Sim, 0, sizeof(Sim));
+	Sim.Config = *Config;
+	if (!Sim.Config.TaskBytes)
+		Sim.Config.TaskBytes = 1;
+}
+
+static bool LUFA_Sim_StandardRequest(void)
+{
+	const void* Address = NULL;
+	uint16_t Size;
+
+	if ((USB_ControlRequest.bmRequestType & CONTROL_REQTYPE_TYPE) != REQTYPE_STANDARD)
+		return false;
+
+	switch (USB_ControlRequest.bRequest)
+	{
+	case REQ_GetDescriptor:
+		Size = CALLBACK_USB_GetDescriptor(USB_ControlRequest.wValue, USB_ControlRequest.wIndex, &Address);
+		if (Size == NO_DESCRIPTOR || !Address)
+			return false;
+		Endpoint_Write_Control_Stream_LE(Address, Size);
+		return true;
+	case REQ_SetAddress:
+		USB_DeviceState = DEVICE_STATE_Addressed;
+		return true;
+	case REQ_SetConfiguration:
+		if (USB_ControlRequest.wValue > FIXED_NUM_CONFIGURATIONS)
+			return false;
+		USB_DeviceState = USB_ControlRequest.wValue ? DEVICE_STATE_Configured : DEVICE_STATE_Addressed;
+		EVENT_USB_Device_ConfigurationChanged();
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool LUFA_Sim_Control(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex,
+                      uint16_t wLength, void* Data, uint16_t* Transferred)
+{
+	uint8_t PrevEndpoint = Sim.Selected;
+	bool Handled;
+
+	USB_ControlRequest.bmRequestType = bmRequestType;
+	USB_ControlRequest.bRequest = bRequest;
+	USB_ControlRequest.wValue = wValue;
+	USB_ControlRequest.wIndex = wIndex;
+	USB_ControlRequest.wLength = wLength;
+
+	Sim.SetupPending = true;
+	Sim.ControlLength = 0;
+
+	/* The library processes control requests with the control endpoint
+	 * selected and restores the previous selection afterwards. */
+	Sim.Selected = ENDPOINT_CONTROLEP;
+	EVENT_USB_Device_ControlRequest();
+	Handled = !Sim.SetupPending || LUFA_Sim_StandardRequest();
+	Sim.Selected = PrevEndpoint;
+
+	if (Transferred)
+		*Transferred = 0;
+	if (!Handled)
+		return false;
+
+	if ((bmRequestType & CONTROL_REQTYPE_DIRECTION) == REQDIR_DEVICETOHOST)
+	{
+		if (Data)
+			memcpy(Data, Sim.ControlData, Sim.ControlLength);
+		if (Transferred)
+			*Transferred = Sim.ControlLength;
+	}
+	return true;
+}
+
+bool LUFA_Sim_Enumerate(void)
+{
+	USB_Descriptor_Device_t Device;
+	USB_Descriptor_Configuration_Header_t Config;
+	uint16_t Length;
+
+	USB_DeviceState = DEVICE_STATE_Default;
+	EVENT_USB_Device_Connect();
+
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_STANDARD | REQREC_DEVICE, REQ_GetDescriptor,
+	                      (DTYPE_Device << 8), 0, sizeof(Device), &Device, &Length) || Length != sizeof(Device))
+		return false;
+	if (!LUFA_Sim_Control(REQDIR_HOSTTODEVICE | REQTYPE_STANDARD | REQREC_DEVICE, REQ_SetAddress,
+	                      1, 0, 0, NULL, NULL))
+		return false;
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_STANDARD | REQREC_DEVICE, REQ_GetDescriptor,
+	                      (DTYPE_Configuration << 8), 0, sizeof(Config), &Config, &Length) || Length != sizeof(Config))
+		return false;
+	if (Config.TotalConfigurationSize > sizeof(Sim.ConfigDescriptor))
+		return false;
+	if (!LUFA_Sim_Control(REQDIR_DEVICETOHOST | REQTYPE_STANDARD | REQREC_DEVICE, REQ_GetDescriptor,
+	                      (DTYPE_Configuration << 8), 0, Config.TotalConfigurationSize,
+	                      Sim.ConfigDescriptor, &Sim.ConfigDescriptorLength))
+		return false;
+
+	return LUFA_Sim_Control(REQDIR_HOSTTODEVICE | REQTYPE_STANDARD | REQREC_DEVICE, REQ_SetConfiguration,
+	                        Config.ConfigurationNumber, 0, 0, NULL, NULL);
+}
+
+const uint8_t* LUFA_Sim_GetConfigDescriptor(uint16_t* Length)
+{
+	*Length = Sim.ConfigDescriptorLength;
+	return Sim.ConfigDescriptor;
+}
+
+void LUFA_Sim_SetHostMode(uint8_t EndpointAddress, uint8_t Mode)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[(EndpointAddress & 0x7F) % LUFA_SIM_ENDPOINTS];
+
+	Ep->HostMode = Mode;
+	Ep->Key = 0;
+	Ep->KeySeeded = false;
+	Ep->LatencySeq = 0;
+}
+
+void LUFA_Sim_ClearHostModes(void)
+{
+	uint8_t i;
+
+	for (i = 1; i < LUFA_SIM_ENDPOINTS; i++)
+		LUFA_Sim_SetHostMode(i, LUFA_SIM_HOST_IDLE);
+}
+
+/* Lets Cost bus bytes pass; the firmware main loop runs once per TaskBytes. */
+static void LUFA_Sim_Elapse(uint16_t Cost, uint16_t* Budget)
+{
+	*Budget = (*Budget > Cost) ? (*Budget - Cost) : 0;
+
+	Sim.TaskCredit += Cost;
+	while (Sim.TaskCredit >= Sim.Config.TaskBytes)
+	{
+		Sim.TaskCredit -= Sim.Config.TaskBytes;
+		Sim.Config.Task();
+	}
+}
+
+/* Latency test host clock (us); the bus time Cost bytes after what the frame has used. */
+static unsigned int LUFA_Sim_NowUs(uint16_t Budget, uint16_t Cost)
+{
+	uint32_t Used = (uint32_t)(Sim.Config.BusBytes - Budget) + Cost;
+
+	if (Used > Sim.Config.BusBytes)
+		Used = Sim.Config.BusBytes;
+	return (unsigned int)(Sim.ClockFrames * 1000 + (Used * 1000) / Sim.Config.BusBytes);
+}
+
+static void LUFA_Sim_CheckIN(LUFA_Sim_Endpoint_t* Ep, unsigned int RecvTimeUs)
+{
+	uint16_t i;
+
+	if (Ep->HostMode == LUFA_SIM_HOST_LATENCY)
+	{
+		if (!BmLatency_Echo(&Ep->Stats.Latency, &Sim.LatencyClock, Ep->Bank, Ep->Count, Ep->Size, RecvTimeUs))
+			Ep->Stats.Errors++;
+		return;
+	}
+
+	if (Ep->Count < 2 || Ep->Count != Ep->Size)
+	{
+		Ep->Stats.Errors++;
+		return;
+	}
+
+	if (Ep->HostMode == LUFA_SIM_HOST_PATTERN)
+	{
+		/* kBench VerifyData; the first packet seeds the key. */
+		if (Ep->KeySeeded && Ep->Bank[1] != Ep->Key)
+			Ep->Stats.Errors++;
+		Ep->Key = Ep->Bank[1] + 1;
+		Ep->KeySeeded = true;
+
+		for (i = 0; i < Ep->Count; i++)
+		{
+			if (i != 1 && Ep->Bank[i] != LUFA_Sim_Pattern(i))
+			{
+				Ep->Stats.Errors++;
+				break;
+			}
+		}
+	}
+	else if (Ep->HostMode == LUFA_SIM_HOST_SEQUENCE)
+	{
+		if (Ep->Bank[1] != Ep->Key)
+			Ep->Stats.Errors++;
+		Ep->Key = Ep->Bank[1] + 1;
+	}
+}
+
+static void LUFA_Sim_Transaction(LUFA_Sim_Endpoint_t* Ep, uint16_t* Budget)
+{
+	uint16_t Cost = Sim.Config.PacketOverhead;
+	uint16_t i;
+
+	if (Ep->Enabled && Ep->Configured && !Ep->BankCPU)
+	{
+		if (Ep->Direction == ENDPOINT_DIR_IN)
+		{
+			LUFA_Sim_CheckIN(Ep, LUFA_Sim_NowUs(*Budget, Cost + Ep->Count));
+			Cost += Ep->Count;
+			Ep->Stats.Bytes += Ep->Count;
+			Ep->Count = 0;
+		}
+		else
+		{
+			for (i = 0; i < Ep->Size; i++)
+				Ep->Bank[i] = LUFA_Sim_Pattern(i);
+			Ep->Bank[1] = Ep->Key++;
+			if (Ep->HostMode == LUFA_SIM_HOST_LATENCY)
+				BmLatency_Stamp(Ep->Bank, Ep->Size, Ep->Size, &Ep->LatencySeq, LUFA_Sim_NowUs(*Budget, 0));
+			Ep->Count = Ep->Size;
+			Ep->Position = 0;
+			Cost += Ep->Size;
+			Ep->Stats.Bytes += Ep->Size;
+		}
+		Ep->Stats.Packets++;
+		Ep->BankCPU = true;
+	}
+	else if (Ep->Type == EP_TYPE_ISOCHRONOUS)
+	{
+		/* The host sends iso data whether or not the device takes it. */
+		if (Ep->Direction == ENDPOINT_DIR_OUT)
+		{
+			Ep->Key++;
+			Ep->LatencySeq = (Ep->LatencySeq + 1) & 0xFFFF;
+			Cost += Ep->Size;
+		}
+		Ep->Stats.Missed++;
+	}
+	else
+	{
+		Ep->IntX |= (Ep->Direction == ENDPOINT_DIR_IN) ? (1 << NAKINI) : (1 << NAKOUTI);
+		Ep->Stats.NAKs++;
+	}
+
+	LUFA_Sim_Elapse(Cost, Budget);
+}
+
+void LUFA_Sim_RunFrame(void)
+{
+	uint16_t Budget = Sim.Config.BusBytes;
+	LUFA_Sim_Endpoint_t* Ep;
+	bool HasBulk = false;
+	uint8_t i;
+
+	/* The SOF interrupt is always taken; the latency test host clock is resampled at every frame start. */
+	Sim.ClockFrames++;
+	BmLatency_SetFrameStart(&Sim.LatencyClock, Sim.ClockFrames * 1000, Sim.ClockFrames);
+	Sim.FrameNumber = (Sim.FrameNumber + 1) & 0x7FF;
+	if (Sim.SOFEvents)
+		EVENT_USB_Device_StartOfFrame();
+
+	/* Periodic endpoints first; bInterval is always 1. */
+	for (i = 1; i < LUFA_SIM_ENDPOINTS; i++)
+	{
+		Ep = &Sim.Endpoints[i];
+		if (!Ep->HostMode || !Ep->Enabled)
+			continue;
+		if (Ep->Type == EP_TYPE_BULK)
+			HasBulk = true;
+		else
+			LUFA_Sim_Transaction(Ep, &Budget);
+	}
+
+	/* Bulk endpoints share the rest of the frame. */
+	while (HasBulk && Budget > Sim.Config.PacketOverhead)
+	{
+		Sim.BulkNext = (Sim.BulkNext % (LUFA_SIM_ENDPOINTS - 1)) + 1;
+		Ep = &Sim.Endpoints[Sim.BulkNext];
+		if (Ep->HostMode && Ep->Enabled && Ep->Type == EP_TYPE_BULK)
+			LUFA_Sim_Transaction(Ep, &Budget);
+	}
+
+	LUFA_Sim_Elapse(Budget, &Budget);
+	Sim.Frames++;
+}
+
+uint32_t LUFA_Sim_Frames(void)
+{
+	return Sim.Frames;
+}
+
+LUFA_Sim_EpStats_t* LUFA_Sim_GetEpStats(uint8_t EndpointNumber)
+{
+	LUFA_Sim_Endpoint_t* Ep = &Sim.Endpoints[(EndpointNumber & 0x7F) % LUFA_SIM_ENDPOINTS];
+
+	Ep->Stats.Enabled = Ep->Enabled && Ep->Configured;
+	Ep->Stats.Type = Ep->Type;
+	Ep->Stats.Size = Ep->Size;
+	return &Ep->Stats;
+}
+
+void LUFA_Sim_ResetStats(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < LUFA_SIM_ENDPOINTS; i++)
+		memset(&Sim.Endpoints[i].Stats, 0, sizeof(Sim.Endpoints[i].Stats));
+	Sim.Frames = 0;
+}
+
+uint32_t LUFA_Sim_MemoryConflicts(void)
+{
+	return Sim.MemoryConflicts;
+}
@@ -0,0 +1,148 @@
+/*
+			 LUFA Library
+	 Copyright (C) Dean Camera, 2010.
+
+  dean [at] fourwalledcubicle [dot] com
+		   www.lufa-lib.org
+*/
+
+/*
+  Copyright 2011  Pete Batard (pbatard [at] gmail [dot] com)
+  Copyright 2010-2011 Travis Robinson (libusb.win32.support [at] gmail [dot] com)
+  Copyright 2010  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortuous action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *
+ *  Simulated AVR8 USB controller and host for host builds of the benchmark firmware.
+ *
+ *  lufa_sim implements the LUFA endpoint API (see include/LUFA/Drivers/USB/USB.h)
+ *  on a model of the AVR8 USB controller so Benchmark.c and Descriptors.c run
+ *  unmodified:
+ *    - Endpoints have one direction and move data through a single bank.
+ *      Endpoint memory (176 bytes, as on the AT90USB162) is allocated in
+ *      endpoint order when an endpoint is configured, twice its size for a
+ *      double bank endpoint; configuring an endpoint over the memory of a
+ *      higher endpoint that is still allocated is counted as a conflict.
+ *    - The host runs full-speed 1ms frames. Interrupt and isochronous
+ *      endpoints get one transaction per frame, bulk endpoints share what
+ *      is left of the frame's bus budget round-robin. A bulk or interrupt
+ *      endpoint that is not ready NAKs; an isochronous one misses the frame.
+ *    - The firmware main loop runs once for every task_bytes of bus time.
+ *    - Every frame starts with an SOF event, if enabled. A NAK sets the
+ *      endpoint's NAKINI/NAKOUTI flag in UEINTX.
+ *
+ *  The host checks what it reads: in a read test every packet must carry the
+ *  benchmark pattern and the next packet key; in a loop test every packet must
+ *  come back in order. In a latency test the host stamps and decodes packets
+ *  with kBench_latency.c, as kBench does; the host clock is the bus time.
+ *  (see LUFA_Sim_EpStats_t)
+ */
+
+#ifndef _LUFA_SIM_H_
+#define _LUFA_SIM_H_
+
+	/* Includes: */
+		#include <stdint.h>
+		#include <stdbool.h>
+		#include "kBench_latency.h"
+
+	/* Macros: */
+		/** Number of endpoints, including the control endpoint. */
+		#define LUFA_SIM_ENDPOINTS          5
+
+		/** Endpoint memory of the simulated controller. */
+		#define LUFA_SIM_DPRAM_SIZE         176
+
+		/** Largest endpoint bank. */
+		#define LUFA_SIM_MAX_EP_SIZE        64
+
+	/* Type Defines: */
+		typedef struct
+		{
+			/** Bus bytes per frame; packet payload plus packet_overhead. */
+			uint16_t BusBytes;
+
+			/** Bus bytes charged to every transaction in addition to its payload. */
+			uint16_t PacketOverhead;
+
+			/** Bus bytes that pass for every firmware main loop iteration. */
+			uint16_t TaskBytes;
+
+			/** Firmware main loop. */
+			void (*Task)(void);
+		} LUFA_Sim_Config_t;
+
+		typedef struct
+		{
+			bool     Enabled;
+			uint8_t  Type;
+			uint16_t Size;
+
+			uint32_t Packets;
+			uint64_t Bytes;
+			uint32_t NAKs;			/**< Bulk/interrupt transactions the endpoint was not ready for. */
+			uint32_t Missed;		/**< Isochronous frames the endpoint was not ready for. */
+			uint32_t Errors;		/**< Bad pattern, packet key or loop sequence. */
+
+			BM_LATENCY_RESULT Latency;	/**< LUFA_SIM_HOST_LATENCY IN endpoints. */
+		} LUFA_Sim_EpStats_t;
+
+		/** What the host does with an endpoint. */
+		enum LUFA_Sim_HostModes_t
+		{
+			LUFA_SIM_HOST_IDLE     = 0,
+			LUFA_SIM_HOST_PATTERN  = 1,	/**< IN: check the benchmark pattern and packet key. OUT: send it. */
+			LUFA_SIM_HOST_SEQUENCE = 2,	/**< OUT: send a sequence number in byte 1. IN: check it. */
+			LUFA_SIM_HOST_LATENCY  = 3,	/**< OUT: send a latency test stamp. IN: decode it. */
+		};
+
+	/* Function Prototypes: */
+		void LUFA_Sim_Init(const LUFA_Sim_Config_t* Config);
+
+		/** Runs a control request through EVENT_USB_Device_ControlRequest and, if the firmware does
+		 *  not handle it, the standard requests the LUFA library would. Returns false on a stall.
+		 */
+		bool LUFA_Sim_Control(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex,
+		                      uint16_t wLength, void* Data, uint16_t* Transferred);
+
+		/** Attaches, reads the device and configuration descriptors and selects configuration 1. */
+		bool LUFA_Sim_Enumerate(void);
+
+		/** Gets the configuration descriptor read by LUFA_Sim_Enumerate. */
+		const uint8_t* LUFA_Sim_GetConfigDescriptor(uint16_t* Length);
+
+		/** Sets what the host does with an endpoint; the other endpoints are left alone. */
+		void LUFA_Sim_SetHostMode(uint8_t EndpointAddress, uint8_t Mode);
+
+		/** Stops all host activity. */
+		void LUFA_Sim_ClearHostModes(void);
+
+		void LUFA_Sim_RunFrame(void);
+		uint32_t LUFA_Sim_Frames(void);
+
+		LUFA_Sim_EpStats_t* LUFA_Sim_GetEpStats(uint8_t EndpointNumber);
+		void LUFA_Sim_ResetStats(void);
+
+		/** Endpoint memory conflicts. (see above) */
+		uint32_t LUFA_Sim_MemoryConflicts(void);
+
+#endif
@@ -34,6 +34,9 @@
 #ifndef USB_CONFIG_H_
 #define USB_CONFIG_H_
 
+	/* Settings defined here (e.g. by BmFW/DescGen) replace the defaults below. */
+	#include "USB_Config_External.h"
+
 	/* Descriptor configuration */
 
 	/* DUAL_INTERFACE Selection:
@@ -47,14 +50,19 @@
 
 	// #define DUAL_INTERFACE_WITH_ASSOCIATION
 
-	/* SINGLE_INTERFACE_WITH_ALTSETTINGS Selection:
-	 * If defined, creates a single interface device with an additional alt 
-	 * setting. By default, the first alt setting will have either 0 or 
-	 * USBGEN_EP_SIZE_INTF0/2 for its endpoints wMaxPacketSize's (0 for ISO 
-	 * endpoints). The second alt setting exposes the interface with the actual 
-	 * wMaxPacketSize setting. */
+	/* INTERFACE_ALTSETTINGS Selection:
+	 * If defined, every benchmark interface has four alt settings. The host
+	 * selects one with SET_INTERFACE and the firmware reconfigures the
+	 * interface's endpoints to match, so endpoint types and sizes can be
+	 * swept without reflashing:
+	 *   0: EP_INTFx, USBGEN_EP_SIZE_INTFx/2 (0 for ISO endpoints)
+	 *   1: EP_INTFx, USBGEN_EP_SIZE_INTFx
+	 *   2: EP_TYPE_INTERRUPT, USBGEN_EP_SIZE_INTFx
+	 *   3: EP_TYPE_ISOCHRONOUS, USBGEN_EP_SIZE_INTFx
+	 * If not defined, each interface has only alt setting 1 above (as alt
+	 * setting 0). */
 
-	#define SINGLE_INTERFACE_WITH_ALTSETTINGS
+	#define INTERFACE_ALTSETTINGS
 
 	/* ENABLE_VENDOR_BUFFER_AND_SET_DESCRIPTOR Selection:
 	 * Enables additional control requests and an 8 byte buffer for storing and 
@@ -66,10 +74,6 @@
 	#define DUAL_INTERFACE
 	#endif
 
-	#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS) && defined(DUAL_INTERFACE)
-	#error "Dual interface and single interface with altsettings defines cannot be combined."
-	#endif
-
 	/* Hardware ID configuration */
 	#define VENDOR_ID					0x1234
 	#define PRODUCT_ID					0x0001
@@ -102,60 +106,57 @@
 	/* Interface & endpoint configuration */
 
 	/* Interface number to use in interface descriptor(s) */
-	#define INTF0_NUMBER				1
-	#define INTF1_NUMBER				2
+	#define INTF0_NUMBER				0
+	#define INTF1_NUMBER				1
 
-	/* Endpoint #1 (in, out) size & type */
-	#define USBGEN_EP_SIZE_INTF0		64
+	/* Interface #0 endpoints (#1 out, #2 in) size & type */
+	#if !defined(EP_INTF0)
 	//#define EP_INTF0					EP_TYPE_ISOCHRONOUS
 	#define EP_INTF0					EP_TYPE_BULK
 	//#define EP_INTF0					EP_TYPE_INTERRUPT
+	#endif
 
-	/* Endpoint #2 (in, out) size & type */
-	#define USBGEN_EP_SIZE_INTF1		64
+	/* Interface #1 endpoints (#3 out, #4 in) size & type */
+	#if !defined(EP_INTF1)
 	//#define EP_INTF1					EP_TYPE_ISOCHRONOUS
 	#define EP_INTF1					EP_TYPE_BULK
 	//#define EP_INTF1					EP_TYPE_INTERRUPT
+	#endif
+
+	/* The AT90USB162 has 176 bytes of endpoint memory; two interfaces only
+	 * fit with 32 byte endpoints (8 + 4 * 32). */
+	#if !defined(USBGEN_EP_SIZE_INTF0)
+		#if !defined(DUAL_INTERFACE)
+			#define USBGEN_EP_SIZE_INTF0	64
+			#define USBGEN_EP_SIZE_INTF1	64
+		#else
+			#define USBGEN_EP_SIZE_INTF0	32
+			#define USBGEN_EP_SIZE_INTF1	32
+		#endif
+	#endif
+
+	/* Banks per data endpoint; ENDPOINT_BANK_DOUBLE takes twice the endpoint
+	 * memory. */
+	#if !defined(USBGEN_EP_BANKS)
+		#define USBGEN_EP_BANKS			ENDPOINT_BANK_SINGLE
+	#endif
 
 	/* USB Service Mode */
 	//#define USB_POLLING
 	#define USB_INTERRUPT
 
 	/* Interface & endpoint internal setup */
-	#if (EP_INTF0 == EP_TYPE_BULK)
-		#define USBGEN_EP_ATTRIBUTES_INTF0		(EP_TYPE_BULK | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF0		USB_HANDSHAKE_ENABLED
-		#define USBGEN_EP_INTERVAL_INTF0		0
-	#elif (EP_INTF0 == EP_TYPE_INTERRUPT)
-		#define USBGEN_EP_ATTRIBUTES_INTF0		(EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF0		USB_HANDSHAKE_ENABLED
-		#define USBGEN_EP_INTERVAL_INTF0		1
-	#elif (EP_INTF0 == EP_TYPE_ISOCHRONOUS)
-		#define USBGEN_EP_ATTRIBUTES_INTF0		(EP_TYPE_ISOCHRONOUS | ENDPOINT_ATTR_ASYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF0		0
-		#define USBGEN_EP_INTERVAL_INTF0		1
-	#endif
-
-	#if (EP_INTF1 == EP_TYPE_BULK)
-		#define USBGEN_EP_ATTRIBUTES_INTF1		(EP_TYPE_BULK | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF1		USB_HANDSHAKE_ENABLED
-		#define USBGEN_EP_INTERVAL_INTF1		0
-	#elif (EP_INTF1 == EP_TYPE_INTERRUPT)
-		#define USBGEN_EP_ATTRIBUTES_INTF1		(EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF1		USB_HANDSHAKE_ENABLED
-		#define USBGEN_EP_INTERVAL_INTF1		1
-	#elif (EP_INTF1 == EP_TYPE_ISOCHRONOUS)
-		#define USBGEN_EP_ATTRIBUTES_INTF1		(EP_TYPE_ISOCHRONOUS | ENDPOINT_ATTR_ASYNC | ENDPOINT_USAGE_DATA)
-		#define USBGEN_EP_HANDSHAKE_INTF1		0
-		#define USBGEN_EP_INTERVAL_INTF1		1
-	#endif
-
-	#if (EP_INTF0 == EP_TYPE_ISOCHRONOUS)
-		#define USBGEN_EP_SIZE_INTF0_ALT0		0
+	#define USBGEN_EP_ATTRIBUTES(EpType)	(((EpType) == EP_TYPE_ISOCHRONOUS) ?									\
+											(EP_TYPE_ISOCHRONOUS | ENDPOINT_ATTR_ASYNC | ENDPOINT_USAGE_DATA) :	\
+											((EpType) | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA))
+	#define USBGEN_EP_INTERVAL(EpType)		(((EpType) == EP_TYPE_BULK) ? 0 : 1)
+
+	#if defined(INTERFACE_ALTSETTINGS)
+		#define BM_ALTSETTING_COUNT			4
+		#define USBGEN_EP_SIZE_ALT0(EpType, EpSize)	(((EpType) == EP_TYPE_ISOCHRONOUS) ? 0 : ((EpSize)/2))
 	#else
-		#define USBGEN_EP_SIZE_INTF0_ALT0		(USBGEN_EP_SIZE_INTF0/2)
+		#define BM_ALTSETTING_COUNT			1
 	#endif
-	#define USBGEN_EP_SIZE_INTF0_ALT1			USBGEN_EP_SIZE_INTF0
 
 	#define PP_COUNT						2		// Ping Pong Count
 	#define USB_NEXT_PING_PONG				4
@@ -164,27 +165,23 @@
 	#define mBDT_IsOdd(BdtPtr)             ((((BYTE_VAL*)&BdtPtr)->Val & USB_NEXT_PING_PONG)?1:0)
 	#define mBDT_TogglePP(BdtPtr)          ((BYTE_VAL*)&BdtPtr)->Val ^= USB_NEXT_PING_PONG	
 
-	#define USBGEN_EP_NUM_INTF0				1
-	#define USBGEN_EP_NUM_INTF1				2
+	/* AVR8 endpoints have a single direction; every interface uses two. */
+	#define USBGEN_EP_OUT_INTF0				1
+	#define USBGEN_EP_IN_INTF0				2
+	#define USBGEN_EP_OUT_INTF1				3
+	#define USBGEN_EP_IN_INTF1				4
 
 	#define USB_EP0_BUFF_SIZE				8
-	
-	#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS)
-		#if (EP_INTF0 == EP_TYPE_ISOCHRONOUS)
-			#define USBGEN_EP_SIZE_INTF0_ALT0 (0)
-		#else
-			#define USBGEN_EP_SIZE_INTF0_ALT0 (USBGEN_EP_SIZE_INTF0/2)
-		#endif
-		#define USBGEN_EP_SIZE_INTF0_ALT1 USBGEN_EP_SIZE_INTF0
-	#endif	
 
 	#if defined(DUAL_INTERFACE)
 		#define USB_MAX_NUM_INT				(INTF1_NUMBER + 1)	// For tracking Alternate Setting
-		#define USB_MAX_EP_NUMBER			2
+		#define USB_MAX_EP_NUMBER			USBGEN_EP_IN_INTF1
+		#define BM_INTERFACE_COUNT			2
 		#define USB_NUM_STRING_DESCRIPTORS	6
 	#else
 		#define USB_MAX_NUM_INT				(INTF0_NUMBER + 1)	// For tracking Alternate Setting
-		#define USB_MAX_EP_NUMBER			1
+		#define USB_MAX_EP_NUMBER			USBGEN_EP_IN_INTF0
+		#define BM_INTERFACE_COUNT			1
 		#define USB_NUM_STRING_DESCRIPTORS	4
 	#endif
 
@@ -0,0 +1,3 @@
+#ifndef USB_CONFIG_EXTERNAL_H_
+#define USB_CONFIG_EXTERNAL_H_
+#endif
@@ -0,0 +1,904 @@
+/*!********************************************************************
+libusbK - Benchmark firmware descriptor generator.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Benchmark firmware descriptor generator.
+//
+// Picks the endpoint types, packet sizes, intervals and buffering of a
+// benchmark firmware from a device profile and writes them as the
+// firmware's external configuration header. The firmware builds its
+// descriptor tables and endpoint buffers from that header:
+//
+//   mcp   usb_config_external.h      MCP/USB_Device_Benchmark/Firmware
+//   lufa  USB_Config_External.h      AVR/LUFA/Projects/Benchmark
+//   asf   conf_benchmark_external.h  AVR/ASF/Benchmark/Benchmark/src/config
+//
+// The generated header replaces the firmware's (empty) one; the firmware
+// simulations build with it directly with 'make PROFILE=<out dir>'.
+//
+// bm_descgen [profile=<file>] [out=<dir>] [<setting>=<value> ...]
+//
+// A profile is a list of the settings below separated by white space; '#'
+// starts a comment. Settings on the command line are applied after the
+// profile.
+//
+//   firmware=mcp|lufa|asf   Required.
+//   speed=full|high         Bus speed. (full)
+//   intf0=bulk|int|iso      Endpoint type of interface #0. (bulk)
+//   intf1=bulk|int|iso      Endpoint type of interface #1; adds a second
+//                           interface (DUAL_INTERFACE).
+//   buffering=<n>           Buffers per endpoint: ping-pong buffers (mcp),
+//                           endpoint banks (lufa) or DMA transfer ring
+//                           depth (asf). (firmware default)
+//   ram=<bytes>             Memory the endpoint buffers must fit in; 0 for
+//                           no limit. (firmware default, see below)
+//
+// Every endpoint starts at the largest wMaxPacketSize the bus speed and the
+// controller allow and the shortest bInterval. While the periodic endpoints
+// take more than the bus allows per (micro)frame (USB 2.0 5.6.4/5.7.4) or
+// the endpoint buffers do not fit ram, the largest packet size is halved;
+// asf isochronous endpoints lengthen bInterval first, since their DMA
+// buffers hold a fixed number of frames. (see conf_bm_iso.h)
+//
+// The configuration descriptor the firmware builds from the header is
+// generated too, written to the header as a comment, and walked with the
+// descriptor walk libusbK builds its interface stack with
+// (libusbK/src/lusbk_desc_walk.c): every interface, alt setting and pipe
+// must be found and be valid for the bus speed. Exits non-zero if the profile is
+// invalid, does not fit or the descriptor does not validate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lusbk_desc_walk.h"
+
+#define DG_EP_ISO				0x01
+#define DG_EP_BULK				0x02
+#define DG_EP_INT				0x03
+
+#define DG_MAX_INTERFACES		2
+#define DG_MAX_ALTSETTINGS		4
+#define DG_MAX_CONFIG_LENGTH	512
+
+#define DG_DESC_CONFIG			0x02
+#define DG_DESC_INTERFACE		0x04
+#define DG_DESC_ENDPOINT		0x05
+
+typedef struct _DG_INTERFACE
+{
+	int Type;
+	unsigned int PacketSize;
+	unsigned int Interval;
+} DG_INTERFACE;
+
+typedef struct _DG_FIRMWARE DG_FIRMWARE;
+
+typedef struct _DG_PROFILE
+{
+	const DG_FIRMWARE* Firmware;
+	int HighSpeed;
+	int InterfaceCount;
+	DG_INTERFACE Interfaces[DG_MAX_INTERFACES];
+	unsigned int Buffering;
+	unsigned int Ram;
+	int RamSet;
+	int BufferingSet;
+} DG_PROFILE;
+
+// What a benchmark firmware and its controller support.
+struct _DG_FIRMWARE
+{
+	const char* Name;
+	const char* Header;
+	const char* Guard;
+	int HighSpeed;
+	int MaxInterfaces;
+	unsigned int MinBuffering;
+	unsigned int MaxBuffering;
+	unsigned int DefaultBuffering;
+	unsigned int DefaultRam;
+	unsigned int MaxPacketSize[4];		// By endpoint type; the controller's limit.
+	int PowerOfTwo;						// Packet sizes must be powers of two.
+	int AltSettings;					// 4 for the LUFA INTERFACE_ALTSETTINGS profiles.
+	unsigned char EpAddress[DG_MAX_INTERFACES][2];	// OUT, IN
+
+	unsigned int (*BufferBytes)(const DG_PROFILE* Profile, const DG_INTERFACE* Intf);
+	void (*Write)(FILE* File, const DG_PROFILE* Profile);
+};
+
+static const char* const DescGen_TypeNames[] = { "ctrl", "iso", "bulk", "int" };
+
+/////////////////////////////////////////////////////////////////////
+// Firmware models
+
+// BenchmarkBuffers_INTFx[2][PP_COUNT][USBGEN_EP_SIZE_INTFx]
+static unsigned int DescGen_McpBufferBytes(const DG_PROFILE* Profile, const DG_INTERFACE* Intf)
+{
+	return 2 * Profile->Buffering * Intf->PacketSize;
+}
+
+// Two endpoints, each Buffering banks of endpoint memory.
+static unsigned int DescGen_LufaBufferBytes(const DG_PROFILE* Profile, const DG_INTERFACE* Intf)
+{
+	return 2 * Profile->Buffering * Intf->PacketSize;
+}
+
+// BM_RING_SIZE buffers of BM_BUFFER_SIZE, shared by both endpoints. (conf_bm_iso.h)
+static unsigned int DescGen_AsfBufferBytes(const DG_PROFILE* Profile, const DG_INTERFACE* Intf)
+{
+	unsigned int multiplier;
+	unsigned int bufferSize;
+
+	if (Intf->Type == DG_EP_ISO)
+		multiplier = Profile->HighSpeed ? (64 >> (Intf->Interval - 1)) : 8;
+	else
+		multiplier = 8192 / Intf->PacketSize;
+
+	// MAKE_INTERVAL_SIZE rounds up to BM_BANK_SIZE.
+	bufferSize = ((Intf->PacketSize * multiplier + 511) / 512) * 512;
+	return 2 * Profile->Buffering * bufferSize;
+}
+
+static void DescGen_WriteMcp(FILE* File, const DG_PROFILE* Profile)
+{
+	static const char* const typeNames[] = { "", "EP_ISO", "EP_BULK", "EP_INT" };
+	const DG_INTERFACE* intf1 = &Profile->Interfaces[Profile->InterfaceCount - 1];
+
+	if (Profile->InterfaceCount > 1)
+		fprintf(File, "#define DUAL_INTERFACE\n\n");
+
+	fprintf(File, "#define INTF0\t\t\t\t\t%s\n", typeNames[Profile->Interfaces[0].Type]);
+	fprintf(File, "#define USBGEN_EP_SIZE_INTF0\t%u\n\n", Profile->Interfaces[0].PacketSize);
+	fprintf(File, "#define INTF1\t\t\t\t\t%s\n", typeNames[intf1->Type]);
+	fprintf(File, "#define USBGEN_EP_SIZE_INTF1\t%u\n", intf1->PacketSize);
+}
+
+static void DescGen_WriteLufa(FILE* File, const DG_PROFILE* Profile)
+{
+	static const char* const typeNames[] = { "", "EP_TYPE_ISOCHRONOUS", "EP_TYPE_BULK", "EP_TYPE_INTERRUPT" };
+	const DG_INTERFACE* intf1 = &Profile->Interfaces[Profile->InterfaceCount - 1];
+
+	if (Profile->InterfaceCount > 1)
+		fprintf(File, "#define DUAL_INTERFACE\n\n");
+
+	fprintf(File, "#define EP_INTF0\t\t\t\t%s\n", typeNames[Profile->Interfaces[0].Type]);
+	fprintf(File, "#define USBGEN_EP_SIZE_INTF0\t%u\n\n", Profile->Interfaces[0].PacketSize);
+	fprintf(File, "#define EP_INTF1\t\t\t\t%s\n", typeNames[intf1->Type]);
+	fprintf(File, "#define USBGEN_EP_SIZE_INTF1\t%u\n\n", intf1->PacketSize);
+	fprintf(File, "#define USBGEN_EP_BANKS\t\t\t%s\n",
+	        (Profile->Buffering > 1) ? "ENDPOINT_BANK_DOUBLE" : "ENDPOINT_BANK_SINGLE");
+}
+
+static void DescGen_WriteAsf(FILE* File, const DG_PROFILE* Profile)
+{
+	static const char* const typeNames[] = { "", "EP_TYPE_ISO", "EP_TYPE_BULK", "EP_TYPE_INT" };
+	const DG_INTERFACE* intf = &Profile->Interfaces[0];
+
+	fprintf(File, "#define BM_EP_TYPE\t\t\t\t%s\n", typeNames[intf->Type]);
+	fprintf(File, "#define BM_EP_MAX_PACKET_SIZE\t%u\n", intf->PacketSize);
+	fprintf(File, "#define BM_EP_INTERVAL\t\t\t%u\n", intf->Interval);
+	fprintf(File, "#define BM_RING_SIZE\t\t\t%u\n", 2 * Profile->Buffering);
+}
+
+static const DG_FIRMWARE DescGen_Firmwares[] =
+{
+	// PIC18/PIC24/PIC32 full-speed SIE; BDT byte counts are 10 bits. The
+	// firmware is built for full ping-pong. The default ram fits the
+	// PIC18F4550 USB RAM left over by the BDT and EP0.
+	{
+		"mcp", "usb_config_external.h", "_USB_CFG_EXTERNAL_H",
+		0, 2, 2, 2, 2, 512,
+		{ 0, 1023, 64, 64 }, 0, 1,
+		{ { 0x01, 0x81 }, { 0x02, 0x82 } },
+		DescGen_McpBufferBytes, DescGen_WriteMcp
+	},
+	// AT90USB162; 176 bytes of endpoint memory, 8 of them for EP0. Every
+	// interface has the four INTERFACE_ALTSETTINGS alt settings.
+	{
+		"lufa", "USB_Config_External.h", "USB_CONFIG_EXTERNAL_H_",
+		0, 2, 1, 2, 1, 176 - 8,
+		{ 0, 64, 64, 64 }, 1, 4,
+		{ { 0x01, 0x82 }, { 0x03, 0x84 } },
+		DescGen_LufaBufferBytes, DescGen_WriteLufa
+	},
+	// UC3A3 USBB; one interface. The default ram is what the firmware's
+	// default bulk configuration takes for its DMA ring.
+	{
+		"asf", "conf_benchmark_external.h", "_CONF_BENCHMARK_EXTERNAL_H_",
+		1, 1, 1, 64, 2, 32768,
+		{ 0, 1024, 512, 1024 }, 1, 1,
+		{ { 0x02, 0x81 } },
+		DescGen_AsfBufferBytes, DescGen_WriteAsf
+	},
+};
+
+/////////////////////////////////////////////////////////////////////
+// Endpoint selection
+
+// USB 2.0 wMaxPacketSize limits. (5.5.3, 5.6.3, 5.7.3, 5.8.3)
+static unsigned int DescGen_SpecPacketSize(int Type, int HighSpeed)
+{
+	switch (Type)
+	{
+	case DG_EP_ISO:
+		return HighSpeed ? 1024 : 1023;
+	case DG_EP_INT:
+		return HighSpeed ? 1024 : 64;
+	default:
+		return HighSpeed ? 512 : 64;
+	}
+}
+
+// Bytes a transaction takes on the bus, protocol overhead included. (5.6.4, 5.7.4)
+static unsigned int DescGen_TransactionBytes(int Type, int HighSpeed, unsigned int PacketSize)
+{
+	if (Type == DG_EP_ISO)
+		return PacketSize + (HighSpeed ? 38 : 9);
+	return PacketSize + (HighSpeed ? 55 : 13);
+}
+
+static unsigned int DescGen_PowerOfTwoBelow(unsigned int Size)
+{
+	unsigned int pow2 = 1;
+
+	while (pow2 * 2 <= Size) pow2 *= 2;
+	return pow2;
+}
+
+// Bus bytes per (micro)frame the periodic endpoints reserve; two per interface.
+static unsigned int DescGen_PeriodicBytes(const DG_PROFILE* Profile)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < Profile->InterfaceCount; i++)
+	{
+		const DG_INTERFACE* intf = &Profile->Interfaces[i];
+
+		if (intf->Type != DG_EP_BULK)
+			total += 2 * DescGen_TransactionBytes(intf->Type, Profile->HighSpeed, intf->PacketSize);
+	}
+	return total;
+}
+
+// 90% of a full-speed frame, 80% of a high-speed microframe. (5.6.4, 5.7.4)
+static unsigned int DescGen_PeriodicLimit(const DG_PROFILE* Profile)
+{
+	return Profile->HighSpeed ? (7500 * 8 / 10) : (1500 * 9 / 10);
+}
+
+static unsigned int DescGen_RamBytes(const DG_PROFILE* Profile)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < Profile->InterfaceCount; i++)
+		total += Profile->Firmware->BufferBytes(Profile, &Profile->Interfaces[i]);
+	return total;
+}
+
+// Halves the largest packet size that can be; for PeriodicOnly only of
+// interrupt and isochronous endpoints. Returns 0 if nothing can shrink.
+static int DescGen_Shrink(DG_PROFILE* Profile, int PeriodicOnly)
+{
+	DG_INTERFACE* largest = NULL;
+	DG_INTERFACE* intf;
+	// Alt setting 0 of the lufa profiles halves the packet size.
+	unsigned int minSize = (Profile->Firmware->AltSettings > 1) ? 16 : 8;
+	int i;
+
+	for (i = 0; i < Profile->InterfaceCount; i++)
+	{
+		intf = &Profile->Interfaces[i];
+		if (PeriodicOnly && intf->Type == DG_EP_BULK)
+			continue;
+		// High-speed bulk endpoints must be 512 bytes.
+		if (intf->Type == DG_EP_BULK && Profile->HighSpeed)
+			continue;
+		if (intf->PacketSize <= minSize)
+			continue;
+		if (!largest || intf->PacketSize > largest->PacketSize)
+			largest = intf;
+	}
+	if (!largest)
+		return 0;
+
+	// The asf DMA ring holds a fixed number of frames; a longer interval takes less of it.
+	if (!PeriodicOnly && Profile->Firmware->BufferBytes == DescGen_AsfBufferBytes &&
+	        largest->Type == DG_EP_ISO && Profile->HighSpeed && largest->Interval < 4)
+	{
+		largest->Interval++;
+		return 1;
+	}
+
+	if (largest->PacketSize & (largest->PacketSize - 1))
+		largest->PacketSize = DescGen_PowerOfTwoBelow(largest->PacketSize);
+	else
+		largest->PacketSize /= 2;
+	return 1;
+}
+
+static int DescGen_SelectEndpoints(DG_PROFILE* Profile)
+{
+	const DG_FIRMWARE* fw = Profile->Firmware;
+	DG_INTERFACE* intf;
+	unsigned int size;
+	int i;
+
+	for (i = 0; i < Profile->InterfaceCount; i++)
+	{
+		intf = &Profile->Interfaces[i];
+
+		size = DescGen_SpecPacketSize(intf->Type, Profile->HighSpeed);
+		if (size > fw->MaxPacketSize[intf->Type])
+			size = fw->MaxPacketSize[intf->Type];
+		if (fw->PowerOfTwo)
+			size = DescGen_PowerOfTwoBelow(size);
+
+		intf->PacketSize = size;
+		intf->Interval = (intf->Type == DG_EP_BULK) ? 0 : 1;
+	}
+
+	while (DescGen_PeriodicBytes(Profile) > DescGen_PeriodicLimit(Profile))
+	{
+		if (!DescGen_Shrink(Profile, 1))
+		{
+			fprintf(stderr, "the periodic endpoints do not fit in a %s\n", Profile->HighSpeed ? "microframe" : "frame");
+			return -1;
+		}
+	}
+
+	while (Profile->Ram && DescGen_RamBytes(Profile) > Profile->Ram)
+	{
+		if (!DescGen_Shrink(Profile, 0))
+		{
+			fprintf(stderr, "the endpoint buffers take %u bytes; ram=%u\n", DescGen_RamBytes(Profile), Profile->Ram);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Configuration descriptor
+
+// The endpoint type and size an alt setting of an interface has. (USB_Config.h)
+static void DescGen_AltSetting(const DG_PROFILE* Profile, const DG_INTERFACE* Intf, int AltSetting,
+                               int* Type, unsigned int* PacketSize)
+{
+	*Type = Intf->Type;
+	*PacketSize = Intf->PacketSize;
+
+	if (Profile->Firmware->AltSettings == 1)
+		return;
+
+	switch (AltSetting)
+	{
+	case 0:
+		*PacketSize = (Intf->Type == DG_EP_ISO) ? 0 : (Intf->PacketSize / 2);
+		break;
+	case 2:
+		*Type = DG_EP_INT;
+		break;
+	case 3:
+		*Type = DG_EP_ISO;
+		break;
+	}
+}
+
+static unsigned int DescGen_Put(unsigned char* Config, unsigned int Length, const unsigned char* Desc)
+{
+	memcpy(&Config[Length], Desc, Desc[0]);
+	return Length + Desc[0];
+}
+
+// Builds the configuration descriptor; returns its length.
+static unsigned int DescGen_BuildConfig(const DG_PROFILE* Profile, unsigned char* Config)
+{
+	const DG_FIRMWARE* fw = Profile->Firmware;
+	unsigned char desc[9];
+	unsigned int length = 9;
+	unsigned int size;
+	int i, alt, dir, type;
+
+	for (i = 0; i < Profile->InterfaceCount; i++)
+	{
+		for (alt = 0; alt < fw->AltSettings; alt++)
+		{
+			DescGen_AltSetting(Profile, &Profile->Interfaces[i], alt, &type, &size);
+
+			memset(desc, 0, sizeof(desc));
+			desc[0] = 9;
+			desc[1] = DG_DESC_INTERFACE;
+			desc[2] = (unsigned char)i;
+			desc[3] = (unsigned char)alt;
+			desc[4] = 2;
+			desc[5] = 0xFF;
+			length = DescGen_Put(Config, length, desc);
+
+			for (dir = 0; dir < 2; dir++)
+			{
+				memset(desc, 0, sizeof(desc));
+				desc[0] = 7;
+				desc[1] = DG_DESC_ENDPOINT;
+				desc[2] = fw->EpAddress[i][dir];
+				desc[3] = (unsigned char)type;
+				desc[4] = (unsigned char)size;
+				desc[5] = (unsigned char)(size >> 8);
+				desc[6] = (unsigned char)((type == DG_EP_BULK) ? 0 : (Profile->Interfaces[i].Interval ? Profile->Interfaces[i].Interval : 1));
+				length = DescGen_Put(Config, length, desc);
+			}
+		}
+	}
+
+	memset(Config, 0, 9);
+	Config[0] = 9;
+	Config[1] = DG_DESC_CONFIG;
+	Config[2] = (unsigned char)length;
+	Config[3] = (unsigned char)(length >> 8);
+	Config[4] = (unsigned char)Profile->InterfaceCount;
+	Config[5] = 1;
+	Config[7] = 0x80;
+	Config[8] = 50;
+	return length;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Validation; the libusbK interface stack walk.
+
+typedef struct _DG_PIPE
+{
+	unsigned char Address;
+	int Type;
+	unsigned int PacketSize;
+	unsigned int Interval;
+} DG_PIPE;
+
+typedef struct _DG_ALT_INTERFACE
+{
+	int ID;
+	int DeclaredPipes;
+	int PipeCount;
+	DG_PIPE Pipes[2];
+} DG_ALT_INTERFACE;
+
+typedef struct _DG_INTERFACE_EL
+{
+	int ID;
+	int AltInterfaceCount;
+	DG_ALT_INTERFACE AltInterfaces[DG_MAX_ALTSETTINGS];
+} DG_INTERFACE_EL;
+
+typedef struct _DG_STACK
+{
+	int InterfaceCount;
+	DG_INTERFACE_EL Interfaces[DG_MAX_INTERFACES];
+	int Overflow;
+} DG_STACK;
+
+// KDESC_WALK::AddPipe
+static int DescGen_AddPipe(void* Context, void* AltInterface, const unsigned char* Descriptor)
+{
+	DG_STACK* stack = Context;
+	DG_ALT_INTERFACE* altInterfaceEL = AltInterface;
+	DG_PIPE* pipe;
+	int i;
+
+	for (i = 0; i < altInterfaceEL->PipeCount; i++)
+	{
+		if (altInterfaceEL->Pipes[i].Address == Descriptor[2])
+			return 1;
+	}
+	if (altInterfaceEL->PipeCount == 2)
+	{
+		stack->Overflow++;
+		return 1;
+	}
+
+	pipe = &altInterfaceEL->Pipes[altInterfaceEL->PipeCount++];
+	pipe->Address = Descriptor[2];
+	pipe->Type = Descriptor[3] & 0x03;
+	pipe->PacketSize = (unsigned int)Descriptor[4] | ((unsigned int)Descriptor[5] << 8);
+	pipe->Interval = Descriptor[6];
+	return 1;
+}
+
+// KDESC_WALK::AddInterface
+static void* DescGen_AddInterface(void* Context, const unsigned char* Descriptor)
+{
+	DG_STACK* stack = Context;
+	DG_INTERFACE_EL* interfaceEL = NULL;
+	DG_ALT_INTERFACE* altInterfaceEL = NULL;
+	int i;
+
+	for (i = 0; i < stack->InterfaceCount; i++)
+	{
+		if (stack->Interfaces[i].ID == Descriptor[2])
+			interfaceEL = &stack->Interfaces[i];
+	}
+	if (!interfaceEL)
+	{
+		if (stack->InterfaceCount == DG_MAX_INTERFACES)
+		{
+			stack->Overflow++;
+			return NULL;
+		}
+		interfaceEL = &stack->Interfaces[stack->InterfaceCount++];
+		interfaceEL->ID = Descriptor[2];
+	}
+
+	for (i = 0; i < interfaceEL->AltInterfaceCount; i++)
+	{
+		if (interfaceEL->AltInterfaces[i].ID == Descriptor[3])
+			altInterfaceEL = &interfaceEL->AltInterfaces[i];
+	}
+	if (!altInterfaceEL)
+	{
+		if (interfaceEL->AltInterfaceCount == DG_MAX_ALTSETTINGS)
+		{
+			stack->Overflow++;
+			return NULL;
+		}
+		altInterfaceEL = &interfaceEL->AltInterfaces[interfaceEL->AltInterfaceCount++];
+		altInterfaceEL->ID = Descriptor[3];
+		altInterfaceEL->DeclaredPipes = Descriptor[4];
+	}
+
+	return altInterfaceEL;
+}
+
+// USB 2.0 9.6.6; returns 0 if the pipe is valid for the bus speed.
+static int DescGen_CheckPipe(const DG_PIPE* Pipe, int HighSpeed)
+{
+	if (Pipe->PacketSize > DescGen_SpecPacketSize(Pipe->Type, HighSpeed))
+		return -1;
+
+	switch (Pipe->Type)
+	{
+	case DG_EP_BULK:
+		if (HighSpeed)
+			return (Pipe->PacketSize == 512) ? 0 : -1;
+		return (Pipe->PacketSize >= 8 && !(Pipe->PacketSize & (Pipe->PacketSize - 1))) ? 0 : -1;
+	case DG_EP_INT:
+		if (!Pipe->PacketSize || !Pipe->Interval)
+			return -1;
+		return (HighSpeed && Pipe->Interval > 16) ? -1 : 0;
+	case DG_EP_ISO:
+		return (Pipe->Interval >= 1 && Pipe->Interval <= 16) ? 0 : -1;
+	default:
+		return -1;
+	}
+}
+
+// Returns the number of problems found.
+static int DescGen_Validate(const DG_PROFILE* Profile, const unsigned char* Config, unsigned int Length)
+{
+	KDESC_WALK walk;
+	DG_STACK stack;
+	long totalLength;
+	const DG_ALT_INTERFACE* alt;
+	int problems = 0;
+	int i, j, k;
+
+	memset(&stack, 0, sizeof(stack));
+
+	totalLength = (long)((unsigned int)Config[2] | ((unsigned int)Config[3] << 8));
+	if ((unsigned int)totalLength != Length)
+	{
+		printf("wTotalLength %ld, descriptor is %u bytes\n", totalLength, Length);
+		problems++;
+	}
+
+	walk.Context = &stack;
+	walk.AddInterface = DescGen_AddInterface;
+	walk.AddPipe = DescGen_AddPipe;
+	DescWalk_Config(&walk, Config, totalLength);
+
+	if (stack.Overflow)
+	{
+		printf("unexpected interfaces, alt settings or endpoints\n");
+		problems++;
+	}
+	if (stack.InterfaceCount != Config[4] || stack.InterfaceCount != Profile->InterfaceCount)
+	{
+		printf("%d interfaces found, bNumInterfaces %u\n", stack.InterfaceCount, Config[4]);
+		problems++;
+	}
+
+	for (i = 0; i < stack.InterfaceCount; i++)
+	{
+		if (stack.Interfaces[i].AltInterfaceCount != Profile->Firmware->AltSettings)
+		{
+			printf("interface %d: %d alt settings found\n", stack.Interfaces[i].ID, stack.Interfaces[i].AltInterfaceCount);
+			problems++;
+		}
+		for (j = 0; j < stack.Interfaces[i].AltInterfaceCount; j++)
+		{
+			alt = &stack.Interfaces[i].AltInterfaces[j];
+			if (alt->PipeCount != alt->DeclaredPipes)
+			{
+				printf("interface %d/%d: %d pipes found, bNumEndpoints %d\n", stack.Interfaces[i].ID, alt->ID, alt->PipeCount, alt->DeclaredPipes);
+				problems++;
+			}
+			for (k = 0; k < alt->PipeCount; k++)
+			{
+				// Zero bandwidth alt settings have no packets to check.
+				if (!alt->Pipes[k].PacketSize && alt->Pipes[k].Type == DG_EP_ISO)
+					continue;
+				if (DescGen_CheckPipe(&alt->Pipes[k], Profile->HighSpeed) != 0)
+				{
+					printf("interface %d/%d: pipe %02Xh %s wMaxPacketSize %u bInterval %u is not valid at %s-speed\n",
+					       stack.Interfaces[i].ID, alt->ID, alt->Pipes[k].Address, DescGen_TypeNames[alt->Pipes[k].Type],
+					       alt->Pipes[k].PacketSize, alt->Pipes[k].Interval, Profile->HighSpeed ? "high" : "full");
+					problems++;
+				}
+			}
+		}
+	}
+
+	return problems;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Output
+
+// Reserved bandwidth of a periodic endpoint, KB/s.
+static double DescGen_PeriodicKBs(const DG_PROFILE* Profile, const DG_INTERFACE* Intf)
+{
+	double intervalsPerSecond = Profile->HighSpeed ? 8000.0 : 1000.0;
+
+	if (Intf->Type == DG_EP_INT && !Profile->HighSpeed)
+		return (double)Intf->PacketSize * 1000.0 / Intf->Interval / 1024.0;
+	return (double)Intf->PacketSize * intervalsPerSecond / (double)(1 << (Intf->Interval - 1)) / 1024.0;
+}
+
+static void DescGen_Summary(FILE* File, const char* Prefix, const DG_PROFILE* Profile)
+{
+	const DG_INTERFACE* intf;
+	int i;
+
+	fprintf(File, "%s%s, %s-speed, buffering %u\n", Prefix, Profile->Firmware->Name,
+	        Profile->HighSpeed ? "high" : "full", Profile->Buffering);
+	for (i = 0; i < Profile->InterfaceCount; i++)
+	{
+		intf = &Profile->Interfaces[i];
+		fprintf(File, "%sInterface %d: %-4s wMaxPacketSize %4u bInterval %u", Prefix, i,
+		        DescGen_TypeNames[intf->Type], intf->PacketSize, intf->Interval);
+		if (intf->Type != DG_EP_BULK)
+			fprintf(File, "  %.1f KB/s per endpoint", DescGen_PeriodicKBs(Profile, intf));
+		fprintf(File, "\n");
+	}
+	fprintf(File, "%sPeriodic bus bytes per %s: %u of %u\n", Prefix, Profile->HighSpeed ? "microframe" : "frame",
+	        DescGen_PeriodicBytes(Profile), DescGen_PeriodicLimit(Profile));
+	if (Profile->Ram)
+		fprintf(File, "%sEndpoint buffers: %u of %u bytes\n", Prefix, DescGen_RamBytes(Profile), Profile->Ram);
+	else
+		fprintf(File, "%sEndpoint buffers: %u bytes\n", Prefix, DescGen_RamBytes(Profile));
+}
+
+static int DescGen_WriteHeader(const char* OutDir, const DG_PROFILE* Profile,
+                               const unsigned char* Config, unsigned int Length)
+{
+	const DG_FIRMWARE* fw = Profile->Firmware;
+	char path[1024];
+	FILE* file;
+	unsigned int i;
+
+	snprintf(path, sizeof(path), "%s/%s", OutDir, fw->Header);
+	file = fopen(path, "w");
+	if (!file)
+	{
+		perror(path);
+		return -1;
+	}
+
+	fprintf(file, "// %s - generated by bm_descgen (BmFW/DescGen); do not edit.\n//\n", fw->Header);
+	DescGen_Summary(file, "// ", Profile);
+	fprintf(file, "//\n// Configuration descriptor:\n");
+	for (i = 0; i < Length; i++)
+		fprintf(file, "%s%02X%s", (i % 16) ? "" : "//  ", Config[i], ((i % 16) == 15 || i == Length - 1) ? "\n" : " ");
+
+	fprintf(file, "\n#ifndef %s\n#define %s\n\n", fw->Guard, fw->Guard);
+	fw->Write(file, Profile);
+	fprintf(file, "\n#endif\n");
+
+	fclose(file);
+	printf("wrote %s\n", path);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Profile
+
+static int DescGen_ParseType(const char* Value)
+{
+	if (!strcmp(Value, "bulk")) return DG_EP_BULK;
+	if (!strcmp(Value, "int")) return DG_EP_INT;
+	if (!strcmp(Value, "iso")) return DG_EP_ISO;
+	return 0;
+}
+
+// Applies one name=value setting; returns 0 on success.
+static int DescGen_ParseSetting(DG_PROFILE* Profile, const char* Setting)
+{
+	const char* value = strchr(Setting, '=');
+	size_t nameLength;
+	unsigned int i;
+
+	if (!value)
+		return -1;
+	nameLength = (size_t)(value - Setting);
+	value++;
+
+#define DG_IS(Name) (nameLength == strlen(Name) && !strncmp(Setting, Name, nameLength))
+
+	if (DG_IS("firmware"))
+	{
+		Profile->Firmware = NULL;
+		for (i = 0; i < sizeof(DescGen_Firmwares) / sizeof(DescGen_Firmwares[0]); i++)
+		{
+			if (!strcmp(value, DescGen_Firmwares[i].Name))
+				Profile->Firmware = &DescGen_Firmwares[i];
+		}
+		return Profile->Firmware ? 0 : -1;
+	}
+	if (DG_IS("speed"))
+	{
+		if (!strcmp(value, "full")) Profile->HighSpeed = 0;
+		else if (!strcmp(value, "high")) Profile->HighSpeed = 1;
+		else return -1;
+		return 0;
+	}
+	if (DG_IS("intf0"))
+		return (Profile->Interfaces[0].Type = DescGen_ParseType(value)) ? 0 : -1;
+	if (DG_IS("intf1"))
+	{
+		Profile->InterfaceCount = 2;
+		return (Profile->Interfaces[1].Type = DescGen_ParseType(value)) ? 0 : -1;
+	}
+	if (DG_IS("buffering"))
+	{
+		Profile->Buffering = (unsigned int)strtoul(value, NULL, 0);
+		Profile->BufferingSet = 1;
+		return 0;
+	}
+	if (DG_IS("ram"))
+	{
+		Profile->Ram = (unsigned int)strtoul(value, NULL, 0);
+		Profile->RamSet = 1;
+		return 0;
+	}
+
+#undef DG_IS
+	return -1;
+}
+
+static int DescGen_ParseProfile(DG_PROFILE* Profile, const char* FileName)
+{
+	char line[256];
+	char* token;
+	char* comment;
+	FILE* file;
+	int lineNumber = 0;
+	int result = 0;
+
+	file = fopen(FileName, "r");
+	if (!file)
+	{
+		perror(FileName);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+		if ((comment = strchr(line, '#')) != NULL)
+			*comment = '\0';
+
+		for (token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n"))
+		{
+			if (DescGen_ParseSetting(Profile, token) != 0)
+			{
+				fprintf(stderr, "%s(%d): invalid setting '%s'\n", FileName, lineNumber, token);
+				result = -1;
+			}
+		}
+	}
+
+	fclose(file);
+	return result;
+}
+
+// Applies the firmware defaults and checks the profile against the firmware.
+static int DescGen_CheckProfile(DG_PROFILE* Profile)
+{
+	const DG_FIRMWARE* fw = Profile->Firmware;
+
+	if (!fw)
+	{
+		fprintf(stderr, "no firmware selected\n");
+		return -1;
+	}
+	if (!Profile->BufferingSet)
+		Profile->Buffering = fw->DefaultBuffering;
+	if (!Profile->RamSet)
+		Profile->Ram = fw->DefaultRam;
+
+	if (Profile->HighSpeed && !fw->HighSpeed)
+	{
+		fprintf(stderr, "%s: the controller is full-speed only\n", fw->Name);
+		return -1;
+	}
+	if (Profile->InterfaceCount > fw->MaxInterfaces)
+	{
+		fprintf(stderr, "%s: at most %d interface(s)\n", fw->Name, fw->MaxInterfaces);
+		return -1;
+	}
+	if (Profile->Buffering < fw->MinBuffering || Profile->Buffering > fw->MaxBuffering ||
+	        (Profile->Buffering & (Profile->Buffering - 1)))
+	{
+		fprintf(stderr, "%s: buffering must be a power of 2 from %u to %u\n", fw->Name, fw->MinBuffering, fw->MaxBuffering);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	DG_PROFILE profile;
+	unsigned char config[DG_MAX_CONFIG_LENGTH];
+	unsigned int length;
+	const char* outDir = ".";
+	int i;
+
+	memset(&profile, 0, sizeof(profile));
+	profile.InterfaceCount = 1;
+	profile.Interfaces[0].Type = DG_EP_BULK;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "profile=", 8))
+		{
+			if (DescGen_ParseProfile(&profile, argv[i] + 8) != 0)
+				return 2;
+		}
+		else if (!strncmp(argv[i], "out=", 4))
+		{
+			outDir = argv[i] + 4;
+		}
+		else if (DescGen_ParseSetting(&profile, argv[i]) != 0)
+		{
+			printf("usage: bm_descgen [profile=<file>] [out=<dir>] [firmware=mcp|lufa|asf] [speed=full|high]\n"
+			       "                  [intf0=bulk|int|iso] [intf1=bulk|int|iso] [buffering=<n>] [ram=<bytes>]\n");
+			return 2;
+		}
+	}
+
+	if (DescGen_CheckProfile(&profile) != 0 || DescGen_SelectEndpoints(&profile) != 0)
+		return 1;
+
+	length = DescGen_BuildConfig(&profile, config);
+	DescGen_Summary(stdout, "", &profile);
+	if (DescGen_Validate(&profile, config, length) != 0)
+	{
+		printf("configuration descriptor validation failed\n");
+		return 1;
+	}
+
+	return DescGen_WriteHeader(outDir, &profile, config, length) ? 1 : 0;
+}
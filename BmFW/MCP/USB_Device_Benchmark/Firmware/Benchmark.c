@@ -29,6 +29,7 @@
 */
 
 /** INCLUDES *******************************************************/
+#include <string.h>
 #include "USB/usb.h"
 #include "USB/usb_function_generic.h"
 #include "HardwareProfile.h"
@@ -69,9 +70,17 @@
 #endif
 
 // Data buffers
-BYTE BenchmarkBuffers_INTF0[2][PP_COUNT][USBGEN_EP_SIZE_INTF0];
+// Packet keys are stamped with a WORD store; on C30/C32 the buffers must be
+// WORD aligned.
+#if defined(__18CXX)
+	#define BUFFER_ALIGNED
+#else
+	#define BUFFER_ALIGNED __attribute__((aligned(4)))
+#endif
+
+BYTE BenchmarkBuffers_INTF0[2][PP_COUNT][USBGEN_EP_SIZE_INTF0] BUFFER_ALIGNED;
 #ifdef DUAL_INTERFACE
-BYTE BenchmarkBuffers_INTF1[2][PP_COUNT][USBGEN_EP_SIZE_INTF1];
+BYTE BenchmarkBuffers_INTF1[2][PP_COUNT][USBGEN_EP_SIZE_INTF1] BUFFER_ALIGNED;
 #endif
 
 #if defined(VENDOR_BUFFER_ENABLED)
@@ -88,17 +97,30 @@ WORD counter;
 volatile BYTE TestType_INTF0;
 volatile BYTE PrevTestType_INTF0;
 
-volatile BYTE FillCount_INTF0;
 volatile BYTE NextPacketKey_INTF0;
 
 #ifdef DUAL_INTERFACE
 	volatile BYTE TestType_INTF1;
 	volatile BYTE PrevTestType_INTF1;
 
-	volatile BYTE FillCount_INTF1;
 	volatile BYTE NextPacketKey_INTF1;
 #endif
 
+// Device counters (GET_STATS). Armed_ has a bit for every BDT submitted since
+// USBCBInitEP; see countTransfer().
+BM_STATS Stats_INTF0;
+BYTE Armed_INTF0;
+#ifdef DUAL_INTERFACE
+	BM_STATS Stats_INTF1;
+	BYTE Armed_INTF1;
+#endif
+
+// GET_STATS reply; the counters can change while EP0 sends it.
+BM_STATS StatsReply;
+
+WORD LastFrameNumber;
+BYTE LastFrameNumberValid;
+
 /** EXTERNS ********************************************************/
 extern void BlinkUSBStatus(void);
 extern USB_VOLATILE BYTE USBAlternateInterface[USB_MAX_NUM_INT];
@@ -110,41 +132,87 @@ unsigned char gConfigDescriptorCount = 0;
 #endif
 
 /** BMARK FUNCTIONS ************************************************/
+void doBenchmarkIO_INTF0(void);
 void doBenchmarkLoop_INTF0(void);
 void doBenchmarkWrite_INTF0(void);
 void doBenchmarkRead_INTF0(void);
 
 #ifdef DUAL_INTERFACE
+	void doBenchmarkIO_INTF1(void);
 	void doBenchmarkLoop_INTF1(void);
 	void doBenchmarkWrite_INTF1(void);
 	void doBenchmarkRead_INTF1(void);
 #endif
 
 void fillBuffer(BYTE* pBuffer, WORD size);
+void resetStats(BM_STATS* pStats);
+void countTransfer(BM_STATS* pStats, BYTE* pArmed, volatile BDT_ENTRY* pBdt, BYTE Direction);
+
+// Test pattern expected by the PC application: 0,1,2..255, then 1..255
+// repeating. Byte 1 of every packet is replaced with the packet key.
+#define PATTERN_16(n) \
+	(n)+0x0,(n)+0x1,(n)+0x2,(n)+0x3,(n)+0x4,(n)+0x5,(n)+0x6,(n)+0x7,\
+	(n)+0x8,(n)+0x9,(n)+0xA,(n)+0xB,(n)+0xC,(n)+0xD,(n)+0xE,(n)+0xF
+
+ROM BYTE PatternTable[256]=
+{
+	PATTERN_16(0x00),PATTERN_16(0x10),PATTERN_16(0x20),PATTERN_16(0x30),
+	PATTERN_16(0x40),PATTERN_16(0x50),PATTERN_16(0x60),PATTERN_16(0x70),
+	PATTERN_16(0x80),PATTERN_16(0x90),PATTERN_16(0xA0),PATTERN_16(0xB0),
+	PATTERN_16(0xC0),PATTERN_16(0xD0),PATTERN_16(0xE0),PATTERN_16(0xF0)
+};
+
+#if defined(__18CXX)
+	#define mCopyPattern(Dest, Src, Length) memcpypgm2ram(Dest, (const ROM void*)(Src), Length)
+#else
+	#define mCopyPattern(Dest, Src, Length) memcpy(Dest, (const void*)(Src), Length)
+#endif
+
+// 11 bit frame number of the last SOF.
+#if defined(__18CXX)
+	#define mGetFrameNumber() (UFRML | (((WORD)(UFRMH & 0x07))<<8))
+#else
+	#define mGetFrameNumber() (U1FRML | (((WORD)(U1FRMH & 0x07))<<8))
+#endif
+
+// Latency test; stamps the frame the packet was taken in.
+#define mStampLatency(pBuffer, Length)										\
+{																			\
+	if ((Length) >= BM_LATENCY_STAMP_LENGTH)								\
+	{																		\
+		WORD frame = mGetFrameNumber() | BM_LATENCY_FRAME_STAMPED;			\
+		(pBuffer)[BM_LATENCY_FRAME_OFFSET] = (BYTE)frame;					\
+		(pBuffer)[BM_LATENCY_FRAME_OFFSET+1] = (BYTE)(frame >> 8);			\
+	}																		\
+}
+
+#if defined(USB_DISABLE_SOF_HANDLER)
+	#define BM_STATS_FLAGS (0)
+#else
+	#define BM_STATS_FLAGS BM_STATS_FLAG_SOFS
+#endif
 
 /** BMARK MACROS ****************************************************/
 #define	mBenchMarkInit(IntfSuffix)				\
 {												\
 	TestType_##IntfSuffix=TEST_LOOP;			\
 	PrevTestType_##IntfSuffix=TEST_LOOP;		\
-	FillCount_##IntfSuffix=0;					\
 	NextPacketKey_##IntfSuffix=0;				\
+	resetStats(&Stats_##IntfSuffix);			\
 }
 
-
-#define mSetWritePacketID(BufferPtr, BufferSize, FillCount, NextPacketKey)	\
-{																			\
-	if ((BufferSize)>0)														\
-	{																		\
-		if (FillCount < 3)													\
-		{																	\
-			FillCount++;													\
-			fillBuffer((BYTE*)BufferPtr,BufferSize);						\
-		}																	\
-		BufferPtr[1]=NextPacketKey++;										\
-	}																		\
+// Fills every buffer of an interface with the test pattern. The loop test
+// swaps buffers between the endpoints, so all of them are filled.
+#define mFillBuffers(IntfSuffix)																	\
+{																									\
+	for (counter=0; counter < sizeof(BenchmarkBuffers_##IntfSuffix); counter+=USBGEN_EP_SIZE_##IntfSuffix)	\
+		fillBuffer(((BYTE*)BenchmarkBuffers_##IntfSuffix)+counter, USBGEN_EP_SIZE_##IntfSuffix);	\
 }
 
+// Stamps the packet key; byte 0 (always 0) and byte 1 in one WORD store.
+#define mSetWritePacketID(BufferPtr, NextPacketKey)	\
+	*((WORD*)(BufferPtr)) = ((WORD)(NextPacketKey++))<<8
+
 // If interface #0 is iso, use an iso specific submit macro
 #if (INTF0==EP_ISO)
 	#define mSubmitTransfer_INTF0(BdtPtr, BufferLength) mBDT_SubmitIsoTransfer(BdtPtr, BufferLength)
@@ -159,6 +227,15 @@ void fillBuffer(BYTE* pBuffer, WORD size);
 	#define mSubmitTransfer_INTF1(BdtPtr, BufferLength) mBDT_SubmitTransfer(BdtPtr)
 #endif
 
+// Services an interface once for every ping-pong buffer; each pass re-arms at
+// most one BDT per direction.
+#define mServiceTransfers(IntfSuffix)			\
+{												\
+	BYTE ppIndex;								\
+	for (ppIndex=0; ppIndex < PP_COUNT; ppIndex++)	\
+		doBenchmarkIO_##IntfSuffix();			\
+}
+
 #define GetBenchmarkBuffer(IntfSuffix, Direction, IsOdd) BenchmarkBuffers_##IntfSuffix[Direction][IsOdd]
 
 // Swaps byte pointers
@@ -200,6 +277,12 @@ void PicFWSetVendorBufferHandler(void)
 // the OUT (MCU Rx) endpoint with the first BenchmarkBuffer.
 void USBCBInitEP(void)
 {
+	Armed_INTF0=0;
+	#ifdef DUAL_INTERFACE
+		Armed_INTF1=0;
+	#endif
+	LastFrameNumberValid=0;
+
     USBEnableEndpoint(USBGEN_EP_NUM_INTF0,USB_OUT_ENABLED|USB_IN_ENABLED|USBGEN_EP_HANDSHAKE_INTF0|USB_DISALLOW_SETUP);
 
 	//Prepare the OUT endpoints to receive the first packets from the host.
@@ -242,6 +325,13 @@ void USBCBInitEP(void)
 		#endif
 	#endif
 
+	// Start the current test; nothing is polled from the main loop.
+	#if defined(TRANSFER_EVENTS_ENABLED)
+		mServiceTransfers(INTF0);
+		#ifdef DUAL_INTERFACE
+			mServiceTransfers(INTF1);
+		#endif
+	#endif
 }
 void USBCBCheckOtherReq(void)
 {
@@ -254,19 +344,29 @@ void USBCBCheckOtherReq(void)
 		if ((SetupPkt.wIndex & 0xff) == INTF1_NUMBER)
 		{
 			TestType_INTF1=SetupPkt.wValue & 0xff;
+			resetStats(&Stats_INTF1);
 			inPipes[0].pSrc.bRam = (BYTE*)&TestType_INTF1;  // Set Source
 			inPipes[0].info.bits.ctrl_trf_mem = USB_EP0_RAM;		// Set memory type
 			inPipes[0].wCount.v[0] = 1;						// Set data count
 			inPipes[0].info.bits.busy = 1;
+#if defined(TRANSFER_EVENTS_ENABLED)
+			if (USBDeviceState == CONFIGURED_STATE)
+				mServiceTransfers(INTF1);
+#endif
 		}
 		else
 #endif
 		{
 			TestType_INTF0=SetupPkt.wValue & 0xff;
+			resetStats(&Stats_INTF0);
 			inPipes[0].pSrc.bRam = (BYTE*)&TestType_INTF0;  // Set Source
 			inPipes[0].info.bits.ctrl_trf_mem = USB_EP0_RAM;		// Set memory type
 			inPipes[0].wCount.v[0] = 1;						// Set data count
 			inPipes[0].info.bits.busy = 1;
+#if defined(TRANSFER_EVENTS_ENABLED)
+			if (USBDeviceState == CONFIGURED_STATE)
+				mServiceTransfers(INTF0);
+#endif
 		}
 		break;
 	case PICFW_GET_TEST:
@@ -287,6 +387,19 @@ void USBCBCheckOtherReq(void)
 			inPipes[0].info.bits.busy = 1;
 		}
 		break;
+	case PICFW_GET_STATS:
+#ifdef DUAL_INTERFACE
+		if ((SetupPkt.wIndex & 0xff) == INTF1_NUMBER)
+			StatsReply = Stats_INTF1;
+		else
+#endif
+			StatsReply = Stats_INTF0;
+
+		inPipes[0].pSrc.bRam = (BYTE*)&StatsReply;			// Set Source
+		inPipes[0].info.bits.ctrl_trf_mem = USB_EP0_RAM;	// Set memory type
+		inPipes[0].wCount.v[0] = (SetupPkt.wLength < sizeof(StatsReply)) ? SetupPkt.wLength : sizeof(StatsReply);
+		inPipes[0].info.bits.busy = 1;
+		break;
 #if defined(VENDOR_BUFFER_ENABLED)
 
 	case PICFW_SET_VENDOR_BUFFER:
@@ -352,14 +465,68 @@ void Benchmark_Init(void)
 
 void fillBuffer(BYTE* pBuffer, WORD size)
 {
-	BYTE dataByte = 0;
-	for (counter=0; counter < size; counter++)
+	WORD length = (size < sizeof(PatternTable)) ? size : sizeof(PatternTable);
+
+	mCopyPattern(pBuffer, PatternTable, length);
+	for (pBuffer+=length, size-=length; size; pBuffer+=length, size-=length)
 	{
-		pBuffer[counter] = dataByte++;
-		if (dataByte == 0) dataByte++;
+		length = (size < sizeof(PatternTable)-1) ? size : sizeof(PatternTable)-1;
+		mCopyPattern(pBuffer, &PatternTable[1], length);
 	}
 }
 
+void resetStats(BM_STATS* pStats)
+{
+	memset(pStats, 0, sizeof(BM_STATS));
+	pStats->Length = sizeof(BM_STATS);
+	pStats->Version = BM_STATS_VERSION;
+	pStats->Flags = BM_STATS_FLAGS;
+}
+
+// Called just before pBdt is re-armed; counts the transfer that last used it
+// and marks it armed. The endpoint is starved if the other ping-pong BDT is
+// back from the SIE as well; the host is being NAKed until this one is
+// re-armed.
+void countTransfer(BM_STATS* pStats, BYTE* pArmed, volatile BDT_ENTRY* pBdt, BYTE Direction)
+{
+	BYTE armedBit = 1 << ((Direction<<1) | mBDT_IsOdd(pBdt));
+
+	if (*pArmed & armedBit)
+	{
+		pStats->Transfers[Direction]++;
+		pStats->Bytes[Direction]+=mBDT_GetLength(pBdt);
+
+		#if (PP_COUNT==(2))
+			mBDT_TogglePP(pBdt);
+			if ((*pArmed & (1 << ((Direction<<1) | mBDT_IsOdd(pBdt)))) && !USBHandleBusy(pBdt))
+				pStats->Starved[Direction]++;
+		#else
+			pStats->Starved[Direction]++;
+		#endif
+	}
+	*pArmed |= armedBit;
+}
+
+// Called from USBCB_SOF_Handler(). A gap in the frame number is a frame whose
+// SOF was not serviced before the next one.
+void Benchmark_SOF(void)
+{
+	WORD frameNumber = mGetFrameNumber();
+	WORD missed = 0;
+
+	if (LastFrameNumberValid && frameNumber != LastFrameNumber)
+		missed = (frameNumber - LastFrameNumber - 1) & 0x7FF;
+	LastFrameNumber = frameNumber;
+	LastFrameNumberValid = 1;
+
+	Stats_INTF0.Sofs++;
+	Stats_INTF0.MissedSofs+=missed;
+#ifdef DUAL_INTERFACE
+	Stats_INTF1.Sofs++;
+	Stats_INTF1.MissedSofs+=missed;
+#endif
+}
+
 void Benchmark_ProcessIO(void)
 {
 	//Blink the LEDs according to the USB device status, but only do so if the PC application isn't connected and controlling the LEDs.
@@ -371,9 +538,49 @@ void Benchmark_ProcessIO(void)
 		return;
 	}
 
+#if !defined(TRANSFER_EVENTS_ENABLED)
+	doBenchmarkIO_INTF0();
+#ifdef DUAL_INTERFACE
+	doBenchmarkIO_INTF1();
+#endif
+#endif
+
+}//end Benchmark_ProcessIO
+
+#if defined(TRANSFER_EVENTS_ENABLED)
+// Called from USBDeviceTasks() for every transaction completed on a data
+// endpoint; pdata points to the USTAT value of the transaction. In USB_INTERRUPT
+// mode this is interrupt context, as are USBCBInitEP() and USBCBCheckOtherReq(),
+// so the BDTs are never touched from the main loop.
+void USBCBTransferEvent(void* pdata)
+{
+	USTAT_FIELDS ustat;
+
+	ustat.Val = *((BYTE*)pdata);
+	switch (USBHALGetLastEndpoint(ustat))
+	{
+	case USBGEN_EP_NUM_INTF0:
+		mServiceTransfers(INTF0);
+		break;
+#ifdef DUAL_INTERFACE
+	case USBGEN_EP_NUM_INTF1:
+		mServiceTransfers(INTF1);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+#endif
+
+// Starts a new test when the test type changes and services the endpoints
+// for the current one.
+void doBenchmarkIO_INTF0(void)
+{
 	if (TestType_INTF0!=PrevTestType_INTF0)
 	{
-		FillCount_INTF0=0;
+		if (TestType_INTF0==TEST_PCREAD)
+			mFillBuffers(INTF0);
 		NextPacketKey_INTF0=0;
 		PrevTestType_INTF0=TestType_INTF0;
 	}
@@ -387,17 +594,22 @@ void Benchmark_ProcessIO(void)
 		doBenchmarkRead_INTF0();
 		break;
 	case TEST_LOOP:
+	case TEST_LATENCY:
 		doBenchmarkLoop_INTF0();
 		break;
 	default:
 		doBenchmarkRead_INTF0();
 		break;
 	}
+}
 
 #ifdef DUAL_INTERFACE
+void doBenchmarkIO_INTF1(void)
+{
 	if (TestType_INTF1!=PrevTestType_INTF1)
 	{
-		FillCount_INTF1=0;
+		if (TestType_INTF1==TEST_PCREAD)
+			mFillBuffers(INTF1);
 		NextPacketKey_INTF1=0;
 		PrevTestType_INTF1=TestType_INTF1;
 	}
@@ -411,16 +623,16 @@ void Benchmark_ProcessIO(void)
 		doBenchmarkRead_INTF1();
 		break;
 	case TEST_LOOP:
+	case TEST_LATENCY:
 		doBenchmarkLoop_INTF1();
 		break;
 	default:
 		doBenchmarkRead_INTF1();
 		break;
 	}
+}
 #endif
 
-}//end Benchmark_ProcessIO
-
 void doBenchmarkWrite_INTF0(void)
 {
 	WORD Length;
@@ -435,7 +647,8 @@ void doBenchmarkWrite_INTF0(void)
 		#endif
 
 		pBufferTx = USBHandleGetAddr(pBdtTxEp1);
-		mSetWritePacketID(pBufferTx, Length, FillCount_INTF0, NextPacketKey_INTF0);
+		mSetWritePacketID(pBufferTx, NextPacketKey_INTF0);
+		countTransfer(&Stats_INTF0, &Armed_INTF0, pBdtTxEp1, IN_TO_HOST);
 		mBDT_FillTransfer(pBdtTxEp1, pBufferTx, Length);
 		mSubmitTransfer_INTF0(pBdtTxEp1, Length);
 
@@ -462,6 +675,10 @@ void doBenchmarkLoop_INTF0(void)
 		#else
 			Length = mBDT_GetLength(pBdtRxEp1);
 		#endif
+		if (TestType_INTF0==TEST_LATENCY)
+			mStampLatency(pBufferTx, Length);
+		countTransfer(&Stats_INTF0, &Armed_INTF0, pBdtRxEp1, OUT_FROM_HOST);
+		countTransfer(&Stats_INTF0, &Armed_INTF0, pBdtTxEp1, IN_TO_HOST);
 		mBDT_FillTransfer(pBdtTxEp1, pBufferTx, Length);
 		mSubmitTransfer_INTF0(pBdtTxEp1, Length);
 		mBDT_TogglePP(pBdtTxEp1);
@@ -493,6 +710,7 @@ void doBenchmarkRead_INTF0(void)
 		#endif
 
 		pBufferRx = USBHandleGetAddr(pBdtRxEp1);
+		countTransfer(&Stats_INTF0, &Armed_INTF0, pBdtRxEp1, OUT_FROM_HOST);
 		mBDT_FillTransfer(pBdtRxEp1, pBufferRx, Length);
 		mSubmitTransfer_INTF0(pBdtRxEp1, Length);
 		mBDT_TogglePP(pBdtRxEp1);
@@ -506,7 +724,8 @@ void doBenchmarkWrite_INTF1(void)
 	if (!USBHandleBusy(pBdtTxEp2))
 	{
 		pBufferTx = USBHandleGetAddr(pBdtTxEp2);
-		mSetWritePacketID(pBufferTx, USBGEN_EP_SIZE_INTF1, FillCount_INTF1, NextPacketKey_INTF1);
+		mSetWritePacketID(pBufferTx, NextPacketKey_INTF1);
+		countTransfer(&Stats_INTF1, &Armed_INTF1, pBdtTxEp2, IN_TO_HOST);
 		mBDT_FillTransfer(pBdtTxEp2, pBufferTx, USBGEN_EP_SIZE_INTF1);
 		mSubmitTransfer_INTF1(pBdtTxEp2, USBGEN_EP_SIZE_INTF1);
 
@@ -529,6 +748,10 @@ void doBenchmarkLoop_INTF1(void)
 #else
 		Length = mBDT_GetLength(pBdtRxEp2);
 #endif
+		if (TestType_INTF1==TEST_LATENCY)
+			mStampLatency(pBufferTx, Length);
+		countTransfer(&Stats_INTF1, &Armed_INTF1, pBdtRxEp2, OUT_FROM_HOST);
+		countTransfer(&Stats_INTF1, &Armed_INTF1, pBdtTxEp2, IN_TO_HOST);
 		mBDT_FillTransfer(pBdtTxEp2, pBufferTx, Length);
 		mSubmitTransfer_INTF1(pBdtTxEp2, Length);
 		mBDT_TogglePP(pBdtTxEp2);
@@ -547,6 +770,7 @@ void doBenchmarkRead_INTF1(void)
 	if (!USBHandleBusy(pBdtRxEp2))
 	{
 		pBufferRx = USBHandleGetAddr(pBdtRxEp2);
+		countTransfer(&Stats_INTF1, &Armed_INTF1, pBdtRxEp2, OUT_FROM_HOST);
 		mBDT_FillTransfer(pBdtRxEp2, pBufferRx, USBGEN_EP_SIZE_INTF1);
 		mSubmitTransfer_INTF1(pBdtRxEp2, USBGEN_EP_SIZE_INTF1);
 		mBDT_TogglePP(pBdtRxEp2);
@@ -44,7 +44,8 @@ enum TestType
     TEST_NONE,
     TEST_PCREAD,
     TEST_PCWRITE,
-    TEST_LOOP
+    TEST_LOOP,
+    TEST_LATENCY	= 0x07
 };
 
 // PicFW Vendor-Specific Requests
@@ -54,12 +55,43 @@ enum PICFW_COMMANDS
     PICFW_GET_TEST		= 0x0F,
 	PICFW_SET_VENDOR_BUFFER= 0x10,
 	PICFW_GET_VENDOR_BUFFER= 0x11,
+	PICFW_GET_STATS		= 0x12,
 };
 
+// GET_STATS counter block; little-endian, the layout kBench decodes
+// (libusbK/src/kBench/kBench_stats.h). One per interface.
+#define BM_STATS_VERSION		1
+#define BM_STATS_FLAG_SOFS		0x0001	// Sofs and MissedSofs are maintained.
+#define BM_STATS_FLAG_NAK_FLAGS	0x0002	// Starved counts are controller NAK flags.
+
+typedef struct _BM_STATS
+{
+	BYTE  Length;
+	BYTE  Version;
+	WORD  Flags;
+	DWORD Transfers[2];		// [OUT_FROM_HOST] and [IN_TO_HOST]; packets taken from (OUT) or given to (IN) the host.
+	DWORD Bytes[2];
+	DWORD Starved[2];		// Times every ping-pong buffer of the endpoint was found returned by the SIE.
+	DWORD Sofs;
+	DWORD MissedSofs;		// Frames between two SOF handler calls, less one.
+} BM_STATS;
+
+// Latency test stamp (libusbK/src/kBench/kBench_latency.h). The latency test
+// runs the loop test; the host stamps the first six bytes of every packet and
+// the firmware writes the frame number at BM_LATENCY_FRAME_OFFSET
+// (little-endian) before echoing it. Full-speed only; no microframe.
+#define BM_LATENCY_STAMP_LENGTH		8
+#define BM_LATENCY_FRAME_OFFSET		6
+#define BM_LATENCY_FRAME_STAMPED	0x8000
+
 /** BMARK CALLBACKS ************************************************/
 void USBCBCheckOtherReq(void);
 void USBCBInitEP(void);
 void USBCBStdSetDscHandler(void);
+#if defined(TRANSFER_EVENTS_ENABLED)
+void USBCBTransferEvent(void* pdata);
+#endif
+void Benchmark_SOF(void);
 
 /** USB FW EXTERNS DEFINES *****************************************/
 extern volatile CTRL_TRF_SETUP SetupPkt;
@@ -0,0 +1,363 @@
+/// bm_sim.c
+/// Host build of the benchmark firmware.
+
+/* USB Benchmark for libusb-win32
+
+    Copyright  2010 Travis Robinson. <libusbdotnet@gmail.com>
+    website: http://sourceforge.net/projects/libusb-win32
+ 
+    Software License Agreement:
+    
+    The software supplied herewith is intended for use solely and
+    exclusively on Microchip PIC Microcontroller products. This 
+    software is owned by Travis Robinson, and is protected under
+	applicable copyright laws. All rights are reserved. Any use in 
+	violation of the foregoing restrictions may subject the user to 
+	criminal sanctions under applicable laws, as well as to civil 
+	liability for the breach of the terms and conditions of this
+    license.
+
+	You may redistribute and/or modify this file under the terms
+	described above.
+    
+    THIS SOFTWARE IS PROVIDED IN AN AS IS CONDITION. NO WARRANTIES,
+    WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT NOT LIMITED
+    TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. THE OWNER SHALL NOT,
+    IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL OR
+    CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.	
+*/
+
+// Host build of the benchmark firmware. (see mcp_sim.h)
+//
+// Configures the firmware, then for every interface and test selects the
+// test the way kBench does (the SET_TEST vendor request with wIndex =
+// interface number) and runs the bus for a while. Every run starts from a
+// device reset.
+//
+// bm_sim [test=loop|read|write|latency|all] [time=<ms>] [bw=<bus bytes per frame>]
+//        [overhead=<bytes per packet>] [loop=<bus bytes per main loop pass>]
+//        [isr=<bytes per USTAT entry>] [usb=int|poll]
+//
+// Prints the packets moved per frame in each direction and the firmware's
+// GET_STATS counters for the run, decoded the way kBench does, and for the
+// latency test the latency distributions. Exits non-zero if a transfer fails
+// verification, an active endpoint moves no data, the firmware counters
+// disagree with what the host moved or a latency test packet is reordered,
+// not stamped or (bulk/interrupt) lost.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcp_sim.h"
+#include "Benchmark.h"
+#include "BDT_transfer.h"
+#include "kBench_stats.h"
+#include "kBench_latency.h"
+
+typedef struct
+{
+	BYTE Number;
+	BYTE EpNum;
+	BYTE EpType;
+	WORD EpSize;
+} BM_SIM_INTF;
+
+static const BM_SIM_INTF Bm_Sim_Interfaces[] =
+{
+	{INTF0_NUMBER, USBGEN_EP_NUM_INTF0, INTF0, USBGEN_EP_SIZE_INTF0},
+#if defined(DUAL_INTERFACE)
+	{INTF1_NUMBER, USBGEN_EP_NUM_INTF1, INTF1, USBGEN_EP_SIZE_INTF1},
+#endif
+};
+
+static const BYTE Bm_Sim_Tests[] = { TEST_PCREAD, TEST_PCWRITE, TEST_LOOP, TEST_LATENCY };
+static const char* const Bm_Sim_TestNames[] = { "none", "read", "write", "loop" };
+static const char* const Bm_Sim_EpTypeNames[] = { "ctrl", "iso", "bulk", "int" };
+
+// main.c
+volatile WORD led_count;
+
+void BlinkUSBStatus(void)
+{
+}
+
+BOOL USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, WORD size)
+{
+	switch(event)
+	{
+	case EVENT_CONFIGURED:
+		USBCBInitEP();
+		break;
+	case EVENT_SET_DESCRIPTOR:
+		USBCBStdSetDscHandler();
+		break;
+	case EVENT_EP0_REQUEST:
+		USBCBCheckOtherReq();
+		break;
+	case EVENT_SOF:
+		Benchmark_SOF();
+		break;
+	case EVENT_TRANSFER:
+#if defined(TRANSFER_EVENTS_ENABLED)
+		USBCBTransferEvent(pdata);
+#endif
+		break;
+	default:
+		break;
+	}
+	return TRUE;
+}
+
+// kBench Bench_GetStats
+static BOOL Bm_Sim_GetStats(const BM_SIM_INTF* Intf, BM_DEVICE_STATS* Stats)
+{
+	BYTE Data[BM_STATS_LENGTH];
+	WORD Transferred;
+
+	if (!MCPSim_VendorRequest(PICFW_GET_STATS, 0, Intf->Number, sizeof(Data), Data, &Transferred))
+		return FALSE;
+	return BmStats_Decode(Stats, Data, Transferred) == 0;
+}
+
+// The firmware counts a packet when it re-arms the BDT; up to PP_COUNT
+// packets per direction can fall on the other side of either snapshot.
+static int Bm_Sim_CheckStats(const BM_DEVICE_STATS* Delta, MCPSIM_EP_STATS* Out, MCPSIM_EP_STATS* In, DWORD Frames)
+{
+	int Problems = 0;
+	long Diff;
+	int Dir;
+
+	for (Dir = 0; Dir < 2; Dir++)
+	{
+		MCPSIM_EP_STATS* Host = (Dir == BM_STATS_OUT) ? Out : In;
+
+		Diff = (long)Host->Packets - (long)Delta->Transfers[Dir];
+		if (labs(Diff) > PP_COUNT)
+			Problems++;
+		Diff = (long)Host->Bytes - (long)Delta->Bytes[Dir];
+		if (labs(Diff) > (long)PP_COUNT * Host->Size)
+			Problems++;
+	}
+
+	Diff = (long)(Delta->Sofs + Delta->MissedSofs) - (long)Frames;
+	if (!(Delta->Flags & BM_STATS_FLAG_SOFS) || Diff < -1 || Diff > 1)
+		Problems++;
+
+	return Problems;
+}
+
+static const char* Bm_Sim_TestName(BYTE TestType)
+{
+	return (TestType == TEST_LATENCY) ? "lat" : Bm_Sim_TestNames[TestType & 3];
+}
+
+// Every echoed packet must carry both stamps, in order; iso packets the
+// device was not ready for are lost. The simulated clock is exact at each
+// frame start, so one-way times are good to half a full speed frame. A
+// round trip under twice that is not split; the others are split at the
+// middle of the frame, so they add up to it exactly and neither exceeds it.
+static int Bm_Sim_CheckLatency(const BM_LATENCY_RESULT* Latency, BOOL Iso)
+{
+	if (!Latency->Packets || Latency->Reordered || Latency->Unstamped || (Latency->Lost && !Iso))
+		return 1;
+	if (Latency->OutLatency.Count + Latency->OneWaySkipped != Latency->Packets || Latency->RoundTrip.MinUs <= 0)
+		return 1;
+	if (Latency->ResolutionUs != 500)
+		return 1;
+
+	if (Latency->RoundTrip.MaxUs < 2 * 500 && Latency->OutLatency.Count)
+		return 1;
+	if (Latency->RoundTrip.MinUs >= 2 * 500 && Latency->OneWaySkipped)
+		return 1;
+	if (!Latency->OneWaySkipped && Latency->OutLatency.TotalUs + Latency->InLatency.TotalUs != Latency->RoundTrip.TotalUs)
+		return 1;
+	return (Latency->OutLatency.MaxUs > Latency->RoundTrip.MaxUs || Latency->InLatency.MaxUs > Latency->RoundTrip.MaxUs) ? 1 : 0;
+}
+
+static void Bm_Sim_PrintLatency(const BM_LATENCY_RESULT* Latency)
+{
+	char Line[256];
+
+	BmLatency_Format(Line, sizeof(Line), Latency);
+	printf("      Latency: %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->RoundTrip);
+	printf("        round trip     %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->OutLatency);
+	printf("        host to device %s\n", Line);
+	BmLatency_FormatHistogram(Line, sizeof(Line), &Latency->InLatency);
+	printf("        device to host %s\n", Line);
+}
+
+static int Bm_Sim_Run(const BM_SIM_INTF* Intf, BYTE TestType, DWORD Frames)
+{
+	MCPSIM_EP_STATS* Out;
+	MCPSIM_EP_STATS* In;
+	BM_DEVICE_STATS Before, After, Delta;
+	char Line[256];
+	BYTE Response = 0xFF;
+	WORD Transferred;
+	BOOL IsoLoop;
+	int Problems = 0;
+	DWORD i;
+
+	Benchmark_Init();
+	MCPSim_Configure();
+#if defined(SINGLE_INTERFACE_WITH_ALTSETTINGS)
+	USBAlternateInterface[INTF0_NUMBER] = 1;
+#endif
+
+	// kBench Bench_SetTestType
+	if (!MCPSim_VendorRequest(PICFW_SET_TEST, TestType, Intf->Number, 1, &Response, &Transferred) ||
+	        Transferred != 1 || Response != TestType)
+	{
+		printf("SET_TEST %u on interface %u failed\n", TestType, Intf->Number);
+		return 1;
+	}
+
+	MCPSim_ClearHostModes();
+	switch (TestType)
+	{
+	case TEST_PCREAD:
+		MCPSim_SetHostMode(0x80 | Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_PATTERN);
+		break;
+	case TEST_PCWRITE:
+		MCPSim_SetHostMode(Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_PATTERN);
+		break;
+	case TEST_LOOP:
+		MCPSim_SetHostMode(Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_SEQUENCE);
+		MCPSim_SetHostMode(0x80 | Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_SEQUENCE);
+		break;
+	case TEST_LATENCY:
+		MCPSim_SetHostMode(Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_LATENCY);
+		MCPSim_SetHostMode(0x80 | Intf->EpNum, Intf->EpType, Intf->EpSize, MCPSIM_HOST_LATENCY);
+		break;
+	}
+
+	// Let the firmware pick up the new test before counting.
+	MCPSim_RunFrame();
+	MCPSim_ResetStats();
+	if (!Bm_Sim_GetStats(Intf, &Before))
+	{
+		printf("GET_STATS on interface %u failed\n", Intf->Number);
+		return 1;
+	}
+	for (i = 0; i < Frames; i++)
+		MCPSim_RunFrame();
+	if (!Bm_Sim_GetStats(Intf, &After))
+	{
+		printf("GET_STATS on interface %u failed\n", Intf->Number);
+		return 1;
+	}
+	BmStats_Delta(&Delta, &After, &Before);
+
+	Out = MCPSim_GetEpStats(Intf->EpNum);
+	In = MCPSim_GetEpStats(0x80 | Intf->EpNum);
+
+	// Iso packets the device was not ready for are lost; the loop sequence has gaps.
+	IsoLoop = ((TestType == TEST_LOOP || TestType == TEST_LATENCY) && Intf->EpType == EP_ISO);
+
+	if (TestType != TEST_PCREAD && !Out->Packets)
+		Problems++;
+	if (TestType != TEST_PCWRITE && !In->Packets)
+		Problems++;
+	if (Out->Errors)
+		Problems++;
+	if (In->Errors && !IsoLoop)
+		Problems++;
+	Problems += Bm_Sim_CheckStats(&Delta, Out, In, Frames);
+	if (TestType == TEST_LATENCY)
+		Problems += Bm_Sim_CheckLatency(&In->Latency, Intf->EpType == EP_ISO);
+
+	printf("%4u  %-5s %4u  %-5s %7.2f %7.2f %8.1f %7u %7u %7u %6u %6u %5u%s\n",
+	       Intf->Number, Bm_Sim_EpTypeNames[Intf->EpType], Intf->EpSize, Bm_Sim_TestName(TestType),
+	       (double)Out->Packets / Frames,
+	       (double)In->Packets / Frames,
+	       (double)(Out->Bytes + In->Bytes) * 1000.0 / 1024.0 / Frames,
+	       Out->NAKs + In->NAKs, Out->FifoNAKs + In->FifoNAKs, Out->Missed + In->Missed,
+	       Out->Errors, In->Errors, MCPSim_UstatHighWater(),
+	       Problems ? "  FAIL" : "");
+	BmStats_Format(Line, sizeof(Line), &Delta);
+	printf("      %s\n", Line);
+	if (TestType == TEST_LATENCY)
+		Bm_Sim_PrintLatency(&In->Latency);
+
+	MCPSim_ClearHostModes();
+
+	return Problems;
+}
+
+int main(int argc, char** argv)
+{
+	MCPSIM_CONFIG Config;
+	int TestType = -1;
+	DWORD TimeMs = 200;
+	int Failures = 0;
+	int Runs = 0;
+	int i, Test;
+
+	Config.BusBytes = 1500;
+	Config.PacketOverhead = 13;
+	Config.MainLoopBytes = 150;
+	Config.IsrBytes = 10;
+	Config.Polling = FALSE;
+	Config.MainLoop = Benchmark_ProcessIO;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "test=loop"))
+			TestType = TEST_LOOP;
+		else if (!strcmp(argv[i], "test=read"))
+			TestType = TEST_PCREAD;
+		else if (!strcmp(argv[i], "test=write"))
+			TestType = TEST_PCWRITE;
+		else if (!strcmp(argv[i], "test=latency"))
+			TestType = TEST_LATENCY;
+		else if (!strcmp(argv[i], "test=all"))
+			TestType = -1;
+		else if (!strncmp(argv[i], "time=", 5))
+			TimeMs = strtoul(argv[i] + 5, NULL, 0);
+		else if (!strncmp(argv[i], "bw=", 3))
+			Config.BusBytes = (WORD)strtoul(argv[i] + 3, NULL, 0);
+		else if (!strncmp(argv[i], "overhead=", 9))
+			Config.PacketOverhead = (WORD)strtoul(argv[i] + 9, NULL, 0);
+		else if (!strncmp(argv[i], "loop=", 5))
+			Config.MainLoopBytes = (WORD)strtoul(argv[i] + 5, NULL, 0);
+		else if (!strncmp(argv[i], "isr=", 4))
+			Config.IsrBytes = (WORD)strtoul(argv[i] + 4, NULL, 0);
+		else if (!strcmp(argv[i], "usb=int"))
+			Config.Polling = FALSE;
+		else if (!strcmp(argv[i], "usb=poll"))
+			Config.Polling = TRUE;
+		else
+		{
+			printf("usage: bm_sim [test=loop|read|write|latency|all] [time=<ms>] [bw=<bytes>] [overhead=<bytes>]\n"
+			       "              [loop=<bytes>] [isr=<bytes>] [usb=int|poll]\n");
+			return 2;
+		}
+	}
+	if (!TimeMs)
+		TimeMs = 1;
+
+	MCPSim_Init(&Config);
+
+#if defined(TRANSFER_EVENTS_ENABLED)
+	printf("endpoints serviced from EVENT_TRANSFER, %s\n", Config.Polling ? "USB_POLLING" : "USB_INTERRUPT");
+#else
+	printf("endpoints serviced from the main loop, %s\n", Config.Polling ? "USB_POLLING" : "USB_INTERRUPT");
+#endif
+	printf("intf  type  size  test   out/fr   in/fr     KB/s    naks fifonak  missed oerrs  ierrs ustat\n");
+	for (i = 0; i < (int)(sizeof(Bm_Sim_Interfaces) / sizeof(Bm_Sim_Interfaces[0])); i++)
+	{
+		for (Test = 0; Test < (int)sizeof(Bm_Sim_Tests); Test++)
+		{
+			if (TestType >= 0 && Bm_Sim_Tests[Test] != TestType)
+				continue;
+			Failures += Bm_Sim_Run(&Bm_Sim_Interfaces[i], Bm_Sim_Tests[Test], TimeMs) ? 1 : 0;
+			Runs++;
+		}
+	}
+
+	printf("%d runs, %d failed\n", Runs, Failures);
+	return Failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/// GenericTypeDefs.h
+/// Host build of the simulated controller. (see mcp_sim.h)
+
+/* USB Benchmark for libusb-win32
+
+    Copyright  2010 Travis Robinson. <libusbdotnet@gmail.com>
+    website: http://sourceforge.net/projects/libusb-win32
+ 
+    Software License Agreement:
+    
+    The software supplied herewith is intended for use solely and
+    exclusively on Microchip PIC Microcontroller products. This 
+    software is owned by Travis Robinson, and is protected under
+	applicable copyright laws. All rights are reserved. Any use in 
+	violation of the foregoing restrictions may subject the user to 
+	criminal sanctions under applicable laws, as well as to civil 
+	liability for the breach of the terms and conditions of this
+    license.
+
+	You may redistribute and/or modify this file under the terms
+	described above.
+    
+    THIS SOFTWARE IS PROVIDED IN AN AS IS CONDITION. NO WARRANTIES,
+    WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT NOT LIMITED
+    TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. THE OWNER SHALL NOT,
+    IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL OR
+    CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.	
+*/
+
+// Host build type definitions; replaces Microchip/Include/GenericTypeDefs.h,
+// whose DWORD is 64 bits wide on a 64-bit host.
+
+#ifndef _GENERICTYPEDEFS_H_
+#define _GENERICTYPEDEFS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum _BOOL { FALSE = 0, TRUE } BOOL;
+
+typedef uint8_t		BYTE;
+typedef uint16_t	WORD;
+typedef uint32_t	DWORD;
+typedef uint64_t	QWORD;
+typedef int8_t		CHAR;
+typedef int16_t		SHORT;
+typedef int32_t		INT32;
+
+typedef union
+{
+	BYTE Val;
+	struct
+	{
+		BYTE b0:1;
+		BYTE b1:1;
+		BYTE b2:1;
+		BYTE b3:1;
+		BYTE b4:1;
+		BYTE b5:1;
+		BYTE b6:1;
+		BYTE b7:1;
+	} bits;
+} BYTE_VAL;
+
+typedef union
+{
+	WORD Val;
+	BYTE v[2];
+	struct
+	{
+		BYTE LB;
+		BYTE HB;
+	} byte;
+} WORD_VAL;
+
+#define ROM		const
+#define Nop()
+
+#endif
@@ -0,0 +1,270 @@
+/// usb.h
+/// Host build of the simulated controller. (see mcp_sim.h)
+
+/* USB Benchmark for libusb-win32
+
+    Copyright  2010 Travis Robinson. <libusbdotnet@gmail.com>
+    website: http://sourceforge.net/projects/libusb-win32
+ 
+    Software License Agreement:
+    
+    The software supplied herewith is intended for use solely and
+    exclusively on Microchip PIC Microcontroller products. This 
+    software is owned by Travis Robinson, and is protected under
+	applicable copyright laws. All rights are reserved. Any use in 
+	violation of the foregoing restrictions may subject the user to 
+	criminal sanctions under applicable laws, as well as to civil 
+	liability for the breach of the terms and conditions of this
+    license.
+
+	You may redistribute and/or modify this file under the terms
+	described above.
+    
+    THIS SOFTWARE IS PROVIDED IN AN AS IS CONDITION. NO WARRANTIES,
+    WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT NOT LIMITED
+    TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. THE OWNER SHALL NOT,
+    IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL OR
+    CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.	
+*/
+
+// Host build of the parts of the Microchip USB device stack the benchmark
+// firmware uses, laid out as on PIC32 (8 byte BDT entries, full ping-pong).
+// The stack itself is simulated by mcp_sim.c.
+
+#ifndef _USB_H_
+#define _USB_H_
+
+#include "GenericTypeDefs.h"
+
+#define USB_PING_PONG__NO_PING_PONG		0x00
+#define USB_PING_PONG__EP0_OUT_ONLY		0x01
+#define USB_PING_PONG__FULL_PING_PONG	0x02
+#define USB_PING_PONG__ALL_BUT_EP0		0x03
+
+#define USB_PULLUP_ENABLE			0x10
+#define USB_PULLUP_DISABLED			0x00
+#define USB_INTERNAL_TRANSCEIVER	0x00
+#define USB_EXTERNAL_TRANSCEIVER	0x01
+#define USB_FULL_SPEED				0x00
+#define USB_LOW_SPEED				0x04
+
+#include "usb_config.h"
+
+#if (USB_PING_PONG_MODE != USB_PING_PONG__FULL_PING_PONG)
+	#error "The simulated controller only supports USB_PING_PONG__FULL_PING_PONG."
+#endif
+
+#define USB_VOLATILE volatile
+
+#define OUT_FROM_HOST	0
+#define IN_TO_HOST		1
+
+// Buffer Descriptor Status Register layout.
+typedef union __attribute__ ((packed)) _BD_STAT
+{
+	struct __attribute__ ((packed))
+	{
+		BYTE		:2;
+		BYTE BSTALL	:1;
+		BYTE DTSEN	:1;
+		BYTE		:2;
+		BYTE DTS	:1;
+		BYTE UOWN	:1;
+	};
+	struct __attribute__ ((packed))
+	{
+		BYTE		:2;
+		BYTE PID	:4;
+		BYTE		:2;
+	};
+	WORD Val;
+} BD_STAT;
+
+// BDT Entry Layout
+typedef union __attribute__ ((packed)) __BDT
+{
+	struct __attribute__ ((packed))
+	{
+		BD_STAT	STAT;
+		WORD	CNT:10;
+		WORD	:6;
+		DWORD	ADR;
+	};
+	DWORD	w[2];
+	QWORD	Val;
+} BDT_ENTRY;
+
+#define _BSTALL		0x04
+#define _DTSEN		0x08
+#define _DAT0		0x00
+#define _DAT1		0x40
+#define _DTSMASK	0x40
+#define _USIE		0x80
+#define _UCPU		0x00
+
+// USTAT Register Layout
+typedef union __USTAT
+{
+	struct
+	{
+		BYTE filler1			:2;
+		BYTE ping_pong			:1;
+		BYTE direction			:1;
+		BYTE endpoint_number	:4;
+	};
+	BYTE Val;
+} USTAT_FIELDS;
+
+#define USBHALGetLastEndpoint(stat)		stat.endpoint_number
+#define USBHALGetLastDirection(stat)	stat.direction
+#define USBHALGetLastPingPong(stat)		stat.ping_pong
+
+// Frame number registers; set by the host at the start of every frame.
+extern volatile DWORD U1FRML;
+extern volatile DWORD U1FRMH;
+
+// Buffer addresses are 32 bit offsets from a base in host memory, the
+// way PIC32 BDTs hold physical addresses.
+extern uintptr_t MCPSim_RamBase;
+#define ConvertToPhysicalAddress(a)	((DWORD)((uintptr_t)(a) - MCPSim_RamBase))
+#define ConvertToVirtualAddress(a)	((void*)(MCPSim_RamBase + (INT32)(a)))
+
+#define USBHandleBusy(handle)		(handle==0?0:((volatile BDT_ENTRY*)handle)->STAT.UOWN)
+#define USBHandleGetAddr(handle)	ConvertToVirtualAddress((((volatile BDT_ENTRY*)handle)->ADR))
+
+#define USB_HANDSHAKE_ENABLED	0x01
+#define USB_HANDSHAKE_DISABLED	0x00
+#define USB_OUT_ENABLED			0x08
+#define USB_OUT_DISABLED		0x00
+#define USB_IN_ENABLED			0x04
+#define USB_IN_DISABLED			0x00
+#define USB_ALLOW_SETUP			0x00
+#define USB_DISALLOW_SETUP		0x10
+
+// Endpoint descriptor attributes used by usb_config.h
+#define _AS		0x04
+#define _DE		0x08
+
+// Device states
+typedef enum
+{
+	DETACHED_STATE		= 0x00,
+	ATTACHED_STATE		= 0x01,
+	POWERED_STATE		= 0x02,
+	DEFAULT_STATE		= 0x04,
+	ADR_PENDING_STATE	= 0x08,
+	ADDRESS_STATE		= 0x10,
+	CONFIGURED_STATE	= 0x20
+} USB_DEVICE_STATE;
+
+extern USB_VOLATILE USB_DEVICE_STATE USBDeviceState;
+
+extern BYTE MCPSim_Suspended;
+#define USBSuspendControl MCPSim_Suspended
+
+// Setup packet
+typedef union __attribute__ ((packed)) __CTRL_TRF_SETUP
+{
+	struct __attribute__ ((packed))
+	{
+		BYTE bmRequestType;
+		BYTE bRequest;
+		WORD wValue;
+		WORD wIndex;
+		WORD wLength;
+	};
+	struct __attribute__ ((packed))
+	{
+		BYTE Recipient		:5;
+		BYTE RequestType	:2;
+		BYTE DataDir		:1;
+	};
+	struct __attribute__ ((packed))
+	{
+		BYTE _reserved[2];
+		BYTE bDscIndex;
+		BYTE bDescriptorType;
+	};
+} CTRL_TRF_SETUP;
+
+#define USB_SETUP_TYPE_STANDARD_BITFIELD	0
+#define USB_SETUP_TYPE_CLASS_BITFIELD		1
+#define USB_SETUP_TYPE_VENDOR_BITFIELD		2
+
+#define USB_DESCRIPTOR_STRING	0x03
+
+// Control transfer pipes
+#define USB_EP0_ROM	0x00
+#define USB_EP0_RAM	0x01
+
+typedef struct
+{
+	union
+	{
+		BYTE* bRam;
+		ROM BYTE* bRom;
+		WORD* wRam;
+		ROM WORD* wRom;
+	} pSrc;
+	union
+	{
+		struct
+		{
+			BYTE ctrl_trf_mem	:1;
+			BYTE reserved		:5;
+			BYTE includeZero	:1;
+			BYTE busy			:1;
+		} bits;
+		BYTE Val;
+	} info;
+	WORD_VAL wCount;
+} IN_PIPE;
+
+typedef struct
+{
+	union
+	{
+		BYTE* bRam;
+		WORD* wRam;
+	} pDst;
+	union
+	{
+		struct
+		{
+			BYTE reserved	:7;
+			BYTE busy		:1;
+		} bits;
+		BYTE Val;
+	} info;
+	WORD_VAL wCount;
+	void (*pFunc)(void);
+} OUT_PIPE;
+
+extern USB_VOLATILE IN_PIPE inPipes[1];
+extern USB_VOLATILE OUT_PIPE outPipes[1];
+
+// Events
+typedef enum
+{
+	EVENT_NONE = 0,
+	EVENT_TRANSFER,
+	EVENT_SOF,
+	EVENT_RESUME,
+	EVENT_SUSPEND,
+	EVENT_RESET,
+	EVENT_DETACH,
+	EVENT_ATTACH,
+	EVENT_CONFIGURED,
+	EVENT_SET_DESCRIPTOR,
+	EVENT_EP0_REQUEST,
+	EVENT_BUS_ERROR,
+	EVENT_TRANSFER_TERMINATED
+} USB_EVENT;
+
+BOOL USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, WORD size);
+
+void USBDeviceTasks(void);
+void USBEnableEndpoint(BYTE ep, BYTE options);
+
+#endif
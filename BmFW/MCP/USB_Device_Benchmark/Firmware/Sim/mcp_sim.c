@@ -0,0 +1,507 @@
+/// mcp_sim.c
+/// Simulated USB module and host.
+
+/* USB Benchmark for libusb-win32
+
+    Copyright  2010 Travis Robinson. <libusbdotnet@gmail.com>
+    website: http://sourceforge.net/projects/libusb-win32
+ 
+    Software License Agreement:
+    
+    The software supplied herewith is intended for use solely and
+    exclusively on Microchip PIC Microcontroller products. This 
+    software is owned by Travis Robinson, and is protected under
+	applicable copyright laws. All rights are reserved. Any use in 
+	violation of the foregoing restrictions may subject the user to 
+	criminal sanctions under applicable laws, as well as to civil 
+	liability for the breach of the terms and conditions of this
+    license.
+
+	You may redistribute and/or modify this file under the terms
+	described above.
+    
+    THIS SOFTWARE IS PROVIDED IN AN AS IS CONDITION. NO WARRANTIES,
+    WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT NOT LIMITED
+    TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. THE OWNER SHALL NOT,
+    IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL OR
+    CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.	
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "mcp_sim.h"
+
+#define MCPSIM_EP_COUNT			(USB_MAX_EP_NUMBER+1)
+#define MCPSIM_MAX_PACKET_SIZE	1023
+
+// BDT index; full ping-pong.
+#define EP(ep,dir,pp)			(4*(ep)+2*(dir)+(pp))
+
+#define PID_OUT					0x1
+#define PID_IN					0x9
+
+typedef struct
+{
+	// USB module
+	BOOL Enabled;
+	BYTE PingPong;
+
+	// Host
+	BYTE Mode;
+	BYTE Toggle;
+	BYTE Key;
+	BOOL KeySeeded;
+	unsigned int LatencySeq;
+	BYTE Packet[MCPSIM_MAX_PACKET_SIZE];
+
+	MCPSIM_EP_STATS Stats;
+} MCPSIM_EP;
+
+static struct
+{
+	MCPSIM_CONFIG Config;
+	MCPSIM_EP Endpoints[MCPSIM_EP_COUNT][2];
+
+	USTAT_FIELDS Ustat[MCPSIM_USTAT_FIFO_DEPTH];
+	BYTE UstatHead;
+	BYTE UstatCount;
+	BYTE UstatHighWater;
+
+	long CpuCredit;
+	BYTE BulkNext;
+
+	WORD FrameNumber;
+	BOOL SofPending;
+
+	// Latency test host clock; frames run since MCPSim_Init.
+	DWORD Frames;
+	BM_LATENCY_CLOCK LatencyClock;
+} Sim;
+
+// Stack and USB module state used by the firmware.
+uintptr_t MCPSim_RamBase;
+BYTE MCPSim_Suspended;
+USB_VOLATILE USB_DEVICE_STATE USBDeviceState;
+volatile CTRL_TRF_SETUP SetupPkt;
+USB_VOLATILE IN_PIPE inPipes[1];
+USB_VOLATILE OUT_PIPE outPipes[1];
+USB_VOLATILE BYTE USBAlternateInterface[USB_MAX_NUM_INT];
+volatile BDT_ENTRY* pBDTEntryOut[USB_MAX_EP_NUMBER+1];
+volatile BDT_ENTRY* pBDTEntryIn[USB_MAX_EP_NUMBER+1];
+volatile BDT_ENTRY BDT[MCPSIM_EP_COUNT*4] __attribute__ ((aligned (512)));
+volatile DWORD U1FRML;
+volatile DWORD U1FRMH;
+
+// Benchmark pattern; 0..255, then 1..255 repeating. Byte 1 is the packet key.
+static BYTE MCPSim_Pattern(WORD Index)
+{
+	return (Index < 256) ? (BYTE)Index : (BYTE)(((Index - 256) % 255) + 1);
+}
+
+static MCPSIM_EP* MCPSim_GetEndpoint(BYTE EndpointAddress)
+{
+	return &Sim.Endpoints[(EndpointAddress & 0x0F) % MCPSIM_EP_COUNT][(EndpointAddress & 0x80) ? IN_TO_HOST : OUT_FROM_HOST];
+}
+
+/*****************************************************************************
+ * USB device stack
+ *****************************************************************************/
+static void MCPSim_ConfigureEndpoint(BYTE ep, BYTE direction)
+{
+	volatile BDT_ENTRY* handle = &BDT[EP(ep,direction,0)];
+
+	handle->STAT.UOWN = 0;
+	handle->STAT.DTS = 0;
+	(handle+1)->STAT.DTS = 1;
+
+	if (direction == OUT_FROM_HOST)
+		pBDTEntryOut[ep] = handle;
+	else
+		pBDTEntryIn[ep] = handle;
+
+	Sim.Endpoints[ep][direction].Enabled = TRUE;
+	Sim.Endpoints[ep][direction].PingPong = 0;
+}
+
+void USBEnableEndpoint(BYTE ep, BYTE options)
+{
+	if (ep >= MCPSIM_EP_COUNT)
+		return;
+
+	if (options & USB_OUT_ENABLED)
+		MCPSim_ConfigureEndpoint(ep, OUT_FROM_HOST);
+	if (options & USB_IN_ENABLED)
+		MCPSim_ConfigureEndpoint(ep, IN_TO_HOST);
+}
+
+// SOF and transaction complete servicing (Task D of the stack's USBDeviceTasks).
+void USBDeviceTasks(void)
+{
+	USTAT_FIELDS ustat;
+	BYTE i;
+
+	if (Sim.SofPending)
+	{
+		Sim.SofPending = FALSE;
+		Sim.CpuCredit -= Sim.Config.IsrBytes;
+		USER_USB_CALLBACK_EVENT_HANDLER(EVENT_SOF, 0, 1);
+	}
+
+	for (i = 0; i < 4u && Sim.UstatCount; i++)
+	{
+		ustat = Sim.Ustat[Sim.UstatHead];
+		Sim.UstatHead = (Sim.UstatHead + 1) % MCPSIM_USTAT_FIFO_DEPTH;
+		Sim.UstatCount--;
+
+		Sim.CpuCredit -= Sim.Config.IsrBytes;
+		if (USBHALGetLastEndpoint(ustat) != 0)
+			USER_USB_CALLBACK_EVENT_HANDLER(EVENT_TRANSFER, (BYTE*)&ustat.Val, 0);
+	}
+}
+
+/*****************************************************************************
+ * Host
+ *****************************************************************************/
+void MCPSim_Init(const MCPSIM_CONFIG* Config)
+{
+	memset(&Sim, 0, sizeof(Sim));
+	Sim.Config = *Config;
+	MCPSim_RamBase = (uintptr_t)BDT;
+	if (!Sim.Config.MainLoopBytes)
+		Sim.Config.MainLoopBytes = 1;
+
+	USBDeviceState = DETACHED_STATE;
+}
+
+void MCPSim_Configure(void)
+{
+	BYTE ep, dir;
+
+	memset((void*)BDT, 0, sizeof(BDT));
+	memset((void*)USBAlternateInterface, 0, sizeof(USBAlternateInterface));
+	for (ep = 0; ep < MCPSIM_EP_COUNT; ep++)
+	{
+		for (dir = 0; dir < 2; dir++)
+		{
+			Sim.Endpoints[ep][dir].Enabled = FALSE;
+			Sim.Endpoints[ep][dir].PingPong = 0;
+			Sim.Endpoints[ep][dir].Toggle = 0;
+		}
+	}
+	Sim.UstatCount = 0;
+
+	USBDeviceState = CONFIGURED_STATE;
+	USER_USB_CALLBACK_EVENT_HANDLER(EVENT_CONFIGURED, 0, 0);
+}
+
+BOOL MCPSim_VendorRequest(BYTE bRequest, WORD wValue, WORD wIndex, WORD wLength, BYTE* Data, WORD* Transferred)
+{
+	WORD length;
+
+	SetupPkt.bmRequestType = 0xC0;
+	SetupPkt.bRequest = bRequest;
+	SetupPkt.wValue = wValue;
+	SetupPkt.wIndex = wIndex;
+	SetupPkt.wLength = wLength;
+
+	inPipes[0].info.Val = 0;
+	inPipes[0].wCount.Val = 0;
+	USER_USB_CALLBACK_EVENT_HANDLER(EVENT_EP0_REQUEST, 0, 0);
+
+	*Transferred = 0;
+	if (!inPipes[0].info.bits.busy)
+		return FALSE;
+
+	length = (inPipes[0].wCount.Val < wLength) ? inPipes[0].wCount.Val : wLength;
+	memcpy(Data, (const void*)inPipes[0].pSrc.bRam, length);
+	*Transferred = length;
+	return TRUE;
+}
+
+void MCPSim_SetHostMode(BYTE EndpointAddress, BYTE Type, WORD Size, BYTE Mode)
+{
+	MCPSIM_EP* e = MCPSim_GetEndpoint(EndpointAddress);
+
+	e->Mode = Mode;
+	e->Key = 0;
+	e->KeySeeded = FALSE;
+	e->LatencySeq = 0;
+	e->Stats.Type = Type;
+	e->Stats.Size = (Size < MCPSIM_MAX_PACKET_SIZE) ? Size : MCPSIM_MAX_PACKET_SIZE;
+}
+
+void MCPSim_ClearHostModes(void)
+{
+	BYTE ep;
+
+	for (ep = 1; ep < MCPSIM_EP_COUNT; ep++)
+	{
+		Sim.Endpoints[ep][OUT_FROM_HOST].Mode = MCPSIM_HOST_IDLE;
+		Sim.Endpoints[ep][IN_TO_HOST].Mode = MCPSIM_HOST_IDLE;
+	}
+}
+
+// Lets Cost bus bytes pass. The CPU services pending USTAT entries first
+// (USB_INTERRUPT) and runs a main loop pass every MainLoopBytes.
+static void MCPSim_Elapse(WORD Cost, WORD* Budget)
+{
+	*Budget = (*Budget > Cost) ? (*Budget - Cost) : 0;
+
+	Sim.CpuCredit += Cost;
+	for (;;)
+	{
+		if (!Sim.Config.Polling && (Sim.UstatCount || Sim.SofPending) && Sim.CpuCredit > 0)
+		{
+			USBDeviceTasks();
+		}
+		else if (Sim.CpuCredit >= (long)Sim.Config.MainLoopBytes)
+		{
+			Sim.CpuCredit -= Sim.Config.MainLoopBytes;
+			if (Sim.Config.Polling)
+				USBDeviceTasks();
+			Sim.Config.MainLoop();
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+// Latency test host clock (us); the bus time Cost bytes after what the frame has used.
+static unsigned int MCPSim_NowUs(WORD Budget, WORD Cost)
+{
+	DWORD Used = (DWORD)(Sim.Config.BusBytes - Budget) + Cost;
+
+	if (Used > Sim.Config.BusBytes)
+		Used = Sim.Config.BusBytes;
+	return (unsigned int)(Sim.Frames * 1000 + (Used * 1000) / Sim.Config.BusBytes);
+}
+
+static void MCPSim_CheckIN(MCPSIM_EP* e, const BYTE* Data, WORD Length, unsigned int RecvTimeUs)
+{
+	WORD i;
+
+	if (e->Mode == MCPSIM_HOST_LATENCY)
+	{
+		if (!BmLatency_Echo(&e->Stats.Latency, &Sim.LatencyClock, Data, Length, e->Stats.Size, RecvTimeUs))
+			e->Stats.Errors++;
+		return;
+	}
+
+	if (Length < 2 || Length != e->Stats.Size)
+	{
+		e->Stats.Errors++;
+		return;
+	}
+
+	if (e->Mode == MCPSIM_HOST_PATTERN)
+	{
+		// kBench VerifyData; the first packet seeds the key.
+		if (e->KeySeeded && Data[1] != e->Key)
+			e->Stats.Errors++;
+		e->Key = Data[1] + 1;
+		e->KeySeeded = TRUE;
+
+		for (i = 0; i < Length; i++)
+		{
+			if (i != 1 && Data[i] != MCPSim_Pattern(i))
+			{
+				e->Stats.Errors++;
+				break;
+			}
+		}
+	}
+	else if (e->Mode == MCPSIM_HOST_SEQUENCE)
+	{
+		if (Data[1] != e->Key)
+			e->Stats.Errors++;
+		e->Key = Data[1] + 1;
+	}
+}
+
+static void MCPSim_Transaction(BYTE ep, BYTE dir, WORD* Budget)
+{
+	MCPSIM_EP* e = &Sim.Endpoints[ep][dir];
+	volatile BDT_ENTRY* bd = &BDT[EP(ep,dir,e->PingPong)];
+	BOOL iso = (e->Stats.Type == EP_ISO);
+	WORD cost = Sim.Config.PacketOverhead;
+	WORD length;
+	WORD i;
+
+	if (dir == OUT_FROM_HOST)
+	{
+		for (i = 0; i < e->Stats.Size; i++)
+			e->Packet[i] = MCPSim_Pattern(i);
+		if (e->Stats.Size > 1)
+			e->Packet[1] = e->Key;
+	}
+
+	if (!e->Enabled || Sim.UstatCount == MCPSIM_USTAT_FIFO_DEPTH || !bd->STAT.UOWN)
+	{
+		if (!e->Enabled)
+			e->Stats.Errors++;
+		else if (iso)
+			e->Stats.Missed++;
+		else if (Sim.UstatCount == MCPSIM_USTAT_FIFO_DEPTH)
+			e->Stats.FifoNAKs++;
+		else
+			e->Stats.NAKs++;
+
+		// The host sends iso data whether or not the device takes it.
+		if (iso && dir == OUT_FROM_HOST)
+		{
+			e->Key++;
+			e->LatencySeq = (e->LatencySeq + 1) & 0xFFFF;
+			cost += e->Stats.Size;
+		}
+		MCPSim_Elapse(cost, Budget);
+		return;
+	}
+
+	if (dir == IN_TO_HOST)
+	{
+		length = bd->CNT;
+		cost += length;
+
+		if (!iso && bd->STAT.DTS != e->Toggle)
+		{
+			// Data toggle mismatch; the host drops the packet.
+			e->Stats.Errors++;
+		}
+		else
+		{
+			if (!iso)
+				e->Toggle ^= 1;
+			MCPSim_CheckIN(e, (const BYTE*)ConvertToVirtualAddress(bd->ADR), length, MCPSim_NowUs(*Budget, cost));
+			e->Stats.Packets++;
+			e->Stats.Bytes += length;
+		}
+		bd->STAT.Val = (bd->STAT.Val & _DTSMASK) | (PID_IN << 2);
+	}
+	else
+	{
+		length = e->Stats.Size;
+		cost += length;
+
+		if (!iso && bd->STAT.DTSEN && bd->STAT.DTS != e->Toggle)
+		{
+			// Data toggle mismatch; the SIE acks the packet but ignores it.
+			e->Stats.Errors++;
+			e->Toggle ^= 1;
+			MCPSim_Elapse(cost, Budget);
+			return;
+		}
+		if (length > bd->CNT)
+		{
+			e->Stats.Errors++;
+			length = bd->CNT;
+		}
+
+		if (e->Mode == MCPSIM_HOST_LATENCY)
+			BmLatency_Stamp(e->Packet, length, e->Stats.Size, &e->LatencySeq, MCPSim_NowUs(*Budget, 0));
+		memcpy(ConvertToVirtualAddress(bd->ADR), e->Packet, length);
+		bd->CNT = length;
+		bd->STAT.Val = (bd->STAT.Val & _DTSMASK) | (PID_OUT << 2);
+
+		if (!iso)
+			e->Toggle ^= 1;
+		e->Key++;
+		e->Stats.Packets++;
+		e->Stats.Bytes += length;
+	}
+
+	// Transaction complete; push USTAT and advance the hardware ping-pong state.
+	Sim.Ustat[(Sim.UstatHead + Sim.UstatCount) % MCPSIM_USTAT_FIFO_DEPTH].Val = 0;
+	Sim.Ustat[(Sim.UstatHead + Sim.UstatCount) % MCPSIM_USTAT_FIFO_DEPTH].endpoint_number = ep;
+	Sim.Ustat[(Sim.UstatHead + Sim.UstatCount) % MCPSIM_USTAT_FIFO_DEPTH].direction = dir;
+	Sim.Ustat[(Sim.UstatHead + Sim.UstatCount) % MCPSIM_USTAT_FIFO_DEPTH].ping_pong = e->PingPong;
+	Sim.UstatCount++;
+	if (Sim.UstatCount > Sim.UstatHighWater)
+		Sim.UstatHighWater = Sim.UstatCount;
+	e->PingPong ^= 1;
+
+	MCPSim_Elapse(cost, Budget);
+}
+
+void MCPSim_RunFrame(void)
+{
+	WORD Budget = Sim.Config.BusBytes;
+	BOOL HasBulk = FALSE;
+	BYTE ep, dir, i;
+
+	// SOF; the latency test host clock is resampled at every frame start.
+	Sim.Frames++;
+	BmLatency_SetFrameStart(&Sim.LatencyClock, Sim.Frames * 1000, Sim.Frames);
+	Sim.FrameNumber = (Sim.FrameNumber + 1) & 0x7FF;
+	U1FRML = Sim.FrameNumber & 0xFF;
+	U1FRMH = Sim.FrameNumber >> 8;
+	Sim.SofPending = TRUE;
+
+	// Periodic endpoints first; bInterval is always 1.
+	for (ep = 1; ep < MCPSIM_EP_COUNT; ep++)
+	{
+		for (dir = 0; dir < 2; dir++)
+		{
+			if (!Sim.Endpoints[ep][dir].Mode)
+				continue;
+			if (Sim.Endpoints[ep][dir].Stats.Type == EP_BULK)
+				HasBulk = TRUE;
+			else
+				MCPSim_Transaction(ep, dir, &Budget);
+		}
+	}
+
+	// Bulk endpoints share the rest of the frame; a transaction is only
+	// started if a full packet still fits.
+	while (HasBulk)
+	{
+		HasBulk = FALSE;
+		for (i = 0; i < MCPSIM_EP_COUNT * 2; i++)
+		{
+			Sim.BulkNext = (Sim.BulkNext + 1) % (MCPSIM_EP_COUNT * 2);
+			ep = Sim.BulkNext / 2;
+			dir = Sim.BulkNext % 2;
+			if (!ep || !Sim.Endpoints[ep][dir].Mode || Sim.Endpoints[ep][dir].Stats.Type != EP_BULK)
+				continue;
+			if (Budget < Sim.Config.PacketOverhead + Sim.Endpoints[ep][dir].Stats.Size)
+				continue;
+			MCPSim_Transaction(ep, dir, &Budget);
+			HasBulk = TRUE;
+			break;
+		}
+	}
+
+	MCPSim_Elapse(Budget, &Budget);
+}
+
+MCPSIM_EP_STATS* MCPSim_GetEpStats(BYTE EndpointAddress)
+{
+	return &MCPSim_GetEndpoint(EndpointAddress)->Stats;
+}
+
+void MCPSim_ResetStats(void)
+{
+	BYTE ep, dir;
+
+	for (ep = 0; ep < MCPSIM_EP_COUNT; ep++)
+	{
+		for (dir = 0; dir < 2; dir++)
+		{
+			MCPSIM_EP_STATS* stats = &Sim.Endpoints[ep][dir].Stats;
+			BYTE type = stats->Type;
+			WORD size = stats->Size;
+
+			memset(stats, 0, sizeof(*stats));
+			stats->Type = type;
+			stats->Size = size;
+		}
+	}
+	Sim.UstatHighWater = Sim.UstatCount;
+}
+
+BYTE MCPSim_UstatHighWater(void)
+{
+	return Sim.UstatHighWater;
+}
@@ -0,0 +1,122 @@
+/// mcp_sim.h
+/// Simulated USB module and host.
+
+/* USB Benchmark for libusb-win32
+
+    Copyright  2010 Travis Robinson. <libusbdotnet@gmail.com>
+    website: http://sourceforge.net/projects/libusb-win32
+ 
+    Software License Agreement:
+    
+    The software supplied herewith is intended for use solely and
+    exclusively on Microchip PIC Microcontroller products. This 
+    software is owned by Travis Robinson, and is protected under
+	applicable copyright laws. All rights are reserved. Any use in 
+	violation of the foregoing restrictions may subject the user to 
+	criminal sanctions under applicable laws, as well as to civil 
+	liability for the breach of the terms and conditions of this
+    license.
+
+	You may redistribute and/or modify this file under the terms
+	described above.
+    
+    THIS SOFTWARE IS PROVIDED IN AN AS IS CONDITION. NO WARRANTIES,
+    WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT NOT LIMITED
+    TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. THE OWNER SHALL NOT,
+    IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL OR
+    CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.	
+*/
+
+// Simulated USB module (SIE, BDT and USTAT FIFO) and host for host builds of
+// the benchmark firmware.
+//
+// mcp_sim implements the parts of the Microchip USB device stack the
+// benchmark firmware uses (see include/USB/usb.h) so Benchmark.c runs
+// unmodified:
+//   - The SIE completes a transaction only if the BDT entry it points to
+//     (hardware ping-pong state) is owned by the SIE and the USTAT FIFO has
+//     room; completing it writes the BDT back, pushes a USTAT entry and
+//     advances the hardware ping-pong state. With the 4 entry USTAT FIFO
+//     full every transaction is NAKed.
+//   - USBDeviceTasks() raises EVENT_SOF if a frame has started since the
+//     last call, then drains up to 4 USTAT entries and raises EVENT_TRANSFER
+//     for every data endpoint entry. SOFs that arrive while one is still
+//     pending are lost, as with the SOF interrupt flag.
+//   - The host runs full-speed 1ms frames. Interrupt and isochronous
+//     endpoints get one transaction per frame, bulk endpoints share what is
+//     left of the frame round-robin. Data toggles are checked on both sides.
+//   - The CPU runs one main loop pass for every MainLoopBytes of bus time.
+//     With USB_INTERRUPT, USBDeviceTasks() runs as soon as an SOF or a USTAT
+//     entry is pending; with USB_POLLING it runs at the start of every main
+//     loop pass. Every SOF and USTAT entry serviced costs IsrBytes of CPU time.
+//
+// The host checks what it reads: in a read test every packet must carry the
+// benchmark pattern and the next packet key; in a loop test every packet must
+// come back in order. In a latency test the host stamps and decodes packets
+// with kBench_latency.c, as kBench does; the host clock is the bus time.
+
+#ifndef _MCP_SIM_H_
+#define _MCP_SIM_H_
+
+#include "USB/usb.h"
+#include "kBench_latency.h"
+
+#define MCPSIM_USTAT_FIFO_DEPTH		4
+
+typedef struct
+{
+	WORD BusBytes;			// Bus bytes per frame; packet payload plus PacketOverhead.
+	WORD PacketOverhead;	// Bus bytes charged to every transaction in addition to its payload.
+	WORD MainLoopBytes;		// Bus time of one main loop pass.
+	WORD IsrBytes;			// CPU time of one USTAT entry serviced by USBDeviceTasks().
+	BOOL Polling;			// USB_POLLING; otherwise USB_INTERRUPT.
+	void (*MainLoop)(void);	// Main loop pass, less USBDeviceTasks().
+} MCPSIM_CONFIG;
+
+typedef struct
+{
+	BYTE  Type;				// EP_ISO, EP_BULK or EP_INT
+	WORD  Size;
+
+	DWORD Packets;
+	QWORD Bytes;
+	DWORD NAKs;				// Bulk/interrupt transactions the BDT was not armed for.
+	DWORD FifoNAKs;			// Transactions NAKed because the USTAT FIFO was full.
+	DWORD Missed;			// Isochronous frames the BDT was not armed for.
+	DWORD Errors;			// Bad pattern, packet key, loop sequence, data toggle or length.
+
+	BM_LATENCY_RESULT Latency;	// MCPSIM_HOST_LATENCY IN endpoints.
+} MCPSIM_EP_STATS;
+
+// What the host does with an endpoint.
+enum MCPSIM_HOST_MODE
+{
+	MCPSIM_HOST_IDLE,
+	MCPSIM_HOST_PATTERN,	// IN: check the benchmark pattern and packet key. OUT: send it.
+	MCPSIM_HOST_SEQUENCE,	// OUT: send a sequence number in byte 1. IN: check it.
+	MCPSIM_HOST_LATENCY,	// OUT: send a latency test stamp. IN: decode it.
+};
+
+void MCPSim_Init(const MCPSIM_CONFIG* Config);
+
+// SET_CONFIGURATION; clears the BDT and raises EVENT_CONFIGURED.
+void MCPSim_Configure(void);
+
+// Device to host vendor request through EVENT_EP0_REQUEST. Returns FALSE on a stall.
+BOOL MCPSim_VendorRequest(BYTE bRequest, WORD wValue, WORD wIndex, WORD wLength, BYTE* Data, WORD* Transferred);
+
+// Sets what the host does with an endpoint and the endpoint's type and
+// wMaxPacketSize as read from its descriptor.
+void MCPSim_SetHostMode(BYTE EndpointAddress, BYTE Type, WORD Size, BYTE Mode);
+void MCPSim_ClearHostModes(void);
+
+void MCPSim_RunFrame(void);
+
+MCPSIM_EP_STATS* MCPSim_GetEpStats(BYTE EndpointAddress);
+void MCPSim_ResetStats(void);
+
+// Most USTAT entries pending at once since MCPSim_ResetStats.
+BYTE MCPSim_UstatHighWater(void);
+
+#endif
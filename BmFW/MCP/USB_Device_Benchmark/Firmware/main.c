@@ -993,6 +993,9 @@ void USBCB_SOF_Handler(void)
 {
     // No need to clear UIRbits.SOFIF to 0 here.
     // Callback caller is already doing that.
+
+    // Device counters (GET_STATS).
+    Benchmark_SOF();
 }
 
 /*******************************************************************
@@ -1250,7 +1253,11 @@ BOOL USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, WORD size)
             USBCBErrorHandler();
             break;
         case EVENT_TRANSFER:
+            #if defined(TRANSFER_EVENTS_ENABLED)
+            USBCBTransferEvent(pdata);
+            #else
             Nop();
+            #endif
             break;
         default:
             break;
@@ -85,6 +85,19 @@
 #define DESCRIPTOR_COUNTING_ENABLED
 #endif
 
+/*! \def TRANSFER_EVENTS_ENABLED
+* \brief Services the benchmark endpoints from transfer complete events.
+*
+* If defined, the ping-pong buffers of a benchmark endpoint are re-armed from the
+* \c EVENT_TRANSFER callback of USBDeviceTasks() as soon as a transaction completes.
+* Otherwise they are polled by Benchmark_ProcessIO() from the main loop and throughput
+* depends on how often the main loop runs.
+*
+*/
+#ifndef USBCFG_H
+#define TRANSFER_EVENTS_ENABLED
+#endif
+
 #if defined(DESCRIPTOR_COUNTING_ENABLED) && !defined(VENDOR_BUFFER_ENABLED)
 #define VENDOR_BUFFER_ENABLED
 #endif
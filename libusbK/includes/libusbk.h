@@ -213,6 +213,129 @@ typedef KLIB_VERSION* PKLIB_VERSION;
 //! Callback function typedef for \ref IsoK_EnumPackets
 typedef BOOL KUSB_API KISO_ENUM_PACKETS_CB (_in UINT PacketIndex, _in PKISO_PACKET IsoPacket, _in PVOID UserState);
 
+//! Describes the packet layout of an isochronous stream for \ref IsoK_InitLayout.
+typedef struct _KISO_LAYOUT_PARAMS
+{
+	//! The endpoint \c wMaxPacketSize, including the high-bandwidth transactions-per-microframe bits (11-12).
+	USHORT MaxPacketSize;
+
+	//! The endpoint service period in bus intervals; frames for full-speed, microframes for high-speed. (0 = 1)
+	USHORT Interval;
+
+	//! \c FullSpeed or \c HighSpeed. Selects 1000 or 8000 bus intervals per second.
+	UINT DeviceSpeed;
+
+	//! Sample frames per second (e.g. 44100), or \b 0 to fill every packet to its maximum size.
+	UINT SampleRate;
+
+	//! Bytes per sample frame (channels * sub-slot size). Ignored when \c SampleRate is \b 0.
+	UINT BytesPerSample;
+} KISO_LAYOUT_PARAMS;
+//! pointer to a \c KISO_LAYOUT_PARAMS structure
+typedef KISO_LAYOUT_PARAMS* PKISO_LAYOUT_PARAMS;
+
+//! Opaque precomputed isochronous packet layout. See \ref IsoK_InitLayout.
+typedef struct _KISO_LAYOUT KISO_LAYOUT;
+//! pointer to a \c KISO_LAYOUT
+typedef KISO_LAYOUT* PKISO_LAYOUT;
+
+//! Opaque continuous isochronous stream. See \ref IsoK_StreamInit.
+typedef struct _KISO_STREAM KISO_STREAM;
+//! pointer to a \c KISO_STREAM
+typedef KISO_STREAM* PKISO_STREAM;
+
+//! Describes one isochronous packet of a \ref KISO_STREAM.
+typedef struct _KISO_STREAM_PACKET
+{
+	//! Packet data. Points into the transfer buffer inside a \ref KISO_STREAM_CB, or into the caller buffer for \ref IsoK_StreamRead.
+	PUCHAR Data;
+
+	//! Number of bytes in \c Data. For OUT streams this is the number of bytes the callback must fill.
+	UINT Length;
+
+	//! USBD status code of the packet; \b 0 on success.
+	UINT Status;
+
+	//! The bus frame the packet was scheduled in.
+	UINT FrameNumber;
+
+	//! The microframe (0-7) within \c FrameNumber; always \b 0 for full-speed devices.
+	UINT MicroFrame;
+
+	//! Estimated \c QueryPerformanceCounter value of the packet bus interval.
+	LONGLONG Timestamp;
+} KISO_STREAM_PACKET;
+//! pointer to a \c KISO_STREAM_PACKET structure
+typedef KISO_STREAM_PACKET* PKISO_STREAM_PACKET;
+
+//! Packet callback function typedef for a \ref KISO_STREAM.
+/*!
+* Called from the stream thread with the packets of each completed IN transfer, or with the packets of an OUT
+* transfer that is about to be submitted. Return FALSE to stop the stream.
+*/
+typedef BOOL KUSB_API KISO_STREAM_CB (_in PKISO_STREAM IsoStream, _in PKISO_STREAM_PACKET Packets, _in INT PacketCount, _in PVOID UserState);
+
+//! Configures a continuous isochronous stream for \ref IsoK_StreamInit.
+typedef struct _KISO_STREAM_PARAMS
+{
+	//! Number of ISO packets in each transfer.
+	/*!
+	* On high-speed devices, transfers must fill whole frames: a multiple of 8, 4 or 2 packets for an endpoint
+	* interval of 1, 2 or 4 microframes. Other values fail with \c ERROR_INVALID_PARAMETER.
+	*/
+	INT PacketsPerTransfer;
+
+	//! Number of transfers kept queued. (minimum 2)
+	INT MaxPendingTransfers;
+
+	//! Frames between the current bus frame and the first queued transfer when (re)synchronizing. (0 = 8)
+	UINT FrameLead;
+
+	//! See \ref KISO_LAYOUT_PARAMS::SampleRate.
+	UINT SampleRate;
+
+	//! See \ref KISO_LAYOUT_PARAMS::BytesPerSample.
+	UINT BytesPerSample;
+
+	//! Packet callback. Required for OUT pipes. If NULL, IN packets are queued for \ref IsoK_StreamRead.
+	KISO_STREAM_CB* PacketCB;
+
+	//! Number of packets the \ref IsoK_StreamRead ring holds. Used only when \c PacketCB is NULL.
+	INT RingPacketCount;
+
+	//! User context passed to \c PacketCB.
+	PVOID UserState;
+} KISO_STREAM_PARAMS;
+//! pointer to a \c KISO_STREAM_PARAMS structure
+typedef KISO_STREAM_PARAMS* PKISO_STREAM_PARAMS;
+
+//! Counters of a \ref KISO_STREAM. See \ref IsoK_StreamGetStats.
+typedef struct _KISO_STREAM_STATS
+{
+	//! Completed transfers.
+	ULONGLONG TransferCount;
+
+	//! Completed packets.
+	ULONGLONG PacketCount;
+
+	//! Completed packets with a non-zero status.
+	ULONGLONG PacketErrorCount;
+
+	//! Bus frames skipped while resynchronizing.
+	UINT MissedFrames;
+
+	//! Number of times the start frame schedule was resynchronized.
+	UINT ResyncCount;
+
+	//! IN packets dropped because the \ref IsoK_StreamRead ring was full.
+	UINT RingOverruns;
+
+	//! The error that stopped the stream thread, or \b 0.
+	UINT ErrorCode;
+} KISO_STREAM_STATS;
+//! pointer to a \c KISO_STREAM_STATS structure
+typedef KISO_STREAM_STATS* PKISO_STREAM_STATS;
+
 /*! @} */
 #endif
 
@@ -1038,6 +1161,15 @@ typedef enum _KUSB_FNID
     //! \ref UsbK_GetProperty dynamic driver function id.
     KUSB_FNID_GetProperty,
 
+    //! \ref UsbK_GetPipeStats dynamic driver function id.
+    KUSB_FNID_GetPipeStats,
+
+    //! \ref UsbK_SubmitBatch dynamic driver function id.
+    KUSB_FNID_SubmitBatch,
+
+    //! \ref UsbK_ReadPackets dynamic driver function id.
+    KUSB_FNID_ReadPackets,
+
 
     //! Supported function count
     KUSB_FNID_COUNT,
@@ -1230,6 +1362,28 @@ typedef BOOL KUSB_API KUSB_GetProperty (
     _ref PUINT PropertySize,
     _out PVOID Value);
 
+typedef BOOL KUSB_API KUSB_GetPipeStats (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats);
+
+typedef BOOL KUSB_API KUSB_SubmitBatch (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped);
+
+typedef BOOL KUSB_API KUSB_ReadPackets (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped);
+
 
 
 //! USB core driver API information structure.
@@ -1464,6 +1618,24 @@ typedef struct _KUSB_DRIVER_API
 	*/
 	KUSB_GetProperty* GetProperty;
 
+	/*! \fn BOOL KUSB_API GetPipeStats (_in KUSB_HANDLE InterfaceHandle, _in UCHAR PipeID, _out PKPIPE_STATS Stats)
+	* \memberof KUSB_DRIVER_API
+	* \copydoc UsbK_GetPipeStats
+	*/
+	KUSB_GetPipeStats* GetPipeStats;
+
+	/*! \fn BOOL KUSB_API SubmitBatch (_in KUSB_HANDLE InterfaceHandle, _in UCHAR PipeID, _ref PKUSB_BATCH_ENTRY Entries, _in UINT EntryCount, _ref PUCHAR Buffer, _in UINT BufferLength, _in LPOVERLAPPED Overlapped)
+	* \memberof KUSB_DRIVER_API
+	* \copydoc UsbK_SubmitBatch
+	*/
+	KUSB_SubmitBatch* SubmitBatch;
+
+	/*! \fn BOOL KUSB_API ReadPackets (_in KUSB_HANDLE InterfaceHandle, _in UCHAR PipeID, _out PUCHAR Buffer, _in UINT BufferLength, _outopt PUINT LengthTransferred, _inopt LPOVERLAPPED Overlapped)
+	* \memberof KUSB_DRIVER_API
+	* \copydoc UsbK_ReadPackets
+	*/
+	KUSB_ReadPackets* ReadPackets;
+
 	//! fixed structure padding.
 	UCHAR z_F_i_x_e_d[512 - sizeof(KUSB_DRIVER_API_INFO) -  sizeof(UINT_PTR) * KUSB_FNID_COUNT];
 
@@ -1599,11 +1771,14 @@ typedef enum _KOVL_WAIT_FLAG
 
 //! \c Overlapped pool config flags.
 /*!
-* \attention Currently not used.
+*
 */
 typedef enum _KOVL_POOL_FLAG
 {
     KOVL_POOL_FLAG_NONE	= 0L,
+
+    //! Registers a completion queue with the driver so \ref OvlK_WaitAny can find completed transfers without waiting on each OverlappedK. libusbK driver only; ignored by the other drivers.
+    KOVL_POOL_FLAG_COMPLETION_QUEUE	= 0x0001,
 } KOVL_POOL_FLAG;
 
 /**@}*/
@@ -2968,6 +3143,8 @@ extern "C" {
 	*
 	* \param[in,out] IsoContext
 	* Pointer to an isochronous transfer context created with \ref IsoK_Init. If \c IsoContext is NULL,
+	* the packet offsets come from the \c ISO_AUTO_PACKET_TEMPLATE pipe policy and no per-packet results
+	* are returned.
 	*
 	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
 	*
@@ -3010,7 +3187,8 @@ extern "C" {
 	* before returning. An event is signaled when the operation is complete.
 	*
 	* \param[in,out] IsoContext
-	* Pointer to an isochronous transfer context created with \ref IsoK_Init. See remarks below.
+	* Pointer to an isochronous transfer context created with \ref IsoK_Init. If \c IsoContext is NULL,
+	* the packet offsets come from the \c ISO_AUTO_PACKET_TEMPLATE pipe policy.
 	*
 	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
 	*
@@ -3123,6 +3301,130 @@ extern "C" {
 	    _ref PUINT PropertySize,
 	    _out PVOID Value);
 
+//! Gets the performance counters the driver keeps for a pipe.
+	/*!
+	*
+	* \param[in] InterfaceHandle
+	* An initialized usb handle, see \ref UsbK_Init.
+	*
+	* \param[in] PipeID
+	* An 8-bit value that consists of a 7-bit address and a direction bit. This parameter corresponds to the
+	* bEndpointAddress field in the endpoint descriptor.
+	*
+	* \param[out] Stats
+	* On success, receives the pipe counters. See \ref KPIPE_STATS.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* Only read and write requests are counted; control transfers are not. Counters are read one at a time
+	* while transfers may be in progress, so related counters can be off by the requests that completed in
+	* between. Only the libusbK driver supports this function.
+	*
+	*/
+	KUSB_EXP BOOL KUSB_API UsbK_GetPipeStats (
+	    _in KUSB_HANDLE InterfaceHandle,
+	    _in UCHAR PipeID,
+	    _out PKPIPE_STATS Stats);
+
+//! Submits several bulk or interrupt transfers on one pipe with a single driver request.
+	/*!
+	*
+	* \param[in] InterfaceHandle
+	* An initialized usb handle, see \ref UsbK_Init.
+	*
+	* \param[in] PipeID
+	* An 8-bit value that consists of a 7-bit address and a direction bit. This parameter corresponds to the
+	* bEndpointAddress field in the endpoint descriptor. The direction bit selects whether every transfer of
+	* the batch is a read or a write.
+	*
+	* \param[in,out] Entries
+	* Array of \c EntryCount transfer descriptors. See \ref KUSB_BATCH_ENTRY. \c Transferred and \c Status
+	* are filled in as each transfer completes. The array must remain valid until the batch completes.
+	*
+	* \param[in] EntryCount
+	* Number of transfers; 1 to \ref KUSB_BATCH_MAX_ENTRIES.
+	*
+	* \param[in,out] Buffer
+	* Data buffer shared by all of the transfers. Each transfer uses the \c Offset and \c Length range of its
+	* descriptor.
+	*
+	* \param[in] BufferLength
+	* The length of \c Buffer, in bytes.
+	*
+	* \param[in] Overlapped
+	* A \b required pointer to an overlapped structure for asynchronous operations.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	* As with other overlapped functions, FALSE with \c ERROR_IO_PENDING means the batch was submitted.
+	*
+	* A batch replaces one driver request per transfer with one request for all of them; use it when many
+	* small transfers are submitted at a high rate. The driver keeps several transfers of the batch in flight
+	* at a time and sends them in descriptor order. The batch completes when every transfer has; the
+	* overlapped result is the total number of bytes transferred.
+	*
+	* When a transfer fails the transfers that were not yet sent are not sent; their \c Status is
+	* \c STATUS_CANCELLED, and the batch completes with the error of the first failed transfer.
+	*
+	* Read lengths must be a non-zero multiple of the maximum packet size, and no transfer may be larger than
+	* the pipe's \c MAXIMUM_TRANSFER_SIZE. Pipe policies other than \c PIPE_TRANSFER_TIMEOUT, which applies to
+	* each transfer, and \c AUTO_CLEAR_STALL are not used. Only the libusbK driver supports this function.
+	*
+	*/
+	KUSB_EXP BOOL KUSB_API UsbK_SubmitBatch (
+	    _in KUSB_HANDLE InterfaceHandle,
+	    _in UCHAR PipeID,
+	    _ref PKUSB_BATCH_ENTRY Entries,
+	    _in UINT EntryCount,
+	    _ref PUCHAR Buffer,
+	    _in UINT BufferLength,
+	    _in LPOVERLAPPED Overlapped);
+
+//! Reads the packets stored by the continuous reader of a pipe.
+	/*!
+	*
+	* \param[in] InterfaceHandle
+	* An initialized usb handle, see \ref UsbK_Init.
+	*
+	* \param[in] PipeID
+	* An 8-bit value that consists of a 7-bit address and a direction bit. Must be a bulk or interrupt IN
+	* pipe with the \c CONTINUOUS_READER policy set.
+	*
+	* \param[out] Buffer
+	* Receives one or more packets. Each packet is a \ref KUSB_PACKET_HEADER followed by the packet data;
+	* the next packet starts \ref KUSB_PACKET_SIZE (\c Length) bytes after the previous one.
+	*
+	* \param[in] BufferLength
+	* The length of \c Buffer, in bytes. Must hold at least one packet of the pipe's maximum packet size.
+	*
+	* \param[out] LengthTransferred
+	* On success, receives the number of bytes written to \c Buffer.
+	*
+	* \param[in] Overlapped
+	* An optional pointer to an overlapped structure for asynchronous operations.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* With \c CONTINUOUS_READER set the driver keeps that many reads sent on the pipe and stores every
+	* completed read, in order, in a ring buffer with its completion time (\c QueryPerformanceCounter
+	* ticks). \c UsbK_ReadPackets returns as many whole packets as fit in \c Buffer and waits for the first
+	* one if the ring is empty. Use it for interrupt endpoints that must not miss a report between
+	* application reads.
+	*
+	* The reader starts with the first call. When the ring is full new packets are dropped and the next
+	* stored packet has \ref KUSB_PACKET_FLAG_OVERRUN set. When a read fails the reader stops; the
+	* remaining packets are returned first, then the error is returned once and the next call starts the
+	* reader again. \ref UsbK_ReadPipe and \ref UsbK_SubmitBatch fail on the pipe while the policy is set.
+	* Only the libusbK driver supports this function.
+	*
+	*/
+	KUSB_EXP BOOL KUSB_API UsbK_ReadPackets (
+	    _in KUSB_HANDLE InterfaceHandle,
+	    _in UCHAR PipeID,
+	    _out PUCHAR Buffer,
+	    _in UINT BufferLength,
+	    _outopt PUINT LengthTransferred,
+	    _inopt LPOVERLAPPED Overlapped);
+
 	/*! @} */
 
 
@@ -3561,6 +3863,49 @@ extern "C" {
 	    _inopt KOVL_WAIT_FLAG WaitFlags,
 	    _out PUINT TransferredLength);
 
+//! Waits for any acquired OverlappedK in the pool to complete.
+	/*!
+	*
+	* \param[in] PoolHandle
+	* The pool handle containing one or more acuired OverlappedKs.
+	*
+	* \param[out] OverlappedK
+	* On success, set to the overlappedK that completed.
+	*
+	* \param[in] TimeoutMS
+	* Number of milliseconds to wait for any overlappedK to complete.
+	*
+	* \param[in] WaitFlags
+	* See /ref KOVL_WAIT_FLAG. The timeout actions are not performed; nothing is cancelled if no overlappedK
+	* completes in time.
+	*
+	* \param[out] TransferredLength
+	* See /ref OvlK_Wait
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	* If an OverlappedK completed with an error, \c OverlappedK is set and \c GetLastError() returns its error
+	* as described in /ref OvlK_Wait. If none completed within \c TimeoutMS, \c GetLastError() returns
+	* \c ERROR_IO_INCOMPLETE.
+	*
+	* Each completion is returned once; an OverlappedK returned by \ref OvlK_WaitAny is not returned again
+	* until it has been re-used (\ref OvlK_ReUse) or released and acquired again.
+	*
+	* When the pool was created with \ref KOVL_POOL_FLAG_COMPLETION_QUEUE the driver records every completion
+	* in a queue shared with the pool and this function only blocks when that queue is empty; a successful
+	* completion taken from the queue is returned without a system call. Otherwise, or if
+	* the queue could not be registered, the acquired OverlappedKs are checked and waited on directly; only the
+	* oldest \c MAXIMUM_WAIT_OBJECTS are waited on.
+	*
+	* \note Like the other pool functions, \ref OvlK_WaitAny should not be called by more than one thread at a
+	* time for the same pool.
+	*/
+	KUSB_EXP BOOL KUSB_API OvlK_WaitAny(
+	    _in KOVL_POOL_HANDLE PoolHandle,
+	    _out KOVL_HANDLE* OverlappedK,
+	    _inopt INT TimeoutMS,
+	    _inopt KOVL_WAIT_FLAG WaitFlags,
+	    _out PUINT TransferredLength);
+
 //! Waits for overlapped I/O completion, cancels on a timeout error.
 	/*!
 	*
@@ -3989,6 +4334,202 @@ extern "C" {
 	KUSB_EXP BOOL KUSB_API IsoK_ReUse(
 	    _ref PKISO_CONTEXT IsoContext);
 
+//! Precomputes the packet offset tables of an isochronous stream.
+	/*!
+	* \param[out] IsoLayout
+	* Receives a new isochronous packet layout.
+	*
+	* \param[in] Params
+	* Endpoint and stream parameters used to calculate the packet sizes.
+	*
+	* \param[in] NumberOfPackets
+	* The number of \ref KISO_PACKET structures in each transfer. Must match the
+	* \ref KISO_CONTEXT::NumberOfPackets of the contexts the layout is applied to.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* When \c SampleRate does not divide evenly into the bus interval rate (e.g. 44.1 kHz), the fractional
+	* sample count is carried from packet to packet so the stream never drifts. The packet size pattern then
+	* repeats over several transfers; \c IsoK_InitLayout builds one complete \ref KISO_PACKET array for each of
+	* them. Fails with \c ERROR_INVALID_PARAMETER if a packet would exceed \c MaxPacketSize.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_InitLayout(
+	    _out PKISO_LAYOUT* IsoLayout,
+	    _in PKISO_LAYOUT_PARAMS Params,
+	    _in INT NumberOfPackets);
+
+//! Destroys an isochronous packet layout.
+	/*!
+	* \param[in] IsoLayout
+	* A pointer to an isochronous packet layout created with \ref IsoK_InitLayout.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_FreeLayout(
+	    _in PKISO_LAYOUT IsoLayout);
+
+//! Copies the next precomputed packet table of a layout into an isochronous transfer context.
+	/*!
+	* \param[in] IsoLayout
+	* A pointer to an isochronous packet layout created with \ref IsoK_InitLayout.
+	*
+	* \param[in,out] IsoContext
+	* A pointer to an isochronous transfer context with the same number of packets as \c IsoLayout.
+	*
+	* \param[out] TransferLength
+	* Receives the total number of bytes described by the packets; pass it as the \c BufferLength of
+	* \ref UsbK_IsoReadPipe or \ref UsbK_IsoWritePipe.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* \c IsoK_ApplyLayout replaces \ref IsoK_ReUse for layout based transfers. All \ref KISO_PACKET
+	* structures are copied with a single \c memcpy and the \b ErrorCount is zeroed; \b StartFrame and
+	* \b Flags are not changed. Each call advances the layout to its next table, so use one layout per
+	* stream and submit transfers in the order they were applied.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_ApplyLayout(
+	    _in PKISO_LAYOUT IsoLayout,
+	    _ref PKISO_CONTEXT IsoContext,
+	    _outopt PUINT TransferLength);
+
+//! Gathers the data of all successfully received ISO packets into a contiguous buffer.
+	/*!
+	* \param[in] IsoContext
+	* A pointer to a completed isochronous transfer context.
+	*
+	* \param[in] Buffer
+	* The transfer buffer passed to \ref UsbK_IsoReadPipe.
+	*
+	* \param[out] Output
+	* Receives the packet data. May be the same as \c Buffer to compact in place.
+	*
+	* \param[in] OutputLength
+	* The size of \c Output in bytes.
+	*
+	* \param[out] CompactedLength
+	* Receives the number of bytes copied to \c Output.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* Packets with a non-zero \b Status or a zero \b Length are skipped. If \c Output is too small,
+	* \c IsoK_CompactPackets stops at the first packet that does not fit and fails with \c ERROR_MORE_DATA;
+	* \c CompactedLength is still set.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_CompactPackets(
+	    _in PKISO_CONTEXT IsoContext,
+	    _in PUCHAR Buffer,
+	    _out PUCHAR Output,
+	    _in UINT OutputLength,
+	    _out PUINT CompactedLength);
+
+//! Creates a continuous isochronous stream.
+	/*!
+	* \param[out] IsoStream
+	* Receives the new stream.
+	*
+	* \param[in] UsbHandle
+	* An initialized usb handle. The interface and alternate setting of \c PipeID must already be selected.
+	*
+	* \param[in] PipeID
+	* An isochronous endpoint address.
+	*
+	* \param[in] Params
+	* Stream configuration. See \ref KISO_STREAM_PARAMS.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* An IsoK stream replaces the \ref KISO_CONTEXT ring, \ref UsbK_GetCurrentFrameNumber and
+	* \ref KISO_FLAG_SET_START_FRAME management done by hand in the iso examples. Once started, a stream
+	* thread keeps \c MaxPendingTransfers transfers queued with contiguous start frames. When a transfer
+	* cannot be queued before its start frame, the schedule is resynchronized \c FrameLead frames ahead of the
+	* bus and the skipped frames are counted in \ref KISO_STREAM_STATS::MissedFrames. Packet sizes come from a
+	* \ref KISO_LAYOUT built from the endpoint descriptor and the \c SampleRate in \c Params.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamInit(
+	    _out PKISO_STREAM* IsoStream,
+	    _in KUSB_HANDLE UsbHandle,
+	    _in UCHAR PipeID,
+	    _in PKISO_STREAM_PARAMS Params);
+
+//! Stops and destroys a continuous isochronous stream.
+	/*!
+	* \param[in] IsoStream
+	* A stream created with \ref IsoK_StreamInit.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamFree(
+	    _in PKISO_STREAM IsoStream);
+
+//! Starts the stream thread.
+	/*!
+	* \param[in] IsoStream
+	* A stream created with \ref IsoK_StreamInit.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* Statistics are reset and the start frame schedule is synchronized with the bus when the first transfer
+	* is queued.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamStart(
+	    _in PKISO_STREAM IsoStream);
+
+//! Stops the stream thread.
+	/*!
+	* \param[in] IsoStream
+	* A stream created with \ref IsoK_StreamInit.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* Pending transfers are aborted and \c IsoK_StreamStop waits for the stream thread to exit. Packets already
+	* in the \ref IsoK_StreamRead ring remain readable.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamStop(
+	    _in PKISO_STREAM IsoStream);
+
+//! Reads the next packet of an IN stream created without a \ref KISO_STREAM_CB.
+	/*!
+	* \param[in] IsoStream
+	* A stream created with \ref IsoK_StreamInit.
+	*
+	* \param[out] Packet
+	* Receives the packet description. \ref KISO_STREAM_PACKET::Data is set to \c Buffer.
+	*
+	* \param[out] Buffer
+	* Receives the packet data.
+	*
+	* \param[in] BufferLength
+	* The size of \c Buffer; the endpoint maximum packet size is always enough.
+	*
+	* \param[in] TimeoutMS
+	* Milliseconds to wait for a packet, or \c INFINITE.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*
+	* Only successful, non-empty packets are queued. Fails with \c ERROR_SEM_TIMEOUT if no packet arrived in
+	* time.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamRead(
+	    _in PKISO_STREAM IsoStream,
+	    _out PKISO_STREAM_PACKET Packet,
+	    _out PUCHAR Buffer,
+	    _in UINT BufferLength,
+	    _in UINT TimeoutMS);
+
+//! Gets the counters of a continuous isochronous stream.
+	/*!
+	* \param[in] IsoStream
+	* A stream created with \ref IsoK_StreamInit.
+	*
+	* \param[out] Stats
+	* Receives the stream counters.
+	*
+	* \returns On success, TRUE. Otherwise FALSE. Use \c GetLastError() to get extended error information.
+	*/
+	KUSB_EXP BOOL KUSB_API IsoK_StreamGetStats(
+	    _in PKISO_STREAM IsoStream,
+	    _out PKISO_STREAM_STATS Stats);
+
 	/*! @} */
 
 #endif
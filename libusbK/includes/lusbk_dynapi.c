@@ -257,6 +257,28 @@ typedef BOOL KUSB_API UsbK_GetProperty_T (
     _ref PUINT PropertySize,
     _out PVOID Value);
 
+typedef BOOL KUSB_API UsbK_GetPipeStats_T (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats);
+
+typedef BOOL KUSB_API UsbK_SubmitBatch_T (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped);
+
+typedef BOOL KUSB_API UsbK_ReadPackets_T (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped);
+
 typedef BOOL KUSB_API LstK_Init_T(
     _out KLST_HANDLE* DeviceList,
     _in KLST_FLAG Flags);
@@ -336,6 +358,13 @@ typedef BOOL KUSB_API OvlK_WaitOldest_T(
     _inopt KOVL_WAIT_FLAG WaitFlags,
     _out PUINT TransferredLength);
 
+typedef BOOL KUSB_API OvlK_WaitAny_T(
+    _in KOVL_POOL_HANDLE PoolHandle,
+    _out KOVL_HANDLE* OverlappedK,
+    _inopt INT TimeoutMS,
+    _inopt KOVL_WAIT_FLAG WaitFlags,
+    _out PUINT TransferredLength);
+
 typedef BOOL KUSB_API OvlK_WaitOrCancel_T(
     _in KOVL_HANDLE OverlappedK,
     _inopt INT TimeoutMS,
@@ -417,6 +446,52 @@ typedef BOOL KUSB_API IsoK_EnumPackets_T(
 typedef BOOL KUSB_API IsoK_ReUse_T(
     _ref PKISO_CONTEXT IsoContext);
 
+typedef BOOL KUSB_API IsoK_InitLayout_T(
+    _out PKISO_LAYOUT* IsoLayout,
+    _in PKISO_LAYOUT_PARAMS Params,
+    _in INT NumberOfPackets);
+
+typedef BOOL KUSB_API IsoK_FreeLayout_T(
+    _in PKISO_LAYOUT IsoLayout);
+
+typedef BOOL KUSB_API IsoK_ApplyLayout_T(
+    _in PKISO_LAYOUT IsoLayout,
+    _ref PKISO_CONTEXT IsoContext,
+    _outopt PUINT TransferLength);
+
+typedef BOOL KUSB_API IsoK_CompactPackets_T(
+    _in PKISO_CONTEXT IsoContext,
+    _in PUCHAR Buffer,
+    _out PUCHAR Output,
+    _in UINT OutputLength,
+    _out PUINT CompactedLength);
+
+typedef BOOL KUSB_API IsoK_StreamInit_T(
+    _out PKISO_STREAM* IsoStream,
+    _in KUSB_HANDLE UsbHandle,
+    _in UCHAR PipeID,
+    _in PKISO_STREAM_PARAMS Params);
+
+typedef BOOL KUSB_API IsoK_StreamFree_T(
+    _in PKISO_STREAM IsoStream);
+
+typedef BOOL KUSB_API IsoK_StreamStart_T(
+    _in PKISO_STREAM IsoStream);
+
+typedef BOOL KUSB_API IsoK_StreamStop_T(
+    _in PKISO_STREAM IsoStream);
+
+typedef BOOL KUSB_API IsoK_StreamRead_T(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_PACKET Packet,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in UINT TimeoutMS);
+
+typedef BOOL KUSB_API IsoK_StreamGetStats_T(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_STATS Stats);
+
 
 
 ///////////////////////////////////////////////////////////////////////
@@ -513,6 +588,12 @@ static UsbK_GetOverlappedResult_T* pUsbK_GetOverlappedResult = NULL;
 
 static UsbK_GetProperty_T* pUsbK_GetProperty = NULL;
 
+static UsbK_GetPipeStats_T* pUsbK_GetPipeStats = NULL;
+
+static UsbK_SubmitBatch_T* pUsbK_SubmitBatch = NULL;
+
+static UsbK_ReadPackets_T* pUsbK_ReadPackets = NULL;
+
 static LstK_Init_T* pLstK_Init = NULL;
 
 static LstK_InitEx_T* pLstK_InitEx = NULL;
@@ -551,6 +632,8 @@ static OvlK_Wait_T* pOvlK_Wait = NULL;
 
 static OvlK_WaitOldest_T* pOvlK_WaitOldest = NULL;
 
+static OvlK_WaitAny_T* pOvlK_WaitAny = NULL;
+
 static OvlK_WaitOrCancel_T* pOvlK_WaitOrCancel = NULL;
 
 static OvlK_WaitAndRelease_T* pOvlK_WaitAndRelease = NULL;
@@ -585,6 +668,26 @@ static IsoK_EnumPackets_T* pIsoK_EnumPackets = NULL;
 
 static IsoK_ReUse_T* pIsoK_ReUse = NULL;
 
+static IsoK_InitLayout_T* pIsoK_InitLayout = NULL;
+
+static IsoK_FreeLayout_T* pIsoK_FreeLayout = NULL;
+
+static IsoK_ApplyLayout_T* pIsoK_ApplyLayout = NULL;
+
+static IsoK_CompactPackets_T* pIsoK_CompactPackets = NULL;
+
+static IsoK_StreamInit_T* pIsoK_StreamInit = NULL;
+
+static IsoK_StreamFree_T* pIsoK_StreamFree = NULL;
+
+static IsoK_StreamStart_T* pIsoK_StreamStart = NULL;
+
+static IsoK_StreamStop_T* pIsoK_StreamStop = NULL;
+
+static IsoK_StreamRead_T* pIsoK_StreamRead = NULL;
+
+static IsoK_StreamGetStats_T* pIsoK_StreamGetStats = NULL;
+
 
 
 ///////////////////////////////////////////////////////////////////////
@@ -689,6 +792,12 @@ VOID LibusbK_DynApi_Free(VOID)
 
 		pUsbK_GetProperty = NULL;
 
+		pUsbK_GetPipeStats = NULL;
+
+		pUsbK_SubmitBatch = NULL;
+
+		pUsbK_ReadPackets = NULL;
+
 		pLstK_Init = NULL;
 
 		pLstK_InitEx = NULL;
@@ -727,6 +836,8 @@ VOID LibusbK_DynApi_Free(VOID)
 
 		pOvlK_WaitOldest = NULL;
 
+		pOvlK_WaitAny = NULL;
+
 		pOvlK_WaitOrCancel = NULL;
 
 		pOvlK_WaitAndRelease = NULL;
@@ -761,6 +872,26 @@ VOID LibusbK_DynApi_Free(VOID)
 
 		pIsoK_ReUse = NULL;
 
+		pIsoK_InitLayout = NULL;
+
+		pIsoK_FreeLayout = NULL;
+
+		pIsoK_ApplyLayout = NULL;
+
+		pIsoK_CompactPackets = NULL;
+
+		pIsoK_StreamInit = NULL;
+
+		pIsoK_StreamFree = NULL;
+
+		pIsoK_StreamStart = NULL;
+
+		pIsoK_StreamStop = NULL;
+
+		pIsoK_StreamRead = NULL;
+
+		pIsoK_StreamGetStats = NULL;
+
 
 
 		///////////////////////////////////////////////////////////////////////
@@ -1054,6 +1185,24 @@ INT LibusbK_DynApi_Init(_inopt LPCSTR DllFullPathName)
 		OutputDebugStringA("Failed loading function UsbK_GetProperty.\n");
 	}
 
+	if ((pUsbK_GetPipeStats = (UsbK_GetPipeStats_T*)GetProcAddress(mLibusbK_ModuleHandle, "UsbK_GetPipeStats")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function UsbK_GetPipeStats.\n");
+	}
+
+	if ((pUsbK_SubmitBatch = (UsbK_SubmitBatch_T*)GetProcAddress(mLibusbK_ModuleHandle, "UsbK_SubmitBatch")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function UsbK_SubmitBatch.\n");
+	}
+
+	if ((pUsbK_ReadPackets = (UsbK_ReadPackets_T*)GetProcAddress(mLibusbK_ModuleHandle, "UsbK_ReadPackets")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function UsbK_ReadPackets.\n");
+	}
+
 	if ((pLstK_Init = (LstK_Init_T*)GetProcAddress(mLibusbK_ModuleHandle, "LstK_Init")) == NULL)
 	{
 		funcLoadFailCount++;
@@ -1168,6 +1317,12 @@ INT LibusbK_DynApi_Init(_inopt LPCSTR DllFullPathName)
 		OutputDebugStringA("Failed loading function OvlK_WaitOldest.\n");
 	}
 
+	if ((pOvlK_WaitAny = (OvlK_WaitAny_T*)GetProcAddress(mLibusbK_ModuleHandle, "OvlK_WaitAny")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function OvlK_WaitAny.\n");
+	}
+
 	if ((pOvlK_WaitOrCancel = (OvlK_WaitOrCancel_T*)GetProcAddress(mLibusbK_ModuleHandle, "OvlK_WaitOrCancel")) == NULL)
 	{
 		funcLoadFailCount++;
@@ -1270,6 +1425,66 @@ INT LibusbK_DynApi_Init(_inopt LPCSTR DllFullPathName)
 		OutputDebugStringA("Failed loading function IsoK_ReUse.\n");
 	}
 
+	if ((pIsoK_InitLayout = (IsoK_InitLayout_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_InitLayout")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_InitLayout.\n");
+	}
+
+	if ((pIsoK_FreeLayout = (IsoK_FreeLayout_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_FreeLayout")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_FreeLayout.\n");
+	}
+
+	if ((pIsoK_ApplyLayout = (IsoK_ApplyLayout_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_ApplyLayout")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_ApplyLayout.\n");
+	}
+
+	if ((pIsoK_CompactPackets = (IsoK_CompactPackets_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_CompactPackets")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_CompactPackets.\n");
+	}
+
+	if ((pIsoK_StreamInit = (IsoK_StreamInit_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamInit")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamInit.\n");
+	}
+
+	if ((pIsoK_StreamFree = (IsoK_StreamFree_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamFree")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamFree.\n");
+	}
+
+	if ((pIsoK_StreamStart = (IsoK_StreamStart_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamStart")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamStart.\n");
+	}
+
+	if ((pIsoK_StreamStop = (IsoK_StreamStop_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamStop")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamStop.\n");
+	}
+
+	if ((pIsoK_StreamRead = (IsoK_StreamRead_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamRead")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamRead.\n");
+	}
+
+	if ((pIsoK_StreamGetStats = (IsoK_StreamGetStats_T*)GetProcAddress(mLibusbK_ModuleHandle, "IsoK_StreamGetStats")) == NULL)
+	{
+		funcLoadFailCount++;
+		OutputDebugStringA("Failed loading function IsoK_StreamGetStats.\n");
+	}
+
 
 
 	///////////////////////////////////////////////////////////////////////
@@ -1642,6 +1857,37 @@ KUSB_EXP BOOL KUSB_API UsbK_GetProperty (
 	return pUsbK_GetProperty(InterfaceHandle, PropertyType, PropertySize, Value);
 }
 
+KUSB_EXP BOOL KUSB_API UsbK_GetPipeStats (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats)
+{
+	return pUsbK_GetPipeStats(InterfaceHandle, PipeID, Stats);
+}
+
+KUSB_EXP BOOL KUSB_API UsbK_SubmitBatch (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped)
+{
+	return pUsbK_SubmitBatch(InterfaceHandle, PipeID, Entries, EntryCount, Buffer, BufferLength, Overlapped);
+}
+
+KUSB_EXP BOOL KUSB_API UsbK_ReadPackets (
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped)
+{
+	return pUsbK_ReadPackets(InterfaceHandle, PipeID, Buffer, BufferLength, LengthTransferred, Overlapped);
+}
+
 KUSB_EXP BOOL KUSB_API LstK_Init(
     _out KLST_HANDLE* DeviceList,
     _in KLST_FLAG Flags)
@@ -1778,6 +2024,16 @@ KUSB_EXP BOOL KUSB_API OvlK_WaitOldest(
 	return pOvlK_WaitOldest(PoolHandle, OverlappedK, TimeoutMS, WaitFlags, TransferredLength);
 }
 
+KUSB_EXP BOOL KUSB_API OvlK_WaitAny(
+    _in KOVL_POOL_HANDLE PoolHandle,
+    _out KOVL_HANDLE* OverlappedK,
+    _inopt INT TimeoutMS,
+    _inopt KOVL_WAIT_FLAG WaitFlags,
+    _out PUINT TransferredLength)
+{
+	return pOvlK_WaitAny(PoolHandle, OverlappedK, TimeoutMS, WaitFlags, TransferredLength);
+}
+
 KUSB_EXP BOOL KUSB_API OvlK_WaitOrCancel(
     _in KOVL_HANDLE OverlappedK,
     _inopt INT TimeoutMS,
@@ -1910,6 +2166,82 @@ KUSB_EXP BOOL KUSB_API IsoK_ReUse(
 	return pIsoK_ReUse(IsoContext);
 }
 
+KUSB_EXP BOOL KUSB_API IsoK_InitLayout(
+    _out PKISO_LAYOUT* IsoLayout,
+    _in PKISO_LAYOUT_PARAMS Params,
+    _in INT NumberOfPackets)
+{
+	return pIsoK_InitLayout(IsoLayout, Params, NumberOfPackets);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_FreeLayout(
+    _in PKISO_LAYOUT IsoLayout)
+{
+	return pIsoK_FreeLayout(IsoLayout);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_ApplyLayout(
+    _in PKISO_LAYOUT IsoLayout,
+    _ref PKISO_CONTEXT IsoContext,
+    _outopt PUINT TransferLength)
+{
+	return pIsoK_ApplyLayout(IsoLayout, IsoContext, TransferLength);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_CompactPackets(
+    _in PKISO_CONTEXT IsoContext,
+    _in PUCHAR Buffer,
+    _out PUCHAR Output,
+    _in UINT OutputLength,
+    _out PUINT CompactedLength)
+{
+	return pIsoK_CompactPackets(IsoContext, Buffer, Output, OutputLength, CompactedLength);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamInit(
+    _out PKISO_STREAM* IsoStream,
+    _in KUSB_HANDLE UsbHandle,
+    _in UCHAR PipeID,
+    _in PKISO_STREAM_PARAMS Params)
+{
+	return pIsoK_StreamInit(IsoStream, UsbHandle, PipeID, Params);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamFree(
+    _in PKISO_STREAM IsoStream)
+{
+	return pIsoK_StreamFree(IsoStream);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamStart(
+    _in PKISO_STREAM IsoStream)
+{
+	return pIsoK_StreamStart(IsoStream);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamStop(
+    _in PKISO_STREAM IsoStream)
+{
+	return pIsoK_StreamStop(IsoStream);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamRead(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_PACKET Packet,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in UINT TimeoutMS)
+{
+	return pIsoK_StreamRead(IsoStream, Packet, Buffer, BufferLength, TimeoutMS);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamGetStats(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_STATS Stats)
+{
+	return pIsoK_StreamGetStats(IsoStream, Stats);
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////
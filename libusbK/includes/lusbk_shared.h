@@ -42,6 +42,7 @@ typedef enum _USBD_PIPE_TYPE
 #define ISO_START_LATENCY		0x20
 #define ISO_ALWAYS_START_ASAP	0x21
 #define ISO_NUM_FIXED_PACKETS	0x22
+#define ISO_AUTO_PACKET_TEMPLATE	0x23
 
 // http://msdn.microsoft.com/en-us/library/windows/hardware/ff552359%28v=vs.85%29.aspx
 // Settings.Parallel.NumberOfPresentedRequests
@@ -49,6 +50,36 @@ typedef enum _USBD_PIPE_TYPE
 // time. Available in version 1.9 and later versions of KMDF.
 #define SIMUL_PARALLEL_REQUESTS	0x30
 
+// Maximum number of stages a sequential (RAW_IO=FALSE) bulk or interrupt
+// transfer keeps in flight. 0 or 1 sends one stage at a time.
+#define PIPELINE_DEPTH			0x31
+
+// Largest stage (in bytes) a sequential bulk or interrupt transfer is split
+// into. 0 picks a size from the device speed and USB stack. Never larger
+// than the maximum transfer size reported by the USB stack.
+#define MAXIMUM_STAGE_SIZE		0x32
+
+// Read-only; gets a KPIPE_SPLIT_INFO describing how transfers are split.
+#define PIPE_SPLIT_INFO			0x33
+
+// Pipe 0 only. Request classes (CONTROL_CACHE_xxx flags) whose read-only
+// control responses are answered from a driver cache after the first
+// successful transfer. 0 (the default) disables the cache.
+#define CONTROL_RESPONSE_CACHE	0x34
+
+// Bulk and interrupt IN pipes only. Number of reads (1-16) the driver keeps
+// sent into a driver packet ring; read the packets with UsbK_ReadPackets.
+// 0 (the default) disables the continuous reader.
+#define CONTINUOUS_READER		0x35
+
+// CONTROL_RESPONSE_CACHE flags ////
+// Standard GET_DESCRIPTOR requests. (string, BOS, class-specific, ..)
+#define CONTROL_CACHE_STANDARD	0x01
+// Class device-to-host requests.
+#define CONTROL_CACHE_CLASS		0x02
+// Vendor device-to-host requests.
+#define CONTROL_CACHE_VENDOR	0x04
+
 // Power policy types //////////////
 #define AUTO_SUSPEND            0x81
 #define SUSPEND_DELAY           0x83
@@ -81,6 +112,155 @@ typedef struct _WINUSB_PIPE_INFORMATION
 typedef WINUSB_PIPE_INFORMATION* PWINUSB_PIPE_INFORMATION;
 C_ASSERT(sizeof(WINUSB_PIPE_INFORMATION) == 12);
 
+//! The \c KPIPE_SPLIT_INFO structure describes how a pipe splits transfers into stages.
+/*!
+* Returned by \ref UsbK_GetPipePolicy for the \c PIPE_SPLIT_INFO policy type.
+*/
+typedef struct _KPIPE_SPLIT_INFO
+{
+	//! Largest stage, in bytes, a transfer is split into. This is also the \c MAXIMUM_TRANSFER_SIZE.
+	UINT StageSize;
+
+	//! The \c MAXIMUM_STAGE_SIZE policy value. (0 = automatic)
+	UINT StageSizePolicy;
+
+	//! Stage size the driver uses when \c MAXIMUM_STAGE_SIZE is 0.
+	UINT AutoStageSize;
+
+	//! Maximum transfer size reported by the USB stack.
+	UINT StackMaxTransferSize;
+
+	//! The \c PIPELINE_DEPTH policy value. (stages kept in flight)
+	UINT PipelineDepth;
+
+	//! USBDI version of the USB stack. (0x600 = Vista/7, 0x602 = Windows 8 and later)
+	USHORT UsbdiVersion;
+
+	//! \c LowSpeed, \c FullSpeed or \c HighSpeed
+	UCHAR DeviceSpeed;
+
+	//! Reserved; always 0.
+	UCHAR Reserved;
+
+} KPIPE_SPLIT_INFO;
+//! Pointer to a \ref KPIPE_SPLIT_INFO structure
+typedef KPIPE_SPLIT_INFO* PKPIPE_SPLIT_INFO;
+C_ASSERT(sizeof(KPIPE_SPLIT_INFO) == 24);
+
+//! Number of completion latency buckets in a \ref KPIPE_STATS.
+#define KPIPE_STATS_LATENCY_BUCKETS 10
+
+//! The \c KPIPE_STATS structure contains the performance counters the driver keeps for a pipe.
+/*!
+* Returned by \ref UsbK_GetPipeStats. Counters start at zero when the device is
+* started and are kept across interface and alternate setting changes.
+*/
+typedef struct _KPIPE_STATS
+{
+	//! Read and write requests completed.
+	UINT Requests;
+
+	//! Requests completed with an error. (includes timeouts)
+	UINT Errors;
+
+	//! Requests cancelled by the \c PIPE_TRANSFER_TIMEOUT policy.
+	UINT Timeouts;
+
+	//! Stage transfers sent to the USB stack. (divide by \c Requests for stages per request)
+	UINT Stages;
+
+	//! Reads the device sent more data to than was requested; the rest is kept for the next read unless \c AUTO_FLUSH is set.
+	UINT PartialReads;
+
+	//! Stalls cleared by the \c AUTO_CLEAR_STALL policy.
+	UINT StallClears;
+
+	//! Requests currently in progress.
+	UINT InFlight;
+
+	//! Most requests ever in progress at the same time.
+	UINT InFlightPeak;
+
+	//! Bytes transferred by completed requests.
+	ULONGLONG Bytes;
+
+	//! Bytes read through the pipe bounce buffer. (reads that are not a multiple of the maximum packet size)
+	ULONGLONG BounceBytes;
+
+	//! Completion latencies; bucket 0 is less than 125us, bucket n is less than 125us << n, the last bucket is 32ms or more.
+	UINT Latency[KPIPE_STATS_LATENCY_BUCKETS];
+
+	//! Isochronous URBs taken from the pipe URB pool.
+	UINT UrbPoolHits;
+
+	//! Isochronous URBs allocated from nonpaged pool because the URB pool was empty or the URB was too large.
+	UINT UrbPoolMisses;
+
+	//! Most URB pool blocks ever in use at the same time.
+	UINT UrbPoolPeakInUse;
+
+	//! Reserved; always 0.
+	UINT Reserved;
+
+} KPIPE_STATS;
+//! Pointer to a \ref KPIPE_STATS structure
+typedef KPIPE_STATS* PKPIPE_STATS;
+C_ASSERT(sizeof(KPIPE_STATS) == 104);
+
+//! Most transfers in one \ref UsbK_SubmitBatch call.
+#define KUSB_BATCH_MAX_ENTRIES 1024
+
+//! The \c KUSB_BATCH_ENTRY structure describes one transfer of a \ref UsbK_SubmitBatch call.
+/*!
+* Every transfer of a batch uses a range of the batch data buffer. The driver
+* fills in \c Transferred and \c Status when the transfer completes.
+*/
+typedef struct _KUSB_BATCH_ENTRY
+{
+	//! Offset of the transfer data in the batch buffer.
+	UINT Offset;
+
+	//! Bytes to transfer. 0 sends a zero-length packet. (writes only)
+	UINT Length;
+
+	//! Bytes transferred.
+	UINT Transferred;
+
+	//! Completion status of the transfer; 0 on success. Transfers that were not sent because an earlier transfer failed are \c STATUS_CANCELLED (0xC0000120).
+	INT Status;
+
+} KUSB_BATCH_ENTRY;
+//! Pointer to a \ref KUSB_BATCH_ENTRY structure
+typedef KUSB_BATCH_ENTRY* PKUSB_BATCH_ENTRY;
+C_ASSERT(sizeof(KUSB_BATCH_ENTRY) == 16);
+
+//! Packets were dropped before this one because the driver packet ring was full.
+#define KUSB_PACKET_FLAG_OVERRUN 0x00000001
+
+//! Bytes a packet of \c DataLength bytes takes up in a \ref UsbK_ReadPackets buffer.
+#define KUSB_PACKET_SIZE(DataLength) (sizeof(KUSB_PACKET_HEADER) + (((DataLength) + 7) & ~7))
+
+//! The \c KUSB_PACKET_HEADER structure starts every packet returned by \ref UsbK_ReadPackets.
+/*!
+* The packet data follows the header. The next header starts \ref KUSB_PACKET_SIZE (\c Length)
+* bytes after this one.
+*/
+typedef struct _KUSB_PACKET_HEADER
+{
+	//! Packet data length; may be 0.
+	UINT Length;
+
+	//! \c KUSB_PACKET_FLAG_xxx flags.
+	UINT Flags;
+
+	//! Time the read completed, in \c QueryPerformanceCounter ticks.
+	LONGLONG Timestamp;
+
+} KUSB_PACKET_HEADER;
+//! Pointer to a \ref KUSB_PACKET_HEADER structure
+typedef KUSB_PACKET_HEADER* PKUSB_PACKET_HEADER;
+C_ASSERT(sizeof(KUSB_PACKET_HEADER) == 16);
+
 #include <pshpack1.h>
 
 //! The \c WINUSB_SETUP_PACKET structure describes a USB setup packet.
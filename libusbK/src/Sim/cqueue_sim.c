@@ -0,0 +1,395 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the shared completion queue and the OvlK_WaitAny reap path.
+// (see lusbk_cqueue.h and lusbk_overlapped.c)
+//
+// Tags     : CQueue_TagIndex maps OVERLAPPED addresses of a handle array to
+//            their index and rejects every other address.
+// Threads  : a driver thread completes transfers the way libusbK.sys does:
+//            it posts the record, then completes the OVERLAPPED and sets its
+//            event, sometimes with a delay between the two. It also posts
+//            records for i/o that is not the pool's. The consumer reaps them
+//            the way OvlK_WaitAny does: a tag is looked up by index, a
+//            record is used without waiting once the OVERLAPPED shows the
+//            same result, a still pending OVERLAPPED is waited on, and after
+//            the queue dropped records completions are found by scanning.
+//            Every transfer must be returned exactly once with its own
+//            result, and a consumer blocked on the queue event must always
+//            be woken. A small queue is run as well so records are dropped.
+//
+// Usage: cqueue_sim [transfers=<count>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include "lusbk_cqueue.h"
+
+#define SIM_STATUS_PENDING	0x00000103
+#define SIM_STATUS_FAILED	((int)0xC0000001)
+
+// Handles of the simulated OvlK handle pool; the even ones belong to the pool under test.
+#define SIM_HANDLES			64
+#define SIM_POOL_HANDLES	(SIM_HANDLES / 2)
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+// OVERLAPPED; Internal and InternalHigh are the I/O status block the driver completes.
+typedef struct _SIM_OVERLAPPED
+{
+	volatile unsigned long Internal;
+	volatile unsigned long InternalHigh;
+	unsigned long Offset;
+	unsigned long OffsetHigh;
+	volatile int Event;
+} SIM_OVERLAPPED;
+
+// KOVL_HANDLE_INTERNAL; the OVERLAPPED comes first.
+typedef struct _SIM_HANDLE
+{
+	SIM_OVERLAPPED Overlapped;
+	int Pool;
+	int IsAcquired;
+	int IsReaped;
+
+	// Transfer the handle is submitted for.
+	unsigned int Transfer;
+} SIM_HANDLE;
+
+typedef struct _SIM_RUN
+{
+	SIM_HANDLE Handles[SIM_HANDLES];
+
+	// An OVERLAPPED of other i/o on the same device handle.
+	SIM_OVERLAPPED Foreign;
+
+	KCQ_PRODUCER Producer;
+	KCQ_CONSUMER Consumer;
+	void* Buffer;
+	sem_t Event;
+
+	// Submitted handles waiting for the driver. (Lock)
+	pthread_mutex_t Lock;
+	unsigned int Submitted[SIM_HANDLES];
+	unsigned int SubmitHead, SubmitTail;
+	volatile int Stop;
+
+	unsigned int Transfers;
+	unsigned char* Returned;
+
+	// Reap paths taken.
+	unsigned int FromRecord, WaitedPending, FromScan, Waits, Stale;
+	int Dropped;
+} SIM_RUN;
+
+static SIM_RUN Sim_Run;
+
+// Result of a transfer.
+static int Sim_TransferStatus(unsigned int transfer)
+{
+	return transfer % 97 == 0 ? SIM_STATUS_FAILED : 0;
+}
+
+static unsigned int Sim_TransferLength(unsigned int transfer)
+{
+	return Sim_TransferStatus(transfer) ? 0 : (transfer * 7) % 4097;
+}
+
+static void Sim_CheckTags(void)
+{
+	static SIM_HANDLE handles[8];
+	unsigned long long first = (unsigned long long)(size_t)&handles[0].Overlapped;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		SIM_CHECK(CQueue_TagIndex((unsigned long long)(size_t)&handles[i].Overlapped, first, sizeof(SIM_HANDLE), 8) == (int)i,
+		          "tags: handle %u not found", i);
+		SIM_CHECK(CQueue_TagIndex((unsigned long long)(size_t)&handles[i].Overlapped + 4, first, sizeof(SIM_HANDLE), 8) == -1,
+		          "tags: address inside handle %u accepted", i);
+	}
+	SIM_CHECK(CQueue_TagIndex(first - sizeof(SIM_HANDLE), first, sizeof(SIM_HANDLE), 8) == -1, "tags: address below the array accepted");
+	SIM_CHECK(CQueue_TagIndex(first + 8 * sizeof(SIM_HANDLE), first, sizeof(SIM_HANDLE), 8) == -1, "tags: address past the array accepted");
+	SIM_CHECK(CQueue_TagIndex(0, first, sizeof(SIM_HANDLE), 8) == -1, "tags: NULL accepted");
+	SIM_CHECK(CQueue_TagIndex(first, first, 0, 8) == -1, "tags: zero element size accepted");
+	SIM_CHECK(CQueue_TagIndex(0xFFFFFFFFFFFFFFF0ULL, 0xFFFFFFFFFFFFFF00ULL, 0x10, 8) == -1 &&
+	          CQueue_TagIndex(0xFFFFFFFFFFFFFF70ULL, 0xFFFFFFFFFFFFFF00ULL, 0x10, 8) == 7, "tags: top of the address space");
+}
+
+static unsigned long long Sim_Tag(const SIM_OVERLAPPED* overlapped)
+{
+	return (unsigned long long)(size_t)overlapped;
+}
+
+// libusbK.sys: takes submitted transfers in order and completes them.
+static void* Sim_DriverThread(void* context)
+{
+	SIM_HANDLE* handle;
+	unsigned int seed = 11, index, transfer;
+	int result;
+
+	(void)context;
+	while (!Sim_Run.Stop)
+	{
+		pthread_mutex_lock(&Sim_Run.Lock);
+		if (Sim_Run.SubmitHead == Sim_Run.SubmitTail)
+		{
+			pthread_mutex_unlock(&Sim_Run.Lock);
+			sched_yield();
+			continue;
+		}
+		index = Sim_Run.Submitted[Sim_Run.SubmitTail++ % SIM_HANDLES];
+		pthread_mutex_unlock(&Sim_Run.Lock);
+
+		handle = &Sim_Run.Handles[index];
+		transfer = handle->Transfer;
+		seed = (seed * 1103515245) + 12345;
+
+		// Other i/o on the device handle, and transfers of another pool.
+		if ((seed >> 16) % 8 == 0)
+		{
+			result = CQueue_Post(&Sim_Run.Producer, Sim_Tag(&Sim_Run.Foreign), 0, 1);
+			if (result & KCQ_POST_WAKE) sem_post(&Sim_Run.Event);
+			result = CQueue_Post(&Sim_Run.Producer, Sim_Tag(&Sim_Run.Handles[index ^ 1].Overlapped), 0, 2);
+			if (result & KCQ_POST_WAKE) sem_post(&Sim_Run.Event);
+		}
+
+		// Xfer_CompleteRequest: the record first, then the request completes.
+		result = CQueue_Post(&Sim_Run.Producer, Sim_Tag(&handle->Overlapped), Sim_TransferStatus(transfer), Sim_TransferLength(transfer));
+		if (result & KCQ_POST_WAKE) sem_post(&Sim_Run.Event);
+
+		if ((seed >> 16) % 4 == 0)
+			sched_yield();
+
+		// I/O manager: status block, then the event.
+		__atomic_store_n(&handle->Overlapped.InternalHigh, Sim_TransferLength(transfer), __ATOMIC_RELEASE);
+		__atomic_store_n(&handle->Overlapped.Internal, (unsigned long)(unsigned int)Sim_TransferStatus(transfer), __ATOMIC_RELEASE);
+		__atomic_store_n(&handle->Overlapped.Event, 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void Sim_Submit(unsigned int index, unsigned int transfer)
+{
+	SIM_HANDLE* handle = &Sim_Run.Handles[index];
+
+	// OvlK_ReUse and the transfer call.
+	handle->IsReaped = 0;
+	handle->Transfer = transfer;
+	handle->Overlapped.Event = 0;
+	handle->Overlapped.InternalHigh = 0;
+	__atomic_store_n(&handle->Overlapped.Internal, SIM_STATUS_PENDING, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&Sim_Run.Lock);
+	Sim_Run.Submitted[Sim_Run.SubmitHead++ % SIM_HANDLES] = index;
+	pthread_mutex_unlock(&Sim_Run.Lock);
+}
+
+// o_FindAcquired.
+static SIM_HANDLE* Sim_FindAcquired(unsigned long long tag)
+{
+	int index = CQueue_TagIndex(tag, Sim_Tag(&Sim_Run.Handles[0].Overlapped), sizeof(SIM_HANDLE), SIM_HANDLES);
+
+	if (index < 0) return NULL;
+	return (Sim_Run.Handles[index].Pool == 0 && Sim_Run.Handles[index].IsAcquired) ? &Sim_Run.Handles[index] : NULL;
+}
+
+// OvlK_Wait without a timeout.
+static void Sim_WaitEvent(SIM_HANDLE* handle)
+{
+	while (!__atomic_load_n(&handle->Overlapped.Event, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+// OvlK_WaitAny. Returns the reaped handle.
+static SIM_HANDLE* Sim_WaitAny(void)
+{
+	SIM_HANDLE* handle;
+	KCQ_RECORD record;
+	struct timespec timeout;
+	unsigned int index;
+
+	for (;;)
+	{
+		while (CQueue_Reap(&Sim_Run.Consumer, &record, 1))
+		{
+			handle = Sim_FindAcquired(record.Tag);
+			if (!handle || handle->IsReaped) continue;
+
+			if (record.Status == 0 && __atomic_load_n(&handle->Overlapped.Internal, __ATOMIC_ACQUIRE) != SIM_STATUS_PENDING &&
+			        (int)handle->Overlapped.Internal == record.Status && handle->Overlapped.InternalHigh == record.Transferred)
+			{
+				Sim_Run.FromRecord++;
+			}
+			else
+			{
+				if (__atomic_load_n(&handle->Overlapped.Internal, __ATOMIC_ACQUIRE) == SIM_STATUS_PENDING)
+					Sim_Run.WaitedPending++;
+				else if (record.Status == 0)
+					Sim_Run.Stale++;
+				Sim_WaitEvent(handle);
+			}
+			handle->IsReaped = 1;
+			return handle;
+		}
+		if (CQueue_CheckDropped(&Sim_Run.Consumer))
+			Sim_Run.Dropped = 1;
+
+		if (!Sim_Run.Dropped)
+		{
+			// Widens the window between the last reap and the wait, where a record can arrive unnoticed.
+			if (++Sim_Run.Waits % 2)
+				sched_yield();
+
+			if (!CQueue_PrepareWait(&Sim_Run.Consumer)) continue;
+
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_sec += 5;
+			if (sem_timedwait(&Sim_Run.Event, &timeout))
+			{
+				SIM_CHECK(errno != ETIMEDOUT, "threads: consumer was never woken");
+				CQueue_CancelWait(&Sim_Run.Consumer);
+				return NULL;
+			}
+			continue;
+		}
+
+		// After a drop: find completions by their events, oldest handle first.
+		for (index = 0; index < SIM_HANDLES; index += 2)
+		{
+			handle = &Sim_Run.Handles[index];
+			if (handle->IsAcquired && !handle->IsReaped && __atomic_load_n(&handle->Overlapped.Event, __ATOMIC_ACQUIRE))
+			{
+				Sim_Run.FromScan++;
+				handle->IsReaped = 1;
+				return handle;
+			}
+		}
+		for (index = 0; index < SIM_HANDLES; index += 2)
+		{
+			if (Sim_Run.Handles[index].IsAcquired && !Sim_Run.Handles[index].IsReaped) break;
+		}
+		if (index == SIM_HANDLES) Sim_Run.Dropped = 0;
+		sched_yield();
+	}
+}
+
+static void Sim_CheckThreads(unsigned int recordCount, unsigned int inFlight, unsigned int transfers)
+{
+	pthread_t driver;
+	SIM_HANDLE* handle;
+	unsigned int i, next = 0, done = 0, result, length, errors = 0;
+
+	memset(&Sim_Run, 0, sizeof(Sim_Run));
+	pthread_mutex_init(&Sim_Run.Lock, NULL);
+	sem_init(&Sim_Run.Event, 0, 0);
+	Sim_Run.Transfers = transfers;
+	Sim_Run.Returned = (unsigned char*)calloc(transfers, 1);
+	Sim_Run.Buffer = calloc(1, KCQ_BUFFER_SIZE(recordCount));
+
+	CQueue_InitConsumer(&Sim_Run.Consumer, Sim_Run.Buffer, recordCount);
+	SIM_CHECK(CQueue_InitProducer(&Sim_Run.Producer, Sim_Run.Buffer, (unsigned int)KCQ_BUFFER_SIZE(recordCount)), "threads: producer rejected the queue");
+
+	for (i = 0; i < SIM_HANDLES; i++)
+		Sim_Run.Handles[i].Pool = i & 1;
+
+	pthread_create(&driver, NULL, Sim_DriverThread, NULL);
+
+	// The odd handles belong to another pool and are never submitted here.
+	for (i = 0; i < inFlight && next < transfers; i++)
+	{
+		Sim_Run.Handles[i * 2].IsAcquired = 1;
+		Sim_Submit(i * 2, next++);
+	}
+
+	while (done < transfers)
+	{
+		handle = Sim_WaitAny();
+		if (!handle) break;
+
+		result = handle->Transfer;
+		length = (unsigned int)handle->Overlapped.InternalHigh;
+		if (result >= transfers || Sim_Run.Returned[result] ||
+		        (int)handle->Overlapped.Internal != Sim_TransferStatus(result) || length != Sim_TransferLength(result))
+		{
+			if (errors++ < 10)
+				SIM_CHECK(0, "threads: transfer %u returned twice or with the wrong result (%08lXh %u)", result, handle->Overlapped.Internal, length);
+		}
+		else
+		{
+			Sim_Run.Returned[result] = 1;
+		}
+		done++;
+
+		if (next < transfers)
+			Sim_Submit((unsigned int)(handle - Sim_Run.Handles), next++);
+	}
+
+	Sim_Run.Stop = 1;
+	pthread_join(driver, NULL);
+
+	for (i = 0; i < transfers && done == transfers; i++)
+		SIM_CHECK(Sim_Run.Returned[i], "threads: transfer %u never returned", i);
+	SIM_CHECK(done == transfers, "threads: %u of %u transfers returned", done, transfers);
+
+	printf("threads : queue %5u, %2u in flight, %u transfers: %u from records, %u waited pending, %u stale, %u by scan, %u waits, %u dropped\n",
+	       recordCount, inFlight, transfers, Sim_Run.FromRecord, Sim_Run.WaitedPending, Sim_Run.Stale, Sim_Run.FromScan,
+	       Sim_Run.Waits, Sim_Run.Consumer.Dropped);
+
+	sem_destroy(&Sim_Run.Event);
+	pthread_mutex_destroy(&Sim_Run.Lock);
+	free(Sim_Run.Buffer);
+	free(Sim_Run.Returned);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int transfers = 200000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "transfers=", 10))
+			transfers = (unsigned int)atoi(argv[i] + 10);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!transfers) transfers = 1;
+
+	Sim_CheckTags();
+
+	// Queue sized the way OvlK_Init sizes it, and one small enough to drop records.
+	Sim_CheckThreads(CQueue_RecordCount(SIM_POOL_HANDLES * 4), SIM_POOL_HANDLES, transfers);
+	Sim_CheckThreads(CQueue_RecordCount(1), 1, transfers);
+	Sim_CheckThreads(KCQ_MIN_RECORDS, SIM_POOL_HANDLES, transfers);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,350 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the isochronous packet layout engine. (see lusbk_iso_layout.h)
+//
+// Checks the packet size pattern of fractional sample rates (44.1 kHz and
+// others) against the exact sample count, the high-bandwidth
+// transactions-per-microframe bits of wMaxPacketSize, the layout limits,
+// and in-place packet compaction. Then reports the cost of applying a
+// precomputed layout against rebuilding it per transfer, and the
+// compaction throughput.
+//
+// Usage: iso_layout_sim [loops=<count>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lusbk_iso_layout.h"
+
+#define SIM_MAX_PACKETS	KISO_LAYOUT_MAX_TABLE_PACKETS
+
+static KISO_LAYOUT_PACKET Sim_Packets[SIM_MAX_PACKETS];
+static unsigned int Sim_Lengths[SIM_MAX_PACKETS];
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static double Sim_Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int Sim_Layout(const KISO_LAYOUT_SPEC* spec, unsigned int numberOfPackets, PKISO_LAYOUT_PLAN plan)
+{
+	int result = IsoLayout_Plan(spec, numberOfPackets, plan);
+	if (result == KISO_LAYOUT_OK)
+		IsoLayout_Build(spec, plan, numberOfPackets, Sim_Lengths, Sim_Packets);
+	return result;
+}
+
+// Every packet carries floor or ceil of the exact samples per packet, the
+// running total never drifts from the exact count, offsets are contiguous
+// and the phases join up into one continuous stream.
+static void Sim_CheckRate(unsigned int rate, int highSpeed, unsigned int interval, unsigned int bytesPerSample, unsigned int numberOfPackets)
+{
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	unsigned long long intervalsPerSecond = highSpeed ? 8000 : 1000;
+	unsigned long long total = 0;
+	unsigned long long expected;
+	unsigned int layoutIndex, packetIndex, offset;
+	const KISO_LAYOUT_PACKET* packet = Sim_Packets;
+	int result;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.MaxPacketSize = 1024;
+	spec.Interval = interval;
+	spec.HighSpeed = highSpeed;
+	spec.SampleRate = rate;
+	spec.BytesPerSample = bytesPerSample;
+
+	result = Sim_Layout(&spec, numberOfPackets, &plan);
+	SIM_CHECK(result == KISO_LAYOUT_OK, "%u Hz: plan failed (%d)", rate, result);
+	if (result != KISO_LAYOUT_OK) return;
+
+	for (layoutIndex = 0; layoutIndex < plan.LayoutCount; layoutIndex++)
+	{
+		offset = 0;
+		for (packetIndex = 0; packetIndex < numberOfPackets; packetIndex++, packet++)
+		{
+			unsigned int samples = packet->Length / bytesPerSample;
+
+			SIM_CHECK(packet->Length % bytesPerSample == 0, "%u Hz: packet of %u bytes splits a sample", rate, packet->Length);
+			SIM_CHECK(packet->Offset == offset, "%u Hz: phase %u packet %u offset %u, expected %u", rate, layoutIndex, packetIndex, packet->Offset, offset);
+			SIM_CHECK(samples == plan.PacketSamples || samples + 1 == plan.PacketSamples,
+			          "%u Hz: packet of %u samples, largest is %u", rate, samples, plan.PacketSamples);
+
+			total += samples;
+			expected = ((unsigned long long)rate * interval * ((layoutIndex * numberOfPackets) + packetIndex + 1)) / intervalsPerSecond;
+			SIM_CHECK(total == expected, "%u Hz: %llu samples after packet %u of phase %u, expected %llu", rate, total, packetIndex, layoutIndex, expected);
+			offset += packet->Length;
+		}
+		SIM_CHECK(Sim_Lengths[layoutIndex] == offset, "%u Hz: phase %u length %u, expected %u", rate, layoutIndex, Sim_Lengths[layoutIndex], offset);
+	}
+
+	// The last phase ends where the first one starts; the pattern repeats.
+	expected = ((unsigned long long)rate * interval * plan.LayoutCount * numberOfPackets) % intervalsPerSecond;
+	SIM_CHECK(expected == 0, "%u Hz: %u phases of %u packets do not complete the pattern", rate, plan.LayoutCount, numberOfPackets);
+
+	printf("  %6u Hz %s interval %u, %3u packets: %4u phase(s), %u-%u samples per packet\n",
+	       rate, highSpeed ? "HS" : "FS", interval, numberOfPackets, plan.LayoutCount,
+	       plan.PacketSamples - ((unsigned long long)rate * interval % intervalsPerSecond ? 1 : 0), plan.PacketSamples);
+}
+
+static void Sim_Check441(void)
+{
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	unsigned int i;
+
+	// 44.1 kHz, 16-bit stereo on a full-speed 1 ms interval: nine packets of
+	// 44 samples, then one of 45 as the 0.1 sample remainder carries over.
+	memset(&spec, 0, sizeof(spec));
+	spec.MaxPacketSize = 192;
+	spec.SampleRate = 44100;
+	spec.BytesPerSample = 4;
+
+	SIM_CHECK(Sim_Layout(&spec, 10, &plan) == KISO_LAYOUT_OK && plan.LayoutCount == 1, "44.1 kHz: 10 packets should need one phase");
+	for (i = 0; i < 10; i++)
+		SIM_CHECK(Sim_Packets[i].Length == (i == 9 ? 180 : 176), "44.1 kHz: packet %u is %u bytes", i, Sim_Packets[i].Length);
+	SIM_CHECK(Sim_Lengths[0] == 1764, "44.1 kHz: transfer length %u, expected 1764", Sim_Lengths[0]);
+
+	// Eight packet transfers: the pattern takes five transfers (40 packets) to
+	// repeat and only the first one has no 45 sample packet.
+	SIM_CHECK(Sim_Layout(&spec, 8, &plan) == KISO_LAYOUT_OK && plan.LayoutCount == 5, "44.1 kHz: 8 packets should need five phases, got %u", plan.LayoutCount);
+	for (i = 0; i < 40; i++)
+		SIM_CHECK(Sim_Packets[i].Length == ((i % 10) == 9 ? 180 : 176), "44.1 kHz: phase %u packet %u is %u bytes", i / 8, i % 8, Sim_Packets[i].Length);
+	for (i = 0; i < 5; i++)
+		SIM_CHECK(Sim_Lengths[i] == (i == 0 ? 1408 : 1412), "44.1 kHz: phase %u length %u", i, Sim_Lengths[i]);
+
+	// 176 bytes plus one sample does not fit a 178 byte endpoint.
+	spec.MaxPacketSize = 178;
+	SIM_CHECK(Sim_Layout(&spec, 10, &plan) == KISO_LAYOUT_PACKET_OVERFLOW && plan.PacketSamples == 45, "44.1 kHz: 178 byte endpoint should overflow");
+}
+
+static void Sim_CheckHighBandwidth(void)
+{
+	static const struct
+	{
+		unsigned int MaxPacketSize;
+		unsigned int Bytes;
+	} cases[] =
+	{
+		{0x0400, 1024},		// one transaction per microframe
+		{0x0C00, 2048},		// two
+		{0x1400, 3072},		// three
+		{0x13FF, 3069},		// three of 1023
+		{0x0A00, 1024},		// two of 512
+		{0x0040, 64},
+		{0x1800, 0},		// size bits clear
+		{0xE400, 1024},		// bits 13-15 are reserved and ignored
+	};
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	unsigned int i, p;
+	int result;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		SIM_CHECK(IsoLayout_MaxPacketBytes(cases[i].MaxPacketSize) == cases[i].Bytes,
+		          "wMaxPacketSize %04Xh: %u bytes per microframe, expected %u",
+		          cases[i].MaxPacketSize, IsoLayout_MaxPacketBytes(cases[i].MaxPacketSize), cases[i].Bytes);
+
+		memset(&spec, 0, sizeof(spec));
+		spec.MaxPacketSize = cases[i].MaxPacketSize;
+		spec.HighSpeed = 1;
+
+		result = Sim_Layout(&spec, 24, &plan);
+		if (!cases[i].Bytes)
+		{
+			SIM_CHECK(result == KISO_LAYOUT_BAD_PACKET_SIZE, "wMaxPacketSize %04Xh should be rejected", cases[i].MaxPacketSize);
+			continue;
+		}
+
+		SIM_CHECK(result == KISO_LAYOUT_OK && plan.LayoutCount == 1, "wMaxPacketSize %04Xh: fill layout failed", cases[i].MaxPacketSize);
+		for (p = 0; p < 24; p++)
+			SIM_CHECK(Sim_Packets[p].Length == cases[i].Bytes && Sim_Packets[p].Offset == p * cases[i].Bytes,
+			          "wMaxPacketSize %04Xh: packet %u is %u bytes at %u", cases[i].MaxPacketSize, p, Sim_Packets[p].Length, Sim_Packets[p].Offset);
+	}
+
+	// 384 kHz 32-bit 8 channel audio needs 1536 bytes per microframe: only a
+	// high-bandwidth endpoint carries it.
+	memset(&spec, 0, sizeof(spec));
+	spec.HighSpeed = 1;
+	spec.SampleRate = 384000;
+	spec.BytesPerSample = 32;
+	spec.MaxPacketSize = 0x0400;
+	SIM_CHECK(Sim_Layout(&spec, 8, &plan) == KISO_LAYOUT_PACKET_OVERFLOW, "384 kHz: 1024 byte endpoint should overflow");
+	spec.MaxPacketSize = 0x0B00;
+	SIM_CHECK(Sim_Layout(&spec, 8, &plan) == KISO_LAYOUT_OK && Sim_Packets[0].Length == 1536, "384 kHz: 2x768 byte endpoint should carry 1536 bytes");
+}
+
+static void Sim_CheckLimits(void)
+{
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.MaxPacketSize = 1023;
+	spec.SampleRate = 48000;
+	SIM_CHECK(IsoLayout_Plan(&spec, 8, &plan) == KISO_LAYOUT_BAD_SAMPLE_SIZE, "SampleRate without BytesPerSample should be rejected");
+
+	// 44.101 kHz repeats every 1000 packets; 127 packet transfers need 1000 phases.
+	spec.SampleRate = 44101;
+	spec.BytesPerSample = 4;
+	SIM_CHECK(IsoLayout_Plan(&spec, 127, &plan) == KISO_LAYOUT_TABLE_TOO_LARGE, "44101 Hz with 127 packets should exceed the table limit");
+	SIM_CHECK(IsoLayout_Plan(&spec, 50, &plan) == KISO_LAYOUT_OK && plan.LayoutCount == 20, "44101 Hz with 50 packets should need 20 phases");
+}
+
+// Packets with a status or no data are dropped; the rest are gathered to
+// the front of the same buffer.
+static void Sim_CheckCompact(void)
+{
+	enum { PACKETS = 16, SIZE = 192 };
+	static unsigned char buffer[PACKETS * SIZE];
+	static unsigned char expected[PACKETS * SIZE];
+	KISO_LAYOUT_PACKET packets[PACKETS];
+	unsigned int i, expectedLength = 0, compacted;
+	int full;
+
+	for (i = 0; i < PACKETS; i++)
+	{
+		packets[i].Offset = i * SIZE;
+		packets[i].Length = (unsigned short)((i * 37) % SIZE);		// includes a zero length packet
+		packets[i].Status = (i % 5 == 3) ? 0xC000 : 0;				// some packets in error
+		memset(&buffer[i * SIZE], 0xEE, SIZE);
+		memset(&buffer[i * SIZE], (int)(i + 1), packets[i].Length);
+
+		if (!packets[i].Status && packets[i].Length)
+		{
+			memset(&expected[expectedLength], (int)(i + 1), packets[i].Length);
+			expectedLength += packets[i].Length;
+		}
+	}
+
+	full = IsoLayout_Compact(packets, PACKETS, buffer, buffer, sizeof(buffer), &compacted);
+	SIM_CHECK(full < 0, "compact: in-place compaction reported a full buffer at packet %d", full);
+	SIM_CHECK(compacted == expectedLength, "compact: %u bytes, expected %u", compacted, expectedLength);
+	SIM_CHECK(!memcmp(buffer, expected, expectedLength), "compact: in-place data differs");
+
+	// An output buffer too small stops at the first packet that does not fit.
+	for (i = 0; i < PACKETS; i++) memset(&buffer[i * SIZE], (int)(i + 1), packets[i].Length);
+	full = IsoLayout_Compact(packets, PACKETS, buffer, expected, 1000, &compacted);
+	SIM_CHECK(full >= 0 && compacted <= 1000 && compacted + packets[full].Length > 1000,
+	          "compact: 1000 byte output stopped at packet %d with %u bytes", full, compacted);
+}
+
+static void Sim_Benchmark(unsigned int loops)
+{
+	static KISO_LAYOUT_PACKET context[64];
+	static unsigned char buffer[64 * 192];
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	unsigned int i, next = 0, compacted = 0;
+	unsigned long long sink = 0;
+	double start, applyNs, buildNs, compactNs;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.MaxPacketSize = 192;
+	spec.SampleRate = 44100;
+	spec.BytesPerSample = 4;
+	Sim_Layout(&spec, 64, &plan);
+
+	start = Sim_Now();
+	for (i = 0; i < loops; i++)
+	{
+		memcpy(context, &Sim_Packets[next * 64], sizeof(context));
+		if (++next >= plan.LayoutCount) next = 0;
+		sink += context[i & 63].Length;
+	}
+	applyNs = (Sim_Now() - start) * 1e9 / loops;
+
+	start = Sim_Now();
+	for (i = 0; i < loops; i++)
+	{
+		KISO_LAYOUT_PLAN one = plan;
+		one.LayoutCount = 1;
+		IsoLayout_Build(&spec, &one, 64, Sim_Lengths, context);
+		sink += context[i & 63].Length;
+	}
+	buildNs = (Sim_Now() - start) * 1e9 / loops;
+
+	Sim_Layout(&spec, 64, &plan);
+	memcpy(context, Sim_Packets, sizeof(context));
+	for (i = 0; i < 64; i += 7) context[i].Status = 0xC000;
+
+	start = Sim_Now();
+	for (i = 0; i < loops; i++)
+	{
+		IsoLayout_Compact(context, 64, buffer, buffer, sizeof(buffer), &compacted);
+		sink += buffer[i % compacted];
+	}
+	compactNs = (Sim_Now() - start) * 1e9 / loops;
+
+	printf("benchmark (64 packets of 44.1 kHz, %u loops):\n", loops);
+	printf("  apply precomputed layout : %8.1f ns per transfer\n", applyNs);
+	printf("  rebuild layout           : %8.1f ns per transfer\n", buildNs);
+	printf("  compact in place         : %8.1f ns per transfer (%.0f MB/s)\n", compactNs, compacted / compactNs * 1e3);
+	if (sink == 1) printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int loops = 1000000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "loops=", 6))
+			loops = (unsigned int)atoi(argv[i] + 6);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!loops) loops = 1;
+
+	printf("sample rate patterns:\n");
+	Sim_Check441();
+	Sim_CheckRate(44100, 0, 1, 4, 10);
+	Sim_CheckRate(44100, 0, 1, 4, 8);
+	Sim_CheckRate(22050, 0, 1, 4, 32);
+	Sim_CheckRate(11025, 0, 2, 2, 16);
+	Sim_CheckRate(48000, 0, 1, 6, 10);
+	Sim_CheckRate(44100, 1, 1, 8, 64);
+	Sim_CheckRate(44100, 1, 4, 8, 24);
+	Sim_CheckRate(88200, 1, 2, 6, 40);
+	Sim_CheckRate(192000, 1, 1, 6, 8);
+	Sim_CheckRate(7350, 1, 8, 2, 7);
+
+	Sim_CheckHighBandwidth();
+	Sim_CheckLimits();
+	Sim_CheckCompact();
+
+	Sim_Benchmark(loops);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,437 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of isochronous stream scheduling. (see lusbk_iso_sched.h)
+//
+// Drives the scheduler with a simulated frame clock the way the IsoK stream
+// thread does: a fixed number of transfers stay queued, and each one is
+// reaped a frame after its last packet and resubmitted with the current
+// frame. The application can be stalled for a number of frames to inject
+// lateness.
+//
+// Every packet's bus interval is marked on a map of the simulation window.
+// A scenario fails if an interval is handed out twice, if a transfer is
+// scheduled in the past, if the intervals left empty do not match
+// MissedFrames, or if the resync count is not what the lateness calls for.
+//
+// IsoSched_Submit is run like the stream engine runs it, with 44.1 kHz
+// layouts (lusbk_iso_layout.c) and a driver that rejects some start frames.
+// Every transfer must be filled once, and the samples submitted must
+// follow the exact running count of the rate.
+//
+// Usage: iso_sched_sim
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lusbk_iso_sched.h"
+#include "lusbk_iso_layout.h"
+
+#define SIM_WINDOW_FRAMES	4096
+#define SIM_MAX_PENDING		16
+#define SIM_MAX_STALLS		4
+
+typedef struct _SIM_STALL
+{
+	unsigned int AtFrame;	// frames after the first submit.
+	unsigned int Frames;
+} SIM_STALL;
+
+typedef struct _SIM_SCENARIO
+{
+	const char* Name;
+	unsigned int PacketsPerTransfer;
+	unsigned int PacketInterval;
+	int HighSpeed;
+	unsigned int FrameLead;
+	unsigned int Pending;
+	unsigned int FirstFrame;		// bus frame of the first submit. (wrap tests)
+	SIM_STALL Stalls[SIM_MAX_STALLS];
+	int ExpectResync;				// 0=none, 1=at least one
+	int ExpectGaps;					// the configuration leaves intervals empty in every transfer.
+} SIM_SCENARIO;
+
+static const SIM_SCENARIO Sim_Scenarios[] =
+{
+	{"fs 8x1, steady",              8, 1, 0, 8, 4, 1000,        {{0, 0}},                  0, 0},
+	{"fs 1x1, steady",              1, 1, 0, 2, 8, 1000,        {{0, 0}},                  0, 0},
+	{"hs 64x1, steady",            64, 1, 1, 8, 3, 1000,        {{0, 0}},                  0, 0},
+	{"hs 8x2 int=2, steady",        8, 2, 1, 4, 4, 1000,        {{0, 0}},                  0, 0},
+	{"hs 16x16 int=16, steady",    16, 16, 1, 4, 4, 1000,       {{0, 0}},                  0, 0},
+	{"fs 8x1, short stall",         8, 1, 0, 8, 4, 1000,        {{200, 20}},               0, 0},
+	{"fs 8x1, long stall",          8, 1, 0, 8, 4, 1000,        {{200, 100}},              1, 0},
+	{"hs 32x1, stalls",            32, 1, 1, 8, 3, 1000,        {{100, 30}, {700, 9}, {1500, 3}}, 1, 0},
+	{"fs 4x1, wrap",                4, 1, 0, 6, 4, 0xFFFFFE00,  {{0, 0}},                  0, 0},
+	{"hs 16x1, stall over wrap",   16, 1, 1, 8, 4, 0xFFFFFF80,  {{100, 40}},               1, 0},
+	{"hs 5x1, partial frames",      5, 1, 1, 8, 4, 1000,        {{0, 0}},                  0, 1},
+	{"hs 3x2 int=2, partial",       3, 2, 1, 8, 4, 1000,        {{0, 0}},                  0, 1},
+};
+
+static unsigned char Sim_Map[SIM_WINDOW_FRAMES * 8];
+
+typedef struct _SIM_XFER
+{
+	unsigned int StartFrame;
+	unsigned int EndFrame;		// first frame after the transfer.
+} SIM_XFER;
+
+static int Sim_Stalled(const SIM_SCENARIO* scenario, unsigned int elapsed)
+{
+	int i;
+
+	for (i = 0; i < SIM_MAX_STALLS; i++)
+	{
+		if (scenario->Stalls[i].Frames &&
+		        elapsed >= scenario->Stalls[i].AtFrame &&
+		        elapsed < scenario->Stalls[i].AtFrame + scenario->Stalls[i].Frames)
+			return 1;
+	}
+	return 0;
+}
+
+// Marks the bus intervals of a transfer. Returns the number of errors.
+static int Sim_Submit(const SIM_SCENARIO* scenario, PKISO_SCHED sched, unsigned int clock, SIM_XFER* xfer)
+{
+	unsigned int packet, frame, micro, slot;
+	int errors = 0;
+
+	xfer->StartFrame = IsoSched_Next(sched, clock);
+	xfer->EndFrame = xfer->StartFrame + sched->FramesPerTransfer;
+
+	if (IsoSched_FrameDiff(xfer->StartFrame, clock) < 1)
+	{
+		printf("  FAIL: transfer at frame %u submitted in frame %u\n", xfer->StartFrame, clock);
+		return 1;
+	}
+
+	for (packet = 0; packet < sched->PacketsPerTransfer; packet++)
+	{
+		IsoSched_PacketFrame(sched, xfer->StartFrame, packet, &frame, &micro);
+		slot = (frame - scenario->FirstFrame) * sched->IntervalsPerFrame + micro;
+		if (slot >= sizeof(Sim_Map)) continue;
+
+		if (Sim_Map[slot]++)
+		{
+			if (!errors) printf("  FAIL: frame %u.%u handed out twice\n", frame, micro);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static int Sim_Run(const SIM_SCENARIO* scenario)
+{
+	KISO_SCHED sched;
+	SIM_XFER xfers[SIM_MAX_PENDING];
+	unsigned int head = 0, i;
+	unsigned int clock = scenario->FirstFrame;
+	unsigned int firstStart, lastEnd = 0;
+	unsigned int slot, empty = 0, missed;
+	int errors = 0;
+
+	memset(Sim_Map, 0, sizeof(Sim_Map));
+	memset(xfers, 0, sizeof(xfers));
+	IsoSched_Init(&sched, scenario->PacketsPerTransfer, scenario->PacketInterval, scenario->HighSpeed, scenario->FrameLead);
+
+	for (i = 0; i < scenario->Pending; i++)
+		errors += Sim_Submit(scenario, &sched, clock, &xfers[i]);
+	firstStart = xfers[0].StartFrame;
+
+	// Run until the transfers cover most of the window.
+	while (IsoSched_FrameDiff(sched.NextStartFrame, scenario->FirstFrame) < SIM_WINDOW_FRAMES - 64)
+	{
+		clock++;
+		if (Sim_Stalled(scenario, clock - scenario->FirstFrame)) continue;
+
+		// Reap every transfer that finished before this frame, oldest first.
+		while (IsoSched_FrameDiff(clock, xfers[head].EndFrame) >= 1)
+		{
+			errors += Sim_Submit(scenario, &sched, clock, &xfers[head]);
+			if (++head >= scenario->Pending) head = 0;
+		}
+	}
+
+	for (i = 0; i < scenario->Pending; i++)
+		if (IsoSched_FrameDiff(xfers[i].EndFrame, lastEnd) > 0 || !lastEnd) lastEnd = xfers[i].EndFrame;
+
+	// Count the packet slots left empty between the first and last transfer.
+	// Slots in frames the scheduler skipped are MissedFrames; the rest are
+	// the unused end of partially filled frames.
+	for (slot = (firstStart - scenario->FirstFrame) * sched.IntervalsPerFrame;
+	        slot < (lastEnd - scenario->FirstFrame) * sched.IntervalsPerFrame && slot < sizeof(Sim_Map);
+	        slot += sched.PacketInterval)
+	{
+		if (!Sim_Map[slot]) empty++;
+	}
+	missed = (sched.MissedFrames * sched.IntervalsPerFrame) / sched.PacketInterval;
+
+	printf("  %-28s frames/xfer %2u, resyncs %u, missed frames %3u, empty slots %u\n",
+	       scenario->Name, sched.FramesPerTransfer, sched.ResyncCount, sched.MissedFrames, empty);
+
+	if (empty < missed)
+	{
+		printf("  FAIL: %u frames reported missed but only %u slots are empty\n", sched.MissedFrames, empty);
+		errors++;
+	}
+	if (scenario->ExpectGaps != (empty > missed))
+	{
+		printf("  FAIL: %u slots left empty in frames that were not missed, expected %s\n", empty - missed, scenario->ExpectGaps ? "some" : "none");
+		errors++;
+	}
+	if (scenario->ExpectResync ? !sched.ResyncCount : sched.ResyncCount != 0)
+	{
+		printf("  FAIL: %u resyncs, expected %s\n", sched.ResyncCount, scenario->ExpectResync ? "some" : "none");
+		errors++;
+	}
+	if ((scenario->PacketsPerTransfer % IsoSched_FramePackets(scenario->PacketInterval, scenario->HighSpeed) != 0) != scenario->ExpectGaps)
+	{
+		printf("  FAIL: IsoSched_FramePackets(%u) = %u does not predict the gaps\n",
+		       scenario->PacketInterval, IsoSched_FramePackets(scenario->PacketInterval, scenario->HighSpeed));
+		errors++;
+	}
+	return errors;
+}
+
+// Invalidate must not reuse frames owned by transfers still queued.
+static int Sim_CheckInvalidate(void)
+{
+	KISO_SCHED sched;
+	unsigned int a, b, c;
+	int errors = 0;
+
+	IsoSched_Init(&sched, 8, 1, 0, 4);
+	a = IsoSched_Next(&sched, 100);		// 104-111
+	b = IsoSched_Next(&sched, 100);		// 112-119
+	IsoSched_Invalidate(&sched);
+	c = IsoSched_Next(&sched, 101);		// 105 would overlap; stays at 120
+
+	if (a != 104 || b != 112 || c != 120 || sched.ResyncCount != 1 || sched.MissedFrames != 0)
+	{
+		printf("  FAIL: invalidate: start frames %u %u %u, resyncs %u, missed %u\n", a, b, c, sched.ResyncCount, sched.MissedFrames);
+		errors++;
+	}
+
+	// Far behind: restart FrameLead frames ahead and count the frames skipped.
+	c = IsoSched_Next(&sched, 200);
+	if (c != 204 || sched.MissedFrames != 204 - 128)
+	{
+		printf("  FAIL: late: start frame %u (expected 204), missed %u (expected %u)\n", c, sched.MissedFrames, 204 - 128);
+		errors++;
+	}
+	printf("  invalidate and late restart: %s\n", errors ? "failed" : "ok");
+	return errors;
+}
+
+// IsoSched_Submit context; the stream engine's IsoK_ApplyLayout, packet
+// callback and driver.
+#define SIM_SUBMIT_PACKETS		8
+#define SIM_SUBMIT_PHASES		5
+#define SIM_SUBMIT_TRANSFERS	40
+
+typedef struct _SIM_SUBMIT
+{
+	const unsigned int* Lengths;
+	unsigned int NextLayout;
+	unsigned int Clock;
+
+	unsigned int Transfer;
+	unsigned int Prepares;				// of the current transfer.
+	unsigned int Samples;				// filled by the application so far.
+	unsigned int TransferSamples;		// of the current transfer.
+	unsigned long long Submitted;		// samples queued on the bus.
+	unsigned int LastEnd;				// first frame after the last queued transfer.
+	unsigned int RejectAt[2];			// transfers whose first submit is rejected.
+	int RejectAll;
+	int Attempt;
+	int Errors;
+} SIM_SUBMIT;
+
+static int Sim_SubmitGetFrame(void* context, unsigned int* currentFrame)
+{
+	SIM_SUBMIT* sim = (SIM_SUBMIT*)context;
+
+	// A rejected submit costs a few frames.
+	sim->Clock += sim->Attempt ? 3 : 0;
+	*currentFrame = sim->Clock;
+	return 1;
+}
+
+static int Sim_SubmitPrepare(void* context, unsigned int startFrame, unsigned int currentFrame)
+{
+	SIM_SUBMIT* sim = (SIM_SUBMIT*)context;
+
+	(void)startFrame;
+	(void)currentFrame;
+
+	// IsoK_ApplyLayout takes the next phase; the packet callback then has
+	// the application write that many samples.
+	sim->TransferSamples = sim->Lengths[sim->NextLayout] / 4;
+	if (++sim->NextLayout >= SIM_SUBMIT_PHASES)
+		sim->NextLayout = 0;
+	sim->Samples += sim->TransferSamples;
+	sim->Prepares++;
+	return 1;
+}
+
+static int Sim_SubmitAt(void* context, unsigned int startFrame, unsigned int currentFrame)
+{
+	SIM_SUBMIT* sim = (SIM_SUBMIT*)context;
+
+	if (sim->RejectAll ||
+	        (sim->Attempt++ == 0 && (sim->Transfer == sim->RejectAt[0] || sim->Transfer == sim->RejectAt[1])))
+		return KISO_SCHED_REJECTED;
+
+	if (IsoSched_FrameDiff(startFrame, currentFrame) < 1 ||
+	        (sim->LastEnd && IsoSched_FrameDiff(startFrame, sim->LastEnd) < 0))
+	{
+		printf("  FAIL: transfer %u queued at frame %u in frame %u, after frame %u\n", sim->Transfer, startFrame, currentFrame, sim->LastEnd);
+		sim->Errors++;
+	}
+	sim->LastEnd = startFrame + SIM_SUBMIT_PACKETS;
+	sim->Submitted += sim->TransferSamples;
+	return KISO_SCHED_SUBMITTED;
+}
+
+// A rejected start frame is resubmitted with the data the application
+// already wrote; the layout phase and the running sample count continue.
+static int Sim_CheckSubmitRetry(void)
+{
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	static KISO_LAYOUT_PACKET layouts[SIM_SUBMIT_PHASES * SIM_SUBMIT_PACKETS];
+	static unsigned int lengths[SIM_SUBMIT_PHASES];
+	KISO_SCHED sched;
+	KISO_SCHED_SUBMIT callbacks;
+	SIM_SUBMIT sim;
+	unsigned long long expected;
+	unsigned int resyncs;
+	int result;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.MaxPacketSize = 192;
+	spec.SampleRate = 44100;
+	spec.BytesPerSample = 4;
+	if (IsoLayout_Plan(&spec, SIM_SUBMIT_PACKETS, &plan) != KISO_LAYOUT_OK || plan.LayoutCount != SIM_SUBMIT_PHASES)
+	{
+		printf("  FAIL: 44.1 kHz plan of %u packets\n", SIM_SUBMIT_PACKETS);
+		return 1;
+	}
+	IsoLayout_Build(&spec, &plan, SIM_SUBMIT_PACKETS, lengths, layouts);
+
+	memset(&sim, 0, sizeof(sim));
+	sim.Lengths = lengths;
+	sim.Clock = 1000;
+	sim.RejectAt[0] = 7;
+	sim.RejectAt[1] = 23;
+
+	callbacks.Context = &sim;
+	callbacks.GetFrame = Sim_SubmitGetFrame;
+	callbacks.Prepare = Sim_SubmitPrepare;
+	callbacks.Submit = Sim_SubmitAt;
+
+	IsoSched_Init(&sched, SIM_SUBMIT_PACKETS, 1, 0, 4);
+	for (sim.Transfer = 0; sim.Transfer < SIM_SUBMIT_TRANSFERS; sim.Transfer++)
+	{
+		sim.Prepares = 0;
+		sim.Attempt = 0;
+		result = IsoSched_Submit(&sched, &callbacks);
+		if (result != KISO_SCHED_SUBMITTED || sim.Prepares != 1)
+		{
+			printf("  FAIL: transfer %u: result %d after %d attempt(s), filled %u times\n", sim.Transfer, result, sim.Attempt, sim.Prepares);
+			sim.Errors++;
+		}
+
+		// 44.1 samples per 1 ms packet, exactly.
+		expected = (44100ULL * SIM_SUBMIT_PACKETS * (sim.Transfer + 1)) / 1000;
+		if (sim.Submitted != expected || sim.Samples != expected)
+		{
+			printf("  FAIL: transfer %u: %llu samples submitted, %u filled, expected %llu\n", sim.Transfer, sim.Submitted, sim.Samples, expected);
+			sim.Errors++;
+			break;
+		}
+		sim.Clock += SIM_SUBMIT_PACKETS / 2;
+	}
+
+	resyncs = sched.ResyncCount;
+	if (resyncs != 2)
+	{
+		printf("  FAIL: %u resyncs for 2 rejected submits\n", resyncs);
+		sim.Errors++;
+	}
+
+	// Both attempts rejected: the transfer is not retried again.
+	sim.RejectAll = 1;
+	sim.Prepares = 0;
+	result = IsoSched_Submit(&sched, &callbacks);
+	if (result != KISO_SCHED_REJECTED || sim.Prepares != 1)
+	{
+		printf("  FAIL: rejected twice: result %d, filled %u times\n", result, sim.Prepares);
+		sim.Errors++;
+	}
+
+	printf("  submit retry at 44.1 kHz: %llu samples in %u transfers, resyncs %u: %s\n",
+	       sim.Submitted, SIM_SUBMIT_TRANSFERS, resyncs, sim.Errors ? "failed" : "ok");
+	return sim.Errors;
+}
+
+static int Sim_CheckFramePackets(void)
+{
+	static const unsigned int expected[] = {8, 8, 4, 0, 2, 0, 0, 0, 1};
+	unsigned int interval;
+	int errors = 0;
+
+	for (interval = 1; interval <= 8; interval <<= 1)
+	{
+		if (IsoSched_FramePackets(interval, 1) != expected[interval] || IsoSched_FramePackets(interval, 0) != 1)
+		{
+			printf("  FAIL: IsoSched_FramePackets(%u) = %u, expected %u\n", interval, IsoSched_FramePackets(interval, 1), expected[interval]);
+			errors++;
+		}
+	}
+	if (IsoSched_FramePackets(16, 1) != 1)
+	{
+		printf("  FAIL: IsoSched_FramePackets(16) = %u, expected 1\n", IsoSched_FramePackets(16, 1));
+		errors++;
+	}
+	return errors;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int i;
+	int errors = 0;
+
+	if (argc > 1)
+	{
+		printf("invalid argument! %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("iso stream scheduling:\n");
+	for (i = 0; i < sizeof(Sim_Scenarios) / sizeof(Sim_Scenarios[0]); i++)
+		errors += Sim_Run(&Sim_Scenarios[i]);
+
+	errors += Sim_CheckInvalidate();
+	errors += Sim_CheckSubmitRetry();
+	errors += Sim_CheckFramePackets();
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors ? 1 : 0;
+}
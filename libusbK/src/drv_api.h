@@ -165,6 +165,24 @@ enum
 #define LIBUSBK_IOCTL_AUTOISOEX_READ CTL_CODE(FILE_DEVICE_UNKNOWN,\
         0x916, METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
 
+#define LIBUSBK_IOCTL_GET_PIPE_STATS CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x917, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+#define LIBUSBK_IOCTL_GET_TRACE CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x918, METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
+
+#define LIBUSBK_IOCTL_BATCH_WRITE CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x919, METHOD_IN_DIRECT, FILE_ANY_ACCESS)
+
+#define LIBUSBK_IOCTL_BATCH_READ CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x91A, METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
+
+#define LIBUSBK_IOCTL_READ_PACKETS CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x91B, METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
+
+#define LIBUSBK_IOCTL_REGISTER_CQUEUE CTL_CODE(FILE_DEVICE_UNKNOWN,\
+        0x91C, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
 /////////////////////////////////////////////////////////////////////////////
 
 #include <pshpack1.h>
@@ -237,6 +255,18 @@ typedef struct
 			UCHAR PipeID;
 		} AutoIsoEx;
 		struct
+		{
+			UCHAR PipeID;
+			ULONG EntryCount;
+			PKUSB_BATCH_ENTRY Entries;
+		} Batch;
+		struct
+		{
+			ULONG BufferLength;
+			PVOID Buffer;
+			HANDLE Event;
+		} CQueue;
+		struct
 		{
 			unsigned int type;
 			unsigned int recipient;
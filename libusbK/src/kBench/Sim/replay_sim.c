@@ -0,0 +1,403 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of workload profile replay. (see kBench_replay.h)
+//
+// Replays a profile against a simulated device the way kBench does: one
+// read and one write thread, each walking the whole profile with its own
+// cursor and issuing the steps it owns, with up to "concurrency" transfers
+// outstanding per pipe. The device services bulk transfers in submission
+// order at a fixed bus bandwidth and per-transfer cost, on a simulated
+// microsecond clock.
+//
+// The profile is replayed twice and the two runs are compared step by step
+// (pipe, operation, length, submit and completion time). A replay with a
+// different seed must differ, every step must be issued by exactly one
+// thread, and a profile written by the libusbK workload capture must load
+// with its trailing concurrency= line.
+//
+// Usage: replay_sim [profile=<file>] [seed=<n>] [passes=<n>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kBench_replay.h"
+
+#define REPLAY_SIM_MAX_EVENTS		65536
+#define REPLAY_SIM_MAX_CONCURRENCY	64
+
+// Simulated device: bulk pipes move 40 bytes/us (high-speed, 8 packets per
+// microframe) after a 125us first-transfer cost; control requests take 250us.
+#define REPLAY_SIM_BYTES_PER_US		40
+#define REPLAY_SIM_XFER_COST_US		125
+#define REPLAY_SIM_CONTROL_US		250
+
+typedef struct _REPLAY_SIM_EVENT
+{
+	int Pipe;			// 0=read thread, 1=write thread
+	int Sequence;		// Position on the profile timeline.
+	BM_REPLAY_OP Op;
+	int Length;
+	long long DueUs;
+	long long SubmitUs;
+	long long DoneUs;
+} REPLAY_SIM_EVENT;
+
+typedef struct _REPLAY_SIM_RUN
+{
+	REPLAY_SIM_EVENT Events[REPLAY_SIM_MAX_EVENTS];
+	int Count;
+	int Timeline;		// Steps generated by one cursor.
+	long long Bytes[2];
+	long long EndUs;
+} REPLAY_SIM_RUN;
+
+static REPLAY_SIM_RUN Run[3];
+
+static const char* Sim_CaptureProfile =
+    "# libusbK workload capture (pid 1234)\n"
+    "control 8 0\t# t=0 outstanding=1\n"
+    "# done control 8 t=210 latency=210 outstanding=0\n"
+    "read 512 215\t# t=215 outstanding=1\n"
+    "read 512 3\t# t=218 outstanding=2\n"
+    "write 65536 40\t# t=258 outstanding=3\n"
+    "# done read 512 t=330 latency=115 outstanding=2\n"
+    "read 512 80\t# t=338 outstanding=3\n"
+    "# 4 submitted, 2 completed, 0 untracked, 2 outstanding\n"
+    "concurrency=3\n";
+
+static const char* Sim_DefaultProfile =
+    "# Bursty instrument: control polls between 512K bulk bursts.\n"
+    "seed=7\n"
+    "concurrency=4\n"
+    "passes=3\n"
+    "control 8 100-300 20\n"
+    "read 512-4096 0-50 32\n"
+    "write 64 10\n"
+    "read 524288 500-2000 4\n"
+    "write 16384-65536 0-100 8\n"
+    "control 64 1000\n";
+
+static int Sim_LoadText(PBM_REPLAY_PROFILE profile, const char* text)
+{
+	char line[256];
+	const char* next;
+	size_t length;
+	int lineNumber = 0;
+
+	BmReplay_Init(profile);
+
+	while (*text)
+	{
+		next = strchr(text, '\n');
+		length = next ? (size_t)(next - text) : strlen(text);
+		if (length >= sizeof(line)) length = sizeof(line) - 1;
+
+		memcpy(line, text, length);
+		line[length] = '\0';
+		lineNumber++;
+
+		if (BmReplay_ParseLine(profile, line) < 0)
+		{
+			printf("invalid profile entry at line %d\n", lineNumber);
+			return -1;
+		}
+		text = next ? next + 1 : text + length;
+	}
+
+	return profile->StepCount ? 0 : -1;
+}
+
+static int Sim_LoadFile(PBM_REPLAY_PROFILE profile, const char* fileName)
+{
+	char line[256];
+	FILE* file;
+	int lineNumber = 0;
+
+	BmReplay_Init(profile);
+
+	if ((file = fopen(fileName, "r")) == NULL)
+	{
+		printf("failed opening profile %s\n", fileName);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+		if (BmReplay_ParseLine(profile, line) < 0)
+		{
+			printf("invalid profile entry at %s(%d)\n", fileName, lineNumber);
+			fclose(file);
+			return -1;
+		}
+	}
+
+	fclose(file);
+	return profile->StepCount ? 0 : -1;
+}
+
+// One transfer thread. Mirrors Replay_WaitNext in kBench.c: a step is
+// submitted when it is due and a transfer slot is free.
+typedef struct _REPLAY_SIM_THREAD
+{
+	BM_REPLAY_CURSOR Cursor;
+	int IsRead;
+	int Sequence;
+	int Pending;		// A step has been generated but not issued.
+	BM_REPLAY_OP Op;
+	int Length;
+	long long SlotFreeUs[REPLAY_SIM_MAX_CONCURRENCY];
+} REPLAY_SIM_THREAD;
+
+// Picks the thread whose next owned step can be issued first; ties go to
+// the earlier profile position so the interleave does not depend on the
+// thread order.
+static int Sim_Replay(const BM_REPLAY_PROFILE* profile, REPLAY_SIM_RUN* run)
+{
+	REPLAY_SIM_THREAD threads[2];
+	REPLAY_SIM_EVENT* event;
+	int concurrency = profile->Concurrency ? profile->Concurrency : 1;
+	int i, t, slot, best;
+	long long start[2];
+	long long busFreeUs = 0;
+
+	if (concurrency > REPLAY_SIM_MAX_CONCURRENCY) concurrency = REPLAY_SIM_MAX_CONCURRENCY;
+
+	memset(run, 0, sizeof(*run));
+	memset(threads, 0, sizeof(threads));
+
+	for (t = 0; t < 2; t++)
+	{
+		threads[t].IsRead = (t == 0);
+		BmReplay_Start(profile, &threads[t].Cursor);
+	}
+
+	for (;;)
+	{
+		best = -1;
+		for (t = 0; t < 2; t++)
+		{
+			// Advance past the steps this thread does not own.
+			while (!threads[t].Pending)
+			{
+				if (!BmReplay_Next(profile, &threads[t].Cursor, &threads[t].Op, &threads[t].Length))
+					break;
+
+				threads[t].Sequence++;
+				if (BmReplay_IsOwner(profile, threads[t].Op, threads[t].IsRead))
+					threads[t].Pending = 1;
+			}
+			if (!threads[t].Pending) continue;
+
+			slot = 0;
+			for (i = 1; i < concurrency; i++)
+				if (threads[t].SlotFreeUs[i] < threads[t].SlotFreeUs[slot]) slot = i;
+
+			start[t] = threads[t].Cursor.DueUs > threads[t].SlotFreeUs[slot] ? threads[t].Cursor.DueUs : threads[t].SlotFreeUs[slot];
+			if (best < 0 || start[t] < start[best] || (start[t] == start[best] && threads[t].Sequence < threads[best].Sequence))
+				best = t;
+		}
+		if (best < 0) break;
+
+		if (run->Count >= REPLAY_SIM_MAX_EVENTS)
+		{
+			printf("profile too long for the simulation (%d events)\n", REPLAY_SIM_MAX_EVENTS);
+			return -1;
+		}
+
+		t = best;
+		slot = 0;
+		for (i = 1; i < concurrency; i++)
+			if (threads[t].SlotFreeUs[i] < threads[t].SlotFreeUs[slot]) slot = i;
+
+		event = &run->Events[run->Count++];
+		event->Pipe = t;
+		event->Sequence = threads[t].Sequence;
+		event->Op = threads[t].Op;
+		event->Length = threads[t].Length;
+		event->DueUs = threads[t].Cursor.DueUs;
+		event->SubmitUs = start[t];
+
+		if (event->Op == BM_REPLAY_OP_CONTROL)
+		{
+			// Control requests are synchronous in kBench; the thread waits for them.
+			event->DoneUs = event->SubmitUs + REPLAY_SIM_CONTROL_US;
+			for (i = 0; i < concurrency; i++)
+				if (threads[t].SlotFreeUs[i] < event->DoneUs) threads[t].SlotFreeUs[i] = event->DoneUs;
+		}
+		else
+		{
+			long long begin = event->SubmitUs > busFreeUs ? event->SubmitUs : busFreeUs;
+
+			event->DoneUs = begin + REPLAY_SIM_XFER_COST_US + (event->Length + REPLAY_SIM_BYTES_PER_US - 1) / REPLAY_SIM_BYTES_PER_US;
+			busFreeUs = event->DoneUs;
+			threads[t].SlotFreeUs[slot] = event->DoneUs;
+			run->Bytes[t] += event->Length;
+		}
+
+		if (event->DoneUs > run->EndUs) run->EndUs = event->DoneUs;
+		threads[t].Pending = 0;
+	}
+
+	// Both cursors walk the same timeline.
+	if (threads[0].Sequence != threads[1].Sequence || threads[0].Cursor.DueUs != threads[1].Cursor.DueUs)
+	{
+		printf("threads disagree on the timeline: %d steps/%lld us vs %d steps/%lld us\n",
+		       threads[0].Sequence, threads[0].Cursor.DueUs, threads[1].Sequence, threads[1].Cursor.DueUs);
+		return -1;
+	}
+	run->Timeline = threads[0].Sequence;
+	return 0;
+}
+
+// Returns the index of the first differing event or -1 if the runs match.
+static int Sim_Compare(const REPLAY_SIM_RUN* a, const REPLAY_SIM_RUN* b)
+{
+	int i;
+
+	for (i = 0; i < a->Count && i < b->Count; i++)
+	{
+		const REPLAY_SIM_EVENT* x = &a->Events[i];
+		const REPLAY_SIM_EVENT* y = &b->Events[i];
+
+		if (x->Pipe != y->Pipe || x->Sequence != y->Sequence || x->Op != y->Op || x->Length != y->Length ||
+		        x->DueUs != y->DueUs || x->SubmitUs != y->SubmitUs || x->DoneUs != y->DoneUs)
+			return i;
+	}
+
+	return (a->Count == b->Count) ? -1 : i;
+}
+
+static void Sim_Report(const char* name, const BM_REPLAY_PROFILE* profile, const REPLAY_SIM_RUN* run)
+{
+	int counts[3] = {0, 0, 0};
+	int i;
+
+	for (i = 0; i < run->Count; i++) counts[run->Events[i].Op]++;
+
+	printf("%-8s %d steps (%d read, %d write, %d control) seed %u, concurrency %d\n",
+	       name, run->Count, counts[BM_REPLAY_OP_READ], counts[BM_REPLAY_OP_WRITE], counts[BM_REPLAY_OP_CONTROL],
+	       profile->Seed, profile->Concurrency ? profile->Concurrency : 1);
+	printf("         %lld bytes in, %lld bytes out in %lld us (%.2f MB/s)\n",
+	       run->Bytes[0], run->Bytes[1], run->EndUs,
+	       run->EndUs ? (double)(run->Bytes[0] + run->Bytes[1]) / (double)run->EndUs : 0.0);
+}
+
+static int Sim_Check(const char* name, const BM_REPLAY_PROFILE* profile)
+{
+	BM_REPLAY_PROFILE reseeded;
+	int diff;
+
+	if (Sim_Replay(profile, &Run[0]) || Sim_Replay(profile, &Run[1])) return -1;
+	Sim_Report(name, profile, &Run[0]);
+
+	// Every step on the timeline is issued by exactly one thread.
+	if (Run[0].Count != Run[0].Timeline)
+	{
+		printf("FAIL: %d steps issued for %d timeline steps\n", Run[0].Count, Run[0].Timeline);
+		return -1;
+	}
+
+	if ((diff = Sim_Compare(&Run[0], &Run[1])) >= 0)
+	{
+		printf("FAIL: replays differ at step %d\n", diff);
+		return -1;
+	}
+	printf("         replayed twice; %d steps identical\n", Run[0].Count);
+
+	// A different seed must change the ranges that were picked.
+	reseeded = *profile;
+	reseeded.Seed = profile->Seed + 1;
+	if (Sim_Replay(&reseeded, &Run[2])) return -1;
+
+	if (Sim_Compare(&Run[0], &Run[2]) < 0)
+	{
+		int ranged = 0, i;
+
+		for (i = 0; i < profile->StepCount; i++)
+		{
+			if (profile->Steps[i].MinLength != profile->Steps[i].MaxLength ||
+			        profile->Steps[i].MinDelay != profile->Steps[i].MaxDelay)
+				ranged = 1;
+		}
+		if (ranged)
+		{
+			printf("FAIL: seed %u replays the same as seed %u\n", reseeded.Seed, profile->Seed);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	BM_REPLAY_PROFILE profile;
+	const char* fileName = NULL;
+	int seed = -1, passes = -1;
+	int i, failed = 0;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "profile=", 8))
+			fileName = argv[i] + 8;
+		else if (!strncmp(argv[i], "seed=", 5))
+			seed = atoi(argv[i] + 5);
+		else if (!strncmp(argv[i], "passes=", 7))
+			passes = atoi(argv[i] + 7);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (fileName ? Sim_LoadFile(&profile, fileName) : Sim_LoadText(&profile, Sim_DefaultProfile))
+		return 1;
+	if (seed >= 0) profile.Seed = (unsigned int)seed;
+	if (passes > 0) profile.Passes = passes;
+	if (!profile.Passes)
+	{
+		printf("passes=0 replays until stopped; pass a count\n");
+		return 1;
+	}
+
+	if (Sim_Check(fileName ? fileName : "default", &profile)) failed++;
+	BmReplay_Free(&profile);
+
+	// A capture loads as a profile; its concurrency comes from the trailer.
+	if (fileName == NULL)
+	{
+		if (Sim_LoadText(&profile, Sim_CaptureProfile) ||
+		        profile.StepCount != 5 || profile.Concurrency != 3 || !profile.HasReads || !profile.HasWrites)
+		{
+			printf("FAIL: capture loaded %d steps, concurrency %d\n", profile.StepCount, profile.Concurrency);
+			failed++;
+		}
+		else if (Sim_Check("capture", &profile))
+		{
+			failed++;
+		}
+		BmReplay_Free(&profile);
+	}
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
@@ -22,9 +22,16 @@ binary distributions.
 #include <conio.h>
 #include <wtypes.h>
 
+#include <winioctl.h>
+
 #include "libusbk.h"
 #include "lusbk_version.h"
 #include "lusbk_linked_list.h"
+#include "drv_api.h"
+#include "sys\drv_trace_ring.h"
+#include "kBench_stats.h"
+#include "kBench_latency.h"
+#include "kBench_replay.h"
 
 // warning C4127: conditional expression is constant.
 #pragma warning(disable: 4127)
@@ -80,8 +87,15 @@ typedef enum _BENCHMARK_DEVICE_COMMAND
 {
     SET_TEST = 0x0E,
     GET_TEST = 0x0F,
+    GET_STATS = BM_STATS_REQUEST,	// Optional; see kBench_stats.h and the "devstats" argument.
+    CONTROL_READ = 0x13,			// Control test only; see the "ctrlread" argument.
+    CONTROL_WRITE = 0x14,			// Control test only; see the "ctrlwrite" argument.
+    SET_PACING = 0x15,				// Optional; see the "pace" argument.
 } BENCHMARK_DEVICE_COMMAND, *PBENCHMARK_DEVICE_COMMAND;
 
+// Largest CONTROL_READ/CONTROL_WRITE data stage; the driver's MAX_CONTROL_TRANSFER_SIZE.
+#define BM_CONTROL_MAX_TRANSFER_SIZE	4096
+
 // Tests supported by the official benchmark firmware.
 //
 typedef enum _BENCHMARK_DEVICE_TEST_TYPE
@@ -90,6 +104,8 @@ typedef enum _BENCHMARK_DEVICE_TEST_TYPE
     TestTypeRead	= 0x01,
     TestTypeWrite	= 0x02,
     TestTypeLoop	= TestTypeRead | TestTypeWrite,
+    TestTypeLatency	= BM_LATENCY_TEST_TYPE,	// Loop with stamped packets; see kBench_latency.h.
+    TestTypeControl	= 0x08,					// Control pipe data stages; CONTROL_READ or CONTROL_WRITE.
 } BENCHMARK_DEVICE_TEST_TYPE, *PBENCHMARK_DEVICE_TEST_TYPE;
 
 // This software was mainly created for testing the libusb-win32 kernel & user driver.
@@ -100,8 +116,24 @@ typedef enum _BENCHMARK_TRANSFER_MODE
 
     // Test for async function, iso transfers, and queued transfers
     TRANSFER_MODE_ASYNC,
+
+    // Tests the StmK queued stream functions. (lusbk_queued_stream.c)
+    TRANSFER_MODE_STREAM,
+
+    // Tests iso transfers using IsoK contexts and start frame scheduling. (lusbk_usb_iso.c)
+    TRANSFER_MODE_ISOEX,
 } BENCHMARK_TRANSFER_MODE;
 
+// Start frame policies for TRANSFER_MODE_ISOEX.
+typedef enum _BENCHMARK_ISO_START_FRAME
+{
+    // The driver starts each transfer on the next available frame.
+    ISO_START_FRAME_ASAP,
+
+    // Each transfer is scheduled to start where the previous one ends.
+    ISO_START_FRAME_CONTIGUOUS,
+} BENCHMARK_ISO_START_FRAME;
+
 // Holds all of the information about a test.
 typedef struct _BENCHMARK_TEST_PARAM
 {
@@ -126,7 +158,28 @@ typedef struct _BENCHMARK_TEST_PARAM
 	BOOL Verify;		// Only for loop and read test. If true, verifies data integrity.
 	BOOL VerifyDetails;	// If true, prints detailed information for each invalid byte.
 	enum BENCHMARK_DEVICE_TEST_TYPE TestType;	// The benchmark test type.
-	enum BENCHMARK_TRANSFER_MODE TransferMode;	// Sync or Async
+	enum BENCHMARK_TRANSFER_MODE TransferMode;	// Sync, Async, Stream or IsoEx
+
+	INT StreamTransferSize;	// (Stream mode only) Maximum transfer size of a stream transfer context.
+	INT StreamMaxPending;	// (Stream mode only) Number of stream transfer contexts.
+	INT StreamMaxPendingIO;	// (Stream mode only) Number of I/O requests the stream thread keeps pending.
+
+	INT IsoPacketCount;		// (IsoEx mode only) Number of KISO_PACKETs per transfer. (0=calculate)
+	INT IsoFrameLead;		// (IsoEx mode only) Number of frames ahead of the current frame to schedule.
+	enum BENCHMARK_ISO_START_FRAME IsoStartFrame;	// (IsoEx mode only) Start frame policy.
+	INT IsoSampleRate;		// (IsoEx mode only) Sample frames per second. (0=fill packets)
+	INT IsoBytesPerSample;	// (IsoEx mode only) Bytes per sample frame.
+
+	BOOL UseSimDevice;	// If true, pipe I/O is serviced by the software device. See Sim_Install().
+
+	CHAR ReplayFile[MAX_PATH];			// Workload profile file name.
+	BM_REPLAY_PROFILE Replay;	// Active when Replay.StepCount is non-zero.
+
+	CHAR TraceFile[MAX_PATH];			// (libusbK only) Driver trace dump file name.
+
+	BOOL DeviceStats;	// If true, the firmware counters (GET_STATS) are polled with the running status.
+	INT PaceRate;		// KB/s the firmware paces its endpoints at (SET_PACING); 0 = unpaced, -1 = not sent.
+	BOOL ControlWrite;	// (Control test only) Repeat CONTROL_WRITE instead of CONTROL_READ.
 
 	// Internal value use during the test.
 	//
@@ -137,6 +190,7 @@ typedef struct _BENCHMARK_TEST_PARAM
 	USB_DEVICE_DESCRIPTOR DeviceDescriptor;
 	USB_INTERFACE_DESCRIPTOR InterfaceDescriptor;
 	WINUSB_PIPE_INFORMATION PipeInformation[32];
+	WINUSB_PIPE_INFORMATION ControlPipe;	// (Control test only) The default pipe.
 	BOOL IsCancelled;
 	BOOL IsUserAborted;
 
@@ -158,6 +212,8 @@ typedef struct _BENCHMARK_TEST_PARAM
 
 	UCHAR UseRawIO;
 
+	BM_DEVICE_STATS DeviceStatsLast;	// Counters returned by the last GET_STATS.
+
 } BENCHMARK_TEST_PARAM, *PBENCHMARK_TEST_PARAM;
 
 // The benchmark transfer context used for asynchronous transfers.  see TransferAsync().
@@ -168,6 +224,8 @@ typedef struct _BENCHMARK_TRANSFER_HANDLE
 	PUCHAR Data;
 	INT DataMaxLength;
 	INT ReturnCode;
+	PKISO_CONTEXT IsoContext;	// (IsoEx mode only)
+	LONGLONG SubmitTime;		// Performance counter value when the transfer was submitted.
 } BENCHMARK_TRANSFER_HANDLE, *PBENCHMARK_TRANSFER_HANDLE;
 #pragma warning(disable:4200)
 // Holds all of the information about a transfer.
@@ -202,6 +260,35 @@ typedef struct _BENCHMARK_TRANSFER_PARAM
 
 	BENCHMARK_TRANSFER_HANDLE TransferHandles[MAX_OUTSTANDING_TRANSFERS];
 
+	// Stream mode only.
+	KSTM_HANDLE StreamHandle;
+
+	// IsoEx mode only.
+	INT IsoPacketSize;
+	INT IsoFramesPerTransfer;
+	UINT IsoNextStartFrame;
+	BOOL IsoStartFrameValid;
+	INT IsoErrorPacketCount;
+	INT IsoResyncCount;
+	PKISO_LAYOUT IsoLayout;
+
+	// Workload replay only.
+	BM_REPLAY_CURSOR ReplayCursor;
+	LONGLONG ReplayStart;
+	LONGLONG ReplayDue;
+	BOOL ReplayPending;
+	BM_REPLAY_OP ReplayOp;
+	INT ReplayLength;
+	INT ReplayControlCount;
+
+	BM_LATENCY_HISTOGRAM Latency;
+
+	// Latency test only.
+	UINT EchoSequence;			// (write) Sequence number of the next stamped packet.
+	BM_LATENCY_CLOCK EchoClock;	// (read) Host time/bus frame pair; resampled every second.
+	BOOL EchoClockFailed;		// (read) GetCurrentFrameNumber is not supported; round trip times only.
+	BM_LATENCY_RESULT Echo;		// (read) Echoed packets.
+
 	// Placeholder for end of structure; this is where the raw data for the
 	// transfer buffer is allocated.
 	//
@@ -225,6 +312,14 @@ BOOL Bench_Configure(__in KUSB_HANDLE handle,
                      __in UCHAR intf,
                      __deref_inout PBENCHMARK_DEVICE_TEST_TYPE testType);
 
+BOOL Bench_GetStats(__in KUSB_HANDLE handle,
+                    __in UCHAR intf,
+                    __out PBM_DEVICE_STATS stats);
+
+BOOL Bench_SetPacing(__in KUSB_HANDLE handle,
+                     __in UCHAR intf,
+                     __in UINT bytesPerSecond);
+
 // Critical section for running status.
 CRITICAL_SECTION DisplayCriticalSection;
 
@@ -249,6 +344,7 @@ PBENCHMARK_TRANSFER_PARAM CreateTransferParam(PBENCHMARK_TEST_PARAM test, int en
 void GetAverageBytesSec(PBENCHMARK_TRANSFER_PARAM transferParam, DOUBLE* bps);
 void GetCurrentBytesSec(PBENCHMARK_TRANSFER_PARAM transferParam, DOUBLE* bps);
 void ShowRunningStatus(PBENCHMARK_TRANSFER_PARAM transferParam);
+void ShowDeviceStats(PBENCHMARK_TEST_PARAM test);
 void ShowTestInfo(PBENCHMARK_TEST_PARAM test);
 void ShowTransferInfo(PBENCHMARK_TRANSFER_PARAM transferParam);
 
@@ -264,9 +360,17 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParams);
 #define INC_ROLL(IncField, RollOverValue) if ((++IncField) >= RollOverValue) IncField = 0
 
 #define ENDPOINT_TYPE(TransferParam) (TransferParam->Ep.PipeType & 3)
+
+// Bytes per (micro)frame of an iso endpoint; includes the high-bandwidth transactions-per-microframe bits.
+#define ISO_PACKET_SIZE(MaximumPacketSize) (((MaximumPacketSize) & 0x7FF) * (1 + (((MaximumPacketSize) >> 11) & 3)))
+
 const char* TestDisplayString[] = {"None", "Read", "Write", "Loop", NULL};
+const char* TransferModeDisplayString[] = {"Sync", "Async", "Stream", "IsoEx", NULL};
 const char* EndpointTypeDisplayString[] = {"Control", "Isochronous", "Bulk", "Interrupt", NULL};
 
+// Performance counter ticks per second; used for latency and replay timing.
+LONGLONG PerfFrequency;
+
 LONG WinError(__in_opt DWORD errorCode)
 {
 	LPSTR buffer = NULL;
@@ -309,6 +413,11 @@ void SetTestDefaults(PBENCHMARK_TEST_PARAM test)
 	test->Intf				= -1;
 	test->Altf				= -1;
 	test->UseRawIO			= 0xFF;
+	test->StreamMaxPending	= 16;
+	test->StreamMaxPendingIO = 4;
+	test->IsoFrameLead		= 8;
+	test->IsoStartFrame		= ISO_START_FRAME_CONTIGUOUS;
+	test->PaceRate			= -1;
 }
 
 VOID AppendLoopBuffer(PBENCHMARK_TEST_PARAM Test, PUCHAR data, LONG dataLength)
@@ -524,101 +633,931 @@ BOOL Bench_Configure(__in KUSB_HANDLE handle,
 			return TRUE;
 	}
 
-	return WinError(0);
+	return WinError(0);
+}
+
+BOOL Bench_GetStats(__in KUSB_HANDLE handle,
+                    __in UCHAR intf,
+                    __out PBM_DEVICE_STATS stats)
+{
+	UCHAR buffer[BM_STATS_LENGTH];
+	UINT transferred = 0;
+	WINUSB_SETUP_PACKET Pkt;
+	KUSB_SETUP_PACKET* defPkt = (KUSB_SETUP_PACKET*)&Pkt;
+
+	memset(&Pkt, 0, sizeof(Pkt));
+	defPkt->BmRequest.Dir = BMREQUEST_DIR_DEVICE_TO_HOST;
+	defPkt->BmRequest.Type = BMREQUEST_TYPE_VENDOR;
+	defPkt->Request = GET_STATS;
+	defPkt->Index = intf;
+	defPkt->Length = sizeof(buffer);
+
+	if (!handle || handle == INVALID_HANDLE_VALUE)
+		return WinError(ERROR_INVALID_HANDLE);
+
+	if (!K.ControlTransfer(handle, Pkt, buffer, sizeof(buffer), &transferred, NULL))
+		return WinError(0);
+
+	if (BmStats_Decode(stats, buffer, transferred) != 0)
+		return WinError(ERROR_INVALID_DATA);
+
+	return TRUE;
+}
+
+BOOL Bench_SetPacing(__in KUSB_HANDLE handle,
+                     __in UCHAR intf,
+                     __in UINT bytesPerSecond)
+{
+	UCHAR buffer[4];
+	UINT transferred = 0;
+	WINUSB_SETUP_PACKET Pkt;
+	KUSB_SETUP_PACKET* defPkt = (KUSB_SETUP_PACKET*)&Pkt;
+
+	memset(&Pkt, 0, sizeof(Pkt));
+	defPkt->BmRequest.Dir = BMREQUEST_DIR_HOST_TO_DEVICE;
+	defPkt->BmRequest.Type = BMREQUEST_TYPE_VENDOR;
+	defPkt->Request = SET_PACING;
+	defPkt->Index = intf;
+	defPkt->Length = sizeof(buffer);
+
+	buffer[0] = (UCHAR)bytesPerSecond;
+	buffer[1] = (UCHAR)(bytesPerSecond >> 8);
+	buffer[2] = (UCHAR)(bytesPerSecond >> 16);
+	buffer[3] = (UCHAR)(bytesPerSecond >> 24);
+
+	if (!handle || handle == INVALID_HANDLE_VALUE)
+		return WinError(ERROR_INVALID_HANDLE);
+
+	if (!K.ControlTransfer(handle, Pkt, buffer, sizeof(buffer), &transferred, NULL))
+		return WinError(0);
+
+	return TRUE;
+}
+
+INT VerifyData(PBENCHMARK_TRANSFER_PARAM transferParam, BYTE* data, INT dataLength)
+{
+
+	WORD verifyDataSize = transferParam->Test->VerifyBufferSize;
+	BYTE* verifyData = transferParam->Test->VerifyBuffer;
+	BYTE keyC = 0;
+	BOOL seedKey = TRUE;
+	INT dataLeft = dataLength;
+	INT dataIndex = 0;
+	INT packetIndex = 0;
+	INT verifyIndex = 0;
+
+	while(dataLeft > 1)
+	{
+		verifyDataSize = dataLeft > transferParam->Test->VerifyBufferSize ? transferParam->Test->VerifyBufferSize : (WORD)dataLeft;
+
+		if (seedKey)
+			keyC = data[dataIndex + 1];
+		else
+		{
+			if (data[dataIndex + 1] == 0)
+			{
+				keyC = 0;
+			}
+			else
+			{
+				keyC++;
+			}
+		}
+		seedKey = FALSE;
+		// Index 0 is always 0.
+		// The key is always at index 1
+		verifyData[1] = keyC;
+
+		if (memcmp(&data[dataIndex], verifyData, verifyDataSize) != 0)
+		{
+			// Packet verification failed.
+
+			// Reset the key byte on the next packet.
+			seedKey = TRUE;
+
+			CONVDAT("Packet=#%d Data=#%d\n", packetIndex, dataIndex);
+
+			if (transferParam->Test->VerifyDetails)
+			{
+				for (verifyIndex = 0; verifyIndex < verifyDataSize; verifyIndex++)
+				{
+					if (verifyData[verifyIndex] == data[dataIndex + verifyIndex])
+						continue;
+
+					CONVDAT("packet-offset=%d expected %02Xh got %02Xh\n",
+					        verifyIndex,
+					        verifyData[verifyIndex],
+					        data[dataIndex + verifyIndex]);
+
+				}
+			}
+		}
+
+		// Move to the next packet.
+		packetIndex++;
+		dataLeft -= verifyDataSize;
+		dataIndex += verifyDataSize;
+	}
+
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Software benchmark device.
+//
+// When the "simdevice" argument is specified, the pipe I/O functions in the
+// K driver api are replaced with the functions below.  The device is still
+// opened (StmK_Init validates the pipe against the selected interface) but
+// no data is sent to the bus.  Reads are completed immediately with the same
+// pattern a benchmark device sends in a read test and writes are discarded.
+// This measures the overhead of the library transfer paths alone.
+//
+typedef struct _BENCHMARK_SIM_DEVICE
+{
+	PBENCHMARK_TEST_PARAM Test;
+	UCHAR Key;
+	UINT FrameNumber;
+	BM_DEVICE_STATS Stats;	// Answers GET_STATS. Each direction is only updated by its own test thread.
+} BENCHMARK_SIM_DEVICE;
+
+BENCHMARK_SIM_DEVICE SimDevice;
+
+static USHORT Sim_GetMaxPacketSize(UCHAR PipeID)
+{
+	int i;
+	for (i = 0; i < SimDevice.Test->InterfaceDescriptor.bNumEndpoints; i++)
+	{
+		if (SimDevice.Test->PipeInformation[i].PipeId == PipeID)
+			return SimDevice.Test->PipeInformation[i].MaximumPacketSize;
+	}
+	return 64;
+}
+
+static VOID Sim_FillPacket(PUCHAR Buffer, UINT Length)
+{
+	UINT pos;
+	UCHAR indexC = 2;
+
+	// Data Format:
+	// [0][KeyByte] 2 3 4 5 ..to.. wMaxPacketSize (if data byte rolls it is incremented to 1)
+	for (pos = 0; pos < Length; pos++)
+	{
+		if (pos == 0)
+			Buffer[pos] = 0;
+		else if (pos == 1)
+			Buffer[pos] = SimDevice.Key++;
+		else
+			Buffer[pos] = indexC++;
+
+		if (indexC == 0) indexC = 1;
+	}
+}
+
+static VOID Sim_FillBuffer(UCHAR PipeID, PUCHAR Buffer, UINT BufferLength)
+{
+	UINT packetSize = ISO_PACKET_SIZE(Sim_GetMaxPacketSize(PipeID));
+	UINT stageSize;
+
+	if (!packetSize) packetSize = 64;
+	while (BufferLength)
+	{
+		stageSize = BufferLength > packetSize ? packetSize : BufferLength;
+		Sim_FillPacket(Buffer, stageSize);
+		Buffer += stageSize;
+		BufferLength -= stageSize;
+	}
+}
+
+static BOOL Sim_Complete(UINT Length, PUINT LengthTransferred, LPOVERLAPPED Overlapped)
+{
+	if (LengthTransferred) *LengthTransferred = Length;
+	if (!Overlapped) return TRUE;
+
+	Overlapped->Internal = 0;
+	Overlapped->InternalHigh = Length;
+	SetEvent(Overlapped->hEvent);
+	SetLastError(ERROR_IO_PENDING);
+	return FALSE;
+}
+
+static VOID Sim_CountTransfer(INT Direction, UINT Length)
+{
+	SimDevice.Stats.Transfers[Direction]++;
+	SimDevice.Stats.Bytes[Direction] += Length;
+}
+
+static BOOL KUSB_API Sim_ReadPipe(KUSB_HANDLE InterfaceHandle, UCHAR PipeID, PUCHAR Buffer, UINT BufferLength, PUINT LengthTransferred, LPOVERLAPPED Overlapped)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	Sim_FillBuffer(PipeID, Buffer, BufferLength);
+	Sim_CountTransfer(BM_STATS_IN, BufferLength);
+	return Sim_Complete(BufferLength, LengthTransferred, Overlapped);
+}
+
+static BOOL KUSB_API Sim_WritePipe(KUSB_HANDLE InterfaceHandle, UCHAR PipeID, PUCHAR Buffer, UINT BufferLength, PUINT LengthTransferred, LPOVERLAPPED Overlapped)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+	UNREFERENCED_PARAMETER(PipeID);
+	UNREFERENCED_PARAMETER(Buffer);
+
+	Sim_CountTransfer(BM_STATS_OUT, BufferLength);
+	return Sim_Complete(BufferLength, LengthTransferred, Overlapped);
+}
+
+static VOID Sim_CompleteIsoContext(UCHAR PipeID, PUCHAR Buffer, UINT BufferLength, PKISO_CONTEXT IsoContext, BOOL IsRead)
+{
+	INT packetIndex;
+	UINT nextOffset;
+	UINT length;
+
+	if (!(IsoContext->Flags & KISO_FLAG_SET_START_FRAME))
+		IsoContext->StartFrame = SimDevice.FrameNumber;
+
+	SimDevice.FrameNumber = IsoContext->StartFrame + IsoContext->NumberOfPackets;
+	IsoContext->ErrorCount = 0;
+	IsoContext->UrbHdrStatus = 0;
+
+	for (packetIndex = 0; packetIndex < IsoContext->NumberOfPackets; packetIndex++)
+	{
+		nextOffset = (packetIndex + 1 < IsoContext->NumberOfPackets) ? IsoContext->IsoPackets[packetIndex + 1].Offset : BufferLength;
+		length = (nextOffset > IsoContext->IsoPackets[packetIndex].Offset) ? nextOffset - IsoContext->IsoPackets[packetIndex].Offset : 0;
+
+		if (IsRead)
+		{
+			IsoContext->IsoPackets[packetIndex].Length = (USHORT)length;
+			Sim_FillBuffer(PipeID, &Buffer[IsoContext->IsoPackets[packetIndex].Offset], length);
+		}
+		IsoContext->IsoPackets[packetIndex].Status = 0;
+	}
+}
+
+static BOOL KUSB_API Sim_IsoReadPipe(KUSB_HANDLE InterfaceHandle, UCHAR PipeID, PUCHAR Buffer, UINT BufferLength, LPOVERLAPPED Overlapped, PKISO_CONTEXT IsoContext)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	if (IsoContext)
+		Sim_CompleteIsoContext(PipeID, Buffer, BufferLength, IsoContext, TRUE);
+	else
+		Sim_FillBuffer(PipeID, Buffer, BufferLength);
+
+	Sim_CountTransfer(BM_STATS_IN, BufferLength);
+	return Sim_Complete(BufferLength, NULL, Overlapped);
+}
+
+static BOOL KUSB_API Sim_IsoWritePipe(KUSB_HANDLE InterfaceHandle, UCHAR PipeID, PUCHAR Buffer, UINT BufferLength, LPOVERLAPPED Overlapped, PKISO_CONTEXT IsoContext)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	if (IsoContext)
+		Sim_CompleteIsoContext(PipeID, Buffer, BufferLength, IsoContext, FALSE);
+
+	Sim_CountTransfer(BM_STATS_OUT, BufferLength);
+	return Sim_Complete(BufferLength, NULL, Overlapped);
+}
+
+static BOOL KUSB_API Sim_GetCurrentFrameNumber(KUSB_HANDLE InterfaceHandle, PUINT FrameNumber)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	*FrameNumber = SimDevice.FrameNumber;
+	return TRUE;
+}
+
+static BOOL KUSB_API Sim_GetOverlappedResult(KUSB_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, PUINT lpNumberOfBytesTransferred, BOOL bWait)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	if (bWait) WaitForSingleObject(Overlapped->hEvent, INFINITE);
+	*lpNumberOfBytesTransferred = (UINT)Overlapped->InternalHigh;
+	return TRUE;
+}
+
+static BOOL KUSB_API Sim_ControlTransfer(KUSB_HANDLE InterfaceHandle, WINUSB_SETUP_PACKET SetupPacket, PUCHAR Buffer, UINT BufferLength, PUINT LengthTransferred, LPOVERLAPPED Overlapped)
+{
+	UINT length = min(BufferLength, SetupPacket.Length);
+
+	UCHAR stats[BM_STATS_LENGTH];
+
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+
+	if (SetupPacket.Request == GET_STATS)
+	{
+		BmStats_Encode(&SimDevice.Stats, stats, sizeof(stats));
+		length = min(length, (UINT)sizeof(stats));
+		if (length && Buffer) memcpy(Buffer, stats, length);
+		return Sim_Complete(length, LengthTransferred, Overlapped);
+	}
+
+	// Answers GET_TEST with the selected test type.
+	if (length && Buffer) Buffer[0] = (UCHAR)SimDevice.Test->TestType;
+	return Sim_Complete(length, LengthTransferred, Overlapped);
+}
+
+static BOOL KUSB_API Sim_PipeNop(KUSB_HANDLE InterfaceHandle, UCHAR PipeID)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+	UNREFERENCED_PARAMETER(PipeID);
+
+	return TRUE;
+}
+
+VOID Sim_Install(PBENCHMARK_TEST_PARAM test)
+{
+	memset(&SimDevice, 0, sizeof(SimDevice));
+	SimDevice.Test = test;
+
+	K.ReadPipe				= Sim_ReadPipe;
+	K.WritePipe				= Sim_WritePipe;
+	K.ControlTransfer		= Sim_ControlTransfer;
+	K.IsoReadPipe			= Sim_IsoReadPipe;
+	K.IsoWritePipe			= Sim_IsoWritePipe;
+	K.GetCurrentFrameNumber	= Sim_GetCurrentFrameNumber;
+	K.GetOverlappedResult	= Sim_GetOverlappedResult;
+	K.ResetPipe				= Sim_PipeNop;
+	K.AbortPipe				= Sim_PipeNop;
+	K.FlushPipe				= Sim_PipeNop;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Latency histogram helpers.
+//
+static LONGLONG Perf_Now(void)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static VOID Latency_Add(PBM_LATENCY_HISTOGRAM latency, LONGLONG submitTime)
+{
+	BmLatency_Add(latency, ((Perf_Now() - submitTime) * 1000000) / PerfFrequency);
+}
+
+// Host clock (us) carried in latency test stamps; wraps every ~71 minutes.
+static UINT Latency_NowUs(void)
+{
+	LONGLONG now = Perf_Now();
+	return (UINT)((now / PerfFrequency) * 1000000 + ((now % PerfFrequency) * 1000000) / PerfFrequency);
+}
+
+static UINT Latency_PacketSize(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	return ISO_PACKET_SIZE(transferParam->Ep.MaximumPacketSize);
+}
+
+// Latency test; stamps every packet of a write transfer just before it is submitted.
+static VOID Latency_Stamp(PBENCHMARK_TRANSFER_PARAM transferParam, PUCHAR data, INT length)
+{
+	if (transferParam->Test->TestType != TestTypeLatency)
+		return;
+
+	BmLatency_Stamp(data, length, Latency_PacketSize(transferParam), &transferParam->EchoSequence, Latency_NowUs());
+}
+
+// Latency test; adds the packets of a completed read transfer.
+static VOID Latency_Echo(PBENCHMARK_TRANSFER_PARAM transferParam, PUCHAR data, INT length)
+{
+	UINT recvTime = Latency_NowUs();
+	UINT before, after, frameNumber;
+
+	// One-way times need the bus frame clock; the pair is taken around the frame number read.
+	if (!transferParam->EchoClockFailed &&
+	        (!transferParam->EchoClock.Valid || recvTime - transferParam->EchoClock.HostTimeUs >= 1000000))
+	{
+		before = Latency_NowUs();
+		if (K.GetCurrentFrameNumber(transferParam->Test->InterfaceHandle, &frameNumber))
+		{
+			after = Latency_NowUs();
+			BmLatency_SetClock(&transferParam->EchoClock, before + ((after - before) / 2), frameNumber, after - before);
+		}
+		else
+		{
+			CONWRN("GetCurrentFrameNumber failed; one-way latency disabled. ErrorCode=%08Xh\n", GetLastError());
+			transferParam->EchoClockFailed = TRUE;
+		}
+	}
+
+	EnterCriticalSection(&DisplayCriticalSection);
+	BmLatency_Echo(&transferParam->Echo, &transferParam->EchoClock, data, length, Latency_PacketSize(transferParam), recvTime);
+	LeaveCriticalSection(&DisplayCriticalSection);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Workload replay helpers. The profile format and step generator are in
+// kBench_replay.c.
+//
+BOOL Replay_Load(PBM_REPLAY_PROFILE profile, LPCSTR fileName)
+{
+	FILE* file = NULL;
+	CHAR line[256];
+	INT lineNumber = 0;
+
+	BmReplay_Init(profile);
+
+	if (fopen_s(&file, fileName, "r") != 0 || !file)
+	{
+		CONERR("failed opening profile %s\n", fileName);
+		return FALSE;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+
+		switch (BmReplay_ParseLine(profile, line))
+		{
+		case BM_REPLAY_LINE_INVALID:
+			CONERR("invalid profile entry at %s(%d)\n", fileName, lineNumber);
+			goto Error;
+		case BM_REPLAY_LINE_NO_MEMORY:
+			CONERR("memory allocation failure at line %d!\n", __LINE__);
+			goto Error;
+		}
+	}
+
+	fclose(file);
+
+	if (!profile->StepCount)
+	{
+		CONERR("profile %s has no transfer steps.\n", fileName);
+		return FALSE;
+	}
+	return TRUE;
+
+Error:
+	fclose(file);
+	BmReplay_Free(profile);
+	return FALSE;
+}
+
+// Moves the replay cursor to the next step and schedules it on the timeline.
+static BOOL Replay_Advance(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	if (!BmReplay_Next(&transferParam->Test->Replay, &transferParam->ReplayCursor, &transferParam->ReplayOp, &transferParam->ReplayLength))
+		return FALSE;
+
+	transferParam->ReplayDue = transferParam->ReplayStart + (transferParam->ReplayCursor.DueUs * PerfFrequency) / 1000000;
+	transferParam->ReplayPending = TRUE;
+	return TRUE;
+}
+
+static VOID Replay_Control(PBENCHMARK_TRANSFER_PARAM transferParam, INT length)
+{
+	UCHAR buffer[64];
+	UINT transferred = 0;
+	WINUSB_SETUP_PACKET Pkt;
+	KUSB_SETUP_PACKET* defPkt = (KUSB_SETUP_PACKET*)&Pkt;
+	LONGLONG submitTime;
+
+	memset(&Pkt, 0, sizeof(Pkt));
+	defPkt->BmRequest.Dir = BMREQUEST_DIR_DEVICE_TO_HOST;
+	defPkt->BmRequest.Type = BMREQUEST_TYPE_VENDOR;
+	defPkt->Request = GET_TEST;
+	defPkt->Index = (USHORT)transferParam->Test->InterfaceDescriptor.bInterfaceNumber;
+	defPkt->Length = (USHORT)min(max(length, 1), (INT)sizeof(buffer));
+
+	submitTime = Perf_Now();
+	if (K.ControlTransfer(transferParam->Test->InterfaceHandle, Pkt, buffer, defPkt->Length, &transferred, NULL))
+	{
+		Latency_Add(&transferParam->Latency, submitTime);
+		transferParam->ReplayControlCount++;
+	}
+	else
+	{
+		transferParam->TotalErrorCount++;
+		CONERR("control request failed. ErrorCode=%08Xh\n", GetLastError());
+	}
+}
+
+// Control test; one CONTROL_READ or CONTROL_WRITE request with a data stage of
+// length bytes. The direction of the transfer param's pipe picks the request.
+static BOOL Control_Transfer(PBENCHMARK_TRANSFER_PARAM transferParam, INT length, PUINT transferred)
+{
+	WINUSB_SETUP_PACKET Pkt;
+	KUSB_SETUP_PACKET* defPkt = (KUSB_SETUP_PACKET*)&Pkt;
+
+	memset(&Pkt, 0, sizeof(Pkt));
+	if (USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId))
+	{
+		defPkt->BmRequest.Dir = BMREQUEST_DIR_DEVICE_TO_HOST;
+		defPkt->Request = CONTROL_READ;
+	}
+	else
+	{
+		defPkt->BmRequest.Dir = BMREQUEST_DIR_HOST_TO_DEVICE;
+		defPkt->Request = CONTROL_WRITE;
+	}
+	defPkt->BmRequest.Type = BMREQUEST_TYPE_VENDOR;
+	defPkt->Index = (USHORT)transferParam->Test->InterfaceDescriptor.bInterfaceNumber;
+	defPkt->Length = (USHORT)length;
+
+	return K.ControlTransfer(transferParam->Test->InterfaceHandle, Pkt, transferParam->Buffer, length, transferred, NULL);
+}
+
+// Waits for the next profile step owned by this thread and leaves its length in
+// ReplayLength. Returns FALSE when the profile is finished, the test is cancelled,
+// or the oldest outstanding transfer completes first so the caller can reap it
+// without adding the inter-arrival delay to its latency.
+static BOOL Replay_WaitNext(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	LONGLONG remaining;
+	DWORD waitMs;
+
+	if (!transferParam->ReplayStart)
+	{
+		BmReplay_Start(&transferParam->Test->Replay, &transferParam->ReplayCursor);
+		transferParam->ReplayStart = Perf_Now();
+	}
+
+	while (!transferParam->Test->IsCancelled && !transferParam->ReplayCursor.Done)
+	{
+		if (!transferParam->ReplayPending && !Replay_Advance(transferParam))
+			break;
+
+		remaining = transferParam->ReplayDue - Perf_Now();
+		if (remaining > 0)
+		{
+			waitMs = (DWORD)((remaining * 1000) / PerfFrequency);
+			if (transferParam->OutstandingTransferCount > 0)
+			{
+				PBENCHMARK_TRANSFER_HANDLE oldest = &transferParam->TransferHandles[transferParam->TransferHandleWaitIndex];
+				if (WaitForSingleObject(oldest->Overlapped.hEvent, waitMs) == WAIT_OBJECT_0)
+					return FALSE;
+			}
+			else if (waitMs)
+			{
+				Sleep(waitMs);
+			}
+			else
+			{
+				SwitchToThread();
+			}
+			continue;
+		}
+
+		// Steps that belong to the other pipe only advance the timeline.
+		transferParam->ReplayPending = FALSE;
+		if (!BmReplay_IsOwner(&transferParam->Test->Replay, transferParam->ReplayOp, USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId)))
+			continue;
+
+		if (transferParam->ReplayOp == BM_REPLAY_OP_CONTROL)
+		{
+			Replay_Control(transferParam, transferParam->ReplayLength);
+			continue;
+		}
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+// Largest driver trace dump kBench will read. (KTRACE_RING_COUNT * KTRACE_RING_RECORDS fits easily)
+#define TRACE_DUMP_MAX_SIZE (4 * 1024 * 1024)
+
+// Reads the driver trace rings with LIBUSBK_IOCTL_GET_TRACE and writes the raw
+// dump to test->TraceFile. The dump is formatted with "kTrace decode <file>".
+static BOOL Trace_Save(PBENCHMARK_TEST_PARAM test)
+{
+	HANDLE deviceHandle = NULL;
+	UINT propertySize = sizeof(deviceHandle);
+	libusb_request request;
+	OVERLAPPED overlapped;
+	KTRACE_DUMP_HEADER* header;
+	PUCHAR dump = NULL;
+	DWORD length = 0;
+	FILE* file = NULL;
+	BOOL success = FALSE;
+
+	memset(&overlapped, 0, sizeof(overlapped));
+	memset(&request, 0, sizeof(request));
+
+	if (!K.GetProperty(test->InterfaceHandle, KUSB_PROPERTY_DEVICE_FILE_HANDLE, &propertySize, &deviceHandle))
+	{
+		CONERR("driver trace is only available with the libusbK driver. ErrorCode=%08Xh\n", GetLastError());
+		return FALSE;
+	}
+
+	dump = malloc(TRACE_DUMP_MAX_SIZE);
+	overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!dump || !overlapped.hEvent)
+	{
+		CONERR("out of resources reading driver trace.\n");
+		goto Done;
+	}
+
+	// The device handle is overlapped.
+	if (!DeviceIoControl(deviceHandle, LIBUSBK_IOCTL_GET_TRACE, &request, sizeof(request), dump, TRACE_DUMP_MAX_SIZE, NULL, &overlapped) &&
+	        GetLastError() != ERROR_IO_PENDING)
+	{
+		CONERR("LIBUSBK_IOCTL_GET_TRACE failed. ErrorCode=%08Xh\n", GetLastError());
+		goto Done;
+	}
+	if (!GetOverlappedResult(deviceHandle, &overlapped, &length, TRUE))
+	{
+		CONERR("LIBUSBK_IOCTL_GET_TRACE failed. ErrorCode=%08Xh\n", GetLastError());
+		goto Done;
+	}
+
+	header = (KTRACE_DUMP_HEADER*)dump;
+	if (length < sizeof(*header) || header->Magic != KTRACE_DUMP_MAGIC)
+	{
+		CONERR("invalid driver trace dump. Length=%u\n", length);
+		goto Done;
+	}
+
+	if (fopen_s(&file, test->TraceFile, "wb") != 0 || !file)
+	{
+		CONERR("failed creating trace file %s\n", test->TraceFile);
+		file = NULL;
+		goto Done;
+	}
+
+	success = fwrite(dump, length, 1, file) == 1;
+	if (success)
+		CONMSG("Driver trace: %u events (%u lost) saved to %s\n", header->RecordCount, header->Lost, test->TraceFile);
+	else
+		CONERR("failed writing trace file %s\n", test->TraceFile);
+
+Done:
+	if (file) fclose(file);
+	if (overlapped.hEvent) CloseHandle(overlapped.hEvent);
+	free(dump);
+	return success;
+}
+
+// Returns the number of bytes for the next transfer on this pipe.
+static INT Transfer_NextLength(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	if (transferParam->Test->Replay.StepCount)
+		return transferParam->ReplayLength;
+
+	return USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId) ? transferParam->Test->ReadLength : transferParam->Test->WriteLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IsoEx transfer mode helpers.
+//
+static BOOL IsoEx_Submit(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_HANDLE handle)
+{
+	PBENCHMARK_TEST_PARAM test = transferParam->Test;
+	PKISO_CONTEXT isoContext;
+	UINT transferLength;
+
+	if (!handle->IsoContext)
+	{
+		if (!IsoK_Init(&handle->IsoContext, test->IsoPacketCount, 0))
+			return FALSE;
+	}
+	isoContext = handle->IsoContext;
+
+	// Packet offsets (and the transfer length) come from the precomputed layout.
+	if (!IsoK_ApplyLayout(transferParam->IsoLayout, isoContext, &transferLength))
+		return FALSE;
+
+	if (test->IsoStartFrame == ISO_START_FRAME_CONTIGUOUS)
+	{
+		if (!transferParam->IsoStartFrameValid)
+		{
+			// (Re)synchronize with the bus; schedule the next transfer IsoFrameLead frames from now.
+			if (!K.GetCurrentFrameNumber(test->InterfaceHandle, &transferParam->IsoNextStartFrame))
+				return FALSE;
+
+			transferParam->IsoNextStartFrame += test->IsoFrameLead;
+			transferParam->IsoStartFrameValid = TRUE;
+		}
+
+		isoContext->Flags		= KISO_FLAG_SET_START_FRAME;
+		isoContext->StartFrame	= transferParam->IsoNextStartFrame;
+		transferParam->IsoNextStartFrame += transferParam->IsoFramesPerTransfer;
+	}
+	else
+	{
+		isoContext->Flags = KISO_FLAG_NONE;
+	}
+
+	handle->DataMaxLength = (INT)transferLength;
+
+	if (USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId))
+	{
+		return K.IsoReadPipe(test->InterfaceHandle,
+		                     transferParam->Ep.PipeId,
+		                     handle->Data,
+		                     handle->DataMaxLength,
+		                     &handle->Overlapped,
+		                     isoContext);
+	}
+
+	AppendLoopBuffer(test, handle->Data, handle->DataMaxLength);
+	return K.IsoWritePipe(test->InterfaceHandle,
+	                      transferParam->Ep.PipeId,
+	                      handle->Data,
+	                      handle->DataMaxLength,
+	                      &handle->Overlapped,
+	                      isoContext);
+}
+
+// Returns the number of contiguous data bytes in handle->Data.
+static INT IsoEx_Complete(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_HANDLE handle, INT transferred)
+{
+	UINT compacted;
+
+	if (!handle->IsoContext)
+		return transferred;
+
+	// Gather the received packets to the front of the buffer for verify and logging.
+	if (USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId))
+	{
+		if (IsoK_CompactPackets(handle->IsoContext, handle->Data, handle->Data, handle->DataMaxLength, &compacted))
+			transferred = (INT)compacted;
+	}
+
+	if (!handle->IsoContext->ErrorCount)
+		return transferred;
+
+	transferParam->IsoErrorPacketCount += handle->IsoContext->ErrorCount;
+
+	// Packets were late or missed; re-sync the start frame with the bus on the next submit.
+	if (transferParam->Test->IsoStartFrame == ISO_START_FRAME_CONTIGUOUS)
+	{
+		transferParam->IsoStartFrameValid = FALSE;
+		transferParam->IsoResyncCount++;
+	}
+	return transferred;
+}
+
+static BOOL IsoEx_Init(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	PBENCHMARK_TEST_PARAM test = transferParam->Test;
+	KISO_LAYOUT_PARAMS layoutParams;
+	UINT interval;
+	UINT period;
+
+	// Iso endpoints are serviced every 2^(bInterval-1) (micro)frames.
+	interval = transferParam->Ep.Interval;
+	if (interval < 1) interval = 1;
+	if (interval > 16) interval = 16;
+	period = 1 << (interval - 1);
+
+	if (test->DeviceSpeed == HighSpeed)
+		transferParam->IsoFramesPerTransfer = (test->IsoPacketCount * period + 7) / 8;
+	else
+		transferParam->IsoFramesPerTransfer = test->IsoPacketCount * period;
+
+	transferParam->IsoStartFrameValid = FALSE;
+
+	memset(&layoutParams, 0, sizeof(layoutParams));
+	layoutParams.MaxPacketSize	= transferParam->Ep.MaximumPacketSize;
+	layoutParams.Interval		= (USHORT)period;
+	layoutParams.DeviceSpeed	= test->DeviceSpeed;
+	layoutParams.SampleRate		= test->IsoSampleRate;
+	layoutParams.BytesPerSample	= test->IsoBytesPerSample;
+
+	if (!IsoK_InitLayout(&transferParam->IsoLayout, &layoutParams, test->IsoPacketCount))
+	{
+		CONERR("failed creating iso packet layout. ErrorCode=%08Xh\n", GetLastError());
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Stream transfer mode helpers.
+//
+static INT KUSB_API Stream_Submit(PKSTM_INFO StreamInfo, PKSTM_XFER_CONTEXT XferContext, INT XferContextIndex, LPOVERLAPPED Overlapped)
+{
+	UNREFERENCED_PARAMETER(XferContextIndex);
+
+	// Submit through K so the stream also runs against the software device.
+	if (USB_ENDPOINT_DIRECTION_IN(StreamInfo->PipeID))
+		K.ReadPipe(StreamInfo->UsbHandle, StreamInfo->PipeID, XferContext->Buffer, XferContext->BufferSize, NULL, Overlapped);
+	else
+		K.WritePipe(StreamInfo->UsbHandle, StreamInfo->PipeID, XferContext->Buffer, XferContext->TransferLength, NULL, Overlapped);
+
+	return (INT)GetLastError();
 }
 
-INT VerifyData(PBENCHMARK_TRANSFER_PARAM transferParam, BYTE* data, INT dataLength)
+static BOOL Stream_Start(PBENCHMARK_TRANSFER_PARAM transferParam)
 {
-
-	WORD verifyDataSize = transferParam->Test->VerifyBufferSize;
-	BYTE* verifyData = transferParam->Test->VerifyBuffer;
-	BYTE keyC = 0;
-	BOOL seedKey = TRUE;
-	INT dataLeft = dataLength;
-	INT dataIndex = 0;
-	INT packetIndex = 0;
-	INT verifyIndex = 0;
-
-	while(dataLeft > 1)
+	PBENCHMARK_TEST_PARAM test = transferParam->Test;
+	KSTM_CALLBACK callbacks;
+	KSTM_FLAG flags;
+
+	memset(&callbacks, 0, sizeof(callbacks));
+	callbacks.Submit = Stream_Submit;
+
+	// StmK_Read/StmK_Write wait up to Timeout ms for a transfer context.
+	flags = KSTM_FLAG_USE_TIMEOUT | (test->Timeout & KSTM_FLAG_TIMEOUT_MASK);
+
+	if (!StmK_Init(&transferParam->StreamHandle,
+	               test->InterfaceHandle,
+	               transferParam->Ep.PipeId,
+	               test->StreamTransferSize,
+	               test->StreamMaxPending,
+	               test->StreamMaxPendingIO,
+	               &callbacks,
+	               flags))
 	{
-		verifyDataSize = dataLeft > transferParam->Test->VerifyBufferSize ? transferParam->Test->VerifyBufferSize : (WORD)dataLeft;
+		transferParam->StreamHandle = NULL;
+		CONERR("StmK_Init failed. ErrorCode=%08Xh\n", GetLastError());
+		return FALSE;
+	}
 
-		if (seedKey)
-			keyC = data[dataIndex + 1];
-		else
-		{
-			if (data[dataIndex + 1] == 0)
-			{
-				keyC = 0;
-			}
-			else
-			{
-				keyC++;
-			}
-		}
-		seedKey = FALSE;
-		// Index 0 is always 0.
-		// The key is always at index 1
-		verifyData[1] = keyC;
+	if (!StmK_Start(transferParam->StreamHandle))
+	{
+		CONERR("StmK_Start failed. ErrorCode=%08Xh\n", GetLastError());
+		StmK_Free(transferParam->StreamHandle);
+		transferParam->StreamHandle = NULL;
+		return FALSE;
+	}
 
-		if (memcmp(&data[dataIndex], verifyData, verifyDataSize) != 0)
-		{
-			// Packet verification failed.
+	return TRUE;
+}
 
-			// Reset the key byte on the next packet.
-			seedKey = TRUE;
+static VOID Stream_Stop(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	if (!transferParam->StreamHandle) return;
 
-			CONVDAT("Packet=#%d Data=#%d\n", packetIndex, dataIndex);
+	StmK_Stop(transferParam->StreamHandle, transferParam->Test->Timeout);
+	StmK_Free(transferParam->StreamHandle);
+	transferParam->StreamHandle = NULL;
+}
 
-			if (transferParam->Test->VerifyDetails)
-			{
-				for (verifyIndex = 0; verifyIndex < verifyDataSize; verifyIndex++)
-				{
-					if (verifyData[verifyIndex] == data[dataIndex + verifyIndex])
-						continue;
+int TransferStream(PBENCHMARK_TRANSFER_PARAM transferParam)
+{
+	UINT transferred = 0;
+	BOOL success;
+	DWORD errorCode;
 
-					CONVDAT("packet-offset=%d expected %02Xh got %02Xh\n",
-					        verifyIndex,
-					        verifyData[verifyIndex],
-					        data[dataIndex + verifyIndex]);
+	if (USB_ENDPOINT_DIRECTION_IN(transferParam->Ep.PipeId))
+	{
+		success = StmK_Read(transferParam->StreamHandle,
+		                    transferParam->Buffer,
+		                    0,
+		                    transferParam->Test->ReadLength,
+		                    &transferred);
+	}
+	else
+	{
+		AppendLoopBuffer(transferParam->Test, transferParam->Buffer, transferParam->Test->WriteLength);
+		success = StmK_Write(transferParam->StreamHandle,
+		                     transferParam->Buffer,
+		                     0,
+		                     transferParam->Test->WriteLength,
+		                     &transferred);
+	}
 
-				}
-			}
-		}
+	if (success) return (int)transferred;
 
-		// Move to the next packet.
-		packetIndex++;
-		dataLeft -= verifyDataSize;
-		dataIndex += verifyDataSize;
-	}
+	// The stream returns ERROR_NO_MORE_ITEMS when no transfer context became available within the timeout.
+	errorCode = GetLastError();
+	if (errorCode == ERROR_NO_MORE_ITEMS)
+		errorCode = ERROR_SEM_TIMEOUT;
 
-	return 0;
+	return -labs(errorCode);
 }
 
 int TransferSync(PBENCHMARK_TRANSFER_PARAM transferParam)
 {
 	UINT transferred;
 	BOOL success;
-	if (transferParam->Ep.PipeId & USB_ENDPOINT_DIRECTION_MASK)
+	INT length;
+	LONGLONG submitTime;
+
+	if (transferParam->Test->Replay.StepCount && !Replay_WaitNext(transferParam))
+		return 0;
+
+	length = Transfer_NextLength(transferParam);
+	submitTime = Perf_Now();
+
+	if (ENDPOINT_TYPE(transferParam) == USB_ENDPOINT_TYPE_CONTROL)
+	{
+		success = Control_Transfer(transferParam, length, &transferred);
+	}
+	else if (transferParam->Ep.PipeId & USB_ENDPOINT_DIRECTION_MASK)
 	{
 		success = K.ReadPipe(transferParam->Test->InterfaceHandle,
 		                     transferParam->Ep.PipeId,
 		                     transferParam->Buffer,
-		                     transferParam->Test->ReadLength,
+		                     length,
 		                     &transferred,
 		                     NULL);
 	}
 	else
 	{
-		AppendLoopBuffer(transferParam->Test, transferParam->Buffer, transferParam->Test->WriteLength);
+		AppendLoopBuffer(transferParam->Test, transferParam->Buffer, length);
+		Latency_Stamp(transferParam, transferParam->Buffer, length);
 		success = K.WritePipe(transferParam->Test->InterfaceHandle,
 		                      transferParam->Ep.PipeId,
 		                      transferParam->Buffer,
-		                      transferParam->Test->WriteLength,
+		                      length,
 		                      &transferred,
 		                      NULL);
 	}
 
+	if (success) Latency_Add(&transferParam->Latency, submitTime);
+
 	return success ? (int)transferred : -labs(GetLastError());
 }
 
@@ -634,6 +1573,10 @@ int TransferAsync(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_H
 	// Submit transfers until the maximum number of outstanding transfer(s) is reached.
 	while (transferParam->OutstandingTransferCount < transferParam->Test->BufferCount)
 	{
+		// In replay mode the workload profile decides when, and how much, to submit.
+		if (transferParam->Test->Replay.StepCount && !Replay_WaitNext(transferParam))
+			break;
+
 		// Get the next available benchmark transfer handle.
 		*handleRef = handle = &transferParam->TransferHandles[transferParam->TransferHandleNextIndex];
 
@@ -655,9 +1598,15 @@ int TransferAsync(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_H
 			handle->Overlapped.hEvent = h;
 		}
 
-		if (transferParam->Ep.PipeId & USB_ENDPOINT_DIRECTION_MASK)
+		handle->SubmitTime = Perf_Now();
+
+		if (transferParam->Test->TransferMode == TRANSFER_MODE_ISOEX)
 		{
-			handle->DataMaxLength = transferParam->Test->ReadLength;
+			success = IsoEx_Submit(transferParam, handle);
+		}
+		else if (transferParam->Ep.PipeId & USB_ENDPOINT_DIRECTION_MASK)
+		{
+			handle->DataMaxLength = Transfer_NextLength(transferParam);
 			success = K.ReadPipe(transferParam->Test->InterfaceHandle,
 			                     transferParam->Ep.PipeId,
 			                     handle->Data,
@@ -667,8 +1616,9 @@ int TransferAsync(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_H
 		}
 		else
 		{
-			AppendLoopBuffer(transferParam->Test, handle->Data, transferParam->Test->WriteLength);
-			handle->DataMaxLength = transferParam->Test->WriteLength;
+			handle->DataMaxLength = Transfer_NextLength(transferParam);
+			AppendLoopBuffer(transferParam->Test, handle->Data, handle->DataMaxLength);
+			Latency_Stamp(transferParam, handle->Data, handle->DataMaxLength);
 			success = K.WritePipe(transferParam->Test->InterfaceHandle,
 			                      transferParam->Ep.PipeId,
 			                      handle->Data,
@@ -706,9 +1656,11 @@ int TransferAsync(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_H
 	}
 
 	// If the number of outstanding transfers has reached the limit, wait for the
-	// oldest outstanding transfer to complete.
+	// oldest outstanding transfer to complete. In replay mode the oldest transfer
+	// is also reaped when it completes before the next step is due.
 	//
-	if (transferParam->OutstandingTransferCount == transferParam->Test->BufferCount)
+	if (transferParam->OutstandingTransferCount == transferParam->Test->BufferCount ||
+	        (transferParam->Test->Replay.StepCount && transferParam->OutstandingTransferCount > 0))
 	{
 		UINT transferred;
 		// TransferHandleWaitIndex is the index of the oldest outstanding transfer.
@@ -739,6 +1691,11 @@ int TransferAsync(PBENCHMARK_TRANSFER_PARAM transferParam, PBENCHMARK_TRANSFER_H
 
 		if (ret < 0) goto Done;
 
+		Latency_Add(&transferParam->Latency, handle->SubmitTime);
+
+		if (transferParam->Test->TransferMode == TRANSFER_MODE_ISOEX)
+			handle->ReturnCode = ret = IsoEx_Complete(transferParam, handle, ret);
+
 		// Mark this handle has no longer InUse.
 		handle->InUse = FALSE;
 
@@ -872,7 +1829,19 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParam)
 
 	transferParam->IsRunning = TRUE;
 
-	K.ResetPipe(transferParam->Test->InterfaceHandle, transferParam->Ep.PipeId);
+	if (ENDPOINT_TYPE(transferParam) != USB_ENDPOINT_TYPE_CONTROL)
+		K.ResetPipe(transferParam->Test->InterfaceHandle, transferParam->Ep.PipeId);
+
+	if (transferParam->Test->TransferMode == TRANSFER_MODE_STREAM)
+	{
+		if (!Stream_Start(transferParam))
+			goto Done;
+	}
+	else if (transferParam->Test->TransferMode == TRANSFER_MODE_ISOEX)
+	{
+		if (!IsoEx_Init(transferParam))
+			goto Done;
+	}
 
 	while (!transferParam->Test->IsCancelled)
 	{
@@ -884,17 +1853,27 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParam)
 			ret = TransferSync(transferParam);
 			if (ret >= 0) data = transferParam->Buffer;
 		}
-		else if (transferParam->Test->TransferMode == TRANSFER_MODE_ASYNC)
+		else if (transferParam->Test->TransferMode == TRANSFER_MODE_ASYNC ||
+		         transferParam->Test->TransferMode == TRANSFER_MODE_ISOEX)
 		{
 			ret = TransferAsync(transferParam, &handle);
 			if ((handle) && ret >= 0) data = handle->Data;
 		}
+		else if (transferParam->Test->TransferMode == TRANSFER_MODE_STREAM)
+		{
+			ret = TransferStream(transferParam);
+			if (ret >= 0) data = transferParam->Buffer;
+		}
 		else
 		{
 			CONERR("invalid transfer mode %d\n", transferParam->Test->TransferMode);
 			goto Done;
 		}
 
+		// The workload profile has been replayed and every transfer reaped.
+		if (transferParam->ReplayCursor.Done && !transferParam->OutstandingTransferCount && ret == 0)
+			break;
+
 		if (transferParam->Test->Verify &&
 		        transferParam->Test->VerifyList &&
 		        transferParam->Test->TestType == TestTypeLoop &&
@@ -932,7 +1911,8 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParam)
 				       transferParam->Test->Retry + 1,
 				       ret);
 
-				K.ResetPipe(transferParam->Test->InterfaceHandle, transferParam->Ep.PipeId);
+				if (ENDPOINT_TYPE(transferParam) != USB_ENDPOINT_TYPE_CONTROL)
+					K.ResetPipe(transferParam->Test->InterfaceHandle, transferParam->Ep.PipeId);
 
 				if (transferParam->RunningErrorCount > transferParam->Test->Retry)
 					break;
@@ -955,6 +1935,11 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParam)
 				{
 					VerifyData(transferParam, data, ret);
 				}
+
+				if (transferParam->Test->TestType == TestTypeLatency)
+				{
+					Latency_Echo(transferParam, data, ret);
+				}
 			}
 			else
 			{
@@ -996,6 +1981,8 @@ DWORD TransferThreadProc(PBENCHMARK_TRANSFER_PARAM transferParam)
 
 Done:
 
+	Stream_Stop(transferParam);
+
 	for (i = 0; i < transferParam->Test->BufferCount; i++)
 	{
 		if (transferParam->TransferHandles[i].Overlapped.hEvent)
@@ -1036,6 +2023,18 @@ Done:
 			transferParam->TransferHandles[i].Overlapped.hEvent = NULL;
 		}
 		transferParam->TransferHandles[i].InUse = FALSE;
+
+		if (transferParam->TransferHandles[i].IsoContext)
+		{
+			IsoK_Free(transferParam->TransferHandles[i].IsoContext);
+			transferParam->TransferHandles[i].IsoContext = NULL;
+		}
+	}
+
+	if (transferParam->IsoLayout)
+	{
+		IsoK_FreeLayout(transferParam->IsoLayout);
+		transferParam->IsoLayout = NULL;
 	}
 
 	transferParam->IsRunning = FALSE;
@@ -1067,6 +2066,78 @@ int ValidateBenchmarkArgs(PBENCHMARK_TEST_PARAM test)
 		return -1;
 	}
 
+	if (test->TransferMode == TRANSFER_MODE_STREAM)
+	{
+		if (test->StreamMaxPendingIO < 1 || test->StreamMaxPending < test->StreamMaxPendingIO)
+		{
+			CONERR("Invalid stream arguments. StreamIO=%d StreamPending=%d. StreamIO must be greater than 0 and less than or equal to StreamPending.\n",
+			       test->StreamMaxPendingIO, test->StreamMaxPending);
+			return -1;
+		}
+	}
+
+	if (test->TransferMode == TRANSFER_MODE_ISOEX)
+	{
+		if (test->IsoPacketCount < 0 || test->IsoPacketCount > 1024 || test->IsoFrameLead < 0)
+		{
+			CONERR("Invalid iso arguments. IsoPackets=%d IsoFrameLead=%d. IsoPackets must be 0-1024.\n",
+			       test->IsoPacketCount, test->IsoFrameLead);
+			return -1;
+		}
+		if (test->IsoSampleRate < 0 || (test->IsoSampleRate && test->IsoBytesPerSample < 1))
+		{
+			CONERR("Invalid iso arguments. IsoRate=%d IsoSampleSize=%d. IsoSampleSize is required with IsoRate.\n",
+			       test->IsoSampleRate, test->IsoBytesPerSample);
+			return -1;
+		}
+	}
+
+	if (test->Replay.StepCount && test->TransferMode != TRANSFER_MODE_SYNC && test->TransferMode != TRANSFER_MODE_ASYNC)
+	{
+		CONERR("Workload profiles can only be replayed with mode=sync or mode=async.\n");
+		return -1;
+	}
+
+	if (test->TestType == TestTypeLatency)
+	{
+		if ((test->TransferMode != TRANSFER_MODE_SYNC && test->TransferMode != TRANSFER_MODE_ASYNC) || test->Replay.StepCount)
+		{
+			CONERR("The latency test runs with mode=sync or mode=async and without a workload profile.\n");
+			return -1;
+		}
+		if (test->UseSimDevice)
+		{
+			CONERR("The software device does not echo; the latency test needs a benchmark device.\n");
+			return -1;
+		}
+		if (test->Verify)
+		{
+			CONWRN("The latency test overwrites the test pattern; verify disabled.\n");
+			test->Verify = FALSE;
+		}
+	}
+
+	if (test->TestType == TestTypeControl)
+	{
+		INT length = test->ControlWrite ? test->WriteLength : test->ReadLength;
+
+		if (test->TransferMode != TRANSFER_MODE_SYNC || test->Replay.StepCount || test->UseSimDevice)
+		{
+			CONERR("The control test runs with mode=sync, on a benchmark device and without a workload profile.\n");
+			return -1;
+		}
+		if (length < 1 || length > BM_CONTROL_MAX_TRANSFER_SIZE)
+		{
+			CONERR("Invalid control test size %d. The data stage must be 1-%d bytes.\n", length, BM_CONTROL_MAX_TRANSFER_SIZE);
+			return -1;
+		}
+		if (test->Verify)
+		{
+			CONWRN("The control test does not verify data; verify disabled.\n");
+			test->Verify = FALSE;
+		}
+	}
+
 	return 0;
 }
 
@@ -1089,7 +2160,7 @@ int ParseBenchmarkArgs(PBENCHMARK_TEST_PARAM testParams, int argc, char** argv)
 		else if (GetParamIntValue(arg, "retry=", &testParams->Retry)) {}
 		else if (GetParamIntValue(arg, "buffercount=", &testParams->BufferCount))
 		{
-			if (testParams->BufferCount > 1)
+			if (testParams->BufferCount > 1 && testParams->TransferMode == TRANSFER_MODE_SYNC)
 				testParams->TransferMode = TRANSFER_MODE_ASYNC;
 		}
 		else if (GetParamIntValue(arg, "buffersize=", &testParams->AllocBufferSize) ||
@@ -1112,6 +2183,39 @@ int ParseBenchmarkArgs(PBENCHMARK_TEST_PARAM testParams, int argc, char** argv)
 		}
 		else if (GetParamIntValue(arg, "refresh=", &testParams->Refresh)) {}
 		else if (GetParamIntValue(arg, "fixedisopackets=", &testParams->FixedIsoPackets)) {}
+		else if (GetParamIntValue(arg, "streamsize=", &testParams->StreamTransferSize)) {}
+		else if (GetParamIntValue(arg, "streampending=", &testParams->StreamMaxPending)) {}
+		else if (GetParamIntValue(arg, "streamio=", &testParams->StreamMaxPendingIO)) {}
+		else if (GetParamIntValue(arg, "isopackets=", &testParams->IsoPacketCount)) {}
+		else if (GetParamIntValue(arg, "isoframelead=", &testParams->IsoFrameLead)) {}
+		else if (GetParamIntValue(arg, "isorate=", &testParams->IsoSampleRate)) {}
+		else if (GetParamIntValue(arg, "isosamplesize=", &testParams->IsoBytesPerSample)) {}
+		else if (GetParamIntValue(arg, "pace=", &testParams->PaceRate)) {}
+		else if ((value = GetParamStrValue(arg, "isostartframe=")) != NULL)
+		{
+			if (GetParamStrValue(value, "asap"))
+			{
+				testParams->IsoStartFrame = ISO_START_FRAME_ASAP;
+			}
+			else if (GetParamStrValue(value, "contiguous"))
+			{
+				testParams->IsoStartFrame = ISO_START_FRAME_CONTIGUOUS;
+			}
+			else
+			{
+				CONERR("invalid iso start frame argument! %s\n", argv[iarg]);
+				return -1;
+			}
+		}
+		else if ((value = GetParamStrValue(arg, "profile=")) != NULL)
+		{
+			// Use the original argument; file names keep their case.
+			strcpy_s(testParams->ReplayFile, _countof(testParams->ReplayFile), argv[iarg] + (value - arg));
+		}
+		else if ((value = GetParamStrValue(arg, "trace=")) != NULL)
+		{
+			strcpy_s(testParams->TraceFile, _countof(testParams->TraceFile), argv[iarg] + (value - arg));
+		}
 		else if ((value = GetParamStrValue(arg, "mode=")) != NULL)
 		{
 			if (GetParamStrValue(value, "sync"))
@@ -1122,6 +2226,14 @@ int ParseBenchmarkArgs(PBENCHMARK_TEST_PARAM testParams, int argc, char** argv)
 			{
 				testParams->TransferMode = TRANSFER_MODE_ASYNC;
 			}
+			else if (GetParamStrValue(value, "stream"))
+			{
+				testParams->TransferMode = TRANSFER_MODE_STREAM;
+			}
+			else if (GetParamStrValue(value, "isoex"))
+			{
+				testParams->TransferMode = TRANSFER_MODE_ISOEX;
+			}
 			else
 			{
 				// Invalid EndpointType argument.
@@ -1200,6 +2312,20 @@ int ParseBenchmarkArgs(PBENCHMARK_TEST_PARAM testParams, int argc, char** argv)
 		{
 			testParams->TestType = TestTypeLoop;
 		}
+		else if (!_stricmp(arg, "latency"))
+		{
+			testParams->TestType = TestTypeLatency;
+		}
+		else if (!_stricmp(arg, "ctrlread"))
+		{
+			testParams->TestType = TestTypeControl;
+			testParams->ControlWrite = FALSE;
+		}
+		else if (!_stricmp(arg, "ctrlwrite"))
+		{
+			testParams->TestType = TestTypeControl;
+			testParams->ControlWrite = TRUE;
+		}
 		else if (!_stricmp(arg, "listonly"))
 		{
 			testParams->UseList = TRUE;
@@ -1222,12 +2348,38 @@ int ParseBenchmarkArgs(PBENCHMARK_TEST_PARAM testParams, int argc, char** argv)
 		{
 			testParams->Use_UsbK_Init = TRUE;
 		}
+		else if (!_stricmp(arg, "devstats"))
+		{
+			testParams->DeviceStats = TRUE;
+		}
+		else if (!_stricmp(arg, "simdevice"))
+		{
+			testParams->UseSimDevice = TRUE;
+			testParams->NoTestSelect = TRUE;
+		}
 		else
 		{
 			CONERR("invalid argument! %s\n", argv[iarg]);
 			return -1;
 		}
 	}
+
+	if (testParams->ReplayFile[0])
+	{
+		PBM_REPLAY_PROFILE profile = &testParams->Replay;
+
+		if (!Replay_Load(profile, testParams->ReplayFile))
+			return -1;
+
+		// The profile determines the test type, transfer sizes and concurrency.
+		testParams->TestType = (profile->HasReads ? TestTypeRead : TestTypeNone) | (profile->HasWrites ? TestTypeWrite : TestTypeNone);
+		if (profile->MaxReadLength) testParams->ReadLength = profile->MaxReadLength;
+		if (profile->MaxWriteLength) testParams->WriteLength = profile->MaxWriteLength;
+		if (profile->Concurrency) testParams->BufferCount = profile->Concurrency;
+		if (testParams->BufferCount > 1 && testParams->TransferMode == TRANSFER_MODE_SYNC)
+			testParams->TransferMode = TRANSFER_MODE_ASYNC;
+	}
+
 	return ValidateBenchmarkArgs(testParams);
 }
 
@@ -1279,8 +2431,18 @@ PBENCHMARK_TRANSFER_PARAM CreateTransferParam(PBENCHMARK_TEST_PARAM test, int en
 
 	PWINUSB_PIPE_INFORMATION pipeInfo = NULL;
 
+	// The control test runs on the default pipe; it has no endpoint descriptor.
+	if (test->TestType == TestTypeControl)
+	{
+		memset(&test->ControlPipe, 0, sizeof(test->ControlPipe));
+		test->ControlPipe.PipeType = UsbdPipeTypeControl;
+		test->ControlPipe.PipeId = (UCHAR)(endpointID & USB_ENDPOINT_DIRECTION_MASK);
+		test->ControlPipe.MaximumPacketSize = test->DeviceDescriptor.bMaxPacketSize0;
+		pipeInfo = &test->ControlPipe;
+	}
+
 	/// Get Pipe Information
-	for(i = 0; i < test->InterfaceDescriptor.bNumEndpoints; i++)
+	for(i = 0; !pipeInfo && i < test->InterfaceDescriptor.bNumEndpoints; i++)
 	{
 		if (!(endpointID & USB_ENDPOINT_ADDRESS_MASK))
 		{
@@ -1312,6 +2474,32 @@ PBENCHMARK_TRANSFER_PARAM CreateTransferParam(PBENCHMARK_TEST_PARAM test, int en
 		CONWRN("MaximumPacketSize=0 for EP%02Xh. check alternate settings.\n", pipeInfo->PipeId);
 	}
 
+	if (test->TransferMode == TRANSFER_MODE_ISOEX)
+	{
+		INT isoPacketSize = ISO_PACKET_SIZE(pipeInfo->MaximumPacketSize);
+
+		if (pipeInfo->PipeType != UsbdPipeTypeIsochronous && !test->UseSimDevice)
+		{
+			CONERR("mode=isoex requires an isochronous endpoint. EP%02Xh is %s.\n",
+			       pipeInfo->PipeId, EndpointTypeDisplayString[pipeInfo->PipeType & 3]);
+			goto Done;
+		}
+
+		if (!test->IsoPacketCount && isoPacketSize)
+		{
+			test->IsoPacketCount = (USB_ENDPOINT_DIRECTION_IN(pipeInfo->PipeId) ? test->ReadLength : test->WriteLength) / isoPacketSize;
+			if (!test->IsoPacketCount) test->IsoPacketCount = 1;
+		}
+		test->AllocBufferSize = max(test->AllocBufferSize, test->IsoPacketCount * isoPacketSize);
+	}
+	else if (test->TransferMode == TRANSFER_MODE_STREAM && !test->StreamTransferSize && pipeInfo->MaximumPacketSize)
+	{
+		// StmK_Init requires a transfer size that is an interval of wMaxPacketSize.
+		test->StreamTransferSize = max(test->ReadLength, test->WriteLength);
+		test->StreamTransferSize += pipeInfo->MaximumPacketSize - 1;
+		test->StreamTransferSize -= test->StreamTransferSize % pipeInfo->MaximumPacketSize;
+	}
+
 	test->AllocBufferSize = max(test->AllocBufferSize, test->ReadLength);
 	test->AllocBufferSize = max(test->AllocBufferSize, test->WriteLength);
 
@@ -1325,9 +2513,11 @@ PBENCHMARK_TRANSFER_PARAM CreateTransferParam(PBENCHMARK_TEST_PARAM test, int en
 
 		memcpy(&transferParam->Ep, pipeInfo, sizeof(transferParam->Ep));
 
-		if (ENDPOINT_TYPE(transferParam) == USB_ENDPOINT_TYPE_ISOCHRONOUS)
+		if (ENDPOINT_TYPE(transferParam) == USB_ENDPOINT_TYPE_ISOCHRONOUS && transferParam->Test->TransferMode == TRANSFER_MODE_SYNC)
 			transferParam->Test->TransferMode = TRANSFER_MODE_ASYNC;
 
+		transferParam->IsoPacketSize = ISO_PACKET_SIZE(pipeInfo->MaximumPacketSize);
+
 		ResetRunningStatus(transferParam);
 
 		transferParam->ThreadHandle = CreateThread(
@@ -1457,6 +2647,27 @@ void ShowRunningStatus(PBENCHMARK_TRANSFER_PARAM transferParam)
 	}
 
 }
+void ShowDeviceStats(PBENCHMARK_TEST_PARAM test)
+{
+	BM_DEVICE_STATS stats;
+	BM_DEVICE_STATS delta;
+	CHAR line[256];
+
+	if (!Bench_GetStats(test->InterfaceHandle, (UCHAR)test->Intf, &stats))
+	{
+		// Stop polling; a stalled request every refresh would only slow the test down.
+		CONWRN("GET_STATS failed; devstats disabled. ErrorCode=%08Xh\n", GetLastError());
+		test->DeviceStats = FALSE;
+		return;
+	}
+
+	BmStats_Delta(&delta, &stats, &test->DeviceStatsLast);
+	test->DeviceStatsLast = stats;
+
+	BmStats_Format(line, sizeof(line), &delta);
+	CONMSG("%s\n", line);
+}
+
 void ShowTransferInfo(PBENCHMARK_TRANSFER_PARAM transferParam)
 {
 	DOUBLE bpsAverage;
@@ -1490,6 +2701,51 @@ void ShowTransferInfo(PBENCHMARK_TRANSFER_PARAM transferParam)
 		{
 			CONMSG("\tOther Errors    : %d\n", transferParam->TotalErrorCount);
 		}
+		if (transferParam->IsoErrorPacketCount)
+		{
+			CONMSG("\tIso Packet Errs : %d\n", transferParam->IsoErrorPacketCount);
+		}
+		if (transferParam->IsoResyncCount)
+		{
+			CONMSG("\tIso Resyncs     : %d\n", transferParam->IsoResyncCount);
+		}
+		if (transferParam->ReplayControlCount)
+		{
+			CONMSG("\tControl Requests: %d\n", transferParam->ReplayControlCount);
+		}
+		if (transferParam->Latency.Count)
+		{
+			CONMSG("\tLatency (us)    : min %d avg %.1f max %d\n",
+			       transferParam->Latency.MinUs,
+			       (DOUBLE)transferParam->Latency.TotalUs / (DOUBLE)transferParam->Latency.Count,
+			       transferParam->Latency.MaxUs);
+			CONMSG("\tLatency p50/p90 : %d / %d (us)\n",
+			       BmLatency_Percentile(&transferParam->Latency, 50.0),
+			       BmLatency_Percentile(&transferParam->Latency, 90.0));
+			CONMSG("\tLatency p99/p999: %d / %d (us)\n",
+			       BmLatency_Percentile(&transferParam->Latency, 99.0),
+			       BmLatency_Percentile(&transferParam->Latency, 99.9));
+		}
+		if (transferParam->Echo.Packets)
+		{
+			CHAR line[256];
+
+			BmLatency_Format(line, sizeof(line), &transferParam->Echo);
+			CONMSG("\tEcho Packets    : %s\n", line);
+			BmLatency_FormatHistogram(line, sizeof(line), &transferParam->Echo.RoundTrip);
+			CONMSG("\tRound Trip      : %s\n", line);
+			if (transferParam->Echo.OutLatency.Count)
+			{
+				BmLatency_FormatHistogram(line, sizeof(line), &transferParam->Echo.OutLatency);
+				CONMSG("\tHost To Device  : %s (+/-%dus)\n", line, transferParam->Echo.ResolutionUs);
+				BmLatency_FormatHistogram(line, sizeof(line), &transferParam->Echo.InLatency);
+				CONMSG("\tDevice To Host  : %s (+/-%dus)\n", line, transferParam->Echo.ResolutionUs);
+			}
+			else if (transferParam->Echo.OneWaySkipped)
+			{
+				CONMSG("\tOne-Way         : not resolved; round trips are under 2 x %dus\n", transferParam->Echo.ResolutionUs);
+			}
+		}
 
 		CONMSG("\tAvg. Bytes/sec  : %.2f\n", bpsAverage);
 
@@ -1509,7 +2765,9 @@ void ShowTestInfo(PBENCHMARK_TEST_PARAM test)
 {
 	if (!test) return;
 
-	CONMSG("%s Test Information\n", TestDisplayString[test->TestType & 3]);
+	CONMSG("%s Test Information\n",
+	       test->TestType == TestTypeLatency ? "Latency" :
+	       test->TestType == TestTypeControl ? "Control" : TestDisplayString[test->TestType & 3]);
 	CONMSG("\tDriver          : %s\n", GetDrvIdString(test->SelectedDeviceProfile->DriverID));
 	CONMSG("\tVid / Pid       : %04Xh / %04Xh\n", test->DeviceDescriptor.idVendor,  test->DeviceDescriptor.idProduct);
 	CONMSG("\tDevicePath      : %s\n", test->SelectedDeviceProfile->DevicePath);
@@ -1520,8 +2778,30 @@ void ShowTestInfo(PBENCHMARK_TEST_PARAM test)
 	CONMSG("\tPriority        : %d\n", test->Priority);
 	CONMSG("\tRead Size       : %d\n", test->ReadLength);
 	CONMSG("\tWrite Size      : %d\n", test->WriteLength);
+	CONMSG("\tTransfer Mode   : %s%s\n", TransferModeDisplayString[test->TransferMode], test->UseSimDevice ? " (Software Device)" : "");
 	CONMSG("\tBuffer Count    : %d\n", test->BufferCount);
+	if (test->TransferMode == TRANSFER_MODE_STREAM)
+	{
+		CONMSG("\tStream Xfer Size: %d\n", test->StreamTransferSize);
+		CONMSG("\tStream Pending  : %d (I/O %d)\n", test->StreamMaxPending, test->StreamMaxPendingIO);
+	}
+	else if (test->TransferMode == TRANSFER_MODE_ISOEX)
+	{
+		CONMSG("\tIso Packets     : %d\n", test->IsoPacketCount);
+		CONMSG("\tIso Start Frame : %s (lead %d)\n", test->IsoStartFrame == ISO_START_FRAME_ASAP ? "Asap" : "Contiguous", test->IsoFrameLead);
+		if (test->IsoSampleRate)
+			CONMSG("\tIso Sample Rate : %d Hz (%d bytes per sample)\n", test->IsoSampleRate, test->IsoBytesPerSample);
+	}
+	if (test->Replay.StepCount)
+	{
+		CONMSG("\tWorkload Profile: %s\n", test->ReplayFile);
+		CONMSG("\tProfile Steps   : %d (seed %u, passes %d)\n", test->Replay.StepCount, test->Replay.Seed, test->Replay.Passes);
+	}
 	CONMSG("\tDisplay Refresh : %d (ms)\n", test->Refresh);
+	if (test->DeviceStats)
+		CONMSG0("\tDevice Counters : On (GET_STATS)\n");
+	if (test->PaceRate > 0)
+		CONMSG("\tDevice Pacing   : %d KB/s (SET_PACING)\n", test->PaceRate);
 	CONMSG("\tTransfer Timeout: %d (ms)\n", test->Timeout);
 	CONMSG("\tRetry Count     : %d\n", test->Retry);
 	CONMSG("\tVerify Data     : %s%s\n",
@@ -1566,6 +2846,8 @@ void ResetRunningStatus(PBENCHMARK_TRANSFER_PARAM transferParam)
 	transferParam->Packets = -2;
 	transferParam->LastTick = 0;
 	transferParam->RunningTimeoutCount = 0;
+	memset(&transferParam->Latency, 0, sizeof(transferParam->Latency));
+	BmLatency_Reset(&transferParam->Echo);
 }
 
 int GetTestDeviceFromArgs(PBENCHMARK_TEST_PARAM test)
@@ -1679,6 +2961,7 @@ int __cdecl main(int argc, char** argv)
 	int key;
 	LONG ec;
 	UINT count, length;
+	LARGE_INTEGER perfFrequency;
 
 
 	if (argc == 1)
@@ -1689,6 +2972,14 @@ int __cdecl main(int argc, char** argv)
 
 	SetTestDefaults(&Test);
 
+	if (QueryPerformanceFrequency(&perfFrequency))
+		PerfFrequency = perfFrequency.QuadPart;
+	if (!PerfFrequency)
+	{
+		CONERR0("performance counter not available.\n");
+		return -1;
+	}
+
 	// Load the command line arguments.
 	if (ParseBenchmarkArgs(&Test, argc, argv) < 0)
 		return -1;
@@ -1742,6 +3033,10 @@ int __cdecl main(int argc, char** argv)
 
 	CONMSG("opened %s (%s)..\n", Test.SelectedDeviceProfile->DeviceDesc, Test.SelectedDeviceProfile->DeviceID);
 
+	// Pipe I/O is serviced by the software device from this point on.
+	if (Test.UseSimDevice)
+		Sim_Install(&Test);
+
 	// If "NoTestSelect" appears in the command line then don't send the control
 	// messages for selecting the test type.
 	//
@@ -1754,6 +3049,38 @@ int __cdecl main(int argc, char** argv)
 		}
 	}
 
+	// The firmware keeps the target across tests; pace=0 turns it off.
+	if (Test.PaceRate >= 0 && !Test.UseSimDevice)
+	{
+		if (!Bench_SetPacing(Test.InterfaceHandle, (UCHAR)Test.Intf, (UINT)Test.PaceRate * 1024))
+		{
+			CONERR("setting device pacing to %d KB/s! ErrorCode=%08Xh\n\n", Test.PaceRate, GetLastError());
+			goto Done;
+		}
+	}
+
+	// Baseline for the device counters; the first running status shows the change from here.
+	if (Test.DeviceStats)
+	{
+		if (!Bench_GetStats(Test.InterfaceHandle, (UCHAR)Test.Intf, &Test.DeviceStatsLast))
+		{
+			CONWRN("device does not support GET_STATS; devstats disabled. ErrorCode=%08Xh\n", GetLastError());
+			Test.DeviceStats = FALSE;
+		}
+	}
+
+	// The control test has one transfer param on the default pipe; its direction
+	// picks CONTROL_READ or CONTROL_WRITE.
+	//
+	if (Test.TestType == TestTypeControl)
+	{
+		if (Test.ControlWrite)
+			WriteTest = CreateTransferParam(&Test, 0);
+		else
+			ReadTest = CreateTransferParam(&Test, USB_ENDPOINT_DIRECTION_MASK);
+		if (!ReadTest && !WriteTest) goto Done;
+	}
+
 	// If reading from the device create the read transfer param. This will also create
 	// a thread in a suspended state.
 	//
@@ -1920,6 +3247,9 @@ int __cdecl main(int argc, char** argv)
 		else
 			ShowRunningStatus(WriteTest);
 
+		if (Test.DeviceStats)
+			ShowDeviceStats(&Test);
+
 	}
 
 	// Wait for the transfer threads to complete gracefully if it
@@ -1950,6 +3280,9 @@ int __cdecl main(int argc, char** argv)
 	if (ReadTest) ShowTransferInfo(ReadTest);
 	if (WriteTest) ShowTransferInfo(WriteTest);
 
+	if (Test.TraceFile[0] && !Test.UseSimDevice)
+		Trace_Save(&Test);
+
 
 Done:
 	if (Test.InterfaceHandle)
@@ -1997,6 +3330,8 @@ Done:
 	FreeTransferParam(&ReadTest);
 	FreeTransferParam(&WriteTest);
 
+	BmReplay_Free(&Test.Replay);
+
 	DeleteCriticalSection(&DisplayCriticalSection);
 
 	if (!Test.ListDevicesOnly)
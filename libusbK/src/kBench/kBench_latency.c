@@ -0,0 +1,317 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <stdio.h>
+#include <string.h>
+#include "kBench_latency.h"
+
+#ifdef _MSC_VER
+#define snprintf _snprintf
+#endif
+
+static int BmLatency_BucketIndex(unsigned int Us)
+{
+	int msb = 0;
+
+	if (Us < BM_LATENCY_SUB_BUCKETS) return (int)Us;
+
+	while ((Us >> msb) > 1) msb++;
+	return ((msb - 3) * BM_LATENCY_SUB_BUCKETS) + (int)((Us >> (msb - 4)) & (BM_LATENCY_SUB_BUCKETS - 1));
+}
+
+// Returns the largest latency (us) that falls into bucket Index.
+static long long BmLatency_BucketValue(int Index)
+{
+	int shift;
+
+	if (Index < BM_LATENCY_SUB_BUCKETS) return Index;
+
+	shift = (Index / BM_LATENCY_SUB_BUCKETS) - 1;
+	return (((long long)BM_LATENCY_SUB_BUCKETS + (Index % BM_LATENCY_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+void BmLatency_Add(
+    PBM_LATENCY_HISTOGRAM Histogram,
+    long long Us)
+{
+	if (Us < 0) Us = 0;
+	if (Us > 0x7FFFFFFF) Us = 0x7FFFFFFF;
+
+	if (!Histogram->Count || Us < Histogram->MinUs) Histogram->MinUs = (int)Us;
+	if (Us > Histogram->MaxUs) Histogram->MaxUs = (int)Us;
+
+	Histogram->Count++;
+	Histogram->TotalUs += Us;
+	Histogram->Buckets[BmLatency_BucketIndex((unsigned int)Us)]++;
+}
+
+int BmLatency_Percentile(
+    const BM_LATENCY_HISTOGRAM* Histogram,
+    double Percentile)
+{
+	long long target = (long long)((Histogram->Count * Percentile) / 100.0 + 0.5);
+	long long sum = 0;
+	long long value;
+	int index;
+
+	if (!Histogram->Count) return 0;
+	if (target < 1) target = 1;
+
+	for (index = 0; index < BM_LATENCY_BUCKET_COUNT; index++)
+	{
+		sum += Histogram->Buckets[index];
+		if (sum >= target)
+		{
+			value = BmLatency_BucketValue(index);
+			return (value < Histogram->MaxUs) ? (int)value : Histogram->MaxUs;
+		}
+	}
+	return Histogram->MaxUs;
+}
+
+int BmLatency_FormatHistogram(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_LATENCY_HISTOGRAM* Histogram)
+{
+	int length;
+
+	if (!BufferSize) return 0;
+
+	if (!Histogram->Count)
+		length = snprintf(Buffer, BufferSize, "no samples");
+	else
+		length = snprintf(Buffer, BufferSize, "min %d avg %.1f p50 %d p90 %d p99 %d max %d (us)",
+		                  Histogram->MinUs,
+		                  (double)Histogram->TotalUs / (double)Histogram->Count,
+		                  BmLatency_Percentile(Histogram, 50.0),
+		                  BmLatency_Percentile(Histogram, 90.0),
+		                  BmLatency_Percentile(Histogram, 99.0),
+		                  Histogram->MaxUs);
+
+	if (length < 0 || (unsigned int)length >= BufferSize)
+		Buffer[BufferSize - 1] = '\0';
+	return length;
+}
+
+unsigned int BmLatency_Stamp(
+    unsigned char* Data,
+    unsigned int DataLength,
+    unsigned int PacketSize,
+    unsigned int* Sequence,
+    unsigned int HostTimeUs)
+{
+	unsigned int offset;
+	unsigned int count = 0;
+	unsigned char* packet;
+
+	if (PacketSize < BM_LATENCY_STAMP_LENGTH) return 0;
+
+	for (offset = 0; offset + BM_LATENCY_STAMP_LENGTH <= DataLength; offset += PacketSize)
+	{
+		packet = &Data[offset];
+		packet[0] = (unsigned char)*Sequence;
+		packet[1] = (unsigned char)(*Sequence >> 8);
+		packet[2] = (unsigned char)HostTimeUs;
+		packet[3] = (unsigned char)(HostTimeUs >> 8);
+		packet[4] = (unsigned char)(HostTimeUs >> 16);
+		packet[5] = (unsigned char)(HostTimeUs >> 24);
+		packet[6] = 0;
+		packet[7] = 0;
+
+		*Sequence = (*Sequence + 1) & 0xFFFF;
+		count++;
+	}
+	return count;
+}
+
+int BmLatency_Decode(
+    PBM_LATENCY_STAMP Stamp,
+    const unsigned char* Packet,
+    unsigned int PacketLength)
+{
+	if (PacketLength < BM_LATENCY_STAMP_LENGTH)
+		return -1;
+
+	Stamp->Sequence		= (unsigned int)Packet[0] | ((unsigned int)Packet[1] << 8);
+	Stamp->HostTimeUs	= (unsigned int)Packet[2] | ((unsigned int)Packet[3] << 8) | ((unsigned int)Packet[4] << 16) | ((unsigned int)Packet[5] << 24);
+	Stamp->DeviceFrame	= (unsigned int)Packet[6] | ((unsigned int)Packet[7] << 8);
+	return 0;
+}
+
+void BmLatency_SetClock(
+    PBM_LATENCY_CLOCK Clock,
+    unsigned int HostTimeUs,
+    unsigned int Frame,
+    unsigned int WindowUs)
+{
+	// Anywhere in the frame; take the middle.
+	Clock->HostTimeUs	= HostTimeUs;
+	Clock->FrameStartUs	= HostTimeUs - 1000 / 2;
+	Clock->ErrorUs		= (int)((1000 + WindowUs) / 2);
+	Clock->Frame		= Frame;
+	Clock->Valid		= 1;
+}
+
+void BmLatency_SetFrameStart(
+    PBM_LATENCY_CLOCK Clock,
+    unsigned int HostTimeUs,
+    unsigned int Frame)
+{
+	Clock->HostTimeUs	= HostTimeUs;
+	Clock->FrameStartUs	= HostTimeUs;
+	Clock->ErrorUs		= 0;
+	Clock->Frame		= Frame;
+	Clock->Valid		= 1;
+}
+
+void BmLatency_Reset(
+    PBM_LATENCY_RESULT Result)
+{
+	memset(Result, 0, sizeof(*Result));
+}
+
+// Places the device frame on the host clock and splits the round trip time
+// into the two one-way times.
+static void BmLatency_AddOneWay(
+    PBM_LATENCY_RESULT Result,
+    const BM_LATENCY_CLOCK* Clock,
+    const BM_LATENCY_STAMP* Stamp,
+    unsigned int RecvTimeUs)
+{
+	long long sendUs, recvUs, deviceUs, roundTripUs, outUs;
+	long long sendFrame;
+	int delta, halfUnitUs, resolutionUs;
+
+	// Host times relative to the start of the clock frame; signed 32 bit
+	// differences are wrap safe.
+	sendUs = (int)(Stamp->HostTimeUs - Clock->FrameStartUs);
+	recvUs = (int)(RecvTimeUs - Clock->FrameStartUs);
+
+	// The device only has the low 11 bits; take the frame nearest to the one
+	// the packet was sent in.
+	sendFrame = (sendUs >= 0) ? (sendUs / 1000) : -((999 - sendUs) / 1000);
+	delta = (int)((Stamp->DeviceFrame - (Clock->Frame + (unsigned int)sendFrame)) & BM_LATENCY_FRAME_MASK);
+	if (delta > (BM_LATENCY_FRAME_MASK >> 1))
+		delta -= BM_LATENCY_FRAME_MASK + 1;
+
+	// The firmware handled the packet somewhere in its (micro)frame; take the
+	// middle of it, which is off by at most half a frame either way.
+	deviceUs = (sendFrame + delta) * 1000;
+	if (Stamp->DeviceFrame & BM_LATENCY_FRAME_MICROFRAME)
+	{
+		deviceUs += ((Stamp->DeviceFrame & BM_LATENCY_FRAME_MICRO_MASK) >> BM_LATENCY_FRAME_MICRO_SHIFT) * 125;
+		halfUnitUs = 125 / 2;
+	}
+	else
+	{
+		halfUnitUs = 1000 / 2;
+	}
+	deviceUs += halfUnitUs;
+
+	resolutionUs = halfUnitUs + Clock->ErrorUs;
+	if (resolutionUs > Result->ResolutionUs)
+		Result->ResolutionUs = resolutionUs;
+
+	// Both one-way times of a round trip this short are within the error.
+	roundTripUs = recvUs - sendUs;
+	if (roundTripUs < 2 * (long long)resolutionUs)
+	{
+		Result->OneWaySkipped++;
+		return;
+	}
+
+	// The device cannot have seen the packet before it was sent or after it
+	// came back; both one-way times lie within the round trip time and add up
+	// to it.
+	outUs = deviceUs - sendUs;
+	if (outUs < 0) outUs = 0;
+	if (outUs > roundTripUs) outUs = roundTripUs;
+
+	BmLatency_Add(&Result->OutLatency, outUs);
+	BmLatency_Add(&Result->InLatency, roundTripUs - outUs);
+}
+
+unsigned int BmLatency_Echo(
+    PBM_LATENCY_RESULT Result,
+    const BM_LATENCY_CLOCK* Clock,
+    const unsigned char* Data,
+    unsigned int DataLength,
+    unsigned int PacketSize,
+    unsigned int RecvTimeUs)
+{
+	BM_LATENCY_STAMP stamp;
+	unsigned int offset;
+	unsigned int count = 0;
+	unsigned int skipped;
+
+	if (PacketSize < BM_LATENCY_STAMP_LENGTH) return 0;
+
+	for (offset = 0; offset < DataLength; offset += PacketSize)
+	{
+		if (BmLatency_Decode(&stamp, &Data[offset], DataLength - offset) != 0)
+			break;
+
+		Result->Packets++;
+		count++;
+
+		// 16 bit sequence numbers; anything up to half the range ahead is loss.
+		skipped = (stamp.Sequence - Result->NextSequence) & 0xFFFF;
+		if (!Result->Synced || skipped < 0x8000)
+		{
+			if (Result->Synced)
+				Result->Lost += skipped;
+			Result->NextSequence = (stamp.Sequence + 1) & 0xFFFF;
+			Result->Synced = 1;
+		}
+		else
+		{
+			Result->Reordered++;
+		}
+
+		BmLatency_Add(&Result->RoundTrip, (int)(RecvTimeUs - stamp.HostTimeUs));
+
+		if (!(stamp.DeviceFrame & BM_LATENCY_FRAME_STAMPED))
+			Result->Unstamped++;
+		else if (Clock && Clock->Valid)
+			BmLatency_AddOneWay(Result, Clock, &stamp, RecvTimeUs);
+	}
+	return count;
+}
+
+int BmLatency_Format(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_LATENCY_RESULT* Result)
+{
+	int length;
+
+	if (!BufferSize) return 0;
+
+	if (Result->ResolutionUs)
+		length = snprintf(Buffer, BufferSize, "Echoed %u Lost %u Reordered %u Unstamped %u One-way +/-%dus (%u unresolved)",
+		                  Result->Packets, Result->Lost, Result->Reordered, Result->Unstamped, Result->ResolutionUs,
+		                  Result->OneWaySkipped);
+	else
+		length = snprintf(Buffer, BufferSize, "Echoed %u Lost %u Reordered %u Unstamped %u",
+		                  Result->Packets, Result->Lost, Result->Reordered, Result->Unstamped);
+
+	if (length < 0 || (unsigned int)length >= BufferSize)
+		Buffer[BufferSize - 1] = '\0';
+	return length;
+}
@@ -0,0 +1,189 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __KBENCH_LATENCY_H_
+#define __KBENCH_LATENCY_H_
+
+// Benchmark firmware latency test. (TEST_LATENCY)
+//
+// The latency test (0x07) is the loop test with a stamp at the start of
+// every packet. The host writes the first six bytes of each OUT packet, the
+// firmware writes the last two before it echoes the packet on the IN
+// endpoint. The stamp is little-endian:
+//
+//   Offset Size Field
+//   0      2    Sequence      Running packet number; per OUT endpoint.
+//   2      4    HostTimeUs    Host clock (us) when the transfer was submitted.
+//   6      2    DeviceFrame   Bus frame the firmware handled the packet in.
+//
+// DeviceFrame holds the 11 bit frame number in bits 0-10 and, when
+// BM_LATENCY_FRAME_MICROFRAME is set, the high-speed microframe in bits
+// 11-13. The firmware sets BM_LATENCY_FRAME_STAMPED; a packet echoed without
+// it (loop firmware) still gives a round trip time.
+//
+// Packets shorter than BM_LATENCY_STAMP_LENGTH are not stamped. A transfer
+// is stamped at every wMaxPacketSize boundary, so the IN data of a loop
+// device that echoes packet for packet decodes the same way.
+//
+// The round trip time is exact to the host clock. One-way times need the
+// bus frame clock; the host samples (HostTimeUs, frame) pairs and device
+// frames are placed against the latest pair. The firmware only reports the
+// (micro)frame it handled the packet in, so the device time is taken as
+// the middle of that frame and each packet's round trip time is split at
+// that point.
+//
+// The split is good to ResolutionUs either way: half a device (micro)frame
+// plus the error of the clock sample. A frame number read by the host
+// (BmLatency_SetClock) may have been sampled anywhere in its 1 ms frame,
+// which adds another half frame and half the time the read took. A
+// simulated bus that knows its frame starts (BmLatency_SetFrameStart) adds
+// nothing. A round trip shorter than twice the resolution cannot be split
+// into anything meaningful; such packets only count in OneWaySkipped.
+//
+// This file has no Windows dependencies; it is also built by the firmware
+// host simulations (BmFW/*/Sim).
+
+#define BM_LATENCY_TEST_TYPE			0x07
+#define BM_LATENCY_STAMP_LENGTH			8
+#define BM_LATENCY_FRAME_OFFSET			6
+
+#define BM_LATENCY_FRAME_MASK			0x07FF
+#define BM_LATENCY_FRAME_MICRO_SHIFT	11
+#define BM_LATENCY_FRAME_MICRO_MASK		0x3800
+#define BM_LATENCY_FRAME_MICROFRAME		0x4000
+#define BM_LATENCY_FRAME_STAMPED		0x8000
+
+// Log-linear histogram; 16 sub-buckets per power of two (us).
+#define BM_LATENCY_SUB_BUCKETS			16
+#define BM_LATENCY_BUCKET_COUNT			(29 * BM_LATENCY_SUB_BUCKETS)
+
+typedef struct _BM_LATENCY_HISTOGRAM
+{
+	long long Count;
+	long long TotalUs;
+	int MinUs;
+	int MaxUs;
+	unsigned int Buckets[BM_LATENCY_BUCKET_COUNT];
+} BM_LATENCY_HISTOGRAM, *PBM_LATENCY_HISTOGRAM;
+
+// Host time and bus frame sampled together.
+typedef struct _BM_LATENCY_CLOCK
+{
+	unsigned int HostTimeUs;			// When the pair was sampled.
+	unsigned int FrameStartUs;			// Estimated host time Frame started at.
+	int ErrorUs;						// FrameStartUs is +/- this much.
+	unsigned int Frame;
+	int Valid;
+} BM_LATENCY_CLOCK, *PBM_LATENCY_CLOCK;
+
+typedef struct _BM_LATENCY_STAMP
+{
+	unsigned int Sequence;
+	unsigned int HostTimeUs;
+	unsigned int DeviceFrame;
+} BM_LATENCY_STAMP, *PBM_LATENCY_STAMP;
+
+// Echoed packets of one IN endpoint.
+typedef struct _BM_LATENCY_RESULT
+{
+	BM_LATENCY_HISTOGRAM RoundTrip;
+	BM_LATENCY_HISTOGRAM OutLatency;	// Host submit to the middle of the device frame.
+	BM_LATENCY_HISTOGRAM InLatency;		// Round trip less OutLatency.
+	int ResolutionUs;					// One-way times are +/- this much; 0 if none.
+	unsigned int OneWaySkipped;			// Round trip under twice ResolutionUs; not split.
+
+	unsigned int Packets;
+	unsigned int Lost;					// Sequence numbers skipped.
+	unsigned int Reordered;				// Sequence numbers older than the last one.
+	unsigned int Unstamped;				// Echoed without a device frame.
+
+	unsigned int NextSequence;
+	int Synced;							// NextSequence is valid.
+} BM_LATENCY_RESULT, *PBM_LATENCY_RESULT;
+
+// Adds a sample; negative values count as 0.
+void BmLatency_Add(
+    PBM_LATENCY_HISTOGRAM Histogram,
+    long long Us);
+
+// Returns the latency (us) at Percentile (0-100) or 0 if the histogram is
+// empty.
+int BmLatency_Percentile(
+    const BM_LATENCY_HISTOGRAM* Histogram,
+    double Percentile);
+
+// Formats a one line summary of Histogram. Returns the snprintf result.
+int BmLatency_FormatHistogram(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_LATENCY_HISTOGRAM* Histogram);
+
+// Stamps the packets of a transfer; the DeviceFrame field is cleared.
+// *Sequence is advanced for every stamped packet. Returns the number of
+// packets stamped.
+unsigned int BmLatency_Stamp(
+    unsigned char* Data,
+    unsigned int DataLength,
+    unsigned int PacketSize,
+    unsigned int* Sequence,
+    unsigned int HostTimeUs);
+
+// Decodes the stamp of one packet. Returns 0 on success or -1 if the
+// packet is too short.
+int BmLatency_Decode(
+    PBM_LATENCY_STAMP Stamp,
+    const unsigned char* Packet,
+    unsigned int PacketLength);
+
+// Sets the clock from a frame number the host read in the WindowUs long
+// window centered on HostTimeUs.
+void BmLatency_SetClock(
+    PBM_LATENCY_CLOCK Clock,
+    unsigned int HostTimeUs,
+    unsigned int Frame,
+    unsigned int WindowUs);
+
+// Sets the clock from the exact host time Frame started at.
+void BmLatency_SetFrameStart(
+    PBM_LATENCY_CLOCK Clock,
+    unsigned int HostTimeUs,
+    unsigned int Frame);
+
+// Clears the counters and histograms of Result.
+void BmLatency_Reset(
+    PBM_LATENCY_RESULT Result);
+
+// Adds the packets of an echoed transfer received at RecvTimeUs. Clock may
+// be NULL or not valid; only round trip times are taken then. Returns the
+// number of packets decoded.
+unsigned int BmLatency_Echo(
+    PBM_LATENCY_RESULT Result,
+    const BM_LATENCY_CLOCK* Clock,
+    const unsigned char* Data,
+    unsigned int DataLength,
+    unsigned int PacketSize,
+    unsigned int RecvTimeUs);
+
+// Formats a one line summary of the packet counters. Returns the snprintf
+// result.
+int BmLatency_Format(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_LATENCY_RESULT* Result);
+
+#endif
@@ -0,0 +1,244 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "kBench_replay.h"
+
+const char* BmReplay_OpNames[] = {"read", "write", "control", NULL};
+
+// Returns the next blank separated token of *Line or NULL.
+static char* BmReplay_Token(char** Line)
+{
+	char* token = *Line;
+
+	while (*token == ' ' || *token == '\t' || *token == '\r' || *token == '\n') token++;
+	if (!*token) return NULL;
+
+	*Line = token;
+	while (**Line && **Line != ' ' && **Line != '\t' && **Line != '\r' && **Line != '\n') (*Line)++;
+	if (**Line) *(*Line)++ = '\0';
+
+	return token;
+}
+
+// Parses a non-negative decimal number; the whole string must be used.
+static int BmReplay_ParseInt(const char* Text, const char** End, int* Value)
+{
+	long long value = 0;
+
+	if (!isdigit((unsigned char)*Text)) return 0;
+	while (isdigit((unsigned char)*Text))
+	{
+		value = (value * 10) + (*Text++ - '0');
+		if (value > 0x7FFFFFFF) return 0;
+	}
+
+	*Value = (int)value;
+	*End = Text;
+	return 1;
+}
+
+static int BmReplay_ParseRange(const char* Token, int* MinValue, int* MaxValue)
+{
+	const char* end;
+
+	if (!BmReplay_ParseInt(Token, &end, MinValue)) return 0;
+	*MaxValue = *MinValue;
+
+	if (*end == '-')
+	{
+		if (!BmReplay_ParseInt(end + 1, &end, MaxValue)) return 0;
+	}
+
+	return (*end == '\0' && *MaxValue >= *MinValue);
+}
+
+static int BmReplay_ParseSetting(const char* Token, const char* Name, int* Value)
+{
+	size_t length = strlen(Name);
+	const char* end;
+
+	if (strncmp(Token, Name, length)) return 0;
+	if (!BmReplay_ParseInt(Token + length, &end, Value) || *end) return -1;
+	return 1;
+}
+
+void BmReplay_Init(
+    PBM_REPLAY_PROFILE Profile)
+{
+	memset(Profile, 0, sizeof(*Profile));
+	Profile->Seed = 1;
+	Profile->Passes = 1;
+}
+
+void BmReplay_Free(
+    PBM_REPLAY_PROFILE Profile)
+{
+	free(Profile->Steps);
+	BmReplay_Init(Profile);
+}
+
+int BmReplay_ParseLine(
+    PBM_REPLAY_PROFILE Profile,
+    char* Line)
+{
+	char* token;
+	char* pos;
+	const char* end;
+	int value;
+	int result;
+	PBM_REPLAY_STEP steps;
+	BM_REPLAY_STEP step;
+
+	if ((pos = strchr(Line, '#')) != NULL) *pos = '\0';
+	for (pos = Line; *pos; pos++) *pos = (char)tolower((unsigned char)*pos);
+
+	pos = Line;
+	if ((token = BmReplay_Token(&pos)) == NULL) return BM_REPLAY_LINE_NONE;
+
+	if ((result = BmReplay_ParseSetting(token, "seed=", &value)) != 0)
+	{
+		if (result < 0) return BM_REPLAY_LINE_INVALID;
+		Profile->Seed = (unsigned int)value;
+		return BM_REPLAY_LINE_NONE;
+	}
+	if ((result = BmReplay_ParseSetting(token, "concurrency=", &Profile->Concurrency)) != 0)
+		return result < 0 ? BM_REPLAY_LINE_INVALID : BM_REPLAY_LINE_NONE;
+	if ((result = BmReplay_ParseSetting(token, "passes=", &Profile->Passes)) != 0)
+		return result < 0 ? BM_REPLAY_LINE_INVALID : BM_REPLAY_LINE_NONE;
+
+	memset(&step, 0, sizeof(step));
+	step.Repeat = 1;
+
+	if (!strcmp(token, "read"))
+		step.Op = BM_REPLAY_OP_READ;
+	else if (!strcmp(token, "write"))
+		step.Op = BM_REPLAY_OP_WRITE;
+	else if (!strcmp(token, "control"))
+		step.Op = BM_REPLAY_OP_CONTROL;
+	else
+		return BM_REPLAY_LINE_INVALID;
+
+	token = BmReplay_Token(&pos);
+	if (!token || !BmReplay_ParseRange(token, &step.MinLength, &step.MaxLength))
+		return BM_REPLAY_LINE_INVALID;
+
+	if ((token = BmReplay_Token(&pos)) != NULL)
+	{
+		if (!BmReplay_ParseRange(token, &step.MinDelay, &step.MaxDelay))
+			return BM_REPLAY_LINE_INVALID;
+
+		if ((token = BmReplay_Token(&pos)) != NULL)
+		{
+			if (!BmReplay_ParseInt(token, &end, &step.Repeat) || *end || step.Repeat < 1)
+				return BM_REPLAY_LINE_INVALID;
+		}
+	}
+	if (BmReplay_Token(&pos)) return BM_REPLAY_LINE_INVALID;
+
+	steps = realloc(Profile->Steps, (Profile->StepCount + 1) * sizeof(BM_REPLAY_STEP));
+	if (!steps) return BM_REPLAY_LINE_NO_MEMORY;
+
+	Profile->Steps = steps;
+	steps[Profile->StepCount++] = step;
+
+	if (step.Op == BM_REPLAY_OP_WRITE)
+	{
+		if (step.MaxLength > Profile->MaxWriteLength) Profile->MaxWriteLength = step.MaxLength;
+		Profile->HasWrites = 1;
+	}
+	else
+	{
+		if (step.Op == BM_REPLAY_OP_READ && step.MaxLength > Profile->MaxReadLength)
+			Profile->MaxReadLength = step.MaxLength;
+		Profile->HasReads = 1;
+	}
+
+	return BM_REPLAY_LINE_STEP;
+}
+
+static int BmReplay_Range(unsigned int* Random, int MinValue, int MaxValue)
+{
+	unsigned int value;
+
+	if (MaxValue <= MinValue) return MinValue;
+
+	// 30 bits from two rounds of the C runtime LCG; identical on every run.
+	*Random = (*Random * 1103515245) + 12345;
+	value = (*Random >> 16) & 0x7FFF;
+	*Random = (*Random * 1103515245) + 12345;
+	value = (value << 15) | ((*Random >> 16) & 0x7FFF);
+
+	return MinValue + (int)(value % ((unsigned int)(MaxValue - MinValue) + 1));
+}
+
+void BmReplay_Start(
+    const BM_REPLAY_PROFILE* Profile,
+    PBM_REPLAY_CURSOR Cursor)
+{
+	memset(Cursor, 0, sizeof(*Cursor));
+	Cursor->Random = Profile->Seed;
+	Cursor->Done = !Profile->StepCount;
+}
+
+int BmReplay_Next(
+    const BM_REPLAY_PROFILE* Profile,
+    PBM_REPLAY_CURSOR Cursor,
+    BM_REPLAY_OP* Op,
+    int* Length)
+{
+	const BM_REPLAY_STEP* step;
+
+	if (Cursor->Done) return 0;
+
+	if (Cursor->Step >= Profile->StepCount)
+	{
+		Cursor->Step = 0;
+		if (Profile->Passes && ++Cursor->Pass >= Profile->Passes)
+		{
+			Cursor->Done = 1;
+			return 0;
+		}
+	}
+
+	step = &Profile->Steps[Cursor->Step];
+
+	*Op = step->Op;
+	Cursor->DueUs += BmReplay_Range(&Cursor->Random, step->MinDelay, step->MaxDelay);
+	*Length = BmReplay_Range(&Cursor->Random, step->MinLength, step->MaxLength);
+
+	if (++Cursor->Repeat >= step->Repeat)
+	{
+		Cursor->Repeat = 0;
+		Cursor->Step++;
+	}
+	return 1;
+}
+
+int BmReplay_IsOwner(
+    const BM_REPLAY_PROFILE* Profile,
+    BM_REPLAY_OP Op,
+    int IsReadPipe)
+{
+	if (Op == BM_REPLAY_OP_CONTROL)
+		return IsReadPipe || !Profile->HasReads;
+
+	return (Op == BM_REPLAY_OP_READ) == (IsReadPipe ? 1 : 0);
+}
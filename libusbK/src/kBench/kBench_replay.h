@@ -0,0 +1,129 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __KBENCH_REPLAY_H_
+#define __KBENCH_REPLAY_H_
+
+// Workload profiles. (kBench profile=<file>)
+//
+// Profile file format (one entry per line, '#' starts a comment):
+//   seed=<n>           Random seed for length/delay ranges. (default 1)
+//   concurrency=<n>    Number of outstanding transfers per pipe.
+//   passes=<n>         Number of times to replay the profile. (0=until 'Q')
+//   <read|write|control> <length>[-<max>] [<delay-us>[-<max>]] [<repeat>]
+//
+// Settings may appear anywhere in the file; the libusbK workload capture
+// (LIBUSBK_CAPTURE) writes its concurrency= line last.
+//
+// Every transfer thread walks the complete profile with its own cursor and
+// the same seed, so the direction mix and inter-arrival times stay on one
+// timeline; each thread only issues the steps it owns (BmReplay_IsOwner).
+// Due times are kept in microseconds from the start of the replay so the
+// sequence does not depend on the host clock.
+//
+// This file has no Windows dependencies; it is also built by the replay
+// host simulation (kBench/Sim).
+
+typedef enum _BM_REPLAY_OP
+{
+    BM_REPLAY_OP_READ,
+    BM_REPLAY_OP_WRITE,
+
+    // Replayed as a GET_TEST request; only the request rate and latency are modeled.
+    BM_REPLAY_OP_CONTROL,
+} BM_REPLAY_OP;
+
+// One line of a workload profile. Lengths and delays are picked uniformly
+// from [Min,Max] with the profile seed.
+typedef struct _BM_REPLAY_STEP
+{
+	BM_REPLAY_OP Op;
+	int MinLength;
+	int MaxLength;
+	int MinDelay;		// Inter-arrival time (us) from the previous step.
+	int MaxDelay;
+	int Repeat;
+} BM_REPLAY_STEP, *PBM_REPLAY_STEP;
+
+typedef struct _BM_REPLAY_PROFILE
+{
+	PBM_REPLAY_STEP Steps;
+	int StepCount;
+	unsigned int Seed;
+	int Concurrency;	// Overrides BufferCount when non-zero.
+	int Passes;			// Number of times the profile is replayed. (0=until the user quits)
+	int MaxReadLength;
+	int MaxWriteLength;
+	int HasReads;		// Includes control steps.
+	int HasWrites;
+} BM_REPLAY_PROFILE, *PBM_REPLAY_PROFILE;
+
+// Position of one transfer thread in the profile.
+typedef struct _BM_REPLAY_CURSOR
+{
+	int Step;
+	int Repeat;
+	int Pass;
+	unsigned int Random;
+	long long DueUs;	// Due time of the last step returned by BmReplay_Next.
+	int Done;
+} BM_REPLAY_CURSOR, *PBM_REPLAY_CURSOR;
+
+// BmReplay_ParseLine results.
+#define BM_REPLAY_LINE_NONE		0	// Blank, comment or setting.
+#define BM_REPLAY_LINE_STEP		1
+#define BM_REPLAY_LINE_INVALID	-1
+#define BM_REPLAY_LINE_NO_MEMORY	-2
+
+extern const char* BmReplay_OpNames[];
+
+// Sets the profile defaults (seed 1, one pass, no steps).
+void BmReplay_Init(
+    PBM_REPLAY_PROFILE Profile);
+
+// Frees the steps of Profile and re-initializes it.
+void BmReplay_Free(
+    PBM_REPLAY_PROFILE Profile);
+
+// Parses one line of a profile file. Line is modified.
+int BmReplay_ParseLine(
+    PBM_REPLAY_PROFILE Profile,
+    char* Line);
+
+// Positions Cursor at the first step of the first pass.
+void BmReplay_Start(
+    const BM_REPLAY_PROFILE* Profile,
+    PBM_REPLAY_CURSOR Cursor);
+
+// Moves Cursor to the next step and returns its operation and length.
+// Cursor->DueUs is advanced by the step's inter-arrival time. Returns 0
+// when all passes are done.
+int BmReplay_Next(
+    const BM_REPLAY_PROFILE* Profile,
+    PBM_REPLAY_CURSOR Cursor,
+    BM_REPLAY_OP* Op,
+    int* Length);
+
+// Returns non-zero if the thread for a pipe issues Op. Control steps are
+// issued by the read thread, or the write thread in a write-only test.
+int BmReplay_IsOwner(
+    const BM_REPLAY_PROFILE* Profile,
+    BM_REPLAY_OP Op,
+    int IsReadPipe);
+
+#endif
@@ -0,0 +1,158 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <stdio.h>
+#include <string.h>
+#include "kBench_stats.h"
+
+#ifdef _MSC_VER
+#define snprintf _snprintf
+#endif
+
+static unsigned int BmStats_GetLE32(const unsigned char* Data)
+{
+	return (unsigned int)Data[0] | ((unsigned int)Data[1] << 8) | ((unsigned int)Data[2] << 16) | ((unsigned int)Data[3] << 24);
+}
+
+static void BmStats_SetLE32(unsigned char* Data, unsigned int Value)
+{
+	Data[0] = (unsigned char)Value;
+	Data[1] = (unsigned char)(Value >> 8);
+	Data[2] = (unsigned char)(Value >> 16);
+	Data[3] = (unsigned char)(Value >> 24);
+}
+
+int BmStats_Decode(
+    PBM_DEVICE_STATS Stats,
+    const unsigned char* Data,
+    unsigned int DataLength)
+{
+	unsigned int counters[10];
+	unsigned int length;
+	unsigned int i;
+
+	memset(Stats, 0, sizeof(*Stats));
+
+	if (DataLength < BM_STATS_HEADER_LENGTH)
+		return -1;
+
+	length = Data[0];
+	if (length < BM_STATS_HEADER_LENGTH || length > DataLength || Data[1] != BM_STATS_VERSION)
+		return -1;
+
+	// Newer firmware may append counters; only the known ones are read.
+	memset(counters, 0, sizeof(counters));
+	for (i = 0; i < sizeof(counters) / sizeof(counters[0]) && BM_STATS_HEADER_LENGTH + (i + 1) * 4 <= length; i++)
+		counters[i] = BmStats_GetLE32(&Data[BM_STATS_HEADER_LENGTH + i * 4]);
+
+	Stats->Length		= length;
+	Stats->Version		= Data[1];
+	Stats->Flags		= (unsigned int)Data[2] | ((unsigned int)Data[3] << 8);
+	Stats->Transfers[0]	= counters[0];
+	Stats->Transfers[1]	= counters[1];
+	Stats->Bytes[0]		= counters[2];
+	Stats->Bytes[1]		= counters[3];
+	Stats->Starved[0]	= counters[4];
+	Stats->Starved[1]	= counters[5];
+	Stats->Sofs			= counters[6];
+	Stats->MissedSofs	= counters[7];
+
+	return 0;
+}
+
+unsigned int BmStats_Encode(
+    const BM_DEVICE_STATS* Stats,
+    unsigned char* Data,
+    unsigned int DataLength)
+{
+	if (DataLength < BM_STATS_LENGTH)
+		return 0;
+
+	Data[0] = BM_STATS_LENGTH;
+	Data[1] = BM_STATS_VERSION;
+	Data[2] = (unsigned char)Stats->Flags;
+	Data[3] = (unsigned char)(Stats->Flags >> 8);
+	BmStats_SetLE32(&Data[4], Stats->Transfers[0]);
+	BmStats_SetLE32(&Data[8], Stats->Transfers[1]);
+	BmStats_SetLE32(&Data[12], Stats->Bytes[0]);
+	BmStats_SetLE32(&Data[16], Stats->Bytes[1]);
+	BmStats_SetLE32(&Data[20], Stats->Starved[0]);
+	BmStats_SetLE32(&Data[24], Stats->Starved[1]);
+	BmStats_SetLE32(&Data[28], Stats->Sofs);
+	BmStats_SetLE32(&Data[32], Stats->MissedSofs);
+
+	return BM_STATS_LENGTH;
+}
+
+void BmStats_Delta(
+    PBM_DEVICE_STATS Delta,
+    const BM_DEVICE_STATS* Now,
+    const BM_DEVICE_STATS* Prev)
+{
+	int i;
+
+	Delta->Length	= Now->Length;
+	Delta->Version	= Now->Version;
+	Delta->Flags	= Now->Flags;
+
+	// Unsigned subtraction; a counter that wrapped once still gives the right delta.
+	for (i = 0; i < 2; i++)
+	{
+		Delta->Transfers[i]	= Now->Transfers[i] - Prev->Transfers[i];
+		Delta->Bytes[i]		= Now->Bytes[i] - Prev->Bytes[i];
+		Delta->Starved[i]	= Now->Starved[i] - Prev->Starved[i];
+	}
+	Delta->Sofs			= Now->Sofs - Prev->Sofs;
+	Delta->MissedSofs	= Now->MissedSofs - Prev->MissedSofs;
+}
+
+int BmStats_Format(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_DEVICE_STATS* Delta)
+{
+	int length;
+	int total;
+
+	if (!BufferSize) return 0;
+
+	length = snprintf(Buffer, BufferSize, "Device: Out %u (%u bytes) In %u (%u bytes) %s %u/%u",
+	                  Delta->Transfers[BM_STATS_OUT], Delta->Bytes[BM_STATS_OUT],
+	                  Delta->Transfers[BM_STATS_IN], Delta->Bytes[BM_STATS_IN],
+	                  (Delta->Flags & BM_STATS_FLAG_NAK_FLAGS) ? "NAKed Out/In" : "Starved Out/In",
+	                  Delta->Starved[BM_STATS_OUT], Delta->Starved[BM_STATS_IN]);
+	if (length < 0 || (unsigned int)length >= BufferSize)
+	{
+		Buffer[BufferSize - 1] = '\0';
+		return length;
+	}
+	total = length;
+
+	if (Delta->Flags & BM_STATS_FLAG_SOFS)
+	{
+		length = snprintf(&Buffer[total], BufferSize - total, " SOFs %u Missed %u", Delta->Sofs, Delta->MissedSofs);
+		if (length < 0 || (unsigned int)length >= BufferSize - total)
+		{
+			Buffer[BufferSize - 1] = '\0';
+			return length < 0 ? length : total + length;
+		}
+		total += length;
+	}
+
+	return total;
+}
@@ -0,0 +1,111 @@
+/*!********************************************************************
+libusbK - kBench USB benchmark/diagnostic tool.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __KBENCH_STATS_H_
+#define __KBENCH_STATS_H_
+
+// Benchmark firmware statistics. (GET_STATS vendor request)
+//
+// GET_STATS (0x12) is a device to host vendor request; wIndex selects the
+// interface. The firmware answers with a fixed layout, little-endian counter
+// block:
+//
+//   Offset Size Field
+//   0      1    Length        Bytes in the block. (BM_STATS_LENGTH)
+//   1      1    Version       BM_STATS_VERSION
+//   2      2    Flags         BM_STATS_FLAG_*
+//   4      4    Transfers[0]  OUT (host to device) transfers taken by the firmware.
+//   8      4    Transfers[1]  IN (device to host) transfers completed.
+//   12     4    Bytes[0]      OUT bytes.
+//   16     4    Bytes[1]      IN bytes.
+//   20     4    Starved[0]    Times the OUT endpoint had no free buffer.
+//   24     4    Starved[1]    Times the IN endpoint had no armed buffer.
+//   28     4    Sofs          Start of frames seen by the firmware.
+//   32     4    MissedSofs    Frames the firmware did not see an SOF for.
+//
+// A transfer is the unit the firmware queues on the endpoint; one packet on
+// the Microchip and LUFA firmware, up to BM_MAX_TRANSFER_SIZE on the ASF
+// firmware. A starved endpoint is NAKed (iso data is lost) until the
+// firmware services it again, so the starved counters tell whether a slow
+// test is held up by the device or by the host.
+//
+// Counters are free running and wrap; SET_TEST clears the counters of the
+// interface it selects. Blocks shorter than BM_STATS_LENGTH are accepted if
+// they hold the header; the missing counters read as zero.
+//
+// This file has no Windows dependencies; it is also built by the firmware
+// host simulations (BmFW/*/Sim).
+
+#define BM_STATS_REQUEST		0x12
+#define BM_STATS_VERSION		1
+#define BM_STATS_LENGTH			36
+#define BM_STATS_HEADER_LENGTH	4
+
+// Sofs and MissedSofs are maintained.
+#define BM_STATS_FLAG_SOFS		0x0001
+
+// The starved counters are the controller's NAK flags rather than the
+// firmware's buffer state.
+#define BM_STATS_FLAG_NAK_FLAGS	0x0002
+
+// Transfers, Bytes and Starved index.
+#define BM_STATS_OUT			0
+#define BM_STATS_IN				1
+
+typedef struct _BM_DEVICE_STATS
+{
+	unsigned int Length;
+	unsigned int Version;
+	unsigned int Flags;
+
+	unsigned int Transfers[2];
+	unsigned int Bytes[2];
+	unsigned int Starved[2];
+	unsigned int Sofs;
+	unsigned int MissedSofs;
+} BM_DEVICE_STATS, *PBM_DEVICE_STATS;
+
+// Decodes a counter block received from the device. Returns 0 on success or
+// -1 if the block is shorter than its header, shorter than its own Length
+// field or of an unknown version.
+int BmStats_Decode(
+    PBM_DEVICE_STATS Stats,
+    const unsigned char* Data,
+    unsigned int DataLength);
+
+// Encodes a counter block; returns the number of bytes written
+// (BM_STATS_LENGTH) or 0 if DataLength is too small.
+unsigned int BmStats_Encode(
+    const BM_DEVICE_STATS* Stats,
+    unsigned char* Data,
+    unsigned int DataLength);
+
+// Counter changes from Prev to Now. (wrap safe)
+void BmStats_Delta(
+    PBM_DEVICE_STATS Delta,
+    const BM_DEVICE_STATS* Now,
+    const BM_DEVICE_STATS* Prev);
+
+// Formats a one line summary of Delta; counters the device does not
+// maintain are left out. Returns the snprintf result.
+int BmStats_Format(
+    char* Buffer,
+    unsigned int BufferSize,
+    const BM_DEVICE_STATS* Delta);
+
+#endif
@@ -0,0 +1,248 @@
+/*!********************************************************************
+libusbK - kTrace driver trace decoder.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Decodes libusbK driver trace dumps ("kBench trace=<file>").
+//
+// The driver writes binary records only; the event names and format strings
+// are taken from sys/drv_trace_events.h when kTrace is built, so kTrace must
+// be built from the same source as the driver that produced the dump.
+//
+// kTrace uses standard C only and builds on any host, e.g.:
+//   cc -I../sys -o ktrace kTrace.c ../sys/drv_trace_ring.c
+//   cl /I..\sys kTrace.c ..\sys\drv_trace_ring.c
+//
+// USAGE: kTrace decode <file>
+//        kTrace bench [events]
+//
+//   decode : Prints the events of a dump, merged from all processors in
+//            timestamp order. Times are microseconds from the first event.
+//   bench  : Measures the cost per event of writing a trace record and of
+//            formatting the same event as text.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "drv_trace_ring.h"
+
+typedef struct _KTRACE_EVENT_INFO
+{
+	const char* Name;
+	const char* Format;
+} KTRACE_EVENT_INFO;
+
+static const KTRACE_EVENT_INFO EventTable[] =
+{
+#define KTRACE_EVENT(Name, Format) { #Name, Format },
+#include "drv_trace_events.h"
+#undef KTRACE_EVENT
+};
+
+#define EVENT_COUNT (sizeof(EventTable) / sizeof(EventTable[0]))
+
+static void ShowUsage(void)
+{
+	printf("USAGE: kTrace decode <file>\n");
+	printf("       kTrace bench [events]\n");
+}
+
+static int CompareRecords(const void* a, const void* b)
+{
+	const KTRACE_RECORD* r1 = (const KTRACE_RECORD*)a;
+	const KTRACE_RECORD* r2 = (const KTRACE_RECORD*)b;
+
+	if (r1->Timestamp != r2->Timestamp) return r1->Timestamp < r2->Timestamp ? -1 : 1;
+	if (r1->Cpu != r2->Cpu) return r1->Cpu < r2->Cpu ? -1 : 1;
+	if (r1->Sequence != r2->Sequence) return r1->Sequence < r2->Sequence ? -1 : 1;
+	return 0;
+}
+
+static void PrintRecord(const KTRACE_RECORD* record, long long firstTimestamp, long long frequency)
+{
+	double us = (double)(record->Timestamp - firstTimestamp) * 1000000.0 / (double)frequency;
+
+	printf("%14.3f cpu%-3u ", us, record->Cpu);
+
+	if (record->EventId < EVENT_COUNT)
+	{
+		printf("%-18s ", EventTable[record->EventId].Name);
+		printf(EventTable[record->EventId].Format, record->Args[0], record->Args[1], record->Args[2], record->Args[3]);
+	}
+	else
+	{
+		printf("EVENT_%-12u %08Xh %08Xh %08Xh %08Xh",
+		       record->EventId, record->Args[0], record->Args[1], record->Args[2], record->Args[3]);
+	}
+	printf("\n");
+}
+
+static int Decode(const char* fileName)
+{
+	FILE* file;
+	KTRACE_DUMP_HEADER header;
+	KTRACE_RECORD* records = NULL;
+	unsigned int pos;
+	int ret = -1;
+
+	file = fopen(fileName, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "failed opening %s\n", fileName);
+		return -1;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	        header.Magic != KTRACE_DUMP_MAGIC)
+	{
+		fprintf(stderr, "%s is not a libusbK trace dump.\n", fileName);
+		goto Done;
+	}
+	if (header.Version != KTRACE_DUMP_VERSION || header.RecordSize != sizeof(KTRACE_RECORD))
+	{
+		fprintf(stderr, "unsupported trace dump version %u (record size %u).\n", header.Version, header.RecordSize);
+		goto Done;
+	}
+	if (!header.Frequency)
+	{
+		fprintf(stderr, "invalid trace dump timestamp frequency.\n");
+		goto Done;
+	}
+
+	if (header.RecordCount)
+	{
+		records = (KTRACE_RECORD*)malloc(header.RecordCount * sizeof(KTRACE_RECORD));
+		if (!records)
+		{
+			fprintf(stderr, "out of memory.\n");
+			goto Done;
+		}
+		if (fread(records, sizeof(KTRACE_RECORD), header.RecordCount, file) != header.RecordCount)
+		{
+			fprintf(stderr, "%s is truncated.\n", fileName);
+			goto Done;
+		}
+	}
+
+	// Records are grouped by processor; merge them.
+	qsort(records, header.RecordCount, sizeof(KTRACE_RECORD), CompareRecords);
+
+	printf("# %u events, %u lost, %lld ticks/s\n", header.RecordCount, header.Lost, header.Frequency);
+	for (pos = 0; pos < header.RecordCount; pos++)
+		PrintRecord(&records[pos], records[0].Timestamp, header.Frequency);
+
+	ret = 0;
+
+Done:
+	free(records);
+	fclose(file);
+	return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// bench
+//
+
+static long long Bench_Now(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+static double Bench_Ns(long long elapsed)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (double)elapsed * 1000000000.0 / (double)frequency.QuadPart;
+#else
+	return (double)elapsed;
+#endif
+}
+
+#define BENCH_RING_RECORDS 1024
+
+static int Bench(unsigned int events)
+{
+	static KTRACE_RECORD records[BENCH_RING_RECORDS];
+	static KTRACE_RECORD snapshot[BENCH_RING_RECORDS];
+	KTRACE_RING ring;
+	char text[256];
+	unsigned int pos;
+	unsigned int kept;
+	unsigned int lost = 0;
+	size_t textLength = 0;
+	long long start;
+	double traceNs, textNs;
+
+	TraceRing_Init(&ring, records, BENCH_RING_RECORDS);
+
+	// The driver takes a timestamp for every event; so does the benchmark.
+	start = Bench_Now();
+	for (pos = 0; pos < events; pos++)
+		TraceRing_Write(&ring, 0, 11, Bench_Now(), 0x81, pos, pos * 4096, 4096);
+	traceNs = Bench_Ns(Bench_Now() - start) / events;
+
+	// What USBMSG does before the text is handed to the debugger.
+	start = Bench_Now();
+	for (pos = 0; pos < events; pos++)
+	{
+		textLength += (size_t)snprintf(text, sizeof(text), "[%s] PipeID=%02Xh Stage=%u Offset=%u Staging=%u\n",
+		                               "Xfer_PipelineStage", 0x81, pos, pos * 4096, 4096);
+	}
+	textNs = Bench_Ns(Bench_Now() - start) / events;
+
+	kept = TraceRing_Snapshot(&ring, snapshot, BENCH_RING_RECORDS, &lost);
+
+	printf("events        : %u\n", events);
+	printf("trace record  : %8.1f ns/event (%u kept, %u overwritten)\n", traceNs, kept, lost);
+	printf("text format   : %8.1f ns/event (%lu chars)\n", textNs, (unsigned long)textLength);
+	printf("ratio         : %8.1fx\n", traceNs > 0 ? textNs / traceNs : 0.0);
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int events = 10000000;
+
+	if (argc >= 3 && !strcmp(argv[1], "decode"))
+		return Decode(argv[2]);
+
+	if (argc >= 2 && !strcmp(argv[1], "bench"))
+	{
+		if (argc >= 3) events = (unsigned int)strtoul(argv[2], NULL, 0);
+		if (!events) events = 1;
+		return Bench(events);
+	}
+
+	ShowUsage();
+	return -1;
+}
@@ -809,6 +809,114 @@ KUSB_EXP BOOL KUSB_API UsbK_GetCurrentFrameNumber(
 	return success;
 }
 
+KUSB_EXP BOOL KUSB_API UsbK_GetPipeStats(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats)
+{
+	libusb_request request;
+	PKUSB_HANDLE_INTERNAL handle;
+	BOOL success;
+
+	ErrorParamAction(!Stats, "Stats", return FALSE);
+
+	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
+	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
+
+	Mem_Zero(&request, sizeof(request));
+	request.endpoint.endpoint = PipeID;
+
+	success = Ioctl_Sync(Dev_Handle(), LIBUSBK_IOCTL_GET_PIPE_STATS,
+	                     &request, sizeof(request),
+	                     Stats, sizeof(*Stats),
+	                     NULL);
+
+	PoolHandle_Dec_UsbK(handle);
+	return success;
+}
+
+KUSB_EXP BOOL KUSB_API UsbK_SubmitBatch(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped)
+{
+	libusb_request request;
+	PKUSB_HANDLE_INTERNAL handle;
+	BOOL success;
+	UINT entryIndex;
+	LONGLONG submitTime = 0;
+
+	ErrorParamAction(!Entries, "Entries", return FALSE);
+	ErrorParamAction(!EntryCount || EntryCount > KUSB_BATCH_MAX_ENTRIES, "EntryCount", return FALSE);
+	ErrorParamAction(!IsHandleValid(Overlapped), "Overlapped", return FALSE);
+
+	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
+	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
+
+	for (entryIndex = 0; entryIndex < EntryCount; entryIndex++)
+		submitTime = Capture_Submit(PipeID, Entries[entryIndex].Length, Overlapped);
+
+	Mem_Zero(&request, sizeof(request));
+	request.Batch.PipeID		= PipeID;
+	request.Batch.EntryCount	= EntryCount;
+	request.Batch.Entries		= Entries;
+
+	success = Ioctl_Async(Dev_Handle(),
+	                      USB_ENDPOINT_DIRECTION_IN(PipeID) ? LIBUSBK_IOCTL_BATCH_READ : LIBUSBK_IOCTL_BATCH_WRITE,
+	                      &request, sizeof(request),
+	                      Buffer, BufferLength,
+	                      Overlapped);
+	Capture_SubmitResult(Overlapped, PipeID, submitTime, success, NULL);
+
+	PoolHandle_Dec_UsbK(handle);
+	return success;
+}
+
+KUSB_EXP BOOL KUSB_API UsbK_ReadPackets(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped)
+{
+	libusb_request request;
+	PKUSB_HANDLE_INTERNAL handle;
+	BOOL success;
+
+	ErrorParamAction(!Buffer || BufferLength < sizeof(KUSB_PACKET_HEADER), "Buffer", return FALSE);
+
+	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
+	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
+
+	Mem_Zero(&request, sizeof(request));
+	request.endpoint.endpoint = PipeID;
+
+	// The driver's reads are not submissions of this call; nothing is captured.
+	// PIPE_TRANSFER_TIMEOUT is not used because a timeout aborts the pipe and stops the reader.
+	if (Overlapped)
+	{
+		success = Ioctl_Async(Dev_Handle(), LIBUSBK_IOCTL_READ_PACKETS,
+		                      &request, sizeof(request),
+		                      Buffer, BufferLength,
+		                      Overlapped);
+	}
+	else
+	{
+		success = Ioctl_Sync(Dev_Handle(), LIBUSBK_IOCTL_READ_PACKETS,
+		                     &request, sizeof(request),
+		                     Buffer, BufferLength,
+		                     LengthTransferred);
+	}
+
+	PoolHandle_Dec_UsbK(handle);
+	return success;
+}
+
 KUSB_EXP BOOL KUSB_API UsbK_ResetDevice(
     _in KUSB_HANDLE InterfaceHandle)
 {
@@ -838,10 +946,13 @@ KUSB_EXP BOOL KUSB_API UsbK_ControlTransfer(
 	INT ioctlCode;
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(SetupPacket.RequestType & USB_ENDPOINT_DIRECTION_MASK, SetupPacket.Length, Overlapped);
+
 	ioctlCode = (SetupPacket.RequestType & USB_ENDPOINT_DIRECTION_MASK) ? LIBUSB_IOCTL_CONTROL_READ : LIBUSB_IOCTL_CONTROL_WRITE;
 
 	if (Overlapped)
@@ -860,6 +971,7 @@ KUSB_EXP BOOL KUSB_API UsbK_ControlTransfer(
 
 		success = Ioctl_Sync(Dev_Handle(), ioctlCode, &request, sizeof(request), Buffer, BufferLength, LengthTransferred);
 	}
+	Capture_SubmitResult(Overlapped, SetupPacket.RequestType & USB_ENDPOINT_DIRECTION_MASK, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -878,6 +990,7 @@ KUSB_EXP BOOL KUSB_API UsbK_GetOverlappedResult(
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
 	success = GetOverlappedResult(Dev_Handle(), Overlapped, (LPDWORD)lpNumberOfBytesTransferred, bWait);
+	Capture_Reaped(Overlapped, success, *lpNumberOfBytesTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -957,10 +1070,13 @@ KUSB_EXP BOOL KUSB_API UsbK_ReadPipe(
 {
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(PipeID, BufferLength, Overlapped);
+
 	if (Overlapped)
 	{
 		libusb_request request;
@@ -985,6 +1101,7 @@ KUSB_EXP BOOL KUSB_API UsbK_ReadPipe(
 		                                PipeID,
 		                                LengthTransferred);
 	}
+	Capture_SubmitResult(Overlapped, PipeID, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -1000,10 +1117,13 @@ KUSB_EXP BOOL KUSB_API UsbK_WritePipe(
 {
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(PipeID, BufferLength, Overlapped);
+
 	if (Overlapped)
 	{
 		libusb_request request;
@@ -1028,6 +1148,7 @@ KUSB_EXP BOOL KUSB_API UsbK_WritePipe(
 		                                PipeID,
 		                                LengthTransferred);
 	}
+	Capture_SubmitResult(Overlapped, PipeID, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
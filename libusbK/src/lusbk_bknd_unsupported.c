@@ -403,6 +403,59 @@ KUSB_EXP BOOL KUSB_API Unsupported_GetCurrentFrameNumber(
 	return FALSE;
 }
 
+KUSB_EXP BOOL KUSB_API Unsupported_GetPipeStats(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+	UNREFERENCED_PARAMETER(PipeID);
+	UNREFERENCED_PARAMETER(Stats);
+
+	SetLastError(ERROR_NOT_SUPPORTED);
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API Unsupported_SubmitBatch(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+	UNREFERENCED_PARAMETER(PipeID);
+	UNREFERENCED_PARAMETER(Entries);
+	UNREFERENCED_PARAMETER(EntryCount);
+	UNREFERENCED_PARAMETER(Buffer);
+	UNREFERENCED_PARAMETER(BufferLength);
+	UNREFERENCED_PARAMETER(Overlapped);
+
+	SetLastError(ERROR_NOT_SUPPORTED);
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API Unsupported_ReadPackets(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped)
+{
+	UNREFERENCED_PARAMETER(InterfaceHandle);
+	UNREFERENCED_PARAMETER(PipeID);
+	UNREFERENCED_PARAMETER(Buffer);
+	UNREFERENCED_PARAMETER(BufferLength);
+	UNREFERENCED_PARAMETER(LengthTransferred);
+	UNREFERENCED_PARAMETER(Overlapped);
+
+	SetLastError(ERROR_NOT_SUPPORTED);
+	return FALSE;
+}
+
 KUSB_EXP BOOL KUSB_API Unsupported_Free(
     _in KUSB_HANDLE InterfaceHandle)
 {
@@ -550,6 +603,15 @@ BOOL GetProcAddress_Unsupported(__out KPROC* ProcAddress, __in LONG FunctionID)
 	case KUSB_FNID_GetCurrentFrameNumber:
 		*ProcAddress = (KPROC)Unsupported_GetCurrentFrameNumber;
 		break;
+	case KUSB_FNID_GetPipeStats:
+		*ProcAddress = (KPROC)Unsupported_GetPipeStats;
+		break;
+	case KUSB_FNID_SubmitBatch:
+		*ProcAddress = (KPROC)Unsupported_SubmitBatch;
+		break;
+	case KUSB_FNID_ReadPackets:
+		*ProcAddress = (KPROC)Unsupported_ReadPackets;
+		break;
 
 	default:
 		*ProcAddress = (KPROC)NULL;
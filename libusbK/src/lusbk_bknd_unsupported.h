@@ -179,6 +179,28 @@ KUSB_EXP BOOL KUSB_API Unsupported_GetCurrentFrameNumber(
     _in KUSB_HANDLE InterfaceHandle,
     _out PUINT FrameNumber);
 
+KUSB_EXP BOOL KUSB_API Unsupported_GetPipeStats(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PKPIPE_STATS Stats);
+
+KUSB_EXP BOOL KUSB_API Unsupported_SubmitBatch(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _ref PKUSB_BATCH_ENTRY Entries,
+    _in UINT EntryCount,
+    _ref PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in LPOVERLAPPED Overlapped);
+
+KUSB_EXP BOOL KUSB_API Unsupported_ReadPackets(
+    _in KUSB_HANDLE InterfaceHandle,
+    _in UCHAR PipeID,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _outopt PUINT LengthTransferred,
+    _inopt LPOVERLAPPED Overlapped);
+
 KUSB_EXP BOOL KUSB_API Unsupported_Free(
     _in KUSB_HANDLE InterfaceHandle);
 
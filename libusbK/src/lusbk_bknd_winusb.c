@@ -634,11 +634,15 @@ KUSB_EXP BOOL KUSB_API WUsb_ControlTransfer(
 {
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(SetupPacket.RequestType & USB_ENDPOINT_DIRECTION_MASK, SetupPacket.Length, Overlapped);
+
 	success = WinUsb.ControlTransfer(Intf_Handle(), SetupPacket, Buffer, BufferLength, LengthTransferred, Overlapped);
+	Capture_SubmitResult(Overlapped, SetupPacket.RequestType & USB_ENDPOINT_DIRECTION_MASK, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -657,6 +661,7 @@ KUSB_EXP BOOL KUSB_API WUsb_GetOverlappedResult(
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
 	success = GetOverlappedResult(Dev_Handle(), Overlapped, (LPDWORD)lpNumberOfBytesTransferred, bWait);
+	Capture_Reaped(Overlapped, success, *lpNumberOfBytesTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -728,12 +733,16 @@ KUSB_EXP BOOL KUSB_API WUsb_ReadPipe(
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
 	HANDLE intfHandle;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(PipeID, BufferLength, Overlapped);
+
 	intfHandle = Get_PipeInterfaceHandle(handle, PipeID);
 	success = WinUsb.ReadPipe(intfHandle, PipeID, Buffer, BufferLength, LengthTransferred, Overlapped);
+	Capture_SubmitResult(Overlapped, PipeID, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -750,12 +759,16 @@ KUSB_EXP BOOL KUSB_API WUsb_WritePipe(
 	PKUSB_HANDLE_INTERNAL handle;
 	BOOL success;
 	HANDLE intfHandle;
+	LONGLONG submitTime;
 
 	Pub_To_Priv_UsbK(InterfaceHandle, handle, return FALSE);
 	ErrorSetAction(!PoolHandle_Inc_UsbK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_UsbK");
 
+	submitTime = Capture_Submit(PipeID, BufferLength, Overlapped);
+
 	intfHandle = Get_PipeInterfaceHandle(handle, PipeID);
 	success = WinUsb.WritePipe(intfHandle, PipeID, Buffer, BufferLength, LengthTransferred, Overlapped);
+	Capture_SubmitResult(Overlapped, PipeID, submitTime, success, LengthTransferred);
 
 	PoolHandle_Dec_UsbK(handle);
 	return success;
@@ -0,0 +1,249 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+#include "lusbk_private.h"
+
+// Workload capture.
+//
+// When the LIBUSBK_CAPTURE environment variable names a file, every pipe and
+// control transfer submitted through the libusbK and WinUSB backends is
+// appended to it as a kBench workload profile line:
+//   <read|write|control> <length> <inter-arrival-us>	# t=<us> outstanding=<n>
+//
+// Completions are written as comment lines, so the file still replays as is:
+//   # done <read|write|control> <transferred> t=<us> latency=<us> outstanding=<n> [failed]
+//
+// t= is the time since the first submission and outstanding= the number of
+// captured transfers pending after the event. Overlapped transfers complete
+// when they are reaped through UsbK_GetOverlappedResult, the OvlK wait
+// functions or a StmK stream; transfers reaped with the Win32
+// GetOverlappedResult directly stay outstanding. When the capture is closed
+// the highest outstanding count is written as the profile's "concurrency="
+// line.
+//
+// The file can be replayed with "kBench profile=<file>".
+//
+#define CAPTURE_ENV_NAME "LIBUSBK_CAPTURE"
+
+// Overlapped transfers tracked at once; others are counted as untracked.
+#define CAPTURE_MAX_PENDING 256
+
+typedef struct _KCAPTURE_PENDING
+{
+	LPOVERLAPPED Overlapped;
+	LONGLONG SubmitTime;
+	UCHAR PipeID;
+} KCAPTURE_PENDING;
+
+typedef struct _KCAPTURE_CONTEXT
+{
+	volatile long Lock;
+	FILE* File;
+	LONGLONG Frequency;
+	LONGLONG FirstSubmit;
+	LONGLONG LastSubmit;
+
+	KCAPTURE_PENDING Pending[CAPTURE_MAX_PENDING];
+	LONG PendingCount;
+	LONG Outstanding;
+	LONG PeakOutstanding;
+
+	LONG Submitted;
+	LONG Completed;
+	LONG Untracked;
+} KCAPTURE_CONTEXT;
+
+static KCAPTURE_CONTEXT Capture;
+
+static LPCSTR Capture_OpName(UCHAR PipeID)
+{
+	// PipeIDs 0x00 and 0x80 are the default control pipe.
+	if (!(PipeID & 0xF))
+		return "control";
+
+	return (PipeID & USB_ENDPOINT_DIRECTION_MASK) ? "read" : "write";
+}
+
+static LONG Capture_ToUs(LONGLONG ticks)
+{
+	LONGLONG us = (ticks * 1000000) / Capture.Frequency;
+
+	if (us < 0) return 0;
+	return us > MAXLONG ? MAXLONG : (LONG)us;
+}
+
+VOID Capture_Init(VOID)
+{
+	CHAR fileName[MAX_PATH];
+	DWORD length;
+	LARGE_INTEGER frequency;
+
+	if (Capture.File) return;
+
+	length = GetEnvironmentVariableA(CAPTURE_ENV_NAME, fileName, sizeof(fileName));
+	if (!length || length >= sizeof(fileName)) return;
+
+	if (!QueryPerformanceFrequency(&frequency) || !frequency.QuadPart)
+	{
+		USBWRNN("performance counter not available; workload capture disabled.");
+		return;
+	}
+
+	Mem_Zero(&Capture, sizeof(Capture));
+
+	if (fopen_s(&Capture.File, fileName, "w") != 0 || !Capture.File)
+	{
+		USBWRNN("failed creating workload capture file %s", fileName);
+		Capture.File = NULL;
+		return;
+	}
+
+	Capture.Frequency = frequency.QuadPart;
+
+	fprintf(Capture.File, "# libusbK workload capture (pid %u)\n", GetCurrentProcessId());
+	USBMSGN("capturing workload to %s", fileName);
+}
+
+VOID Capture_Free(VOID)
+{
+	FILE* file;
+
+	if (!Capture.File) return;
+
+	mSpin_Acquire(&Capture.Lock);
+	file = Capture.File;
+	Capture.File = NULL;
+	mSpin_Release(&Capture.Lock);
+
+	if (file)
+	{
+		fprintf(file, "# %d submitted, %d completed, %d untracked, %d outstanding\n",
+		        Capture.Submitted, Capture.Completed, Capture.Untracked, Capture.Outstanding);
+		fprintf(file, "concurrency=%d\n", max(Capture.PeakOutstanding, 1));
+		fflush(file);
+		fclose(file);
+	}
+}
+
+LONGLONG Capture_Submit(__in UCHAR PipeID, __in UINT Length, __in_opt LPOVERLAPPED Overlapped)
+{
+	LARGE_INTEGER now;
+	LONGLONG delay;
+	DWORD errorCode;
+
+	if (!Capture.File) return 0;
+
+	errorCode = GetLastError();
+	QueryPerformanceCounter(&now);
+
+	mSpin_Acquire(&Capture.Lock);
+	if (Capture.File)
+	{
+		if (!Capture.FirstSubmit) Capture.FirstSubmit = now.QuadPart;
+		delay = Capture.LastSubmit ? now.QuadPart - Capture.LastSubmit : 0;
+		Capture.LastSubmit = now.QuadPart;
+		Capture.Submitted++;
+
+		if (!Overlapped || Capture.PendingCount < CAPTURE_MAX_PENDING)
+		{
+			if (Overlapped)
+			{
+				Capture.Pending[Capture.PendingCount].Overlapped = Overlapped;
+				Capture.Pending[Capture.PendingCount].SubmitTime = now.QuadPart;
+				Capture.Pending[Capture.PendingCount].PipeID = PipeID;
+				Capture.PendingCount++;
+			}
+			if (++Capture.Outstanding > Capture.PeakOutstanding)
+				Capture.PeakOutstanding = Capture.Outstanding;
+		}
+		else
+		{
+			Capture.Untracked++;
+		}
+
+		fprintf(Capture.File, "%s %u %d\t# t=%d outstanding=%d\n",
+		        Capture_OpName(PipeID), Length, Capture_ToUs(delay),
+		        Capture_ToUs(now.QuadPart - Capture.FirstSubmit), Capture.Outstanding);
+	}
+	mSpin_Release(&Capture.Lock);
+
+	SetLastError(errorCode);
+	return now.QuadPart;
+}
+
+static VOID Capture_WriteDone(UCHAR PipeID, LONGLONG SubmitTime, LONGLONG Now, BOOL Success, UINT Transferred)
+{
+	Capture.Completed++;
+	Capture.Outstanding--;
+
+	fprintf(Capture.File, "# done %s %u t=%d latency=%d outstanding=%d%s\n",
+	        Capture_OpName(PipeID), Transferred,
+	        Capture_ToUs(Now - Capture.FirstSubmit), Capture_ToUs(Now - SubmitTime),
+	        Capture.Outstanding, Success ? "" : " failed");
+}
+
+static VOID Capture_Complete(LPOVERLAPPED Overlapped, UCHAR PipeID, LONGLONG SubmitTime, BOOL Success, UINT Transferred)
+{
+	LARGE_INTEGER now;
+	DWORD errorCode;
+	LONG pos;
+
+	errorCode = GetLastError();
+	QueryPerformanceCounter(&now);
+
+	mSpin_Acquire(&Capture.Lock);
+	if (Capture.File)
+	{
+		if (!Overlapped)
+		{
+			Capture_WriteDone(PipeID, SubmitTime, now.QuadPart, Success, Transferred);
+		}
+		else
+		{
+			// A batch submits several entries with one overlapped; all of them complete here.
+			for (pos = Capture.PendingCount - 1; pos >= 0; pos--)
+			{
+				if (Capture.Pending[pos].Overlapped != Overlapped) continue;
+
+				Capture_WriteDone(Capture.Pending[pos].PipeID, Capture.Pending[pos].SubmitTime, now.QuadPart, Success, Transferred);
+				Capture.Pending[pos] = Capture.Pending[--Capture.PendingCount];
+				Transferred = 0;
+			}
+		}
+	}
+	mSpin_Release(&Capture.Lock);
+
+	SetLastError(errorCode);
+}
+
+VOID Capture_SubmitResult(__in_opt LPOVERLAPPED Overlapped, __in UCHAR PipeID, __in LONGLONG SubmitTime, __in BOOL Success, __in_opt PUINT LengthTransferred)
+{
+	if (!Capture.File) return;
+
+	if (!Overlapped)
+		Capture_Complete(NULL, PipeID, SubmitTime, Success, (Success && LengthTransferred) ? *LengthTransferred : 0);
+	else if (!Success && GetLastError() != ERROR_IO_PENDING)
+		Capture_Complete(Overlapped, PipeID, SubmitTime, FALSE, 0);
+}
+
+VOID Capture_Reaped(__in LPOVERLAPPED Overlapped, __in BOOL Success, __in UINT Transferred)
+{
+	if (!Capture.File) return;
+
+	if (Success || GetLastError() != ERROR_IO_INCOMPLETE)
+		Capture_Complete(Overlapped, 0, 0, Success, Success ? Transferred : 0);
+}
@@ -0,0 +1,198 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "lusbk_cqueue.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchange, _InterlockedCompareExchange)
+
+// Every access to a shared index is a full barrier; stores return the old value.
+#define CQueue_Store(mPtr, mValue)	((unsigned int)_InterlockedExchange((volatile long*)(mPtr), (long)(mValue)))
+#define CQueue_Load(mPtr)			((unsigned int)_InterlockedCompareExchange((volatile long*)(mPtr), 0, 0))
+#else
+#define CQueue_Store(mPtr, mValue)	__atomic_exchange_n((mPtr), (mValue), __ATOMIC_SEQ_CST)
+#define CQueue_Load(mPtr)			__atomic_load_n((mPtr), __ATOMIC_SEQ_CST)
+#endif
+
+unsigned int CQueue_RecordCount(
+    unsigned int minRecords)
+{
+	unsigned int recordCount = KCQ_MIN_RECORDS;
+
+	while (recordCount < minRecords && recordCount < KCQ_MAX_RECORDS)
+		recordCount <<= 1;
+
+	return recordCount;
+}
+
+void CQueue_InitConsumer(
+    KCQ_CONSUMER* consumer,
+    void* buffer,
+    unsigned int recordCount)
+{
+	KCQ_HEADER* header = (KCQ_HEADER*)buffer;
+	unsigned char* pos = (unsigned char*)buffer;
+	unsigned int length = (unsigned int)KCQ_BUFFER_SIZE(recordCount);
+
+	while (length--) *pos++ = 0;
+
+	header->Magic		= KCQ_MAGIC;
+	header->RecordCount	= recordCount;
+
+	consumer->Header	= header;
+	consumer->Records	= (KCQ_RECORD*)(header + 1);
+	consumer->Mask		= recordCount - 1;
+	consumer->Tail		= 0;
+	consumer->Dropped	= 0;
+}
+
+int CQueue_InitProducer(
+    KCQ_PRODUCER* producer,
+    void* buffer,
+    unsigned int bufferSize)
+{
+	KCQ_HEADER* header = (KCQ_HEADER*)buffer;
+	unsigned int recordCount;
+
+	if (bufferSize < sizeof(KCQ_HEADER))
+		return 0;
+
+	// Read once; the consumer could change it while it is validated.
+	recordCount = *(volatile unsigned int*)&header->RecordCount;
+
+	if (header->Magic != KCQ_MAGIC ||
+	        recordCount < KCQ_MIN_RECORDS || recordCount > KCQ_MAX_RECORDS ||
+	        (recordCount & (recordCount - 1)) ||
+	        bufferSize < KCQ_BUFFER_SIZE(recordCount))
+		return 0;
+
+	producer->Header	= header;
+	producer->Records	= (KCQ_RECORD*)(header + 1);
+	producer->Mask		= recordCount - 1;
+	producer->Head		= 0;
+
+	CQueue_Store(&header->Head, 0);
+	return 1;
+}
+
+int CQueue_Post(
+    KCQ_PRODUCER* producer,
+    unsigned long long tag,
+    int status,
+    unsigned int transferred)
+{
+	KCQ_HEADER* header = producer->Header;
+	KCQ_RECORD* record;
+	unsigned int head = producer->Head;
+	int result = 0;
+
+	// Anything outside of 0..RecordCount (a corrupt Tail) is treated as full.
+	if (head - CQueue_Load(&header->Tail) > producer->Mask)
+	{
+		CQueue_Store(&header->Dropped, CQueue_Load(&header->Dropped) + 1);
+		result = KCQ_POST_DROPPED;
+	}
+	else
+	{
+		record = &producer->Records[head & producer->Mask];
+		record->Tag			= tag;
+		record->Status		= status;
+		record->Transferred	= transferred;
+
+		producer->Head = ++head;
+		CQueue_Store(&header->Head, head);
+	}
+
+	if (CQueue_Load(&header->Waiting) && CQueue_Store(&header->Waiting, 0))
+		result |= KCQ_POST_WAKE;
+
+	return result;
+}
+
+unsigned int CQueue_Reap(
+    KCQ_CONSUMER* consumer,
+    KCQ_RECORD* records,
+    unsigned int maxRecords)
+{
+	unsigned int head = CQueue_Load(&consumer->Header->Head);
+	unsigned int tail = consumer->Tail;
+	unsigned int count = 0;
+
+	while (tail != head && count < maxRecords)
+	{
+		records[count++] = consumer->Records[tail & consumer->Mask];
+		tail++;
+	}
+
+	if (count)
+	{
+		// The records are copied before the producer can reuse them.
+		consumer->Tail = tail;
+		CQueue_Store(&consumer->Header->Tail, tail);
+	}
+
+	return count;
+}
+
+int CQueue_PrepareWait(
+    KCQ_CONSUMER* consumer)
+{
+	CQueue_Store(&consumer->Header->Waiting, 1);
+
+	if (CQueue_Load(&consumer->Header->Head) != consumer->Tail)
+	{
+		CQueue_CancelWait(consumer);
+		return 0;
+	}
+
+	return 1;
+}
+
+void CQueue_CancelWait(
+    KCQ_CONSUMER* consumer)
+{
+	CQueue_Store(&consumer->Header->Waiting, 0);
+}
+
+int CQueue_CheckDropped(
+    KCQ_CONSUMER* consumer)
+{
+	unsigned int dropped = CQueue_Load(&consumer->Header->Dropped);
+
+	if (dropped == consumer->Dropped)
+		return 0;
+
+	consumer->Dropped = dropped;
+	return 1;
+}
+
+int CQueue_TagIndex(
+    unsigned long long tag,
+    unsigned long long firstTag,
+    unsigned int elementSize,
+    unsigned int count)
+{
+	unsigned long long offset = tag - firstTag;
+
+	// Tags below firstTag wrap to a large offset.
+	if (!elementSize || offset % elementSize || offset / elementSize >= count)
+		return -1;
+
+	return (int)(offset / elementSize);
+}
@@ -0,0 +1,168 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __LUSBK_CQUEUE_H_
+#define __LUSBK_CQUEUE_H_
+
+// Completion queue shared by libusbK.sys and user mode.
+//
+// The application allocates the queue (a KCQ_HEADER followed by RecordCount
+// KCQ_RECORDs) and registers it with LIBUSBK_IOCTL_REGISTER_CQUEUE. The
+// driver then appends a record for every pipe transfer completed on that
+// file handle; the consumer reads them without a system call and only blocks
+// on the registered event when the queue is empty.
+//
+// There is one producer and one consumer. Head is written only by the
+// producer and Tail only by the consumer; both are free running and wrap.
+// A record is written before Head is advanced past it, and is not reused
+// until Tail has been advanced past it. Before blocking, the consumer sets
+// Waiting and checks Head again; the producer checks Waiting after
+// advancing Head and signals the event if it was set. Both of those steps
+// are full barriers, so one side always sees the other.
+//
+// The producer keeps its own copy of Head and of the queue size and treats
+// every other header field as untrusted; a consumer that corrupts the header
+// can lose completions, but cannot make the producer write outside of the
+// queue.
+//
+// This module uses plain C types only; it is built into both the driver and
+// the library, and can be exercised outside of either.
+
+// "KUCQ"
+#define KCQ_MAGIC				0x5143554B
+
+#define KCQ_MIN_RECORDS			16
+#define KCQ_MAX_RECORDS			65536
+
+// Bytes needed for a queue of recordCount records.
+#define KCQ_BUFFER_SIZE(recordCount) (sizeof(KCQ_HEADER) + (recordCount) * sizeof(KCQ_RECORD))
+
+typedef struct _KCQ_RECORD
+{
+	// Identifies the request; the user mode address of its OVERLAPPED.
+	unsigned long long Tag;
+
+	// Completion status. (NTSTATUS)
+	int Status;
+
+	// Number of bytes transferred.
+	unsigned int Transferred;
+} KCQ_RECORD;
+
+typedef struct _KCQ_HEADER
+{
+	// Written by the consumer before the queue is registered.
+	unsigned int Magic;
+	unsigned int RecordCount;
+	unsigned int Reserved0[14];
+
+	// Written by the producer. (own cache line)
+	volatile unsigned int Head;
+	volatile unsigned int Dropped;
+	unsigned int Reserved1[14];
+
+	// Written by the consumer; Waiting is cleared by the producer when it signals. (own cache line)
+	volatile unsigned int Tail;
+	volatile unsigned int Waiting;
+	unsigned int Reserved2[14];
+} KCQ_HEADER;
+
+// Producer state; the producer never reads these back from the shared header.
+typedef struct _KCQ_PRODUCER
+{
+	KCQ_HEADER* Header;
+	KCQ_RECORD* Records;
+	unsigned int Mask;
+	unsigned int Head;
+} KCQ_PRODUCER;
+
+typedef struct _KCQ_CONSUMER
+{
+	KCQ_HEADER* Header;
+	KCQ_RECORD* Records;
+	unsigned int Mask;
+	unsigned int Tail;
+
+	// Header->Dropped when it was last checked. (see CQueue_CheckDropped)
+	unsigned int Dropped;
+} KCQ_CONSUMER;
+
+// CQueue_Post result flags.
+#define KCQ_POST_WAKE			0x00000001
+#define KCQ_POST_DROPPED		0x00000002
+
+// Gets the record count a consumer should use for at least minRecords;
+// a power of two within KCQ_MIN_RECORDS..KCQ_MAX_RECORDS.
+unsigned int CQueue_RecordCount(
+    unsigned int minRecords);
+
+// Initializes a queue buffer of KCQ_BUFFER_SIZE(recordCount) bytes.
+// recordCount must be a power of two within KCQ_MIN_RECORDS..KCQ_MAX_RECORDS.
+void CQueue_InitConsumer(
+    KCQ_CONSUMER* consumer,
+    void* buffer,
+    unsigned int recordCount);
+
+// Attaches to a queue initialized by CQueue_InitConsumer. Returns zero if the
+// header is not valid for a buffer of bufferSize bytes.
+int CQueue_InitProducer(
+    KCQ_PRODUCER* producer,
+    void* buffer,
+    unsigned int bufferSize);
+
+// Appends a record. Returns KCQ_POST_WAKE if the consumer was waiting and
+// must be signalled. If the queue is full the record is dropped, Dropped is
+// incremented and KCQ_POST_DROPPED is returned.
+int CQueue_Post(
+    KCQ_PRODUCER* producer,
+    unsigned long long tag,
+    int status,
+    unsigned int transferred);
+
+// Moves up to maxRecords records to records, oldest first, and returns the
+// number moved.
+unsigned int CQueue_Reap(
+    KCQ_CONSUMER* consumer,
+    KCQ_RECORD* records,
+    unsigned int maxRecords);
+
+// Called before blocking on the queue event. Returns non-zero if the
+// consumer may block; zero if records arrived and must be reaped first.
+int CQueue_PrepareWait(
+    KCQ_CONSUMER* consumer);
+
+// Ends a wait that returned without the event being signalled.
+void CQueue_CancelWait(
+    KCQ_CONSUMER* consumer);
+
+// Returns non-zero if records were dropped since the last call; the consumer
+// must then find its completions some other way.
+int CQueue_CheckDropped(
+    KCQ_CONSUMER* consumer);
+
+// Gets the array index a record tag refers to. firstTag is the tag (the
+// address of the tagged field) of element 0 of an array of count elements
+// of elementSize bytes. Returns -1 if tag is not the tag of any element;
+// the tag is never dereferenced.
+int CQueue_TagIndex(
+    unsigned long long tag,
+    unsigned long long firstTag,
+    unsigned int elementSize,
+    unsigned int count);
+
+#endif
@@ -0,0 +1,75 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <stddef.h>
+#include "lusbk_desc_walk.h"
+
+int DescWalk_Next(PKDESC_ITERATOR Desc)
+{
+	if (Desc->Remaining < 2) return 0;
+
+	Desc->Remaining -= Desc->Offset[0];
+
+	if (Desc->Remaining >= 2)
+	{
+		Desc->Offset += Desc->Offset[0];
+		return 1;
+	}
+	return 0;
+}
+
+// The endpoints up to the next interface descriptor; Desc is left on the
+// last descriptor before it.
+static void DescWalk_Pipes(const KDESC_WALK* Callbacks, void* AltInterface, PKDESC_ITERATOR Desc)
+{
+	KDESC_ITERATOR descPrev = *Desc;
+
+	while (DescWalk_Next(Desc))
+	{
+		if (Desc->Offset[1] == KDESC_WALK_TYPE_INTERFACE)
+		{
+			*Desc = descPrev;
+			break;
+		}
+		else if (Desc->Offset[1] == KDESC_WALK_TYPE_ENDPOINT)
+		{
+			if (!Callbacks->AddPipe(Callbacks->Context, AltInterface, Desc->Offset))
+				return;
+		}
+		descPrev = *Desc;
+	}
+}
+
+void DescWalk_Config(const KDESC_WALK* Callbacks, const unsigned char* Config, long Length)
+{
+	KDESC_ITERATOR desc;
+	void* altInterface;
+
+	desc.Offset = Config;
+	desc.Remaining = Length;
+
+	while (DescWalk_Next(&desc))
+	{
+		if (desc.Offset[1] == KDESC_WALK_TYPE_INTERFACE)
+		{
+			altInterface = Callbacks->AddInterface(Callbacks->Context, desc.Offset);
+			if (altInterface)
+				DescWalk_Pipes(Callbacks, altInterface, &desc);
+		}
+	}
+}
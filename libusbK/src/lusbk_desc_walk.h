@@ -0,0 +1,71 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __LUSBK_DESC_WALK_H_
+#define __LUSBK_DESC_WALK_H_
+
+// Configuration descriptor walk.
+//
+// This is how UsbStack_Init (lusbk_stack_collection.c) finds the
+// interfaces, alt settings and pipes of a configuration descriptor. Like
+// lusbk_iso_layout.c, it has no Windows or driver dependencies; the
+// benchmark firmware descriptor generator (BmFW/DescGen) builds it to
+// check that libusbK finds every pipe of a generated descriptor.
+//
+// Only the two byte common descriptor header is read by the walk; the
+// callbacks get a pointer to each whole descriptor.
+
+// Descriptor types the walk stops at. (USB 2.0 table 9-5)
+#define KDESC_WALK_TYPE_INTERFACE	0x04
+#define KDESC_WALK_TYPE_ENDPOINT	0x05
+
+typedef struct _KDESC_ITERATOR
+{
+	long Remaining;
+	const unsigned char* Offset;
+} KDESC_ITERATOR, *PKDESC_ITERATOR;
+
+// Callbacks of DescWalk_Config; Context is passed to each one.
+typedef struct _KDESC_WALK
+{
+	void* Context;
+
+	// Adds an interface descriptor. Returns the alt setting its endpoints
+	// are added to or NULL to skip them.
+	void* (*AddInterface)(void* Context, const unsigned char* Descriptor);
+
+	// Adds an endpoint descriptor of AltInterface. Returns zero to skip the
+	// rest of its endpoints.
+	int (*AddPipe)(void* Context, void* AltInterface, const unsigned char* Descriptor);
+} KDESC_WALK, *PKDESC_WALK;
+
+// Steps to the next descriptor. Returns zero if there is no complete
+// descriptor header left.
+int DescWalk_Next(
+    PKDESC_ITERATOR Desc);
+
+// Walks the descriptors following the configuration descriptor at Config;
+// Length is its wTotalLength. Every interface descriptor is added, then the
+// endpoint descriptors up to the next interface descriptor. Other
+// descriptors are skipped.
+void DescWalk_Config(
+    const KDESC_WALK* Callbacks,
+    const unsigned char* Config,
+    long Length);
+
+#endif
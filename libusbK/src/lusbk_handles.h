@@ -511,6 +511,9 @@ typedef struct _KOVL_HANDLE_INTERNAL
 
 	volatile long IsAcquired;
 
+	// Set once OvlK_WaitAny has returned it; cleared when it is reused.
+	BOOL IsReaped;
+
 	struct _KOVL_EL* MasterLink;
 
 	KOBJ_BASE Base;
@@ -529,6 +532,7 @@ typedef struct _KOVL_EL
 #define Init_Handle_OvlPoolK(HandlePtr) do {	\
 		(HandlePtr)->Flags = 0; 					\
 		(HandlePtr)->UsbHandle = NULL; 				\
+		memset(&((HandlePtr)->CQueue), 0, sizeof((HandlePtr)->CQueue));	\
 	}while(0)
 typedef struct _KOVL_POOL_HANDLE_INTERNAL
 {
@@ -542,6 +546,17 @@ typedef struct _KOVL_POOL_HANDLE_INTERNAL
 
 	KOVL_POOL_FLAG Flags;
 	PKUSB_HANDLE_INTERNAL UsbHandle;
+
+	// KOVL_POOL_FLAG_COMPLETION_QUEUE; the registration request is pending while IsRegistered is set.
+	struct
+	{
+		BOOL IsRegistered;
+		BOOL Dropped;
+		PVOID Buffer;
+		HANDLE Event;
+		OVERLAPPED Overlapped;
+		KCQ_CONSUMER Consumer;
+	} CQueue;
 } KOVL_POOL_HANDLE_INTERNAL;
 typedef KOVL_POOL_HANDLE_INTERNAL* PKOVL_POOL_HANDLE_INTERNAL;
 
@@ -0,0 +1,145 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <string.h>
+#include "lusbk_iso_layout.h"
+
+static unsigned long long IsoLayout_Gcd(unsigned long long a, unsigned long long b)
+{
+	unsigned long long t;
+	while (b)
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+unsigned int IsoLayout_MaxPacketBytes(
+    unsigned int MaxPacketSize)
+{
+	return (MaxPacketSize & 0x7FF) * (1 + ((MaxPacketSize >> 11) & 3));
+}
+
+int IsoLayout_Plan(
+    const KISO_LAYOUT_SPEC* Spec,
+    unsigned int NumberOfPackets,
+    PKISO_LAYOUT_PLAN Plan)
+{
+	unsigned long long intervalsPerSecond = Spec->HighSpeed ? 8000 : 1000;
+	unsigned long long interval = Spec->Interval ? Spec->Interval : 1;
+	unsigned long long samplesPerPacket;
+	unsigned long long period;
+	unsigned long long phases = 1;
+
+	memset(Plan, 0, sizeof(*Plan));
+
+	Plan->MaxPacketBytes = IsoLayout_MaxPacketBytes(Spec->MaxPacketSize);
+	if (!Plan->MaxPacketBytes) return KISO_LAYOUT_BAD_PACKET_SIZE;
+
+	if (Spec->SampleRate)
+	{
+		if (!Spec->BytesPerSample) return KISO_LAYOUT_BAD_SAMPLE_SIZE;
+
+		// Samples per packet is SampleRate * interval / intervalsPerSecond, rounded up.
+		samplesPerPacket = ((unsigned long long)Spec->SampleRate * interval + intervalsPerSecond - 1) / intervalsPerSecond;
+		Plan->PacketSamples = (unsigned int)samplesPerPacket;
+		if (samplesPerPacket * Spec->BytesPerSample > Plan->MaxPacketBytes) return KISO_LAYOUT_PACKET_OVERFLOW;
+
+		period = intervalsPerSecond / IsoLayout_Gcd((unsigned long long)Spec->SampleRate * interval, intervalsPerSecond);
+		phases = period / IsoLayout_Gcd(period, NumberOfPackets);
+	}
+
+	if (phases * NumberOfPackets > KISO_LAYOUT_MAX_TABLE_PACKETS) return KISO_LAYOUT_TABLE_TOO_LARGE;
+
+	Plan->LayoutCount = (unsigned int)phases;
+	return KISO_LAYOUT_OK;
+}
+
+void IsoLayout_Build(
+    const KISO_LAYOUT_SPEC* Spec,
+    const KISO_LAYOUT_PLAN* Plan,
+    unsigned int NumberOfPackets,
+    unsigned int* TransferLengths,
+    PKISO_LAYOUT_PACKET Packets)
+{
+	unsigned long long intervalsPerSecond = Spec->HighSpeed ? 8000 : 1000;
+	unsigned long long step = (unsigned long long)Spec->SampleRate * (Spec->Interval ? Spec->Interval : 1);
+	unsigned long long accumulator = 0;
+	unsigned int layoutIndex;
+	unsigned int packetIndex;
+	unsigned int offset;
+	unsigned int length;
+
+	for (layoutIndex = 0; layoutIndex < Plan->LayoutCount; layoutIndex++)
+	{
+		offset = 0;
+		for (packetIndex = 0; packetIndex < NumberOfPackets; packetIndex++, Packets++)
+		{
+			if (Spec->SampleRate)
+			{
+				accumulator += step;
+				length = (unsigned int)(accumulator / intervalsPerSecond) * Spec->BytesPerSample;
+				accumulator %= intervalsPerSecond;
+			}
+			else
+			{
+				length = Plan->MaxPacketBytes;
+			}
+
+			Packets->Offset = offset;
+			Packets->Length = (unsigned short)length;
+			Packets->Status = 0;
+			offset += length;
+		}
+		TransferLengths[layoutIndex] = offset;
+	}
+}
+
+int IsoLayout_Compact(
+    const KISO_LAYOUT_PACKET* Packets,
+    unsigned int NumberOfPackets,
+    const unsigned char* Buffer,
+    unsigned char* Output,
+    unsigned int OutputLength,
+    unsigned int* CompactedLength)
+{
+	unsigned int packetIndex;
+	unsigned int compacted = 0;
+
+	for (packetIndex = 0; packetIndex < NumberOfPackets; packetIndex++, Packets++)
+	{
+		if (Packets->Status || !Packets->Length)
+			continue;
+
+		if (Packets->Length > OutputLength - compacted)
+		{
+			*CompactedLength = compacted;
+			return (int)packetIndex;
+		}
+
+		if (&Output[compacted] != &Buffer[Packets->Offset])
+			memmove(&Output[compacted], &Buffer[Packets->Offset], Packets->Length);
+
+		compacted += Packets->Length;
+	}
+
+	*CompactedLength = compacted;
+	return -1;
+}
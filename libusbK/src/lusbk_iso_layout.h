@@ -0,0 +1,101 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __LUSBK_ISO_LAYOUT_H_
+#define __LUSBK_ISO_LAYOUT_H_
+
+// Isochronous packet layout and compaction math.
+//
+// This is the arithmetic behind IsoK_InitLayout, IsoK_ApplyLayout and
+// IsoK_CompactPackets (lusbk_usb_iso.c). Like lusbk_iso_sched.c, it has no
+// Windows or driver dependencies and can be built and tested on its own.
+//
+// A fractional sample rate (e.g. 44.1 kHz on a 1 ms bus interval) repeats
+// its packet size pattern every 'period' packets. The remainder is carried
+// from packet to packet, so the largest packet holds one extra sample. A
+// transfer of NumberOfPackets packets starts at one of
+// period / gcd(period, NumberOfPackets) phases; a complete packet array is
+// precomputed for each phase.
+
+// Limits the size of a precomputed layout table. (packet count)
+#define KISO_LAYOUT_MAX_TABLE_PACKETS	0x10000
+
+// Same layout as KISO_PACKET.
+typedef struct _KISO_LAYOUT_PACKET
+{
+	unsigned int Offset;
+	unsigned short Length;
+	unsigned short Status;
+} KISO_LAYOUT_PACKET, *PKISO_LAYOUT_PACKET;
+
+typedef struct _KISO_LAYOUT_SPEC
+{
+	unsigned int MaxPacketSize;		// wMaxPacketSize, including the high-bandwidth bits (11-12).
+	unsigned int Interval;			// bus intervals between packets. (0 = 1)
+	int HighSpeed;					// 8000 bus intervals per second instead of 1000.
+	unsigned int SampleRate;		// sample frames per second; 0 fills every packet.
+	unsigned int BytesPerSample;
+} KISO_LAYOUT_SPEC, *PKISO_LAYOUT_SPEC;
+
+typedef struct _KISO_LAYOUT_PLAN
+{
+	unsigned int MaxPacketBytes;	// bytes per bus interval.
+	unsigned int PacketSamples;		// largest packet in sample frames. (SampleRate only)
+	unsigned int LayoutCount;		// transfer phases.
+} KISO_LAYOUT_PLAN, *PKISO_LAYOUT_PLAN;
+
+// IsoLayout_Plan results.
+#define KISO_LAYOUT_OK					0
+#define KISO_LAYOUT_BAD_PACKET_SIZE		1	// MaxPacketSize is zero.
+#define KISO_LAYOUT_BAD_SAMPLE_SIZE		2	// SampleRate without BytesPerSample.
+#define KISO_LAYOUT_PACKET_OVERFLOW		3	// the largest packet exceeds MaxPacketBytes.
+#define KISO_LAYOUT_TABLE_TOO_LARGE		4	// more than KISO_LAYOUT_MAX_TABLE_PACKETS.
+
+// Returns the bytes per bus interval of an endpoint wMaxPacketSize; the
+// high-bandwidth bits add one or two transactions per microframe.
+unsigned int IsoLayout_MaxPacketBytes(
+    unsigned int MaxPacketSize);
+
+// Validates Spec and computes the number of transfer phases.
+int IsoLayout_Plan(
+    const KISO_LAYOUT_SPEC* Spec,
+    unsigned int NumberOfPackets,
+    PKISO_LAYOUT_PLAN Plan);
+
+// Fills Plan->LayoutCount packet arrays of NumberOfPackets packets and the
+// data length of each one.
+void IsoLayout_Build(
+    const KISO_LAYOUT_SPEC* Spec,
+    const KISO_LAYOUT_PLAN* Plan,
+    unsigned int NumberOfPackets,
+    unsigned int* TransferLengths,
+    PKISO_LAYOUT_PACKET Packets);
+
+// Gathers the data of every packet with a zero Status and a non-zero
+// Length into Output. Output may be Buffer; packets only ever move towards
+// the front. Returns -1 on success, otherwise the index of the first packet
+// that does not fit. *CompactedLength is always set.
+int IsoLayout_Compact(
+    const KISO_LAYOUT_PACKET* Packets,
+    unsigned int NumberOfPackets,
+    const unsigned char* Buffer,
+    unsigned char* Output,
+    unsigned int OutputLength,
+    unsigned int* CompactedLength);
+
+#endif
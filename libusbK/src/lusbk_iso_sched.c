@@ -0,0 +1,148 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <string.h>
+#include "lusbk_iso_sched.h"
+
+void IsoSched_Init(
+    PKISO_SCHED Sched,
+    unsigned int PacketsPerTransfer,
+    unsigned int PacketInterval,
+    int HighSpeed,
+    unsigned int FrameLead)
+{
+	unsigned int intervals;
+
+	memset(Sched, 0, sizeof(*Sched));
+
+	Sched->PacketsPerTransfer	= PacketsPerTransfer ? PacketsPerTransfer : 1;
+	Sched->PacketInterval		= PacketInterval ? PacketInterval : 1;
+	Sched->IntervalsPerFrame	= HighSpeed ? 8 : 1;
+	Sched->FrameLead			= FrameLead ? FrameLead : 1;
+
+	// A high-speed transfer that ends part way through a frame still owns that
+	// frame; the next transfer starts on the following one.
+	intervals = Sched->PacketsPerTransfer * Sched->PacketInterval;
+	Sched->FramesPerTransfer = (intervals + Sched->IntervalsPerFrame - 1) / Sched->IntervalsPerFrame;
+}
+
+unsigned int IsoSched_Next(
+    PKISO_SCHED Sched,
+    unsigned int CurrentFrame)
+{
+	unsigned int startFrame;
+
+	if (Sched->Synced && IsoSched_FrameDiff(Sched->NextStartFrame, CurrentFrame) < 1)
+	{
+		// Late; the next start frame is already on the bus.
+		Sched->Synced = 0;
+		Sched->ResyncCount++;
+	}
+
+	if (!Sched->Synced)
+	{
+		startFrame = CurrentFrame + Sched->FrameLead;
+		if (Sched->Started)
+		{
+			// Frames still owned by queued transfers are never handed out twice.
+			if (IsoSched_FrameDiff(Sched->NextStartFrame, startFrame) > 0)
+				startFrame = Sched->NextStartFrame;
+			else
+				Sched->MissedFrames += (unsigned int)IsoSched_FrameDiff(startFrame, Sched->NextStartFrame);
+		}
+
+		Sched->NextStartFrame = startFrame;
+		Sched->Synced = 1;
+		Sched->Started = 1;
+	}
+
+	startFrame = Sched->NextStartFrame;
+	Sched->NextStartFrame += Sched->FramesPerTransfer;
+
+	return startFrame;
+}
+
+void IsoSched_Invalidate(
+    PKISO_SCHED Sched)
+{
+	if (Sched->Synced)
+	{
+		Sched->Synced = 0;
+		Sched->ResyncCount++;
+	}
+}
+
+int IsoSched_Submit(
+    PKISO_SCHED Sched,
+    const KISO_SCHED_SUBMIT* Callbacks)
+{
+	unsigned int attempt, currentFrame, startFrame;
+	int result = KISO_SCHED_REJECTED;
+
+	for (attempt = 0; attempt < KISO_SCHED_SUBMIT_ATTEMPTS; attempt++)
+	{
+		if (!Callbacks->GetFrame(Callbacks->Context, &currentFrame))
+			return KISO_SCHED_FAILED;
+
+		startFrame = IsoSched_Next(Sched, currentFrame);
+		if (!attempt && !Callbacks->Prepare(Callbacks->Context, startFrame, currentFrame))
+			return KISO_SCHED_FAILED;
+
+		result = Callbacks->Submit(Callbacks->Context, startFrame, currentFrame);
+		if (result != KISO_SCHED_REJECTED)
+			break;
+
+		// Most often a start frame the host controller would not accept; resync.
+		IsoSched_Invalidate(Sched);
+	}
+	return result;
+}
+
+void IsoSched_Reset(
+    PKISO_SCHED Sched)
+{
+	Sched->NextStartFrame	= 0;
+	Sched->Synced			= 0;
+	Sched->Started			= 0;
+	Sched->ResyncCount		= 0;
+	Sched->MissedFrames		= 0;
+}
+
+unsigned int IsoSched_FramePackets(
+    unsigned int PacketInterval,
+    int HighSpeed)
+{
+	if (!HighSpeed || !PacketInterval || PacketInterval >= 8)
+		return 1;
+
+	// Intervals are powers of two; 8, 4 or 2 packets make a whole frame.
+	return 8 / PacketInterval;
+}
+
+void IsoSched_PacketFrame(
+    const KISO_SCHED* Sched,
+    unsigned int StartFrame,
+    unsigned int PacketIndex,
+    unsigned int* Frame,
+    unsigned int* MicroFrame)
+{
+	unsigned int interval = PacketIndex * Sched->PacketInterval;
+
+	*Frame		= StartFrame + (interval / Sched->IntervalsPerFrame);
+	*MicroFrame	= interval % Sched->IntervalsPerFrame;
+}
@@ -0,0 +1,138 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#ifndef __LUSBK_ISO_SCHED_H_
+#define __LUSBK_ISO_SCHED_H_
+
+// Start frame scheduling for continuous isochronous streams.
+//
+// This is the frame arithmetic used by the IsoK stream engine
+// (lusbk_iso_stream.c). It has no Windows or driver dependencies; the
+// current bus frame is always passed in by the caller, so the scheduler
+// can be driven by a simulated frame clock.
+//
+// Frame numbers are 32-bit USB (1 ms) frame numbers and wrap; they are
+// only ever compared through IsoSched_FrameDiff.
+
+typedef struct _KISO_SCHED
+{
+	// Configuration. (see IsoSched_Init)
+	unsigned int PacketsPerTransfer;
+	unsigned int PacketInterval;		// bus intervals between packets.
+	unsigned int IntervalsPerFrame;		// 8 for high-speed, 1 otherwise.
+	unsigned int FrameLead;				// frames ahead of the current frame when (re)synchronizing.
+
+	// Number of whole frames covered by one transfer.
+	unsigned int FramesPerTransfer;
+
+	// Start frame of the next transfer; valid when Synced is non-zero.
+	unsigned int NextStartFrame;
+	int Synced;
+
+	// Non-zero once a start frame has been handed out.
+	int Started;
+
+	// Statistics.
+	unsigned int ResyncCount;
+	unsigned int MissedFrames;
+} KISO_SCHED, *PKISO_SCHED;
+
+// Signed distance from frame b to frame a. (wrap safe)
+#define IsoSched_FrameDiff(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)))
+
+void IsoSched_Init(
+    PKISO_SCHED Sched,
+    unsigned int PacketsPerTransfer,
+    unsigned int PacketInterval,
+    int HighSpeed,
+    unsigned int FrameLead);
+
+// Returns the start frame for the next transfer and advances the schedule.
+//
+// CurrentFrame is the bus frame sampled just before submitting. If the next
+// start frame is not at least one frame in the future the stream is late:
+// the schedule restarts FrameLead frames after CurrentFrame and the frames
+// skipped over are counted in MissedFrames.
+unsigned int IsoSched_Next(
+    PKISO_SCHED Sched,
+    unsigned int CurrentFrame);
+
+// Forces the next IsoSched_Next call to resynchronize with the frame clock.
+// Used when a transfer completes with every packet late or the driver
+// rejects a start frame. Frames that belong to transfers which are still
+// queued are not reused.
+void IsoSched_Invalidate(
+    PKISO_SCHED Sched);
+
+// Submit attempts per transfer; a rejected start frame is retried once.
+#define KISO_SCHED_SUBMIT_ATTEMPTS	2
+
+// KISO_SCHED_SUBMIT::Submit and IsoSched_Submit results.
+#define KISO_SCHED_SUBMITTED		0
+#define KISO_SCHED_REJECTED			1	// the start frame was not accepted.
+#define KISO_SCHED_FAILED			2	// a callback failed; the stream must stop.
+
+// Callbacks of IsoSched_Submit; Context is passed to each one.
+typedef struct _KISO_SCHED_SUBMIT
+{
+	void* Context;
+
+	// Samples the current bus frame. Returns zero on failure.
+	int (*GetFrame)(void* Context, unsigned int* CurrentFrame);
+
+	// Fills the transfer for its first start frame. Returns zero on failure.
+	int (*Prepare)(void* Context, unsigned int StartFrame, unsigned int CurrentFrame);
+
+	// Queues the transfer at StartFrame. Returns a KISO_SCHED_ result.
+	int (*Submit)(void* Context, unsigned int StartFrame, unsigned int CurrentFrame);
+} KISO_SCHED_SUBMIT, *PKISO_SCHED_SUBMIT;
+
+// Schedules and submits one transfer.
+//
+// Prepare is called once, with the first start frame. If the start frame is
+// rejected the schedule is invalidated, the bus frame sampled again and the
+// same transfer submitted at the new start frame, up to
+// KISO_SCHED_SUBMIT_ATTEMPTS times in all. The transfer keeps its data and
+// layout phase across attempts. Returns the last Submit result or
+// KISO_SCHED_FAILED if a callback failed.
+int IsoSched_Submit(
+    PKISO_SCHED Sched,
+    const KISO_SCHED_SUBMIT* Callbacks);
+
+// Clears the schedule and statistics; the configuration is kept.
+void IsoSched_Reset(
+    PKISO_SCHED Sched);
+
+// Returns the smallest number of packets that fills whole frames; 1 for
+// full-speed. A transfer must be a multiple of it to end where the next one
+// starts. Otherwise FramesPerTransfer rounds up and the bus intervals up to
+// the next frame are left empty in every transfer.
+unsigned int IsoSched_FramePackets(
+    unsigned int PacketInterval,
+    int HighSpeed);
+
+// Gets the bus frame and microframe (0-7, high-speed only) packet
+// PacketIndex of a transfer starting at StartFrame is scheduled in.
+void IsoSched_PacketFrame(
+    const KISO_SCHED* Sched,
+    unsigned int StartFrame,
+    unsigned int PacketIndex,
+    unsigned int* Frame,
+    unsigned int* MicroFrame);
+
+#endif
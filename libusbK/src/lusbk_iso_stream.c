@@ -0,0 +1,662 @@
+/*!********************************************************************
+libusbK - Multi-driver USB library.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "lusbk_private.h"
+#include "lusbk_handles.h"
+#include "lusbk_stack_collection.h"
+#include "lusbk_iso_sched.h"
+#include <process.h>
+
+// warning C4127: conditional expression is constant.
+#pragma warning(disable: 4127)
+
+// Continuous isochronous stream.
+//
+// A worker thread keeps MaxPendingTransfers iso transfers queued on one pipe.
+// Start frames come from a KISO_SCHED (lusbk_iso_sched.c) so consecutive
+// transfers cover contiguous frames; a late submit resynchronizes the
+// schedule and the skipped frames are counted in the stream statistics.
+// Transfers always complete in submission order, so the thread only ever
+// waits on the oldest one.
+
+#define ISO_STREAM_DEFAULT_FRAME_LEAD	8
+#define ISO_STREAM_STOP_TIMEOUT_MS		1000
+
+#define KISO_STREAM_THREADSTATE_STOPPED		0
+#define KISO_STREAM_THREADSTATE_STARTED		1
+
+typedef struct _KISO_STREAM_XFER
+{
+	OVERLAPPED Overlapped;
+	PKISO_CONTEXT IsoContext;
+	PUCHAR Buffer;
+	UINT TransferLength;
+	BOOL Pending;
+
+	// Frame clock sample taken when the start frame was chosen.
+	UINT SubmitFrame;
+	LONGLONG SubmitTime;
+} KISO_STREAM_XFER, *PKISO_STREAM_XFER;
+
+struct _KISO_STREAM
+{
+	KUSB_DRIVER_API DriverAPI;
+	KUSB_HANDLE UsbHandle;
+	UCHAR PipeID;
+
+	KISO_STREAM_PARAMS Params;
+	KISO_SCHED Sched;
+	PKISO_LAYOUT Layout;
+
+	UINT MaxPacketBytes;
+	LONGLONG Frequency;
+
+	INT XferCount;
+	INT XferNext;
+	PKISO_STREAM_XFER Xfers;
+
+	// Per-transfer packet descriptors handed to the callback.
+	PKISO_STREAM_PACKET Packets;
+
+	struct
+	{
+		HANDLE Handle;
+		HANDLE StopEvent;
+		volatile long State;
+	} Thread;
+
+	struct
+	{
+		volatile long Lock;
+		HANDLE SemFilled;
+		PKISO_STREAM_PACKET Packets;
+		PUCHAR Data;
+		INT Count;
+		INT Head;
+		INT Filled;
+	} Ring;
+
+	volatile long StatsLock;
+	KISO_STREAM_STATS Stats;
+};
+
+static VOID IsoStream_SetError(PKISO_STREAM stream, DWORD errorCode)
+{
+	mSpin_Acquire(&stream->StatsLock);
+	if (!stream->Stats.ErrorCode)
+		stream->Stats.ErrorCode = errorCode;
+	mSpin_Release(&stream->StatsLock);
+}
+
+// Fills stream->Packets with the schedule of a transfer.
+static VOID IsoStream_DescribePackets(PKISO_STREAM stream, PKISO_STREAM_XFER xfer)
+{
+	INT packetIndex;
+	UINT frame, microFrame;
+	PKISO_PACKET isoPacket;
+	PKISO_STREAM_PACKET packet;
+
+	for (packetIndex = 0; packetIndex < xfer->IsoContext->NumberOfPackets; packetIndex++)
+	{
+		isoPacket	= &xfer->IsoContext->IsoPackets[packetIndex];
+		packet		= &stream->Packets[packetIndex];
+
+		IsoSched_PacketFrame(&stream->Sched, xfer->IsoContext->StartFrame, (UINT)packetIndex, &frame, &microFrame);
+
+		packet->Data		= &xfer->Buffer[isoPacket->Offset];
+		packet->Length		= isoPacket->Length;
+		packet->Status		= isoPacket->Status;
+		packet->FrameNumber	= frame;
+		packet->MicroFrame	= microFrame;
+
+		// Estimated from the frame clock sample; one bus frame is 1 ms.
+		packet->Timestamp	= xfer->SubmitTime +
+		                      (((LONGLONG)IsoSched_FrameDiff(frame, xfer->SubmitFrame) * 8 + microFrame) * stream->Frequency) / 8000;
+	}
+}
+
+static VOID IsoStream_RingWrite(PKISO_STREAM stream, PKISO_STREAM_PACKET packets, INT packetCount)
+{
+	INT packetIndex;
+	INT slot;
+	LONG added = 0;
+	UINT overruns = 0;
+
+	mSpin_Acquire(&stream->Ring.Lock);
+	for (packetIndex = 0; packetIndex < packetCount; packetIndex++)
+	{
+		if (packets[packetIndex].Status || !packets[packetIndex].Length)
+			continue;
+
+		if (stream->Ring.Filled == stream->Ring.Count)
+		{
+			// The reader has fallen behind; drop the newest data.
+			overruns++;
+			continue;
+		}
+
+		slot = (stream->Ring.Head + stream->Ring.Filled) % stream->Ring.Count;
+		memcpy(&stream->Ring.Packets[slot], &packets[packetIndex], sizeof(KISO_STREAM_PACKET));
+		stream->Ring.Packets[slot].Data = &stream->Ring.Data[slot * stream->MaxPacketBytes];
+		memcpy(stream->Ring.Packets[slot].Data, packets[packetIndex].Data, packets[packetIndex].Length);
+
+		stream->Ring.Filled++;
+		added++;
+	}
+	mSpin_Release(&stream->Ring.Lock);
+
+	if (added)
+		ReleaseSemaphore(stream->Ring.SemFilled, added, NULL);
+
+	if (overruns)
+	{
+		mSpin_Acquire(&stream->StatsLock);
+		stream->Stats.RingOverruns += overruns;
+		mSpin_Release(&stream->StatsLock);
+	}
+}
+
+// IsoSched_Submit context of one transfer.
+typedef struct _KISO_STREAM_SUBMIT
+{
+	PKISO_STREAM Stream;
+	PKISO_STREAM_XFER Xfer;
+	LONGLONG Now;
+	DWORD ErrorCode;
+} KISO_STREAM_SUBMIT, *PKISO_STREAM_SUBMIT;
+
+static int IsoStream_GetFrame(void* context, unsigned int* currentFrame)
+{
+	PKISO_STREAM_SUBMIT submit = (PKISO_STREAM_SUBMIT)context;
+	LARGE_INTEGER now;
+
+	if (!submit->Stream->DriverAPI.GetCurrentFrameNumber(submit->Stream->UsbHandle, currentFrame))
+	{
+		submit->ErrorCode = GetLastError();
+		USBERRN("GetCurrentFrameNumber failed. ErrorCode=%08Xh", submit->ErrorCode);
+		IsoStream_SetError(submit->Stream, submit->ErrorCode);
+		return 0;
+	}
+	QueryPerformanceCounter(&now);
+	submit->Now = now.QuadPart;
+	return 1;
+}
+
+static VOID IsoStream_SetStart(PKISO_STREAM_SUBMIT submit, UINT startFrame, UINT currentFrame)
+{
+	submit->Xfer->IsoContext->StartFrame	= startFrame;
+	submit->Xfer->IsoContext->Flags			= KISO_FLAG_SET_START_FRAME;
+	submit->Xfer->SubmitFrame				= currentFrame;
+	submit->Xfer->SubmitTime				= submit->Now;
+}
+
+// Takes the next layout phase and, for OUT pipes, has the application fill
+// the packets. Called once per transfer; a resubmit keeps both.
+static int IsoStream_Prepare(void* context, unsigned int startFrame, unsigned int currentFrame)
+{
+	PKISO_STREAM_SUBMIT submit = (PKISO_STREAM_SUBMIT)context;
+	PKISO_STREAM stream = submit->Stream;
+	PKISO_STREAM_XFER xfer = submit->Xfer;
+
+	IsoK_ApplyLayout(stream->Layout, xfer->IsoContext, &xfer->TransferLength);
+	IsoStream_SetStart(submit, startFrame, currentFrame);
+
+	if (USB_ENDPOINT_DIRECTION_OUT(stream->PipeID))
+	{
+		// The application fills the packets before they are queued.
+		IsoStream_DescribePackets(stream, xfer);
+		if (!stream->Params.PacketCB(stream, stream->Packets, xfer->IsoContext->NumberOfPackets, stream->Params.UserState))
+			return 0;
+	}
+	return 1;
+}
+
+static int IsoStream_SubmitAt(void* context, unsigned int startFrame, unsigned int currentFrame)
+{
+	PKISO_STREAM_SUBMIT submit = (PKISO_STREAM_SUBMIT)context;
+	PKISO_STREAM stream = submit->Stream;
+	PKISO_STREAM_XFER xfer = submit->Xfer;
+	BOOL success;
+
+	IsoStream_SetStart(submit, startFrame, currentFrame);
+
+	ResetEvent(xfer->Overlapped.hEvent);
+	if (USB_ENDPOINT_DIRECTION_OUT(stream->PipeID))
+		success = stream->DriverAPI.IsoWritePipe(stream->UsbHandle, stream->PipeID, xfer->Buffer, xfer->TransferLength, &xfer->Overlapped, xfer->IsoContext);
+	else
+		success = stream->DriverAPI.IsoReadPipe(stream->UsbHandle, stream->PipeID, xfer->Buffer, xfer->TransferLength, &xfer->Overlapped, xfer->IsoContext);
+
+	submit->ErrorCode = success ? ERROR_SUCCESS : GetLastError();
+	if (success || submit->ErrorCode == ERROR_IO_PENDING)
+		return KISO_SCHED_SUBMITTED;
+
+	USBWRNN("Iso submit failed. StartFrame=%08Xh ErrorCode=%08Xh", startFrame, submit->ErrorCode);
+	return KISO_SCHED_REJECTED;
+}
+
+// Schedules and submits one transfer. Returns FALSE if the stream must stop.
+static BOOL IsoStream_Submit(PKISO_STREAM stream, PKISO_STREAM_XFER xfer)
+{
+	KISO_STREAM_SUBMIT submit;
+	KISO_SCHED_SUBMIT callbacks;
+
+	memset(&submit, 0, sizeof(submit));
+	submit.Stream	= stream;
+	submit.Xfer		= xfer;
+
+	callbacks.Context	= &submit;
+	callbacks.GetFrame	= IsoStream_GetFrame;
+	callbacks.Prepare	= IsoStream_Prepare;
+	callbacks.Submit	= IsoStream_SubmitAt;
+
+	switch (IsoSched_Submit(&stream->Sched, &callbacks))
+	{
+	case KISO_SCHED_SUBMITTED:
+		xfer->Pending = TRUE;
+		return TRUE;
+
+	case KISO_SCHED_REJECTED:
+		IsoStream_SetError(stream, submit.ErrorCode);
+		return FALSE;
+
+	default:
+		return FALSE;
+	}
+}
+
+// Returns FALSE if the stream must stop.
+static BOOL IsoStream_Complete(PKISO_STREAM stream, PKISO_STREAM_XFER xfer)
+{
+	UINT transferred;
+	DWORD errorCode;
+	INT packetCount = xfer->IsoContext->NumberOfPackets;
+
+	xfer->Pending = FALSE;
+	if (!stream->DriverAPI.GetOverlappedResult(stream->UsbHandle, &xfer->Overlapped, &transferred, FALSE))
+	{
+		errorCode = GetLastError();
+		USBERRN("Iso transfer failed. StartFrame=%08Xh ErrorCode=%08Xh", xfer->IsoContext->StartFrame, errorCode);
+		IsoStream_SetError(stream, errorCode);
+		return FALSE;
+	}
+
+	mSpin_Acquire(&stream->StatsLock);
+	stream->Stats.TransferCount++;
+	stream->Stats.PacketCount += packetCount;
+	stream->Stats.PacketErrorCount += xfer->IsoContext->ErrorCount;
+	stream->Stats.MissedFrames = stream->Sched.MissedFrames;
+	stream->Stats.ResyncCount = stream->Sched.ResyncCount;
+	mSpin_Release(&stream->StatsLock);
+
+	// Every packet missed its frame; the schedule is no longer trustworthy.
+	if (xfer->IsoContext->ErrorCount >= packetCount)
+		IsoSched_Invalidate(&stream->Sched);
+
+	if (USB_ENDPOINT_DIRECTION_IN(stream->PipeID))
+	{
+		IsoStream_DescribePackets(stream, xfer);
+		if (stream->Params.PacketCB)
+			return stream->Params.PacketCB(stream, stream->Packets, packetCount, stream->Params.UserState);
+
+		IsoStream_RingWrite(stream, stream->Packets, packetCount);
+	}
+	return TRUE;
+}
+
+static VOID IsoStream_Abort(PKISO_STREAM stream)
+{
+	INT xferIndex;
+	PKISO_STREAM_XFER xfer;
+	UINT transferred;
+
+	stream->DriverAPI.AbortPipe(stream->UsbHandle, stream->PipeID);
+
+	for (xferIndex = 0; xferIndex < stream->XferCount; xferIndex++)
+	{
+		xfer = &stream->Xfers[xferIndex];
+		if (!xfer->Pending) continue;
+
+		if (WaitForSingleObject(xfer->Overlapped.hEvent, ISO_STREAM_STOP_TIMEOUT_MS) != WAIT_OBJECT_0)
+		{
+			USBWRNN("transfer %d did not abort; cancelling.", xferIndex);
+			CancelIo(((PKUSB_HANDLE_INTERNAL)stream->UsbHandle)->Device->MasterDeviceHandle);
+			WaitForSingleObject(xfer->Overlapped.hEvent, INFINITE);
+		}
+		stream->DriverAPI.GetOverlappedResult(stream->UsbHandle, &xfer->Overlapped, &transferred, FALSE);
+		xfer->Pending = FALSE;
+	}
+}
+
+static unsigned _stdcall IsoStream_ThreadProc(PKISO_STREAM stream)
+{
+	INT xferIndex;
+	PKISO_STREAM_XFER xfer;
+	HANDLE waitHandles[2];
+	DWORD waitResult;
+
+	for (xferIndex = 0; xferIndex < stream->XferCount; xferIndex++)
+	{
+		if (!IsoStream_Submit(stream, &stream->Xfers[xferIndex]))
+			goto Done;
+	}
+
+	stream->XferNext = 0;
+	waitHandles[1] = stream->Thread.StopEvent;
+	for (;;)
+	{
+		xfer = &stream->Xfers[stream->XferNext];
+		waitHandles[0] = xfer->Overlapped.hEvent;
+
+		waitResult = WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE);
+		if (waitResult != WAIT_OBJECT_0)
+			break;
+
+		if (!IsoStream_Complete(stream, xfer))
+			break;
+
+		if (WaitForSingleObject(stream->Thread.StopEvent, 0) == WAIT_OBJECT_0)
+			break;
+
+		if (!IsoStream_Submit(stream, xfer))
+			break;
+
+		if (++stream->XferNext == stream->XferCount)
+			stream->XferNext = 0;
+	}
+
+Done:
+	IsoStream_Abort(stream);
+	InterlockedExchange(&stream->Thread.State, KISO_STREAM_THREADSTATE_STOPPED);
+	return 0;
+}
+
+static VOID IsoStream_Free(PKISO_STREAM stream)
+{
+	INT xferIndex;
+
+	if (stream->Xfers)
+	{
+		for (xferIndex = 0; xferIndex < stream->XferCount; xferIndex++)
+		{
+			if (stream->Xfers[xferIndex].Overlapped.hEvent)
+				CloseHandle(stream->Xfers[xferIndex].Overlapped.hEvent);
+			if (stream->Xfers[xferIndex].IsoContext)
+				IsoK_Free(stream->Xfers[xferIndex].IsoContext);
+			Mem_Free(&stream->Xfers[xferIndex].Buffer);
+		}
+		Mem_Free(&stream->Xfers);
+	}
+
+	if (stream->Layout)
+		IsoK_FreeLayout(stream->Layout);
+
+	if (stream->Ring.SemFilled)
+		CloseHandle(stream->Ring.SemFilled);
+
+	if (stream->Thread.StopEvent)
+		CloseHandle(stream->Thread.StopEvent);
+
+	if (stream->UsbHandle)
+		PoolHandle_Dec_UsbK((PKUSB_HANDLE_INTERNAL)stream->UsbHandle);
+
+	Mem_Free(&stream->Ring.Packets);
+	Mem_Free(&stream->Ring.Data);
+	Mem_Free(&stream->Packets);
+	Mem_Free(&stream);
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamInit(
+    _out PKISO_STREAM* IsoStream,
+    _in KUSB_HANDLE UsbHandle,
+    _in UCHAR PipeID,
+    _in PKISO_STREAM_PARAMS Params)
+{
+	PKISO_STREAM stream = NULL;
+	PKUSB_HANDLE_INTERNAL usbHandle;
+	USB_ENDPOINT_DESCRIPTOR epDescriptor;
+	KISO_LAYOUT_PARAMS layoutParams;
+	LARGE_INTEGER frequency;
+	UCHAR deviceSpeed = FullSpeed;
+	UINT length;
+	UINT framePackets;
+	INT xferIndex;
+	BOOL success;
+
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+	ErrorParam(!IsHandleValid(Params), Error, "Params");
+	ErrorParam(!(PipeID & 0x0F), Error, "PipeID");
+	ErrorParam(Params->PacketsPerTransfer < 1 || Params->PacketsPerTransfer > MAXSHORT, Error, "Params->PacketsPerTransfer");
+	ErrorParam(Params->MaxPendingTransfers < 2, Error, "Params->MaxPendingTransfers < 2");
+	ErrorParam(USB_ENDPOINT_DIRECTION_OUT(PipeID) && !Params->PacketCB, Error, "Params->PacketCB is required for OUT pipes");
+	ErrorParam(USB_ENDPOINT_DIRECTION_IN(PipeID) && !Params->PacketCB && Params->RingPacketCount < 1, Error, "Params->RingPacketCount");
+
+	usbHandle = (PKUSB_HANDLE_INTERNAL)UsbHandle;
+	ErrorHandle(!IsHandleValid(usbHandle), Error, "UsbHandle");
+
+	success = UsbStack_QuerySelectedEndpoint(UsbHandle, PipeID, FALSE, &epDescriptor);
+	ErrorNoSet(!success, Error, "PipeID not found on selected interface");
+	ErrorParam((epDescriptor.bmAttributes & 0x03) != UsbdPipeTypeIsochronous, Error, "PipeID is not an isochronous endpoint");
+
+	ErrorNoSet(!QueryPerformanceFrequency(&frequency), Error, "QueryPerformanceFrequency failed.");
+
+	stream = Mem_Alloc(sizeof(*stream));
+	ErrorMemory(!stream, Error);
+
+	ErrorSet(!PoolHandle_Inc_UsbK(usbHandle), Error, ERROR_RESOURCE_NOT_AVAILABLE, "->PoolHandle_Inc_UsbK");
+	stream->UsbHandle = UsbHandle;
+
+	memcpy(&stream->DriverAPI, usbHandle->Device->DriverAPI, sizeof(stream->DriverAPI));
+	memcpy(&stream->Params, Params, sizeof(stream->Params));
+	stream->PipeID		= PipeID;
+	stream->Frequency	= frequency.QuadPart;
+
+	length = sizeof(deviceSpeed);
+	stream->DriverAPI.QueryDeviceInformation(UsbHandle, DEVICE_SPEED, &length, &deviceSpeed);
+
+	memset(&layoutParams, 0, sizeof(layoutParams));
+	layoutParams.MaxPacketSize	= epDescriptor.wMaxPacketSize;
+	layoutParams.Interval		= (USHORT)(1 << (min(max(epDescriptor.bInterval, 1), 16) - 1));
+	layoutParams.DeviceSpeed	= deviceSpeed;
+	layoutParams.SampleRate		= Params->SampleRate;
+	layoutParams.BytesPerSample	= Params->BytesPerSample;
+
+	// Transfers start on a frame boundary; on high-speed a partial last frame would leave a gap.
+	framePackets = IsoSched_FramePackets(layoutParams.Interval, deviceSpeed == HighSpeed);
+	ErrorSet(Params->PacketsPerTransfer % framePackets, Error, ERROR_INVALID_PARAMETER,
+	         "PacketsPerTransfer %d does not fill whole frames; use a multiple of %u.", Params->PacketsPerTransfer, framePackets);
+
+	success = IsoK_InitLayout(&stream->Layout, &layoutParams, Params->PacketsPerTransfer);
+	ErrorNoSet(!success, Error, "->IsoK_InitLayout");
+
+	IsoSched_Init(&stream->Sched,
+	              (UINT)Params->PacketsPerTransfer,
+	              layoutParams.Interval,
+	              deviceSpeed == HighSpeed,
+	              Params->FrameLead ? Params->FrameLead : ISO_STREAM_DEFAULT_FRAME_LEAD);
+
+	stream->MaxPacketBytes = (epDescriptor.wMaxPacketSize & 0x7FF) * (1 + ((epDescriptor.wMaxPacketSize >> 11) & 3));
+
+	stream->Packets = Mem_Alloc(sizeof(KISO_STREAM_PACKET) * Params->PacketsPerTransfer);
+	ErrorMemory(!stream->Packets, Error);
+
+	stream->Xfers = Mem_Alloc(sizeof(KISO_STREAM_XFER) * Params->MaxPendingTransfers);
+	ErrorMemory(!stream->Xfers, Error);
+	stream->XferCount = Params->MaxPendingTransfers;
+
+	for (xferIndex = 0; xferIndex < stream->XferCount; xferIndex++)
+	{
+		PKISO_STREAM_XFER xfer = &stream->Xfers[xferIndex];
+
+		xfer->Buffer = Mem_Alloc(stream->MaxPacketBytes * Params->PacketsPerTransfer);
+		ErrorMemory(!xfer->Buffer, Error);
+
+		success = IsoK_Init(&xfer->IsoContext, Params->PacketsPerTransfer, 0);
+		ErrorNoSet(!success, Error, "->IsoK_Init");
+
+		xfer->Overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+		ErrorNoSet(!xfer->Overlapped.hEvent, Error, "CreateEventA failed.");
+	}
+
+	if (USB_ENDPOINT_DIRECTION_IN(PipeID) && !Params->PacketCB)
+	{
+		stream->Ring.Count = Params->RingPacketCount;
+		stream->Ring.Packets = Mem_Alloc(sizeof(KISO_STREAM_PACKET) * stream->Ring.Count);
+		ErrorMemory(!stream->Ring.Packets, Error);
+
+		stream->Ring.Data = Mem_Alloc(stream->MaxPacketBytes * stream->Ring.Count);
+		ErrorMemory(!stream->Ring.Data, Error);
+
+		stream->Ring.SemFilled = CreateSemaphoreA(NULL, 0, stream->Ring.Count, NULL);
+		ErrorNoSet(!stream->Ring.SemFilled, Error, "CreateSemaphoreA failed.");
+	}
+
+	stream->Thread.StopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	ErrorNoSet(!stream->Thread.StopEvent, Error, "CreateEventA failed.");
+
+	*IsoStream = stream;
+	return TRUE;
+
+Error:
+	if (stream)
+		IsoStream_Free(stream);
+	if (IsoStream)
+		*IsoStream = NULL;
+
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamStart(
+    _in PKISO_STREAM IsoStream)
+{
+	unsigned threadID;
+
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+	ErrorSet(IsoStream->Thread.Handle, Error, ERROR_BUSY, "stream is already started");
+
+	memset(&IsoStream->Stats, 0, sizeof(IsoStream->Stats));
+	IsoSched_Reset(&IsoStream->Sched);
+	ResetEvent(IsoStream->Thread.StopEvent);
+
+	InterlockedExchange(&IsoStream->Thread.State, KISO_STREAM_THREADSTATE_STARTED);
+	IsoStream->Thread.Handle = (HANDLE)_beginthreadex(NULL, 0, &IsoStream_ThreadProc, IsoStream, CREATE_SUSPENDED, &threadID);
+	if (!IsoStream->Thread.Handle)
+	{
+		InterlockedExchange(&IsoStream->Thread.State, KISO_STREAM_THREADSTATE_STOPPED);
+		ErrorNoSet(TRUE, Error, "_beginthreadex failed.");
+	}
+
+	SetThreadPriority(IsoStream->Thread.Handle, THREAD_PRIORITY_TIME_CRITICAL);
+	ResumeThread(IsoStream->Thread.Handle);
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamStop(
+    _in PKISO_STREAM IsoStream)
+{
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+	ErrorSet(!IsoStream->Thread.Handle, Error, ERROR_INVALID_STATE, "stream is not started");
+
+	SetEvent(IsoStream->Thread.StopEvent);
+	WaitForSingleObject(IsoStream->Thread.Handle, INFINITE);
+	CloseHandle(IsoStream->Thread.Handle);
+	IsoStream->Thread.Handle = NULL;
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamFree(
+    _in PKISO_STREAM IsoStream)
+{
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+
+	if (IsoStream->Thread.Handle)
+		IsoK_StreamStop(IsoStream);
+
+	IsoStream_Free(IsoStream);
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamRead(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_PACKET Packet,
+    _out PUCHAR Buffer,
+    _in UINT BufferLength,
+    _in UINT TimeoutMS)
+{
+	INT slot;
+
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+	ErrorParam(!IsHandleValid(Packet), Error, "Packet");
+	ErrorParam(!IsHandleValid(Buffer), Error, "Buffer");
+	ErrorSet(!IsoStream->Ring.Count, Error, ERROR_NOT_SUPPORTED, "stream was not created with a packet ring");
+
+	if (WaitForSingleObject(IsoStream->Ring.SemFilled, TimeoutMS) != WAIT_OBJECT_0)
+	{
+		SetLastError(ERROR_SEM_TIMEOUT);
+		return FALSE;
+	}
+
+	mSpin_Acquire(&IsoStream->Ring.Lock);
+	slot = IsoStream->Ring.Head;
+	if (IsoStream->Ring.Packets[slot].Length > BufferLength)
+	{
+		mSpin_Release(&IsoStream->Ring.Lock);
+		ReleaseSemaphore(IsoStream->Ring.SemFilled, 1, NULL);
+		ErrorSet(TRUE, Error, ERROR_MORE_DATA, "Buffer is too small for a %u byte packet.", IsoStream->Ring.Packets[slot].Length);
+	}
+
+	memcpy(Packet, &IsoStream->Ring.Packets[slot], sizeof(*Packet));
+	memcpy(Buffer, Packet->Data, Packet->Length);
+	Packet->Data = Buffer;
+
+	if (++IsoStream->Ring.Head == IsoStream->Ring.Count)
+		IsoStream->Ring.Head = 0;
+	IsoStream->Ring.Filled--;
+	mSpin_Release(&IsoStream->Ring.Lock);
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_StreamGetStats(
+    _in PKISO_STREAM IsoStream,
+    _out PKISO_STREAM_STATS Stats)
+{
+	ErrorHandle(!IsHandleValid(IsoStream), Error, "IsoStream");
+	ErrorParam(!IsHandleValid(Stats), Error, "Stats");
+
+	mSpin_Acquire(&IsoStream->StatsLock);
+	memcpy(Stats, &IsoStream->Stats, sizeof(*Stats));
+	mSpin_Release(&IsoStream->StatsLock);
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
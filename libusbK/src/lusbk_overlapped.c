@@ -27,6 +27,74 @@ binary distributions.
 #define mOvlK_IsComplete(mOverlappedK)	\
 	(WaitForSingleObject(((PKOVL_HANDLE_INTERNAL)mOverlappedK)->Overlapped.hEvent, 0) != WAIT_TIMEOUT)
 
+// Unregisters and frees the pool's completion queue.
+static void o_CQueue_Free(PKOVL_POOL_HANDLE_INTERNAL handle)
+{
+	DWORD transferred;
+
+	if (handle->CQueue.IsRegistered)
+	{
+		AllK->CancelIoEx(handle->UsbHandle->Device->MasterDeviceHandle, (KOVL_HANDLE)&handle->CQueue.Overlapped);
+		GetOverlappedResult(handle->UsbHandle->Device->MasterDeviceHandle, &handle->CQueue.Overlapped, &transferred, TRUE);
+	}
+
+	SafeCloseEvent(handle->CQueue.Overlapped.hEvent);
+	SafeCloseEvent(handle->CQueue.Event);
+	if (handle->CQueue.Buffer) VirtualFree(handle->CQueue.Buffer, 0, MEM_RELEASE);
+
+	memset(&handle->CQueue, 0, sizeof(handle->CQueue));
+}
+
+// Registers a completion queue for the transfers sent on the pool's device handle. If the driver
+// does not support it OvlK_WaitAny finds completions by their events instead; this is not an error.
+static void o_CQueue_Register(PKOVL_POOL_HANDLE_INTERNAL handle, INT MaxOverlappedCount)
+{
+	libusb_request request;
+	unsigned int recordCount;
+	DWORD bufferSize;
+	DWORD errorCode;
+	BOOL success;
+
+	// The registration is cancelled from whichever thread frees the pool.
+	if (!AllK->CancelIoEx) return;
+
+	// Room for the pool's transfers and for other i/o on the same handle.
+	recordCount = CQueue_RecordCount((unsigned int)MaxOverlappedCount * 4);
+	bufferSize = (DWORD)KCQ_BUFFER_SIZE(recordCount);
+
+	handle->CQueue.Buffer = VirtualAlloc(NULL, bufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	handle->CQueue.Event = CreateEventA(NULL, FALSE, FALSE, NULL);
+	handle->CQueue.Overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!handle->CQueue.Buffer || !handle->CQueue.Event || !handle->CQueue.Overlapped.hEvent)
+	{
+		USBWRNN("failed allocating completion queue. ErrorCode=%08Xh", GetLastError());
+		o_CQueue_Free(handle);
+		return;
+	}
+
+	CQueue_InitConsumer(&handle->CQueue.Consumer, handle->CQueue.Buffer, recordCount);
+
+	Mem_Zero(&request, sizeof(request));
+	request.CQueue.BufferLength = bufferSize;
+	request.CQueue.Buffer = handle->CQueue.Buffer;
+	request.CQueue.Event = handle->CQueue.Event;
+
+	// The request stays pending for as long as the queue is registered.
+	success = Ioctl_Async(handle->UsbHandle->Device->MasterDeviceHandle, LIBUSBK_IOCTL_REGISTER_CQUEUE,
+	                      &request, sizeof(request),
+	                      NULL, 0,
+	                      &handle->CQueue.Overlapped);
+	errorCode = GetLastError();
+	if (!success && errorCode == ERROR_IO_PENDING)
+	{
+		handle->CQueue.IsRegistered = TRUE;
+		return;
+	}
+
+	USBDBGN("completion queue not available. ErrorCode=%08Xh", success ? ERROR_SUCCESS : errorCode);
+	o_CQueue_Free(handle);
+}
+
 static void KUSB_API Cleanup_OvlPoolK(PKOVL_POOL_HANDLE_INTERNAL handle)
 {
 	int i;
@@ -34,6 +102,8 @@ static void KUSB_API Cleanup_OvlPoolK(PKOVL_POOL_HANDLE_INTERNAL handle)
 
 	PoolHandle_Dead_OvlPoolK(handle);
 
+	if (handle->UsbHandle) o_CQueue_Free(handle);
+
 	if (handle->UsbHandle) PoolHandle_Dec_UsbK(handle->UsbHandle);
 
 	masterListCount = (int)handle->MasterListCount;
@@ -65,6 +135,7 @@ static void KUSB_API Cleanup_OvlK(PKOVL_HANDLE_INTERNAL handle)
 
 static void o_Reuse(PKOVL_HANDLE_INTERNAL overlapped)
 {
+	overlapped->IsReaped = FALSE;
 	if (!overlapped->Overlapped.hEvent)
 		overlapped->Overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
 	else
@@ -174,6 +245,9 @@ KUSB_EXP BOOL KUSB_API OvlK_Init(
 
 	handle->Flags		= Flags;
 
+	if (Flags & KOVL_POOL_FLAG_COMPLETION_QUEUE)
+		o_CQueue_Register(handle, MaxOverlappedCount);
+
 	*PoolHandle = (KOVL_POOL_HANDLE)handle;
 	PoolHandle_Live_OvlPoolK(handle);
 	return TRUE;
@@ -230,6 +304,199 @@ KUSB_EXP BOOL KUSB_API OvlK_WaitOldest(
 	return OvlK_Wait(ovlEL->Handle, TimeoutMS, WaitFlags, TransferredLength);
 }
 
+// Gets the OverlappedK of this pool a completion record was tagged with; the tag is the user mode address of its
+// OVERLAPPED, so it maps straight to an index of the OvlK handle pool. Returns NULL for any other tag.
+static PKOVL_HANDLE_INTERNAL o_FindAcquired(PKOVL_POOL_HANDLE_INTERNAL handle, unsigned long long tag)
+{
+	PKOVL_HANDLE_INTERNAL overlapped;
+	int index;
+
+	index = CQueue_TagIndex(tag,
+	                        (unsigned long long)(ULONG_PTR)&AllK->OvlK.Handles[0].Overlapped,
+	                        sizeof(AllK->OvlK.Handles[0]),
+	                        (unsigned int)ALLK_HANDLE_COUNT(OvlK));
+	if (index < 0) return NULL;
+
+	overlapped = &AllK->OvlK.Handles[index];
+	return (overlapped->Pool == handle && overlapped->IsAcquired) ? overlapped : NULL;
+}
+
+static BOOL o_HasOutstanding(PKOVL_POOL_HANDLE_INTERNAL handle)
+{
+	PKOVL_EL ovlEL;
+
+	DL_FOREACH(handle->AcquiredList, ovlEL)
+	{
+		if (!ovlEL->Handle->IsReaped)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+// Milliseconds left of TimeoutMS since startTime.
+static DWORD o_TimeLeft(DWORD startTime, INT TimeoutMS)
+{
+	DWORD elapsed;
+
+	if ((DWORD)TimeoutMS == INFINITE) return INFINITE;
+
+	elapsed = GetTickCount() - startTime;
+	return elapsed < (DWORD)TimeoutMS ? (DWORD)TimeoutMS - elapsed : 0;
+}
+
+KUSB_EXP BOOL KUSB_API OvlK_WaitAny(
+    _in KOVL_POOL_HANDLE PoolHandle,
+    _out KOVL_HANDLE* OverlappedK,
+    _inopt INT TimeoutMS,
+    _inopt KOVL_WAIT_FLAG WaitFlags,
+    _out PUINT TransferredLength)
+{
+	PKOVL_POOL_HANDLE_INTERNAL handle;
+	PKOVL_HANDLE_INTERNAL overlapped = NULL;
+	PKOVL_HANDLE_INTERNAL waitList[MAXIMUM_WAIT_OBJECTS];
+	HANDLE waitEvents[MAXIMUM_WAIT_OBJECTS];
+	PKOVL_EL ovlEL;
+	KCQ_RECORD record;
+	DWORD startTime;
+	DWORD waitCount;
+	DWORD waitResult;
+	DWORD errorCode;
+	BOOL useQueue;
+	BOOL fromRecord = FALSE;
+	BOOL success;
+
+	ErrorParamAction(!OverlappedK, "OverlappedK", return FALSE);
+	ErrorParamAction(!TransferredLength, "TransferredLength", return FALSE);
+	*OverlappedK = NULL;
+
+	Pub_To_Priv_OvlPoolK(PoolHandle, handle, return FALSE);
+	ErrorSetAction(!PoolHandle_Inc_OvlPoolK(handle), ERROR_RESOURCE_NOT_AVAILABLE, return FALSE, "->PoolHandle_Inc_OvlPoolK");
+
+	startTime = GetTickCount();
+	for (;;)
+	{
+		// The driver completes the registration request if the queue goes away.
+		useQueue = handle->CQueue.IsRegistered && !HasOverlappedIoCompleted(&handle->CQueue.Overlapped);
+
+		if (useQueue)
+		{
+			// Records for other i/o on the device handle, or for an OverlappedK that was already returned, are skipped.
+			while (CQueue_Reap(&handle->CQueue.Consumer, &record, 1))
+			{
+				overlapped = o_FindAcquired(handle, record.Tag);
+				if (overlapped && !overlapped->IsReaped)
+				{
+					fromRecord = TRUE;
+					goto Found;
+				}
+			}
+			if (CQueue_CheckDropped(&handle->CQueue.Consumer))
+			{
+				USBWRNN("completion queue overflow; scanning acquired OverlappedKs.");
+				handle->CQueue.Dropped = TRUE;
+			}
+		}
+
+		if (useQueue && !handle->CQueue.Dropped)
+		{
+			ErrorSet(!o_HasOutstanding(handle), Error, ERROR_NO_MORE_ITEMS, "No more acquired OverlappedKs");
+
+			if (!CQueue_PrepareWait(&handle->CQueue.Consumer)) continue;
+
+			waitResult = WaitForSingleObjectEx(handle->CQueue.Event, o_TimeLeft(startTime, TimeoutMS), (WaitFlags & KOVL_WAIT_FLAG_ALERTABLE) ? TRUE : FALSE);
+			if (waitResult != WAIT_OBJECT_0)
+				CQueue_CancelWait(&handle->CQueue.Consumer);
+		}
+		else
+		{
+			// Without a queue, or after it lost records, completions are found by their events; only the
+			// MAXIMUM_WAIT_OBJECTS oldest are waited on.
+			waitCount = 0;
+			DL_FOREACH(handle->AcquiredList, ovlEL)
+			{
+				if (ovlEL->Handle->IsReaped) continue;
+
+				overlapped = ovlEL->Handle;
+				if (mOvlK_IsComplete(overlapped)) goto Found;
+
+				if (waitCount < MAXIMUM_WAIT_OBJECTS)
+				{
+					waitList[waitCount] = overlapped;
+					waitEvents[waitCount++] = overlapped->Overlapped.hEvent;
+				}
+			}
+
+			if (!waitCount)
+			{
+				// Nothing is outstanding, so nothing the queue lost can be; go back to using it.
+				handle->CQueue.Dropped = FALSE;
+				ErrorSet(TRUE, Error, ERROR_NO_MORE_ITEMS, "No more acquired OverlappedKs");
+			}
+
+			waitResult = WaitForMultipleObjectsEx(waitCount, waitEvents, FALSE, o_TimeLeft(startTime, TimeoutMS), (WaitFlags & KOVL_WAIT_FLAG_ALERTABLE) ? TRUE : FALSE);
+			if (waitResult < WAIT_OBJECT_0 + waitCount)
+			{
+				overlapped = waitList[waitResult - WAIT_OBJECT_0];
+				goto Found;
+			}
+		}
+
+		if (waitResult == WAIT_TIMEOUT)
+		{
+			errorCode = ERROR_IO_INCOMPLETE;
+			goto Done;
+		}
+		else if (waitResult == WAIT_IO_COMPLETION)
+		{
+			errorCode = WAIT_IO_COMPLETION;
+			goto Done;
+		}
+		else if (waitResult == WAIT_FAILED)
+		{
+			errorCode = GetLastError();
+			USBERRN("wait failed. ErrorCode=%08Xh", errorCode);
+			goto Done;
+		}
+	}
+
+Found:
+	// A successful record is used as is once the OVERLAPPED has completed with the same result; that takes no system
+	// call. The check also rejects a record left from an earlier use of the OverlappedK (one that was found by its
+	// event while its record was still queued) unless the result is the same anyway.
+	if (fromRecord && record.Status == 0 && HasOverlappedIoCompleted(&overlapped->Overlapped) &&
+	        (LONG)overlapped->Overlapped.Internal == record.Status && (UINT)overlapped->Overlapped.InternalHigh == record.Transferred)
+	{
+		*TransferredLength = record.Transferred;
+		Capture_Reaped(&overlapped->Overlapped, TRUE, record.Transferred);
+
+		if (WaitFlags & KOVL_WAIT_FLAG_RELEASE_ON_SUCCESS) OvlK_Release((KOVL_HANDLE)overlapped);
+		errorCode = ERROR_SUCCESS;
+	}
+	else
+	{
+		// Still pending (a record is posted just before the driver completes its request) or failed. If it is not
+		// done by the timeout its record is gone and it is found by its event next time.
+		success = OvlK_Wait((KOVL_HANDLE)overlapped, (INT)o_TimeLeft(startTime, TimeoutMS), (KOVL_WAIT_FLAG)(WaitFlags & ~(KOVL_WAIT_FLAG_RELEASE_ON_TIMEOUT | KOVL_WAIT_FLAG_ALERTABLE)), TransferredLength);
+		errorCode = success ? ERROR_SUCCESS : GetLastError();
+		if (errorCode == ERROR_IO_INCOMPLETE)
+		{
+			handle->CQueue.Dropped = handle->CQueue.IsRegistered;
+			goto Done;
+		}
+	}
+
+	overlapped->IsReaped = TRUE;
+	*OverlappedK = (KOVL_HANDLE)overlapped;
+
+Done:
+	PoolHandle_Dec_OvlPoolK(handle);
+	return LusbwError(errorCode);
+
+Error:
+	PoolHandle_Dec_OvlPoolK(handle);
+	return FALSE;
+}
+
 KUSB_EXP BOOL KUSB_API OvlK_Wait(
     _in KOVL_HANDLE OverlappedK,
     _inopt INT TimeoutMS,
@@ -264,6 +531,7 @@ CancelIoRetry:
 	{
 		// check for an overlapped result regardless of the WaitForSingleObject return value
 		success = GetOverlappedResult(overlapped->Pool->UsbHandle->Device->MasterDeviceHandle, &overlapped->Overlapped, (LPDWORD)TransferredLength, FALSE);
+		Capture_Reaped(&overlapped->Overlapped, success, *TransferredLength);
 		if (!success) errorCode = GetLastError();
 	}
 	else if (errorCode == WAIT_TIMEOUT)
@@ -16,6 +16,7 @@
 #include "lusbk_version.h"
 #include "libusbk.h"
 #include "drv_api.h"
+#include "lusbk_cqueue.h"
 #include "lusbk_debug_view_output.h"
 
 //////////////////////////////////////////////////////////////////////////////
@@ -198,4 +199,15 @@ BOOL GetProcAddress_LUsb0(__out KPROC* ProcAddress, __in LONG FunctionID);
 BOOL GetProcAddress_WUsb(__out KPROC* ProcAddress, __in LONG FunctionID);
 BOOL GetProcAddress_Unsupported(__out KPROC* ProcAddress, __in LONG FunctionID);
 
+//////////////////////////////////////////////////////////////////////////////
+// Workload capture (lusbk_capture.c); enabled by the LIBUSBK_CAPTURE environment variable.
+VOID Capture_Init(VOID);
+VOID Capture_Free(VOID);
+// Capture_Submit is called before a transfer is submitted and returns its
+// submit time; Capture_SubmitResult after. Overlapped transfers complete in
+// Capture_Reaped.
+LONGLONG Capture_Submit(__in UCHAR PipeID, __in UINT Length, __in_opt LPOVERLAPPED Overlapped);
+VOID Capture_SubmitResult(__in_opt LPOVERLAPPED Overlapped, __in UCHAR PipeID, __in LONGLONG SubmitTime, __in BOOL Success, __in_opt PUINT LengthTransferred);
+VOID Capture_Reaped(__in LPOVERLAPPED Overlapped, __in BOOL Success, __in UINT Transferred);
+
 #endif
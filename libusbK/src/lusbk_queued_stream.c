@@ -366,6 +366,7 @@ static BOOL Stm_Thread_ProcessPending(PKSTM_THREAD_INTERNAL stm, DWORD timeoutOv
 	DL_DELETE(stm->ovlList, stm->ovlNext);
 
 	stm->success = GetOverlappedResult(stm->handle->Info->DeviceHandle, &stm->ovlNext->Overlapped, (LPDWORD)&stm->xferNext->Xfer->Public.TransferLength, FALSE);
+	Capture_Reaped(&stm->ovlNext->Overlapped, stm->success, stm->xferNext->Xfer->Public.TransferLength);
 	if (!stm->success)
 	{
 		stm->errorCode = GetLastError();
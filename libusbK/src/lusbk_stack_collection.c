@@ -19,85 +19,52 @@ binary distributions.
 #include "lusbk_private.h"
 #include "lusbk_handles.h"
 #include "lusbk_stack_collection.h"
+#include "lusbk_desc_walk.h"
 
 // warning C4127: conditional expression is constant.
 #pragma warning(disable: 4127)
 
 #ifndef DESCRIPTOR_PARSE_BUILD_STACK___________________________________
 
-typedef struct _DESCRIPTOR_ITERATOR
-{
-	LONG	Remaining;
-
-	union
-	{
-		PUCHAR						Offset;
-
-		PUSB_COMMON_DESCRIPTOR		Comn;
-		PUSB_INTERFACE_DESCRIPTOR	Intf;
-		PUSB_ENDPOINT_DESCRIPTOR	Pipe;
-	} Ptr;
-} DESCRIPTOR_ITERATOR, *PDESCRIPTOR_ITERATOR;
-
-static BOOL u_Desc_Next(PDESCRIPTOR_ITERATOR desc)
-{
-	if (desc->Remaining < sizeof(USB_COMMON_DESCRIPTOR)) return FALSE;
-
-	desc->Remaining -= desc->Ptr.Comn->bLength;
-
-	if (desc->Remaining >= sizeof(USB_COMMON_DESCRIPTOR))
-	{
-		desc->Ptr.Offset += desc->Ptr.Comn->bLength;
-		return TRUE;
-	}
-	return FALSE;
-}
-
-static void u_Add_Pipe(PKUSB_ALT_INTERFACE_EL altInterfaceEL, PDESCRIPTOR_ITERATOR desc)
+// KDESC_WALK::AddPipe
+static int u_Add_Pipe(void* Context, void* AltInterface, const unsigned char* Descriptor)
 {
+	PKUSB_ALT_INTERFACE_EL altInterfaceEL = AltInterface;
+	PUSB_ENDPOINT_DESCRIPTOR pipeDesc = (PUSB_ENDPOINT_DESCRIPTOR)Descriptor;
 	PKUSB_PIPE_EL pipeEL;
-	DESCRIPTOR_ITERATOR descPrev;
 
-	memcpy(&descPrev, desc, sizeof(descPrev));
+	UNREFERENCED_PARAMETER(Context);
 
-	while (u_Desc_Next(desc))
+	FindPipeEL(altInterfaceEL, pipeEL, FALSE, pipeDesc->bEndpointAddress);
+	if (!pipeEL)
 	{
-		if (desc->Ptr.Comn->bDescriptorType == USB_DESCRIPTOR_TYPE_INTERFACE)
-		{
-			memcpy(desc, &descPrev, sizeof(*desc));
-			break;
-		}
-		else if (desc->Ptr.Comn->bDescriptorType == USB_DESCRIPTOR_TYPE_ENDPOINT)
-		{
-			FindPipeEL(altInterfaceEL, pipeEL, FALSE, desc->Ptr.Pipe->bEndpointAddress);
-			if (!pipeEL)
-			{
-				pipeEL = Mem_Alloc(sizeof(*pipeEL));
-				if (!pipeEL) return;
+		pipeEL = Mem_Alloc(sizeof(*pipeEL));
+		if (!pipeEL) return FALSE;
 
-				pipeEL->Descriptor	= desc->Ptr.Pipe;
-				pipeEL->ID			= pipeEL->Descriptor->bEndpointAddress;
-				pipeEL->Index		= altInterfaceEL->PipeCount++;
+		pipeEL->Descriptor	= pipeDesc;
+		pipeEL->ID			= pipeEL->Descriptor->bEndpointAddress;
+		pipeEL->Index		= altInterfaceEL->PipeCount++;
 
-				DL_APPEND(altInterfaceEL->PipeList, pipeEL);
-			}
-		}
-		memcpy(&descPrev, desc, sizeof(descPrev));
+		DL_APPEND(altInterfaceEL->PipeList, pipeEL);
 	}
+	return TRUE;
 }
 
-static void u_Add_Interface(PKUSB_HANDLE_INTERNAL Handle, PDESCRIPTOR_ITERATOR desc)
+// KDESC_WALK::AddInterface
+static void* u_Add_Interface(void* Context, const unsigned char* Descriptor)
 {
+	PKUSB_HANDLE_INTERNAL Handle = Context;
+	PUSB_INTERFACE_DESCRIPTOR intfDesc = (PUSB_INTERFACE_DESCRIPTOR)Descriptor;
 	PKUSB_INTERFACE_EL interfaceEL;
 	PKUSB_ALT_INTERFACE_EL altInterfaceEL;
 
-	FindInterfaceEL(Handle->Device->UsbStack, interfaceEL, FALSE, desc->Ptr.Intf->bInterfaceNumber);
+	FindInterfaceEL(Handle->Device->UsbStack, interfaceEL, FALSE, intfDesc->bInterfaceNumber);
 	if (!interfaceEL)
 	{
 		interfaceEL = Mem_Alloc(sizeof(*interfaceEL));
-		if (!interfaceEL) return;
+		if (!interfaceEL) return NULL;
 
-		interfaceEL->ID		= desc->Ptr.Intf->bInterfaceNumber;
+		interfaceEL->ID		= intfDesc->bInterfaceNumber;
 		interfaceEL->Index	= Handle->Device->UsbStack->InterfaceCount++;
 
 		interfaceEL->SharedInterface		= &Get_SharedInterface(Handle, interfaceEL->Index);
@@ -107,37 +74,32 @@ static void u_Add_Interface(PKUSB_HANDLE_INTERNAL Handle, PDESCRIPTOR_ITERATOR d
 		DL_APPEND(Handle->Device->UsbStack->InterfaceList,	interfaceEL);
 	}
 
-	FindAltInterfaceEL(interfaceEL, altInterfaceEL, FALSE, desc->Ptr.Intf->bAlternateSetting);
+	FindAltInterfaceEL(interfaceEL, altInterfaceEL, FALSE, intfDesc->bAlternateSetting);
 	if (!altInterfaceEL)
 	{
 		altInterfaceEL = Mem_Alloc(sizeof(*altInterfaceEL));
-		if (!altInterfaceEL) return;
+		if (!altInterfaceEL) return NULL;
 
-		altInterfaceEL->Descriptor	= desc->Ptr.Intf;
-		altInterfaceEL->ID			= desc->Ptr.Intf->bAlternateSetting;
+		altInterfaceEL->Descriptor	= intfDesc;
+		altInterfaceEL->ID			= intfDesc->bAlternateSetting;
 		altInterfaceEL->Index		= interfaceEL->AltInterfaceCount++;
 
 		DL_APPEND(interfaceEL->AltInterfaceList, altInterfaceEL);
 	}
 
-	u_Add_Pipe(altInterfaceEL, desc);
+	return altInterfaceEL;
 }
 
 static BOOL u_Init_Config(__in PKUSB_HANDLE_INTERNAL Handle)
 {
 	DWORD errorCode = ERROR_SUCCESS;
-	DESCRIPTOR_ITERATOR desc;
+	KDESC_WALK walk;
 	PUSB_CONFIGURATION_DESCRIPTOR cfg = Handle->Device->ConfigDescriptor;
 
-	Mem_Zero(&desc, sizeof(desc));
-	desc.Ptr.Offset = (PUCHAR)cfg;
-	desc.Remaining = (LONG)cfg->wTotalLength;
-
-	while(u_Desc_Next(&desc))
-	{
-		if (desc.Ptr.Comn->bDescriptorType == USB_DESCRIPTOR_TYPE_INTERFACE)
-			u_Add_Interface(Handle, &desc);
-	}
+	walk.Context		= Handle;
+	walk.AddInterface	= u_Add_Interface;
+	walk.AddPipe		= u_Add_Pipe;
+	DescWalk_Config(&walk, (const unsigned char*)cfg, (LONG)cfg->wTotalLength);
 
 	return LusbwError(errorCode);
 }
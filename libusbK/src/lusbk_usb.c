@@ -163,6 +163,15 @@ BOOL GetProcAddress_UsbK(__out KPROC* ProcAddress, __in LONG FunctionID)
 	case KUSB_FNID_GetCurrentFrameNumber:
 		*ProcAddress = (KPROC)UsbK_GetCurrentFrameNumber;
 		break;
+	case KUSB_FNID_GetPipeStats:
+		*ProcAddress = (KPROC)UsbK_GetPipeStats;
+		break;
+	case KUSB_FNID_SubmitBatch:
+		*ProcAddress = (KPROC)UsbK_SubmitBatch;
+		break;
+	case KUSB_FNID_ReadPackets:
+		*ProcAddress = (KPROC)UsbK_ReadPackets;
+		break;
 	default:
 		return FALSE;
 
@@ -180,6 +189,15 @@ BOOL GetProcAddress_LUsb0(__out KPROC* ProcAddress, __in LONG FunctionID)
 	case KUSB_FNID_IsoWritePipe:
 		GetProcAddress_Unsupported(ProcAddress, FunctionID);
 		return LusbwError(ERROR_NOT_SUPPORTED);
+	case KUSB_FNID_GetPipeStats:
+		GetProcAddress_Unsupported(ProcAddress, FunctionID);
+		return LusbwError(ERROR_NOT_SUPPORTED);
+	case KUSB_FNID_SubmitBatch:
+		GetProcAddress_Unsupported(ProcAddress, FunctionID);
+		return LusbwError(ERROR_NOT_SUPPORTED);
+	case KUSB_FNID_ReadPackets:
+		GetProcAddress_Unsupported(ProcAddress, FunctionID);
+		return LusbwError(ERROR_NOT_SUPPORTED);
 	default:
 		return GetProcAddress_UsbK(ProcAddress, FunctionID);
 	}
@@ -286,6 +304,9 @@ KUSB_EXP BOOL KUSB_API LibK_LoadDriverAPI(
 			CASE_FNID_LOAD(GetCurrentFrameNumber);
 			CASE_FNID_LOAD(GetOverlappedResult);
 			CASE_FNID_LOAD(GetProperty);
+			CASE_FNID_LOAD(GetPipeStats);
+			CASE_FNID_LOAD(SubmitBatch);
+			CASE_FNID_LOAD(ReadPackets);
 
 		default:
 			USBERRN("undeclared api function %u!", fnIdIndex);
@@ -534,6 +555,8 @@ KUSB_EXP BOOL KUSB_API LibK_Context_Init(
 	AllK->StmK.Index = -1;
 	AllK->UsbK.Index = -1;
 
+	Capture_Init();
+
 	USBLOG_PRINTLN("Dynamically allocated as needed:");
 	USBLOG_PRINTLN("\tKLST_DEVINFO = %u bytes each", sizeof(KLST_DEVINFO));
 
@@ -557,6 +580,8 @@ KUSB_EXP VOID KUSB_API LibK_Context_Free(VOID)
 		return;
 	}
 
+	Capture_Free();
+
 #ifdef DEBUG_LOGGING_ENABLED
 	POOLHANDLE_LIB_EXIT_CHECK(HotK);
 	POOLHANDLE_LIB_EXIT_CHECK(LstK);
@@ -18,6 +18,7 @@ binary distributions.
 
 #include "lusbk_private.h"
 #include "lusbk_handles.h"
+#include "lusbk_iso_layout.h"
 
 KUSB_EXP BOOL KUSB_API IsoK_Init(
     _out PKISO_CONTEXT* IsoContext,
@@ -157,3 +158,137 @@ Error:
 	return FALSE;
 }
 
+
+// Private layout table created by IsoK_InitLayout; see KISO_LAYOUT in libusbk.h
+// and lusbk_iso_layout.h.
+struct _KISO_LAYOUT
+{
+	INT NumberOfPackets;
+	INT LayoutCount;
+	INT NextLayout;
+	PUINT TransferLengths;	// [LayoutCount]
+	PKISO_PACKET Packets;	// [LayoutCount * NumberOfPackets]
+};
+
+C_ASSERT(sizeof(KISO_LAYOUT_PACKET) == sizeof(KISO_PACKET));
+C_ASSERT(FIELD_OFFSET(KISO_LAYOUT_PACKET, Length) == FIELD_OFFSET(KISO_PACKET, Length));
+C_ASSERT(FIELD_OFFSET(KISO_LAYOUT_PACKET, Status) == FIELD_OFFSET(KISO_PACKET, Status));
+
+KUSB_EXP BOOL KUSB_API IsoK_InitLayout(
+    _out PKISO_LAYOUT* IsoLayout,
+    _in PKISO_LAYOUT_PARAMS Params,
+    _in INT NumberOfPackets)
+{
+	PKISO_LAYOUT layout = NULL;
+	KISO_LAYOUT_SPEC spec;
+	KISO_LAYOUT_PLAN plan;
+	INT result;
+
+	ErrorHandle(!IsHandleValid(IsoLayout), Error, "IsoLayout");
+	ErrorParam(!IsHandleValid(Params), Error, "Params");
+	ErrorParam(NumberOfPackets < 1 || NumberOfPackets > MAXSHORT, Error, "NumberOfPackets");
+
+	spec.MaxPacketSize	= Params->MaxPacketSize;
+	spec.Interval		= Params->Interval;
+	spec.HighSpeed		= (Params->DeviceSpeed == HighSpeed);
+	spec.SampleRate		= Params->SampleRate;
+	spec.BytesPerSample	= Params->BytesPerSample;
+
+	result = IsoLayout_Plan(&spec, (UINT)NumberOfPackets, &plan);
+	ErrorParam(result == KISO_LAYOUT_BAD_PACKET_SIZE, Error, "Params->MaxPacketSize");
+	ErrorParam(result == KISO_LAYOUT_BAD_SAMPLE_SIZE, Error, "Params->BytesPerSample");
+	ErrorSet(result == KISO_LAYOUT_PACKET_OVERFLOW, Error, ERROR_INVALID_PARAMETER,
+	         "SampleRate %u needs %u bytes per packet; MaxPacketSize allows %u.",
+	         Params->SampleRate, plan.PacketSamples * Params->BytesPerSample, plan.MaxPacketBytes);
+	ErrorSet(result == KISO_LAYOUT_TABLE_TOO_LARGE, Error, ERROR_NOT_SUPPORTED,
+	         "Layout requires more than %u packets in %d packet transfers.", KISO_LAYOUT_MAX_TABLE_PACKETS, NumberOfPackets);
+
+	layout = Mem_Alloc(sizeof(*layout) +
+	                   sizeof(UINT) * plan.LayoutCount +
+	                   sizeof(KISO_PACKET) * plan.LayoutCount * NumberOfPackets);
+	ErrorMemory(!layout, Error);
+
+	layout->NumberOfPackets	= NumberOfPackets;
+	layout->LayoutCount		= (INT)plan.LayoutCount;
+	layout->TransferLengths	= (PUINT)&layout[1];
+	layout->Packets			= (PKISO_PACKET)&layout->TransferLengths[plan.LayoutCount];
+
+	IsoLayout_Build(&spec, &plan, (UINT)NumberOfPackets, layout->TransferLengths, (PKISO_LAYOUT_PACKET)layout->Packets);
+
+	*IsoLayout = layout;
+	return TRUE;
+
+Error:
+	Mem_Free(&layout);
+	if (IsoLayout)
+		*IsoLayout = NULL;
+
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_FreeLayout(
+    _in PKISO_LAYOUT IsoLayout)
+{
+	ErrorHandle(!IsHandleValid(IsoLayout), Error, "IsoLayout");
+	Mem_Free(&IsoLayout);
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_ApplyLayout(
+    _in PKISO_LAYOUT IsoLayout,
+    _ref PKISO_CONTEXT IsoContext,
+    _outopt PUINT TransferLength)
+{
+	INT layoutIndex;
+
+	ErrorHandle(!IsHandleValid(IsoLayout), Error, "IsoLayout");
+	ErrorHandle(!IsHandleValid(IsoContext), Error, "IsoContext");
+	ErrorParam(IsoContext->NumberOfPackets != IsoLayout->NumberOfPackets, Error, "IsoContext->NumberOfPackets");
+
+	layoutIndex = IsoLayout->NextLayout;
+	if (++IsoLayout->NextLayout >= IsoLayout->LayoutCount)
+		IsoLayout->NextLayout = 0;
+
+	memcpy(IsoContext->IsoPackets,
+	       &IsoLayout->Packets[layoutIndex * IsoLayout->NumberOfPackets],
+	       sizeof(KISO_PACKET) * IsoLayout->NumberOfPackets);
+
+	IsoContext->ErrorCount = 0;
+	IsoContext->UrbHdrStatus = 0;
+
+	if (TransferLength)
+		*TransferLength = IsoLayout->TransferLengths[layoutIndex];
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
+
+KUSB_EXP BOOL KUSB_API IsoK_CompactPackets(
+    _in PKISO_CONTEXT IsoContext,
+    _in PUCHAR Buffer,
+    _out PUCHAR Output,
+    _in UINT OutputLength,
+    _out PUINT CompactedLength)
+{
+	INT packetIndex;
+
+	ErrorHandle(!IsHandleValid(IsoContext), Error, "IsoContext");
+	ErrorParam(!IsHandleValid(Buffer), Error, "Buffer");
+	ErrorParam(!IsHandleValid(Output), Error, "Output");
+	ErrorParam(!IsHandleValid(CompactedLength), Error, "CompactedLength");
+
+	packetIndex = IsoLayout_Compact((PKISO_LAYOUT_PACKET)IsoContext->IsoPackets, (UINT)IsoContext->NumberOfPackets,
+	                                Buffer, Output, OutputLength, (unsigned int*)CompactedLength);
+	ErrorSet(packetIndex >= 0, Error, ERROR_MORE_DATA, "Output is full at packet %d.", packetIndex);
+
+	return TRUE;
+
+Error:
+	return FALSE;
+}
@@ -0,0 +1,366 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of batched transfers. (see drv_xfer_batch.h)
+//
+// Validate : range table cases for reads and writes.
+// Fan-out  : drives XFER_BATCH the way Xfer_BatchAdvance does with random
+//            completion order. No more than MaxInFlight transfers are sent
+//            at a time, in descriptor order; after a failure nothing more is
+//            sent and the rest complete cancelled.
+// Capture  : the descriptors are changed after they were captured. Every
+//            transfer must be sent from the captured range, Transferred is
+//            clamped to it, and only the result fields are written back.
+// Racing   : a second thread keeps rewriting the descriptors with valid and
+//            invalid ranges while batches are captured, validated and run.
+//            Every range sent must be one that passed validation.
+//
+// Usage: batch_sim [rounds=<count>] [seed=<seed>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "drv_xfer_batch.h"
+
+#define SIM_MPS				64
+#define SIM_MAX_TRANSFER	(SIM_MPS * 64)
+#define SIM_BUFFER_LENGTH	(SIM_MPS * 1024)
+#define SIM_STATUS_FAILED	(-2)
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static unsigned int Sim_Seed = 1;
+
+static unsigned int Sim_Random(unsigned int range)
+{
+	Sim_Seed = (Sim_Seed * 1103515245) + 12345;
+	return ((Sim_Seed >> 16) & 0x7FFF) % range;
+}
+
+static int Sim_Validate(const XFER_BATCH_ENTRY* entries, unsigned int count, int isRead, unsigned int* badEntry)
+{
+	static XFER_BATCH_RANGE ranges[XFER_BATCH_MAX_ENTRIES];
+
+	XferBatch_Capture(ranges, entries, count);
+	return XferBatch_Validate(ranges, count, SIM_BUFFER_LENGTH, isRead, SIM_MPS, SIM_MAX_TRANSFER, badEntry);
+}
+
+static void Sim_CheckValidate(void)
+{
+	static const struct
+	{
+		unsigned int Offset, Length;
+		int IsRead;
+		int Valid;
+	} cases[] =
+	{
+		{0, SIM_MPS, 1, 1},
+		{0, 0, 1, 0},									// reads need at least one packet
+		{0, 0, 0, 1},									// ZLP write
+		{0, SIM_MPS + 1, 1, 0},							// sub-packet read tail
+		{0, SIM_MPS + 1, 0, 1},
+		{0, SIM_MAX_TRANSFER, 1, 1},
+		{0, SIM_MAX_TRANSFER + SIM_MPS, 1, 0},			// over MaximumTransferSize
+		{SIM_BUFFER_LENGTH - SIM_MPS, SIM_MPS, 1, 1},
+		{SIM_BUFFER_LENGTH - SIM_MPS + 1, SIM_MPS, 0, 0},	// past the buffer end
+		{SIM_BUFFER_LENGTH, 0, 0, 1},
+		{SIM_BUFFER_LENGTH + 1, 0, 0, 0},
+		{0xFFFFFFC0, SIM_MPS, 0, 0},					// offset + length wraps
+	};
+	XFER_BATCH_ENTRY entries[3];
+	unsigned int c, badEntry;
+	int valid;
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		// The case is the middle of three otherwise valid entries.
+		memset(entries, 0, sizeof(entries));
+		entries[0].Length = entries[2].Length = SIM_MPS;
+		entries[1].Offset = cases[c].Offset;
+		entries[1].Length = cases[c].Length;
+
+		valid = Sim_Validate(entries, 3, cases[c].IsRead, &badEntry);
+		SIM_CHECK(valid == cases[c].Valid && badEntry == (valid ? 3u : 1u),
+		          "validate case %u (offset %u length %u %s): valid %d bad entry %u",
+		          c, cases[c].Offset, cases[c].Length, cases[c].IsRead ? "read" : "write", valid, badEntry);
+	}
+
+	SIM_CHECK(!Sim_Validate(entries, 0, 0, &badEntry) && badEntry == 0, "validate: empty batch accepted");
+	SIM_CHECK(!XferBatch_Validate(NULL, XFER_BATCH_MAX_ENTRIES + 1, SIM_BUFFER_LENGTH, 0, SIM_MPS, SIM_MAX_TRANSFER, &badEntry) &&
+	          badEntry == XFER_BATCH_MAX_ENTRIES + 1, "validate: too many entries accepted");
+}
+
+// Runs a captured batch to completion. Completions are delivered in random
+// order; the transfer with send index failAt fails. sent receives the
+// ranges in the order they were sent, sentAtFail how many were sent when
+// the failure completed. Returns the number sent.
+static unsigned int Sim_RunBatch(XFER_BATCH* batch, unsigned int failAt, XFER_BATCH_RANGE* sent,
+                                 volatile XFER_BATCH_ENTRY* mutate, unsigned int* maxInFlight, unsigned int* sentAtFail)
+{
+	unsigned int inFlight[XFER_BATCH_MAX_IN_FLIGHT], inFlightCount = 0, sentCount = 0, entryIndex, pick, finished = 0;
+	XFER_BATCH_NEXT next;
+
+	*maxInFlight = 0;
+	*sentAtFail = 0xFFFFFFFF;
+	while (!finished)
+	{
+		while ((next = XferBatch_Next(batch, &entryIndex)) == XFER_BATCH_SEND)
+		{
+			SIM_CHECK(entryIndex == sentCount, "fan-out: sent entry %u, expected %u", entryIndex, sentCount);
+			sent[sentCount++] = batch->Ranges[entryIndex];
+			inFlight[inFlightCount++] = entryIndex;
+			if (inFlightCount > *maxInFlight) *maxInFlight = inFlightCount;
+
+			// The application rewrites the descriptor once it has been sent.
+			if (mutate)
+			{
+				mutate[entryIndex].Offset = 0xFFFFFFF0;
+				mutate[entryIndex].Length = 0xFFFFFFFF;
+			}
+		}
+		if (next == XFER_BATCH_FINISHED)
+		{
+			finished = 1;
+			break;
+		}
+
+		SIM_CHECK(inFlightCount, "fan-out: waiting with nothing in flight");
+		if (!inFlightCount) break;
+
+		pick = Sim_Random(inFlightCount);
+		entryIndex = inFlight[pick];
+		inFlight[pick] = inFlight[--inFlightCount];
+
+		if (entryIndex == failAt)
+		{
+			*sentAtFail = sentCount;
+			XferBatch_EntryDone(batch, entryIndex, SIM_STATUS_FAILED, batch->Ranges[entryIndex].Length / 2);
+		}
+		else
+			XferBatch_EntryDone(batch, entryIndex, 0, batch->Ranges[entryIndex].Length + SIM_MPS);
+	}
+	return sentCount;
+}
+
+static void Sim_CheckFanOut(unsigned int rounds)
+{
+	static XFER_BATCH_ENTRY entries[XFER_BATCH_MAX_ENTRIES], original[XFER_BATCH_MAX_ENTRIES];
+	static XFER_BATCH_RANGE ranges[XFER_BATCH_MAX_ENTRIES], sent[XFER_BATCH_MAX_ENTRIES];
+	XFER_BATCH batch;
+	unsigned int round, count, pos, failAt, maxInFlight, sentCount, sentAtFail, transferred, badEntry, cancelled;
+	int mutate;
+
+	for (round = 0; round < rounds; round++)
+	{
+		count = 1 + Sim_Random(round % 4 ? 64 : XFER_BATCH_MAX_ENTRIES);
+		failAt = Sim_Random(3) ? 0xFFFFFFFF : Sim_Random(count);
+		mutate = round & 1;
+
+		for (pos = 0; pos < count; pos++)
+		{
+			entries[pos].Length = SIM_MPS * (1 + Sim_Random(SIM_MAX_TRANSFER / SIM_MPS));
+			entries[pos].Offset = Sim_Random(SIM_BUFFER_LENGTH - entries[pos].Length + 1);
+			entries[pos].Transferred = 0xAAAAAAAA;
+			entries[pos].Status = 0x55555555;
+		}
+		memcpy(original, entries, count * sizeof(entries[0]));
+
+		XferBatch_Capture(ranges, entries, count);
+		if (!XferBatch_Validate(ranges, count, SIM_BUFFER_LENGTH, 1, SIM_MPS, SIM_MAX_TRANSFER, &badEntry))
+		{
+			SIM_CHECK(0, "round %u: valid batch rejected at %u", round, badEntry);
+			continue;
+		}
+		XferBatch_Begin(&batch, ranges, entries, count, 1 + Sim_Random(XFER_BATCH_MAX_IN_FLIGHT + 2));
+
+		sentCount = Sim_RunBatch(&batch, failAt, sent, mutate ? entries : NULL, &maxInFlight, &sentAtFail);
+
+		SIM_CHECK(maxInFlight <= batch.MaxInFlight, "round %u: %u in flight, limit %u", round, maxInFlight, batch.MaxInFlight);
+		SIM_CHECK(batch.Finished && batch.InFlight == 0 && batch.Completed == count, "round %u: batch did not finish", round);
+
+		// Nothing is sent once the failure has completed.
+		SIM_CHECK(failAt == 0xFFFFFFFF ? sentCount == count : (sentCount > failAt && sentCount == sentAtFail),
+		          "round %u: %u of %u sent, failure at %u completed after %u", round, sentCount, count, failAt, sentAtFail);
+
+		transferred = 0;
+		cancelled = 0;
+		for (pos = 0; pos < count; pos++)
+		{
+			if (pos < sentCount)
+			{
+				SIM_CHECK(sent[pos].Offset == original[pos].Offset && sent[pos].Length == original[pos].Length,
+				          "round %u: entry %u sent as %u/%u, captured %u/%u", round, pos,
+				          sent[pos].Offset, sent[pos].Length, original[pos].Offset, original[pos].Length);
+				if (pos == failAt)
+				{
+					SIM_CHECK(entries[pos].Status == SIM_STATUS_FAILED && entries[pos].Transferred == original[pos].Length / 2,
+					          "round %u: failed entry %u status %d transferred %u", round, pos, entries[pos].Status, entries[pos].Transferred);
+				}
+				else
+				{
+					// Completion lengths past the range are clamped to the captured length.
+					SIM_CHECK(entries[pos].Transferred == original[pos].Length,
+					          "round %u: entry %u transferred %u, length %u", round, pos, entries[pos].Transferred, original[pos].Length);
+				}
+			}
+			else
+			{
+				cancelled += entries[pos].Status == XFER_BATCH_STATUS_CANCELLED && entries[pos].Transferred == 0;
+			}
+			transferred += entries[pos].Transferred;
+
+			// The driver never writes the ranges back.
+			if (mutate && pos < sentCount)
+				SIM_CHECK(entries[pos].Offset == 0xFFFFFFF0 && entries[pos].Length == 0xFFFFFFFF, "round %u: entry %u range written back", round, pos);
+			else
+				SIM_CHECK(entries[pos].Offset == original[pos].Offset && entries[pos].Length == original[pos].Length,
+				          "round %u: entry %u range written back", round, pos);
+		}
+
+		SIM_CHECK(cancelled == count - sentCount, "round %u: %u of %u unsent entries cancelled", round, cancelled, count - sentCount);
+		SIM_CHECK(transferred == batch.Transferred, "round %u: entries transferred %u, batch %u", round, transferred, batch.Transferred);
+		SIM_CHECK(batch.Status == (failAt == 0xFFFFFFFF ? 0 : SIM_STATUS_FAILED), "round %u: batch status %d", round, batch.Status);
+	}
+
+	// Aborting an idle batch cancels everything.
+	for (pos = 0; pos < 4; pos++)
+	{
+		entries[pos].Offset = 0;
+		entries[pos].Length = SIM_MPS;
+	}
+	XferBatch_Capture(ranges, entries, 4);
+	XferBatch_Begin(&batch, ranges, entries, 4, 2);
+	XferBatch_Abort(&batch, XFER_BATCH_STATUS_CANCELLED);
+	SIM_CHECK(XferBatch_Next(&batch, &pos) == XFER_BATCH_FINISHED && entries[3].Status == XFER_BATCH_STATUS_CANCELLED &&
+	          batch.Status == XFER_BATCH_STATUS_CANCELLED, "abort before send: batch did not finish cancelled");
+}
+
+// Entries rewritten by the racing thread.
+#define SIM_RACE_ENTRIES	64
+
+static volatile XFER_BATCH_ENTRY Sim_RaceEntries[SIM_RACE_ENTRIES];
+static volatile int Sim_RaceStop;
+
+static void* Sim_RaceThread(void* context)
+{
+	unsigned int seed = 7, pos = 0;
+
+	(void)context;
+	while (!Sim_RaceStop)
+	{
+		seed = (seed * 1103515245) + 12345;
+		pos = (pos + 1) % SIM_RACE_ENTRIES;
+
+		// Flip between a valid range and one that is past the buffer, too long or not packet sized.
+		switch ((seed >> 16) % 4)
+		{
+		case 0:
+			Sim_RaceEntries[pos].Offset = 0;
+			Sim_RaceEntries[pos].Length = SIM_MPS;
+			break;
+		case 1:
+			Sim_RaceEntries[pos].Offset = SIM_BUFFER_LENGTH;
+			break;
+		case 2:
+			Sim_RaceEntries[pos].Length = SIM_MAX_TRANSFER * 4;
+			break;
+		default:
+			Sim_RaceEntries[pos].Length = SIM_MPS - 1;
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void Sim_CheckRacing(unsigned int rounds)
+{
+	static XFER_BATCH_ENTRY results[SIM_RACE_ENTRIES];
+	static XFER_BATCH_RANGE ranges[SIM_RACE_ENTRIES], sent[SIM_RACE_ENTRIES];
+	XFER_BATCH batch;
+	pthread_t thread;
+	unsigned int round, pos, sentCount, sentAtFail, maxInFlight, badEntry, accepted = 0, rejected = 0;
+
+	for (pos = 0; pos < SIM_RACE_ENTRIES; pos++)
+	{
+		Sim_RaceEntries[pos].Offset = 0;
+		Sim_RaceEntries[pos].Length = SIM_MPS;
+	}
+	Sim_RaceStop = 0;
+	pthread_create(&thread, NULL, Sim_RaceThread, NULL);
+
+	for (round = 0; round < rounds * 10; round++)
+	{
+		XferBatch_Capture(ranges, Sim_RaceEntries, SIM_RACE_ENTRIES);
+		if (!XferBatch_Validate(ranges, SIM_RACE_ENTRIES, SIM_BUFFER_LENGTH, 1, SIM_MPS, SIM_MAX_TRANSFER, &badEntry))
+		{
+			rejected++;
+			continue;
+		}
+		accepted++;
+
+		// Results go to a private array here so the racing writes cannot be mistaken for them.
+		XferBatch_Begin(&batch, ranges, results, SIM_RACE_ENTRIES, XFER_BATCH_MAX_IN_FLIGHT);
+		sentCount = Sim_RunBatch(&batch, 0xFFFFFFFF, sent, NULL, &maxInFlight, &sentAtFail);
+
+		for (pos = 0; pos < sentCount; pos++)
+		{
+			if (sent[pos].Offset > SIM_BUFFER_LENGTH || sent[pos].Length > SIM_BUFFER_LENGTH - sent[pos].Offset ||
+			        sent[pos].Length > SIM_MAX_TRANSFER || !sent[pos].Length || sent[pos].Length % SIM_MPS)
+			{
+				SIM_CHECK(0, "racing: round %u entry %u sent unvalidated range %u/%u", round, pos, sent[pos].Offset, sent[pos].Length);
+				break;
+			}
+		}
+	}
+
+	Sim_RaceStop = 1;
+	pthread_join(thread, NULL);
+
+	printf("racing  : %u batches captured, %u valid, %u rejected\n", accepted + rejected, accepted, rejected);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 2000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "rounds=", 7))
+			rounds = (unsigned int)atoi(argv[i] + 7);
+		else if (!strncmp(argv[i], "seed=", 5))
+			Sim_Seed = (unsigned int)strtoul(argv[i] + 5, NULL, 0);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	Sim_CheckValidate();
+	Sim_CheckFanOut(rounds);
+	Sim_CheckRacing(rounds);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
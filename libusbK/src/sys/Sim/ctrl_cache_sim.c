@@ -0,0 +1,473 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the control response cache. (see drv_ctrl_cache.h)
+//
+// Classify : which setup packets may be cached, per enabled class.
+// Bounds   : LRU eviction at the CTRL_CACHE_MAX_ENTRIES and the
+//            CTRL_CACHE_ARENA_SIZE bound.
+// Model    : random lookups and inserts of random sizes against a reference
+//            LRU model. The cache must evict the same responses as the
+//            model, stay within both bounds and return the stored bytes
+//            after any number of arena compactions, across a tick wrap.
+// Race     : a response that was in flight when something was invalidated
+//            is not stored; one that was not is.
+// Rules    : each invalidation rule of CtrlCache_OnSetup, CtrlCache_SetFlags
+//            and CtrlCache_Invalidate drops exactly the classes it names.
+//
+// Usage: ctrl_cache_sim [rounds=<count>] [seed=<seed>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drv_ctrl_cache.h"
+
+// bmRequestType values.
+#define SIM_STANDARD_IN		0x80
+#define SIM_STANDARD_OUT	0x00
+#define SIM_CLASS_IN		0xA1
+#define SIM_CLASS_OUT		0x21
+#define SIM_VENDOR_IN		0xC0
+#define SIM_VENDOR_OUT		0x40
+
+// Distinct vendor requests used by the model test.
+#define SIM_MODEL_KEYS		96
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static unsigned int Sim_Seed = 1;
+
+static unsigned int Sim_Random(unsigned int range)
+{
+	Sim_Seed = (Sim_Seed * 1103515245) + 12345;
+	return ((Sim_Seed >> 16) & 0x7FFF) % range;
+}
+
+static unsigned char Sim_Arena[CTRL_CACHE_ARENA_SIZE];
+static CTRL_CACHE Sim_Cache;
+
+static CTRL_CACHE_KEY Sim_Key(unsigned char requestType, unsigned char request, unsigned short value, unsigned short length)
+{
+	CTRL_CACHE_KEY key;
+
+	key.RequestType	= requestType;
+	key.Request		= request;
+	key.Value		= value;
+	key.Index		= 0;
+	key.Length		= length;
+	return key;
+}
+
+// Response bytes for a key; differ per key and per version of the response.
+static void Sim_Fill(unsigned char* data, unsigned int length, unsigned int id, unsigned int version)
+{
+	unsigned int pos;
+
+	for (pos = 0; pos < length; pos++)
+		data[pos] = (unsigned char)(id * 31 + version * 7 + pos);
+}
+
+static int Sim_Insert(const CTRL_CACHE_KEY* key, unsigned int id, unsigned int version, unsigned int length)
+{
+	static unsigned char data[CTRL_CACHE_MAX_RESPONSE];
+
+	Sim_Fill(data, length, id, version);
+	return CtrlCache_Insert(&Sim_Cache, Sim_Cache.Generation, key, data, length);
+}
+
+// Looks a key up and checks the bytes. Returns 1 on a hit with the right data, 0 on a miss, -1 on bad data.
+static int Sim_Lookup(const CTRL_CACHE_KEY* key, unsigned int id, unsigned int version, unsigned int length)
+{
+	static unsigned char buffer[CTRL_CACHE_MAX_RESPONSE], expected[CTRL_CACHE_MAX_RESPONSE];
+	unsigned int got;
+
+	if (!CtrlCache_Lookup(&Sim_Cache, key, buffer, sizeof(buffer), &got))
+		return 0;
+
+	Sim_Fill(expected, length, id, version);
+	return (got == length && !memcmp(buffer, expected, length)) ? 1 : -1;
+}
+
+static void Sim_CheckClassify(void)
+{
+	static const struct
+	{
+		unsigned char RequestType, Request;
+		unsigned short Length;
+		unsigned int Flags;
+		unsigned int Class;
+	} cases[] =
+	{
+		{SIM_STANDARD_IN, 0x06, 18, CTRL_CACHE_ALL, CTRL_CACHE_STANDARD},		// GET_DESCRIPTOR
+		{SIM_STANDARD_IN, 0x00, 2, CTRL_CACHE_ALL, 0},							// GET_STATUS
+		{SIM_STANDARD_IN, 0x08, 1, CTRL_CACHE_ALL, 0},							// GET_CONFIGURATION
+		{SIM_STANDARD_IN, 0x0A, 1, CTRL_CACHE_ALL, 0},							// GET_INTERFACE
+		{0x81, 0x06, 9, CTRL_CACHE_ALL, CTRL_CACHE_STANDARD},					// interface GET_DESCRIPTOR
+		{SIM_STANDARD_IN, 0x06, 18, CTRL_CACHE_CLASS | CTRL_CACHE_VENDOR, 0},
+		{SIM_CLASS_IN, 0x01, 4, CTRL_CACHE_ALL, CTRL_CACHE_CLASS},
+		{SIM_CLASS_IN, 0x01, 4, CTRL_CACHE_STANDARD, 0},
+		{SIM_CLASS_OUT, 0x01, 4, CTRL_CACHE_ALL, 0},
+		{SIM_VENDOR_IN, 0x42, 64, CTRL_CACHE_VENDOR, CTRL_CACHE_VENDOR},
+		{SIM_VENDOR_OUT, 0x42, 64, CTRL_CACHE_ALL, 0},
+		{SIM_VENDOR_IN, 0x42, 0, CTRL_CACHE_ALL, 0},							// no data stage
+		{SIM_VENDOR_IN, 0x42, CTRL_CACHE_MAX_RESPONSE, CTRL_CACHE_ALL, CTRL_CACHE_VENDOR},
+		{SIM_VENDOR_IN, 0x42, CTRL_CACHE_MAX_RESPONSE + 1, CTRL_CACHE_ALL, 0},	// too large
+		{0xE0, 0x42, 64, CTRL_CACHE_ALL, 0},									// reserved type
+		{SIM_VENDOR_IN, 0x42, 64, 0, 0},										// disabled
+	};
+	CTRL_CACHE_KEY key;
+	unsigned int c, requestClass;
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		CtrlCache_SetFlags(&Sim_Cache, cases[c].Flags);
+		key = Sim_Key(cases[c].RequestType, cases[c].Request, 0x0300, cases[c].Length);
+		requestClass = CtrlCache_Classify(&Sim_Cache, &key);
+		SIM_CHECK(requestClass == cases[c].Class, "classify case %u (%02Xh %02Xh length %u flags %u): class %u, expected %u",
+		          c, cases[c].RequestType, cases[c].Request, cases[c].Length, cases[c].Flags, requestClass, cases[c].Class);
+	}
+
+	// A cache without an arena never enables.
+	{
+		CTRL_CACHE empty;
+
+		CtrlCache_Init(&empty, NULL, 0);
+		CtrlCache_SetFlags(&empty, CTRL_CACHE_ALL);
+		key = Sim_Key(SIM_VENDOR_IN, 0x42, 0, 64);
+		SIM_CHECK(empty.Flags == 0 && !CtrlCache_Classify(&empty, &key), "cache without an arena enabled");
+	}
+}
+
+static void Sim_CheckBounds(void)
+{
+	CTRL_CACHE_KEY key;
+	unsigned int id;
+
+	// Entry bound: fill every entry, touch all but entry 5, insert one more.
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+	for (id = 0; id < CTRL_CACHE_MAX_ENTRIES; id++)
+	{
+		key = Sim_Key(SIM_VENDOR_IN, 1, (unsigned short)id, 16);
+		Sim_Insert(&key, id, 0, 16);
+	}
+	for (id = 0; id < CTRL_CACHE_MAX_ENTRIES; id++)
+	{
+		key = Sim_Key(SIM_VENDOR_IN, 1, (unsigned short)id, 16);
+		if (id != 5) Sim_Lookup(&key, id, 0, 16);
+	}
+	key = Sim_Key(SIM_VENDOR_IN, 1, 1000, 16);
+	Sim_Insert(&key, 1000, 0, 16);
+
+	SIM_CHECK(Sim_Cache.EntryCount == CTRL_CACHE_MAX_ENTRIES && Sim_Cache.Evictions == 1,
+	          "entry bound: %u entries, %u evictions", Sim_Cache.EntryCount, Sim_Cache.Evictions);
+	key = Sim_Key(SIM_VENDOR_IN, 1, 5, 16);
+	SIM_CHECK(Sim_Lookup(&key, 5, 0, 16) == 0, "entry bound: least recently used entry was kept");
+	for (id = 0; id < CTRL_CACHE_MAX_ENTRIES; id++)
+	{
+		key = Sim_Key(SIM_VENDOR_IN, 1, (unsigned short)id, 16);
+		if (id != 5) SIM_CHECK(Sim_Lookup(&key, id, 0, 16) == 1, "entry bound: entry %u lost", id);
+	}
+
+	// Arena bound: four largest responses fill it exactly; a fifth evicts the least recent.
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+	for (id = 0; id < CTRL_CACHE_ARENA_SIZE / CTRL_CACHE_MAX_RESPONSE; id++)
+	{
+		key = Sim_Key(SIM_VENDOR_IN, 2, (unsigned short)id, CTRL_CACHE_MAX_RESPONSE);
+		Sim_Insert(&key, id, 0, CTRL_CACHE_MAX_RESPONSE);
+	}
+	SIM_CHECK(Sim_Cache.ArenaUsed == CTRL_CACHE_ARENA_SIZE && Sim_Cache.Evictions == 0,
+	          "arena bound: %u bytes used, %u evictions", Sim_Cache.ArenaUsed, Sim_Cache.Evictions);
+
+	key = Sim_Key(SIM_VENDOR_IN, 2, 0, CTRL_CACHE_MAX_RESPONSE);
+	Sim_Lookup(&key, 0, 0, CTRL_CACHE_MAX_RESPONSE);
+	key = Sim_Key(SIM_VENDOR_IN, 2, 100, CTRL_CACHE_MAX_RESPONSE);
+	Sim_Insert(&key, 100, 0, 1);
+
+	// One byte does not fit; entry 1 is now the least recently used.
+	SIM_CHECK(Sim_Cache.Evictions == 1 && Sim_Cache.ArenaUsed == CTRL_CACHE_ARENA_SIZE - CTRL_CACHE_MAX_RESPONSE + 1,
+	          "arena bound: %u evictions, %u bytes used", Sim_Cache.Evictions, Sim_Cache.ArenaUsed);
+	key = Sim_Key(SIM_VENDOR_IN, 2, 1, CTRL_CACHE_MAX_RESPONSE);
+	SIM_CHECK(Sim_Lookup(&key, 1, 0, CTRL_CACHE_MAX_RESPONSE) == 0, "arena bound: least recently used response was kept");
+	for (id = 0; id < 4; id++)
+	{
+		key = Sim_Key(SIM_VENDOR_IN, 2, (unsigned short)id, CTRL_CACHE_MAX_RESPONSE);
+		if (id != 1) SIM_CHECK(Sim_Lookup(&key, id, 0, CTRL_CACHE_MAX_RESPONSE) == 1, "arena bound: response %u lost or damaged", id);
+	}
+
+	// A response longer than the request is cut to wLength.
+	key = Sim_Key(SIM_VENDOR_IN, 3, 0, 8);
+	Sim_Insert(&key, 7, 0, 64);
+	SIM_CHECK(Sim_Lookup(&key, 7, 0, 8) == 1, "response longer than wLength not cut");
+}
+
+typedef struct _SIM_MODEL_ENTRY
+{
+	int Present;
+	unsigned int Length;
+	unsigned int Version;
+	unsigned int LastUse;
+} SIM_MODEL_ENTRY;
+
+static void Sim_CheckModel(unsigned int rounds)
+{
+	static SIM_MODEL_ENTRY model[SIM_MODEL_KEYS];
+	CTRL_CACHE_KEY key;
+	unsigned int round, id, pos, count, used, oldest, tick = 0, hits = 0, evictions = 0, length;
+	int result, expected;
+
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+	memset(model, 0, sizeof(model));
+
+	// Start near the end of the tick range; eviction compares ages, so the wrap must not matter.
+	Sim_Cache.Tick = 0xFFFFFF00;
+
+	for (round = 0; round < rounds * 50; round++)
+	{
+		id = Sim_Random(SIM_MODEL_KEYS);
+		key = Sim_Key(SIM_VENDOR_IN, 4, (unsigned short)id, CTRL_CACHE_MAX_RESPONSE);
+
+		if (Sim_Random(2))
+		{
+			// Lookup.
+			result = Sim_Lookup(&key, id, model[id].Version, model[id].Length);
+			expected = model[id].Present;
+			SIM_CHECK(result == expected, "model: round %u key %u lookup %d, expected %d", round, id, result, expected);
+			if (result != expected) break;
+			if (expected)
+			{
+				model[id].LastUse = ++tick;
+				hits++;
+			}
+			continue;
+		}
+
+		// Insert; mostly small responses with an occasional large one.
+		length = Sim_Random(8) ? Sim_Random(600) : Sim_Random(CTRL_CACHE_MAX_RESPONSE + 1);
+		model[id].Present = 0;
+		for (;;)
+		{
+			count = used = 0;
+			oldest = SIM_MODEL_KEYS;
+			for (pos = 0; pos < SIM_MODEL_KEYS; pos++)
+			{
+				if (!model[pos].Present) continue;
+				count++;
+				used += model[pos].Length;
+				if (oldest == SIM_MODEL_KEYS || model[pos].LastUse < model[oldest].LastUse)
+					oldest = pos;
+			}
+			if (!count || (count < CTRL_CACHE_MAX_ENTRIES && CTRL_CACHE_ARENA_SIZE - used >= length))
+				break;
+			model[oldest].Present = 0;
+			evictions++;
+		}
+		model[id].Present = 1;
+		model[id].Length = length;
+		model[id].Version++;
+		model[id].LastUse = ++tick;
+
+		Sim_Insert(&key, id, model[id].Version, length);
+		SIM_CHECK(Sim_Cache.EntryCount == count + 1 && Sim_Cache.ArenaUsed == used + length,
+		          "model: round %u: %u entries %u bytes, expected %u and %u", round, Sim_Cache.EntryCount, Sim_Cache.ArenaUsed, count + 1, used + length);
+		SIM_CHECK(Sim_Cache.EntryCount <= CTRL_CACHE_MAX_ENTRIES && Sim_Cache.ArenaUsed <= CTRL_CACHE_ARENA_SIZE,
+		          "model: round %u: bounds exceeded", round);
+		if (Sim_Failed) break;
+	}
+
+	SIM_CHECK(Sim_Cache.Evictions == evictions, "model: %u evictions, expected %u", Sim_Cache.Evictions, evictions);
+	printf("model   : %u operations, %u hits, %u evictions\n", round, hits, evictions);
+}
+
+static void Sim_CheckRace(void)
+{
+	static const unsigned char data[4] = {1, 2, 3, 4};
+	CTRL_CACHE_KEY key = Sim_Key(SIM_VENDOR_IN, 5, 0, 4);
+	CTRL_CACHE_KEY other = Sim_Key(SIM_CLASS_OUT, 1, 0, 0);
+	unsigned int generation, length;
+	unsigned char buffer[4];
+
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+
+	// Nothing happened while the request was in flight.
+	generation = Sim_Cache.Generation;
+	SIM_CHECK(CtrlCache_Insert(&Sim_Cache, generation, &key, data, 4), "race: response not stored");
+
+	// A reset while the request was in flight.
+	CtrlCache_Invalidate(&Sim_Cache, CTRL_CACHE_ALL);
+	generation = Sim_Cache.Generation;
+	CtrlCache_Invalidate(&Sim_Cache, CTRL_CACHE_ALL);
+	SIM_CHECK(!CtrlCache_Insert(&Sim_Cache, generation, &key, data, 4) &&
+	          !CtrlCache_Lookup(&Sim_Cache, &key, buffer, sizeof(buffer), &length), "race: response stored after a reset");
+
+	// A class OUT request sent while a vendor request was in flight; any invalidation counts.
+	generation = Sim_Cache.Generation;
+	CtrlCache_OnSetup(&Sim_Cache, &other);
+	SIM_CHECK(!CtrlCache_Insert(&Sim_Cache, generation, &key, data, 4), "race: response stored after an OUT request");
+
+	// The class was disabled and enabled again while the request was in flight.
+	generation = Sim_Cache.Generation;
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_STANDARD);
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+	SIM_CHECK(!CtrlCache_Insert(&Sim_Cache, generation, &key, data, 4), "race: response stored after a policy change");
+
+	// The generation counter wraps.
+	Sim_Cache.Generation = 0xFFFFFFFF;
+	generation = Sim_Cache.Generation;
+	CtrlCache_Invalidate(&Sim_Cache, CTRL_CACHE_VENDOR);
+	SIM_CHECK(Sim_Cache.Generation == 0 && !CtrlCache_Insert(&Sim_Cache, generation, &key, data, 4), "race: generation wrap");
+	SIM_CHECK(CtrlCache_Insert(&Sim_Cache, Sim_Cache.Generation, &key, data, 4), "race: response not stored after wrap");
+
+	// Two identical requests in flight; the newer response is kept.
+	generation = Sim_Cache.Generation;
+	CtrlCache_Insert(&Sim_Cache, generation, &key, data, 2);
+	CtrlCache_Insert(&Sim_Cache, generation, &key, data + 1, 3);
+	SIM_CHECK(Sim_Cache.EntryCount == 1 && CtrlCache_Lookup(&Sim_Cache, &key, buffer, sizeof(buffer), &length) &&
+	          length == 3 && buffer[0] == 2, "race: duplicate response kept %u entries", Sim_Cache.EntryCount);
+}
+
+// Fills the cache with one response per class.
+static void Sim_FillClasses(unsigned int flags)
+{
+	CTRL_CACHE_KEY key;
+
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+	CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+
+	key = Sim_Key(SIM_STANDARD_IN, 0x06, 0x0300, 4);
+	Sim_Insert(&key, CTRL_CACHE_STANDARD, 0, 4);
+	key = Sim_Key(SIM_CLASS_IN, 0x01, 0, 4);
+	Sim_Insert(&key, CTRL_CACHE_CLASS, 0, 4);
+	key = Sim_Key(SIM_VENDOR_IN, 0x01, 0, 4);
+	Sim_Insert(&key, CTRL_CACHE_VENDOR, 0, 4);
+
+	CtrlCache_SetFlags(&Sim_Cache, flags);
+}
+
+// Gets the classes that still have a cached response.
+static unsigned int Sim_CachedClasses(void)
+{
+	CTRL_CACHE_KEY key;
+	unsigned int classes = 0;
+
+	key = Sim_Key(SIM_STANDARD_IN, 0x06, 0x0300, 4);
+	if (Sim_Lookup(&key, CTRL_CACHE_STANDARD, 0, 4) == 1) classes |= CTRL_CACHE_STANDARD;
+	key = Sim_Key(SIM_CLASS_IN, 0x01, 0, 4);
+	if (Sim_Lookup(&key, CTRL_CACHE_CLASS, 0, 4) == 1) classes |= CTRL_CACHE_CLASS;
+	key = Sim_Key(SIM_VENDOR_IN, 0x01, 0, 4);
+	if (Sim_Lookup(&key, CTRL_CACHE_VENDOR, 0, 4) == 1) classes |= CTRL_CACHE_VENDOR;
+
+	return classes;
+}
+
+static void Sim_CheckRules(void)
+{
+	static const struct
+	{
+		const char* Name;
+		unsigned char RequestType, Request;
+		unsigned int Kept;
+	} setups[] =
+	{
+		{"SET_CONFIGURATION", SIM_STANDARD_OUT, 0x09, 0},
+		{"SET_INTERFACE", 0x01, 0x0B, CTRL_CACHE_STANDARD},
+		{"SET_DESCRIPTOR", SIM_STANDARD_OUT, 0x07, CTRL_CACHE_CLASS | CTRL_CACHE_VENDOR},
+		{"SET_ADDRESS", SIM_STANDARD_OUT, 0x05, CTRL_CACHE_ALL},
+		{"SET_FEATURE", SIM_STANDARD_OUT, 0x03, CTRL_CACHE_ALL},
+		{"CLEAR_FEATURE", 0x02, 0x01, CTRL_CACHE_ALL},
+		{"class OUT", SIM_CLASS_OUT, 0x01, CTRL_CACHE_STANDARD | CTRL_CACHE_VENDOR},
+		{"vendor OUT", SIM_VENDOR_OUT, 0x01, CTRL_CACHE_STANDARD | CTRL_CACHE_CLASS},
+		{"standard IN", SIM_STANDARD_IN, 0x00, CTRL_CACHE_ALL},
+		{"class IN", SIM_CLASS_IN, 0x02, CTRL_CACHE_ALL},
+		{"vendor IN", SIM_VENDOR_IN, 0x02, CTRL_CACHE_ALL},
+	};
+	CTRL_CACHE_KEY key;
+	unsigned int c, flags, kept;
+
+	for (c = 0; c < sizeof(setups) / sizeof(setups[0]); c++)
+	{
+		Sim_FillClasses(CTRL_CACHE_ALL);
+		key = Sim_Key(setups[c].RequestType, setups[c].Request, 1, 0);
+		CtrlCache_OnSetup(&Sim_Cache, &key);
+		kept = Sim_CachedClasses();
+		SIM_CHECK(kept == setups[c].Kept, "rules: %s kept classes %u, expected %u", setups[c].Name, kept, setups[c].Kept);
+	}
+
+	// OUT requests of a class the policy does not cache leave the other classes alone.
+	Sim_FillClasses(CTRL_CACHE_STANDARD | CTRL_CACHE_VENDOR);
+	key = Sim_Key(SIM_CLASS_OUT, 0x01, 1, 0);
+	CtrlCache_OnSetup(&Sim_Cache, &key);
+	kept = Sim_CachedClasses();
+	SIM_CHECK(kept == (CTRL_CACHE_STANDARD | CTRL_CACHE_VENDOR), "rules: class OUT with class caching off kept %u", kept);
+
+	// Disabling classes drops exactly those classes.
+	for (flags = 0; flags <= CTRL_CACHE_ALL; flags++)
+	{
+		Sim_FillClasses(flags);
+		CtrlCache_SetFlags(&Sim_Cache, CTRL_CACHE_ALL);
+		kept = Sim_CachedClasses();
+		SIM_CHECK(kept == flags, "rules: policy %u kept classes %u", flags, kept);
+	}
+
+	// Reset, set configuration and resume drop everything; an alternate setting change drops class and vendor.
+	Sim_FillClasses(CTRL_CACHE_ALL);
+	CtrlCache_Invalidate(&Sim_Cache, CTRL_CACHE_ALL);
+	SIM_CHECK(Sim_CachedClasses() == 0 && Sim_Cache.EntryCount == 0 && Sim_Cache.ArenaUsed == 0, "rules: reset kept responses");
+
+	Sim_FillClasses(CTRL_CACHE_ALL);
+	CtrlCache_Invalidate(&Sim_Cache, CTRL_CACHE_CLASS | CTRL_CACHE_VENDOR);
+	kept = Sim_CachedClasses();
+	SIM_CHECK(kept == CTRL_CACHE_STANDARD, "rules: alternate setting change kept classes %u", kept);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 2000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "rounds=", 7))
+			rounds = (unsigned int)atoi(argv[i] + 7);
+		else if (!strncmp(argv[i], "seed=", 5))
+			Sim_Seed = (unsigned int)strtoul(argv[i] + 5, NULL, 0);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	CtrlCache_Init(&Sim_Cache, Sim_Arena, sizeof(Sim_Arena));
+
+	Sim_CheckClassify();
+	Sim_CheckBounds();
+	Sim_CheckModel(rounds);
+	Sim_CheckRace();
+	Sim_CheckRules();
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
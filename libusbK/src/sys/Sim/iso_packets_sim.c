@@ -0,0 +1,329 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of iso packet validation and packet templates. (see drv_iso_packets.h)
+//
+// Table tests for IsoPackets_CheckCount and IsoPackets_BuildUrbTable, then
+// packet templates: a template built once and expanded with
+// IsoPackets_CopyTemplate must give the same URB packet table as
+// converting the user packets for every transfer, for random layouts and
+// transfer lengths. Then reports the cost per transfer of both paths.
+//
+// Usage: iso_packets_sim [loops=<count>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "drv_iso_packets.h"
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static double Sim_Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void Sim_CheckCount(void)
+{
+	static const struct
+	{
+		int Count;
+		int HighSpeed;
+		ISO_PACKETS_RESULT Result;
+	} cases[] =
+	{
+		{0,    0, ISO_PACKETS_INVALID_COUNT},
+		{1,    0, ISO_PACKETS_SUCCESS},
+		{7,    0, ISO_PACKETS_SUCCESS},
+		{255,  0, ISO_PACKETS_SUCCESS},
+		{256,  0, ISO_PACKETS_INVALID_COUNT},
+		{-8,   1, ISO_PACKETS_INVALID_COUNT},
+		{0,    1, ISO_PACKETS_INVALID_COUNT},
+		{1,    1, ISO_PACKETS_INVALID_COUNT},
+		{7,    1, ISO_PACKETS_INVALID_COUNT},
+		{8,    1, ISO_PACKETS_SUCCESS},
+		{12,   1, ISO_PACKETS_INVALID_COUNT},
+		{256,  1, ISO_PACKETS_SUCCESS},
+		{1024, 1, ISO_PACKETS_SUCCESS},
+		{1032, 1, ISO_PACKETS_INVALID_COUNT},
+	};
+	unsigned int i;
+	ISO_PACKETS_RESULT result;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		result = IsoPackets_CheckCount(cases[i].Count, cases[i].HighSpeed, cases[i].HighSpeed ? ISO_PACKETS_MAX_HS : ISO_PACKETS_MAX_FS);
+		SIM_CHECK(result == cases[i].Result, "CheckCount(%d, %s) = %d, expected %d",
+		          cases[i].Count, cases[i].HighSpeed ? "HS" : "FS", result, cases[i].Result);
+	}
+}
+
+static void Sim_CheckUrbTable(void)
+{
+	static const struct
+	{
+		const char* Name;
+		unsigned int Offsets[4];
+		unsigned int MaxBytesPerInterval;
+		unsigned int DataLength;
+		ISO_PACKETS_RESULT Result;
+		int ErrorIndex;
+	} cases[] =
+	{
+		{"fixed stride",          {0, 192, 384, 576},  192, 768, ISO_PACKETS_SUCCESS,         -1},
+		{"short packets",         {0, 100, 150, 150},  192, 768, ISO_PACKETS_SUCCESS,         -1},
+		{"last in range",         {0, 192, 384, 767},  192 * 3, 768, ISO_PACKETS_SUCCESS,     -1},
+		{"last out of range",     {0, 192, 384, 768},  192 * 3, 768, ISO_PACKETS_OUT_OF_RANGE, 3},
+		{"first out of range",    {800, 0, 0, 0},      0,   768, ISO_PACKETS_OUT_OF_RANGE,     0},
+		{"unsorted, no limit",    {576, 0, 384, 192},  0,   768, ISO_PACKETS_SUCCESS,         -1},
+		{"unsorted, limit",       {0, 384, 192, 576},  192, 768, ISO_PACKETS_PACKET_TOO_LONG,  1},
+		{"out of order",          {0, 192, 100, 576},  192, 768, ISO_PACKETS_INVALID_ORDER,    2},
+		{"packet too long",       {0, 192, 385, 576},  192, 768, ISO_PACKETS_PACKET_TOO_LONG,  2},
+		{"first offset too long", {193, 385, 577, 600}, 192, 768, ISO_PACKETS_PACKET_TOO_LONG, 0},
+	};
+	ISO_USER_PACKET packets[4];
+	ISO_URB_PACKET urbPackets[4];
+	ISO_PACKETS_RESULT result;
+	unsigned int i, p;
+	int errorIndex;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		for (p = 0; p < 4; p++)
+		{
+			packets[p].Offset = cases[i].Offsets[p];
+			packets[p].Length = 0x5555;		// user lengths and status are not passed to the URB.
+			packets[p].Status = 0xAAAA;
+		}
+		memset(urbPackets, 0xFF, sizeof(urbPackets));
+
+		result = IsoPackets_BuildUrbTable(packets, 4, cases[i].MaxBytesPerInterval, cases[i].DataLength, urbPackets, &errorIndex);
+		SIM_CHECK(result == cases[i].Result && errorIndex == cases[i].ErrorIndex,
+		          "BuildUrbTable %s: result %d index %d, expected %d index %d",
+		          cases[i].Name, result, errorIndex, cases[i].Result, cases[i].ErrorIndex);
+
+		if (result != ISO_PACKETS_SUCCESS) continue;
+		for (p = 0; p < 4; p++)
+		{
+			SIM_CHECK(urbPackets[p].Offset == packets[p].Offset && urbPackets[p].Length == 0 && urbPackets[p].Status == 0,
+			          "BuildUrbTable %s: URB packet %u is %u/%u/%d", cases[i].Name, p, urbPackets[p].Offset, urbPackets[p].Length, urbPackets[p].Status);
+		}
+	}
+}
+
+// A template allocated with ISO_PACKET_TEMPLATE_SIZE holds every packet.
+static ISO_PACKET_TEMPLATE* Sim_AllocTemplate(int numberOfPackets)
+{
+	unsigned char* memory = malloc(ISO_PACKET_TEMPLATE_SIZE(numberOfPackets) + 16);
+	memset(memory + ISO_PACKET_TEMPLATE_SIZE(numberOfPackets), 0xCD, 16);
+	return (ISO_PACKET_TEMPLATE*)memory;
+}
+
+static int Sim_TemplateOverrun(ISO_PACKET_TEMPLATE* packetTemplate, int numberOfPackets)
+{
+	unsigned char* guard = (unsigned char*)packetTemplate + ISO_PACKET_TEMPLATE_SIZE(numberOfPackets);
+	int i;
+
+	for (i = 0; i < 16; i++)
+		if (guard[i] != 0xCD) return 1;
+	return 0;
+}
+
+static void Sim_CheckTemplate(void)
+{
+	ISO_USER_PACKET packets[16];
+	ISO_PACKET_TEMPLATE* packetTemplate;
+	ISO_PACKETS_RESULT result;
+	int errorIndex, p;
+
+	for (p = 0; p < 16; p++)
+	{
+		packets[p].Offset = (unsigned int)p * 1024;
+		packets[p].Length = 0;
+		packets[p].Status = 0;
+	}
+
+	// High-speed templates are whole frames.
+	packetTemplate = Sim_AllocTemplate(12);
+	result = IsoPackets_BuildTemplate(packets, 12, 1, 1024, packetTemplate, &errorIndex);
+	SIM_CHECK(result == ISO_PACKETS_INVALID_COUNT && errorIndex == -1, "BuildTemplate: 12 HS packets gave %d", result);
+	result = IsoPackets_BuildTemplate(packets, 12, 0, 1024, packetTemplate, &errorIndex);
+	SIM_CHECK(result == ISO_PACKETS_SUCCESS, "BuildTemplate: 12 FS packets gave %d", result);
+	SIM_CHECK(packetTemplate->NumberOfPackets == 12 && packetTemplate->LastOffset == 11 * 1024,
+	          "BuildTemplate: %d packets, last offset %u", packetTemplate->NumberOfPackets, packetTemplate->LastOffset);
+	SIM_CHECK(!Sim_TemplateOverrun(packetTemplate, 12), "BuildTemplate: wrote past ISO_PACKET_TEMPLATE_SIZE(12)");
+	free(packetTemplate);
+
+	// Packet 5 is 1025 bytes; reported at the offset after it.
+	packets[6].Offset++;
+	packetTemplate = Sim_AllocTemplate(16);
+	result = IsoPackets_BuildTemplate(packets, 16, 1, 1024, packetTemplate, &errorIndex);
+	SIM_CHECK(result == ISO_PACKETS_PACKET_TOO_LONG && errorIndex == 6, "BuildTemplate: long packet gave %d index %d", result, errorIndex);
+
+	// Without a packet size limit only the order is free; the buffer length is checked per transfer.
+	result = IsoPackets_BuildTemplate(packets, 16, 1, 0, packetTemplate, &errorIndex);
+	SIM_CHECK(result == ISO_PACKETS_SUCCESS && packetTemplate->LastOffset == 15 * 1024, "BuildTemplate: no limit gave %d", result);
+
+	SIM_CHECK(IsoPackets_CheckTemplateLength(packetTemplate, 15 * 1024) == ISO_PACKETS_OUT_OF_RANGE, "CheckTemplateLength: buffer ending at the last offset accepted");
+	SIM_CHECK(IsoPackets_CheckTemplateLength(packetTemplate, 15 * 1024 + 1) == ISO_PACKETS_SUCCESS, "CheckTemplateLength: one byte last packet rejected");
+	SIM_CHECK(IsoPackets_CheckTemplateLength(packetTemplate, 0) == ISO_PACKETS_OUT_OF_RANGE, "CheckTemplateLength: empty buffer accepted");
+	SIM_CHECK(!Sim_TemplateOverrun(packetTemplate, 16), "BuildTemplate: wrote past ISO_PACKET_TEMPLATE_SIZE(16)");
+	free(packetTemplate);
+}
+
+static unsigned int Sim_Random(unsigned int* seed)
+{
+	*seed = (*seed * 1103515245) + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+// Expanding a template must match converting the same packets per transfer.
+static void Sim_CheckExpansion(void)
+{
+	static ISO_USER_PACKET packets[ISO_PACKETS_MAX_HS];
+	static ISO_URB_PACKET expected[ISO_PACKETS_MAX_HS];
+	static ISO_URB_PACKET expanded[ISO_PACKETS_MAX_HS + 1];
+	ISO_PACKET_TEMPLATE* packetTemplate;
+	unsigned int seed = 1, offset, mps, dataLength;
+	int round, p, count, highSpeed, errorIndex, mismatches = 0;
+	ISO_PACKETS_RESULT templateResult, urbResult;
+
+	for (round = 0; round < 2000; round++)
+	{
+		highSpeed = round & 1;
+		count = highSpeed ? 8 * (1 + (int)(Sim_Random(&seed) % 128)) : 1 + (int)(Sim_Random(&seed) % 255);
+		mps = highSpeed ? 1024 * (1 + Sim_Random(&seed) % 3) : 1023;
+
+		offset = 0;
+		for (p = 0; p < count; p++)
+		{
+			packets[p].Offset = offset;
+			offset += Sim_Random(&seed) % (mps + 1);
+		}
+
+		packetTemplate = Sim_AllocTemplate(count);
+		templateResult = IsoPackets_BuildTemplate(packets, count, highSpeed, mps, packetTemplate, &errorIndex);
+		if (templateResult != ISO_PACKETS_SUCCESS)
+		{
+			SIM_CHECK(0, "expansion round %d: template of %d packets gave %d at %d", round, count, templateResult, errorIndex);
+			free(packetTemplate);
+			continue;
+		}
+
+		// Transfer lengths around the last packet offset.
+		dataLength = packetTemplate->LastOffset + (Sim_Random(&seed) % 3) - 1 + (Sim_Random(&seed) % 2) * mps;
+
+		urbResult = IsoPackets_BuildUrbTable(packets, count, 0, dataLength, expected, &errorIndex);
+		if ((IsoPackets_CheckTemplateLength(packetTemplate, dataLength) == ISO_PACKETS_SUCCESS) != (urbResult == ISO_PACKETS_SUCCESS))
+		{
+			mismatches++;
+		}
+		else if (urbResult == ISO_PACKETS_SUCCESS)
+		{
+			memset(expanded, 0xEE, sizeof(expanded));
+			IsoPackets_CopyTemplate(packetTemplate, expanded);
+			if (memcmp(expanded, expected, sizeof(ISO_URB_PACKET) * count) || expanded[count].Offset != 0xEEEEEEEE)
+				mismatches++;
+		}
+
+		SIM_CHECK(!Sim_TemplateOverrun(packetTemplate, count), "expansion round %d: template overrun", round);
+		free(packetTemplate);
+	}
+
+	SIM_CHECK(mismatches == 0, "expansion: %d of 2000 templates differ from the per-transfer URB table", mismatches);
+	printf("template expansion matches the per-transfer URB table for 2000 random layouts\n");
+}
+
+static void Sim_Benchmark(unsigned int loops)
+{
+	static ISO_USER_PACKET packets[ISO_PACKETS_MAX_HS];
+	static ISO_URB_PACKET urbPackets[ISO_PACKETS_MAX_HS];
+	ISO_PACKET_TEMPLATE* packetTemplate;
+	unsigned int i, sink = 0;
+	int errorIndex, p;
+	double start, buildNs, templateNs;
+
+	for (p = 0; p < ISO_PACKETS_MAX_HS; p++)
+		packets[p].Offset = (unsigned int)p * 3072;
+
+	packetTemplate = Sim_AllocTemplate(ISO_PACKETS_MAX_HS);
+	IsoPackets_BuildTemplate(packets, ISO_PACKETS_MAX_HS, 1, 3072, packetTemplate, &errorIndex);
+
+	start = Sim_Now();
+	for (i = 0; i < loops; i++)
+	{
+		IsoPackets_CheckCount(ISO_PACKETS_MAX_HS, 1, ISO_PACKETS_MAX_HS);
+		IsoPackets_BuildUrbTable(packets, ISO_PACKETS_MAX_HS, 0, ISO_PACKETS_MAX_HS * 3072, urbPackets, &errorIndex);
+		sink += urbPackets[i & 1023].Offset;
+	}
+	buildNs = (Sim_Now() - start) * 1e9 / loops;
+
+	start = Sim_Now();
+	for (i = 0; i < loops; i++)
+	{
+		IsoPackets_CheckTemplateLength(packetTemplate, ISO_PACKETS_MAX_HS * 3072);
+		IsoPackets_CopyTemplate(packetTemplate, urbPackets);
+		sink += urbPackets[i & 1023].Offset;
+	}
+	templateNs = (Sim_Now() - start) * 1e9 / loops;
+
+	printf("benchmark (%d packets, %u loops):\n", ISO_PACKETS_MAX_HS, loops);
+	printf("  validate and convert user packets : %8.1f ns per transfer (%u bytes of packets in the IOCTL)\n",
+	       buildNs, (unsigned int)(sizeof(ISO_USER_PACKET) * ISO_PACKETS_MAX_HS));
+	printf("  expand packet template            : %8.1f ns per transfer\n", templateNs);
+	if (sink == 1) printf("\n");
+	free(packetTemplate);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int loops = 100000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "loops=", 6))
+			loops = (unsigned int)atoi(argv[i] + 6);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!loops) loops = 1;
+
+	// drv_xfer_iso.c asserts these against KISO_PACKET and USBD_ISO_PACKET_DESCRIPTOR.
+	SIM_CHECK(sizeof(ISO_USER_PACKET) == 8 && sizeof(ISO_URB_PACKET) == 12, "packet structs are %u and %u bytes",
+	          (unsigned int)sizeof(ISO_USER_PACKET), (unsigned int)sizeof(ISO_URB_PACKET));
+
+	Sim_CheckCount();
+	Sim_CheckUrbTable();
+	Sim_CheckTemplate();
+	Sim_CheckExpansion();
+	Sim_Benchmark(loops);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check and allocation benchmark of the fixed-size block pool. (see drv_mem_pool.h)
+//
+// Checks block alignment and ownership, misses for large requests and an
+// empty pool, and the hit/miss/peak counters against a model. Then times
+// alloc/free cycles of iso URB sized blocks with up to XFER_URB_POOL_BLOCKS
+// in flight, for the pool behind a spin lock (as drv_xfer_iso.c uses it)
+// and for malloc/free. The C library allocator stands in for nonpaged pool
+// and WdfMemoryCreate, which cost more, so the gap in the driver is larger.
+//
+// Usage: mem_pool_sim [loops=<count>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "drv_mem_pool.h"
+
+// drv_xfer_iso.c
+#define SIM_URB_POOL_BLOCKS	8
+
+// GET_ISO_URB_SIZE(1024) on x64: the URB header plus 1024 packet descriptors.
+#define SIM_URB_SIZE		(0x58 + 1024 * 12)
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static double Sim_Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int Sim_Seed = 1;
+
+static unsigned int Sim_Random(unsigned int range)
+{
+	Sim_Seed = (Sim_Seed * 1103515245) + 12345;
+	return ((Sim_Seed >> 16) & 0x7FFF) % range;
+}
+
+static void* Sim_AllocStorage(unsigned int blockSize, unsigned int blockCount)
+{
+	void* storage = NULL;
+	if (posix_memalign(&storage, MEM_POOL_ALIGNMENT, MemPool_StorageSize(blockSize, blockCount)))
+		return NULL;
+	return storage;
+}
+
+static void Sim_CheckBlocks(void)
+{
+	static const unsigned int blockSizes[] = {1, 7, 8, 16, 17, 100, SIM_URB_SIZE};
+	MEM_POOL pool;
+	void* blocks[SIM_URB_POOL_BLOCKS + 1];
+	void* storage;
+	unsigned int s, b, size;
+
+	for (s = 0; s < sizeof(blockSizes) / sizeof(blockSizes[0]); s++)
+	{
+		size = blockSizes[s];
+		storage = Sim_AllocStorage(size, SIM_URB_POOL_BLOCKS);
+		MemPool_Init(&pool, storage, size, SIM_URB_POOL_BLOCKS);
+
+		SIM_CHECK(pool.BlockSize >= size && pool.BlockSize >= sizeof(void*) && pool.BlockSize % MEM_POOL_ALIGNMENT == 0,
+		          "block size %u: stride %u", size, pool.BlockSize);
+		SIM_CHECK(MemPool_StorageSize(size, SIM_URB_POOL_BLOCKS) == pool.BlockSize * SIM_URB_POOL_BLOCKS,
+		          "block size %u: storage size %u", size, MemPool_StorageSize(size, SIM_URB_POOL_BLOCKS));
+
+		for (b = 0; b < SIM_URB_POOL_BLOCKS; b++)
+		{
+			blocks[b] = MemPool_Alloc(&pool, size);
+			SIM_CHECK(blocks[b] == (unsigned char*)storage + b * pool.BlockSize, "block size %u: block %u not in address order", size, b);
+			SIM_CHECK(blocks[b] && ((uintptr_t)blocks[b] % MEM_POOL_ALIGNMENT) == 0 && MemPool_Owns(&pool, blocks[b]),
+			          "block size %u: block %u misaligned or not owned", size, b);
+			if (blocks[b]) memset(blocks[b], 0xA5, size);
+		}
+
+		// Empty pool and oversized requests are misses.
+		blocks[SIM_URB_POOL_BLOCKS] = MemPool_Alloc(&pool, 1);
+		SIM_CHECK(!blocks[SIM_URB_POOL_BLOCKS], "block size %u: allocated from an empty pool", size);
+		MemPool_Free(&pool, blocks[3]);
+		SIM_CHECK(!MemPool_Alloc(&pool, pool.BlockSize + 1), "block size %u: allocated an oversized block", size);
+		SIM_CHECK(MemPool_Alloc(&pool, pool.BlockSize) == blocks[3], "block size %u: freed block not reused", size);
+
+		SIM_CHECK(pool.Stats.Hits == SIM_URB_POOL_BLOCKS + 1 && pool.Stats.Misses == 2 && pool.Stats.PeakInUse == SIM_URB_POOL_BLOCKS,
+		          "block size %u: hits %u misses %u peak %u", size, pool.Stats.Hits, pool.Stats.Misses, pool.Stats.PeakInUse);
+
+		SIM_CHECK(!MemPool_Owns(&pool, (unsigned char*)blocks[1] + 1) &&
+		          !MemPool_Owns(&pool, (unsigned char*)storage + pool.BlockSize * SIM_URB_POOL_BLOCKS) &&
+		          !MemPool_Owns(&pool, (unsigned char*)storage - pool.BlockSize),
+		          "block size %u: owns a pointer that is not a block", size);
+
+		free(storage);
+	}
+}
+
+// Random alloc/free against a model of the pool counters.
+static void Sim_CheckCounters(void)
+{
+	MEM_POOL pool;
+	void* storage = Sim_AllocStorage(SIM_URB_SIZE, SIM_URB_POOL_BLOCKS);
+	void* held[64];
+	unsigned int heldCount = 0, hits = 0, misses = 0, peak = 0, step, size, pos;
+	void* block;
+
+	MemPool_Init(&pool, storage, SIM_URB_SIZE, SIM_URB_POOL_BLOCKS);
+	for (step = 0; step < 100000; step++)
+	{
+		if (heldCount < 64 && (Sim_Random(2) || !heldCount))
+		{
+			size = Sim_Random(8) ? 1 + Sim_Random(SIM_URB_SIZE) : SIM_URB_SIZE + 1 + Sim_Random(64);
+			block = MemPool_Alloc(&pool, size);
+			if (size <= pool.BlockSize && heldCount < SIM_URB_POOL_BLOCKS)
+			{
+				SIM_CHECK(block != NULL, "counters: miss with %u of %u blocks in use", heldCount, SIM_URB_POOL_BLOCKS);
+				if (!block) break;
+				for (pos = 0; pos < heldCount; pos++)
+					SIM_CHECK(held[pos] != block, "counters: block handed out twice");
+				held[heldCount++] = block;
+				hits++;
+				if (heldCount > peak) peak = heldCount;
+			}
+			else
+			{
+				SIM_CHECK(block == NULL, "counters: hit for %u bytes with %u blocks in use", size, heldCount);
+				misses++;
+			}
+		}
+		else
+		{
+			pos = Sim_Random(heldCount);
+			MemPool_Free(&pool, held[pos]);
+			held[pos] = held[--heldCount];
+		}
+	}
+
+	SIM_CHECK(pool.Stats.Hits == hits && pool.Stats.Misses == misses && pool.Stats.PeakInUse == peak && pool.InUse == heldCount,
+	          "counters: hits %u/%u misses %u/%u peak %u/%u", pool.Stats.Hits, hits, pool.Stats.Misses, misses, pool.Stats.PeakInUse, peak);
+	free(storage);
+}
+
+static pthread_spinlock_t Sim_PoolLock;
+
+static void Sim_Benchmark(unsigned int loops)
+{
+	MEM_POOL pool;
+	void* storage = Sim_AllocStorage(SIM_URB_SIZE, SIM_URB_POOL_BLOCKS);
+	void* held[SIM_URB_POOL_BLOCKS];
+	unsigned int depth, i, slot;
+	double start, poolNs, mallocNs;
+	volatile unsigned int sink = 0;
+
+	pthread_spin_init(&Sim_PoolLock, PTHREAD_PROCESS_PRIVATE);
+
+	printf("benchmark (%u byte URBs, %u alloc/free cycles):\n", SIM_URB_SIZE, loops);
+	printf("  %-10s %14s %14s\n", "in flight", "pool+lock ns", "malloc ns");
+	for (depth = 1; depth <= SIM_URB_POOL_BLOCKS; depth *= 2)
+	{
+		// The oldest URB is cleaned up as each new one is created.
+		MemPool_Init(&pool, storage, SIM_URB_SIZE, SIM_URB_POOL_BLOCKS);
+		for (slot = 0; slot < depth; slot++)
+			held[slot] = MemPool_Alloc(&pool, SIM_URB_SIZE);
+
+		start = Sim_Now();
+		for (i = 0, slot = 0; i < loops; i++, slot = (slot + 1) % depth)
+		{
+			pthread_spin_lock(&Sim_PoolLock);
+			MemPool_Free(&pool, held[slot]);
+			pthread_spin_unlock(&Sim_PoolLock);
+
+			pthread_spin_lock(&Sim_PoolLock);
+			held[slot] = MemPool_Alloc(&pool, SIM_URB_SIZE);
+			pthread_spin_unlock(&Sim_PoolLock);
+
+			((unsigned char*)held[slot])[0] = (unsigned char)i;
+			sink += ((unsigned char*)held[slot])[0];
+		}
+		poolNs = (Sim_Now() - start) * 1e9 / loops;
+		SIM_CHECK(pool.Stats.Misses == 0 && pool.Stats.PeakInUse == depth,
+		          "benchmark: %u misses, peak %u at depth %u", pool.Stats.Misses, pool.Stats.PeakInUse, depth);
+
+		for (slot = 0; slot < depth; slot++)
+			held[slot] = malloc(SIM_URB_SIZE);
+
+		start = Sim_Now();
+		for (i = 0, slot = 0; i < loops; i++, slot = (slot + 1) % depth)
+		{
+			free(held[slot]);
+			held[slot] = malloc(SIM_URB_SIZE);
+
+			((unsigned char*)held[slot])[0] = (unsigned char)i;
+			sink += ((unsigned char*)held[slot])[0];
+		}
+		mallocNs = (Sim_Now() - start) * 1e9 / loops;
+
+		for (slot = 0; slot < depth; slot++)
+			free(held[slot]);
+
+		printf("  %-10u %14.1f %14.1f\n", depth, poolNs, mallocNs);
+	}
+	pthread_spin_destroy(&Sim_PoolLock);
+	free(storage);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int loops = 2000000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "loops=", 6))
+			loops = (unsigned int)atoi(argv[i] + 6);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!loops) loops = 1;
+
+	Sim_CheckBlocks();
+	Sim_CheckCounters();
+	Sim_Benchmark(loops);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,466 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the continuous reader packet ring. (see drv_packet_ring.h)
+//
+// Framing : records of every alignment, both kinds of skipped tail when a
+//           record wraps, a record the size of the ring, overrun flags and
+//           batch drains into buffers that fit a whole number of records,
+//           one byte less, and less than the oldest record.
+// Order   : reader slots that complete out of order are taken in send order.
+// Threads : several threads deliver slot completions in random order while
+//           another drains, serialized by one lock and pumped the way
+//           Xfer_ReaderComplete/Xfer_ReaderPump do. Every drained record must
+//           be well framed and in send order, a record must carry the
+//           overrun flag exactly when packets were dropped before it, and
+//           stored + dropped must account for every packet read.
+//
+// Usage: packet_ring_sim [packets=<count>] [seed=<seed>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "drv_packet_ring.h"
+
+#define SIM_MPS				64
+#define SIM_SLOTS			8
+#define SIM_COMPLETERS		4
+
+// Ring size for the threaded check; small so it wraps and overruns often.
+#define SIM_RING_SIZE		1000
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static unsigned int Sim_Seed = 1;
+
+static unsigned int Sim_Random(unsigned int range)
+{
+	Sim_Seed = (Sim_Seed * 1103515245) + 12345;
+	return ((Sim_Seed >> 16) & 0x7FFF) % range;
+}
+
+// Ring and drain buffers are kept 8 byte aligned like pool memory.
+static long long Sim_RingMemory[65536 / sizeof(long long)];
+static long long Sim_DrainMemory[65536 / sizeof(long long)];
+
+#define Sim_RingBuffer	((unsigned char*)Sim_RingMemory)
+#define Sim_DrainBuffer	((unsigned char*)Sim_DrainMemory)
+
+// Length and bytes of the packet with sequence number seq.
+static unsigned int Sim_PacketLength(unsigned int seq)
+{
+	return (seq * 37) % (SIM_MPS + 1);
+}
+
+static void Sim_PacketFill(unsigned char* data, unsigned int seq)
+{
+	unsigned int pos, length = Sim_PacketLength(seq);
+
+	for (pos = 0; pos < length; pos++)
+		data[pos] = (unsigned char)(seq * 13 + pos);
+}
+
+static int Sim_PacketPut(PACKET_RING* ring, unsigned int seq)
+{
+	unsigned char data[SIM_MPS];
+
+	Sim_PacketFill(data, seq);
+	return PacketRing_Put(ring, data, Sim_PacketLength(seq), seq);
+}
+
+// Walks drained records. Records carry their sequence number as timestamp.
+// lastSeq is the sequence of the previous record (-1 before the first);
+// gaps must match the overrun flag. Returns the number of records parsed.
+static unsigned int Sim_ParseDrain(const unsigned char* buffer, unsigned int length, long long* lastSeq, const char* what)
+{
+	const PACKET_RING_HEADER* header;
+	unsigned char expected[SIM_MPS];
+	unsigned int pos = 0, count = 0, seq;
+	int gap;
+
+	while (pos < length)
+	{
+		if (length - pos < PACKET_RING_HEADER_SIZE)
+		{
+			SIM_CHECK(0, "%s: %u bytes left after %u records", what, length - pos, count);
+			break;
+		}
+
+		header = (const PACKET_RING_HEADER*)(buffer + pos);
+		seq = (unsigned int)header->Timestamp;
+		gap = (long long)seq != *lastSeq + 1;
+
+		if ((header->Flags & ~PACKET_RING_FLAG_OVERRUN) || header->Length != Sim_PacketLength(seq) ||
+		        PACKET_RING_RECORD_SIZE(header->Length) > length - pos || (long long)seq <= *lastSeq ||
+		        gap != ((header->Flags & PACKET_RING_FLAG_OVERRUN) != 0))
+		{
+			SIM_CHECK(0, "%s: record %u (seq %u after %lld) length %u flags %08Xh", what, count, seq, *lastSeq, header->Length, header->Flags);
+			break;
+		}
+
+		Sim_PacketFill(expected, seq);
+		if (memcmp(buffer + pos + PACKET_RING_HEADER_SIZE, expected, header->Length))
+		{
+			SIM_CHECK(0, "%s: record %u (seq %u) data damaged", what, count, seq);
+			break;
+		}
+
+		*lastSeq = seq;
+		pos += PACKET_RING_RECORD_SIZE(header->Length);
+		count++;
+	}
+	return count;
+}
+
+static void Sim_CheckFraming(void)
+{
+	static const unsigned int lengths[] = {0, 1, 7, 8, 9, 63, 64};
+	PACKET_RING ring;
+	unsigned int i, written, packets, size, count;
+	long long lastSeq;
+
+	SIM_CHECK(sizeof(PACKET_RING_HEADER) == PACKET_RING_HEADER_SIZE, "header is %u bytes", (unsigned int)sizeof(PACKET_RING_HEADER));
+	for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		size = PACKET_RING_RECORD_SIZE(lengths[i]);
+		SIM_CHECK(size % PACKET_RING_ALIGN == 0 && size >= PACKET_RING_HEADER_SIZE + lengths[i] && size < PACKET_RING_HEADER_SIZE + lengths[i] + PACKET_RING_ALIGN,
+		          "record size of %u is %u", lengths[i], size);
+	}
+
+	// Sequence numbers are chosen so Sim_PacketLength gives the wanted record sizes below.
+	PacketRing_Init(&ring, Sim_RingBuffer, 256 + 5);
+	SIM_CHECK(ring.Size == 256, "ring size %u not rounded down", ring.Size);
+
+	// A record the size of the ring fits an empty ring; a larger one never does.
+	{
+		static unsigned char data[256];
+
+		SIM_CHECK(PacketRing_Put(&ring, data, 256 - PACKET_RING_HEADER_SIZE, 0) && ring.Write == 0 && ring.Used == 256,
+		          "ring sized record: write %u used %u", ring.Write, ring.Used);
+		written = PacketRing_Drain(&ring, Sim_DrainBuffer, 256, &packets);
+		SIM_CHECK(written == 256 && packets == 1, "ring sized record drained %u bytes %u packets", written, packets);
+		SIM_CHECK(!PacketRing_Put(&ring, data, 256 - PACKET_RING_HEADER_SIZE + 1, 0) && ring.Dropped == 1, "oversized record stored");
+		PacketRing_Reset(&ring);
+		SIM_CHECK(!ring.Overrun, "reset kept the overrun state");
+	}
+
+	// Tail of 24 bytes: the skipped tail gets a pad header that is never drained.
+	{
+		static unsigned char data[256];
+		unsigned char buffer[SIM_MPS];
+
+		PacketRing_Init(&ring, Sim_RingBuffer, 256);
+		PacketRing_Put(&ring, data, 232 - PACKET_RING_HEADER_SIZE, 100);
+		PacketRing_Drain(&ring, Sim_DrainBuffer, 256, &packets);
+		SIM_CHECK(ring.Read == 0 && ring.Write == 0, "empty ring did not start over");
+
+		// Drained rings start over at the front; leave the first record in to keep Write at 232.
+		PacketRing_Put(&ring, data, 232 - PACKET_RING_HEADER_SIZE, 100);
+		memset(buffer, 0x5A, sizeof(buffer));
+		PacketRing_Put(&ring, buffer, 0, 101);
+		PacketRing_Drain(&ring, Sim_DrainBuffer, 232, &packets);
+		SIM_CHECK(packets == 1 && ring.Read == 232 && ring.Write == 248, "pad setup: read %u write %u", ring.Read, ring.Write);
+
+		// 8 byte tail; too small for a header, skipped without one.
+		SIM_CHECK(PacketRing_Put(&ring, buffer, 8, 102) && ring.Write == 24 && ring.Used == 16 + 8 + 24,
+		          "short tail: write %u used %u", ring.Write, ring.Used);
+		written = PacketRing_Drain(&ring, Sim_DrainBuffer, sizeof(Sim_DrainMemory), &packets);
+		SIM_CHECK(packets == 2 && written == 16 + 24 && ((PACKET_RING_HEADER*)Sim_DrainBuffer)->Timestamp == 101 &&
+		          ((PACKET_RING_HEADER*)(Sim_DrainBuffer + 16))->Timestamp == 102, "short tail: drained %u bytes %u packets", written, packets);
+
+		PacketRing_Put(&ring, data, 216 - PACKET_RING_HEADER_SIZE, 103);
+		PacketRing_Put(&ring, buffer, 0, 104);
+		PacketRing_Drain(&ring, Sim_DrainBuffer, 216, &packets);
+		SIM_CHECK(packets == 1 && ring.Read == 216 && ring.Write == 232, "pad setup: read %u write %u", ring.Read, ring.Write);
+
+		// 24 byte tail; gets a pad header.
+		SIM_CHECK(PacketRing_Put(&ring, buffer, 32, 105) && ring.Write == 48 && ring.Used == 16 + 24 + 48,
+		          "pad tail: write %u used %u", ring.Write, ring.Used);
+		SIM_CHECK(PacketRing_PeekSize(&ring) == 16, "pad tail: peek %u", PacketRing_PeekSize(&ring));
+		PacketRing_Drain(&ring, Sim_DrainBuffer, 16, &packets);
+		SIM_CHECK(PacketRing_PeekSize(&ring) == 48 && ring.Read == 0, "pad tail: pad not skipped (peek %u read %u)", PacketRing_PeekSize(&ring), ring.Read);
+		written = PacketRing_Drain(&ring, Sim_DrainBuffer, sizeof(Sim_DrainMemory), &packets);
+		SIM_CHECK(packets == 1 && written == 48 && ((PACKET_RING_HEADER*)Sim_DrainBuffer)->Flags == 0 &&
+		          ((PACKET_RING_HEADER*)Sim_DrainBuffer)->Timestamp == 105, "pad tail: drained %u bytes %u packets", written, packets);
+	}
+
+	// Batch drains: exact fit, one byte short, smaller than the oldest record.
+	PacketRing_Init(&ring, Sim_RingBuffer, 4096);
+	for (i = 0; i < 40; i++)
+		Sim_PacketPut(&ring, i);
+
+	lastSeq = -1;
+	size = 0;
+	for (i = 0; i < 10; i++)
+		size += PACKET_RING_RECORD_SIZE(Sim_PacketLength(i));
+
+	written = PacketRing_Drain(&ring, Sim_DrainBuffer, size - 1, &packets);
+	count = Sim_ParseDrain(Sim_DrainBuffer, written, &lastSeq, "one byte short");
+	SIM_CHECK(packets == 9 && count == 9 && written == size - PACKET_RING_RECORD_SIZE(Sim_PacketLength(9)),
+	          "one byte short: %u packets %u bytes", packets, written);
+
+	size = PacketRing_PeekSize(&ring);
+	SIM_CHECK(size == PACKET_RING_RECORD_SIZE(Sim_PacketLength(9)), "peek %u", size);
+	written = PacketRing_Drain(&ring, Sim_DrainBuffer, size - 1, &packets);
+	SIM_CHECK(written == 0 && packets == 0 && ring.Packets == 31, "too small: %u bytes %u packets", written, packets);
+
+	size = 0;
+	for (i = 9; i < 20; i++)
+		size += PACKET_RING_RECORD_SIZE(Sim_PacketLength(i));
+	written = PacketRing_Drain(&ring, Sim_DrainBuffer, size, &packets);
+	count = Sim_ParseDrain(Sim_DrainBuffer, written, &lastSeq, "exact fit");
+	SIM_CHECK(packets == 11 && count == 11 && written == size, "exact fit: %u packets %u bytes", packets, written);
+
+	written = PacketRing_Drain(&ring, Sim_DrainBuffer, sizeof(Sim_DrainMemory), &packets);
+	count = Sim_ParseDrain(Sim_DrainBuffer, written, &lastSeq, "rest");
+	SIM_CHECK(packets == 20 && count == 20 && !ring.Packets && !ring.Used && !PacketRing_PeekSize(&ring), "rest: %u packets", packets);
+
+	// Overrun: the first packet stored after a drop is flagged, the next is not.
+	PacketRing_Init(&ring, Sim_RingBuffer, 256);
+	for (i = 0; Sim_PacketPut(&ring, i); i++);
+	SIM_CHECK(ring.Dropped == 1 && ring.Overrun, "overrun: %u dropped", ring.Dropped);
+	PacketRing_Drain(&ring, Sim_DrainBuffer, PACKET_RING_RECORD_SIZE(Sim_PacketLength(0)) + PACKET_RING_RECORD_SIZE(Sim_PacketLength(1)), &packets);
+	lastSeq = 1;
+	Sim_PacketPut(&ring, i + 2);
+	Sim_PacketPut(&ring, i + 3);
+	written = PacketRing_Drain(&ring, Sim_DrainBuffer, sizeof(Sim_DrainMemory), &packets);
+	count = Sim_ParseDrain(Sim_DrainBuffer, written, &lastSeq, "overrun");
+	SIM_CHECK(count == packets && lastSeq == i + 3, "overrun: %u of %u packets parsed", count, packets);
+}
+
+static void Sim_CheckOrder(void)
+{
+	static const unsigned int order[SIM_SLOTS] = {3, 1, 0, 2, 7, 4, 6, 5};
+	PACKET_READER reader;
+	unsigned int i, slot, length, taken = 0;
+	long long timestamp;
+	int status;
+
+	PacketReader_Init(&reader, 0);
+	SIM_CHECK(reader.SlotCount == 1, "slot count 0 not clamped");
+	PacketReader_Init(&reader, PACKET_READER_MAX_SLOTS + 1);
+	SIM_CHECK(reader.SlotCount == PACKET_READER_MAX_SLOTS, "slot count not clamped");
+
+	PacketReader_Init(&reader, SIM_SLOTS);
+	for (i = 0; i < SIM_SLOTS; i++)
+	{
+		PacketReader_Complete(&reader, order[i], order[i] == 6 ? -1 : 0, order[i] * 10, order[i]);
+		while (PacketReader_Next(&reader, &slot, &status, &length, &timestamp))
+		{
+			SIM_CHECK(slot == taken && length == slot * 10 && timestamp == slot && status == (slot == 6 ? -1 : 0),
+			          "order: took slot %u, expected %u", slot, taken);
+			taken++;
+		}
+	}
+	SIM_CHECK(taken == SIM_SLOTS, "order: %u slots taken", taken);
+
+	// The resent slot is the newest; slot 0 is next only after it completes again.
+	PacketReader_Complete(&reader, 1, 0, 0, 0);
+	SIM_CHECK(!PacketReader_Next(&reader, &slot, &status, &length, &timestamp), "order: slot 1 taken before slot 0");
+	PacketReader_Complete(&reader, 0, 0, 0, 0);
+	SIM_CHECK(PacketReader_Next(&reader, &slot, &status, &length, &timestamp) && slot == 0 &&
+	          PacketReader_Next(&reader, &slot, &status, &length, &timestamp) && slot == 1, "order: wrap");
+}
+
+// Continuous reader state shared by the threads; every field is protected by Sim_Lock.
+typedef struct _SIM_READER
+{
+	pthread_mutex_t Lock;
+	PACKET_READER State;
+	PACKET_RING Ring;
+	int Busy;
+
+	// Sent slots waiting for a completion thread, and the sequence each one reads.
+	unsigned int Sent[SIM_SLOTS];
+	unsigned int SentCount;
+	unsigned int SlotSeq[SIM_SLOTS];
+	unsigned char SlotBuffer[SIM_SLOTS][SIM_MPS];
+
+	unsigned int NextSeq;
+	unsigned int Packets;
+	int Done;
+} SIM_READER;
+
+static SIM_READER Sim_Reader;
+
+// Xfer_ReaderPump: stores completed slots in order and sends them again.
+static void Sim_Pump(void)
+{
+	unsigned int slot, length;
+	long long timestamp;
+	int status;
+
+	pthread_mutex_lock(&Sim_Reader.Lock);
+	if (Sim_Reader.Busy)
+	{
+		pthread_mutex_unlock(&Sim_Reader.Lock);
+		return;
+	}
+	Sim_Reader.Busy = 1;
+
+	while (PacketReader_Next(&Sim_Reader.State, &slot, &status, &length, &timestamp))
+	{
+		PacketRing_Put(&Sim_Reader.Ring, Sim_Reader.SlotBuffer[slot], length, timestamp);
+
+		if (Sim_Reader.NextSeq < Sim_Reader.Packets)
+		{
+			Sim_Reader.SlotSeq[slot] = Sim_Reader.NextSeq++;
+			Sim_Reader.Sent[Sim_Reader.SentCount++] = slot;
+		}
+		else if (Sim_Reader.Ring.Stored + Sim_Reader.Ring.Dropped == Sim_Reader.Packets)
+		{
+			Sim_Reader.Done = 1;
+		}
+	}
+
+	Sim_Reader.Busy = 0;
+	pthread_mutex_unlock(&Sim_Reader.Lock);
+}
+
+// Xfer_ReaderComplete: the device fills a sent slot; completions run in any order.
+static void* Sim_CompleteThread(void* context)
+{
+	unsigned int seed = (unsigned int)(size_t)context, slot, seq, pick;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&Sim_Reader.Lock);
+		if (Sim_Reader.Done)
+		{
+			pthread_mutex_unlock(&Sim_Reader.Lock);
+			return NULL;
+		}
+		// The device keeps pace with the drains except in bursts that overrun the ring.
+		if (!Sim_Reader.SentCount ||
+		        (Sim_Reader.Ring.Used > SIM_RING_SIZE / 2 && (Sim_Reader.SlotSeq[Sim_Reader.Sent[0]] % 1000) >= 50))
+		{
+			pthread_mutex_unlock(&Sim_Reader.Lock);
+			sched_yield();
+			continue;
+		}
+
+		seed = (seed * 1103515245) + 12345;
+		pick = (seed >> 16) % Sim_Reader.SentCount;
+		slot = Sim_Reader.Sent[pick];
+		Sim_Reader.Sent[pick] = Sim_Reader.Sent[--Sim_Reader.SentCount];
+		seq = Sim_Reader.SlotSeq[slot];
+		pthread_mutex_unlock(&Sim_Reader.Lock);
+
+		// The slot is owned by this completion until it is stored.
+		Sim_PacketFill(Sim_Reader.SlotBuffer[slot], seq);
+
+		pthread_mutex_lock(&Sim_Reader.Lock);
+		PacketReader_Complete(&Sim_Reader.State, slot, 0, Sim_PacketLength(seq), seq);
+		pthread_mutex_unlock(&Sim_Reader.Lock);
+
+		Sim_Pump();
+	}
+}
+
+static void Sim_CheckThreads(unsigned int packets)
+{
+	pthread_t threads[SIM_COMPLETERS];
+	unsigned int i, written, drained = 0, count, drains = 0, needed;
+	long long lastSeq = -1;
+	int done;
+
+	memset(&Sim_Reader, 0, sizeof(Sim_Reader));
+	pthread_mutex_init(&Sim_Reader.Lock, NULL);
+	PacketReader_Init(&Sim_Reader.State, SIM_SLOTS);
+	PacketRing_Init(&Sim_Reader.Ring, Sim_RingBuffer, SIM_RING_SIZE);
+	Sim_Reader.Packets = packets;
+
+	// Xfer_ReaderStart: every slot is sent in slot order.
+	for (i = 0; i < SIM_SLOTS; i++)
+	{
+		Sim_Reader.SlotSeq[i] = Sim_Reader.NextSeq++;
+		Sim_Reader.Sent[Sim_Reader.SentCount++] = i;
+	}
+
+	for (i = 0; i < SIM_COMPLETERS; i++)
+		pthread_create(&threads[i], NULL, Sim_CompleteThread, (void*)(size_t)(i + 1));
+
+	// LIBUSBK_IOCTL_READ_PACKETS with buffers of random sizes.
+	do
+	{
+		pthread_mutex_lock(&Sim_Reader.Lock);
+		done = Sim_Reader.Done;
+		written = PacketRing_Drain(&Sim_Reader.Ring, Sim_DrainBuffer, PACKET_RING_HEADER_SIZE + Sim_Random(SIM_RING_SIZE), &count);
+		needed = !count && Sim_Reader.Ring.Packets ? PacketRing_PeekSize(&Sim_Reader.Ring) : 0;
+		pthread_mutex_unlock(&Sim_Reader.Lock);
+
+		SIM_CHECK(!needed || needed >= PACKET_RING_HEADER_SIZE, "threads: nothing drained, oldest record %u bytes", needed);
+		if (Sim_ParseDrain(Sim_DrainBuffer, written, &lastSeq, "threads") != count)
+		{
+			// Stop the completion threads; nothing drains the ring from here on.
+			pthread_mutex_lock(&Sim_Reader.Lock);
+			Sim_Reader.Done = 1;
+			pthread_mutex_unlock(&Sim_Reader.Lock);
+			break;
+		}
+		drained += count;
+		drains++;
+
+		if (!count)
+			sched_yield();
+	}
+	while (!done || count);
+
+	for (i = 0; i < SIM_COMPLETERS; i++)
+		pthread_join(threads[i], NULL);
+
+	SIM_CHECK(drained == Sim_Reader.Ring.Stored && drained + Sim_Reader.Ring.Dropped == packets,
+	          "threads: %u drained, %u stored, %u dropped of %u", drained, Sim_Reader.Ring.Stored, Sim_Reader.Ring.Dropped, packets);
+
+	printf("threads : %d completion threads, %u packets, %u drained in %u drains, %u dropped\n",
+	       SIM_COMPLETERS, packets, drained, drains, Sim_Reader.Ring.Dropped);
+	pthread_mutex_destroy(&Sim_Reader.Lock);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int packets = 200000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "packets=", 8))
+			packets = (unsigned int)atoi(argv[i] + 8);
+		else if (!strncmp(argv[i], "seed=", 5))
+			Sim_Seed = (unsigned int)strtoul(argv[i] + 5, NULL, 0);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (packets < SIM_SLOTS) packets = SIM_SLOTS;
+
+	Sim_CheckFraming();
+	Sim_CheckOrder();
+	Sim_CheckThreads(packets);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the pipe counter helpers. (see drv_pipe_stats.h)
+//
+// Bucket bounds: for several performance counter rates, a latency just
+// under a bucket limit must land in that bucket and one at the limit in the
+// next, with no overflow for long waits on fast clocks.
+//
+// Accumulation: several threads complete requests and update a
+// PIPE_STATS_COUNTERS copy the way Xfer_StatsBegin and Xfer_CompleteRequest
+// do, with atomic adds. The totals and buckets must match what each thread
+// counted on its own, and the in-flight peak must never pass the thread
+// count.
+//
+// Usage: pipe_stats_sim [requests=<per thread>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "drv_pipe_stats.h"
+
+#define SIM_THREADS	4
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static void Sim_CheckLimits(void)
+{
+	unsigned int bucket;
+
+	for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS - 1; bucket++)
+	{
+		SIM_CHECK(PipeStats_BucketLimitUs(bucket) == (PIPE_STATS_LATENCY_BASE_US << bucket),
+		          "bucket %u limit %uus", bucket, PipeStats_BucketLimitUs(bucket));
+	}
+	SIM_CHECK(PipeStats_BucketLimitUs(PIPE_STATS_LATENCY_BUCKETS - 1) == 0, "last bucket is bounded");
+	SIM_CHECK(PipeStats_BucketLimitUs(PIPE_STATS_LATENCY_BUCKETS + 5) == 0, "bucket past the end is bounded");
+
+	// KPIPE_STATS documents the last bucket as 32ms or more.
+	SIM_CHECK(PipeStats_BucketLimitUs(PIPE_STATS_LATENCY_BUCKETS - 2) == 32000, "last bounded bucket is %uus",
+	          PipeStats_BucketLimitUs(PIPE_STATS_LATENCY_BUCKETS - 2));
+}
+
+static void Sim_CheckBuckets(void)
+{
+	// 1 kHz, the 3.579545 MHz ACPI PM timer, 10 MHz (Windows 10 QPC), TSC rates.
+	static const unsigned long long rates[] = {1000, 3579545, 10000000, 2400000000ULL, 3999999999ULL};
+	unsigned long long rate, limitTicks;
+	unsigned int r, bucket, got;
+
+	for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+	{
+		rate = rates[r];
+
+		SIM_CHECK(PipeStats_LatencyBucket(0, rate) == 0 || rate < 8000, "%llu Hz: 0 ticks in bucket %u", rate, PipeStats_LatencyBucket(0, rate));
+
+		for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS - 1; bucket++)
+		{
+			limitTicks = (rate * PipeStats_BucketLimitUs(bucket)) / 1000000;
+			if (!limitTicks) continue;
+
+			got = PipeStats_LatencyBucket(limitTicks - 1, rate);
+			SIM_CHECK(got == bucket, "%llu Hz: %llu ticks (under %uus) in bucket %u", rate, limitTicks - 1, PipeStats_BucketLimitUs(bucket), got);
+			got = PipeStats_LatencyBucket(limitTicks, rate);
+			SIM_CHECK(got == bucket + 1, "%llu Hz: %llu ticks (%uus) in bucket %u", rate, limitTicks, PipeStats_BucketLimitUs(bucket), got);
+		}
+
+		// An hour, and the largest tick count, are in the last bucket.
+		SIM_CHECK(PipeStats_LatencyBucket(rate * 3600, rate) == PIPE_STATS_LATENCY_BUCKETS - 1, "%llu Hz: an hour not in the last bucket", rate);
+		SIM_CHECK(PipeStats_LatencyBucket(~0ULL, rate) == PIPE_STATS_LATENCY_BUCKETS - 1, "%llu Hz: max ticks not in the last bucket", rate);
+	}
+
+	SIM_CHECK(PipeStats_LatencyBucket(12345, 0) == 0, "zero rate is not bucket 0");
+
+	// Microsecond clock: exact bucket edges.
+	SIM_CHECK(PipeStats_LatencyBucket(124, 1000000) == 0 && PipeStats_LatencyBucket(125, 1000000) == 1 &&
+	          PipeStats_LatencyBucket(249, 1000000) == 1 && PipeStats_LatencyBucket(250, 1000000) == 2 &&
+	          PipeStats_LatencyBucket(31999, 1000000) == 8 && PipeStats_LatencyBucket(32000, 1000000) == 9,
+	          "microsecond clock edges");
+}
+
+// The counters of PIPE_STATS_COUNTERS that Xfer_CompleteRequest updates.
+typedef struct _SIM_COUNTERS
+{
+	volatile long Requests;
+	volatile long Errors;
+	volatile long InFlight;
+	volatile long InFlightPeak;
+	volatile long long Bytes;
+	volatile long Latency[PIPE_STATS_LATENCY_BUCKETS];
+} SIM_COUNTERS;
+
+typedef struct _SIM_THREAD
+{
+	pthread_t Thread;
+	unsigned int Seed;
+	unsigned int Requests;
+
+	// What this thread counted on its own.
+	long Errors;
+	long long Bytes;
+	long Latency[PIPE_STATS_LATENCY_BUCKETS];
+} SIM_THREAD;
+
+static SIM_COUNTERS Sim_Counters;
+
+static void* Sim_CompleteThread(void* context)
+{
+	SIM_THREAD* thread = (SIM_THREAD*)context;
+	unsigned long long elapsed;
+	unsigned int r, transferred, bucket;
+	long inFlight, peak;
+
+	for (r = 0; r < thread->Requests; r++)
+	{
+		// Xfer_StatsBegin
+		inFlight = __sync_add_and_fetch(&Sim_Counters.InFlight, 1);
+		do
+		{
+			peak = Sim_Counters.InFlightPeak;
+			if (inFlight <= peak) break;
+		}
+		while (!__sync_bool_compare_and_swap(&Sim_Counters.InFlightPeak, peak, inFlight));
+
+		thread->Seed = thread->Seed * 1103515245 + 12345;
+		elapsed = (thread->Seed >> 8) % 400000;		// up to 40ms on a 10 MHz clock
+		transferred = (thread->Seed >> 4) & 0xFFFF;
+
+		// Xfer_CompleteRequest
+		__sync_add_and_fetch(&Sim_Counters.Requests, 1);
+		if (transferred)
+			__sync_add_and_fetch(&Sim_Counters.Bytes, (long long)transferred);
+		if ((thread->Seed & 0xF) == 0)
+		{
+			__sync_add_and_fetch(&Sim_Counters.Errors, 1);
+			thread->Errors++;
+		}
+		bucket = PipeStats_LatencyBucket(elapsed, 10000000);
+		__sync_add_and_fetch(&Sim_Counters.Latency[bucket], 1);
+		__sync_sub_and_fetch(&Sim_Counters.InFlight, 1);
+
+		thread->Bytes += transferred;
+		thread->Latency[bucket]++;
+	}
+	return NULL;
+}
+
+static void Sim_CheckAccumulate(unsigned int requests)
+{
+	static SIM_THREAD threads[SIM_THREADS];
+	long errors = 0, latencyTotal = 0, latency[PIPE_STATS_LATENCY_BUCKETS];
+	long long bytes = 0;
+	unsigned int t, bucket;
+
+	memset(&Sim_Counters, 0, sizeof(Sim_Counters));
+	memset(threads, 0, sizeof(threads));
+	memset(latency, 0, sizeof(latency));
+
+	for (t = 0; t < SIM_THREADS; t++)
+	{
+		threads[t].Seed = t + 1;
+		threads[t].Requests = requests;
+		pthread_create(&threads[t].Thread, NULL, Sim_CompleteThread, &threads[t]);
+	}
+	for (t = 0; t < SIM_THREADS; t++)
+	{
+		pthread_join(threads[t].Thread, NULL);
+		errors += threads[t].Errors;
+		bytes += threads[t].Bytes;
+		for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS; bucket++)
+			latency[bucket] += threads[t].Latency[bucket];
+	}
+
+	for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS; bucket++)
+	{
+		SIM_CHECK(Sim_Counters.Latency[bucket] == latency[bucket], "accumulate: bucket %u has %ld, threads counted %ld",
+		          bucket, Sim_Counters.Latency[bucket], latency[bucket]);
+		latencyTotal += Sim_Counters.Latency[bucket];
+	}
+
+	SIM_CHECK(Sim_Counters.Requests == (long)requests * SIM_THREADS && latencyTotal == Sim_Counters.Requests,
+	          "accumulate: %ld requests, %ld in buckets", Sim_Counters.Requests, latencyTotal);
+	SIM_CHECK(Sim_Counters.Errors == errors && Sim_Counters.Bytes == bytes, "accumulate: errors %ld/%ld bytes %lld/%lld",
+	          Sim_Counters.Errors, errors, Sim_Counters.Bytes, bytes);
+	SIM_CHECK(Sim_Counters.InFlight == 0 && Sim_Counters.InFlightPeak >= 1 && Sim_Counters.InFlightPeak <= SIM_THREADS,
+	          "accumulate: in flight %ld, peak %ld", Sim_Counters.InFlight, Sim_Counters.InFlightPeak);
+
+	printf("accumulate: %ld requests from %d threads, in-flight peak %ld\n", Sim_Counters.Requests, SIM_THREADS, Sim_Counters.InFlightPeak);
+	for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS; bucket++)
+	{
+		if (PipeStats_BucketLimitUs(bucket))
+			printf("  < %6uus : %ld\n", PipeStats_BucketLimitUs(bucket), Sim_Counters.Latency[bucket]);
+		else
+			printf("  >= %5uus : %ld\n", PipeStats_BucketLimitUs(bucket - 1), Sim_Counters.Latency[bucket]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int requests = 1000000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "requests=", 9))
+			requests = (unsigned int)atoi(argv[i] + 9);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	Sim_CheckLimits();
+	Sim_CheckBuckets();
+	Sim_CheckAccumulate(requests);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,448 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of pipelined bulk/interrupt stages. (see drv_xfer_pipeline.h)
+//
+// Drives XFER_PIPELINE the way Xfer_PipelineAdvance does against a
+// simulated endpoint. The endpoint serves stages in the order they were
+// sent, but completions are delivered to the pipeline in random order.
+//
+// Reads: the device sends a random stream of full and short packets. A stage
+//        takes packets until it is full or a short packet arrives. Every
+//        depth must leave the same bytes and the same length in the user
+//        buffer as depth 1 (one stage at a time).
+// Writes: one stage may fail part way. Transferred must count every stage
+//        sent before it plus the bytes the failed stage moved, and the ZLPs
+//        must be sent when nothing fails.
+// Cancel: the transfer is aborted with stages in flight. No stage may be
+//        sent after the abort, the transfer must still finish once every
+//        stage is retired, and only bytes retired before the abort count.
+//
+// Usage: pipeline_sim [rounds=<count>] [seed=<seed>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drv_xfer_pipeline.h"
+
+#define SIM_MPS					64
+#define SIM_MAX_LENGTH			(SIM_MPS * 96)
+#define SIM_STATUS_FAILED		(-2)
+#define SIM_STATUS_CANCELLED	(-1)
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+static unsigned int Sim_Seed = 1;
+
+static unsigned int Sim_Random(unsigned int range)
+{
+	Sim_Seed = (Sim_Seed * 1103515245) + 12345;
+	return ((Sim_Seed >> 16) & 0x7FFF) % range;
+}
+
+// Device side of the endpoint.
+typedef struct _SIM_DEVICE
+{
+	// Read: packet sizes the device sends, in order.
+	unsigned int Packets[SIM_MAX_LENGTH];
+	unsigned int PacketCount;
+	unsigned int PacketPos;
+	unsigned int StreamPos;
+
+	// Write: the stage (in send order) that fails, and the bytes it moves.
+	unsigned int FailStage;
+	unsigned int FailActual;
+
+	// Stages in send order; Served of them have been handled by the device.
+	unsigned int Sent[1024];
+	unsigned int SentCount;
+	unsigned int Served;
+
+	// Per stage index: served by the device but not yet completed.
+	int Completed[XFER_PIPELINE_MAX_DEPTH];
+	int Status[XFER_PIPELINE_MAX_DEPTH];
+	unsigned int Actual[XFER_PIPELINE_MAX_DEPTH];
+
+	unsigned int ZlpsSent;
+} SIM_DEVICE;
+
+static unsigned char Sim_Stream(unsigned int pos)
+{
+	return (unsigned char)((pos * 7) ^ (pos >> 8));
+}
+
+static void Sim_DeviceInit(SIM_DEVICE* device, int isRead, unsigned int length)
+{
+	unsigned int pos, total = 0;
+
+	memset(device, 0, sizeof(*device));
+	if (isRead)
+	{
+		// Enough packets to fill the buffer, whatever the stages are.
+		for (pos = 0; total < length + SIM_MPS; pos++)
+		{
+			device->Packets[pos] = Sim_Random(4) ? SIM_MPS : Sim_Random(SIM_MPS);
+			total += device->Packets[pos];
+		}
+		device->PacketCount = pos;
+	}
+	device->FailStage = (unsigned int) - 1;
+}
+
+// The device serves the oldest stage it has not served yet.
+static int Sim_DeviceServe(SIM_DEVICE* device, XFER_PIPELINE* pipeline, unsigned char* buffer, int cancelled)
+{
+	unsigned int stageIndex, packet, sendIndex;
+	XFER_STAGE* stage;
+
+	if (device->Served == device->SentCount)
+		return 0;
+
+	sendIndex = device->Served++;
+	stageIndex = device->Sent[sendIndex];
+	stage = &pipeline->Stages[stageIndex];
+
+	device->Status[stageIndex] = 0;
+	device->Actual[stageIndex] = 0;
+
+	if (cancelled)
+	{
+		device->Status[stageIndex] = SIM_STATUS_CANCELLED;
+	}
+	else if (pipeline->IsRead)
+	{
+		while (device->Actual[stageIndex] < stage->Length)
+		{
+			packet = device->Packets[device->PacketPos++];
+			for (; packet; packet--, device->Actual[stageIndex]++, device->StreamPos++)
+				buffer[stage->Offset + device->Actual[stageIndex]] = Sim_Stream(device->StreamPos);
+			if (device->Packets[device->PacketPos - 1] < SIM_MPS)
+				break;
+		}
+	}
+	else if (sendIndex == device->FailStage)
+	{
+		device->Status[stageIndex] = SIM_STATUS_FAILED;
+		device->Actual[stageIndex] = device->FailActual < stage->Length ? device->FailActual : stage->Length;
+	}
+	else
+	{
+		device->Actual[stageIndex] = stage->Length;
+		if (!stage->Length)
+			device->ZlpsSent++;
+	}
+
+	device->Completed[stageIndex] = 1;
+	return 1;
+}
+
+// Delivers one served stage completion, picked at random.
+static int Sim_DeviceComplete(SIM_DEVICE* device, XFER_PIPELINE* pipeline)
+{
+	unsigned int stageIndex, start = Sim_Random(pipeline->Depth);
+	unsigned int pos;
+
+	for (pos = 0; pos < pipeline->Depth; pos++)
+	{
+		stageIndex = (start + pos) % pipeline->Depth;
+		if (device->Completed[stageIndex])
+		{
+			device->Completed[stageIndex] = 0;
+			XferPipeline_StageDone(pipeline, stageIndex, device->Status[stageIndex], device->Actual[stageIndex]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+typedef struct _SIM_RESULT
+{
+	unsigned int Transferred;
+	int Status;
+	unsigned int StagesSent;
+	unsigned int SentAfterAbort;
+	unsigned int TransferredAtAbort;
+	unsigned int MaxInFlight;
+	int Finished;
+} SIM_RESULT;
+
+// Runs one transfer. abortAfter is the number of stages sent before the
+// transfer is cancelled; -1 runs it to the end.
+static void Sim_Run(
+    XFER_PIPELINE* pipeline,
+    SIM_DEVICE* device,
+    unsigned char* buffer,
+    int isRead,
+    unsigned int length,
+    unsigned int zlps,
+    int abortAfter,
+    SIM_RESULT* result)
+{
+	XFER_PIPELINE_MOVE move;
+	XFER_PIPELINE_NEXT next;
+	unsigned int stageIndex, steps;
+	int aborted = 0;
+
+	memset(result, 0, sizeof(*result));
+	XferPipeline_Begin(pipeline, isRead, length, 0, zlps);
+
+	for (steps = 0; steps < 1000000; steps++)
+	{
+		if (!aborted && abortAfter >= 0 && device->SentCount >= (unsigned int)abortAfter)
+		{
+			XferPipeline_Abort(pipeline, SIM_STATUS_CANCELLED);
+			result->TransferredAtAbort = pipeline->Transferred;
+			aborted = 1;
+		}
+
+		switch (Sim_Random(4))
+		{
+		case 0:
+			next = XferPipeline_NextStage(pipeline, &stageIndex);
+			if (next == XFER_PIPELINE_FINISHED)
+			{
+				result->Finished = 1;
+				result->Transferred = pipeline->Transferred;
+				result->Status = pipeline->Status;
+				return;
+			}
+			if (next == XFER_PIPELINE_SEND)
+			{
+				if (aborted) result->SentAfterAbort++;
+				device->Sent[device->SentCount++ % 1024] = stageIndex;
+				result->StagesSent++;
+				if (pipeline->Count > result->MaxInFlight)
+					result->MaxInFlight = pipeline->Count;
+			}
+			break;
+		case 1:
+			Sim_DeviceServe(device, pipeline, buffer, aborted);
+			break;
+		case 2:
+			Sim_DeviceComplete(device, pipeline);
+			break;
+		default:
+			while (XferPipeline_Retire(pipeline, &move))
+			{
+				if (move.Length)
+					memmove(&buffer[move.DstOffset], &buffer[move.SrcOffset], move.Length);
+			}
+			break;
+		}
+	}
+}
+
+static void Sim_CheckReads(unsigned int rounds)
+{
+	static SIM_DEVICE device;
+	static unsigned char buffer[SIM_MAX_LENGTH], expected[SIM_MAX_LENGTH];
+	XFER_PIPELINE pipeline;
+	SIM_RESULT result, reference;
+	unsigned int round, depth, length, maxTransferSize, pos, seed;
+	unsigned int deepest = 0;
+
+	for (round = 0; round < rounds; round++)
+	{
+		length = 1 + Sim_Random(SIM_MAX_LENGTH);
+		maxTransferSize = SIM_MPS * (1 + Sim_Random(16));
+		seed = Sim_Seed;
+
+		// One stage at a time is the reference.
+		Sim_DeviceInit(&device, 1, length);
+		XferPipeline_Init(&pipeline, 1, SIM_MPS, maxTransferSize);
+		Sim_Run(&pipeline, &device, expected, 1, length, 0, -1, &reference);
+
+		for (pos = 0; pos < reference.Transferred; pos++)
+		{
+			if (expected[pos] != Sim_Stream(pos)) break;
+		}
+		SIM_CHECK(reference.Finished && pos == reference.Transferred && length - reference.Transferred < SIM_MPS,
+		          "read round %u depth 1: %u of %u bytes", round, reference.Transferred, length);
+
+		for (depth = 2; depth <= XFER_PIPELINE_MAX_DEPTH; depth++)
+		{
+			Sim_Seed = seed;
+			Sim_DeviceInit(&device, 1, length);
+			memset(buffer, 0, sizeof(buffer));
+			XferPipeline_Init(&pipeline, depth, SIM_MPS, maxTransferSize);
+			Sim_Run(&pipeline, &device, buffer, 1, length, 0, -1, &result);
+
+			SIM_CHECK(result.Finished && result.Status == 0, "read round %u depth %u: did not finish", round, depth);
+			SIM_CHECK(result.Transferred == reference.Transferred && !memcmp(buffer, expected, result.Transferred),
+			          "read round %u depth %u: %u bytes, depth 1 read %u", round, depth, result.Transferred, reference.Transferred);
+			SIM_CHECK(result.MaxInFlight <= depth, "read round %u depth %u: %u stages in flight", round, depth, result.MaxInFlight);
+			if (result.MaxInFlight > deepest) deepest = result.MaxInFlight;
+		}
+	}
+	printf("reads    : %u transfers at depths 1-%d match one stage at a time (up to %u stages in flight)\n",
+	       rounds, XFER_PIPELINE_MAX_DEPTH, deepest);
+}
+
+static void Sim_CheckWrites(unsigned int rounds)
+{
+	static SIM_DEVICE device;
+	static unsigned char buffer[SIM_MAX_LENGTH];
+	XFER_PIPELINE pipeline;
+	SIM_RESULT result;
+	unsigned int round, length, maxTransferSize, zlps, stages, expected, depth;
+
+	for (round = 0; round < rounds; round++)
+	{
+		length = Sim_Random(SIM_MAX_LENGTH);
+		maxTransferSize = SIM_MPS * (1 + Sim_Random(16));
+		zlps = Sim_Random(3);
+		depth = 1 + Sim_Random(XFER_PIPELINE_MAX_DEPTH);
+		stages = (length + maxTransferSize - 1) / maxTransferSize;
+
+		Sim_DeviceInit(&device, 0, length);
+		if (Sim_Random(2) && stages)
+		{
+			device.FailStage = Sim_Random(stages);
+			device.FailActual = Sim_Random(maxTransferSize);
+		}
+
+		XferPipeline_Init(&pipeline, depth, SIM_MPS, maxTransferSize);
+		Sim_Run(&pipeline, &device, buffer, 0, length, zlps, -1, &result);
+
+		if (device.FailStage == (unsigned int) - 1)
+		{
+			SIM_CHECK(result.Finished && result.Status == 0 && result.Transferred == length,
+			          "write round %u depth %u: %u of %u bytes, status %d", round, depth, result.Transferred, length, result.Status);
+			SIM_CHECK(result.StagesSent == stages + zlps && device.ZlpsSent == zlps,
+			          "write round %u: %u stages and %u ZLPs sent, expected %u and %u", round, result.StagesSent, device.ZlpsSent, stages + zlps, zlps);
+		}
+		else
+		{
+			expected = device.FailStage * maxTransferSize;
+			expected += device.FailActual < length - expected ? device.FailActual : length - expected;
+			SIM_CHECK(result.Finished && result.Status == SIM_STATUS_FAILED && result.Transferred == expected,
+			          "write round %u depth %u: stage %u failed, %u bytes counted, expected %u", round, depth, device.FailStage, result.Transferred, expected);
+			// ZLPs may already be in flight when the failure is retired; they are not counted.
+			SIM_CHECK(device.ZlpsSent <= zlps, "write round %u: %u ZLPs sent", round, device.ZlpsSent);
+		}
+	}
+	printf("writes   : %u transfers count every byte sent up to the first failure\n", rounds);
+}
+
+static void Sim_CheckCancel(unsigned int rounds)
+{
+	static SIM_DEVICE device;
+	static unsigned char buffer[SIM_MAX_LENGTH];
+	XFER_PIPELINE pipeline;
+	SIM_RESULT result;
+	unsigned int round, length, depth, pos;
+	int isRead, abortAfter;
+
+	for (round = 0; round < rounds; round++)
+	{
+		isRead = round & 1;
+		length = SIM_MPS * 8 + Sim_Random(SIM_MAX_LENGTH - SIM_MPS * 8);
+		depth = 2 + Sim_Random(XFER_PIPELINE_MAX_DEPTH - 1);
+		abortAfter = (int)Sim_Random(8);
+
+		Sim_DeviceInit(&device, isRead, length);
+		memset(buffer, 0, sizeof(buffer));
+		XferPipeline_Init(&pipeline, depth, SIM_MPS, SIM_MPS);
+		Sim_Run(&pipeline, &device, buffer, isRead, length, 0, abortAfter, &result);
+
+		SIM_CHECK(result.Finished, "cancel round %u: did not finish", round);
+		SIM_CHECK(result.SentAfterAbort == 0, "cancel round %u: %u stages sent after the abort", round, result.SentAfterAbort);
+		SIM_CHECK(result.Status == SIM_STATUS_CANCELLED && result.Transferred == result.TransferredAtAbort,
+		          "cancel round %u: status %d, %u bytes counted, %u retired at the abort",
+		          round, result.Status, result.Transferred, result.TransferredAtAbort);
+		SIM_CHECK(pipeline.Count == 0 && XferPipeline_NextStage(&pipeline, &pos) == XFER_PIPELINE_WAIT,
+		          "cancel round %u: stages left after finishing", round);
+
+		if (isRead)
+		{
+			for (pos = 0; pos < result.Transferred; pos++)
+				if (buffer[pos] != Sim_Stream(pos)) break;
+			SIM_CHECK(pos == result.Transferred, "cancel round %u: read data differs at %u", round, pos);
+		}
+	}
+	printf("cancel   : %u transfers aborted after 0-7 stages finish and send nothing more\n", rounds);
+}
+
+// Two stages in flight: the second completes first and is not retired until
+// the first is; the first is short so the second's data moves down.
+static void Sim_CheckOrder(void)
+{
+	static unsigned char buffer[SIM_MPS * 4];
+	XFER_PIPELINE pipeline;
+	XFER_PIPELINE_MOVE move;
+	unsigned int first, second;
+
+	XferPipeline_Init(&pipeline, 2, SIM_MPS, SIM_MPS * 2);
+	XferPipeline_Begin(&pipeline, 1, sizeof(buffer), 0, 0);
+
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &first) == XFER_PIPELINE_SEND, "order: first stage not sent");
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &second) == XFER_PIPELINE_SEND, "order: second stage not sent");
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &second) == XFER_PIPELINE_WAIT, "order: third stage sent at depth 2");
+	SIM_CHECK(pipeline.Stages[second].Offset == SIM_MPS * 2, "order: second stage at %u", pipeline.Stages[second].Offset);
+
+	memset(buffer + SIM_MPS * 2, 0xB2, SIM_MPS * 2);
+	XferPipeline_StageDone(&pipeline, second, 0, SIM_MPS * 2);
+	SIM_CHECK(!XferPipeline_Retire(&pipeline, &move), "order: retired ahead of the oldest stage");
+
+	memset(buffer, 0xB1, 10);
+	XferPipeline_StageDone(&pipeline, first, 0, 10);
+	SIM_CHECK(XferPipeline_Retire(&pipeline, &move) && move.Length == 0 && pipeline.Transferred == 10, "order: first stage");
+	SIM_CHECK(XferPipeline_Retire(&pipeline, &move) && move.SrcOffset == SIM_MPS * 2 && move.DstOffset == 10 && move.Length == SIM_MPS * 2,
+	          "order: second stage move %u->%u (%u)", move.SrcOffset, move.DstOffset, move.Length);
+	SIM_CHECK(pipeline.Transferred == 10 + SIM_MPS * 2, "order: %u bytes", pipeline.Transferred);
+
+	// The rest is the sub-packet tail; it is left for the over-run buffer.
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &first) == XFER_PIPELINE_SEND && pipeline.Stages[first].Offset == 10 + SIM_MPS * 2 &&
+	          pipeline.Stages[first].Length == SIM_MPS, "order: stage after compaction");
+	XferPipeline_StageDone(&pipeline, first, 0, SIM_MPS);
+	XferPipeline_Retire(&pipeline, &move);
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &first) == XFER_PIPELINE_FINISHED && pipeline.Transferred == SIM_MPS * 4 - 54,
+	          "order: finished with %u bytes", pipeline.Transferred);
+	SIM_CHECK(XferPipeline_NextStage(&pipeline, &first) == XFER_PIPELINE_WAIT, "order: FINISHED returned twice");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 2000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "rounds=", 7))
+			rounds = (unsigned int)atoi(argv[i] + 7);
+		else if (!strncmp(argv[i], "seed=", 5))
+			Sim_Seed = (unsigned int)strtoul(argv[i] + 5, NULL, 0);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	Sim_CheckOrder();
+	Sim_CheckReads(rounds);
+	Sim_CheckWrites(rounds);
+	Sim_CheckCancel(rounds);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
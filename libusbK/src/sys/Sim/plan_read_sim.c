@@ -0,0 +1,266 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the bulk/interrupt read stage planner. (XferPipeline_PlanRead)
+//
+// Table tests, then an exhaustive comparison over small packet sizes against
+// the stage split mXfer_SubmitNextRead and Xfer_ReadBulk used before the
+// planner (leftovers first, then whole packets direct, then the sub-packet
+// tail through the over-run buffer). The planner must not change it.
+//
+// Then counts the URBs and the bytes copied out of the over-run buffer for
+// streams of odd-sized reads with the same read path as drv_xfer_bulk.c.
+//
+// Usage: plan_read_sim [requests=<count>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drv_xfer_pipeline.h"
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+// The stage split before XferPipeline_PlanRead.
+static void Sim_ReferencePlan(
+    unsigned int length,
+    unsigned int transferred,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize,
+    unsigned int leftover,
+    XFER_READ_PLAN* plan)
+{
+	unsigned int remaining, stageLength;
+
+	memset(plan, 0, sizeof(*plan));
+
+	remaining = transferred < length ? length - transferred : 0;
+	plan->LeftoverCopy = leftover > remaining ? remaining : leftover;
+	remaining -= plan->LeftoverCopy;
+	if (!remaining)
+	{
+		plan->Complete = 1;
+		return;
+	}
+
+	stageLength = remaining > maxTransferSize ? maxTransferSize : remaining;
+	if (stageLength < maxPacketSize)
+		plan->BounceLength = stageLength;
+	else
+		plan->DirectLength = stageLength - (stageLength % maxPacketSize);
+}
+
+static void Sim_CheckTable(void)
+{
+	static const struct
+	{
+		const char* Name;
+		unsigned int Length, Transferred, MaxPacketSize, MaxTransferSize, Leftover;
+		XFER_READ_PLAN Plan;	// LeftoverCopy, DirectLength, BounceLength, Complete
+	} cases[] =
+	{
+		{"whole packets",             1024,    0, 512, 65536,   0, {  0, 1024,   0, 0}},
+		{"packets and a tail",        1100,    0, 512, 65536,   0, {  0, 1024,   0, 0}},
+		{"tail only",                 1100, 1024, 512, 65536,   0, {  0,    0,  76, 0}},
+		{"one byte",                     1,    0, 512, 65536,   0, {  0,    0,   1, 0}},
+		{"stage limit",             200000,    0, 512, 65536,   0, {  0, 65536,  0, 0}},
+		{"stage limit, not packets", 200000,   0, 512, 65000,   0, {  0, 64512,  0, 0}},
+		{"stage limit below a packet", 1000,   0, 512,   300,   0, {  0,    0, 300, 0}},
+		{"leftovers cover it",          10,    0, 512, 65536,  40, { 10,    0,   0, 1}},
+		{"leftovers exactly",           40,    0, 512, 65536,  40, { 40,    0,   0, 1}},
+		{"leftovers then tail",        100,    0, 512, 65536,  40, { 40,    0,  60, 0}},
+		{"leftovers then packets",    1064,    0, 512, 65536,  40, { 40, 1024,   0, 0}},
+		{"leftovers then odd rest",   1000,    0, 512, 65536, 100, {100,  512,   0, 0}},
+		{"already done",               512,  512, 512, 65536,   0, {  0,    0,   0, 1}},
+		{"past the end",               512,  600, 512, 65536,  20, {  0,    0,   0, 1}},
+		{"full speed interrupt",        70,    0,   8,  4096,   0, {  0,   64,   0, 0}},
+		{"full speed interrupt tail",   70,   64,   8,  4096,   3, {  3,    0,   3, 0}},
+	};
+	XFER_READ_PLAN plan;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		XferPipeline_PlanRead(cases[i].Length, cases[i].Transferred, cases[i].MaxPacketSize, cases[i].MaxTransferSize, cases[i].Leftover, &plan);
+		SIM_CHECK(!memcmp(&plan, &cases[i].Plan, sizeof(plan)),
+		          "%s: leftover %u direct %u bounce %u complete %d, expected %u %u %u %d", cases[i].Name,
+		          plan.LeftoverCopy, plan.DirectLength, plan.BounceLength, plan.Complete,
+		          cases[i].Plan.LeftoverCopy, cases[i].Plan.DirectLength, cases[i].Plan.BounceLength, cases[i].Plan.Complete);
+	}
+}
+
+static void Sim_CheckExhaustive(void)
+{
+	static const unsigned int packetSizes[] = {1, 3, 8, 16};
+	XFER_READ_PLAN plan, expected;
+	unsigned int p, maxPacketSize, maxTransferSize, length, transferred, leftover, remaining;
+	unsigned long cases = 0, errors = 0;
+
+	for (p = 0; p < sizeof(packetSizes) / sizeof(packetSizes[0]); p++)
+	{
+		maxPacketSize = packetSizes[p];
+		for (maxTransferSize = 1; maxTransferSize <= maxPacketSize * 5; maxTransferSize++)
+		{
+			for (length = 0; length <= maxPacketSize * 12; length++)
+			{
+				for (transferred = 0; transferred <= length + 1; transferred++)
+				{
+					for (leftover = 0; leftover <= maxPacketSize; leftover++)
+					{
+						XferPipeline_PlanRead(length, transferred, maxPacketSize, maxTransferSize, leftover, &plan);
+						Sim_ReferencePlan(length, transferred, maxPacketSize, maxTransferSize, leftover, &expected);
+						cases++;
+
+						remaining = transferred < length ? length - transferred : 0;
+						if (memcmp(&plan, &expected, sizeof(plan)) ||
+						        plan.LeftoverCopy + plan.DirectLength + plan.BounceLength > remaining ||
+						        plan.DirectLength % maxPacketSize ||
+						        plan.DirectLength > maxTransferSize ||
+						        plan.BounceLength >= maxPacketSize ||
+						        (plan.Complete != 0) + (plan.DirectLength != 0) + (plan.BounceLength != 0) != 1)
+						{
+							if (errors++ < 5)
+								printf("FAIL: length %u transferred %u mps %u max %u leftover %u\n", length, transferred, maxPacketSize, maxTransferSize, leftover);
+						}
+					}
+				}
+			}
+		}
+	}
+	SIM_CHECK(errors == 0, "exhaustive: %lu of %lu plans differ", errors, cases);
+	printf("exhaustive: %lu plans match the previous stage split\n", cases);
+}
+
+// The read path of drv_xfer_bulk.c for a device that always has data.
+typedef struct _SIM_READ_COUNTS
+{
+	unsigned long long Requested;
+	unsigned long long Urbs;
+	unsigned long long DirectBytes;
+	unsigned long long BounceReads;
+	unsigned long long CopiedBytes;
+} SIM_READ_COUNTS;
+
+static void Sim_Read(unsigned int length, unsigned int maxPacketSize, unsigned int maxTransferSize, unsigned int* leftover, SIM_READ_COUNTS* counts)
+{
+	XFER_READ_PLAN plan;
+	unsigned int transferred = 0;
+
+	counts->Requested += length;
+
+	// Xfer_ReadBulk: leftovers of the last over-run read.
+	if (*leftover)
+	{
+		XferPipeline_PlanRead(length, 0, maxPacketSize, maxTransferSize, *leftover, &plan);
+		counts->CopiedBytes += plan.LeftoverCopy;
+		transferred += plan.LeftoverCopy;
+		*leftover -= plan.LeftoverCopy;
+		if (plan.Complete) return;
+	}
+
+	// mXfer_SubmitNextRead / Xfer_ReadBulkComplete.
+	for (;;)
+	{
+		XferPipeline_PlanRead(length, transferred, maxPacketSize, maxTransferSize, 0, &plan);
+		if (plan.Complete) return;
+
+		counts->Urbs++;
+		if (plan.BounceLength)
+		{
+			// One packet into OverBuf; the rest is left for the next request.
+			counts->BounceReads++;
+			counts->CopiedBytes += plan.BounceLength;
+			*leftover = maxPacketSize - plan.BounceLength;
+			return;
+		}
+		counts->DirectBytes += plan.DirectLength;
+		transferred += plan.DirectLength;
+	}
+}
+
+static void Sim_CopyVolume(unsigned int requests)
+{
+	static const struct
+	{
+		const char* Name;
+		unsigned int MaxPacketSize;
+		unsigned int MinLength, MaxLength;
+	} workloads[] =
+	{
+		{"FS bulk, 1-63 byte reads",         64,    1,    63},
+		{"FS bulk, 100-1000 byte reads",     64,  100,  1000},
+		{"HS bulk, 1-511 byte reads",       512,    1,   511},
+		{"HS bulk, 4-64 KB odd reads",      512, 4096, 65536},
+		{"HS bulk, whole packet reads",     512,  512,   512},
+	};
+	SIM_READ_COUNTS counts;
+	unsigned int w, r, length, leftover, seed;
+
+	printf("copy volume (%u reads each, 64 KB stages):\n", requests);
+	printf("  %-30s %10s %10s %12s %10s\n", "workload", "URBs/read", "bounces", "copied B/rd", "copied %");
+	for (w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++)
+	{
+		memset(&counts, 0, sizeof(counts));
+		leftover = 0;
+		seed = 1;
+		for (r = 0; r < requests; r++)
+		{
+			seed = (seed * 1103515245) + 12345;
+			length = workloads[w].MinLength + ((seed >> 8) % (workloads[w].MaxLength - workloads[w].MinLength + 1));
+			Sim_Read(length, workloads[w].MaxPacketSize, 65536, &leftover, &counts);
+		}
+
+		// Every byte copied out of OverBuf is less than a packet per read.
+		SIM_CHECK(counts.CopiedBytes < (unsigned long long)workloads[w].MaxPacketSize * requests * 2,
+		          "%s: %llu bytes copied", workloads[w].Name, counts.CopiedBytes);
+		SIM_CHECK(counts.DirectBytes + counts.CopiedBytes == counts.Requested, "%s: %llu of %llu bytes read",
+		          workloads[w].Name, counts.DirectBytes + counts.CopiedBytes, counts.Requested);
+
+		printf("  %-30s %10.2f %10llu %12.1f %9.2f%%\n", workloads[w].Name,
+		       (double)counts.Urbs / requests, counts.BounceReads,
+		       (double)counts.CopiedBytes / requests, 100.0 * counts.CopiedBytes / counts.Requested);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int requests = 100000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "requests=", 9))
+			requests = (unsigned int)atoi(argv[i] + 9);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!requests) requests = 1;
+
+	Sim_CheckTable();
+	Sim_CheckExhaustive();
+	Sim_CopyVolume(requests);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Table tests of the stage size planner. (XferPipeline_CalcStageSize)
+//
+// Each row is one pipe: type, speed, USB stack, packet size, stack limit
+// and MAXIMUM_STAGE_SIZE policy, with the automatic and effective stage
+// sizes expected. Then every combination of a few values per input is
+// checked against the rules that hold for any pipe: the policy, rounded
+// down to whole packets, only applies to bulk and interrupt pipes, the
+// automatic bulk and interrupt sizes are whole packets, and the stack
+// limit is never exceeded.
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <string.h>
+#include "drv_xfer_pipeline.h"
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+#define KB	1024
+#define MB	(1024 * 1024)
+
+#define BULK	XFER_SPLIT_PIPE_BULK
+#define INTR	XFER_SPLIT_PIPE_INTERRUPT
+#define ISO		XFER_SPLIT_PIPE_ISOCHRONOUS
+#define CTRL	XFER_SPLIT_PIPE_OTHER
+
+#define XP		0x500
+#define VISTA	0x600
+#define WIN8	0x602
+
+typedef struct _SIM_SPLIT_CASE
+{
+	const char* Name;
+	XFER_SPLIT_PARAMS Params;	// PipeType, HighSpeed, UsbdiVersion, MaxPacketSize, StackMaxTransferSize, StageSizePolicy
+	unsigned int AutoStageSize;
+	unsigned int StageSize;
+} SIM_SPLIT_CASE;
+
+static const SIM_SPLIT_CASE Sim_Cases[] =
+{
+	// Automatic bulk sizes.
+	{"HS bulk, Win8 stack",              {BULK, 1, WIN8,  512, 0xFFFFFFFF, 0},   4 * MB,   4 * MB},
+	{"HS bulk, Vista/7 stack",           {BULK, 1, VISTA, 512, 0xFFFFFFFF, 0},   2 * MB,   2 * MB},
+	{"HS bulk, XP stack",                {BULK, 1, XP,    512, 0xFFFFFFFF, 0},   2 * MB,   2 * MB},
+	{"FS bulk, Win8 stack",              {BULK, 0, WIN8,   64, 0xFFFFFFFF, 0},  256 * KB, 256 * KB},
+	{"FS bulk, Vista/7 stack",           {BULK, 0, VISTA,  64, 0xFFFFFFFF, 0},  256 * KB, 256 * KB},
+	{"FS bulk, XP stack",                {BULK, 0, XP,     64, 0xFFFFFFFF, 0},  256 * KB, 256 * KB},
+	{"FS bulk 8 byte packets, XP stack", {BULK, 0, XP,      8, 0xFFFFFFFF, 0},   32 * KB,  32 * KB},
+	{"newer stack uses the Win8 rule",   {BULK, 1, 0x700, 512, 0xFFFFFFFF, 0},   4 * MB,   4 * MB},
+
+	// Rules are rounded down to whole packets.
+	{"HS bulk, odd packet size",         {BULK, 1, WIN8,  500, 0xFFFFFFFF, 0},   4194000,  4194000},
+	{"FS bulk, odd packet size",         {BULK, 0, VISTA,  63, 0xFFFFFFFF, 0},   262143,   262143},
+
+	// The stack limit is never exceeded.
+	{"HS bulk, 1 MB stack limit",        {BULK, 1, WIN8,  512, 1 * MB,     0},   4 * MB,   1 * MB},
+	{"HS bulk, 64 KB stack limit",       {BULK, 1, VISTA, 512, 64 * KB,    0},   2 * MB,  64 * KB},
+
+	// MAXIMUM_STAGE_SIZE policy.
+	{"policy overrides the rule",        {BULK, 1, WIN8,  512, 0xFFFFFFFF, 64 * KB},  4 * MB,  64 * KB},
+	{"policy above the rule",            {BULK, 0, VISTA,  64, 0xFFFFFFFF, 8 * MB},  256 * KB, 8 * MB},
+	{"policy rounded down to packets",   {BULK, 1, WIN8,  512, 0xFFFFFFFF, 1000},    4 * MB,   512},
+	{"policy below one packet",          {BULK, 1, WIN8,  512, 0xFFFFFFFF, 100},     4 * MB,   512},
+	{"policy capped by the stack",       {BULK, 1, WIN8,  512, 1 * MB,     8 * MB},  4 * MB,   1 * MB},
+	{"policy on an interrupt pipe",      {INTR, 1, WIN8,   64, 0xFFFFFFFF, 4096},   256 * KB, 4096},
+
+	// Interrupt pipes keep MaximumPacketSize * 4096.
+	{"HS interrupt",                     {INTR, 1, WIN8, 1024, 0xFFFFFFFF, 0},   4 * MB,   4 * MB},
+	{"FS interrupt",                     {INTR, 0, VISTA,  64, 0xFFFFFFFF, 0},  256 * KB, 256 * KB},
+	{"LS interrupt",                     {INTR, 0, XP,      8, 0xFFFFFFFF, 0},   32 * KB,  32 * KB},
+
+	// Iso transfers are limited by packets per URB; the policy is ignored.
+	{"HS iso",                           {ISO,  1, WIN8, 3072, 0xFFFFFFFF, 0},   3 * MB,   3 * MB},
+	{"FS iso",                           {ISO,  0, VISTA, 1023, 0xFFFFFFFF, 0},  260865,   260865},
+	{"HS iso, stack limit",              {ISO,  1, WIN8, 1024, 256 * KB,   0},   1 * MB,  256 * KB},
+	{"iso ignores the policy",           {ISO,  1, WIN8, 1024, 0xFFFFFFFF, 4096}, 1 * MB,  1 * MB},
+
+	// Other pipes only have the stack limit.
+	{"control",                          {CTRL, 1, WIN8,   64, 4096,       0},   4096,     4096},
+	{"control ignores the policy",       {CTRL, 1, WIN8,   64, 4096,       512}, 4096,     4096},
+};
+
+static void Sim_CheckCases(void)
+{
+	const SIM_SPLIT_CASE* test;
+	unsigned int i, autoStageSize, stageSize;
+
+	for (i = 0; i < sizeof(Sim_Cases) / sizeof(Sim_Cases[0]); i++)
+	{
+		test = &Sim_Cases[i];
+		autoStageSize	= XferPipeline_AutoStageSize(&test->Params);
+		stageSize		= XferPipeline_CalcStageSize(&test->Params);
+
+		SIM_CHECK(autoStageSize == test->AutoStageSize && stageSize == test->StageSize,
+		          "%s: auto %u stage %u, expected %u and %u", test->Name, autoStageSize, stageSize, test->AutoStageSize, test->StageSize);
+	}
+	printf("%u table cases\n", (unsigned int)(sizeof(Sim_Cases) / sizeof(Sim_Cases[0])));
+}
+
+// Rules that hold for any pipe.
+static void Sim_CheckRules(void)
+{
+	static const unsigned int packetSizes[] = {8, 63, 64, 512, 1023, 1024, 3072};
+	static const unsigned int stackLimits[] = {4096, 64 * KB, 1 * MB, 0xFFFFFFFF};
+	static const unsigned int policies[] = {0, 1, 1000, 64 * KB, 16 * MB};
+	static const unsigned int versions[] = {XP, VISTA, WIN8};
+	XFER_SPLIT_PARAMS params;
+	unsigned int t, s, v, p, l, o, stageSize, autoStageSize, expected, errors = 0, cases = 0;
+	int bulkOrInterrupt;
+
+	for (t = CTRL; t <= ISO; t++)
+	for (s = 0; s < 2; s++)
+	for (v = 0; v < sizeof(versions) / sizeof(versions[0]); v++)
+	for (p = 0; p < sizeof(packetSizes) / sizeof(packetSizes[0]); p++)
+	for (l = 0; l < sizeof(stackLimits) / sizeof(stackLimits[0]); l++)
+	for (o = 0; o < sizeof(policies) / sizeof(policies[0]); o++)
+	{
+		memset(&params, 0, sizeof(params));
+		params.PipeType				= (XFER_SPLIT_PIPE_TYPE)t;
+		params.HighSpeed			= (int)s;
+		params.UsbdiVersion			= versions[v];
+		params.MaxPacketSize		= packetSizes[p];
+		params.StackMaxTransferSize	= stackLimits[l];
+		params.StageSizePolicy		= policies[o];
+
+		stageSize		= XferPipeline_CalcStageSize(&params);
+		autoStageSize	= XferPipeline_AutoStageSize(&params);
+		bulkOrInterrupt	= t == BULK || t == INTR;
+		cases++;
+
+		// The policy replaces the automatic size for bulk and interrupt pipes only.
+		expected = autoStageSize;
+		if (bulkOrInterrupt && params.StageSizePolicy)
+		{
+			expected = params.StageSizePolicy - params.StageSizePolicy % params.MaxPacketSize;
+			if (!expected) expected = params.MaxPacketSize;
+		}
+		if (expected > params.StackMaxTransferSize)
+			expected = params.StackMaxTransferSize;
+
+		if (stageSize != expected || !stageSize || (bulkOrInterrupt && autoStageSize % params.MaxPacketSize))
+		{
+			if (errors++ < 5)
+				printf("FAIL: type %u hs %u usbdi %03Xh mps %u stack %u policy %u: stage %u auto %u\n",
+				       t, s, versions[v], packetSizes[p], stackLimits[l], policies[o], stageSize, autoStageSize);
+		}
+	}
+	SIM_CHECK(errors == 0, "rules: %u of %u pipes", errors, cases);
+	printf("%u pipes follow the stage size rules\n", cases);
+}
+
+int main(void)
+{
+	Sim_CheckCases();
+	Sim_CheckRules();
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
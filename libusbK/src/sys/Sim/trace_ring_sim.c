@@ -0,0 +1,241 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+// Host check of the binary event trace ring. (see drv_trace_ring.h)
+//
+// Wrap     : a ring written past its size keeps the newest records, oldest
+//            first, and counts every overwritten record as lost.
+// Snapshot : a snapshot smaller than the ring keeps the newest records and
+//            counts the rest as lost; copied + lost is always the number of
+//            records ever written.
+// Writers  : several threads write into one ring while another takes
+//            snapshots. Every copied record must be complete (its arguments
+//            match its writer and sequence), snapshots must be in write
+//            order, and copied + lost must match the write index the
+//            snapshot started from.
+//
+// Usage: trace_ring_sim [events=<per writer>]
+//
+// Returns non-zero if a check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "drv_trace_ring.h"
+
+#define SIM_RING_RECORDS	256
+#define SIM_WRITERS			4
+
+static int Sim_Failed;
+
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); Sim_Failed++; } } while (0)
+
+// Arguments a writer puts in the record for its n-th event.
+#define SIM_ARG(mWriter, mCount, mArg)	(((mWriter) << 24) ^ ((mCount) * 4 + (mArg)))
+
+static void Sim_WriteEvent(KTRACE_RING* ring, unsigned int writer, unsigned int count)
+{
+	TraceRing_Write(ring, (unsigned char)writer, (unsigned short)(count & 0xFFFF), (long long)count * 10,
+	                SIM_ARG(writer, count, 0), SIM_ARG(writer, count, 1), SIM_ARG(writer, count, 2), SIM_ARG(writer, count, 3));
+}
+
+static int Sim_RecordComplete(const KTRACE_RECORD* record, unsigned int* count)
+{
+	unsigned int writer = record->Cpu;
+	unsigned int n = (unsigned int)(record->Timestamp / 10);
+
+	*count = n;
+	return record->Sequence && record->EventId == (n & 0xFFFF) && record->Timestamp == (long long)n * 10 &&
+	       record->Args[0] == SIM_ARG(writer, n, 0) && record->Args[1] == SIM_ARG(writer, n, 1) &&
+	       record->Args[2] == SIM_ARG(writer, n, 2) && record->Args[3] == SIM_ARG(writer, n, 3);
+}
+
+static void Sim_CheckWrap(void)
+{
+	static KTRACE_RECORD records[SIM_RING_RECORDS], dst[SIM_RING_RECORDS * 2];
+	static const unsigned int writeCounts[] = {0, 1, SIM_RING_RECORDS - 1, SIM_RING_RECORDS, SIM_RING_RECORDS + 1, SIM_RING_RECORDS * 10 + 7};
+	static const unsigned int snapshotSizes[] = {SIM_RING_RECORDS * 2, SIM_RING_RECORDS, 100, 1, 0};
+	KTRACE_RING ring;
+	unsigned int w, s, n, copied, lost, expected, first, count;
+
+	for (w = 0; w < sizeof(writeCounts) / sizeof(writeCounts[0]); w++)
+	{
+		TraceRing_Init(&ring, records, SIM_RING_RECORDS);
+		for (n = 0; n < writeCounts[w]; n++)
+			Sim_WriteEvent(&ring, 0, n);
+
+		for (s = 0; s < sizeof(snapshotSizes) / sizeof(snapshotSizes[0]); s++)
+		{
+			lost = 0;
+			copied = TraceRing_Snapshot(&ring, dst, snapshotSizes[s], &lost);
+
+			expected = writeCounts[w];
+			if (expected > SIM_RING_RECORDS) expected = SIM_RING_RECORDS;
+			if (expected > snapshotSizes[s]) expected = snapshotSizes[s];
+			first = writeCounts[w] - expected;
+
+			SIM_CHECK(copied == expected && copied + lost == writeCounts[w],
+			          "%u events, snapshot of %u: copied %u lost %u, expected %u and %u",
+			          writeCounts[w], snapshotSizes[s], copied, lost, expected, writeCounts[w] - expected);
+
+			for (n = 0; n < copied; n++)
+			{
+				if (!Sim_RecordComplete(&dst[n], &count) || count != first + n || dst[n].Sequence != first + n + 1)
+				{
+					SIM_CHECK(0, "%u events, snapshot of %u: record %u is event %u, expected %u", writeCounts[w], snapshotSizes[s], n, count, first + n);
+					break;
+				}
+			}
+		}
+	}
+
+	// Lost accumulates across snapshots into the same counter, as the driver dump does per processor.
+	TraceRing_Init(&ring, records, SIM_RING_RECORDS);
+	for (n = 0; n < SIM_RING_RECORDS + 50; n++)
+		Sim_WriteEvent(&ring, 0, n);
+	lost = 7;
+	TraceRing_Snapshot(&ring, dst, SIM_RING_RECORDS, &lost);
+	SIM_CHECK(lost == 7 + 50, "lost is not added to the caller's count (%u)", lost);
+
+	// A record that is being written is skipped and counted as lost.
+	TraceRing_Init(&ring, records, SIM_RING_RECORDS);
+	for (n = 0; n < 10; n++)
+		Sim_WriteEvent(&ring, 0, n);
+	records[4].Sequence = 0;
+	lost = 0;
+	copied = TraceRing_Snapshot(&ring, dst, SIM_RING_RECORDS, &lost);
+	SIM_CHECK(copied == 9 && lost == 1 && dst[4].Sequence == 6, "partly written record: copied %u lost %u", copied, lost);
+}
+
+typedef struct _SIM_WRITER
+{
+	pthread_t Thread;
+	KTRACE_RING* Ring;
+	unsigned int Writer;
+	unsigned int Events;
+} SIM_WRITER;
+
+static volatile int Sim_WritersDone;
+
+static void* Sim_WriterThread(void* context)
+{
+	SIM_WRITER* writer = (SIM_WRITER*)context;
+	unsigned int n;
+
+	for (n = 0; n < writer->Events; n++)
+		Sim_WriteEvent(writer->Ring, writer->Writer, n);
+	return NULL;
+}
+
+static void Sim_CheckWriters(unsigned int events)
+{
+	static KTRACE_RECORD records[SIM_RING_RECORDS], dst[SIM_RING_RECORDS];
+	static SIM_WRITER writers[SIM_WRITERS];
+	KTRACE_RING ring;
+	unsigned int w, n, copied, lost, startIndex, endIndex, count, snapshots = 0, torn = 0, unordered = 0, accounting = 0;
+	unsigned long long totalCopied = 0, totalLost = 0;
+	unsigned int lastCount[SIM_WRITERS];
+	int running;
+
+	TraceRing_Init(&ring, records, SIM_RING_RECORDS);
+	for (w = 0; w < SIM_WRITERS; w++)
+	{
+		writers[w].Ring = &ring;
+		writers[w].Writer = w;
+		writers[w].Events = events;
+		pthread_create(&writers[w].Thread, NULL, Sim_WriterThread, &writers[w]);
+	}
+
+	do
+	{
+		startIndex = (unsigned int)ring.WriteIndex;
+		running = startIndex < events * SIM_WRITERS;
+
+		lost = 0;
+		copied = TraceRing_Snapshot(&ring, dst, SIM_RING_RECORDS, &lost);
+		endIndex = (unsigned int)ring.WriteIndex;
+		snapshots++;
+
+		// The snapshot reads WriteIndex once, somewhere between these two.
+		if (copied + lost < startIndex || copied + lost > endIndex)
+			accounting++;
+
+		memset(lastCount, 0xFF, sizeof(lastCount));
+		for (n = 0; n < copied; n++)
+		{
+			if (!Sim_RecordComplete(&dst[n], &count) || dst[n].Cpu >= SIM_WRITERS)
+			{
+				torn++;
+				continue;
+			}
+			if (n && dst[n].Sequence <= dst[n - 1].Sequence)
+				unordered++;
+
+			// Each writer's events appear in the order it wrote them.
+			if (lastCount[dst[n].Cpu] != 0xFFFFFFFF && count <= lastCount[dst[n].Cpu])
+				unordered++;
+			lastCount[dst[n].Cpu] = count;
+		}
+		totalCopied += copied;
+		totalLost += lost;
+	}
+	while (running);
+
+	for (w = 0; w < SIM_WRITERS; w++)
+		pthread_join(writers[w].Thread, NULL);
+
+	SIM_CHECK(torn == 0, "writers: %u incomplete records copied", torn);
+	SIM_CHECK(unordered == 0, "writers: %u records out of order", unordered);
+	SIM_CHECK(accounting == 0, "writers: %u snapshots where copied + lost is not the write index", accounting);
+
+	lost = 0;
+	copied = TraceRing_Snapshot(&ring, dst, SIM_RING_RECORDS, &lost);
+	SIM_CHECK(copied == SIM_RING_RECORDS && copied + lost == events * SIM_WRITERS,
+	          "writers: final snapshot copied %u lost %u of %u", copied, lost, events * SIM_WRITERS);
+
+	printf("writers : %d threads x %u events, %u snapshots while writing (%llu copied, %llu lost)\n",
+	       SIM_WRITERS, events, snapshots, totalCopied, totalLost);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int events = 1000000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "events=", 7))
+			events = (unsigned int)atoi(argv[i] + 7);
+		else
+		{
+			printf("invalid argument! %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!events) events = 1;
+
+	SIM_CHECK(sizeof(KTRACE_RECORD) == 32 && sizeof(KTRACE_DUMP_HEADER) == 24, "record %u and header %u bytes",
+	          (unsigned int)sizeof(KTRACE_RECORD), (unsigned int)sizeof(KTRACE_DUMP_HEADER));
+
+	Sim_CheckWrap();
+	Sim_CheckWriters(events);
+
+	printf("%s\n", Sim_Failed ? "FAILED" : "PASSED");
+	return Sim_Failed ? 1 : 0;
+}
@@ -4,6 +4,7 @@
 #ifndef __DRV_COMMON_H__
 #define __DRV_COMMON_H__
 
+#include "drv_trace.h"
 #include "drv_device.h"
 #include "drv_interface.h"
 #include "drv_request.h"
@@ -0,0 +1,273 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <string.h>
+#include "drv_ctrl_cache.h"
+
+// bmRequestType fields.
+#define CTRL_DIR_IN(mRequestType)		(((mRequestType) & 0x80) != 0)
+#define CTRL_TYPE(mRequestType)			(((mRequestType) >> 5) & 0x3)
+
+#define CTRL_TYPE_STANDARD				0
+#define CTRL_TYPE_CLASS					1
+#define CTRL_TYPE_VENDOR				2
+
+// Standard requests.
+#define CTRL_REQUEST_GET_DESCRIPTOR		0x06
+#define CTRL_REQUEST_SET_DESCRIPTOR		0x07
+#define CTRL_REQUEST_SET_CONFIGURATION	0x09
+#define CTRL_REQUEST_SET_INTERFACE		0x0B
+
+static unsigned int CtrlCache_TypeClass(unsigned char requestType)
+{
+	switch (CTRL_TYPE(requestType))
+	{
+	case CTRL_TYPE_STANDARD:
+		return CTRL_CACHE_STANDARD;
+	case CTRL_TYPE_CLASS:
+		return CTRL_CACHE_CLASS;
+	case CTRL_TYPE_VENDOR:
+		return CTRL_CACHE_VENDOR;
+	}
+	return 0;
+}
+
+static int CtrlCache_KeyEqual(const CTRL_CACHE_KEY* a, const CTRL_CACHE_KEY* b)
+{
+	return a->RequestType == b->RequestType &&
+	       a->Request == b->Request &&
+	       a->Value == b->Value &&
+	       a->Index == b->Index &&
+	       a->Length == b->Length;
+}
+
+// Removes an entry and closes the gap it leaves in the arena.
+static void CtrlCache_Remove(CTRL_CACHE* cache, unsigned int index)
+{
+	CTRL_CACHE_ENTRY* entry = &cache->Entries[index];
+	unsigned int offset = entry->Offset;
+	unsigned int length = entry->Length;
+	unsigned int pos;
+
+	if (length)
+	{
+		memmove(cache->Arena + offset, cache->Arena + offset + length, cache->ArenaUsed - offset - length);
+		cache->ArenaUsed -= length;
+	}
+
+	for (pos = index + 1; pos < cache->EntryCount; pos++)
+	{
+		cache->Entries[pos - 1] = cache->Entries[pos];
+		cache->Entries[pos - 1].Offset -= length;
+	}
+	cache->EntryCount--;
+}
+
+static void CtrlCache_EvictOne(CTRL_CACHE* cache)
+{
+	unsigned int oldest = 0;
+	unsigned int pos;
+
+	for (pos = 1; pos < cache->EntryCount; pos++)
+	{
+		// Ticks wrap; compare ages, not ticks.
+		if (cache->Tick - cache->Entries[pos].LastUse > cache->Tick - cache->Entries[oldest].LastUse)
+			oldest = pos;
+	}
+
+	CtrlCache_Remove(cache, oldest);
+	cache->Evictions++;
+}
+
+void CtrlCache_Init(
+    CTRL_CACHE* cache,
+    unsigned char* arena,
+    unsigned int arenaSize)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->Arena = arena;
+	cache->ArenaSize = arena ? arenaSize : 0;
+}
+
+void CtrlCache_SetFlags(
+    CTRL_CACHE* cache,
+    unsigned int flags)
+{
+	unsigned int dropped;
+
+	if (!cache->Arena)
+		flags = 0;
+
+	flags &= CTRL_CACHE_ALL;
+	dropped = cache->Flags & ~flags;
+	cache->Flags = flags;
+
+	if (dropped)
+		CtrlCache_Invalidate(cache, dropped);
+}
+
+unsigned int CtrlCache_Classify(
+    const CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key)
+{
+	unsigned int requestClass;
+
+	if (!cache->Flags || !CTRL_DIR_IN(key->RequestType))
+		return 0;
+
+	if (key->Length == 0 || key->Length > CTRL_CACHE_MAX_RESPONSE || key->Length > cache->ArenaSize)
+		return 0;
+
+	requestClass = CtrlCache_TypeClass(key->RequestType);
+	if (!(requestClass & cache->Flags))
+		return 0;
+
+	// GET_STATUS, GET_CONFIGURATION, GET_INTERFACE and SYNCH_FRAME describe
+	// state; only descriptors are fixed.
+	if (requestClass == CTRL_CACHE_STANDARD && key->Request != CTRL_REQUEST_GET_DESCRIPTOR)
+		return 0;
+
+	return requestClass;
+}
+
+int CtrlCache_Lookup(
+    CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key,
+    unsigned char* buffer,
+    unsigned int bufferLength,
+    unsigned int* length)
+{
+	unsigned int pos;
+	unsigned int copyLength;
+
+	for (pos = 0; pos < cache->EntryCount; pos++)
+	{
+		CTRL_CACHE_ENTRY* entry = &cache->Entries[pos];
+		if (!CtrlCache_KeyEqual(&entry->Key, key))
+			continue;
+
+		copyLength = entry->Length < bufferLength ? entry->Length : bufferLength;
+		if (copyLength)
+			memcpy(buffer, cache->Arena + entry->Offset, copyLength);
+
+		entry->LastUse = ++cache->Tick;
+		cache->Hits++;
+
+		*length = copyLength;
+		return 1;
+	}
+
+	cache->Misses++;
+	*length = 0;
+	return 0;
+}
+
+int CtrlCache_Insert(
+    CTRL_CACHE* cache,
+    unsigned int generation,
+    const CTRL_CACHE_KEY* key,
+    const unsigned char* data,
+    unsigned int length)
+{
+	unsigned int pos;
+	CTRL_CACHE_ENTRY* entry;
+
+	if (generation != cache->Generation || !CtrlCache_Classify(cache, key))
+		return 0;
+
+	// A response never outgrows its request.
+	if (length > key->Length)
+		length = key->Length;
+
+	// Two identical requests can be in flight at once; keep the newer response.
+	for (pos = 0; pos < cache->EntryCount; pos++)
+	{
+		if (CtrlCache_KeyEqual(&cache->Entries[pos].Key, key))
+		{
+			CtrlCache_Remove(cache, pos);
+			break;
+		}
+	}
+
+	while (cache->EntryCount &&
+	        (cache->EntryCount == CTRL_CACHE_MAX_ENTRIES || cache->ArenaSize - cache->ArenaUsed < length))
+	{
+		CtrlCache_EvictOne(cache);
+	}
+
+	entry = &cache->Entries[cache->EntryCount++];
+	entry->Key = *key;
+	entry->Offset = cache->ArenaUsed;
+	entry->Length = length;
+	entry->LastUse = ++cache->Tick;
+
+	if (length)
+		memcpy(cache->Arena + entry->Offset, data, length);
+	cache->ArenaUsed += length;
+
+	return 1;
+}
+
+void CtrlCache_Invalidate(
+    CTRL_CACHE* cache,
+    unsigned int classes)
+{
+	unsigned int pos;
+
+	// Requests that are in flight now must not store their responses.
+	cache->Generation++;
+	cache->Invalidations++;
+
+	pos = cache->EntryCount;
+	while (pos--)
+	{
+		if (CtrlCache_TypeClass(cache->Entries[pos].Key.RequestType) & classes)
+			CtrlCache_Remove(cache, pos);
+	}
+}
+
+void CtrlCache_OnSetup(
+    CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key)
+{
+	unsigned int requestClass;
+
+	if (!cache->Flags || CTRL_DIR_IN(key->RequestType))
+		return;
+
+	requestClass = CtrlCache_TypeClass(key->RequestType);
+	if (requestClass != CTRL_CACHE_STANDARD)
+	{
+		if (requestClass & cache->Flags)
+			CtrlCache_Invalidate(cache, requestClass);
+		return;
+	}
+
+	switch (key->Request)
+	{
+	case CTRL_REQUEST_SET_CONFIGURATION:
+		CtrlCache_Invalidate(cache, CTRL_CACHE_ALL);
+		break;
+	case CTRL_REQUEST_SET_INTERFACE:
+		CtrlCache_Invalidate(cache, CTRL_CACHE_CLASS | CTRL_CACHE_VENDOR);
+		break;
+	case CTRL_REQUEST_SET_DESCRIPTOR:
+		CtrlCache_Invalidate(cache, CTRL_CACHE_STANDARD);
+		break;
+	}
+}
@@ -0,0 +1,148 @@
+/*! \file drv_ctrl_cache.h
+*/
+
+#ifndef __DRV_CTRL_CACHE_H__
+#define __DRV_CTRL_CACHE_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_ctrl_cache.c function prototypes.
+// Control response cache for read-only control requests on the default pipe.
+//
+// When the CONTROL_RESPONSE_CACHE policy of pipe 0 enables a request class,
+// successful device-to-host responses of that class are kept and repeats of
+// the same setup packet (bmRequestType, bRequest, wValue, wIndex, wLength)
+// are answered from memory. Enabled classes are:
+//   CTRL_CACHE_STANDARD  GET_DESCRIPTOR (string, BOS, class specific, ...)
+//   CTRL_CACHE_CLASS     any class IN request
+//   CTRL_CACHE_VENDOR    any vendor IN request
+//
+// Cached responses are dropped:
+// - all of them on device reset, set configuration and resume (D0 entry)
+// - class and vendor responses on an alternate setting change
+// - by host-to-device requests sent through the cache (see CtrlCache_OnSetup)
+// - for each class that is disabled by the policy
+// A response that was in flight when its class was dropped is not stored.
+//
+// All responses live in one arena supplied by the caller; the least recently
+// used responses are evicted to make room. The arena is never grown.
+//
+// Like drv_xfer_pipeline.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. It takes no locks; callers
+// serialize every call.
+//
+
+// Request classes. (CONTROL_CACHE_STANDARD/CLASS/VENDOR)
+#define CTRL_CACHE_STANDARD			0x01
+#define CTRL_CACHE_CLASS			0x02
+#define CTRL_CACHE_VENDOR			0x04
+#define CTRL_CACHE_ALL				(CTRL_CACHE_STANDARD|CTRL_CACHE_CLASS|CTRL_CACHE_VENDOR)
+
+// Most responses kept at one time.
+#define CTRL_CACHE_MAX_ENTRIES		32
+
+// Arena size the driver allocates; the memory bound of the cache.
+#define CTRL_CACHE_ARENA_SIZE		16384
+
+// Largest response that is cached. (larger responses always go to the device)
+#define CTRL_CACHE_MAX_RESPONSE		4096
+
+typedef struct _CTRL_CACHE_KEY
+{
+	unsigned char RequestType;
+	unsigned char Request;
+	unsigned short Value;
+	unsigned short Index;
+	unsigned short Length;
+} CTRL_CACHE_KEY;
+
+typedef struct _CTRL_CACHE_ENTRY
+{
+	CTRL_CACHE_KEY Key;
+
+	// Response range of the arena.
+	unsigned int Offset;
+	unsigned int Length;
+
+	// CtrlCache_Lookup tick of the last hit or insert.
+	unsigned int LastUse;
+} CTRL_CACHE_ENTRY;
+
+typedef struct _CTRL_CACHE
+{
+	// Enabled request classes; 0 disables the cache.
+	unsigned int Flags;
+
+	unsigned char* Arena;
+	unsigned int ArenaSize;
+
+	// Entries are kept in arena order; Entries[i] data starts after Entries[i-1].
+	CTRL_CACHE_ENTRY Entries[CTRL_CACHE_MAX_ENTRIES];
+	unsigned int EntryCount;
+	unsigned int ArenaUsed;
+
+	unsigned int Tick;
+
+	// Bumped by every invalidation. (see CtrlCache_Insert)
+	unsigned int Generation;
+
+	// Statistics.
+	unsigned int Hits;
+	unsigned int Misses;
+	unsigned int Evictions;
+	unsigned int Invalidations;
+} CTRL_CACHE;
+
+// Assigns the arena and clears the cache. The cache starts disabled.
+void CtrlCache_Init(
+    CTRL_CACHE* cache,
+    unsigned char* arena,
+    unsigned int arenaSize);
+
+// Sets the enabled request classes; responses of classes that are no longer
+// enabled are dropped.
+void CtrlCache_SetFlags(
+    CTRL_CACHE* cache,
+    unsigned int flags);
+
+// Gets the request class (CTRL_CACHE_STANDARD/CLASS/VENDOR) of a setup packet
+// whose response may be cached, or 0 if it may not. Only requests of enabled
+// classes qualify.
+unsigned int CtrlCache_Classify(
+    const CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key);
+
+// Copies a cached response into buffer. Returns non-zero on a hit and sets
+// length to the number of bytes copied.
+int CtrlCache_Lookup(
+    CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key,
+    unsigned char* buffer,
+    unsigned int bufferLength,
+    unsigned int* length);
+
+// Stores a response. generation is the cache Generation sampled when the
+// request was sent; if anything was invalidated since, nothing is stored.
+// Returns non-zero if the response was stored.
+int CtrlCache_Insert(
+    CTRL_CACHE* cache,
+    unsigned int generation,
+    const CTRL_CACHE_KEY* key,
+    const unsigned char* data,
+    unsigned int length);
+
+// Drops the responses of the given request classes.
+void CtrlCache_Invalidate(
+    CTRL_CACHE* cache,
+    unsigned int classes);
+
+// Applies the invalidation rules of a request that is about to be sent to the
+// device. Host-to-device requests may change what the device returns:
+//   SET_CONFIGURATION  drops everything
+//   SET_INTERFACE      drops class and vendor responses
+//   SET_DESCRIPTOR     drops standard responses
+//   class/vendor OUT   drops responses of the same class
+void CtrlCache_OnSetup(
+    CTRL_CACHE* cache,
+    const CTRL_CACHE_KEY* key);
+
+#endif
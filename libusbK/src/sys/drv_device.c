@@ -25,6 +25,7 @@ extern volatile LONG DeviceInstanceNumber;
 #pragma alloc_text(PAGE, Device_OnPrepareHardware)
 #pragma alloc_text(PAGE, Device_OnFileCreate)
 #pragma alloc_text(PAGE, Device_OnFileClose)
+#pragma alloc_text(PAGE, Device_OnFileCleanup)
 #pragma alloc_text(PAGE, Device_Create)
 #pragma alloc_text(PAGE, Device_FetchConfigDescriptor)
 #pragma alloc_text(PAGE, Device_Configure)
@@ -114,7 +115,7 @@ Return Value:
 	    &fileConfig,
 	    Device_OnFileCreate,
 	    Device_OnFileClose,
-	    WDF_NO_EVENT_CALLBACK
+	    Device_OnFileCleanup
 	);
 
 	//
@@ -232,6 +233,20 @@ Return Value:
 		goto Error;
 	}
 
+	status = XferCtrl_InitCache(deviceContext);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("XferCtrl_InitCache failed. status=%Xh\n", status);
+		goto Error;
+	}
+
+	status = Xfer_InitCQueue(deviceContext);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("Xfer_InitCQueue failed. status=%Xh\n", status);
+		goto Error;
+	}
+
 	USBD_GetUSBDIVersion(&deviceContext->UsbVersionInfo);
 
 	//
@@ -361,11 +376,13 @@ Return Value:
 
 NTSTATUS Device_OnD0Entry(WDFDEVICE Device, WDF_POWER_DEVICE_STATE WdfPowerDeviceState)
 {
-	UNREFERENCED_PARAMETER(Device);
 	UNREFERENCED_PARAMETER(WdfPowerDeviceState);
 
 	USBMSGN("Active. D%u -> D0", WdfPowerDeviceState - 1);
 
+	// The device may have been reset while it was suspended.
+	XferCtrl_InvalidateCache(GetDeviceContext(Device), CTRL_CACHE_ALL);
+
 	return STATUS_SUCCESS;
 }
 
@@ -445,6 +462,7 @@ Return Value:
 	PDEVICE_CONTEXT             deviceContext;
 	PPIPE_CONTEXT               pipeContext;
 	PEPROCESS					pProcess;
+	WDF_OBJECT_ATTRIBUTES		attributes;
 	PAGED_CODE();
 
 	USBMSG("begins\n");
@@ -495,6 +513,19 @@ Return Value:
 		}
 	}
 
+	if (NT_SUCCESS(status))
+	{
+		// Guards the completion queue registered on this handle. (see drv_xfer_cqueue.c)
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = FileObject;
+		status = WdfSpinLockCreate(&attributes, &pFileContext->CQueue.Lock);
+		if (!NT_SUCCESS(status))
+		{
+			USBERR("WdfSpinLockCreate failed. status=%Xh\n", status);
+			pFileContext->CQueue.Lock = NULL;
+		}
+	}
+
 	InterlockedIncrement(&deviceContext->OpenedFileHandleCount);
 	WdfRequestComplete(Request, status);
 
@@ -519,6 +550,19 @@ VOID Device_OnFileClose(__in WDFFILEOBJECT FileObject)
 	}
 }
 
+VOID Device_OnFileCleanup(__in WDFFILEOBJECT FileObject)
+{
+	PFILE_CONTEXT               pFileContext;
+
+	PAGED_CODE();
+
+	pFileContext = GetFileContext(FileObject);
+
+	// Release the completion queue registered on this handle.
+	if (pFileContext && pFileContext->DeviceContext)
+		Xfer_UnregisterCQueue(pFileContext->DeviceContext, FileObject);
+}
+
 
 NTSTATUS Device_Create(__in WDFDEVICE Device)
 /*++
@@ -768,6 +812,8 @@ NTSTATUS Device_Configure(WDFDEVICE Device)
 	}
 	else
 	{
+		XferCtrl_InvalidateCache(deviceContext, CTRL_CACHE_ALL);
+
 		// get the interface count again; this should be the same as before since KMDF only supports
 		// the first configuration.
 		//
@@ -853,6 +899,7 @@ NTSTATUS Device_Reset(__in WDFDEVICE Device)
 
 	Pipe_StartAll(deviceContext, TRUE);
 
+	XferCtrl_InvalidateCache(deviceContext, CTRL_CACHE_ALL);
 
 	return status;
 }
@@ -15,6 +15,7 @@ EVT_WDF_DEVICE_D0_ENTRY Device_OnD0Entry;
 EVT_WDF_DEVICE_D0_EXIT Device_OnD0Exit;
 EVT_WDF_DEVICE_FILE_CREATE Device_OnFileCreate;
 EVT_WDF_FILE_CLOSE Device_OnFileClose;
+EVT_WDF_FILE_CLEANUP Device_OnFileCleanup;
 
 NTSTATUS Device_Reset(__in WDFDEVICE Device);
 NTSTATUS Device_Create(__in WDFDEVICE Device);
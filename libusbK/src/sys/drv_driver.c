@@ -94,8 +94,12 @@ Return Value:
 	{
 		DbgPrint("Test\n");
 		USBERR("WdfDriverCreate failed. status=%Xh\n", status);
+		return status;
 	}
 
+	// Tracing is optional; the driver runs without it.
+	Trace_Init(gWdfDriver);
+
 	return status;
 }
 
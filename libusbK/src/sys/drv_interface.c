@@ -187,7 +187,8 @@ NTSTATUS Interface_InitContext(__in PDEVICE_CONTEXT deviceContext,
 		// always update the pipe handle
 		pipeContext->Pipe = pipe;
 
-		pipeInfo.MaximumTransferSize = Pipe_CalcMaxTransferSize(IsHighSpeedDevice(deviceContext), pipeInfo.PipeType, pipeInfo.MaximumPacketSize, pipeInfo.MaximumTransferSize);
+		pipeContext->StackMaxTransferSize = pipeInfo.MaximumTransferSize;
+		pipeInfo.MaximumTransferSize = Pipe_CalcMaxTransferSize(deviceContext, pipeContext, NULL);
 		pipeContext->PipeInformation.MaximumTransferSize = pipeInfo.MaximumTransferSize;
 
 		USBDBG("configured %s pipe: PipeID=%02Xh MaximumPacketSize=%u MaximumTransferSize=%u PipeType=%s\n",
@@ -266,6 +267,9 @@ NTSTATUS Interface_SetAltSetting(__in  PDEVICE_CONTEXT deviceContext,
 		// fetch the setting back from WDF
 		(*interfaceContext)->SettingIndex = WdfUsbInterfaceGetConfiguredSettingIndex((*interfaceContext)->Interface);
 
+		// class and vendor requests may answer differently for the new setting.
+		XferCtrl_InvalidateCache(deviceContext, CTRL_CACHE_CLASS | CTRL_CACHE_VENDOR);
+
 		// delete the old queues and pipes
 		Interface_DeletePipesAndQueues((*interfaceContext));
 
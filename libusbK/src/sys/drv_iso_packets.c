@@ -0,0 +1,115 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <string.h>
+#include "drv_iso_packets.h"
+
+ISO_PACKETS_RESULT IsoPackets_CheckCount(
+    int numberOfPackets,
+    int isHighSpeed,
+    int maxPackets)
+{
+	if (numberOfPackets < 1 || numberOfPackets > maxPackets)
+		return ISO_PACKETS_INVALID_COUNT;
+
+	if (isHighSpeed && (numberOfPackets % 8))
+		return ISO_PACKETS_INVALID_COUNT;
+
+	return ISO_PACKETS_SUCCESS;
+}
+
+ISO_PACKETS_RESULT IsoPackets_BuildUrbTable(
+    const ISO_USER_PACKET* packets,
+    int numberOfPackets,
+    unsigned int maxBytesPerInterval,
+    unsigned int dataLength,
+    ISO_URB_PACKET* urbPackets,
+    int* errorIndex)
+{
+	int pos;
+	unsigned int offset;
+	unsigned int lastOffset = 0;
+
+	for (pos = 0; pos < numberOfPackets; pos++)
+	{
+		offset = packets[pos].Offset;
+		*errorIndex = pos;
+
+		if (offset >= dataLength)
+			return ISO_PACKETS_OUT_OF_RANGE;
+
+		if (maxBytesPerInterval)
+		{
+			if (offset < lastOffset)
+				return ISO_PACKETS_INVALID_ORDER;
+			if (offset - lastOffset > maxBytesPerInterval)
+				return ISO_PACKETS_PACKET_TOO_LONG;
+		}
+
+		urbPackets[pos].Offset	= offset;
+		urbPackets[pos].Length	= 0;
+		urbPackets[pos].Status	= 0;
+		lastOffset = offset;
+	}
+
+	*errorIndex = -1;
+	return ISO_PACKETS_SUCCESS;
+}
+
+ISO_PACKETS_RESULT IsoPackets_CheckTemplateLength(
+    const ISO_PACKET_TEMPLATE* packetTemplate,
+    unsigned int dataLength)
+{
+	if (packetTemplate->LastOffset >= dataLength)
+		return ISO_PACKETS_OUT_OF_RANGE;
+
+	return ISO_PACKETS_SUCCESS;
+}
+
+void IsoPackets_CopyTemplate(
+    const ISO_PACKET_TEMPLATE* packetTemplate,
+    ISO_URB_PACKET* urbPackets)
+{
+	memcpy(urbPackets, packetTemplate->Packets, sizeof(ISO_URB_PACKET) * packetTemplate->NumberOfPackets);
+}
+
+ISO_PACKETS_RESULT IsoPackets_BuildTemplate(
+    const ISO_USER_PACKET* packets,
+    int numberOfPackets,
+    int isHighSpeed,
+    unsigned int maxBytesPerInterval,
+    ISO_PACKET_TEMPLATE* packetTemplate,
+    int* errorIndex)
+{
+	ISO_PACKETS_RESULT result;
+
+	*errorIndex = -1;
+	result = IsoPackets_CheckCount(numberOfPackets, isHighSpeed, isHighSpeed ? ISO_PACKETS_MAX_HS : ISO_PACKETS_MAX_FS);
+	if (result != ISO_PACKETS_SUCCESS)
+		return result;
+
+	// The transfer length is checked against LastOffset when the template is used.
+	result = IsoPackets_BuildUrbTable(packets, numberOfPackets, maxBytesPerInterval, (unsigned int) - 1, packetTemplate->Packets, errorIndex);
+	if (result != ISO_PACKETS_SUCCESS)
+		return result;
+
+	packetTemplate->NumberOfPackets = numberOfPackets;
+	packetTemplate->LastOffset		= packets[numberOfPackets - 1].Offset;
+
+	return ISO_PACKETS_SUCCESS;
+}
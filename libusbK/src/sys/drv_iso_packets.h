@@ -0,0 +1,114 @@
+/*! \file drv_iso_packets.h
+*/
+
+#ifndef __DRV_ISO_PACKETS_H__
+#define __DRV_ISO_PACKETS_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_iso_packets.c function prototypes.
+// Validation of user iso packet arrays and URB packet table building.
+//
+// This module uses plain C types only; it does not include any WDK headers
+// and can be built and exercised outside of the driver. The packet structs
+// below have the same layout as KISO_PACKET and USBD_ISO_PACKET_DESCRIPTOR
+// (see the C_ASSERTs in drv_xfer_iso.c).
+//
+
+#define ISO_PACKETS_MAX_HS	1024
+#define ISO_PACKETS_MAX_FS	255
+
+typedef enum _ISO_PACKETS_RESULT
+{
+    ISO_PACKETS_SUCCESS = 0,
+
+    // NumberOfPackets is out of range for the device speed.
+    ISO_PACKETS_INVALID_COUNT,
+
+    // A packet offset is less than the one before it.
+    ISO_PACKETS_INVALID_ORDER,
+
+    // The distance between two packet offsets is more than the pipe can move in one interval.
+    ISO_PACKETS_PACKET_TOO_LONG,
+
+    // A packet offset is at or beyond the end of the transfer buffer.
+    ISO_PACKETS_OUT_OF_RANGE,
+} ISO_PACKETS_RESULT;
+
+// Same layout as KISO_PACKET.
+typedef struct _ISO_USER_PACKET
+{
+	unsigned int Offset;
+	unsigned short Length;
+	unsigned short Status;
+} ISO_USER_PACKET;
+
+// Same layout as USBD_ISO_PACKET_DESCRIPTOR.
+typedef struct _ISO_URB_PACKET
+{
+	unsigned int Offset;
+	unsigned int Length;
+	int Status;
+} ISO_URB_PACKET;
+
+// Pre-built URB packet table for the ISO_AUTO_PACKET_TEMPLATE pipe policy.
+typedef struct _ISO_PACKET_TEMPLATE
+{
+	int NumberOfPackets;
+
+	// Transfer buffers must be larger than this.
+	unsigned int LastOffset;
+
+	ISO_URB_PACKET Packets[1];
+} ISO_PACKET_TEMPLATE;
+
+#define ISO_PACKET_TEMPLATE_SIZE(mNumberOfPackets) \
+	(sizeof(ISO_PACKET_TEMPLATE) + (sizeof(ISO_URB_PACKET) * ((mNumberOfPackets) - 1)))
+
+// Checks NumberOfPackets for a transfer on a high-speed or full-speed pipe.
+// High-speed transfers must be a multiple of 8 packets (whole frames).
+ISO_PACKETS_RESULT IsoPackets_CheckCount(
+    int numberOfPackets,
+    int isHighSpeed,
+    int maxPackets);
+
+// Converts user packets to URB packets. Only the offsets are used; the
+// URB lengths and status are zeroed.
+//
+// maxBytesPerInterval - 0, or the largest distance allowed between two
+//                       consecutive offsets. Offsets must also be sorted
+//                       when this is non-zero.
+// dataLength          - The transfer buffer length; every offset must be
+//                       less than it.
+// errorIndex          - receives the packet index on failure.
+ISO_PACKETS_RESULT IsoPackets_BuildUrbTable(
+    const ISO_USER_PACKET* packets,
+    int numberOfPackets,
+    unsigned int maxBytesPerInterval,
+    unsigned int dataLength,
+    ISO_URB_PACKET* urbPackets,
+    int* errorIndex);
+
+// Checks that the last packet of a template starts inside a transfer
+// buffer of dataLength bytes.
+ISO_PACKETS_RESULT IsoPackets_CheckTemplateLength(
+    const ISO_PACKET_TEMPLATE* packetTemplate,
+    unsigned int dataLength);
+
+// Copies the URB packet table of a template into a transfer URB. The
+// result is the table IsoPackets_BuildUrbTable builds from the template's
+// user packets.
+void IsoPackets_CopyTemplate(
+    const ISO_PACKET_TEMPLATE* packetTemplate,
+    ISO_URB_PACKET* urbPackets);
+
+// Validates a packet template and builds its URB packet table.
+// template must have room for ISO_PACKET_TEMPLATE_SIZE(numberOfPackets) bytes.
+ISO_PACKETS_RESULT IsoPackets_BuildTemplate(
+    const ISO_USER_PACKET* packets,
+    int numberOfPackets,
+    int isHighSpeed,
+    unsigned int maxBytesPerInterval,
+    ISO_PACKET_TEMPLATE* packetTemplate,
+    int* errorIndex);
+
+#endif
@@ -0,0 +1,109 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_mem_pool.h"
+
+#define MemPool_BlockStride(mBlockSize) \
+	(((mBlockSize) + (MEM_POOL_ALIGNMENT - 1)) & ~(MEM_POOL_ALIGNMENT - 1))
+
+unsigned int MemPool_StorageSize(
+    unsigned int blockSize,
+    unsigned int blockCount)
+{
+	if (blockSize < sizeof(void*))
+		blockSize = sizeof(void*);
+
+	return MemPool_BlockStride(blockSize) * blockCount;
+}
+
+void MemPool_Init(
+    MEM_POOL* pool,
+    void* storage,
+    unsigned int blockSize,
+    unsigned int blockCount)
+{
+	unsigned int stride;
+	unsigned int blockIndex;
+
+	if (blockSize < sizeof(void*))
+		blockSize = sizeof(void*);
+	stride = MemPool_BlockStride(blockSize);
+
+	pool->Storage		= (unsigned char*)storage;
+	pool->BlockSize		= stride;
+	pool->BlockCount	= blockCount;
+	pool->FreeList		= 0;
+	pool->InUse			= 0;
+
+	pool->Stats.Hits		= 0;
+	pool->Stats.Misses		= 0;
+	pool->Stats.PeakInUse	= 0;
+
+	// Link the blocks so the lowest addresses are handed out first.
+	for (blockIndex = blockCount; blockIndex > 0; blockIndex--)
+	{
+		void** block = (void**)(pool->Storage + (blockIndex - 1) * stride);
+		*block = pool->FreeList;
+		pool->FreeList = block;
+	}
+}
+
+void* MemPool_Alloc(
+    MEM_POOL* pool,
+    unsigned int size)
+{
+	void** block;
+
+	if (size > pool->BlockSize || !pool->FreeList)
+	{
+		pool->Stats.Misses++;
+		return 0;
+	}
+
+	block = (void**)pool->FreeList;
+	pool->FreeList = *block;
+
+	pool->Stats.Hits++;
+	if (++pool->InUse > pool->Stats.PeakInUse)
+		pool->Stats.PeakInUse = pool->InUse;
+
+	return block;
+}
+
+void MemPool_Free(
+    MEM_POOL* pool,
+    void* block)
+{
+	*(void**)block = pool->FreeList;
+	pool->FreeList = block;
+	pool->InUse--;
+}
+
+int MemPool_Owns(
+    const MEM_POOL* pool,
+    const void* block)
+{
+	const unsigned char* blockPtr = (const unsigned char*)block;
+	unsigned int offset;
+
+	if (blockPtr < pool->Storage || blockPtr >= pool->Storage + pool->BlockSize * pool->BlockCount)
+		return 0;
+
+	offset = (unsigned int)(blockPtr - pool->Storage);
+	return (offset % pool->BlockSize) == 0;
+}
@@ -0,0 +1,81 @@
+/*! \file drv_mem_pool.h
+*/
+
+#ifndef __DRV_MEM_POOL_H__
+#define __DRV_MEM_POOL_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_mem_pool.c function prototypes.
+// Fixed-size block pool for per-request transfer memory.
+//
+// A pipe queue preallocates one block of storage when it is created and
+// hands it out in fixed-size blocks, so the submit path does not allocate
+// from nonpaged pool for every request. Requests larger than a block, or
+// made while every block is in use, are counted as misses and the caller
+// falls back to a dynamic allocation.
+//
+// Like drv_iso_packets.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. It takes no locks; the driver
+// (drv_xfer_iso.c) serializes every call with the pool lock.
+//
+
+// Blocks start on this boundary. (MEMORY_ALLOCATION_ALIGNMENT on x64)
+#define MEM_POOL_ALIGNMENT	16
+
+typedef struct _MEM_POOL_STATS
+{
+	// Allocations served from the pool.
+	unsigned int Hits;
+
+	// Allocations the caller had to make itself. (too large or pool empty)
+	unsigned int Misses;
+
+	// Most blocks ever in use at the same time.
+	unsigned int PeakInUse;
+} MEM_POOL_STATS;
+
+typedef struct _MEM_POOL
+{
+	// Configuration. (see MemPool_Init)
+	unsigned char* Storage;
+	unsigned int BlockSize;
+	unsigned int BlockCount;
+
+	// Free blocks; each free block holds the pointer to the next one.
+	void* FreeList;
+	unsigned int InUse;
+
+	MEM_POOL_STATS Stats;
+} MEM_POOL;
+
+// Gets the storage size MemPool_Init needs for blockCount blocks of at
+// least blockSize bytes.
+unsigned int MemPool_StorageSize(
+    unsigned int blockSize,
+    unsigned int blockCount);
+
+// Carves storage into blocks. storage must be MEM_POOL_ALIGNMENT aligned
+// and at least MemPool_StorageSize(blockSize, blockCount) bytes.
+void MemPool_Init(
+    MEM_POOL* pool,
+    void* storage,
+    unsigned int blockSize,
+    unsigned int blockCount);
+
+// Gets a block for an allocation of size bytes, or 0 (a miss) if size
+// is larger than a block or every block is in use.
+void* MemPool_Alloc(
+    MEM_POOL* pool,
+    unsigned int size);
+
+// Returns a block from MemPool_Alloc to the pool.
+void MemPool_Free(
+    MEM_POOL* pool,
+    void* block);
+
+// Non-zero if block is one of the pool's blocks.
+int MemPool_Owns(
+    const MEM_POOL* pool,
+    const void* block);
+
+#endif
@@ -0,0 +1,209 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include <string.h>
+#include "drv_packet_ring.h"
+
+void PacketRing_Init(
+    PACKET_RING* ring,
+    unsigned char* buffer,
+    unsigned int size)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->Buffer = buffer;
+	ring->Size = buffer ? (size & ~(PACKET_RING_ALIGN - 1)) : 0;
+}
+
+void PacketRing_Reset(
+    PACKET_RING* ring)
+{
+	ring->Read = 0;
+	ring->Write = 0;
+	ring->Used = 0;
+	ring->Packets = 0;
+	ring->Overrun = 0;
+}
+
+int PacketRing_Put(
+    PACKET_RING* ring,
+    const unsigned char* data,
+    unsigned int length,
+    long long timestamp)
+{
+	PACKET_RING_HEADER header;
+	unsigned int recordSize = PACKET_RING_RECORD_SIZE(length);
+	unsigned int tail = ring->Size - ring->Write;
+	unsigned int skip = 0;
+
+	// Records never wrap; a tail too small for the record is skipped.
+	if (tail < recordSize)
+		skip = tail;
+
+	if (recordSize > ring->Size || ring->Used + skip + recordSize > ring->Size)
+	{
+		ring->Overrun = 1;
+		ring->Dropped++;
+		return 0;
+	}
+
+	if (skip)
+	{
+		// Marks the skipped tail for the reader; a tail smaller than a header is implied.
+		if (skip >= PACKET_RING_HEADER_SIZE)
+		{
+			header.Length = skip - PACKET_RING_HEADER_SIZE;
+			header.Flags = PACKET_RING_FLAG_PAD;
+			header.Timestamp = 0;
+			memcpy(ring->Buffer + ring->Write, &header, sizeof(header));
+		}
+		ring->Used += skip;
+		ring->Write = 0;
+	}
+
+	header.Length = length;
+	header.Flags = ring->Overrun ? PACKET_RING_FLAG_OVERRUN : 0;
+	header.Timestamp = timestamp;
+
+	memcpy(ring->Buffer + ring->Write, &header, sizeof(header));
+	if (length)
+		memcpy(ring->Buffer + ring->Write + PACKET_RING_HEADER_SIZE, data, length);
+
+	ring->Write += recordSize;
+	if (ring->Write == ring->Size)
+		ring->Write = 0;
+
+	ring->Used += recordSize;
+	ring->Packets++;
+	ring->Stored++;
+	ring->Overrun = 0;
+	return 1;
+}
+
+// Gets the oldest record; skips a tail the writer left unused.
+static const PACKET_RING_HEADER* PacketRing_Oldest(PACKET_RING* ring)
+{
+	const PACKET_RING_HEADER* header;
+	unsigned int tail;
+
+	while (ring->Packets)
+	{
+		tail = ring->Size - ring->Read;
+		header = (const PACKET_RING_HEADER*)(ring->Buffer + ring->Read);
+
+		if (tail >= PACKET_RING_HEADER_SIZE && !(header->Flags & PACKET_RING_FLAG_PAD))
+			return header;
+
+		ring->Used -= tail;
+		ring->Read = 0;
+	}
+	return 0;
+}
+
+unsigned int PacketRing_PeekSize(
+    PACKET_RING* ring)
+{
+	const PACKET_RING_HEADER* header = PacketRing_Oldest(ring);
+
+	return header ? PACKET_RING_RECORD_SIZE(header->Length) : 0;
+}
+
+unsigned int PacketRing_Drain(
+    PACKET_RING* ring,
+    unsigned char* buffer,
+    unsigned int bufferLength,
+    unsigned int* packets)
+{
+	const PACKET_RING_HEADER* header;
+	unsigned int recordSize;
+	unsigned int written = 0;
+	unsigned int count = 0;
+
+	while ((header = PacketRing_Oldest(ring)) != 0)
+	{
+		recordSize = PACKET_RING_RECORD_SIZE(header->Length);
+		if (bufferLength - written < recordSize)
+			break;
+
+		memcpy(buffer + written, header, recordSize);
+		written += recordSize;
+		count++;
+
+		ring->Read += recordSize;
+		if (ring->Read == ring->Size)
+			ring->Read = 0;
+
+		ring->Used -= recordSize;
+		ring->Packets--;
+	}
+
+	if (!ring->Packets)
+	{
+		// Start over at the front; nothing is left to skip.
+		ring->Read = ring->Write = 0;
+		ring->Used = 0;
+	}
+
+	*packets = count;
+	return written;
+}
+
+void PacketReader_Init(
+    PACKET_READER* reader,
+    unsigned int slotCount)
+{
+	memset(reader, 0, sizeof(*reader));
+
+	if (slotCount < 1) slotCount = 1;
+	if (slotCount > PACKET_READER_MAX_SLOTS) slotCount = PACKET_READER_MAX_SLOTS;
+	reader->SlotCount = slotCount;
+}
+
+void PacketReader_Complete(
+    PACKET_READER* reader,
+    unsigned int slot,
+    int status,
+    unsigned int length,
+    long long timestamp)
+{
+	reader->Status[slot] = status;
+	reader->Length[slot] = length;
+	reader->Timestamp[slot] = timestamp;
+	reader->Done[slot] = 1;
+}
+
+int PacketReader_Next(
+    PACKET_READER* reader,
+    unsigned int* slot,
+    int* status,
+    unsigned int* length,
+    long long* timestamp)
+{
+	unsigned int next = reader->NextSlot;
+
+	if (!reader->Done[next])
+		return 0;
+
+	reader->Done[next] = 0;
+	*slot = next;
+	*status = reader->Status[next];
+	*length = reader->Length[next];
+	*timestamp = reader->Timestamp[next];
+
+	reader->NextSlot = (next + 1) % reader->SlotCount;
+	return 1;
+}
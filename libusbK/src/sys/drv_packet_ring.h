@@ -0,0 +1,147 @@
+/*! \file drv_packet_ring.h
+*/
+
+#ifndef __DRV_PACKET_RING_H__
+#define __DRV_PACKET_RING_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_packet_ring.c function prototypes.
+// Packet ring and read ordering for the continuous reader. (CONTINUOUS_READER)
+//
+// A continuous reader keeps SlotCount reads of one IN pipe sent at all
+// times. Each completed read becomes one packet record in a byte ring; user
+// mode drains whole records with LIBUSBK_IOCTL_READ_PACKETS. A record is a
+// PACKET_RING_HEADER (the KUSB_PACKET_HEADER layout) followed by the packet
+// data, padded to PACKET_RING_ALIGN bytes. Drained records are copied out in
+// exactly this framing.
+//
+// Reads complete in the order they were sent, but their completion routines
+// can run at the same time on different processors. PACKET_READER puts
+// them back in send order: slots are always sent round robin, so the next
+// packet to store is always the oldest slot.
+//
+// When the ring is full new packets are dropped; the next packet stored has
+// PACKET_RING_FLAG_OVERRUN set.
+//
+// Like drv_xfer_pipeline.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. It takes no locks; callers
+// serialize every call.
+//
+
+// Record alignment and header size. (KUSB_PACKET_HEADER)
+#define PACKET_RING_ALIGN			8
+#define PACKET_RING_HEADER_SIZE		16
+
+// Bytes a record of dataLength bytes takes up in the ring and in a drain buffer.
+#define PACKET_RING_RECORD_SIZE(dataLength) \
+	(PACKET_RING_HEADER_SIZE + (((dataLength) + (PACKET_RING_ALIGN - 1)) & ~(PACKET_RING_ALIGN - 1)))
+
+// Packets were dropped before this one. (KUSB_PACKET_FLAG_OVERRUN)
+#define PACKET_RING_FLAG_OVERRUN	0x00000001
+
+// Ring only; marks the unused tail before a wrapped record. Never drained.
+#define PACKET_RING_FLAG_PAD		0x80000000
+
+// Most reads a continuous reader keeps sent.
+#define PACKET_READER_MAX_SLOTS		16
+
+// Ring size the driver allocates for each continuous reader.
+#define PACKET_RING_SIZE			65536
+
+typedef struct _PACKET_RING_HEADER
+{
+	unsigned int Length;
+	unsigned int Flags;
+
+	// Completion time in performance counter ticks.
+	long long Timestamp;
+} PACKET_RING_HEADER;
+
+typedef struct _PACKET_RING
+{
+	unsigned char* Buffer;
+	unsigned int Size;
+
+	// Byte offsets of the oldest record and of the next record to store.
+	unsigned int Read;
+	unsigned int Write;
+
+	// Bytes in use, including the unused tail skipped when a record wraps.
+	unsigned int Used;
+	unsigned int Packets;
+
+	// Set when a packet was dropped; cleared by the next stored packet.
+	int Overrun;
+
+	// Statistics.
+	unsigned int Stored;
+	unsigned int Dropped;
+} PACKET_RING;
+
+typedef struct _PACKET_READER
+{
+	unsigned int SlotCount;
+
+	// Oldest sent slot; the next one to store.
+	unsigned int NextSlot;
+
+	unsigned char Done[PACKET_READER_MAX_SLOTS];
+	int Status[PACKET_READER_MAX_SLOTS];
+	unsigned int Length[PACKET_READER_MAX_SLOTS];
+	long long Timestamp[PACKET_READER_MAX_SLOTS];
+} PACKET_READER;
+
+// Assigns the ring buffer. size is rounded down to PACKET_RING_ALIGN.
+void PacketRing_Init(
+    PACKET_RING* ring,
+    unsigned char* buffer,
+    unsigned int size);
+
+// Discards every record and the overrun state.
+void PacketRing_Reset(
+    PACKET_RING* ring);
+
+// Stores a packet. Returns zero if the ring is full and the packet was dropped.
+int PacketRing_Put(
+    PACKET_RING* ring,
+    const unsigned char* data,
+    unsigned int length,
+    long long timestamp);
+
+// Moves as many whole records as fit into buffer, oldest first. Returns the
+// number of bytes written; packets receives the number of records.
+unsigned int PacketRing_Drain(
+    PACKET_RING* ring,
+    unsigned char* buffer,
+    unsigned int bufferLength,
+    unsigned int* packets);
+
+// Gets the drain buffer size the oldest record needs; 0 if the ring is empty.
+unsigned int PacketRing_PeekSize(
+    PACKET_RING* ring);
+
+// Starts a reader with slotCount slots (clamped to 1..PACKET_READER_MAX_SLOTS).
+// Every slot is sent in slot order after this call.
+void PacketReader_Init(
+    PACKET_READER* reader,
+    unsigned int slotCount);
+
+// Records the completion of a slot.
+void PacketReader_Complete(
+    PACKET_READER* reader,
+    unsigned int slot,
+    int status,
+    unsigned int length,
+    long long timestamp);
+
+// Takes the oldest slot if it has completed. Returns non-zero and fills in
+// slot, status, length and timestamp; the caller stores the packet and sends
+// the slot again, which makes it the newest.
+int PacketReader_Next(
+    PACKET_READER* reader,
+    unsigned int* slot,
+    int* status,
+    unsigned int* length,
+    long long* timestamp);
+
+#endif
@@ -165,7 +165,11 @@ NTSTATUS Pipe_Stop(__in PPIPE_CONTEXT pipeContext,
 		pipeContext->IsValid = FALSE; // mark context invalid.
 
 		if (pipeContext->Queue && purgeQueue)	// stop queue, cancel any outstanding requests
+		{
+			// the continuous reader keeps its own reads sent; retire them first.
+			Xfer_StopReader(GetQueueContext(pipeContext->Queue));
 			WdfIoQueuePurgeSynchronously(pipeContext->Queue);
+		}
 
 		if (pipeContext->Pipe && stopIoTarget)
 			PipeStop(pipeContext, WdfIoTargetSentIoAction); // stop pipe, cancel any outstanding requests
@@ -341,6 +345,9 @@ NTSTATUS Pipe_InitQueue(
 		// SET queueContext->PipeHandle
 		queueContext->PipeHandle = pipeContext->Pipe;
 
+		// SET queueContext->PipeContext
+		queueContext->PipeContext = pipeContext;
+
 		// SET queueContext->Info
 		RtlCopyMemory(&queueContext->Info, &pipeContext->PipeInformation, sizeof(queueContext->Info));
 
@@ -361,6 +368,42 @@ NTSTATUS Pipe_InitQueue(
 				WdfObjectDelete(queue);
 				goto Exit;
 			}
+
+			// SET queueContext->Pipeline
+			if (queueConfig.DispatchType == WdfIoQueueDispatchSequential && pipeContext->PipelineDepth > 1)
+			{
+				status = Xfer_InitPipeline(queue, queueContext, pipeContext->PipelineDepth);
+				if (!NT_SUCCESS(status))
+				{
+					USBERRN("Xfer_InitPipeline failed. status=%08Xh", status);
+					WdfObjectDelete(queue);
+					goto Exit;
+				}
+			}
+
+			// SET queueContext->Reader
+			if (USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress) && pipeContext->ReaderSlots)
+			{
+				status = Xfer_InitReader(queue, queueContext, pipeContext->ReaderSlots);
+				if (!NT_SUCCESS(status))
+				{
+					USBERRN("Xfer_InitReader failed. status=%08Xh", status);
+					WdfObjectDelete(queue);
+					goto Exit;
+				}
+			}
+		}
+
+		// SET queueContext->UrbPool
+		// The pool is an optimization; iso transfers allocate their own URBs without it.
+		if ((queueContext->Info.MaximumPacketSize) && queueContext->Info.PipeType == WdfUsbPipeTypeIsochronous)
+		{
+			status = Xfer_InitUrbPool(queue, queueContext);
+			if (!NT_SUCCESS(status))
+			{
+				USBWRNN("Xfer_InitUrbPool failed. status=%08Xh", status);
+				status = STATUS_SUCCESS;
+			}
 		}
 	}
 
@@ -563,25 +606,68 @@ NTSTATUS Pipe_InitDefaultContext(__in PDEVICE_CONTEXT deviceContext)
 }
 
 ULONG Pipe_CalcMaxTransferSize(
-    __in BOOLEAN IsHS,
-    __in WDF_USB_PIPE_TYPE pipeType,
-    __in ULONG maxPacketSize,
-    __in ULONG originalMaxTransferSize)
+    __in PDEVICE_CONTEXT deviceContext,
+    __in PPIPE_CONTEXT pipeContext,
+    __out_opt PULONG autoStageSize)
 {
-	ULONG maxTransferSize;
+	XFER_SPLIT_PARAMS splitParams;
 
-	switch (pipeType)
+	RtlZeroMemory(&splitParams, sizeof(splitParams));
+
+	switch (pipeContext->PipeInformation.PipeType)
 	{
 	case WdfUsbPipeTypeIsochronous:
-		maxTransferSize = IsHS ? (1024 * maxPacketSize) : (255 * maxPacketSize);
+		splitParams.PipeType = XFER_SPLIT_PIPE_ISOCHRONOUS;
 		break;
 	case WdfUsbPipeTypeBulk:
+		splitParams.PipeType = XFER_SPLIT_PIPE_BULK;
+		break;
 	case WdfUsbPipeTypeInterrupt:
-		maxTransferSize = maxPacketSize * 4096;
+		splitParams.PipeType = XFER_SPLIT_PIPE_INTERRUPT;
 		break;
 	default:
-		return originalMaxTransferSize;
+		splitParams.PipeType = XFER_SPLIT_PIPE_OTHER;
+		break;
 	}
 
-	return maxTransferSize > originalMaxTransferSize ? originalMaxTransferSize : maxTransferSize;
+	splitParams.HighSpeed				= IsHighSpeedDevice(deviceContext);
+	splitParams.UsbdiVersion			= deviceContext->UsbVersionInfo.USBDI_Version;
+	splitParams.MaxPacketSize			= pipeContext->PipeInformation.MaximumPacketSize;
+	splitParams.StackMaxTransferSize	= pipeContext->StackMaxTransferSize;
+	splitParams.StageSizePolicy			= pipeContext->StageSizePolicy;
+
+	if (autoStageSize)
+		*autoStageSize = XferPipeline_AutoStageSize(&splitParams);
+
+	return XferPipeline_CalcStageSize(&splitParams);
+}
+
+C_ASSERT(PIPE_STATS_LATENCY_BUCKETS == KPIPE_STATS_LATENCY_BUCKETS);
+
+VOID Pipe_GetStats(
+    __in PPIPE_CONTEXT pipeContext,
+    __out PKPIPE_STATS pipeStats)
+{
+	PPIPE_STATS_COUNTERS stats = &pipeContext->Stats;
+	ULONG bucket;
+
+	// Each counter is read atomically; the set as a whole is not a snapshot.
+	pipeStats->Requests		= (UINT)stats->Requests;
+	pipeStats->Errors		= (UINT)stats->Errors;
+	pipeStats->Timeouts		= (UINT)stats->Timeouts;
+	pipeStats->Stages		= (UINT)stats->Stages;
+	pipeStats->PartialReads	= (UINT)stats->PartialReads;
+	pipeStats->StallClears	= (UINT)stats->StallClears;
+	pipeStats->InFlight		= (UINT)stats->InFlight;
+	pipeStats->InFlightPeak	= (UINT)stats->InFlightPeak;
+	pipeStats->Bytes		= (ULONGLONG)InterlockedCompareExchange64(&stats->Bytes.QuadPart, 0, 0);
+	pipeStats->BounceBytes	= (ULONGLONG)InterlockedCompareExchange64(&stats->BounceBytes.QuadPart, 0, 0);
+
+	for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS; bucket++)
+		pipeStats->Latency[bucket] = (UINT)stats->Latency[bucket];
+
+	pipeStats->UrbPoolHits		= (UINT)stats->UrbPoolHits;
+	pipeStats->UrbPoolMisses	= (UINT)stats->UrbPoolMisses;
+	pipeStats->UrbPoolPeakInUse	= (UINT)stats->UrbPoolPeakInUse;
+	pipeStats->Reserved			= 0;
 }
@@ -49,8 +49,12 @@ NTSTATUS Pipe_RefreshQueue(
     __in PPIPE_CONTEXT pipeContext);
 
 ULONG Pipe_CalcMaxTransferSize(
-    __in BOOLEAN IsHS, WDF_USB_PIPE_TYPE pipeType,
-    __in ULONG maxPacketSize,
-    __in ULONG originalMaxTransferSize);
+    __in PDEVICE_CONTEXT deviceContext,
+    __in PPIPE_CONTEXT pipeContext,
+    __out_opt PULONG autoStageSize);
+
+VOID Pipe_GetStats(
+    __in PPIPE_CONTEXT pipeContext,
+    __out PKPIPE_STATS pipeStats);
 
 #endif
@@ -0,0 +1,49 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_pipe_stats.h"
+
+unsigned int PipeStats_LatencyBucket(
+    unsigned long long elapsedTicks,
+    unsigned long long ticksPerSecond)
+{
+	unsigned long long limit;
+	unsigned int bucket;
+
+	if (!ticksPerSecond)
+		return 0;
+
+	// Compare in ticks; converting elapsedTicks to microseconds could overflow.
+	for (bucket = 0; bucket < PIPE_STATS_LATENCY_BUCKETS - 1; bucket++)
+	{
+		limit = (ticksPerSecond * ((unsigned long long)PIPE_STATS_LATENCY_BASE_US << bucket)) / 1000000;
+		if (elapsedTicks < limit)
+			break;
+	}
+
+	return bucket;
+}
+
+unsigned int PipeStats_BucketLimitUs(
+    unsigned int bucket)
+{
+	if (bucket >= PIPE_STATS_LATENCY_BUCKETS - 1)
+		return 0;
+
+	return PIPE_STATS_LATENCY_BASE_US << bucket;
+}
@@ -0,0 +1,39 @@
+/*! \file drv_pipe_stats.h
+*/
+
+#ifndef __DRV_PIPE_STATS_H__
+#define __DRV_PIPE_STATS_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_pipe_stats.c function prototypes.
+// Per-pipe performance counter helpers.
+//
+// The driver keeps a set of counters for every pipe (see PIPE_CONTEXT) and
+// copies them to a KPIPE_STATS for LIBUSBK_IOCTL_GET_PIPE_STATS. Completion
+// latencies are counted in power-of-two buckets:
+//   bucket 0         : < PIPE_STATS_LATENCY_BASE_US
+//   bucket n         : < PIPE_STATS_LATENCY_BASE_US << n
+//   last bucket      : everything else
+//
+// Like drv_iso_packets.h, this module uses plain C types only and can be
+// built and exercised outside of the driver.
+//
+
+// Must match KPIPE_STATS_LATENCY_BUCKETS. (lusbk_shared.h)
+#define PIPE_STATS_LATENCY_BUCKETS	10
+
+// Upper bound, in microseconds, of the first latency bucket.
+#define PIPE_STATS_LATENCY_BASE_US	125
+
+// Gets the latency bucket for a request that took elapsedTicks of a clock
+// running at ticksPerSecond. (KeQueryPerformanceCounter in the driver)
+unsigned int PipeStats_LatencyBucket(
+    unsigned long long elapsedTicks,
+    unsigned long long ticksPerSecond);
+
+// Gets the upper bound, in microseconds, of a latency bucket; 0 for the
+// last (unbounded) bucket.
+unsigned int PipeStats_BucketLimitUs(
+    unsigned int bucket);
+
+#endif
@@ -118,8 +118,9 @@ NTSTATUS Policy_GetPipe(__in PDEVICE_CONTEXT deviceContext,
 	NTSTATUS status = STATUS_SUCCESS;
 	PIPE_POLICIES pipePolicies;
 
+	// The default pipe (0) has a queue but no WDFUSBPIPE.
 	pipeContext = GetPipeContextByID(deviceContext, pipeID);
-	if (!pipeContext->IsValid || !pipeContext->Pipe || !pipeContext->Queue)
+	if (!pipeContext->IsValid || (!pipeContext->Pipe && (pipeID & 0xF)) || !pipeContext->Queue)
 	{
 		status = STATUS_INVALID_PARAMETER;
 		USBERRN("Invalid PipeID=%02Xh", pipeID);
@@ -199,6 +200,42 @@ NTSTATUS Policy_GetPipe(__in PDEVICE_CONTEXT deviceContext,
 		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(ULONG), valueLength[0], valueLength, goto Done);
 		if (value) ((PULONG)value)[0] = pipeContext->SimulParallelRequests;
 		break;
+	case PIPELINE_DEPTH:			// 0x31
+		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(ULONG), valueLength[0], valueLength, goto Done);
+		if (value) ((PULONG)value)[0] = pipeContext->PipelineDepth;
+		break;
+	case MAXIMUM_STAGE_SIZE:		// 0x32
+		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(ULONG), valueLength[0], valueLength, goto Done);
+		if (value) ((PULONG)value)[0] = pipeContext->StageSizePolicy;
+		break;
+	case PIPE_SPLIT_INFO:			// 0x33
+		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(KPIPE_SPLIT_INFO), valueLength[0], valueLength, goto Done);
+		if (value)
+		{
+			PKPIPE_SPLIT_INFO splitInfo = (PKPIPE_SPLIT_INFO)value;
+			RtlZeroMemory(splitInfo, sizeof(*splitInfo));
+
+			splitInfo->StageSize			= Pipe_CalcMaxTransferSize(deviceContext, pipeContext, &splitInfo->AutoStageSize);
+			splitInfo->StageSizePolicy		= pipeContext->StageSizePolicy;
+			splitInfo->StackMaxTransferSize	= pipeContext->StackMaxTransferSize;
+			splitInfo->PipelineDepth		= pipeContext->PipelineDepth;
+			splitInfo->UsbdiVersion			= (USHORT)deviceContext->UsbVersionInfo.USBDI_Version;
+			splitInfo->DeviceSpeed			= (UCHAR)deviceContext->DeviceSpeed + 1;
+		}
+		break;
+	case CONTROL_RESPONSE_CACHE:	// 0x34
+		if (pipeID & 0xF)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(ULONG), valueLength[0], valueLength, goto Done);
+		if (value) ((PULONG)value)[0] = deviceContext->CtrlCache.Flags;
+		break;
+	case CONTINUOUS_READER:			// 0x35
+		mPipe_CheckValueLength(status, policyType, pipeID, sizeof(ULONG), valueLength[0], valueLength, goto Done);
+		if (value) ((PULONG)value)[0] = pipeContext->ReaderSlots;
+		break;
 	default:
 		status = STATUS_INVALID_PARAMETER;
 	}
@@ -405,23 +442,22 @@ Done:
 	return status;
 }
 
-/*
-NTSTATUS Policy_ApplyIsoAutoPacketTemplate(
+static NTSTATUS Policy_ApplyIsoAutoPacketTemplate(
     __inout PDEVICE_CONTEXT deviceContext,
     __in PPIPE_CONTEXT pipeContext,
     __in PVOID value,
     __in ULONG valueLength)
 {
-	BOOLEAN isHS;
-	SHORT minPackets;
-	SHORT maxPackets;
-	SHORT numPackets;
-	int lastOffset, iPacket;
+	ISO_PACKETS_RESULT result;
+	LONG numPackets;
+	INT errorIndex;
 	WDF_OBJECT_ATTRIBUTES memAttributes;
 	NTSTATUS status;
-	WDFMEMORY sharedMemory;
-	KISO_PACKET* isoPackets;
+	WDFMEMORY templateMemory;
+	WDFMEMORY oldTemplateMemory;
+	ISO_PACKET_TEMPLATE* packetTemplate;
 
+	C_ASSERT(sizeof(ISO_USER_PACKET) == sizeof(KISO_PACKET));
 
 	if (pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeIsochronous || !pipeContext->Queue)
 	{
@@ -432,87 +468,82 @@ NTSTATUS Policy_ApplyIsoAutoPacketTemplate(
 
 	if (valueLength == 0)
 	{
-		if (pipeContext->SharedAutoIsoExPacketMemory)
-		{
-			WdfObjectAcquireLock(pipeContext->Queue);
+		WdfObjectAcquireLock(pipeContext->Queue);
 
-			WdfObjectDelete(pipeContext->SharedAutoIsoExPacketMemory);
-			pipeContext->SharedAutoIsoExPacketMemory = NULL;
+		oldTemplateMemory = pipeContext->IsoPacketTemplate;
+		pipeContext->IsoPacketTemplate = NULL;
 
-			WdfObjectReleaseLock(pipeContext->Queue);
-		}
+		WdfObjectReleaseLock(pipeContext->Queue);
 
+		if (oldTemplateMemory) WdfObjectDelete(oldTemplateMemory);
+		USBMSGN("PipeID=%02Xh Removed iso packet template.", pipeContext->PipeInformation.EndpointAddress);
 		return STATUS_SUCCESS;
 	}
 
-	numPackets = (SHORT)((valueLength - sizeof(KISO_CONTEXT)) / sizeof(KISO_PACKET));
-	if ((valueLength - sizeof(KISO_CONTEXT)) % sizeof(KISO_PACKET))
+	if (valueLength <= sizeof(KISO_CONTEXT) || (valueLength - sizeof(KISO_CONTEXT)) % sizeof(KISO_PACKET))
 	{
-		USBERRN("PipeID=%02Xh BufferLength not an interval of %u sizeof(KISO_PACKET)",
+		USBERRN("PipeID=%02Xh ValueLength must be sizeof(KISO_CONTEXT) plus an interval of %u sizeof(KISO_PACKET)",
 		        pipeContext->PipeInformation.EndpointAddress, sizeof(KISO_PACKET));
 		return STATUS_INVALID_PARAMETER;
 	}
+	numPackets = (LONG)((valueLength - sizeof(KISO_CONTEXT)) / sizeof(KISO_PACKET));
 
-	isHS = IsHighSpeedDevice(deviceContext);
-	if (isHS)
-	{
-		minPackets = 8;
-		maxPackets = 1024;
-	}
-	else
-	{
-		minPackets = 1;
-		maxPackets = 255;
-	}
-
-	if (numPackets % minPackets || numPackets > maxPackets || numPackets < minPackets)
+	if (IsoPackets_CheckCount(numPackets, IsHighSpeedDevice(deviceContext), IsHighSpeedDevice(deviceContext) ? ISO_PACKETS_MAX_HS : ISO_PACKETS_MAX_FS) != ISO_PACKETS_SUCCESS)
 	{
-		USBERRN("PipeID=%02Xh NumberOfPackets must be an interval of %u and less than or equal to %u",
-		        pipeContext->PipeInformation.EndpointAddress, minPackets, maxPackets);
+		USBERRN("PipeID=%02Xh Invalid NumberOfPackets=%d. High speed templates must be an interval of 8; maximum is %u (high speed) or %u (full speed).",
+		        pipeContext->PipeInformation.EndpointAddress, numPackets, ISO_PACKETS_MAX_HS, ISO_PACKETS_MAX_FS);
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	lastOffset	= 0;
-	isoPackets	= (KISO_PACKET*) & (((PUCHAR)value)[sizeof(KISO_CONTEXT)]);
-	for (iPacket = 0; iPacket < (int)numPackets; iPacket++)
-	{
-		KISO_PACKET* nextIsoPacket = &isoPackets[iPacket];
-
-		if ((int)nextIsoPacket->Offset < lastOffset || (int)nextIsoPacket->Offset - lastOffset > (int)pipeContext->PipeInformation.MaximumPacketSize)
-		{
-			USBERRN("PipeID=%02Xh IsoPacket[%u] to long. Length=%u",
-			        pipeContext->PipeInformation.EndpointAddress, iPacket - 1, (int)nextIsoPacket->Offset - lastOffset);
-			return STATUS_INVALID_PARAMETER;
-		}
-	}
-
 	WDF_OBJECT_ATTRIBUTES_INIT(&memAttributes);
 	memAttributes.ParentObject = deviceContext->WdfDevice;
-	status = WdfMemoryCreate(&memAttributes, NonPagedPool, POOL_TAG, valueLength, &sharedMemory, NULL);
+	status = WdfMemoryCreate(&memAttributes, NonPagedPool, POOL_TAG, ISO_PACKET_TEMPLATE_SIZE(numPackets), &templateMemory, &packetTemplate);
 	if (!NT_SUCCESS(status))
 	{
 		USBERRN("WdfMemoryCreate failed. Status=%08Xh", status);
 		return status;
 	}
 
-	status = WdfMemoryCopyFromBuffer(sharedMemory, 0, value, valueLength);
-	if (!NT_SUCCESS(status))
+	result = IsoPackets_BuildTemplate(
+	             (const ISO_USER_PACKET*)((PKISO_CONTEXT)value)->IsoPackets,
+	             numPackets,
+	             IsHighSpeedDevice(deviceContext),
+	             pipeContext->PipeInformation.MaximumPacketSize,
+	             packetTemplate,
+	             &errorIndex);
+
+	switch(result)
 	{
-		USBERRN("WdfMemoryCopyFromBuffer failed. Status=%08Xh", status);
-		return status;
+	case ISO_PACKETS_SUCCESS:
+		break;
+	case ISO_PACKETS_INVALID_ORDER:
+		USBERRN("PipeID=%02Xh IsoPacket[%d].Offset is less than the previous offset.",
+		        pipeContext->PipeInformation.EndpointAddress, errorIndex);
+		break;
+	default:
+		USBERRN("PipeID=%02Xh IsoPacket[%d] too long. MaximumPacketSize=%u",
+		        pipeContext->PipeInformation.EndpointAddress, errorIndex - 1, pipeContext->PipeInformation.MaximumPacketSize);
+		break;
+	}
+	if (result != ISO_PACKETS_SUCCESS)
+	{
+		WdfObjectDelete(templateMemory);
+		return STATUS_INVALID_PARAMETER;
 	}
 
+	// Request callbacks hold the queue lock (WdfSynchronizationScopeQueue) while they use the template.
 	WdfObjectAcquireLock(pipeContext->Queue);
 
-	sharedMemory = InterlockedExchangePointer(&pipeContext->SharedAutoIsoExPacketMemory, sharedMemory);
-	if (sharedMemory) WdfObjectDelete(sharedMemory);
+	oldTemplateMemory = pipeContext->IsoPacketTemplate;
+	pipeContext->IsoPacketTemplate = templateMemory;
 
 	WdfObjectReleaseLock(pipeContext->Queue);
 
-	USBMSGN("PipeID=%02Xh Assigned %u iso packet descriptors.", pipeContext->PipeInformation.EndpointAddress, numPackets);
+	if (oldTemplateMemory) WdfObjectDelete(oldTemplateMemory);
+
+	USBMSGN("PipeID=%02Xh Assigned %d iso packet descriptors.", pipeContext->PipeInformation.EndpointAddress, numPackets);
 	return STATUS_SUCCESS;
 }
-*/
 
 NTSTATUS Policy_SetPipe(
     __inout PDEVICE_CONTEXT deviceContext,
@@ -640,12 +671,80 @@ NTSTATUS Policy_SetPipe(
 			pipeContext->IsQueueDirty = TRUE;
 		}
 		break;
-		/*
-		case ISO_AUTO_PACKET_TEMPLATE:	// 0x10
+	case ISO_AUTO_PACKET_TEMPLATE:	// 0x23
 		status = Policy_ApplyIsoAutoPacketTemplate(deviceContext, pipeContext, value, valueLength);
 		break;
-		*/
 
+	case PIPELINE_DEPTH:			// 0x31
+		if (pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeBulk &&
+		        pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeInterrupt)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		mPipe_CheckValueLength(status, policyType, pipeID, 4, valueLength, NULL, goto Done);
+		if (((PULONG)value)[0] > XFER_PIPELINE_MAX_DEPTH)
+		{
+			USBERRN("PipeID=%02Xh PIPELINE_DEPTH cannot be greater than %u.", pipeID, XFER_PIPELINE_MAX_DEPTH);
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		if (pipeContext->PipelineDepth != ((PULONG)value)[0])
+		{
+			pipeContext->PipelineDepth = ((PULONG)value)[0];
+			pipeContext->IsQueueDirty = TRUE;
+		}
+		break;
+
+	case MAXIMUM_STAGE_SIZE:		// 0x32
+		if (pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeBulk &&
+		        pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeInterrupt)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		mPipe_CheckValueLength(status, policyType, pipeID, 4, valueLength, NULL, goto Done);
+		if (pipeContext->StageSizePolicy != ((PULONG)value)[0])
+		{
+			// The queue copies the pipe information when it is created.
+			pipeContext->StageSizePolicy = ((PULONG)value)[0];
+			pipeContext->PipeInformation.MaximumTransferSize = Pipe_CalcMaxTransferSize(deviceContext, pipeContext, NULL);
+			pipeContext->IsQueueDirty = TRUE;
+		}
+		break;
+
+	case CONTROL_RESPONSE_CACHE:	// 0x34
+		if (pipeID & 0xF)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		mPipe_CheckValueLength(status, policyType, pipeID, 4, valueLength, NULL, goto Done);
+		status = XferCtrl_SetCachePolicy(deviceContext, ((PULONG)value)[0]);
+		break;
+
+	case CONTINUOUS_READER:			// 0x35
+		if ((pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeBulk &&
+		        pipeContext->PipeInformation.PipeType != WdfUsbPipeTypeInterrupt) ||
+		        !USB_ENDPOINT_DIRECTION_IN(pipeID))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		mPipe_CheckValueLength(status, policyType, pipeID, 4, valueLength, NULL, goto Done);
+		if (((PULONG)value)[0] > PACKET_READER_MAX_SLOTS)
+		{
+			USBERRN("PipeID=%02Xh CONTINUOUS_READER cannot be greater than %u.", pipeID, PACKET_READER_MAX_SLOTS);
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+		if (pipeContext->ReaderSlots != ((PULONG)value)[0])
+		{
+			// The reader belongs to the pipe queue; it starts or stops when the queue is refreshed.
+			pipeContext->ReaderSlots = ((PULONG)value)[0];
+			pipeContext->IsQueueDirty = TRUE;
+		}
+		break;
 
 	default:
 		status = STATUS_INVALID_PARAMETER;
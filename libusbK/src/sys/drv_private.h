@@ -24,11 +24,21 @@
 #include <wdfusb.h>
 #include <wchar.h>
 
+#include "drv_iso_packets.h"
+#include "drv_xfer_pipeline.h"
+#include "drv_xfer_batch.h"
+#include "drv_ctrl_cache.h"
+#include "drv_packet_ring.h"
+#include "drv_mem_pool.h"
+#include "drv_pipe_stats.h"
+#include "drv_trace_ring.h"
+
 /////////////////////////////////////////////////////////////////////
 // Global/shared includes
 #include "lusbk_version.h"
 #include "lusbk_debug.h"
 #include "lusbk_shared.h"
+#include "lusbk_cqueue.h"
 /////////////////////////////////////////////////////////////////////
 
 #define POOL_TAG (ULONG) 'KBSU'
@@ -190,6 +200,26 @@ typedef union _PIPE_POLICIES
 /////////////////////// START OF CONTEXT SECTION /////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
+// Per-pipe performance counters; updated with interlocked operations from any
+// IRQL and copied to a KPIPE_STATS by Pipe_GetStats.
+typedef struct _PIPE_STATS_COUNTERS
+{
+	volatile LONG		Requests;
+	volatile LONG		Errors;
+	volatile LONG		Timeouts;
+	volatile LONG		Stages;
+	volatile LONG		PartialReads;
+	volatile LONG		StallClears;
+	volatile LONG		InFlight;
+	volatile LONG		InFlightPeak;
+	LARGE_INTEGER		Bytes;			// ExInterlockedAddLargeStatistic
+	LARGE_INTEGER		BounceBytes;	// ExInterlockedAddLargeStatistic
+	volatile LONG		Latency[PIPE_STATS_LATENCY_BUCKETS];
+	volatile LONG		UrbPoolHits;		// Isochronous pipes only. (see Xfer_InitUrbPool)
+	volatile LONG		UrbPoolMisses;
+	volatile LONG		UrbPoolPeakInUse;
+} PIPE_STATS_COUNTERS, *PPIPE_STATS_COUNTERS;
+
 typedef struct _PIPE_CONTEXT
 {
 	volatile WDFQUEUE Queue;					// Pipe queue.
@@ -211,6 +241,25 @@ typedef struct _PIPE_CONTEXT
 	// time. Available in version 1.9 and later versions of KMDF.
 	ULONG SimulParallelRequests;
 
+	// ISO_AUTO_PACKET_TEMPLATE; an ISO_PACKET_TEMPLATE used by LIBUSBK_IOCTL_AUTOISOEX_READ/WRITE.
+	// Swapped under the pipe queue lock.
+	WDFMEMORY IsoPacketTemplate;
+
+	// PIPELINE_DEPTH; applied when the pipe queue is (re)created.
+	ULONG PipelineDepth;
+
+	// MAXIMUM_STAGE_SIZE; 0 = automatic. (see Pipe_CalcMaxTransferSize)
+	ULONG StageSizePolicy;
+
+	// MaximumTransferSize reported by the USB stack when the pipe was configured.
+	ULONG StackMaxTransferSize;
+
+	// CONTINUOUS_READER; applied when the pipe queue is (re)created.
+	ULONG ReaderSlots;
+
+	// Kept for the life of the device. (see Xfer_StatsBegin, LIBUSBK_IOCTL_GET_PIPE_STATS)
+	PIPE_STATS_COUNTERS Stats;
+
 } PIPE_CONTEXT, *PPIPE_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(PIPE_CONTEXT,
@@ -254,6 +303,14 @@ typedef struct _DEVICE_CONTEXT
 	DEVICE_REGSETTINGS				DeviceRegSettings; // Device regisitry settings (from inf Dev_AddReq)
 	BOOLEAN							IsIdleSettingsInitialized;
 	volatile long					OpenedFileHandleCount;
+
+	// CONTROL_RESPONSE_CACHE; the arena is allocated the first time the policy is set. (see drv_ctrl_cache.h)
+	CTRL_CACHE						CtrlCache;
+	WDFSPINLOCK						CtrlCacheLock;
+	WDFMEMORY						CtrlCacheArena;
+
+	// Pending LIBUSBK_IOCTL_REGISTER_CQUEUE requests. (manual queue)
+	WDFQUEUE						CQueueQueue;
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_CONTEXT,
@@ -269,11 +326,30 @@ typedef struct _FILE_CONTEXT
 	PDEVICE_CONTEXT		DeviceContext;
 	UCHAR				PipeID;
 	WDF_USB_PIPE_TYPE	PipeType;
+
+	// LIBUSBK_IOCTL_REGISTER_CQUEUE; Event is NULL while no queue is registered. (see drv_xfer_cqueue.c)
+	struct
+	{
+		WDFSPINLOCK		Lock;
+		PKEVENT			Event;		// [Lock]
+		KCQ_PRODUCER	Producer;	// [Lock]
+	} CQueue;
 } FILE_CONTEXT, *PFILE_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FILE_CONTEXT,
                                    GetFileContext)
 
+// Allocated on a LIBUSBK_IOCTL_REGISTER_CQUEUE request in the caller's context; owns the queue
+// buffer and event until the request completes.
+typedef struct _CQUEUE_REGISTRATION
+{
+	WDFMEMORY	BufferMemory;
+	PKEVENT		Event;
+} CQUEUE_REGISTRATION, *PCQUEUE_REGISTRATION;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(CQUEUE_REGISTRATION,
+                                   GetCQueueRegistration)
+
 typedef struct _QUEUE_CONTEXT
 {
 	WDFUSBPIPE					PipeHandle;	// Pipe handle.		[RO]
@@ -296,6 +372,9 @@ typedef struct _QUEUE_CONTEXT
 	WDFMEMORY			OverMem;
 	PUCHAR				OverBuf;
 
+	// Isochronous pipes only; NULL if the pool could not be created. (see Xfer_InitUrbPool)
+	WDFMEMORY			UrbPool;
+
 	struct
 	{
 		// UserMem represents the users transfer buffer.
@@ -314,6 +393,44 @@ typedef struct _QUEUE_CONTEXT
 		ULONG				Transferred;
 	} Xfer;
 
+	// Only used when PIPELINE_DEPTH > 1; Lock is NULL otherwise. (see drv_xfer_bulk.c)
+	struct
+	{
+		WDFSPINLOCK			Lock;
+		XFER_PIPELINE		State;							// [Lock]
+		WDFREQUEST			Stages[XFER_PIPELINE_MAX_DEPTH];
+		UCHAR				StageFlags[XFER_PIPELINE_MAX_DEPTH];	// [Lock]
+		LONG				Busy;							// [Lock]
+
+		WDFREQUEST			MainRequest;
+		struct _REQUEST_CONTEXT*	MainRequestContext;
+		PUCHAR				UserBuffer;
+		NTSTATUS			CompleteStatus;
+		volatile long		CompleteRefs;
+	} Pipeline;
+
+	// Only used when CONTINUOUS_READER > 0; Lock is NULL otherwise. (see drv_xfer_reader.c)
+	struct
+	{
+		WDFSPINLOCK			Lock;
+		PACKET_READER		State;							// [Lock]
+		PACKET_RING			Ring;							// [Lock]
+		WDFREQUEST			Slots[PACKET_READER_MAX_SLOTS];
+		WDFMEMORY			SlotMemory[PACKET_READER_MAX_SLOTS];
+		PUCHAR				SlotBuffer[PACKET_READER_MAX_SLOTS];
+		UCHAR				SlotSent[PACKET_READER_MAX_SLOTS];	// [Lock]
+
+		// LIBUSBK_IOCTL_READ_PACKETS requests waiting for packets. (manual queue)
+		WDFQUEUE			DrainQueue;
+
+		LONG				Busy;							// [Lock]
+		BOOLEAN				Running;						// [Lock]
+		BOOLEAN				Stopping;						// [Lock]
+		NTSTATUS			Error;							// [Lock] returned once the ring is empty.
+		ULONG				Outstanding;					// [Lock] slots not yet retired.
+		KEVENT				IdleEvent;						// Set when Outstanding is 0.
+	} Reader;
+
 } QUEUE_CONTEXT, *PQUEUE_CONTEXT;
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(QUEUE_CONTEXT, GetQueueContext)
 
@@ -355,6 +472,9 @@ typedef struct _REQUEST_CONTEXT
 	PIPE_POLICIES		Policies;
 	ULONG				Timeout;
 
+	// Performance counter time the request reached its pipe queue; 0 if it is not counted. (see Xfer_CompleteRequest)
+	LONGLONG			StatsStartTime;
+
 	union
 	{
 		struct
@@ -380,6 +500,16 @@ typedef struct _REQUEST_CONTEXT
 				PUCHAR			Buffer;
 			} FixedIsoPackets;
 		} AutoIsoEx;
+		struct
+		{
+			WDFMEMORY			EntriesMemory;
+		} Batch;
+		struct
+		{
+			// CTRL_CACHE_xxx class of a cacheable request; 0 if the response is not cached.
+			ULONG				CacheClass;
+			ULONG				CacheGeneration;
+		} Control;
 	};
 
 } REQUEST_CONTEXT, *PREQUEST_CONTEXT;
@@ -188,6 +188,18 @@ VOID DefaultQueue_OnIoControl(__in WDFQUEUE Queue,
 		                               libusbRequest->AutoIsoEx.PipeID, goto Error);
 		return;
 
+	case LIBUSBK_IOCTL_BATCH_READ:
+		mRequest_InitAndForwardToQueue(status, WdfRequestTypeRead,
+		                               WdfRequestTypeDeviceControl, IoControlCode, OutputBufferLength, Request, deviceContext, requestContext,
+		                               libusbRequest->Batch.PipeID, goto Error);
+		return;
+
+	case LIBUSBK_IOCTL_READ_PACKETS:
+		mRequest_InitAndForwardToQueue(status, WdfRequestTypeRead,
+		                               WdfRequestTypeDeviceControl, IoControlCode, OutputBufferLength, Request, deviceContext, requestContext,
+		                               ((UCHAR)libusbRequest->endpoint.endpoint), goto Error);
+		return;
+
 	case LIBUSB_IOCTL_ISOCHRONOUS_WRITE:
 	case LIBUSB_IOCTL_INTERRUPT_OR_BULK_WRITE:
 		mRequest_InitAndForwardToQueue(status, WdfRequestTypeWrite,
@@ -207,6 +219,12 @@ VOID DefaultQueue_OnIoControl(__in WDFQUEUE Queue,
 		                               libusbRequest->AutoIsoEx.PipeID, goto Error);
 		return;
 
+	case LIBUSBK_IOCTL_BATCH_WRITE:
+		mRequest_InitAndForwardToQueue(status, WdfRequestTypeWrite,
+		                               WdfRequestTypeDeviceControl, IoControlCode, OutputBufferLength, Request, deviceContext, requestContext,
+		                               libusbRequest->Batch.PipeID, goto Error);
+		return;
+
 	case LIBUSB_IOCTL_CONTROL_WRITE:
 		mRequest_InitAndForwardToQueue(status, WdfRequestTypeWrite,
 		                               WdfRequestTypeDeviceControl, IoControlCode, OutputBufferLength, Request, deviceContext, requestContext,
@@ -616,6 +634,33 @@ VOID DefaultQueue_OnIoControl(__in WDFQUEUE Queue,
 
 		break;
 
+	case LIBUSBK_IOCTL_GET_PIPE_STATS:
+		GET_OUT_BUFFER(sizeof(KPIPE_STATS), &outputBuffer, &outputBufferLen, "get_pipe_stats");
+
+		pipeContext = GetPipeContextByID(deviceContext, (UCHAR)libusbRequest->endpoint.endpoint);
+		if (!pipeContext || !pipeContext->IsValid)
+		{
+			USBERRN("Invalid pipe context. PipeID=%02Xh", libusbRequest->endpoint.endpoint);
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		Pipe_GetStats(pipeContext, (PKPIPE_STATS)outputBuffer);
+		length = sizeof(KPIPE_STATS);
+
+		break;
+
+	case LIBUSBK_IOCTL_REGISTER_CQUEUE:
+		Xfer_RegisterCQueue(deviceContext, Request);
+		return;
+
+	case LIBUSBK_IOCTL_GET_TRACE:
+		GET_OUT_BUFFER(sizeof(KTRACE_DUMP_HEADER), &outputBuffer, &outputBufferLen, "get_trace");
+
+		status = Trace_Dump((PUCHAR)outputBuffer, (ULONG)outputBufferLen, &length);
+
+		break;
+
 	default :
 
 		USBERR("unknown IoControlCode %Xh (function=%04Xh)\n", IoControlCode, FUNCTION_FROM_CTL_CODE(IoControlCode));
@@ -55,6 +55,15 @@ VOID PipeQueue_OnIoControl(__in WDFQUEUE Queue,
 	case LIBUSB_IOCTL_INTERRUPT_OR_BULK_WRITE:
 	case LIBUSB_IOCTL_INTERRUPT_OR_BULK_READ:
 
+		if (queueContext->Reader.Lock && IoControlCode == LIBUSB_IOCTL_INTERRUPT_OR_BULK_READ)
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			USBERRN("PipeID=%02Xh Use LIBUSBK_IOCTL_READ_PACKETS when CONTINUOUS_READER is set.", queueContext->Info.EndpointAddress);
+			goto Done;
+		}
+
+		Xfer_StatsBegin(queueContext, requestContext);
+
 		switch (queueContext->Info.PipeType)
 		{
 		case WdfUsbPipeTypeIsochronous:
@@ -95,6 +104,7 @@ VOID PipeQueue_OnIoControl(__in WDFQUEUE Queue,
 	case LIBUSBK_IOCTL_ISOEX_WRITE:
 		if (queueContext->Info.PipeType == WdfUsbPipeTypeIsochronous)
 		{
+			Xfer_StatsBegin(queueContext, requestContext);
 			XferIsoEx(Queue, Request);
 			return;
 		}
@@ -102,18 +112,46 @@ VOID PipeQueue_OnIoControl(__in WDFQUEUE Queue,
 		USBERRN("Invalid PipeType=%s\n", GetPipeTypeString(queueContext->Info.PipeType));
 		break;
 
-		/*
-		case LIBUSBK_IOCTL_AUTOISOEX_READ:
-		case LIBUSBK_IOCTL_AUTOISOEX_WRITE:
-			if (queueContext->Info.PipeType == WdfUsbPipeTypeIsochronous)
-			{
-				XferAutoIsoEx(Queue, Request);
-				return;
-			}
-			status = STATUS_INVALID_PARAMETER;
-			USBERRN("Invalid PipeType=%s\n", GetPipeTypeString(queueContext->Info.PipeType));
+	case LIBUSBK_IOCTL_AUTOISOEX_READ:
+	case LIBUSBK_IOCTL_AUTOISOEX_WRITE:
+		if (queueContext->Info.PipeType == WdfUsbPipeTypeIsochronous)
+		{
+			Xfer_StatsBegin(queueContext, requestContext);
+			XferAutoIsoEx(Queue, Request);
+			return;
+		}
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("Invalid PipeType=%s\n", GetPipeTypeString(queueContext->Info.PipeType));
+		break;
+
+	case LIBUSBK_IOCTL_BATCH_READ:
+	case LIBUSBK_IOCTL_BATCH_WRITE:
+		if (queueContext->Reader.Lock)
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			USBERRN("PipeID=%02Xh Use LIBUSBK_IOCTL_READ_PACKETS when CONTINUOUS_READER is set.", queueContext->Info.EndpointAddress);
 			break;
-		*/
+		}
+		if (queueContext->Info.PipeType == WdfUsbPipeTypeBulk || queueContext->Info.PipeType == WdfUsbPipeTypeInterrupt)
+		{
+			Xfer_StatsBegin(queueContext, requestContext);
+			Xfer_Batch(Queue, Request);
+			return;
+		}
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("Invalid PipeType=%s\n", GetPipeTypeString(queueContext->Info.PipeType));
+		break;
+
+	case LIBUSBK_IOCTL_READ_PACKETS:
+		if ((queueContext->Info.PipeType == WdfUsbPipeTypeBulk || queueContext->Info.PipeType == WdfUsbPipeTypeInterrupt) &&
+		        USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress))
+		{
+			Xfer_ReadPackets(Queue, Request);
+			return;
+		}
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("PipeID=%02Xh Not a bulk or interrupt IN pipe.", queueContext->Info.EndpointAddress);
+		break;
 
 	case LIBUSB_IOCTL_SET_FEATURE:
 	case LIBUSB_IOCTL_CLEAR_FEATURE:
@@ -137,7 +175,7 @@ VOID PipeQueue_OnIoControl(__in WDFQUEUE Queue,
 	}
 
 Done:
-	WdfRequestCompleteWithInformation(Request, status, length);
+	Xfer_CompleteRequest(Request, status, length);
 	return;
 
 }
@@ -172,6 +210,8 @@ VOID PipeQueue_OnRead(__in WDFQUEUE Queue,
 		goto Done;
 	}
 
+	Xfer_StatsBegin(queueContext, requestContext);
+
 	switch(queueContext->Info.PipeType)
 	{
 	case WdfUsbPipeTypeIsochronous:
@@ -190,6 +230,12 @@ VOID PipeQueue_OnRead(__in WDFQUEUE Queue,
 			USBERRN("Cannot read from an OUT pipe.");
 			goto Done;
 		}
+		if (queueContext->Reader.Lock)
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			USBERRN("PipeID=%02Xh Use LIBUSBK_IOCTL_READ_PACKETS when CONTINUOUS_READER is set.", queueContext->Info.EndpointAddress);
+			goto Done;
+		}
 		if(requestContext->Policies.RawIO)
 			Xfer_ReadBulkRaw(Queue, Request);
 		else
@@ -202,7 +248,7 @@ VOID PipeQueue_OnRead(__in WDFQUEUE Queue,
 	USBERRN("PipeID=%02Xh Invalid request", queueContext->Info.EndpointAddress);
 
 Done:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 
 }
 
@@ -237,6 +283,8 @@ VOID PipeQueue_OnWrite(__in WDFQUEUE Queue,
 		goto Done;
 	}
 
+	Xfer_StatsBegin(queueContext, requestContext);
+
 	switch(queueContext->Info.PipeType)
 	{
 	case WdfUsbPipeTypeIsochronous:
@@ -259,13 +307,15 @@ VOID PipeQueue_OnWrite(__in WDFQUEUE Queue,
 			Xfer_WriteBulkRaw(Queue, Request);
 		else
 			Xfer_WriteBulk(Queue, Request);
+
+		return;
 	}
 
 	status = STATUS_INVALID_DEVICE_REQUEST;
 	USBERRN("PipeID=%02Xh Invalid request", queueContext->Info.EndpointAddress);
 
 Done:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 
 }
 
@@ -299,11 +349,24 @@ VOID Queue_OnStop(
 		return;
 	}
 
-	// None of the libusbK transfer functions set EvtRequestCancel, hence this should never happen.
+	// Only pipelined bulk/interrupt transfers (PIPELINE_DEPTH) and batches set EvtRequestCancel.
+	// The main request is never sent; a purge cancels it and its stages through Xfer_PipelineCancel (Xfer_BatchCancel).
 	if (ActionFlags & WdfRequestStopRequestCancelable)
 	{
-		USBERRN("WdfRequestStopRequestCancelable! pipeID=%02Xh", queueContext->Info.EndpointAddress);
-		WdfVerifierDbgBreakPoint();
+		if (queueContext->Pipeline.MainRequest != Request &&
+		        requestContext->IoControlCode != LIBUSBK_IOCTL_BATCH_READ &&
+		        requestContext->IoControlCode != LIBUSBK_IOCTL_BATCH_WRITE)
+		{
+			USBERRN("WdfRequestStopRequestCancelable! pipeID=%02Xh", queueContext->Info.EndpointAddress);
+			WdfVerifierDbgBreakPoint();
+			return;
+		}
+		if (ActionFlags & WdfRequestStopActionSuspend)
+		{
+			USBDBGN("StopAcknowledge for ActionSuspend (pipelined). pipeID=%02Xh request=%p",
+			        queueContext->Info.EndpointAddress, Request);
+			WdfRequestStopAcknowledge(Request, FALSE);
+		}
 		return;
 	}
 
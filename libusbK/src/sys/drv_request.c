@@ -295,6 +295,27 @@ VOID Request_PreIoInitialize(__in WDFDEVICE Device,
 			goto Done;
 		}
 		break;
+	case LIBUSBK_IOCTL_BATCH_READ:
+	case LIBUSBK_IOCTL_BATCH_WRITE:
+		// Lock the transfer descriptors for write. Each transfer's results are written to them upon completion.
+		if (!libusbRequest->Batch.EntryCount || libusbRequest->Batch.EntryCount > KUSB_BATCH_MAX_ENTRIES)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			USBERR("Invalid batch EntryCount=%u\n", libusbRequest->Batch.EntryCount);
+			goto Done;
+		}
+		status = WdfRequestProbeAndLockUserBufferForWrite(Request, libusbRequest->Batch.Entries, libusbRequest->Batch.EntryCount * sizeof(KUSB_BATCH_ENTRY), &requestContext->Batch.EntriesMemory);
+		if(!NT_SUCCESS(status))
+		{
+			USBERR("WdfRequestProbeAndLockUserBufferForWrite failed. status=%08Xh\n", status);
+			goto Done;
+		}
+		break;
+	case LIBUSBK_IOCTL_REGISTER_CQUEUE:
+		// Lock the completion queue and reference its event; this must be done in the context of the registering process.
+		status = Xfer_PrepareCQueue(Request, libusbRequest);
+		if(!NT_SUCCESS(status)) goto Done;
+		break;
 	}
 
 Done:
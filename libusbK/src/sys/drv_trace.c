@@ -0,0 +1,127 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_common.h"
+
+// Trace rings; RingCount is set last and stays 0 if Trace_Init fails.
+typedef struct _KTRACE_CONTEXT
+{
+	KTRACE_RING Rings[KTRACE_RING_COUNT];
+	volatile ULONG RingCount;
+	LONGLONG Frequency;
+} KTRACE_CONTEXT;
+
+static KTRACE_CONTEXT Trace;
+
+C_ASSERT(sizeof(KTRACE_RECORD) == 32);
+C_ASSERT(KTRACE_ID_COUNT <= 0x10000);
+
+NTSTATUS Trace_Init(__in WDFDRIVER Driver)
+{
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY memory;
+	KTRACE_RECORD* records = NULL;
+	LARGE_INTEGER frequency;
+	ULONG ring;
+	NTSTATUS status;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Driver;
+
+	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG,
+	                         sizeof(KTRACE_RECORD) * KTRACE_RING_RECORDS * KTRACE_RING_COUNT,
+	                         &memory, (PVOID*)&records);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfMemoryCreate failed. status=%08Xh", status);
+		return status;
+	}
+
+	for (ring = 0; ring < KTRACE_RING_COUNT; ring++)
+		TraceRing_Init(&Trace.Rings[ring], &records[ring * KTRACE_RING_RECORDS], KTRACE_RING_RECORDS);
+
+	KeQueryPerformanceCounter(&frequency);
+	Trace.Frequency = frequency.QuadPart;
+
+	KeMemoryBarrier();
+	Trace.RingCount = KTRACE_RING_COUNT;
+
+	return STATUS_SUCCESS;
+}
+
+VOID Trace_Event(
+    __in USHORT eventId,
+    __in ULONG arg0,
+    __in ULONG arg1,
+    __in ULONG arg2,
+    __in ULONG arg3)
+{
+	ULONG cpu;
+
+	if (!Trace.RingCount) return;
+
+	cpu = KeGetCurrentProcessorNumber();
+
+	TraceRing_Write(&Trace.Rings[cpu & (KTRACE_RING_COUNT - 1)],
+	                (UCHAR)cpu,
+	                eventId,
+	                KeQueryPerformanceCounter(NULL).QuadPart,
+	                arg0, arg1, arg2, arg3);
+}
+
+NTSTATUS Trace_Dump(
+    __out_bcount(bufferLength) PUCHAR buffer,
+    __in ULONG bufferLength,
+    __out PULONG length)
+{
+	KTRACE_DUMP_HEADER* header = (KTRACE_DUMP_HEADER*)buffer;
+	KTRACE_RECORD* records = (KTRACE_RECORD*)&header[1];
+	ULONG maxRecords;
+	ULONG ring;
+	ULONG copied;
+
+	*length = 0;
+
+	if (!Trace.RingCount)
+	{
+		USBWRNN("tracing is not available.");
+		return STATUS_NOT_SUPPORTED;
+	}
+	if (bufferLength < sizeof(*header))
+		return STATUS_BUFFER_TOO_SMALL;
+
+	RtlZeroMemory(header, sizeof(*header));
+	header->Magic		= KTRACE_DUMP_MAGIC;
+	header->Version		= KTRACE_DUMP_VERSION;
+	header->RecordSize	= sizeof(KTRACE_RECORD);
+	header->Frequency	= Trace.Frequency;
+
+	// Each ring gets an equal share of the buffer. Records that do not fit are
+	// counted as lost; the newest of each ring are kept.
+	maxRecords = (bufferLength - sizeof(*header)) / sizeof(KTRACE_RECORD);
+	maxRecords /= Trace.RingCount;
+
+	for (ring = 0; ring < Trace.RingCount; ring++)
+	{
+		copied = TraceRing_Snapshot(&Trace.Rings[ring], &records[header->RecordCount], maxRecords, &header->Lost);
+		header->RecordCount += copied;
+	}
+
+	*length = sizeof(*header) + (header->RecordCount * sizeof(KTRACE_RECORD));
+	return STATUS_SUCCESS;
+}
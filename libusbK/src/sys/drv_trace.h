@@ -0,0 +1,90 @@
+/*! \file drv_trace.h
+*/
+
+#ifndef __DRV_TRACE_H__
+#define __DRV_TRACE_H__
+
+#include "drv_private.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_trace.c function prototypes.
+// Binary event tracing.
+//
+// KTRACE_xxx(Name, args..) writes a KTRACE_ID_Name event with up to four
+// integer arguments to the per-processor trace rings (see drv_trace_ring.h).
+// Events above KTRACE_LEVEL are compiled out entirely; the rest cost a
+// timestamp and a 32 byte record, no formatting. The rings are read with
+// LIBUSBK_IOCTL_GET_TRACE ("kBench trace=<file>") and formatted by kTrace.
+//
+// Use these instead of USBMSG/USBDBG in per-transfer paths; the USBxxx
+// macros remain for setup, errors and anything that needs strings.
+//
+
+// 0 = errors, 1 = warnings, 2 = messages, 3 = debug, -1 = no tracing.
+#ifndef KTRACE_LEVEL
+#if DBG
+#define KTRACE_LEVEL 3
+#else
+#define KTRACE_LEVEL 2
+#endif
+#endif
+
+// Number of rings; processors beyond this share a ring. (power of two)
+#define KTRACE_RING_COUNT		8
+
+// Records per ring. (power of two)
+#define KTRACE_RING_RECORDS		512
+
+typedef enum _KTRACE_ID
+{
+#define KTRACE_EVENT(Name, Format) KTRACE_ID_##Name,
+#include "drv_trace_events.h"
+#undef KTRACE_EVENT
+
+	KTRACE_ID_COUNT
+} KTRACE_ID;
+
+NTSTATUS Trace_Init(__in WDFDRIVER Driver);
+
+VOID Trace_Event(
+    __in USHORT eventId,
+    __in ULONG arg0,
+    __in ULONG arg1,
+    __in ULONG arg2,
+    __in ULONG arg3);
+
+NTSTATUS Trace_Dump(
+    __out_bcount(bufferLength) PUCHAR buffer,
+    __in ULONG bufferLength,
+    __out PULONG length);
+
+// Pads the argument list to four. KTRACE_EXPAND makes the MSVC preprocessor
+// split __VA_ARGS__ before it is passed on.
+#define KTRACE_EXPAND(mX) mX
+#define KTRACE_ARGS4(mA0, mA1, mA2, mA3, ...) (ULONG)(mA0), (ULONG)(mA1), (ULONG)(mA2), (ULONG)(mA3)
+
+#if KTRACE_LEVEL >= 0
+#define KTRACE_ERR(mName, ...) Trace_Event(KTRACE_ID_##mName, KTRACE_EXPAND(KTRACE_ARGS4(__VA_ARGS__, 0, 0, 0, 0)))
+#else
+#define KTRACE_ERR(mName, ...) NOP_FUNCTION
+#endif
+
+#if KTRACE_LEVEL >= 1
+#define KTRACE_WRN(mName, ...) Trace_Event(KTRACE_ID_##mName, KTRACE_EXPAND(KTRACE_ARGS4(__VA_ARGS__, 0, 0, 0, 0)))
+#else
+#define KTRACE_WRN(mName, ...) NOP_FUNCTION
+#endif
+
+#if KTRACE_LEVEL >= 2
+#define KTRACE_MSG(mName, ...) Trace_Event(KTRACE_ID_##mName, KTRACE_EXPAND(KTRACE_ARGS4(__VA_ARGS__, 0, 0, 0, 0)))
+#else
+#define KTRACE_MSG(mName, ...) NOP_FUNCTION
+#endif
+
+#if KTRACE_LEVEL >= 3
+#define KTRACE_DBG(mName, ...) Trace_Event(KTRACE_ID_##mName, KTRACE_EXPAND(KTRACE_ARGS4(__VA_ARGS__, 0, 0, 0, 0)))
+#else
+#define KTRACE_DBG(mName, ...) NOP_FUNCTION
+#endif
+
+#endif
@@ -0,0 +1,38 @@
+/*! \file drv_trace_events.h
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+// Trace event table.
+//
+// Each KTRACE_EVENT(Name, Format) becomes the event id KTRACE_ID_Name in the
+// driver (see drv_trace.h). Format is only compiled into the kTrace decoder;
+// it may use up to KTRACE_MAX_ARGS 32-bit integer conversions. (%u %d %X ..)
+//
+// Event ids are the position in this list and are stored in trace dumps.
+// Append new events to the end; never reorder or remove one.
+//
+// This file has no include guard; it is included once per table.
+//
+
+KTRACE_EVENT(XFER_STAGE,			"PipeID=%02Xh Staging=%u")
+KTRACE_EVENT(XFER_PARTIAL_COPY,		"PipeID=%02Xh Transferred %u bytes from a previous partial read.")
+KTRACE_EVENT(XFER_PARTIAL_DONE,		"PipeID=%02Xh DoneReason: Transferred==Requested. Transferred=%u")
+KTRACE_EVENT(XFER_DONE_LENGTH,		"PipeID=%02Xh DoneReason: Transferred==Requested. Staged=%u Total=%u Requested=%u")
+KTRACE_EVENT(XFER_DONE_SHORT,		"PipeID=%02Xh DoneReason: IgnoreShortPackets=FALSE. Staged=%u Total=%u Requested=%u")
+KTRACE_EVENT(XFER_ZLP_RECEIVED,		"PipeID=%02Xh ZLP received.")
+KTRACE_EVENT(XFER_ZLP_SEND,			"PipeID=%02Xh Terminating with ZLP %u of %u..")
+KTRACE_EVENT(XFER_RAW_SUBMIT,		"PipeID=%02Xh Length=%u")
+KTRACE_EVENT(XFER_RAW_DONE,			"PipeID=%02Xh Done. Total=%u Requested=%u")
+KTRACE_EVENT(PIPELINE_START,		"PipeID=%02Xh Pipelining. Length=%u Depth=%u")
+KTRACE_EVENT(PIPELINE_STAGE,		"PipeID=%02Xh Stage=%u Offset=%u Staging=%u")
+KTRACE_EVENT(PIPELINE_DONE,			"PipeID=%02Xh DoneReason: Pipeline finished. Total=%u Requested=%u Status=%08Xh")
+KTRACE_EVENT(ISO_DONE,				"Transferred=%u StartFrame=%08Xh Errors=%d Status=%08Xh")
+KTRACE_EVENT(AUTO_CLEAR_STALL,		"PipeID=%02Xh AutoClearStall engaged.")
+KTRACE_EVENT(BATCH_START,			"PipeID=%02Xh Batch. Entries=%u Length=%u Slots=%u")
+KTRACE_EVENT(BATCH_ENTRY,			"PipeID=%02Xh Entry=%u Offset=%u Length=%u")
+KTRACE_EVENT(BATCH_DONE,			"PipeID=%02Xh DoneReason: Batch finished. Entries=%u Total=%u Status=%08Xh")
+KTRACE_EVENT(CTRL_CACHE_HIT,		"bmRequestType=%02Xh bRequest=%u wValue=%04Xh Transferred=%u (cached)")
+KTRACE_EVENT(READER_START,			"PipeID=%02Xh Continuous reader started. Slots=%u SlotLength=%u")
+KTRACE_EVENT(READER_STOP,			"PipeID=%02Xh Continuous reader stopped. Stored=%u Dropped=%u Status=%08Xh")
+KTRACE_EVENT(CQUEUE_START,			"Completion queue registered. Records=%u")
+KTRACE_EVENT(CQUEUE_STOP,			"Completion queue unregistered. Records=%u Posted=%u")
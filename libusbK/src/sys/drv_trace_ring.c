@@ -0,0 +1,119 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_trace_ring.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedIncrement, _ReadWriteBarrier)
+
+#define TraceRing_Reserve(mRing)	((unsigned int)_InterlockedIncrement(&(mRing)->WriteIndex) - 1)
+#define TraceRing_Barrier()			_ReadWriteBarrier()
+#else
+#define TraceRing_Reserve(mRing)	((unsigned int)__sync_add_and_fetch(&(mRing)->WriteIndex, 1) - 1)
+#define TraceRing_Barrier()			__sync_synchronize()
+#endif
+
+void TraceRing_Init(
+    KTRACE_RING* ring,
+    KTRACE_RECORD* records,
+    unsigned int recordCount)
+{
+	unsigned int pos;
+
+	for (pos = 0; pos < recordCount; pos++)
+		records[pos].Sequence = 0;
+
+	ring->Records		= records;
+	ring->Mask			= recordCount - 1;
+	ring->WriteIndex	= 0;
+}
+
+void TraceRing_Write(
+    KTRACE_RING* ring,
+    unsigned char cpu,
+    unsigned short eventId,
+    long long timestamp,
+    unsigned int arg0,
+    unsigned int arg1,
+    unsigned int arg2,
+    unsigned int arg3)
+{
+	unsigned int index = TraceRing_Reserve(ring);
+	KTRACE_RECORD* record = &ring->Records[index & ring->Mask];
+
+	record->Sequence = 0;
+	TraceRing_Barrier();
+
+	record->EventId		= eventId;
+	record->Cpu			= cpu;
+	record->Reserved	= 0;
+	record->Timestamp	= timestamp;
+	record->Args[0]		= arg0;
+	record->Args[1]		= arg1;
+	record->Args[2]		= arg2;
+	record->Args[3]		= arg3;
+
+	// Publish; the sequence is never 0 for a complete record. (wraps after 4G events)
+	TraceRing_Barrier();
+	*(volatile unsigned int*)&record->Sequence = index + 1;
+}
+
+unsigned int TraceRing_Snapshot(
+    const KTRACE_RING* ring,
+    KTRACE_RECORD* dst,
+    unsigned int maxRecords,
+    unsigned int* lost)
+{
+	unsigned int writeIndex = (unsigned int)ring->WriteIndex;
+	unsigned int recordCount = ring->Mask + 1;
+	unsigned int first = 0;
+	unsigned int index;
+	unsigned int copied = 0;
+	const KTRACE_RECORD* record;
+
+	if (writeIndex > recordCount)
+		first = writeIndex - recordCount;
+	if (writeIndex - first > maxRecords)
+		first = writeIndex - maxRecords;
+
+	*lost += first;
+
+	for (index = first; index != writeIndex; index++)
+	{
+		record = &ring->Records[index & ring->Mask];
+		if (*(volatile const unsigned int*)&record->Sequence != index + 1)
+		{
+			// Still being written, or already reused by a newer event.
+			(*lost)++;
+			continue;
+		}
+
+		dst[copied] = *record;
+
+		TraceRing_Barrier();
+		if (*(volatile const unsigned int*)&record->Sequence != index + 1)
+		{
+			(*lost)++;
+			continue;
+		}
+		copied++;
+	}
+
+	return copied;
+}
@@ -0,0 +1,103 @@
+/*! \file drv_trace_ring.h
+*/
+
+#ifndef __DRV_TRACE_RING_H__
+#define __DRV_TRACE_RING_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_trace_ring.c function prototypes.
+// Binary event trace ring.
+//
+// Trace events are fixed-size records (event id, timestamp and up to
+// KTRACE_MAX_ARGS integer arguments) written into a ring per processor.
+// When there are more processors than rings, processors share a ring.
+// Nothing is formatted when an event is written; format strings live in
+// drv_trace_events.h and are only used by the kTrace decoder.
+//
+// A writer reserves a slot with a single interlocked increment, so events
+// can be written from any IRQL, including from code that interrupts another
+// writer on the same processor. A record's Sequence is stored last; readers
+// (TraceRing_Snapshot) skip records that are being written or have been
+// overwritten while they were copied.
+//
+// Like drv_iso_packets.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. The record and dump layouts
+// are the kTrace file format.
+//
+
+#define KTRACE_MAX_ARGS			4
+
+// "KTRC"
+#define KTRACE_DUMP_MAGIC		0x4352544B
+#define KTRACE_DUMP_VERSION		1
+
+typedef struct _KTRACE_RECORD
+{
+	// Write index + 1; 0 while the record is being written.
+	unsigned int Sequence;
+
+	// KTRACE_ID_xxx (see drv_trace_events.h)
+	unsigned short EventId;
+
+	// Processor the event was written on. (low 8 bits)
+	unsigned char Cpu;
+	unsigned char Reserved;
+
+	// Timestamp in KTRACE_DUMP_HEADER.Frequency ticks per second.
+	long long Timestamp;
+
+	unsigned int Args[KTRACE_MAX_ARGS];
+} KTRACE_RECORD;
+
+typedef struct _KTRACE_RING
+{
+	// Configuration. (see TraceRing_Init)
+	KTRACE_RECORD* Records;
+	unsigned int Mask;
+
+	// Total number of records ever reserved.
+	volatile long WriteIndex;
+} KTRACE_RING;
+
+// A trace dump (LIBUSBK_IOCTL_GET_TRACE output and kTrace file) is this
+// header followed by RecordCount records, grouped by processor.
+typedef struct _KTRACE_DUMP_HEADER
+{
+	unsigned int Magic;
+	unsigned short Version;
+	unsigned short RecordSize;
+	unsigned int RecordCount;
+
+	// Records overwritten before the dump was taken.
+	unsigned int Lost;
+
+	// Timestamp ticks per second.
+	long long Frequency;
+} KTRACE_DUMP_HEADER;
+
+// Sets up a ring over recordCount records; recordCount must be a power of two.
+void TraceRing_Init(
+    KTRACE_RING* ring,
+    KTRACE_RECORD* records,
+    unsigned int recordCount);
+
+void TraceRing_Write(
+    KTRACE_RING* ring,
+    unsigned char cpu,
+    unsigned short eventId,
+    long long timestamp,
+    unsigned int arg0,
+    unsigned int arg1,
+    unsigned int arg2,
+    unsigned int arg3);
+
+// Copies the complete records still in the ring, oldest first, to dst and
+// returns the number copied. At most maxRecords (the newest) are copied; the
+// records that were overwritten or did not fit are added to *lost.
+unsigned int TraceRing_Snapshot(
+    const KTRACE_RING* ring,
+    KTRACE_RECORD* dst,
+    unsigned int maxRecords,
+    unsigned int* lost);
+
+#endif
@@ -18,6 +18,8 @@
 			}   																																	\
 			else																																	\
 			{   																																	\
+				if (mQueueContext->ResetPipeForStall && mQueueContext->PipeContext)																	\
+					InterlockedIncrement(&mQueueContext->PipeContext->Stats.StallClears);															\
 				mQueueContext->IsFreshPipeReset=TRUE;																								\
 				mQueueContext->ResetPipeForResume = FALSE;  																						\
 				mQueueContext->ResetPipeForStall = FALSE;   																						\
@@ -31,7 +33,7 @@
 		{ 																															\
 			if ((mRequestContext->Policies.AutoClearStall) && (mStatus != STATUS_DEVICE_NOT_CONNECTED && mStatus != STATUS_CANCELLED))	\
 			{ 																														\
-				USBMSGN("PipeID=%02Xh AutoClearStall engaged.", mQueueContext->Info.EndpointAddress); 								\
+				KTRACE_MSG(AUTO_CLEAR_STALL, mQueueContext->Info.EndpointAddress); 								\
 				mQueueContext->ResetPipeForStall = TRUE;  																			\
 			} 																														\
 		} 																															\
@@ -72,12 +74,32 @@ VOID Xfer_WriteBulk (
     __in WDFQUEUE Queue,
     __in WDFREQUEST Request);
 
+NTSTATUS Xfer_InitPipeline(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG depth);
+
+NTSTATUS Xfer_InitUrbPool(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext);
+
 VOID XferCtrl (
     __in WDFQUEUE Queue,
     __in WDFREQUEST Request,
     __in size_t InputBufferLength,
     __in size_t OutputBufferLength);
 
+NTSTATUS XferCtrl_InitCache(
+    __in PDEVICE_CONTEXT deviceContext);
+
+NTSTATUS XferCtrl_SetCachePolicy(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in ULONG flags);
+
+VOID XferCtrl_InvalidateCache(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in ULONG classes);
+
 VOID XferIsoRead(
     __in WDFQUEUE Queue,
     __in WDFREQUEST Request);
@@ -90,6 +112,117 @@ VOID XferIsoEx(
     __in WDFQUEUE Queue,
     __in WDFREQUEST Request);
 
+VOID XferAutoIsoEx(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request);
+
+VOID Xfer_Batch(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request);
+
+NTSTATUS Xfer_InitReader(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG slotCount);
+
+VOID Xfer_StopReader(
+    __in PQUEUE_CONTEXT queueContext);
+
+VOID Xfer_ReadPackets(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request);
+
+NTSTATUS Xfer_InitCQueue(
+    __in PDEVICE_CONTEXT deviceContext);
+
+NTSTATUS Xfer_PrepareCQueue(
+    __in WDFREQUEST Request,
+    __in libusb_request* libusbRequest);
+
+VOID Xfer_RegisterCQueue(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request);
+
+VOID Xfer_UnregisterCQueue(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFFILEOBJECT FileObject);
+
+VOID Xfer_PostCQueue(
+    __in PFILE_CONTEXT fileContext,
+    __in WDFREQUEST Request,
+    __in NTSTATUS status,
+    __in ULONG_PTR transferred);
+
+// Starts counting a read or write that reached its pipe queue. (PIPE_STATS_COUNTERS)
+FORCEINLINE VOID Xfer_StatsBegin(__in PQUEUE_CONTEXT queueContext,
+                                 __in PREQUEST_CONTEXT requestContext)
+{
+	PPIPE_STATS_COUNTERS stats;
+	LONG inFlight, peak;
+
+	if (!queueContext->PipeContext || requestContext->StatsStartTime)
+		return;
+
+	stats = &queueContext->PipeContext->Stats;
+	requestContext->QueueContext = queueContext;
+	requestContext->StatsStartTime = KeQueryPerformanceCounter(NULL).QuadPart;
+
+	inFlight = InterlockedIncrement(&stats->InFlight);
+	do
+	{
+		peak = stats->InFlightPeak;
+		if (inFlight <= peak) break;
+	}
+	while (InterlockedCompareExchange(&stats->InFlightPeak, inFlight, peak) != peak);
+}
+
+// Completes a read or write request; counted requests update the pipe counters first and
+// the completion is posted to the handle's completion queue when one is registered.
+FORCEINLINE VOID Xfer_CompleteRequest(__in WDFREQUEST Request,
+                                      __in NTSTATUS status,
+                                      __in ULONG_PTR transferred)
+{
+	PREQUEST_CONTEXT requestContext = GetRequestContext(Request);
+	WDFFILEOBJECT fileObject;
+	PFILE_CONTEXT fileContext;
+	PPIPE_STATS_COUNTERS stats;
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+
+	if (requestContext && requestContext->StatsStartTime)
+	{
+		now = KeQueryPerformanceCounter(&frequency);
+		stats = &requestContext->QueueContext->PipeContext->Stats;
+
+		InterlockedIncrement(&stats->Requests);
+		if (transferred)
+			ExInterlockedAddLargeStatistic(&stats->Bytes, (ULONG)transferred);
+		if (!NT_SUCCESS(status))
+		{
+			InterlockedIncrement(&stats->Errors);
+			if (status == STATUS_IO_TIMEOUT || status == STATUS_TIMEOUT)
+				InterlockedIncrement(&stats->Timeouts);
+		}
+		InterlockedIncrement(&stats->Latency[PipeStats_LatencyBucket(
+		                                         (unsigned long long)(now.QuadPart - requestContext->StatsStartTime),
+		                                         (unsigned long long)frequency.QuadPart)]);
+		InterlockedDecrement(&stats->InFlight);
+
+		requestContext->StatsStartTime = 0;
+	}
+
+	// Posted before the request completes; the file object can not be closed until it has.
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject)
+	{
+		fileContext = GetFileContext(fileObject);
+		if (fileContext && fileContext->CQueue.Event)
+			Xfer_PostCQueue(fileContext, Request, status, transferred);
+	}
+
+	WdfRequestCompleteWithInformation(Request, status, transferred);
+}
+
 FORCEINLINE NTSTATUS SetRequestTimeout(__in PREQUEST_CONTEXT requestContext,
                                        __in WDFREQUEST wdfRequest,
                                        __inout PWDF_REQUEST_SEND_OPTIONS wdfSendOptions)
@@ -123,6 +256,10 @@ FORCEINLINE NTSTATUS SubmitAsyncQueueRequest(
 		status = WdfRequestGetStatus(wdfRequest);
 		USBERR("WdfRequestSend failed. pipeID=%02Xh status=%Xh\n", queueContext->Info.EndpointAddress, status);
 	}
+	else if (queueContext->PipeContext)
+	{
+		InterlockedIncrement(&queueContext->PipeContext->Stats.Stages);
+	}
 	return status;
 }
 
@@ -0,0 +1,162 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_xfer_batch.h"
+
+void XferBatch_Capture(
+    XFER_BATCH_RANGE* ranges,
+    const volatile XFER_BATCH_ENTRY* entries,
+    unsigned int entryCount)
+{
+	unsigned int pos;
+
+	for (pos = 0; pos < entryCount; pos++)
+	{
+		ranges[pos].Offset	= entries[pos].Offset;
+		ranges[pos].Length	= entries[pos].Length;
+	}
+}
+
+int XferBatch_Validate(
+    const XFER_BATCH_RANGE* ranges,
+    unsigned int entryCount,
+    unsigned int bufferLength,
+    int isRead,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize,
+    unsigned int* badEntry)
+{
+	unsigned int pos;
+	const XFER_BATCH_RANGE* range;
+
+	*badEntry = entryCount;
+	if (!entryCount || entryCount > XFER_BATCH_MAX_ENTRIES || !maxPacketSize)
+		return 0;
+
+	for (pos = 0; pos < entryCount; pos++)
+	{
+		range = &ranges[pos];
+		*badEntry = pos;
+
+		if (range->Offset > bufferLength || range->Length > bufferLength - range->Offset)
+			return 0;
+		if (range->Length > maxTransferSize)
+			return 0;
+		if (isRead && (!range->Length || (range->Length % maxPacketSize)))
+			return 0;
+	}
+
+	*badEntry = entryCount;
+	return 1;
+}
+
+void XferBatch_Begin(
+    XFER_BATCH* batch,
+    const XFER_BATCH_RANGE* ranges,
+    XFER_BATCH_ENTRY* entries,
+    unsigned int entryCount,
+    unsigned int maxInFlight)
+{
+	unsigned int pos;
+
+	if (maxInFlight < 1) maxInFlight = 1;
+	if (maxInFlight > XFER_BATCH_MAX_IN_FLIGHT) maxInFlight = XFER_BATCH_MAX_IN_FLIGHT;
+
+	batch->Ranges		= ranges;
+	batch->Entries		= entries;
+	batch->EntryCount	= entryCount;
+	batch->MaxInFlight	= maxInFlight;
+	batch->NextEntry	= 0;
+	batch->InFlight		= 0;
+	batch->Completed	= 0;
+	batch->Transferred	= 0;
+	batch->Status		= 0;
+	batch->Stopping		= 0;
+	batch->Finished		= 0;
+
+	for (pos = 0; pos < entryCount; pos++)
+	{
+		entries[pos].Transferred	= 0;
+		entries[pos].Status			= 0;
+	}
+}
+
+XFER_BATCH_NEXT XferBatch_Next(
+    XFER_BATCH* batch,
+    unsigned int* entryIndex)
+{
+	if (batch->Finished)
+		return XFER_BATCH_WAIT;
+
+	if (batch->Stopping)
+	{
+		// Skip everything that has not been sent.
+		while (batch->NextEntry < batch->EntryCount)
+		{
+			batch->Entries[batch->NextEntry++].Status = XFER_BATCH_STATUS_CANCELLED;
+			batch->Completed++;
+		}
+	}
+
+	if (batch->NextEntry < batch->EntryCount && batch->InFlight < batch->MaxInFlight)
+	{
+		*entryIndex = batch->NextEntry++;
+		batch->InFlight++;
+		return XFER_BATCH_SEND;
+	}
+
+	if (batch->Completed == batch->EntryCount && !batch->InFlight)
+	{
+		batch->Finished = 1;
+		return XFER_BATCH_FINISHED;
+	}
+
+	return XFER_BATCH_WAIT;
+}
+
+void XferBatch_EntryDone(
+    XFER_BATCH* batch,
+    unsigned int entryIndex,
+    int status,
+    unsigned int transferred)
+{
+	XFER_BATCH_ENTRY* entry = &batch->Entries[entryIndex];
+
+	if (transferred > batch->Ranges[entryIndex].Length)
+		transferred = batch->Ranges[entryIndex].Length;
+
+	entry->Status		= status;
+	entry->Transferred	= transferred;
+
+	batch->Transferred += transferred;
+	batch->InFlight--;
+	batch->Completed++;
+
+	if (status < 0)
+		XferBatch_Abort(batch, status);
+}
+
+void XferBatch_Abort(
+    XFER_BATCH* batch,
+    int status)
+{
+	if (!batch->Status && status < 0)
+		batch->Status = status;
+
+	batch->Stopping = 1;
+}
@@ -0,0 +1,147 @@
+/*! \file drv_xfer_batch.h
+*/
+
+#ifndef __DRV_XFER_BATCH_H__
+#define __DRV_XFER_BATCH_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_xfer_batch.c function prototypes.
+// Fan-out and completion bookkeeping for batched bulk/interrupt transfers.
+//
+// A batch request (LIBUSBK_IOCTL_BATCH_READ/WRITE) carries any number of
+// transfers for one pipe: an array of transfer descriptors and one data
+// buffer each transfer takes its Offset/Length range from. The driver keeps
+// up to MaxInFlight of the transfers sent at a time, in descriptor order,
+// and writes each transfer's own status and length back to its descriptor.
+// The batch request completes once every transfer has.
+//
+// Once a transfer fails (or the batch is aborted) no more transfers are
+// sent; the ones that were not sent complete with XFER_BATCH_STATUS_CANCELLED.
+//
+// The descriptor array stays in (locked) user memory for the life of the
+// batch and the application can change it at any time. Its ranges are
+// read once, into a driver owned XFER_BATCH_RANGE array, by
+// XferBatch_Capture; validation and sending use that copy only, and only
+// the result fields (Transferred, Status) are ever written back.
+//
+// Like drv_xfer_pipeline.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. It does no I/O and takes no
+// locks; drv_xfer_bulk.c serializes every call with the batch lock.
+//
+
+// Most transfers in one batch. (KUSB_BATCH_MAX_ENTRIES)
+#define XFER_BATCH_MAX_ENTRIES		1024
+
+// Most transfers of a batch sent at the same time.
+#define XFER_BATCH_MAX_IN_FLIGHT	8
+
+// STATUS_CANCELLED
+#define XFER_BATCH_STATUS_CANCELLED	((int)0xC0000120L)
+
+// Transfer descriptor; the same layout as KUSB_BATCH_ENTRY.
+typedef struct _XFER_BATCH_ENTRY
+{
+	// Range of the batch data buffer. Length is 0 for a ZLP. (writes only)
+	unsigned int Offset;
+	unsigned int Length;
+
+	// Completion results.
+	unsigned int Transferred;
+	int Status;
+} XFER_BATCH_ENTRY;
+
+// Driver copy of one descriptor range. (see XferBatch_Capture)
+typedef struct _XFER_BATCH_RANGE
+{
+	unsigned int Offset;
+	unsigned int Length;
+} XFER_BATCH_RANGE;
+
+typedef enum _XFER_BATCH_NEXT
+{
+    // A transfer was reserved; send it.
+    XFER_BATCH_SEND = 0,
+
+    // Nothing to send until another transfer completes.
+    XFER_BATCH_WAIT,
+
+    // Every transfer has completed. Returned once per batch.
+    XFER_BATCH_FINISHED,
+} XFER_BATCH_NEXT;
+
+typedef struct _XFER_BATCH
+{
+	// Ranges to send and the descriptors that receive the results.
+	const XFER_BATCH_RANGE* Ranges;
+	XFER_BATCH_ENTRY* Entries;
+	unsigned int EntryCount;
+	unsigned int MaxInFlight;
+
+	// Next entry to send; entries before it have been sent or skipped.
+	unsigned int NextEntry;
+	unsigned int InFlight;
+	unsigned int Completed;
+
+	// Sum of the Transferred lengths.
+	unsigned int Transferred;
+
+	// First failure status; 0 on success.
+	int Status;
+
+	int Stopping;
+	int Finished;
+} XFER_BATCH;
+
+// Copies the range of each descriptor into ranges. Each field is read
+// exactly once.
+void XferBatch_Capture(
+    XFER_BATCH_RANGE* ranges,
+    const volatile XFER_BATCH_ENTRY* entries,
+    unsigned int entryCount);
+
+// Checks the captured ranges before anything is sent. Returns non-zero if
+// the batch is valid; otherwise *badEntry receives the index of the first
+// invalid range (entryCount if the count itself is invalid).
+//
+// Every range must lie within the data buffer and be no larger than
+// maxTransferSize. Read lengths must be a non-zero multiple of
+// maxPacketSize; a batch has no over-run buffer for a sub-packet tail.
+int XferBatch_Validate(
+    const XFER_BATCH_RANGE* ranges,
+    unsigned int entryCount,
+    unsigned int bufferLength,
+    int isRead,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize,
+    unsigned int* badEntry);
+
+// Starts a batch of validated ranges; clears the results of every entry.
+// maxInFlight is clamped to 1..XFER_BATCH_MAX_IN_FLIGHT.
+void XferBatch_Begin(
+    XFER_BATCH* batch,
+    const XFER_BATCH_RANGE* ranges,
+    XFER_BATCH_ENTRY* entries,
+    unsigned int entryCount,
+    unsigned int maxInFlight);
+
+// Reserves the next transfer. On XFER_BATCH_SEND, entryIndex receives the
+// index of the range to send.
+XFER_BATCH_NEXT XferBatch_Next(
+    XFER_BATCH* batch,
+    unsigned int* entryIndex);
+
+// Records the completion of a sent transfer. A transfer that could not be
+// sent is completed with the send failure status. transferred is clamped
+// to the captured range length.
+void XferBatch_EntryDone(
+    XFER_BATCH* batch,
+    unsigned int entryIndex,
+    int status,
+    unsigned int transferred);
+
+// Stops sending transfers. status is kept if it is the first failure.
+void XferBatch_Abort(
+    XFER_BATCH* batch,
+    int status);
+
+#endif
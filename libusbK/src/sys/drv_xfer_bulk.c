@@ -31,6 +31,35 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_ReadBulkComplete;
 EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkRawComplete;
 EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkComplete;
 
+EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_PipelineStageComplete;
+EVT_WDF_REQUEST_CANCEL Xfer_PipelineCancel;
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_BatchEntryComplete;
+EVT_WDF_REQUEST_CANCEL Xfer_BatchCancel;
+
+static NTSTATUS Xfer_PipelineStart(
+    __in PQUEUE_CONTEXT queueContext,
+    __in PREQUEST_CONTEXT requestContext,
+    __in WDFREQUEST Request);
+
+//
+// Context for the stage requests created by Xfer_InitPipeline.
+//
+typedef struct _XFER_STAGE_CONTEXT
+{
+	PQUEUE_CONTEXT	QueueContext;
+	ULONG			StageIndex;
+} XFER_STAGE_CONTEXT, *PXFER_STAGE_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_STAGE_CONTEXT, GetXferStageContext)
+
+// QUEUE_CONTEXT::Pipeline.StageFlags
+#define XFER_STAGE_FLAG_SENT		0x01
+#define XFER_STAGE_FLAG_CANCELLED	0x02
+
+// TRUE if the remaining part of a transfer is pipelined. (PIPELINE_DEPTH > 1 and more than one stage)
+#define mXfer_UsePipeline(mQueueContext, mRemainingLength) \
+	((mQueueContext)->Pipeline.Lock && (mRemainingLength) > (mQueueContext)->Info.MaximumTransferSize)
+
 #define mXfer_CopyPartialReadToUserMemory(mStatus,mQueueContext, mTransferBuffer, mTransferLength, ErrorAction)	do {	\
 		mStatus = WdfMemoryCopyFromBuffer( 																					\
 		          mQueueContext->Xfer.UserMem,   																					\
@@ -53,28 +82,26 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkComplete;
 /*
 * Sumbmits a bulk/interrupt read stage transfer.
 * REQUIRES:
-* - ULONG remainingLength [out]
+* - XFER_READ_PLAN readPlan [out]
 * - ULONG stageLength [out]
-* - ULONG remainderLength [out]
 * - WDF_REQUEST_SEND_OPTIONS sendOptions [out]
 */
 #define mXfer_SubmitNextRead(mStatus, mQueueContext, mRequestContext, mRequest, mCompletionRoutine, mErrorAction) do { 							\
 		/* One or more transfers required  */  																										\
-		remainingLength	= mQueueContext->Xfer.Length - mQueueContext->Xfer.Transferred; 															\
-		stageLength		= remainingLength > mQueueContext->Info.MaximumTransferSize ? mQueueContext->Info.MaximumTransferSize : remainingLength;	\
-		remainderLength = stageLength % mQueueContext->Info.MaximumPacketSize; 																		\
+		XferPipeline_PlanRead(mQueueContext->Xfer.Length, mQueueContext->Xfer.Transferred,  														\
+		                      mQueueContext->Info.MaximumPacketSize, mQueueContext->Info.MaximumTransferSize, 0, &readPlan);						\
 		\
-		\
-		if (stageLength < mQueueContext->Info.MaximumPacketSize)   																					\
+		if (readPlan.BounceLength) 																													\
 		{  																																			\
+			stageLength = readPlan.BounceLength;   																									\
 			if (!mRequestContext->Policies.AllowPartialReads)  																						\
 			{  																																		\
 				mStatus = STATUS_INVALID_BUFFER_SIZE;  																								\
 				USBERRN("Read buffer is not an interval of MaximumPacketSize. MaximumPacketSize: %u RemainderLength: %u",  							\
-				        mQueueContext->Info.MaximumPacketSize, remainderLength);   																	\
+				        mQueueContext->Info.MaximumPacketSize, stageLength);   																		\
 				mErrorAction;  																														\
 			}  																																		\
-			/* Use the over-run buffer; CompletionRoutine must update UserMem */   																	\
+			/* Only the sub-packet tail uses the over-run buffer; CompletionRoutine must update UserMem */  											\
 			mQueueContext->OverOfs.BufferOffset = 0;   																								\
 			mQueueContext->OverOfs.BufferLength = stageLength; 																						\
 			\
@@ -83,7 +110,7 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkComplete;
 		else   																																		\
 		{  																																			\
 			/* One or more whole packets can be read directly into the user buffer. */ 																\
-			stageLength -= remainderLength;																											\
+			stageLength = readPlan.DirectLength;   																									\
 			mQueueContext->Xfer.UserOfs.BufferOffset = mQueueContext->Xfer.Transferred;																\
 			mQueueContext->Xfer.UserOfs.BufferLength = stageLength;																					\
 			\
@@ -104,7 +131,7 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkComplete;
 			mErrorAction;  																															\
 		}  																																			\
 		\
-		USBMSG("PipeID=%02Xh Staging=%u\n",	mQueueContext->Info.EndpointAddress, stageLength);  													\
+		KTRACE_MSG(XFER_STAGE, mQueueContext->Info.EndpointAddress, stageLength);  													\
 		mStatus = SubmitAsyncQueueRequest(mQueueContext, mRequest, mCompletionRoutine, &sendOptions, mQueueContext);   								\
 		if (!NT_SUCCESS(mStatus))  																													\
 		{  																																			\
@@ -140,7 +167,7 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_WriteBulkComplete;
 			mErrorAction;  																															\
 		}  																																			\
 		\
-		USBMSG("PipeID=%02Xh Staging=%u\n",	mQueueContext->Info.EndpointAddress, stageLength);  													\
+		KTRACE_MSG(XFER_STAGE, mQueueContext->Info.EndpointAddress, stageLength);  													\
 		mStatus = SubmitAsyncQueueRequest(mQueueContext, mRequest, mCompletionRoutine, &sendOptions, mQueueContext);   								\
 		if (!NT_SUCCESS(mStatus))  																													\
 		{  																																			\
@@ -157,9 +184,8 @@ VOID Xfer_ReadBulk (
 	PREQUEST_CONTEXT        requestContext = NULL;
 	PQUEUE_CONTEXT			queueContext = NULL;
 	PDEVICE_CONTEXT         deviceContext;
-	ULONG					remainingLength;
+	XFER_READ_PLAN			readPlan;
 	ULONG					stageLength = 0;
-	ULONG					remainderLength = 0;
 	WDF_REQUEST_SEND_OPTIONS sendOptions;
 	PUCHAR					transferBuffer;
 
@@ -219,16 +245,18 @@ VOID Xfer_ReadBulk (
 	if (queueContext->OverOfs.BufferLength > 0)
 	{
 		// Copy partial read bytes bytes into UserMem
-		remainingLength = queueContext->Xfer.Length - queueContext->Xfer.Transferred;
-		stageLength = (ULONG)queueContext->OverOfs.BufferLength > remainingLength ? remainingLength : (ULONG)queueContext->OverOfs.BufferLength;
+		XferPipeline_PlanRead(queueContext->Xfer.Length, queueContext->Xfer.Transferred,
+		                      queueContext->Info.MaximumPacketSize, queueContext->Info.MaximumTransferSize,
+		                      (ULONG)queueContext->OverOfs.BufferLength, &readPlan);
+
+		stageLength = readPlan.LeftoverCopy;
 		transferBuffer = &queueContext->OverBuf[queueContext->OverOfs.BufferOffset];
 
 		mXfer_CopyPartialReadToUserMemory(status, queueContext, transferBuffer, stageLength, goto Exit);
 
-		USBDBGN("PipeID=%02Xh Transferred %u bytes from a previous partial read.",
-		        queueContext->Info.EndpointAddress, queueContext->Xfer.Transferred);
+		KTRACE_DBG(XFER_PARTIAL_COPY, queueContext->Info.EndpointAddress, queueContext->Xfer.Transferred);
 
-		if (queueContext->Xfer.Transferred >= queueContext->Xfer.Length)
+		if (readPlan.Complete)
 		{
 			if (requestContext->Policies.AutoFlush)
 			{
@@ -237,8 +265,7 @@ VOID Xfer_ReadBulk (
 				queueContext->OverOfs.BufferOffset = 0;
 			}
 
-			USBMSGN("PipeID=%02Xh DoneReason: Transferred==Requested. Transferred=%u",
-			        queueContext->Info.EndpointAddress,	queueContext->Xfer.Transferred);
+			KTRACE_MSG(XFER_PARTIAL_DONE, queueContext->Info.EndpointAddress, queueContext->Xfer.Transferred);
 			status = STATUS_SUCCESS;
 			goto Exit;
 		}
@@ -258,16 +285,28 @@ VOID Xfer_ReadBulk (
 #endif
 	}
 
+	/*
+	Read pipelining is limited to IgnoreShortPackets=TRUE. Otherwise a short packet ends the
+	request and stages already in flight would take data that belongs to the next one.
+	*/
+	if (requestContext->Policies.IgnoreShortPackets &&
+	        mXfer_UsePipeline(queueContext, queueContext->Xfer.Length - queueContext->Xfer.Transferred))
+	{
+		status = Xfer_PipelineStart(queueContext, requestContext, Request);
+		if (!NT_SUCCESS(status)) goto Exit;
+		return;
+	}
+
 	mXfer_SubmitNextRead(status, queueContext, requestContext, Request, Xfer_ReadBulkComplete, goto Exit);
 	return;
 
 Exit:
 	if (queueContext)
 	{
-		WdfRequestCompleteWithInformation(Request, status, queueContext->Xfer.Transferred);
+		Xfer_CompleteRequest(Request, status, queueContext->Xfer.Transferred);
 		return;
 	}
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
 
 VOID Xfer_ReadBulkComplete(
@@ -279,10 +318,9 @@ VOID Xfer_ReadBulkComplete(
 	NTSTATUS                status;
 	PREQUEST_CONTEXT        requestContext = NULL;
 	PQUEUE_CONTEXT			queueContext = NULL;
-	ULONG					remainingLength;
+	XFER_READ_PLAN			readPlan;
 	ULONG					transferredLength;
 	ULONG					stageLength = 0;
-	ULONG					remainderLength = 0;
 	WDF_REQUEST_SEND_OPTIONS sendOptions;
 	PUCHAR					transferBuffer;
 	PWDF_USB_REQUEST_COMPLETION_PARAMS usbCompletionParams;
@@ -318,6 +356,13 @@ VOID Xfer_ReadBulkComplete(
 			transferBuffer	= queueContext->OverBuf;
 			queueContext->OverOfs.BufferLength = transferredLength;
 
+			if (queueContext->PipeContext)
+			{
+				ExInterlockedAddLargeStatistic(&queueContext->PipeContext->Stats.BounceBytes, transferredLength);
+				if (transferredLength > stageLength)
+					InterlockedIncrement(&queueContext->PipeContext->Stats.PartialReads);
+			}
+
 			mXfer_CopyPartialReadToUserMemory(status, queueContext, transferBuffer, stageLength, goto Exit);
 
 			if (queueContext->Xfer.Transferred >= queueContext->Xfer.Length)
@@ -330,8 +375,7 @@ VOID Xfer_ReadBulkComplete(
 				}
 
 				// DONE REASON: Transferred==Requested
-				USBDBGN("PipeID=%02Xh DoneReason: Transferred==Requested. Staged=%u Total=%u Requested=%u",
-				        queueContext->Info.EndpointAddress,	stageLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
+				KTRACE_DBG(XFER_DONE_LENGTH, queueContext->Info.EndpointAddress, stageLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
 				goto Exit;
 			}
 			if (!NT_SUCCESS(status)) goto Exit;
@@ -342,7 +386,7 @@ VOID Xfer_ReadBulkComplete(
 			if (!NT_SUCCESS(status)) goto Exit;
 
 			// Received a ZLP
-			USBDBGN("PipeID=%02Xh ZLP received.", queueContext->Info.EndpointAddress);
+			KTRACE_DBG(XFER_ZLP_RECEIVED, queueContext->Info.EndpointAddress);
 			queueContext->OverOfs.BufferLength = 0;
 		}
 		if (!NT_SUCCESS(status)) goto Exit;
@@ -350,8 +394,7 @@ VOID Xfer_ReadBulkComplete(
 		if (!requestContext->Policies.IgnoreShortPackets)
 		{
 			// DONE REASON: IgnoreShortPackets = 0
-			USBDBGN("PipeID=%02Xh DoneReason: IgnoreShortPackets=FALSE. Staged=%u Total=%u Requested=%u",
-			        queueContext->Info.EndpointAddress,	stageLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
+			KTRACE_DBG(XFER_DONE_SHORT, queueContext->Info.EndpointAddress, stageLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
 
 			goto Exit;
 		}
@@ -365,14 +408,13 @@ VOID Xfer_ReadBulkComplete(
 		if (!transferredLength)
 		{
 			// Received a ZLP
-			USBDBGN("PipeID=%02Xh ZLP received.", queueContext->Info.EndpointAddress);
+			KTRACE_DBG(XFER_ZLP_RECEIVED, queueContext->Info.EndpointAddress);
 		}
 
 		if (queueContext->Xfer.Transferred >= queueContext->Xfer.Length)
 		{
 			// DONE REASON: Transferred==Requested
-			USBDBGN("PipeID=%02Xh DoneReason: Transferred==Requested. Staged=%u Total=%u Requested=%u",
-			        queueContext->Info.EndpointAddress,	transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
+			KTRACE_DBG(XFER_DONE_LENGTH, queueContext->Info.EndpointAddress, transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
 			goto Exit;
 		}
 		else if (transferredLength && transferredLength == queueContext->Xfer.UserOfs.BufferLength)
@@ -384,8 +426,7 @@ VOID Xfer_ReadBulkComplete(
 		if (!requestContext->Policies.IgnoreShortPackets)
 		{
 			// DONE REASON: IgnoreShortPackets = 0
-			USBDBGN("PipeID=%02Xh DoneReason: IgnoreShortPackets=FALSE. Staged=%u Total=%u Requested=%u",
-			        queueContext->Info.EndpointAddress,	transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
+			KTRACE_DBG(XFER_DONE_SHORT, queueContext->Info.EndpointAddress, transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
 			goto Exit;
 		}
 	}
@@ -395,7 +436,7 @@ NextRead:
 	return;
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, queueContext->Xfer.Transferred);
+	Xfer_CompleteRequest(Request, status, queueContext->Xfer.Transferred);
 
 }
 
@@ -466,7 +507,7 @@ VOID Xfer_ReadBulkRaw (
 		goto Exit;
 	}
 
-	USBMSG("PipeID=%02Xh Length=%u\n",	queueContext->Info.EndpointAddress,	requestContext->Length);
+	KTRACE_MSG(XFER_RAW_SUBMIT, queueContext->Info.EndpointAddress, requestContext->Length);
 	status = SubmitAsyncQueueRequest(queueContext, Request, Xfer_ReadBulkRawComplete, &sendOptions, queueContext);
 	if (!NT_SUCCESS(status))
 	{
@@ -477,7 +518,7 @@ VOID Xfer_ReadBulkRaw (
 	return;
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
 
 VOID Xfer_ReadBulkRawComplete(
@@ -508,9 +549,9 @@ VOID Xfer_ReadBulkRawComplete(
 
 	if (NT_SUCCESS(status) || length)
 	{
-		USBMSGN("PipeID=%02Xh Done. Total=%u Requested=%u", queueContext->Info.EndpointAddress,	length, requestContext->Length);
+		KTRACE_MSG(XFER_RAW_DONE, queueContext->Info.EndpointAddress, length, requestContext->Length);
 	}
-	WdfRequestCompleteWithInformation(Request, status, length);
+	Xfer_CompleteRequest(Request, status, length);
 
 }
 
@@ -572,16 +613,24 @@ VOID Xfer_WriteBulk (
 	}
 
 	queueContext->Xfer.Zlps.Required = (UCHAR)requestContext->Policies.ShortPacketTerminate;
+
+	if (mXfer_UsePipeline(queueContext, queueContext->Xfer.Length))
+	{
+		status = Xfer_PipelineStart(queueContext, requestContext, Request);
+		if (!NT_SUCCESS(status)) goto Exit;
+		return;
+	}
+
 	mXfer_SubmitNextWrite(status, queueContext, requestContext, Request, Xfer_WriteBulkComplete, goto Exit);
 	return;
 
 Exit:
 	if (queueContext)
 	{
-		WdfRequestCompleteWithInformation(Request, status, queueContext->Xfer.Transferred);
+		Xfer_CompleteRequest(Request, status, queueContext->Xfer.Transferred);
 		return;
 	}
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
 
 VOID Xfer_WriteBulkComplete(
@@ -626,15 +675,13 @@ VOID Xfer_WriteBulkComplete(
 			if (queueContext->Xfer.Zlps.Sent >= queueContext->Xfer.Zlps.Required)
 			{
 				// DONE REASON: Transferred==Requested
-				USBDBGN("PipeID=%02Xh DoneReason: Transferred==Requested. Staged=%u Total=%u Requested=%u",
-				        queueContext->Info.EndpointAddress,	transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
+				KTRACE_DBG(XFER_DONE_LENGTH, queueContext->Info.EndpointAddress, transferredLength, queueContext->Xfer.Transferred, queueContext->Xfer.Length);
 				goto Exit;
 			}
 			else
 			{
 				queueContext->Xfer.Zlps.Sent++;
-				USBDBGN("PipeID=%02Xh Terminating with ZLP %u of %u..",
-				        queueContext->Info.EndpointAddress, queueContext->Xfer.Zlps.Sent, queueContext->Xfer.Zlps.Required);
+				KTRACE_DBG(XFER_ZLP_SEND, queueContext->Info.EndpointAddress, queueContext->Xfer.Zlps.Sent, queueContext->Xfer.Zlps.Required);
 
 				goto NextWrite;
 
@@ -655,7 +702,7 @@ NextWrite:
 	return;
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, queueContext->Xfer.Transferred);
+	Xfer_CompleteRequest(Request, status, queueContext->Xfer.Transferred);
 
 }
 
@@ -725,7 +772,7 @@ VOID Xfer_WriteBulkRaw (
 		goto Exit;
 	}
 
-	USBMSG("PipeID=%02Xh Length=%u\n",	queueContext->Info.EndpointAddress,	requestContext->Length);
+	KTRACE_MSG(XFER_RAW_SUBMIT, queueContext->Info.EndpointAddress, requestContext->Length);
 	status = SubmitAsyncQueueRequest(queueContext, Request, Xfer_WriteBulkRawComplete, &sendOptions, queueContext);
 	if (!NT_SUCCESS(status))
 	{
@@ -736,7 +783,7 @@ VOID Xfer_WriteBulkRaw (
 	return;
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
 
 VOID Xfer_WriteBulkRawComplete(
@@ -765,7 +812,750 @@ VOID Xfer_WriteBulkRawComplete(
 
 	if (NT_SUCCESS(status) || length)
 	{
-		USBMSGN("PipeID=%02Xh Done. Total=%u Requested=%u", queueContext->Info.EndpointAddress,	length, requestContext->Length);
+		KTRACE_MSG(XFER_RAW_DONE, queueContext->Info.EndpointAddress, length, requestContext->Length);
+	}
+	Xfer_CompleteRequest(Request, status, length);
+}
+
+/*
+* Pipelined bulk/interrupt transfers. (PIPELINE_DEPTH > 1)
+*
+* The main request is never sent. Its stages are sent with the stage requests
+* created by Xfer_InitPipeline and the main request is completed when the
+* last stage is retired. Stage planning and in-order retirement are done by
+* drv_xfer_pipeline.c; everything here holds Pipeline.Lock while using it.
+*
+* Only one thread at a time sends or cancels stages (Pipeline.Busy). Other
+* threads record their completions and leave; the busy thread picks them up
+* before it lets go. This also keeps the transfer from finishing while a
+* stage request is being sent or cancelled outside of the lock.
+*/
+NTSTATUS Xfer_InitPipeline(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG depth)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PXFER_STAGE_CONTEXT stageContext;
+	ULONG stageIndex;
+
+	XferPipeline_Init(&queueContext->Pipeline.State,
+	                  depth,
+	                  queueContext->Info.MaximumPacketSize,
+	                  queueContext->Info.MaximumTransferSize);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Queue;
+	status = WdfSpinLockCreate(&attributes, &queueContext->Pipeline.Lock);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfSpinLockCreate failed. Status=%08Xh", status);
+		queueContext->Pipeline.Lock = NULL;
+		return status;
+	}
+
+	for (stageIndex = 0; stageIndex < queueContext->Pipeline.State.Depth; stageIndex++)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_STAGE_CONTEXT);
+		attributes.ParentObject = Queue;
+
+		status = WdfRequestCreate(&attributes,
+		                          WdfUsbTargetPipeGetIoTarget(queueContext->PipeHandle),
+		                          &queueContext->Pipeline.Stages[stageIndex]);
+		if (!NT_SUCCESS(status))
+		{
+			USBERRN("WdfRequestCreate failed. Status=%08Xh", status);
+			return status;
+		}
+
+		stageContext = GetXferStageContext(queueContext->Pipeline.Stages[stageIndex]);
+		stageContext->QueueContext	= queueContext;
+		stageContext->StageIndex	= stageIndex;
+	}
+
+	USBDBGN("PipeID=%02Xh Depth=%u", queueContext->Info.EndpointAddress, queueContext->Pipeline.State.Depth);
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS Xfer_PipelineSendStage(
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG stageIndex)
+{
+	NTSTATUS status;
+	XFER_STAGE* stage = &queueContext->Pipeline.State.Stages[stageIndex];
+	WDFREQUEST stageRequest = queueContext->Pipeline.Stages[stageIndex];
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+	WDF_REQUEST_SEND_OPTIONS sendOptions;
+	WDFMEMORY_OFFSET stageOfs;
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+	status = WdfRequestReuse(stageRequest, &reuseParams);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfRequestReuse failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	stageOfs.BufferOffset = stage->Offset;
+	stageOfs.BufferLength = stage->Length;
+
+	if (queueContext->Pipeline.State.IsRead)
+		status = WdfUsbTargetPipeFormatRequestForRead(queueContext->PipeHandle, stageRequest, queueContext->Xfer.UserMem, &stageOfs);
+	else if (stage->Length)
+		status = WdfUsbTargetPipeFormatRequestForWrite(queueContext->PipeHandle, stageRequest, queueContext->Xfer.UserMem, &stageOfs);
+	else
+		status = WdfUsbTargetPipeFormatRequestForWrite(queueContext->PipeHandle, stageRequest, NULL, NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfUsbTargetPipeFormatRequest failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions, 0);
+	status = SetRequestTimeout(queueContext->Pipeline.MainRequestContext, stageRequest, &sendOptions);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("SetRequestTimeout failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	KTRACE_MSG(PIPELINE_STAGE, queueContext->Info.EndpointAddress, stageIndex, stage->Offset, stage->Length);
+
+	return SubmitAsyncQueueRequest(queueContext, stageRequest, Xfer_PipelineStageComplete, &sendOptions, queueContext);
+}
+
+static VOID Xfer_PipelineFinish(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	NTSTATUS					status;
+	WDFREQUEST					request			= queueContext->Pipeline.MainRequest;
+	PREQUEST_CONTEXT			requestContext	= queueContext->Pipeline.MainRequestContext;
+	XFER_PIPELINE*				pipeline		= &queueContext->Pipeline.State;
+	XFER_READ_PLAN				readPlan;
+	ULONG						stageLength		= 0;
+	WDF_REQUEST_SEND_OPTIONS	sendOptions;
+
+	status = (NTSTATUS)pipeline->Status;
+	queueContext->Xfer.Transferred = pipeline->Transferred;
+
+	if (!NT_SUCCESS(status))
+		mXfer_HandlePipeResetScenariosForComplete(status, queueContext, requestContext);
+
+	if (WdfRequestUnmarkCancelable(request) == STATUS_CANCELLED)
+	{
+		// Xfer_PipelineCancel has been (or is about to be) called; the last one out completes the request.
+		queueContext->Pipeline.MainRequest = NULL;
+		if (NT_SUCCESS(status) && queueContext->Xfer.Transferred < queueContext->Xfer.Length)
+			status = STATUS_CANCELLED;
+
+		queueContext->Pipeline.CompleteStatus = status;
+		if (InterlockedDecrement(&queueContext->Pipeline.CompleteRefs) > 0)
+			return;
+
+		goto Exit;
+	}
+	queueContext->Pipeline.MainRequest = NULL;
+
+	if (NT_SUCCESS(status) && pipeline->IsRead && queueContext->Xfer.Transferred < queueContext->Xfer.Length)
+	{
+		// Whole packets are in; the sub-packet tail is read through the over-run buffer as usual.
+		mXfer_SubmitNextRead(status, queueContext, requestContext, request, Xfer_ReadBulkComplete, goto Exit);
+		return;
+	}
+
+	KTRACE_DBG(PIPELINE_DONE, queueContext->Info.EndpointAddress, queueContext->Xfer.Transferred, queueContext->Xfer.Length, status);
+
+Exit:
+	Xfer_CompleteRequest(request, status, queueContext->Xfer.Transferred);
+}
+
+static VOID Xfer_PipelineAdvance(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	NTSTATUS			status;
+	XFER_PIPELINE*		pipeline = &queueContext->Pipeline.State;
+	XFER_PIPELINE_MOVE	move;
+	XFER_PIPELINE_NEXT	next;
+	WDFREQUEST			cancelStages[XFER_PIPELINE_MAX_DEPTH];
+	ULONG				cancelCount;
+	ULONG				stageIndex = 0;
+	BOOLEAN				isBusy = FALSE;
+
+	for (;;)
+	{
+		cancelCount = 0;
+
+		WdfSpinLockAcquire(queueContext->Pipeline.Lock);
+
+		if (isBusy)
+		{
+			queueContext->Pipeline.Busy--;
+			isBusy = FALSE;
+		}
+
+		// Retire completed stages in the order they were sent.
+		while (XferPipeline_Retire(pipeline, &move))
+		{
+			if (move.Length)
+			{
+				// A short read stage left a gap; close it.
+				RtlMoveMemory(&queueContext->Pipeline.UserBuffer[move.DstOffset],
+				              &queueContext->Pipeline.UserBuffer[move.SrcOffset],
+				              move.Length);
+			}
+		}
+
+		// Failed or cancelled; stages still in flight will not be counted.
+		if (pipeline->Stopping)
+		{
+			for (stageIndex = 0; stageIndex < pipeline->Depth; stageIndex++)
+			{
+				if (pipeline->Stages[stageIndex].State == XFER_STAGE_PENDING &&
+				        queueContext->Pipeline.StageFlags[stageIndex] == XFER_STAGE_FLAG_SENT)
+				{
+					queueContext->Pipeline.StageFlags[stageIndex] |= XFER_STAGE_FLAG_CANCELLED;
+					cancelStages[cancelCount++] = queueContext->Pipeline.Stages[stageIndex];
+				}
+			}
+		}
+
+		if (cancelCount || queueContext->Pipeline.Busy)
+			next = XFER_PIPELINE_WAIT;
+		else
+			next = XferPipeline_NextStage(pipeline, &stageIndex);
+
+		if (cancelCount || next == XFER_PIPELINE_SEND)
+		{
+			queueContext->Pipeline.Busy++;
+			isBusy = TRUE;
+		}
+		if (next == XFER_PIPELINE_SEND)
+			queueContext->Pipeline.StageFlags[stageIndex] = 0;
+
+		WdfSpinLockRelease(queueContext->Pipeline.Lock);
+
+		if (cancelCount)
+		{
+			while (cancelCount)
+				WdfRequestCancelSentRequest(cancelStages[--cancelCount]);
+			continue;
+		}
+
+		if (next == XFER_PIPELINE_WAIT)
+			return;
+
+		if (next == XFER_PIPELINE_FINISHED)
+		{
+			Xfer_PipelineFinish(queueContext);
+			return;
+		}
+
+		status = Xfer_PipelineSendStage(queueContext, stageIndex);
+
+		WdfSpinLockAcquire(queueContext->Pipeline.Lock);
+		if (NT_SUCCESS(status))
+			queueContext->Pipeline.StageFlags[stageIndex] |= XFER_STAGE_FLAG_SENT;
+		else
+			XferPipeline_StageDone(pipeline, stageIndex, status, 0);
+		WdfSpinLockRelease(queueContext->Pipeline.Lock);
+	}
+}
+
+static NTSTATUS Xfer_PipelineStart(
+    __in PQUEUE_CONTEXT queueContext,
+    __in PREQUEST_CONTEXT requestContext,
+    __in WDFREQUEST Request)
+{
+	NTSTATUS status;
+	BOOLEAN isRead = USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress) ? TRUE : FALSE;
+
+	queueContext->Pipeline.MainRequest			= Request;
+	queueContext->Pipeline.MainRequestContext	= requestContext;
+	queueContext->Pipeline.CompleteStatus		= STATUS_SUCCESS;
+	queueContext->Pipeline.CompleteRefs			= 2;
+	queueContext->Pipeline.UserBuffer			= isRead ? (PUCHAR)WdfMemoryGetBuffer(queueContext->Xfer.UserMem, NULL) : NULL;
+
+	WdfSpinLockAcquire(queueContext->Pipeline.Lock);
+	XferPipeline_Begin(&queueContext->Pipeline.State,
+	                   isRead,
+	                   queueContext->Xfer.Length,
+	                   queueContext->Xfer.Transferred,
+	                   queueContext->Xfer.Zlps.Required);
+	WdfSpinLockRelease(queueContext->Pipeline.Lock);
+
+	status = WdfRequestMarkCancelableEx(Request, Xfer_PipelineCancel);
+	if (!NT_SUCCESS(status))
+	{
+		USBWRNN("WdfRequestMarkCancelableEx failed. Status=%08Xh", status);
+		queueContext->Pipeline.MainRequest = NULL;
+		return status;
+	}
+
+	KTRACE_MSG(PIPELINE_START, queueContext->Info.EndpointAddress, queueContext->Xfer.Length, queueContext->Pipeline.State.Depth);
+
+	Xfer_PipelineAdvance(queueContext);
+	return STATUS_SUCCESS;
+}
+
+VOID Xfer_PipelineStageComplete(
+    __in WDFREQUEST Request,
+    __in WDFIOTARGET Target,
+    __in PWDF_REQUEST_COMPLETION_PARAMS CompletionParams,
+    __in WDFCONTEXT Context)
+{
+	NTSTATUS status;
+	PQUEUE_CONTEXT queueContext = (PQUEUE_CONTEXT)Context;
+	PWDF_USB_REQUEST_COMPLETION_PARAMS usbCompletionParams;
+	ULONG transferredLength = 0;
+
+	UNREFERENCED_PARAMETER(Target);
+
+	status				= CompletionParams->IoStatus.Status;
+	usbCompletionParams = CompletionParams->Parameters.Usb.Completion;
+
+	if (usbCompletionParams)
+	{
+		transferredLength = (ULONG)(queueContext->Pipeline.State.IsRead
+		                            ? usbCompletionParams->Parameters.PipeRead.Length
+		                            : usbCompletionParams->Parameters.PipeWrite.Length);
+	}
+
+	Xfer_CheckPipeStatus(status, queueContext->Info.EndpointAddress);
+
+	WdfSpinLockAcquire(queueContext->Pipeline.Lock);
+	XferPipeline_StageDone(&queueContext->Pipeline.State, GetXferStageContext(Request)->StageIndex, status, transferredLength);
+	WdfSpinLockRelease(queueContext->Pipeline.Lock);
+
+	Xfer_PipelineAdvance(queueContext);
+}
+
+VOID Xfer_PipelineCancel(
+    __in WDFREQUEST Request)
+{
+	PQUEUE_CONTEXT queueContext = GetQueueContext(WdfRequestGetIoQueue(Request));
+
+	USBWRNN("[Cancelled] PipeID=%02Xh pipelined request=%p", queueContext->Info.EndpointAddress, Request);
+
+	WdfSpinLockAcquire(queueContext->Pipeline.Lock);
+	XferPipeline_Abort(&queueContext->Pipeline.State, STATUS_CANCELLED);
+	WdfSpinLockRelease(queueContext->Pipeline.Lock);
+
+	Xfer_PipelineAdvance(queueContext);
+
+	if (InterlockedDecrement(&queueContext->Pipeline.CompleteRefs) == 0)
+		Xfer_CompleteRequest(Request, queueContext->Pipeline.CompleteStatus, queueContext->Xfer.Transferred);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Batched transfers. (LIBUSBK_IOCTL_BATCH_READ/WRITE, see drv_xfer_batch.h)
+//
+// The batch request is never sent. Each transfer is sent with one of up to
+// XFER_BATCH_MAX_IN_FLIGHT slot requests created for the batch; a slot is
+// reused for the next transfer when it completes.
+//
+
+// XFER_BATCH_CONTEXT::SlotEntry of an idle slot.
+#define XFER_BATCH_SLOT_FREE	((ULONG)-1)
+
+typedef struct _XFER_BATCH_CONTEXT
+{
+	PQUEUE_CONTEXT		QueueContext;
+	PREQUEST_CONTEXT	RequestContext;
+	WDFMEMORY			UserMem;
+	WDFSPINLOCK			Lock;
+
+	// Nonpaged copy of the descriptor ranges; never read from user memory again.
+	XFER_BATCH_RANGE*	Ranges;
+
+	XFER_BATCH			State;								// [Lock]
+	ULONG				SlotCount;
+	WDFREQUEST			Slots[XFER_BATCH_MAX_IN_FLIGHT];
+	ULONG				SlotEntry[XFER_BATCH_MAX_IN_FLIGHT];	// [Lock]
+	UCHAR				SlotFlags[XFER_BATCH_MAX_IN_FLIGHT];	// [Lock]
+	LONG				Busy;								// [Lock]
+
+	NTSTATUS			CompleteStatus;
+	volatile long		CompleteRefs;
+} XFER_BATCH_CONTEXT, *PXFER_BATCH_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_BATCH_CONTEXT, GetXferBatchContext)
+
+typedef struct _XFER_BATCH_SLOT_CONTEXT
+{
+	WDFREQUEST	MainRequest;
+	ULONG		SlotIndex;
+} XFER_BATCH_SLOT_CONTEXT, *PXFER_BATCH_SLOT_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_BATCH_SLOT_CONTEXT, GetXferBatchSlotContext)
+
+C_ASSERT(sizeof(KUSB_BATCH_ENTRY) == sizeof(XFER_BATCH_ENTRY));
+C_ASSERT(KUSB_BATCH_MAX_ENTRIES == XFER_BATCH_MAX_ENTRIES);
+
+static NTSTATUS Xfer_BatchSendEntry(
+    __in PXFER_BATCH_CONTEXT batchContext,
+    __in ULONG slotIndex)
+{
+	NTSTATUS status;
+	PQUEUE_CONTEXT queueContext = batchContext->QueueContext;
+	const XFER_BATCH_RANGE* range = &batchContext->Ranges[batchContext->SlotEntry[slotIndex]];
+	WDFREQUEST slotRequest = batchContext->Slots[slotIndex];
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+	WDF_REQUEST_SEND_OPTIONS sendOptions;
+	WDFMEMORY_OFFSET entryOfs;
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+	status = WdfRequestReuse(slotRequest, &reuseParams);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfRequestReuse failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	entryOfs.BufferOffset = range->Offset;
+	entryOfs.BufferLength = range->Length;
+
+	if (USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress))
+		status = WdfUsbTargetPipeFormatRequestForRead(queueContext->PipeHandle, slotRequest, batchContext->UserMem, &entryOfs);
+	else if (range->Length)
+		status = WdfUsbTargetPipeFormatRequestForWrite(queueContext->PipeHandle, slotRequest, batchContext->UserMem, &entryOfs);
+	else
+		status = WdfUsbTargetPipeFormatRequestForWrite(queueContext->PipeHandle, slotRequest, NULL, NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfUsbTargetPipeFormatRequest failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions, 0);
+	status = SetRequestTimeout(batchContext->RequestContext, slotRequest, &sendOptions);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("SetRequestTimeout failed. Status=%08Xh\n", status);
+		return status;
+	}
+
+	KTRACE_MSG(BATCH_ENTRY, queueContext->Info.EndpointAddress, batchContext->SlotEntry[slotIndex], range->Offset, range->Length);
+
+	return SubmitAsyncQueueRequest(queueContext, slotRequest, Xfer_BatchEntryComplete, &sendOptions, batchContext);
+}
+
+static VOID Xfer_BatchFinish(
+    __in WDFREQUEST Request)
+{
+	PXFER_BATCH_CONTEXT batchContext = GetXferBatchContext(Request);
+	NTSTATUS status = (NTSTATUS)batchContext->State.Status;
+
+	if (!NT_SUCCESS(status))
+		mXfer_HandlePipeResetScenariosForComplete(status, batchContext->QueueContext, batchContext->RequestContext);
+
+	KTRACE_DBG(BATCH_DONE, batchContext->QueueContext->Info.EndpointAddress,
+	           batchContext->State.EntryCount, batchContext->State.Transferred, status);
+
+	if (WdfRequestUnmarkCancelable(Request) == STATUS_CANCELLED)
+	{
+		// Xfer_BatchCancel has been (or is about to be) called; the last one out completes the request.
+		batchContext->CompleteStatus = status;
+		if (InterlockedDecrement(&batchContext->CompleteRefs) > 0)
+			return;
+	}
+
+	Xfer_CompleteRequest(Request, status, batchContext->State.Transferred);
+}
+
+static VOID Xfer_BatchAdvance(
+    __in WDFREQUEST Request)
+{
+	NTSTATUS			status;
+	PXFER_BATCH_CONTEXT	batchContext = GetXferBatchContext(Request);
+	XFER_BATCH*			batch = &batchContext->State;
+	XFER_BATCH_NEXT		next;
+	WDFREQUEST			cancelSlots[XFER_BATCH_MAX_IN_FLIGHT];
+	ULONG				cancelCount;
+	ULONG				slotIndex = 0;
+	unsigned int		entryIndex = 0;
+	BOOLEAN				isBusy = FALSE;
+
+	for (;;)
+	{
+		cancelCount = 0;
+
+		WdfSpinLockAcquire(batchContext->Lock);
+
+		if (isBusy)
+		{
+			batchContext->Busy--;
+			isBusy = FALSE;
+		}
+
+		// Failed or cancelled; transfers still in flight are cancelled.
+		if (batch->Stopping)
+		{
+			for (slotIndex = 0; slotIndex < batchContext->SlotCount; slotIndex++)
+			{
+				if (batchContext->SlotEntry[slotIndex] != XFER_BATCH_SLOT_FREE &&
+				        batchContext->SlotFlags[slotIndex] == XFER_STAGE_FLAG_SENT)
+				{
+					batchContext->SlotFlags[slotIndex] |= XFER_STAGE_FLAG_CANCELLED;
+					cancelSlots[cancelCount++] = batchContext->Slots[slotIndex];
+				}
+			}
+		}
+
+		if (cancelCount || batchContext->Busy)
+			next = XFER_BATCH_WAIT;
+		else
+			next = XferBatch_Next(batch, &entryIndex);
+
+		if (cancelCount || next == XFER_BATCH_SEND)
+		{
+			batchContext->Busy++;
+			isBusy = TRUE;
+		}
+		if (next == XFER_BATCH_SEND)
+		{
+			// InFlight never exceeds SlotCount; there is always a free slot.
+			for (slotIndex = 0; slotIndex < batchContext->SlotCount - 1; slotIndex++)
+			{
+				if (batchContext->SlotEntry[slotIndex] == XFER_BATCH_SLOT_FREE)
+					break;
+			}
+
+			batchContext->SlotEntry[slotIndex] = entryIndex;
+			batchContext->SlotFlags[slotIndex] = 0;
+		}
+
+		WdfSpinLockRelease(batchContext->Lock);
+
+		if (cancelCount)
+		{
+			while (cancelCount)
+				WdfRequestCancelSentRequest(cancelSlots[--cancelCount]);
+			continue;
+		}
+
+		if (next == XFER_BATCH_WAIT)
+			return;
+
+		if (next == XFER_BATCH_FINISHED)
+		{
+			Xfer_BatchFinish(Request);
+			return;
+		}
+
+		status = Xfer_BatchSendEntry(batchContext, slotIndex);
+
+		WdfSpinLockAcquire(batchContext->Lock);
+		if (NT_SUCCESS(status))
+		{
+			batchContext->SlotFlags[slotIndex] |= XFER_STAGE_FLAG_SENT;
+		}
+		else
+		{
+			batchContext->SlotEntry[slotIndex] = XFER_BATCH_SLOT_FREE;
+			XferBatch_EntryDone(batch, entryIndex, status, 0);
+		}
+		WdfSpinLockRelease(batchContext->Lock);
+	}
+}
+
+VOID Xfer_Batch(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request)
+{
+	NTSTATUS				status;
+	PREQUEST_CONTEXT		requestContext = GetRequestContext(Request);
+	PQUEUE_CONTEXT			queueContext = NULL;
+	PXFER_BATCH_CONTEXT		batchContext;
+	PXFER_BATCH_SLOT_CONTEXT slotContext;
+	WDF_OBJECT_ATTRIBUTES	attributes;
+	XFER_BATCH_ENTRY*		entries;
+	size_t					entriesSize;
+	WDFMEMORY				rangesMemory;
+	ULONG					entryCount;
+	unsigned int			badEntry;
+	ULONG					slotIndex;
+	BOOLEAN					isRead;
+
+	VALIDATE_REQUEST_CONTEXT(requestContext, status);
+	if (!NT_SUCCESS(status)) goto Exit;
+
+	if ((queueContext = GetQueueContext(Queue)) == NULL)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERRN("Invalid queue context");
+		goto Exit;
+	}
+
+	isRead = USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress) ? TRUE : FALSE;
+	if ((requestContext->IoControlCode == LIBUSBK_IOCTL_BATCH_READ) != isRead)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("PipeID=%02Xh Batch direction does not match the pipe.", queueContext->Info.EndpointAddress);
+		goto Exit;
+	}
+
+	if (!requestContext->Batch.EntriesMemory)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERR("NULL batch entries.\n");
+		goto Exit;
+	}
+
+	entryCount = requestContext->IoControlRequest.Batch.EntryCount;
+	entries = (XFER_BATCH_ENTRY*)WdfMemoryGetBuffer(requestContext->Batch.EntriesMemory, &entriesSize);
+	if (!entries || entriesSize < entryCount * sizeof(XFER_BATCH_ENTRY))
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERR("WdfMemoryGetBuffer failed. Invalid batch entries.\n");
+		goto Exit;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_BATCH_CONTEXT);
+	status = WdfObjectAllocateContext(Request, &attributes, (PVOID*)&batchContext);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfObjectAllocateContext failed. Status=%08Xh", status);
+		goto Exit;
+	}
+
+	// The descriptors stay writable by the application; validate and send from a copy.
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Request;
+	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, entryCount * sizeof(XFER_BATCH_RANGE), &rangesMemory, (PVOID*)&batchContext->Ranges);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfMemoryCreate failed. Status=%08Xh", status);
+		goto Exit;
+	}
+	XferBatch_Capture(batchContext->Ranges, entries, entryCount);
+
+	if (!XferBatch_Validate(batchContext->Ranges, entryCount, requestContext->Length, isRead,
+	                        queueContext->Info.MaximumPacketSize, queueContext->Info.MaximumTransferSize, &badEntry))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("PipeID=%02Xh Invalid batch entry %u of %u. BufferLength=%u MaximumPacketSize=%u MaximumTransferSize=%u",
+		        queueContext->Info.EndpointAddress, badEntry, entryCount, requestContext->Length,
+		        queueContext->Info.MaximumPacketSize, queueContext->Info.MaximumTransferSize);
+		goto Exit;
+	}
+
+	batchContext->QueueContext		= queueContext;
+	batchContext->RequestContext	= requestContext;
+	batchContext->CompleteStatus	= STATUS_SUCCESS;
+	batchContext->CompleteRefs		= 2;
+
+	if (requestContext->Length)
+	{
+		status = GetTransferMemory(Request, requestContext->ActualRequestType, &batchContext->UserMem);
+		if (!NT_SUCCESS(status))
+		{
+			USBERR("GetTransferMemory failed. Status=%08Xh\n", status);
+			goto Exit;
+		}
+	}
+
+	// Everything below is parented to the batch request and deleted with it.
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Request;
+	status = WdfSpinLockCreate(&attributes, &batchContext->Lock);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfSpinLockCreate failed. Status=%08Xh", status);
+		goto Exit;
+	}
+
+	XferBatch_Begin(&batchContext->State, batchContext->Ranges, entries, entryCount, XFER_BATCH_MAX_IN_FLIGHT);
+	batchContext->SlotCount = min(entryCount, batchContext->State.MaxInFlight);
+
+	for (slotIndex = 0; slotIndex < batchContext->SlotCount; slotIndex++)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_BATCH_SLOT_CONTEXT);
+		attributes.ParentObject = Request;
+
+		status = WdfRequestCreate(&attributes,
+		                          WdfUsbTargetPipeGetIoTarget(queueContext->PipeHandle),
+		                          &batchContext->Slots[slotIndex]);
+		if (!NT_SUCCESS(status))
+		{
+			USBERRN("WdfRequestCreate failed. Status=%08Xh", status);
+			goto Exit;
+		}
+
+		slotContext = GetXferBatchSlotContext(batchContext->Slots[slotIndex]);
+		slotContext->MainRequest	= Request;
+		slotContext->SlotIndex		= slotIndex;
+
+		batchContext->SlotEntry[slotIndex] = XFER_BATCH_SLOT_FREE;
+	}
+
+	mXfer_HandlePipeResetScenarios(status, queueContext, requestContext);
+
+	status = WdfRequestMarkCancelableEx(Request, Xfer_BatchCancel);
+	if (!NT_SUCCESS(status))
+	{
+		USBWRNN("WdfRequestMarkCancelableEx failed. Status=%08Xh", status);
+		goto Exit;
 	}
-	WdfRequestCompleteWithInformation(Request, status, length);
+
+	KTRACE_MSG(BATCH_START, queueContext->Info.EndpointAddress, entryCount, requestContext->Length, batchContext->SlotCount);
+
+	Xfer_BatchAdvance(Request);
+	return;
+
+Exit:
+	Xfer_CompleteRequest(Request, status, 0);
+}
+
+VOID Xfer_BatchEntryComplete(
+    __in WDFREQUEST Request,
+    __in WDFIOTARGET Target,
+    __in PWDF_REQUEST_COMPLETION_PARAMS CompletionParams,
+    __in WDFCONTEXT Context)
+{
+	NTSTATUS status;
+	PXFER_BATCH_CONTEXT batchContext = (PXFER_BATCH_CONTEXT)Context;
+	PXFER_BATCH_SLOT_CONTEXT slotContext = GetXferBatchSlotContext(Request);
+	PWDF_USB_REQUEST_COMPLETION_PARAMS usbCompletionParams;
+	ULONG transferredLength = 0;
+	ULONG entryIndex;
+
+	UNREFERENCED_PARAMETER(Target);
+
+	status				= CompletionParams->IoStatus.Status;
+	usbCompletionParams = CompletionParams->Parameters.Usb.Completion;
+
+	if (usbCompletionParams)
+	{
+		transferredLength = (ULONG)(USB_ENDPOINT_DIRECTION_IN(batchContext->QueueContext->Info.EndpointAddress)
+		                            ? usbCompletionParams->Parameters.PipeRead.Length
+		                            : usbCompletionParams->Parameters.PipeWrite.Length);
+	}
+
+	Xfer_CheckPipeStatus(status, batchContext->QueueContext->Info.EndpointAddress);
+
+	WdfSpinLockAcquire(batchContext->Lock);
+	entryIndex = batchContext->SlotEntry[slotContext->SlotIndex];
+	batchContext->SlotEntry[slotContext->SlotIndex] = XFER_BATCH_SLOT_FREE;
+	XferBatch_EntryDone(&batchContext->State, entryIndex, status, transferredLength);
+	WdfSpinLockRelease(batchContext->Lock);
+
+	Xfer_BatchAdvance(slotContext->MainRequest);
+}
+
+VOID Xfer_BatchCancel(
+    __in WDFREQUEST Request)
+{
+	PXFER_BATCH_CONTEXT batchContext = GetXferBatchContext(Request);
+
+	USBWRNN("[Cancelled] PipeID=%02Xh batch request=%p", batchContext->QueueContext->Info.EndpointAddress, Request);
+
+	WdfSpinLockAcquire(batchContext->Lock);
+	XferBatch_Abort(&batchContext->State, STATUS_CANCELLED);
+	WdfSpinLockRelease(batchContext->Lock);
+
+	Xfer_BatchAdvance(Request);
+
+	if (InterlockedDecrement(&batchContext->CompleteRefs) == 0)
+		Xfer_CompleteRequest(Request, batchContext->CompleteStatus, batchContext->State.Transferred);
 }
@@ -51,8 +51,25 @@ typedef enum _USB_DESCRIPTOR_TYPE
 
 EVT_WDF_REQUEST_COMPLETION_ROUTINE XferCtrlComplete;
 
-#if (defined(ALLOC_PRAGMA) && defined(PAGING_ENABLED))
+// The public CONTROL_RESPONSE_CACHE flags are the drv_ctrl_cache.h request classes.
+C_ASSERT(CONTROL_CACHE_STANDARD == CTRL_CACHE_STANDARD);
+C_ASSERT(CONTROL_CACHE_CLASS == CTRL_CACHE_CLASS);
+C_ASSERT(CONTROL_CACHE_VENDOR == CTRL_CACHE_VENDOR);
+
+static BOOLEAN XferCtrl_CacheBegin(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request,
+    __in PREQUEST_CONTEXT requestContext,
+    __in PWDF_USB_CONTROL_SETUP_PACKET setupPacket);
+
+static VOID XferCtrl_CacheInsert(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request,
+    __in ULONG length);
 
+#if (defined(ALLOC_PRAGMA) && defined(PAGING_ENABLED))
+#pragma alloc_text(PAGE, XferCtrl_InitCache)
+#pragma alloc_text(PAGE, XferCtrl_SetCachePolicy)
 #endif
 
 VOID XferCtrl (
@@ -144,6 +161,10 @@ VOID XferCtrl (
 		}
 	}
 
+	// Serve (or apply the invalidation rules of) this request with the control response cache.
+	if (XferCtrl_CacheBegin(deviceContext, Request, requestContext, setupPacket))
+		return;
+
 	if (METHOD_FROM_CTL_CODE(requestContext->IoControlCode) == METHOD_BUFFERED &&
 	        requestContext->RequestType == WdfRequestTypeWrite)
 	{
@@ -212,7 +233,7 @@ VOID XferCtrl (
 
 	WdfRequestSetCompletionRoutine(Request,
 	                               XferCtrlComplete,
-	                               NULL);
+	                               requestContext->Control.CacheClass ? deviceContext : NULL);
 
 	WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions, 0);
 	status = SetRequestTimeout(requestContext, Request, &sendOptions);
@@ -255,11 +276,15 @@ VOID XferCtrlComplete(__in WDFREQUEST Request,
 	ULONG length = usbCompletionParams->Parameters.DeviceControlTransfer.Length;
 
 	UNREFERENCED_PARAMETER(Target);
-	UNREFERENCED_PARAMETER(Context);
 
 	if (NT_SUCCESS(status))
 	{
 		USBMSGN("[Ok] transferred=%u", length);
+
+		// Context is the device context of a cacheable request.
+		if (Context)
+			XferCtrl_CacheInsert((PDEVICE_CONTEXT)Context, Request, length);
+
 		WdfRequestCompleteWithInformation(Request, status, length);
 
 	}
@@ -269,3 +294,178 @@ VOID XferCtrlComplete(__in WDFREQUEST Request,
 		WdfRequestComplete(Request, status);
 	}
 }
+
+//////////////////////////////////////////////////////////////////////////////
+// Control response cache (CONTROL_RESPONSE_CACHE). See drv_ctrl_cache.h.
+//
+
+NTSTATUS XferCtrl_InitCache(
+    __in PDEVICE_CONTEXT deviceContext)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+
+	PAGED_CODE();
+
+	// Disabled until the policy is set; no arena yet.
+	CtrlCache_Init(&deviceContext->CtrlCache, NULL, 0);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = deviceContext->WdfDevice;
+	status = WdfSpinLockCreate(&attributes, &deviceContext->CtrlCacheLock);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfSpinLockCreate failed. Status=%08Xh", status);
+		deviceContext->CtrlCacheLock = NULL;
+	}
+	return status;
+}
+
+NTSTATUS XferCtrl_SetCachePolicy(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in ULONG flags)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY arenaMemory;
+	PVOID arena;
+
+	PAGED_CODE();
+
+	if (flags & ~((ULONG)CTRL_CACHE_ALL))
+	{
+		USBERRN("Invalid CONTROL_RESPONSE_CACHE flags %08Xh.", flags);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (!deviceContext->CtrlCacheLock)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	if (flags && !deviceContext->CtrlCacheArena)
+	{
+		// Kept for the life of the device once the cache has been used.
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = deviceContext->WdfDevice;
+		status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, CTRL_CACHE_ARENA_SIZE, &arenaMemory, &arena);
+		if (!NT_SUCCESS(status))
+		{
+			USBERRN("WdfMemoryCreate failed. Status=%08Xh", status);
+			return status;
+		}
+
+		WdfSpinLockAcquire(deviceContext->CtrlCacheLock);
+		CtrlCache_Init(&deviceContext->CtrlCache, (unsigned char*)arena, CTRL_CACHE_ARENA_SIZE);
+		WdfSpinLockRelease(deviceContext->CtrlCacheLock);
+
+		deviceContext->CtrlCacheArena = arenaMemory;
+	}
+
+	WdfSpinLockAcquire(deviceContext->CtrlCacheLock);
+	CtrlCache_SetFlags(&deviceContext->CtrlCache, flags);
+	WdfSpinLockRelease(deviceContext->CtrlCacheLock);
+
+	USBMSGN("CONTROL_RESPONSE_CACHE=%02Xh", flags);
+	return STATUS_SUCCESS;
+}
+
+VOID XferCtrl_InvalidateCache(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in ULONG classes)
+{
+	// Flags is only a hint here; it is checked again under the lock.
+	if (!deviceContext->CtrlCacheLock || !deviceContext->CtrlCache.Flags)
+		return;
+
+	WdfSpinLockAcquire(deviceContext->CtrlCacheLock);
+	CtrlCache_Invalidate(&deviceContext->CtrlCache, classes);
+	WdfSpinLockRelease(deviceContext->CtrlCacheLock);
+}
+
+static VOID XferCtrl_GetCacheKey(
+    __in PWDF_USB_CONTROL_SETUP_PACKET setupPacket,
+    __out CTRL_CACHE_KEY* key)
+{
+	key->RequestType	= setupPacket->Packet.bm.Byte;
+	key->Request		= setupPacket->Packet.bRequest;
+	key->Value			= setupPacket->Packet.wValue.Value;
+	key->Index			= setupPacket->Packet.wIndex.Value;
+	key->Length			= setupPacket->Packet.wLength;
+}
+
+// Returns TRUE if the request was completed from the cache. Otherwise marks
+// the request for XferCtrl_CacheInsert when its response may be cached.
+static BOOLEAN XferCtrl_CacheBegin(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request,
+    __in PREQUEST_CONTEXT requestContext,
+    __in PWDF_USB_CONTROL_SETUP_PACKET setupPacket)
+{
+	NTSTATUS status;
+	CTRL_CACHE_KEY key;
+	PVOID outputBuffer = NULL;
+	size_t outputBufferLength = 0;
+	unsigned int length = 0;
+	BOOLEAN hit = FALSE;
+
+	requestContext->Control.CacheClass = 0;
+
+	if (!deviceContext->CtrlCacheLock || !deviceContext->CtrlCache.Flags)
+		return FALSE;
+
+	XferCtrl_GetCacheKey(setupPacket, &key);
+
+	// Responses are only cached when the whole of wLength fits in the buffer.
+	if (setupPacket->Packet.bm.Request.Dir == BMREQUEST_DEVICE_TO_HOST && key.Length)
+	{
+		status = WdfRequestRetrieveOutputBuffer(Request, key.Length, &outputBuffer, &outputBufferLength);
+		if (!NT_SUCCESS(status))
+			outputBuffer = NULL;
+	}
+
+	WdfSpinLockAcquire(deviceContext->CtrlCacheLock);
+
+	CtrlCache_OnSetup(&deviceContext->CtrlCache, &key);
+
+	if (outputBuffer && CtrlCache_Classify(&deviceContext->CtrlCache, &key))
+	{
+		hit = CtrlCache_Lookup(&deviceContext->CtrlCache, &key, (unsigned char*)outputBuffer, (unsigned int)outputBufferLength, &length) ? TRUE : FALSE;
+		if (!hit)
+		{
+			requestContext->Control.CacheClass = CtrlCache_Classify(&deviceContext->CtrlCache, &key);
+			requestContext->Control.CacheGeneration = deviceContext->CtrlCache.Generation;
+		}
+	}
+
+	WdfSpinLockRelease(deviceContext->CtrlCacheLock);
+
+	if (hit)
+	{
+		KTRACE_DBG(CTRL_CACHE_HIT, key.RequestType, key.Request, key.Value, length);
+		WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, length);
+	}
+	return hit;
+}
+
+static VOID XferCtrl_CacheInsert(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request,
+    __in ULONG length)
+{
+	NTSTATUS status;
+	PREQUEST_CONTEXT requestContext = GetRequestContext(Request);
+	CTRL_CACHE_KEY key;
+	PVOID outputBuffer;
+	size_t outputBufferLength;
+
+	status = WdfRequestRetrieveOutputBuffer(Request, 1, &outputBuffer, &outputBufferLength);
+	if (!NT_SUCCESS(status))
+		return;
+
+	XferCtrl_GetCacheKey((PWDF_USB_CONTROL_SETUP_PACKET)&requestContext->IoControlRequest.control, &key);
+	if (length > outputBufferLength)
+		length = (ULONG)outputBufferLength;
+
+	WdfSpinLockAcquire(deviceContext->CtrlCacheLock);
+	CtrlCache_Insert(&deviceContext->CtrlCache, requestContext->Control.CacheGeneration, &key, (const unsigned char*)outputBuffer, length);
+	WdfSpinLockRelease(deviceContext->CtrlCacheLock);
+}
@@ -0,0 +1,237 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_common.h"
+
+/*
+* Completion queue. (LIBUSBK_IOCTL_REGISTER_CQUEUE)
+*
+* A handle registers one completion queue (see lusbk_cqueue.h) by sending
+* LIBUSBK_IOCTL_REGISTER_CQUEUE. The request stays pending in CQueueQueue for
+* as long as the queue is registered; the queue buffer is locked and the
+* event referenced by the request (CQUEUE_REGISTRATION) and both are released
+* when it completes. Cancelling the request or closing the handle unregisters
+* the queue.
+*
+* While registered, Xfer_CompleteRequest posts every transfer completed on the
+* handle before completing it, so the file context outlives every post.
+*/
+
+EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE Xfer_CQueueCanceled;
+EVT_WDF_OBJECT_CONTEXT_CLEANUP Xfer_CQueueCleanup;
+
+NTSTATUS Xfer_InitCQueue(
+    __in PDEVICE_CONTEXT deviceContext)
+{
+	NTSTATUS status;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+	queueConfig.PowerManaged = WdfFalse;
+	queueConfig.EvtIoCanceledOnQueue = Xfer_CQueueCanceled;
+
+	status = WdfIoQueueCreate(deviceContext->WdfDevice, &queueConfig, WDF_NO_OBJECT_ATTRIBUTES, &deviceContext->CQueueQueue);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfIoQueueCreate failed. Status=%08Xh", status);
+		deviceContext->CQueueQueue = NULL;
+	}
+
+	return status;
+}
+
+// Called from Request_PreIoInitialize in the context of the registering process.
+NTSTATUS Xfer_PrepareCQueue(
+    __in WDFREQUEST Request,
+    __in libusb_request* libusbRequest)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PCQUEUE_REGISTRATION registration;
+
+	if (libusbRequest->CQueue.BufferLength < KCQ_BUFFER_SIZE(KCQ_MIN_RECORDS) ||
+	        libusbRequest->CQueue.BufferLength > KCQ_BUFFER_SIZE(KCQ_MAX_RECORDS))
+	{
+		USBERRN("Invalid completion queue BufferLength=%u", libusbRequest->CQueue.BufferLength);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, CQUEUE_REGISTRATION);
+	attributes.EvtCleanupCallback = Xfer_CQueueCleanup;
+	status = WdfObjectAllocateContext(Request, &attributes, (PVOID*)&registration);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfObjectAllocateContext failed. Status=%08Xh", status);
+		return status;
+	}
+
+	status = WdfRequestProbeAndLockUserBufferForWrite(Request, libusbRequest->CQueue.Buffer, libusbRequest->CQueue.BufferLength, &registration->BufferMemory);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfRequestProbeAndLockUserBufferForWrite failed. Status=%08Xh", status);
+		return status;
+	}
+
+	status = ObReferenceObjectByHandle(libusbRequest->CQueue.Event, EVENT_MODIFY_STATE, *ExEventObjectType,
+	                                   WdfRequestGetRequestorMode(Request), (PVOID*)&registration->Event, NULL);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("ObReferenceObjectByHandle failed. Status=%08Xh", status);
+		registration->Event = NULL;
+		return status;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID Xfer_CQueueCleanup(__in WDFOBJECT Object)
+{
+	PCQUEUE_REGISTRATION registration = GetCQueueRegistration(Object);
+
+	if (registration && registration->Event)
+	{
+		ObDereferenceObject(registration->Event);
+		registration->Event = NULL;
+	}
+}
+
+// Detaches the queue registered by Request from its handle.
+static VOID Xfer_DetachCQueue(__in WDFREQUEST Request)
+{
+	PFILE_CONTEXT fileContext = GetFileContext(WdfRequestGetFileObject(Request));
+	PCQUEUE_REGISTRATION registration = GetCQueueRegistration(Request);
+
+	WdfSpinLockAcquire(fileContext->CQueue.Lock);
+	if (fileContext->CQueue.Event == registration->Event)
+	{
+		KTRACE_MSG(CQUEUE_STOP, fileContext->CQueue.Producer.Mask + 1, fileContext->CQueue.Producer.Head);
+		fileContext->CQueue.Event = NULL;
+		RtlZeroMemory(&fileContext->CQueue.Producer, sizeof(fileContext->CQueue.Producer));
+	}
+	WdfSpinLockRelease(fileContext->CQueue.Lock);
+}
+
+VOID Xfer_RegisterCQueue(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFREQUEST Request)
+{
+	NTSTATUS status;
+	PFILE_CONTEXT fileContext;
+	PCQUEUE_REGISTRATION registration;
+	KCQ_PRODUCER producer;
+	PVOID buffer;
+	size_t bufferSize;
+
+	fileContext = GetFileContext(WdfRequestGetFileObject(Request));
+	registration = GetCQueueRegistration(Request);
+	if (!fileContext || !fileContext->CQueue.Lock || !registration || !registration->Event)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERRN("Completion queue was not prepared. Status=%08Xh", status);
+		goto Done;
+	}
+
+	buffer = WdfMemoryGetBuffer(registration->BufferMemory, &bufferSize);
+	if (!CQueue_InitProducer(&producer, buffer, (unsigned int)bufferSize))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		USBERRN("Invalid completion queue header. BufferLength=%u", (ULONG)bufferSize);
+		goto Done;
+	}
+
+	WdfSpinLockAcquire(fileContext->CQueue.Lock);
+	if (fileContext->CQueue.Event)
+	{
+		status = STATUS_DEVICE_BUSY;
+	}
+	else
+	{
+		status = STATUS_SUCCESS;
+		fileContext->CQueue.Producer = producer;
+		fileContext->CQueue.Event = registration->Event;
+	}
+	WdfSpinLockRelease(fileContext->CQueue.Lock);
+
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("A completion queue is already registered on this handle.");
+		goto Done;
+	}
+
+	status = WdfRequestForwardToIoQueue(Request, deviceContext->CQueueQueue);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfRequestForwardToIoQueue failed. Status=%08Xh", status);
+		Xfer_DetachCQueue(Request);
+		goto Done;
+	}
+
+	KTRACE_MSG(CQUEUE_START, producer.Mask + 1);
+	return;
+
+Done:
+	WdfRequestCompleteWithInformation(Request, status, 0);
+}
+
+VOID Xfer_CQueueCanceled(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Queue);
+
+	Xfer_DetachCQueue(Request);
+	WdfRequestCompleteWithInformation(Request, STATUS_CANCELLED, 0);
+}
+
+// Called when the handle is cleaned up.
+VOID Xfer_UnregisterCQueue(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in WDFFILEOBJECT FileObject)
+{
+	WDFREQUEST request;
+
+	if (!deviceContext->CQueueQueue) return;
+
+	while (NT_SUCCESS(WdfIoQueueRetrieveRequestByFileObject(deviceContext->CQueueQueue, FileObject, &request)))
+	{
+		Xfer_DetachCQueue(request);
+		WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, 0);
+	}
+}
+
+VOID Xfer_PostCQueue(
+    __in PFILE_CONTEXT fileContext,
+    __in WDFREQUEST Request,
+    __in NTSTATUS status,
+    __in ULONG_PTR transferred)
+{
+	PIRP irp = WdfRequestWdmGetIrp(Request);
+	int result;
+
+	// Records are tagged with the address of the caller's OVERLAPPED; its IO_STATUS_BLOCK is the first member.
+	// The event is signalled under the lock; the registration request (and the event reference) can not
+	// complete until Xfer_DetachCQueue has acquired it.
+	WdfSpinLockAcquire(fileContext->CQueue.Lock);
+	if (fileContext->CQueue.Event)
+	{
+		result = CQueue_Post(&fileContext->CQueue.Producer, (unsigned long long)(ULONG_PTR)irp->UserIosb, (int)status, (unsigned int)transferred);
+		if (result & KCQ_POST_WAKE)
+			KeSetEvent(fileContext->CQueue.Event, IO_NO_INCREMENT, FALSE);
+	}
+	WdfSpinLockRelease(fileContext->CQueue.Lock);
+}
@@ -52,22 +52,6 @@ const USHORT Frames_Per_bInterval_FullSpeed[32] =
 		mUrb->UrbIsochronousTransfer.TransferFlags        = mTransferFlags;   														\
 	}while(0) 																														\
  
-#define mXfer_IsoPacketsToUrb(mIsoPacketArray,mUrb,mNumberOfPackets,mDataLength,mErrorAction) do {  	\
-		LONG mPos; 																							\
-		for (mPos = 0; mPos < (LONG)mNumberOfPackets; mPos++)  												\
-		{  																									\
-			if (mIsoPacketArray[mPos].Offset >= mDataLength)   												\
-			{  																								\
-				status = STATUS_INVALID_BUFFER_SIZE;   														\
-				USBERRN("Last packet offset references data that is out-of-range. IsoPacket[%u].Offset=%u",	\
-				        mPos, mIsoPacketArray[mPos].Offset);   												\
-				mErrorAction; 																				\
-			}  																								\
-			(mUrb)->UrbIsochronousTransfer.IsoPacket[mPos].Offset = mIsoPacketArray[mPos].Offset;  			\
-		}  																									\
-	}while(0)
-
-
 #define mXfer_IsoCheckInitNextFrameNumber(mStatus, mWdfUsbTargetDevice, mRequestContext, mIsHS, mOut_UseNextStartFrame) do { 				\
 		if (mRequestContext->QueueContext->IsFreshPipeReset) 																					\
 		{																																		\
@@ -113,6 +97,9 @@ const USHORT Frames_Per_bInterval_FullSpeed[32] =
 		}   																											\
 	}while(0)
 
+C_ASSERT(sizeof(ISO_URB_PACKET) == sizeof(USBD_ISO_PACKET_DESCRIPTOR));
+C_ASSERT(sizeof(ISO_USER_PACKET) == sizeof(KISO_PACKET));
+
 //
 // Required for doing ISOCH transfer. This context is associated with every
 // subrequest created by the driver to do ISOCH transfer.
@@ -149,6 +136,233 @@ EVT_WDF_REQUEST_COMPLETION_ROUTINE XferIsoRdComplete;
 */
 EVT_WDF_REQUEST_COMPLETION_ROUTINE XferIsoExComplete;
 
+/*
+* ISO completion callback for "advanced" ISO transfers that use the pipe packet template.
+* IE: Transfers completed from "UsbK_IsoReadPipe" or UsbK_IsoWritePipe" with a NULL IsoContext.
+*/
+EVT_WDF_REQUEST_COMPLETION_ROUTINE XferAutoIsoExComplete;
+
+/*
+* Per pipe URB pool.
+*
+* Iso pipe queues preallocate XFER_URB_POOL_BLOCKS URBs large enough for a
+* MaximumTransferSize transfer when they are created. Pooled URB memory is
+* wrapped with WdfMemoryCreatePreallocated and parented to the request as
+* before; its cleanup callback puts the block back. Each pooled URB holds a
+* reference on the pool memory, so a queue can be deleted while the last of
+* its URBs are being cleaned up. The pool lock is a child of the pool memory.
+*
+* Hits, misses and the peak blocks in use are also added to the pipe
+* counters (KPIPE_STATS), which outlive the queue.
+*/
+#define XFER_URB_POOL_BLOCKS	8
+
+typedef struct _XFER_URB_POOL_CONTEXT
+{
+	WDFSPINLOCK	Lock;
+	MEM_POOL	Pool;	// [Lock]
+	UCHAR		PipeID;
+} XFER_URB_POOL_CONTEXT, *PXFER_URB_POOL_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_URB_POOL_CONTEXT, GetXferUrbPoolContext)
+
+typedef struct _XFER_URB_BLOCK_CONTEXT
+{
+	WDFMEMORY	UrbPool;
+	PVOID		Block;
+} XFER_URB_BLOCK_CONTEXT, *PXFER_URB_BLOCK_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_URB_BLOCK_CONTEXT, GetXferUrbBlockContext)
+
+EVT_WDF_OBJECT_CONTEXT_DESTROY XferIso_UrbPoolDestroy;
+EVT_WDF_OBJECT_CONTEXT_CLEANUP XferIso_UrbBlockCleanup;
+
+NTSTATUS Xfer_InitUrbPool(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PXFER_URB_POOL_CONTEXT poolContext;
+	PVOID storage;
+	ULONG blockSize;
+
+	blockSize = GET_ISO_URB_SIZE(queueContext->Info.MaximumTransferSize / queueContext->Info.MaximumPacketSize);
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_URB_POOL_CONTEXT);
+	attributes.ParentObject = Queue;
+	attributes.EvtDestroyCallback = XferIso_UrbPoolDestroy;
+
+	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG,
+	                         MemPool_StorageSize(blockSize, XFER_URB_POOL_BLOCKS),
+	                         &queueContext->UrbPool, &storage);
+	if (!NT_SUCCESS(status))
+	{
+		queueContext->UrbPool = NULL;
+		USBERRN("WdfMemoryCreate failed. status=%08Xh", status);
+		return status;
+	}
+
+	poolContext = GetXferUrbPoolContext(queueContext->UrbPool);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = queueContext->UrbPool;
+	status = WdfSpinLockCreate(&attributes, &poolContext->Lock);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfSpinLockCreate failed. status=%08Xh", status);
+		WdfObjectDelete(queueContext->UrbPool);
+		queueContext->UrbPool = NULL;
+		return status;
+	}
+
+	MemPool_Init(&poolContext->Pool, storage, blockSize, XFER_URB_POOL_BLOCKS);
+	poolContext->PipeID = queueContext->Info.EndpointAddress;
+
+	USBDBGN("PipeID=%02Xh Blocks=%u BlockSize=%u",
+	        poolContext->PipeID, poolContext->Pool.BlockCount, poolContext->Pool.BlockSize);
+
+	return status;
+}
+
+VOID XferIso_UrbPoolDestroy(__in WDFOBJECT Object)
+{
+	PXFER_URB_POOL_CONTEXT poolContext = GetXferUrbPoolContext(Object);
+
+	USBDBGN("PipeID=%02Xh Hits=%u Misses=%u PeakInUse=%u",
+	        poolContext->PipeID, poolContext->Pool.Stats.Hits, poolContext->Pool.Stats.Misses, poolContext->Pool.Stats.PeakInUse);
+}
+
+VOID XferIso_UrbBlockCleanup(__in WDFOBJECT Object)
+{
+	PXFER_URB_BLOCK_CONTEXT blockContext = GetXferUrbBlockContext(Object);
+	PXFER_URB_POOL_CONTEXT poolContext;
+
+	if (!blockContext->UrbPool)
+		return;
+
+	poolContext = GetXferUrbPoolContext(blockContext->UrbPool);
+	ASSERT(MemPool_Owns(&poolContext->Pool, blockContext->Block));
+
+	WdfSpinLockAcquire(poolContext->Lock);
+	MemPool_Free(&poolContext->Pool, blockContext->Block);
+	WdfSpinLockRelease(poolContext->Lock);
+
+	WdfObjectDereference(blockContext->UrbPool);
+	blockContext->UrbPool = NULL;
+}
+
+/*
+* Creates the URB memory for an iso request; parented to the request.
+* Uses the pipe URB pool when it has a free block large enough.
+*/
+static NTSTATUS XferIso_CreateUrbMemory(
+    __in PQUEUE_CONTEXT queueContext,
+    __in WDFREQUEST Request,
+    __in ULONG urbSize,
+    __out WDFMEMORY* urbMemory,
+    __out PURB* urb)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PXFER_URB_POOL_CONTEXT poolContext = NULL;
+	PXFER_URB_BLOCK_CONTEXT blockContext;
+	PVOID block = NULL;
+	PPIPE_STATS_COUNTERS stats;
+	LONG inUse, peak;
+
+	if (queueContext->UrbPool)
+	{
+		poolContext = GetXferUrbPoolContext(queueContext->UrbPool);
+
+		WdfSpinLockAcquire(poolContext->Lock);
+		block = MemPool_Alloc(&poolContext->Pool, urbSize);
+		inUse = (LONG)poolContext->Pool.InUse;
+		WdfSpinLockRelease(poolContext->Lock);
+
+		if (queueContext->PipeContext)
+		{
+			stats = &queueContext->PipeContext->Stats;
+			InterlockedIncrement(block ? &stats->UrbPoolHits : &stats->UrbPoolMisses);
+			do
+			{
+				peak = stats->UrbPoolPeakInUse;
+				if (inUse <= peak) break;
+			}
+			while (InterlockedCompareExchange(&stats->UrbPoolPeakInUse, inUse, peak) != peak);
+		}
+	}
+
+	if (block)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_URB_BLOCK_CONTEXT);
+		attributes.ParentObject = Request;
+		attributes.EvtCleanupCallback = XferIso_UrbBlockCleanup;
+
+		status = WdfMemoryCreatePreallocated(&attributes, block, urbSize, urbMemory);
+		if (NT_SUCCESS(status))
+		{
+			WdfObjectReference(queueContext->UrbPool);
+
+			blockContext = GetXferUrbBlockContext(*urbMemory);
+			blockContext->UrbPool = queueContext->UrbPool;
+			blockContext->Block = block;
+
+			*urb = (PURB)block;
+			return status;
+		}
+
+		USBWRNN("WdfMemoryCreatePreallocated failed. Status=%08Xh", status);
+
+		WdfSpinLockAcquire(poolContext->Lock);
+		MemPool_Free(&poolContext->Pool, block);
+		WdfSpinLockRelease(poolContext->Lock);
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Request;
+	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, urbSize, urbMemory, (PVOID*)urb);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfMemoryCreate failed. size=%u Status=%08Xh\n", urbSize, status);
+	}
+
+	return status;
+}
+
+/*
+* Sets the URB start frame from the pipe queue frame counter, or falls back to ASAP.
+* Returns the status of the current frame number request, if one was made.
+*/
+static NTSTATUS XferIso_SetNextStartFrame(
+    __in PDEVICE_CONTEXT deviceContext,
+    __in PREQUEST_CONTEXT requestContext,
+    __in PQUEUE_CONTEXT queueContext,
+    __in PURB urb,
+    __in BOOLEAN isHS)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	USHORT framesPerPacket;
+	BOOLEAN useNextStartFrame;
+
+	// Set the start frame (and latency if the pipe was freshly reset)
+	useNextStartFrame = requestContext->Policies.IsoAlwaysStartAsap ? FALSE : TRUE;
+	if (useNextStartFrame)
+	{
+		mXfer_IsoCheckInitNextFrameNumber(status, deviceContext->WdfUsbTargetDevice, requestContext, isHS, useNextStartFrame);
+	}
+	if (useNextStartFrame)
+	{
+		framesPerPacket = 0;
+		mXfer_IsoAssignNextFrameNumber(urb, queueContext, isHS, framesPerPacket);
+	}
+	else
+	{
+		// Either the user has specified to use ASAP or the request for the frame number failed.
+		urb->UrbIsochronousTransfer.TransferFlags |= USBD_START_ISO_TRANSFER_ASAP;
+	}
+
+	return status;
+}
+
 /*
 * ISO submit transfer function for "advanced" ISO transfers.
 * IE: Transfers submitted with "UsbK_IsoReadPipe" or UsbK_IsoWritePipe"
@@ -161,16 +375,14 @@ VOID XferIsoEx(__in WDFQUEUE Queue,
 	PREQUEST_CONTEXT requestContext;
 	PKISO_CONTEXT isoContext;
 	size_t isoContextSize;
-	WDF_OBJECT_ATTRIBUTES attributes;
 	PURB urb;
 	PMDL mdl;
 	ULONG urbSize;
 	USBD_PIPE_HANDLE usbdPipeHandle;
 	PQUEUE_CONTEXT queueContext;
+	INT errorIndex;
 
 	BOOLEAN isHS;
-	USHORT framesPerPacket;
-	BOOLEAN useNextStartFrame;
 
 	// Local vars pre-initialization //////////////////////////////////
 	requestContext = GetRequestContext(Request);
@@ -234,14 +446,9 @@ VOID XferIsoEx(__in WDFQUEUE Queue,
 		goto Exit;
 	}
 	// Allocate URB memory 	///////////////////////////////////////////
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = Request;
-	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, urbSize, &requestContext->IsoEx.UrbMemory, &urb);
+	status = XferIso_CreateUrbMemory(queueContext, Request, urbSize, &requestContext->IsoEx.UrbMemory, &urb);
 	if (!NT_SUCCESS(status))
-	{
-		USBERR("WdfMemoryCreate failed. size=%u Status=%08Xh\n", urbSize, status);
 		goto Exit;
-	}
 	///////////////////////////////////////////////////////////////////
 
 	// handle pipe reset scenarios: ResetPipeOnResume, AutoClearStall
@@ -265,27 +472,24 @@ VOID XferIsoEx(__in WDFQUEUE Queue,
 	///////////////////////////////////////////////////////////////////
 
 	// Init URB iso packets ///////////////////////////////////////////
-	mXfer_IsoPacketsToUrb(isoContext->IsoPackets, urb, isoContext->NumberOfPackets, requestContext->Length, goto Exit);
+	if (IsoPackets_BuildUrbTable(
+	            (const ISO_USER_PACKET*)isoContext->IsoPackets,
+	            isoContext->NumberOfPackets,
+	            0,
+	            requestContext->Length,
+	            (ISO_URB_PACKET*)urb->UrbIsochronousTransfer.IsoPacket,
+	            &errorIndex) != ISO_PACKETS_SUCCESS)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		USBERRN("Last packet offset references data that is out-of-range. IsoPacket[%d].Offset=%u",
+		        errorIndex, isoContext->IsoPackets[errorIndex].Offset);
+		goto Exit;
+	}
 	///////////////////////////////////////////////////////////////////
 
 	if (!(isoContext->Flags & KISO_FLAG_SET_START_FRAME))
 	{
-		// Set the start frame (and latency if the pipe was freshly reset)
-		useNextStartFrame = requestContext->Policies.IsoAlwaysStartAsap ? FALSE : TRUE;
-		if (useNextStartFrame)
-		{
-			mXfer_IsoCheckInitNextFrameNumber(status, deviceContext->WdfUsbTargetDevice, requestContext, isHS, useNextStartFrame);
-		}
-		if (useNextStartFrame)
-		{
-			framesPerPacket = 0;
-			mXfer_IsoAssignNextFrameNumber(urb, queueContext, isHS, framesPerPacket);
-		}
-		else
-		{
-			// Either the user has specified to use ASAP or the request for the frame number failed.
-			urb->UrbIsochronousTransfer.TransferFlags |= USBD_START_ISO_TRANSFER_ASAP;
-		}
+		XferIso_SetNextStartFrame(deviceContext, requestContext, queueContext, urb, isHS);
 	}
 	///////////////////////////////////////////////////////////////////
 
@@ -304,7 +508,164 @@ VOID XferIsoEx(__in WDFQUEUE Queue,
 	USBERR("SubmitAsyncQueueRequest failed. Status=%08Xh\n", status);
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
+}
+
+/*
+* ISO submit transfer function for "advanced" ISO transfers that use the pipe packet template.
+* IE: Transfers submitted with "UsbK_IsoReadPipe" or UsbK_IsoWritePipe" with a NULL IsoContext.
+*
+* The URB packet table was validated and built when the ISO_AUTO_PACKET_TEMPLATE pipe policy was set;
+* it is copied as-is. Pipe queue callbacks hold the queue lock, so the template cannot be replaced
+* while it is being copied.
+*/
+VOID XferAutoIsoEx(__in WDFQUEUE Queue,
+                   __in WDFREQUEST Request)
+{
+	NTSTATUS status = STATUS_NOT_SUPPORTED;
+	PDEVICE_CONTEXT deviceContext;
+	PREQUEST_CONTEXT requestContext;
+	ISO_PACKET_TEMPLATE* packetTemplate;
+	PURB urb;
+	PMDL mdl;
+	ULONG urbSize;
+	USBD_PIPE_HANDLE usbdPipeHandle;
+	PQUEUE_CONTEXT queueContext;
+
+	// Local vars pre-initialization //////////////////////////////////
+	requestContext = GetRequestContext(Request);
+	deviceContext = GetDeviceContext(WdfIoQueueGetDevice(Queue));
+	VALIDATE_REQUEST_CONTEXT(requestContext, status);
+	if (!NT_SUCCESS(status)) goto Exit;
+
+	if ((queueContext = GetQueueContext(Queue)) == NULL || !queueContext->PipeContext)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERRN("Invalid queue context");
+		goto Exit;
+	}
+
+	if (!queueContext->PipeContext->IsoPacketTemplate)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERRN("PipeID=%02Xh NULL ISO context and no ISO_AUTO_PACKET_TEMPLATE policy.", queueContext->Info.EndpointAddress);
+		goto Exit;
+	}
+	packetTemplate = (ISO_PACKET_TEMPLATE*)WdfMemoryGetBuffer(queueContext->PipeContext->IsoPacketTemplate, NULL);
+
+	if (IsoPackets_CheckTemplateLength(packetTemplate, requestContext->Length) != ISO_PACKETS_SUCCESS)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		USBERRN("PipeID=%02Xh Last packet offset references data that is out-of-range. Offset=%u Length=%u",
+		        queueContext->Info.EndpointAddress, packetTemplate->LastOffset, requestContext->Length);
+		goto Exit;
+	}
+
+	usbdPipeHandle = WdfUsbTargetPipeWdmGetPipeHandle(queueContext->PipeHandle);
+	if (!usbdPipeHandle)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERR("WdfUsbTargetPipeWdmGetPipeHandle failed. usbdPipeHandle=NULL\n");
+		goto Exit;
+	}
+
+	urbSize = GET_ISO_URB_SIZE(packetTemplate->NumberOfPackets);
+	///////////////////////////////////////////////////////////////////
+
+	status = GetTransferMdl(Request, requestContext->ActualRequestType, &mdl);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("GetTransferMdl failed.Status=%08Xh\n", status);
+		goto Exit;
+	}
+	// Allocate URB memory 	///////////////////////////////////////////
+	status = XferIso_CreateUrbMemory(queueContext, Request, urbSize, &requestContext->AutoIsoEx.UrbMemory, &urb);
+	if (!NT_SUCCESS(status))
+		goto Exit;
+	///////////////////////////////////////////////////////////////////
+
+	// handle pipe reset scenarios: ResetPipeOnResume, AutoClearStall
+	mXfer_HandlePipeResetScenarios(status, queueContext, requestContext);
+
+	// Init URB ///////////////////////////////////////////////////////
+	mXfer_IsoInitUrb(
+	    urb,
+	    urbSize,
+	    usbdPipeHandle,
+	    packetTemplate->NumberOfPackets,
+	    mdl,
+	    requestContext->Length,
+	    (USB_ENDPOINT_DIRECTION_IN(queueContext->Info.EndpointAddress) ? (USBD_TRANSFER_DIRECTION_IN | USBD_SHORT_TRANSFER_OK) : USBD_TRANSFER_DIRECTION_OUT));
+
+	IsoPackets_CopyTemplate(packetTemplate, (ISO_URB_PACKET*)urb->UrbIsochronousTransfer.IsoPacket);
+
+	XferIso_SetNextStartFrame(deviceContext, requestContext, queueContext, urb, IsHighSpeedDevice(deviceContext));
+	///////////////////////////////////////////////////////////////////
+
+	// Assign the new urb to the request and prepare it for WdfRequestSend.
+	status = WdfUsbTargetPipeFormatRequestForUrb(queueContext->PipeHandle, Request, requestContext->AutoIsoEx.UrbMemory, NULL);
+	if (!NT_SUCCESS(status))
+	{
+		USBERR("WdfUsbTargetPipeFormatRequestForUrb failed. Status=%08Xh\n", status);
+		goto Exit;
+	}
+
+	status = SubmitAsyncQueueRequest(queueContext, Request, XferAutoIsoExComplete, NULL, requestContext);
+	if (NT_SUCCESS(status))
+		return;
+
+	USBERR("SubmitAsyncQueueRequest failed. Status=%08Xh\n", status);
+
+Exit:
+	Xfer_CompleteRequest(Request, status, 0);
+}
+
+VOID XferAutoIsoExComplete(
+    __in WDFREQUEST Request,
+    __in WDFIOTARGET Target,
+    __in PWDF_REQUEST_COMPLETION_PARAMS CompletionParams,
+    __in PREQUEST_CONTEXT requestContext)
+{
+	PURB urb;
+	NTSTATUS status;
+	ULONG transferred = 0;
+
+	UNREFERENCED_PARAMETER(Target);
+
+	status = CompletionParams->IoStatus.Status;
+	Xfer_CheckPipeStatus(status, requestContext->QueueContext->Info.EndpointAddress);
+
+	urb = WdfMemoryGetBuffer(requestContext->AutoIsoEx.UrbMemory, NULL);
+
+	if (status == STATUS_CANCELLED || status == STATUS_DEVICE_NOT_CONNECTED)
+	{
+		USBWRNN("[Cancelled] PipeID=%02Xh Status=%08Xh USBD-Status=%08Xh ErrorCount=%u",
+		        requestContext->QueueContext->Info.EndpointAddress, status, urb->UrbHeader.Status, urb->UrbIsochronousTransfer.ErrorCount);
+		Xfer_CompleteRequest(Request, status, 0);
+		return;
+	}
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("[Failure] PipeID=%02Xh Status=%08Xh USBD-Status=%08Xh ErrorCount=%u",
+		        requestContext->QueueContext->Info.EndpointAddress, status, urb->UrbHeader.Status, urb->UrbIsochronousTransfer.ErrorCount);
+
+		if (urb->UrbHeader.Status != USBD_STATUS_SUCCESS)
+		{
+			Xfer_CompleteRequest(Request, status, 0);
+			return;
+		}
+	}
+
+	mXfer_HandlePipeResetScenariosForComplete(status, requestContext->QueueContext, requestContext);
+
+	if (NT_SUCCESS(status))
+	{
+		transferred = (ULONG)urb->UrbIsochronousTransfer.TransferBufferLength;
+
+		KTRACE_MSG(ISO_DONE, transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
+	}
+
+	Xfer_CompleteRequest(Request, status, transferred);
 }
 
 VOID XferIsoExComplete(
@@ -331,7 +692,7 @@ VOID XferIsoExComplete(
 	{
 		USBERRN("Critical Error! urb=%p requestContext=%p IsoContext=%p",urb, requestContext, IsoContext);
 		if (NT_SUCCESS(status)) status = STATUS_INVALID_ADDRESS;
-		WdfRequestComplete(Request,status);
+		Xfer_CompleteRequest(Request, status, 0);
 		return;
 	}
 
@@ -339,7 +700,7 @@ VOID XferIsoExComplete(
 	{
 		USBWRNN("[Cancelled] PipeID=%02Xh Status=%08Xh USBD-Status=%08Xh ErrorCount=%u",
 		        requestContext->QueueContext->Info.EndpointAddress, status, urb->UrbHeader.Status, urb->UrbIsochronousTransfer.ErrorCount);
-		WdfRequestComplete(Request,status);
+		Xfer_CompleteRequest(Request, status, 0);
 		return;
 
 	}
@@ -350,7 +711,7 @@ VOID XferIsoExComplete(
 
 		if (urb->UrbHeader.Status != USBD_STATUS_SUCCESS)
 		{
-			WdfRequestComplete(Request,status);
+			Xfer_CompleteRequest(Request, status, 0);
 			return;
 		}
 	}
@@ -378,11 +739,10 @@ VOID XferIsoExComplete(
 	{
 		transferred = (ULONG)urb->UrbIsochronousTransfer.TransferBufferLength;
 
-		USBMSGN("Transferred=%u StartFrame=%08Xh Errors=%d Status=%08Xh",
-		        transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
+		KTRACE_MSG(ISO_DONE, transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
 	}
 
-	WdfRequestCompleteWithInformation(Request, status, transferred);
+	Xfer_CompleteRequest(Request, status, transferred);
 }
 
 VOID XferIsoRdComplete(
@@ -442,12 +802,11 @@ VOID XferIsoRdComplete(
 	{
 		transferred = (ULONG)urb->UrbIsochronousTransfer.TransferBufferLength;
 
-		USBMSGN("Transferred=%u StartFrame=%08Xh Errors=%d",
-		        transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount);
+		KTRACE_MSG(ISO_DONE, transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
 	}
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, transferred);
+	Xfer_CompleteRequest(Request, status, transferred);
 }
 
 VOID XferIsoWrComplete(
@@ -473,11 +832,10 @@ VOID XferIsoWrComplete(
 	{
 		transferred = (ULONG)urb->UrbIsochronousTransfer.TransferBufferLength;
 
-		USBMSGN("Transferred=%u StartFrame=%08Xh Errors=%d Status=%08Xh",
-		        transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
+		KTRACE_MSG(ISO_DONE, transferred, urb->UrbIsochronousTransfer.StartFrame, urb->UrbIsochronousTransfer.ErrorCount, status);
 	}
 
-	WdfRequestCompleteWithInformation(Request, status, transferred);
+	Xfer_CompleteRequest(Request, status, transferred);
 }
 
 VOID XferIsoRead(
@@ -487,7 +845,6 @@ VOID XferIsoRead(
 	NTSTATUS status = STATUS_NOT_SUPPORTED;
 	PDEVICE_CONTEXT deviceContext;
 	PREQUEST_CONTEXT requestContext;
-	WDF_OBJECT_ATTRIBUTES attributes;
 	PURB urb;
 	PMDL mdl;
 	ULONG urbSize;
@@ -561,14 +918,9 @@ VOID XferIsoRead(
 		goto Exit;
 	}
 	// Allocate URB memory 	///////////////////////////////////////////
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = Request;
-	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, urbSize, &requestContext->AutoIso.UrbMemory, &urb);
+	status = XferIso_CreateUrbMemory(queueContext, Request, urbSize, &requestContext->AutoIso.UrbMemory, &urb);
 	if (!NT_SUCCESS(status))
-	{
-		USBERR("WdfMemoryCreate failed. size=%u Status=%08Xh\n", urbSize, status);
 		goto Exit;
-	}
 	///////////////////////////////////////////////////////////////////
 
 	// handle pipe reset scenarios: ResetPipeOnResume, AutoClearStall
@@ -624,7 +976,7 @@ VOID XferIsoRead(
 	USBERR("SubmitAsyncQueueRequest failed. Status=%08Xh\n", status);
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
 
 VOID XferIsoWrite(
@@ -634,7 +986,6 @@ VOID XferIsoWrite(
 	NTSTATUS status = STATUS_NOT_SUPPORTED;
 	PDEVICE_CONTEXT deviceContext;
 	PREQUEST_CONTEXT requestContext;
-	WDF_OBJECT_ATTRIBUTES attributes;
 	PURB urb;
 	PMDL mdl;
 	ULONG urbSize;
@@ -734,14 +1085,9 @@ VOID XferIsoWrite(
 	// Allocate URB memory 	///////////////////////////////////////////
 	urbSize = GET_ISO_URB_SIZE(numberOfPackets);
 
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = Request;
-	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, urbSize, &requestContext->AutoIso.UrbMemory, &urb);
+	status = XferIso_CreateUrbMemory(queueContext, Request, urbSize, &requestContext->AutoIso.UrbMemory, &urb);
 	if (!NT_SUCCESS(status))
-	{
-		USBERR("WdfMemoryCreate failed. size=%u Status=%08Xh\n", urbSize, status);
 		goto Exit;
-	}
 	///////////////////////////////////////////////////////////////////
 
 	// handle pipe reset scenarios: ResetPipeOnResume, AutoClearStall
@@ -803,5 +1149,5 @@ VOID XferIsoWrite(
 	USBERR("SubmitAsyncQueueRequest failed. Status=%08Xh\n", status);
 
 Exit:
-	WdfRequestCompleteWithInformation(Request, status, 0);
+	Xfer_CompleteRequest(Request, status, 0);
 }
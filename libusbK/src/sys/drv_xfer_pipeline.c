@@ -0,0 +1,300 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_xfer_pipeline.h"
+
+void XferPipeline_PlanRead(
+    unsigned int length,
+    unsigned int transferred,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize,
+    unsigned int leftover,
+    XFER_READ_PLAN* plan)
+{
+	unsigned int remaining;
+	unsigned int stageLength;
+
+	plan->LeftoverCopy	= 0;
+	plan->DirectLength	= 0;
+	plan->BounceLength	= 0;
+	plan->Complete		= 0;
+
+	remaining = transferred < length ? length - transferred : 0;
+
+	plan->LeftoverCopy = leftover > remaining ? remaining : leftover;
+	remaining -= plan->LeftoverCopy;
+
+	if (!remaining)
+	{
+		plan->Complete = 1;
+		return;
+	}
+
+	stageLength = remaining > maxTransferSize ? maxTransferSize : remaining;
+
+	if (stageLength < maxPacketSize)
+		plan->BounceLength = stageLength;
+	else
+		plan->DirectLength = stageLength - (stageLength % maxPacketSize);
+}
+
+void XferPipeline_Init(
+    XFER_PIPELINE* pipeline,
+    unsigned int depth,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize)
+{
+	if (depth < 1) depth = 1;
+	if (depth > XFER_PIPELINE_MAX_DEPTH) depth = XFER_PIPELINE_MAX_DEPTH;
+
+	pipeline->Depth				= depth;
+	pipeline->MaxPacketSize		= maxPacketSize;
+	pipeline->MaxTransferSize	= maxTransferSize;
+
+	XferPipeline_Begin(pipeline, 0, 0, 0, 0);
+	pipeline->Finished = 1;
+}
+
+void XferPipeline_Begin(
+    XFER_PIPELINE* pipeline,
+    int isRead,
+    unsigned int length,
+    unsigned int transferred,
+    unsigned int zlpsRequired)
+{
+	unsigned int pos;
+
+	pipeline->IsRead		= isRead;
+	pipeline->Length		= length;
+	pipeline->ZlpsRequired	= isRead ? 0 : zlpsRequired;
+	pipeline->Transferred	= transferred;
+	pipeline->IssueOffset	= transferred;
+	pipeline->ZlpsIssued	= 0;
+	pipeline->Head			= 0;
+	pipeline->Count			= 0;
+	pipeline->Status		= 0;
+	pipeline->Stopping		= 0;
+	pipeline->Finished		= 0;
+
+	for (pos = 0; pos < XFER_PIPELINE_MAX_DEPTH; pos++)
+		pipeline->Stages[pos].State = XFER_STAGE_IDLE;
+}
+
+XFER_PIPELINE_NEXT XferPipeline_NextStage(
+    XFER_PIPELINE* pipeline,
+    unsigned int* stageIndex)
+{
+	XFER_STAGE* stage;
+	XFER_READ_PLAN readPlan;
+	unsigned int remaining;
+	unsigned int stageLength;
+
+	if (pipeline->Finished)
+		return XFER_PIPELINE_WAIT;
+
+	if (!pipeline->Stopping && pipeline->Count < pipeline->Depth)
+	{
+		if (pipeline->IsRead && !pipeline->Count)
+		{
+			// Short stages were compacted; everything past Transferred is free again.
+			pipeline->IssueOffset = pipeline->Transferred;
+		}
+
+		remaining = pipeline->IssueOffset < pipeline->Length ? pipeline->Length - pipeline->IssueOffset : 0;
+
+		if (pipeline->IsRead)
+		{
+			// The sub-packet tail, if any, is left for the over-run buffer.
+			XferPipeline_PlanRead(pipeline->Length, pipeline->IssueOffset,
+			                      pipeline->MaxPacketSize, pipeline->MaxTransferSize, 0, &readPlan);
+			stageLength = readPlan.DirectLength;
+		}
+		else
+		{
+			stageLength = remaining > pipeline->MaxTransferSize ? pipeline->MaxTransferSize : remaining;
+		}
+
+		if (stageLength || (!pipeline->IsRead && !remaining && pipeline->ZlpsIssued < pipeline->ZlpsRequired))
+		{
+			if (!stageLength)
+				pipeline->ZlpsIssued++;
+
+			*stageIndex = (pipeline->Head + pipeline->Count) % pipeline->Depth;
+			stage = &pipeline->Stages[*stageIndex];
+
+			stage->Offset	= pipeline->IssueOffset;
+			stage->Length	= stageLength;
+			stage->Actual	= 0;
+			stage->Status	= 0;
+			stage->State	= XFER_STAGE_PENDING;
+
+			pipeline->IssueOffset += stageLength;
+			pipeline->Count++;
+
+			return XFER_PIPELINE_SEND;
+		}
+	}
+
+	if (pipeline->Count)
+		return XFER_PIPELINE_WAIT;
+
+	pipeline->Finished = 1;
+	return XFER_PIPELINE_FINISHED;
+}
+
+void XferPipeline_StageDone(
+    XFER_PIPELINE* pipeline,
+    unsigned int stageIndex,
+    int status,
+    unsigned int actual)
+{
+	XFER_STAGE* stage = &pipeline->Stages[stageIndex];
+
+	stage->Status	= status;
+	stage->Actual	= actual > stage->Length ? stage->Length : actual;
+	stage->State	= XFER_STAGE_DONE;
+}
+
+int XferPipeline_Retire(
+    XFER_PIPELINE* pipeline,
+    XFER_PIPELINE_MOVE* move)
+{
+	XFER_STAGE* stage;
+
+	move->Length = 0;
+
+	if (!pipeline->Count)
+		return 0;
+
+	stage = &pipeline->Stages[pipeline->Head];
+	if (stage->State != XFER_STAGE_DONE)
+		return 0;
+
+	// Stages sent after a failure are retired without being counted; on a
+	// failed stage, the bytes it moved are still counted. (same as the
+	// single-stage transfer functions)
+	if (!pipeline->Status)
+	{
+		if (stage->Actual && stage->Offset != pipeline->Transferred)
+		{
+			move->SrcOffset	= stage->Offset;
+			move->DstOffset	= pipeline->Transferred;
+			move->Length	= stage->Actual;
+		}
+		pipeline->Transferred += stage->Actual;
+
+		if (stage->Status)
+			XferPipeline_Abort(pipeline, stage->Status);
+	}
+
+	stage->State = XFER_STAGE_IDLE;
+	pipeline->Head = (pipeline->Head + 1) % pipeline->Depth;
+	pipeline->Count--;
+
+	return 1;
+}
+
+void XferPipeline_Abort(
+    XFER_PIPELINE* pipeline,
+    int status)
+{
+	pipeline->Stopping = 1;
+	if (!pipeline->Status)
+		pipeline->Status = status;
+}
+
+// Automatic bulk stage sizes; the first rule matching the device speed and
+// USB stack is used. Stacks older than the Vista stack (USBDI 0x600) keep the
+// original MaximumPacketSize * 4096 limit. There are no SuperSpeed or
+// per-controller rules. (see XFER_SPLIT_PARAMS)
+typedef struct _XFER_SPLIT_RULE
+{
+	int HighSpeed;
+	unsigned int MinUsbdiVersion;
+	unsigned int StageSize;
+} XFER_SPLIT_RULE;
+
+static const XFER_SPLIT_RULE XferSplitRules[] =
+{
+	// Windows 8 and later (USB 3.0 capable) stack.
+	{1, 0x602, 4 * 1024 * 1024},
+	{0, 0x602, 256 * 1024},
+
+	// Vista/7 stack.
+	{1, 0x600, 2 * 1024 * 1024},
+	{0, 0x600, 256 * 1024},
+};
+
+static unsigned int XferPipeline_RoundToPackets(
+    unsigned int size,
+    unsigned int maxPacketSize)
+{
+	if (!maxPacketSize)
+		return size;
+
+	size -= size % maxPacketSize;
+	return size ? size : maxPacketSize;
+}
+
+unsigned int XferPipeline_AutoStageSize(
+    const XFER_SPLIT_PARAMS* params)
+{
+	unsigned int ruleIndex;
+
+	switch (params->PipeType)
+	{
+	case XFER_SPLIT_PIPE_ISOCHRONOUS:
+		// Packets per transfer are limited by the USB stack.
+		return params->HighSpeed ? (1024 * params->MaxPacketSize) : (255 * params->MaxPacketSize);
+
+	case XFER_SPLIT_PIPE_BULK:
+		for (ruleIndex = 0; ruleIndex < sizeof(XferSplitRules) / sizeof(XferSplitRules[0]); ruleIndex++)
+		{
+			if ((XferSplitRules[ruleIndex].HighSpeed ? 1 : 0) == (params->HighSpeed ? 1 : 0) &&
+			        params->UsbdiVersion >= XferSplitRules[ruleIndex].MinUsbdiVersion)
+			{
+				return XferPipeline_RoundToPackets(XferSplitRules[ruleIndex].StageSize, params->MaxPacketSize);
+			}
+		}
+		return params->MaxPacketSize * 4096;
+
+	case XFER_SPLIT_PIPE_INTERRUPT:
+		return params->MaxPacketSize * 4096;
+
+	default:
+		return params->StackMaxTransferSize;
+	}
+}
+
+unsigned int XferPipeline_CalcStageSize(
+    const XFER_SPLIT_PARAMS* params)
+{
+	unsigned int stageSize;
+
+	if (params->StageSizePolicy &&
+	        (params->PipeType == XFER_SPLIT_PIPE_BULK || params->PipeType == XFER_SPLIT_PIPE_INTERRUPT))
+	{
+		stageSize = XferPipeline_RoundToPackets(params->StageSizePolicy, params->MaxPacketSize);
+	}
+	else
+	{
+		stageSize = XferPipeline_AutoStageSize(params);
+	}
+
+	return stageSize > params->StackMaxTransferSize ? params->StackMaxTransferSize : stageSize;
+}
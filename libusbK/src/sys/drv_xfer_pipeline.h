@@ -0,0 +1,237 @@
+/*! \file drv_xfer_pipeline.h
+*/
+
+#ifndef __DRV_XFER_PIPELINE_H__
+#define __DRV_XFER_PIPELINE_H__
+
+//////////////////////////////////////////////////////////////////////////////
+// drv_xfer_pipeline.c function prototypes.
+// Stage planning and in-order retirement for pipelined bulk/interrupt transfers.
+//
+// When the PIPELINE_DEPTH pipe policy is greater than one, a sequential
+// bulk/interrupt request that needs more than one stage keeps up to Depth
+// stages in flight instead of waiting for each stage to complete before
+// sending the next. Stages can complete in any order; they are retired in
+// the order they were sent so the transfer length and the data in the user
+// buffer are the same as for a single-stage-at-a-time transfer.
+//
+// Like drv_iso_packets.h, this module uses plain C types only and can be
+// built and exercised outside of the driver. It does no I/O and takes no
+// locks; the driver (drv_xfer_bulk.c) serializes every call with the queue
+// pipeline lock, sends and cancels the stage requests and moves the data.
+//
+
+#define XFER_PIPELINE_MAX_DEPTH	8
+
+typedef enum _XFER_STAGE_STATE
+{
+    XFER_STAGE_IDLE = 0,
+    XFER_STAGE_PENDING,
+    XFER_STAGE_DONE,
+} XFER_STAGE_STATE;
+
+typedef struct _XFER_STAGE
+{
+	// Range of the user buffer the stage was sent with. Length is 0 for a ZLP.
+	unsigned int Offset;
+	unsigned int Length;
+
+	// Completion results.
+	unsigned int Actual;
+	int Status;
+
+	XFER_STAGE_STATE State;
+} XFER_STAGE;
+
+typedef enum _XFER_PIPELINE_NEXT
+{
+    // A stage was reserved; send it.
+    XFER_PIPELINE_SEND = 0,
+
+    // Nothing to send until another stage completes.
+    XFER_PIPELINE_WAIT,
+
+    // Every stage has been retired. Returned once per transfer.
+    XFER_PIPELINE_FINISHED,
+} XFER_PIPELINE_NEXT;
+
+// A data move required to retire a short read stage.
+typedef struct _XFER_PIPELINE_MOVE
+{
+	unsigned int SrcOffset;
+	unsigned int DstOffset;
+	unsigned int Length;
+} XFER_PIPELINE_MOVE;
+
+typedef struct _XFER_PIPELINE
+{
+	// Configuration. (see XferPipeline_Init)
+	unsigned int Depth;
+	unsigned int MaxPacketSize;
+	unsigned int MaxTransferSize;
+
+	// Transfer. (see XferPipeline_Begin)
+	int IsRead;
+	unsigned int Length;
+	unsigned int ZlpsRequired;
+
+	// Bytes retired, in order. For reads this is also where the next retired
+	// stage's data belongs in the user buffer.
+	unsigned int Transferred;
+
+	// User buffer offset of the next stage.
+	unsigned int IssueOffset;
+	unsigned int ZlpsIssued;
+
+	// Stage ring; Count stages starting at Head are pending or waiting to be retired.
+	unsigned int Head;
+	unsigned int Count;
+
+	// First failure status; 0 on success.
+	int Status;
+
+	// Set on the first failure or abort; no more stages are sent.
+	int Stopping;
+	int Finished;
+
+	XFER_STAGE Stages[XFER_PIPELINE_MAX_DEPTH];
+} XFER_PIPELINE;
+
+// Read stage plan. (see XferPipeline_PlanRead)
+typedef struct _XFER_READ_PLAN
+{
+	// Bytes to take from the over-run buffer leftovers of a previous read.
+	unsigned int LeftoverCopy;
+
+	// Whole packets to read directly into the user buffer, after the leftovers.
+	unsigned int DirectLength;
+
+	// Non-zero when the next stage is the sub-packet tail; it reads one packet
+	// into the over-run buffer and this many bytes are copied out of it.
+	unsigned int BounceLength;
+
+	// Non-zero if the leftovers satisfy the request; nothing is read.
+	int Complete;
+} XFER_READ_PLAN;
+
+// Plans the next read stage of a sequential bulk/interrupt transfer.
+//
+// Whole packets are always read directly into the user buffer; only a tail
+// shorter than maxPacketSize goes through the over-run buffer, because
+// reading it directly could overrun the user buffer. Leftover bytes from a
+// previous over-run read are used before anything is read.
+//
+// This is the same split the read path used before the planner; it moves
+// the decision into one place but does not copy any less. At most one
+// packet per request is copied out of the over-run buffer.
+void XferPipeline_PlanRead(
+    unsigned int length,
+    unsigned int transferred,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize,
+    unsigned int leftover,
+    XFER_READ_PLAN* plan);
+
+// Sets the pipe configuration. depth is clamped to 1..XFER_PIPELINE_MAX_DEPTH.
+void XferPipeline_Init(
+    XFER_PIPELINE* pipeline,
+    unsigned int depth,
+    unsigned int maxPacketSize,
+    unsigned int maxTransferSize);
+
+// Starts a new transfer.
+//
+// isRead       - Read stages are always whole packets and short stages do
+//                not end the transfer (IGNORE_SHORT_PACKETS). Any sub-packet
+//                tail is left for the caller.
+// transferred  - Bytes already in the user buffer. (partial read leftovers)
+// zlpsRequired - Zero-length stages sent after the data. (writes only)
+void XferPipeline_Begin(
+    XFER_PIPELINE* pipeline,
+    int isRead,
+    unsigned int length,
+    unsigned int transferred,
+    unsigned int zlpsRequired);
+
+// Reserves the next stage. On XFER_PIPELINE_SEND, stageIndex receives the
+// index of the stage in Stages[] to send.
+XFER_PIPELINE_NEXT XferPipeline_NextStage(
+    XFER_PIPELINE* pipeline,
+    unsigned int* stageIndex);
+
+// Records the completion of a stage. A stage that could not be sent is
+// completed with the send failure status.
+void XferPipeline_StageDone(
+    XFER_PIPELINE* pipeline,
+    unsigned int stageIndex,
+    int status,
+    unsigned int actual);
+
+// Retires the oldest stage if it is done. Returns non-zero if a stage was
+// retired. When move->Length is non-zero, the caller must move that many
+// bytes within the user buffer (overlapping) before releasing the lock.
+int XferPipeline_Retire(
+    XFER_PIPELINE* pipeline,
+    XFER_PIPELINE_MOVE* move);
+
+// Stops sending stages. status is kept if it is the first failure.
+void XferPipeline_Abort(
+    XFER_PIPELINE* pipeline,
+    int status);
+
+//////////////////////////////////////////////////////////////////////////////
+// Stage size planning. (Pipe_CalcMaxTransferSize)
+//
+// Picks the largest stage a bulk/interrupt transfer is split into (and the
+// largest iso transfer) from the pipe type, device speed and USB stack. The
+// stage size is also the PipeInformation.MaximumTransferSize reported by the
+// MAXIMUM_TRANSFER_SIZE pipe policy.
+//
+// The inputs are limited to what the driver can query:
+// - Speed is only full or high. The driver sees WDF_USB_DEVICE_TRAIT_AT_HIGH_SPEED
+//   and nothing faster, so a SuperSpeed device gets the high-speed sizes.
+// - The host controller type is not known. The USBDI version of the USB
+//   stack is the only controller input; 0x602 is the Windows 8 USB 3.0
+//   capable stack.
+//
+
+typedef enum _XFER_SPLIT_PIPE_TYPE
+{
+    XFER_SPLIT_PIPE_OTHER = 0,
+    XFER_SPLIT_PIPE_BULK,
+    XFER_SPLIT_PIPE_INTERRUPT,
+    XFER_SPLIT_PIPE_ISOCHRONOUS,
+} XFER_SPLIT_PIPE_TYPE;
+
+typedef struct _XFER_SPLIT_PARAMS
+{
+	XFER_SPLIT_PIPE_TYPE PipeType;
+
+	// Non-zero for a high-speed (or faster) device. SuperSpeed is not told apart.
+	int HighSpeed;
+
+	// USBD_VERSION_INFORMATION.USBDI_Version of the USB stack; stands in for the controller type.
+	unsigned int UsbdiVersion;
+
+	unsigned int MaxPacketSize;
+
+	// MaximumTransferSize reported by the USB stack; never exceeded.
+	unsigned int StackMaxTransferSize;
+
+	// MAXIMUM_STAGE_SIZE pipe policy; 0 uses XferPipeline_AutoStageSize.
+	unsigned int StageSizePolicy;
+} XFER_SPLIT_PARAMS;
+
+// Gets the stage size used when the MAXIMUM_STAGE_SIZE policy is 0.
+// The result is a multiple of MaxPacketSize and is not clamped to
+// StackMaxTransferSize.
+unsigned int XferPipeline_AutoStageSize(
+    const XFER_SPLIT_PARAMS* params);
+
+// Gets the stage size for the pipe. A non-zero StageSizePolicy is rounded
+// down to a multiple of MaxPacketSize (at least one packet) and only applies
+// to bulk and interrupt pipes. The result never exceeds StackMaxTransferSize.
+unsigned int XferPipeline_CalcStageSize(
+    const XFER_SPLIT_PARAMS* params);
+
+#endif
@@ -0,0 +1,506 @@
+/*!********************************************************************
+libusbK - WDF USB driver.
+Copyright (C) 2012 Travis Lee Robinson. All Rights Reserved.
+libusb-win32.sourceforge.net
+
+Development : Travis Lee Robinson  (libusbdotnet@gmail.com)
+Testing     : Xiaofan Chen         (xiaofanc@gmail.com)
+
+At the discretion of the user of this library, this software may be
+licensed under the terms of the GNU Public License v3 or a BSD-Style
+license as outlined in the following files:
+* LICENSE-gpl3.txt
+* LICENSE-bsd.txt
+
+License files are located in a license folder at the root of source and
+binary distributions.
+********************************************************************!*/
+
+#include "drv_common.h"
+
+/*
+* Continuous reader. (CONTINUOUS_READER)
+*
+* The pipe queue owns Reader.Slots read requests; while the reader runs every
+* slot is either sent to the pipe or about to be sent again. Completed reads
+* are stored in the packet ring in the order they were sent and pended
+* LIBUSBK_IOCTL_READ_PACKETS requests are filled from it. Ordering and ring
+* framing are done by drv_packet_ring.c; everything here holds Reader.Lock
+* while using it.
+*
+* Like the pipeline in drv_xfer_bulk.c, only one thread at a time stores
+* packets and sends slots (Reader.Busy). Other completions are recorded and
+* picked up by the busy thread before it lets go.
+*
+* The reader starts with the first LIBUSBK_IOCTL_READ_PACKETS request. A read
+* failure stops it; the failure is returned once the ring is empty and the
+* next request starts it again. Pipe_Stop stops it and discards the ring.
+*/
+
+typedef struct _XFER_READER_SLOT_CONTEXT
+{
+	PQUEUE_CONTEXT	QueueContext;
+	ULONG			SlotIndex;
+} XFER_READER_SLOT_CONTEXT, *PXFER_READER_SLOT_CONTEXT;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(XFER_READER_SLOT_CONTEXT, GetXferReaderSlotContext)
+
+// LIBUSBK_IOCTL_READ_PACKETS returns the ring records as they are stored.
+C_ASSERT(sizeof(KUSB_PACKET_HEADER) == sizeof(PACKET_RING_HEADER));
+C_ASSERT(sizeof(KUSB_PACKET_HEADER) == PACKET_RING_HEADER_SIZE);
+C_ASSERT(KUSB_PACKET_FLAG_OVERRUN == PACKET_RING_FLAG_OVERRUN);
+C_ASSERT(KUSB_PACKET_SIZE(1) == PACKET_RING_RECORD_SIZE(1));
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE Xfer_ReaderComplete;
+
+NTSTATUS Xfer_InitReader(
+    __in WDFQUEUE Queue,
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG slotCount)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	PXFER_READER_SLOT_CONTEXT slotContext;
+	WDFMEMORY ringMemory;
+	PVOID ringBuffer;
+	ULONG slotIndex;
+
+	PacketReader_Init(&queueContext->Reader.State, slotCount);
+	KeInitializeEvent(&queueContext->Reader.IdleEvent, NotificationEvent, TRUE);
+
+	// Everything below is parented to the pipe queue and deleted with it.
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Queue;
+	status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG, PACKET_RING_SIZE, &ringMemory, &ringBuffer);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfMemoryCreate failed. Status=%08Xh", status);
+		return status;
+	}
+	PacketRing_Init(&queueContext->Reader.Ring, (unsigned char*)ringBuffer, PACKET_RING_SIZE);
+
+	for (slotIndex = 0; slotIndex < queueContext->Reader.State.SlotCount; slotIndex++)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, XFER_READER_SLOT_CONTEXT);
+		attributes.ParentObject = Queue;
+
+		status = WdfRequestCreate(&attributes,
+		                          WdfUsbTargetPipeGetIoTarget(queueContext->PipeHandle),
+		                          &queueContext->Reader.Slots[slotIndex]);
+		if (!NT_SUCCESS(status))
+		{
+			USBERRN("WdfRequestCreate failed. Status=%08Xh", status);
+			return status;
+		}
+
+		slotContext = GetXferReaderSlotContext(queueContext->Reader.Slots[slotIndex]);
+		slotContext->QueueContext	= queueContext;
+		slotContext->SlotIndex		= slotIndex;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = queueContext->Reader.Slots[slotIndex];
+		status = WdfMemoryCreate(&attributes, NonPagedPool, POOL_TAG,
+		                         queueContext->Info.MaximumPacketSize,
+		                         &queueContext->Reader.SlotMemory[slotIndex],
+		                         (PVOID*)&queueContext->Reader.SlotBuffer[slotIndex]);
+		if (!NT_SUCCESS(status))
+		{
+			USBERRN("WdfMemoryCreate failed. Status=%08Xh", status);
+			return status;
+		}
+	}
+
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+	queueConfig.PowerManaged = WdfFalse;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Queue;
+	status = WdfIoQueueCreate(WdfIoQueueGetDevice(Queue), &queueConfig, &attributes, &queueContext->Reader.DrainQueue);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfIoQueueCreate failed. Status=%08Xh", status);
+		queueContext->Reader.DrainQueue = NULL;
+		return status;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Queue;
+	status = WdfSpinLockCreate(&attributes, &queueContext->Reader.Lock);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfSpinLockCreate failed. Status=%08Xh", status);
+		queueContext->Reader.Lock = NULL;
+		return status;
+	}
+
+	USBDBGN("PipeID=%02Xh Slots=%u", queueContext->Info.EndpointAddress, queueContext->Reader.State.SlotCount);
+	return STATUS_SUCCESS;
+}
+
+// Cancels the slots that are sent; requires Reader.Lock and releases it while cancelling.
+static VOID Xfer_ReaderCancelSent(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	UCHAR sent[PACKET_READER_MAX_SLOTS];
+	ULONG slotIndex;
+
+	RtlCopyMemory(sent, queueContext->Reader.SlotSent, sizeof(sent));
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	for (slotIndex = 0; slotIndex < queueContext->Reader.State.SlotCount; slotIndex++)
+	{
+		if (sent[slotIndex])
+			WdfRequestCancelSentRequest(queueContext->Reader.Slots[slotIndex]);
+	}
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+}
+
+static NTSTATUS Xfer_ReaderSend(
+    __in PQUEUE_CONTEXT queueContext,
+    __in ULONG slotIndex)
+{
+	NTSTATUS status;
+	WDFREQUEST slotRequest = queueContext->Reader.Slots[slotIndex];
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+	status = WdfRequestReuse(slotRequest, &reuseParams);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfRequestReuse failed. Status=%08Xh", status);
+		return status;
+	}
+
+	status = WdfUsbTargetPipeFormatRequestForRead(queueContext->PipeHandle,
+	         slotRequest,
+	         queueContext->Reader.SlotMemory[slotIndex],
+	         NULL);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfUsbTargetPipeFormatRequestForRead failed. Status=%08Xh", status);
+		return status;
+	}
+
+	WdfRequestSetCompletionRoutine(slotRequest, Xfer_ReaderComplete, queueContext);
+
+	if (!WdfRequestSend(slotRequest, WdfUsbTargetPipeGetIoTarget(queueContext->PipeHandle), WDF_NO_SEND_OPTIONS))
+	{
+		status = WdfRequestGetStatus(slotRequest);
+		USBERRN("WdfRequestSend failed. Status=%08Xh", status);
+		return status;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+// Moves packets from the ring into a LIBUSBK_IOCTL_READ_PACKETS request; requires Reader.Lock.
+static NTSTATUS Xfer_ReaderFill(
+    __in PQUEUE_CONTEXT queueContext,
+    __in WDFREQUEST Request,
+    __out PULONG length)
+{
+	NTSTATUS status;
+	PVOID buffer;
+	size_t bufferLength;
+	unsigned int packets;
+
+	*length = 0;
+
+	status = WdfRequestRetrieveOutputBuffer(Request, PACKET_RING_HEADER_SIZE, &buffer, &bufferLength);
+	if (!NT_SUCCESS(status))
+	{
+		USBERRN("WdfRequestRetrieveOutputBuffer failed. Status=%08Xh", status);
+		return status;
+	}
+
+	*length = PacketRing_Drain(&queueContext->Reader.Ring, (unsigned char*)buffer, (unsigned int)bufferLength, &packets);
+	if (!packets)
+	{
+		if (queueContext->Reader.Ring.Packets)
+		{
+			USBERRN("PipeID=%02Xh Buffer too small for the next packet. Required=%u",
+			        queueContext->Info.EndpointAddress, PacketRing_PeekSize(&queueContext->Reader.Ring));
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+
+		// Only the reader error is left.
+		status = queueContext->Reader.Error;
+		queueContext->Reader.Error = STATUS_SUCCESS;
+		return status;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+// Stores completed reads, sends their slots again and fills waiting requests.
+static VOID Xfer_ReaderPump(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	NTSTATUS status;
+	unsigned int slotIndex;
+	int slotStatus;
+	unsigned int slotLength;
+	long long timestamp;
+	WDFREQUEST drainRequest;
+	ULONG drainLength;
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+	if (queueContext->Reader.Busy)
+	{
+		WdfSpinLockRelease(queueContext->Reader.Lock);
+		return;
+	}
+	queueContext->Reader.Busy = 1;
+
+	for (;;)
+	{
+		if (PacketReader_Next(&queueContext->Reader.State, &slotIndex, &slotStatus, &slotLength, &timestamp))
+		{
+			queueContext->Reader.SlotSent[slotIndex] = FALSE;
+
+			if (NT_SUCCESS(slotStatus))
+			{
+				PacketRing_Put(&queueContext->Reader.Ring, queueContext->Reader.SlotBuffer[slotIndex], slotLength, timestamp);
+			}
+			else if (!queueContext->Reader.Stopping)
+			{
+				// First failure; the remaining slots are cancelled and retired.
+				USBWRNN("PipeID=%02Xh Continuous reader failed. Status=%08Xh", queueContext->Info.EndpointAddress, slotStatus);
+				queueContext->Reader.Error = slotStatus;
+				queueContext->Reader.Stopping = TRUE;
+
+				// The failed slot is retired below; the others as they come back.
+				Xfer_ReaderCancelSent(queueContext);
+			}
+
+			if (queueContext->Reader.Stopping)
+			{
+				if (--queueContext->Reader.Outstanding == 0)
+				{
+					queueContext->Reader.Running = FALSE;
+					KTRACE_MSG(READER_STOP, queueContext->Info.EndpointAddress,
+					           queueContext->Reader.Ring.Stored, queueContext->Reader.Ring.Dropped, queueContext->Reader.Error);
+					KeSetEvent(&queueContext->Reader.IdleEvent, IO_NO_INCREMENT, FALSE);
+				}
+				continue;
+			}
+
+			queueContext->Reader.SlotSent[slotIndex] = TRUE;
+			WdfSpinLockRelease(queueContext->Reader.Lock);
+
+			status = Xfer_ReaderSend(queueContext, slotIndex);
+
+			WdfSpinLockAcquire(queueContext->Reader.Lock);
+			if (!NT_SUCCESS(status))
+			{
+				// The slot is still the newest; fail it in order.
+				queueContext->Reader.SlotSent[slotIndex] = FALSE;
+				PacketReader_Complete(&queueContext->Reader.State, slotIndex, status, 0, 0);
+			}
+			else if (queueContext->Reader.Stopping)
+			{
+				// Sent after the stop cancelled the others.
+				WdfSpinLockRelease(queueContext->Reader.Lock);
+				WdfRequestCancelSentRequest(queueContext->Reader.Slots[slotIndex]);
+				WdfSpinLockAcquire(queueContext->Reader.Lock);
+			}
+			continue;
+		}
+
+		// Fill a waiting request if there are packets, or the error of a stopped reader.
+		if (queueContext->Reader.Ring.Packets ||
+		        (!queueContext->Reader.Running && !NT_SUCCESS(queueContext->Reader.Error)))
+		{
+			status = WdfIoQueueRetrieveNextRequest(queueContext->Reader.DrainQueue, &drainRequest);
+			if (NT_SUCCESS(status))
+			{
+				status = Xfer_ReaderFill(queueContext, drainRequest, &drainLength);
+
+				WdfSpinLockRelease(queueContext->Reader.Lock);
+				Xfer_CompleteRequest(drainRequest, status, drainLength);
+				WdfSpinLockAcquire(queueContext->Reader.Lock);
+				continue;
+			}
+		}
+
+		break;
+	}
+
+	queueContext->Reader.Busy = 0;
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+}
+
+VOID Xfer_ReaderComplete(__in WDFREQUEST Request,
+                         __in WDFIOTARGET Target,
+                         __in PWDF_REQUEST_COMPLETION_PARAMS Params,
+                         __in WDFCONTEXT Context)
+{
+	PQUEUE_CONTEXT queueContext = (PQUEUE_CONTEXT)Context;
+	PXFER_READER_SLOT_CONTEXT slotContext = GetXferReaderSlotContext(Request);
+	PWDF_USB_REQUEST_COMPLETION_PARAMS usbCompletionParams = Params->Parameters.Usb.Completion;
+	LONGLONG timestamp = KeQueryPerformanceCounter(NULL).QuadPart;
+
+	UNREFERENCED_PARAMETER(Target);
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+	PacketReader_Complete(&queueContext->Reader.State,
+	                      slotContext->SlotIndex,
+	                      Params->IoStatus.Status,
+	                      (unsigned int)usbCompletionParams->Parameters.PipeRead.Length,
+	                      timestamp);
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	Xfer_ReaderPump(queueContext);
+}
+
+// Marks the reader running; requires Reader.Lock. Xfer_ReaderStart must follow.
+static VOID Xfer_ReaderClaim(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	PacketReader_Init(&queueContext->Reader.State, queueContext->Reader.State.SlotCount);
+	queueContext->Reader.Running		= TRUE;
+	queueContext->Reader.Stopping		= FALSE;
+	queueContext->Reader.Error			= STATUS_SUCCESS;
+	queueContext->Reader.Outstanding	= queueContext->Reader.State.SlotCount;
+	queueContext->Reader.Busy			= 1;
+	KeClearEvent(&queueContext->Reader.IdleEvent);
+}
+
+// Sends every slot of a reader claimed by Xfer_ReaderClaim.
+static VOID Xfer_ReaderStart(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	NTSTATUS status;
+	ULONG slotIndex;
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+
+	KTRACE_MSG(READER_START, queueContext->Info.EndpointAddress,
+	           queueContext->Reader.State.SlotCount, queueContext->Info.MaximumPacketSize);
+
+	for (slotIndex = 0; slotIndex < queueContext->Reader.State.SlotCount; slotIndex++)
+	{
+		if (queueContext->Reader.Stopping)
+		{
+			// An earlier slot failed; retire the rest without sending them.
+			PacketReader_Complete(&queueContext->Reader.State, slotIndex, STATUS_CANCELLED, 0, 0);
+			continue;
+		}
+
+		queueContext->Reader.SlotSent[slotIndex] = TRUE;
+		WdfSpinLockRelease(queueContext->Reader.Lock);
+
+		status = Xfer_ReaderSend(queueContext, slotIndex);
+
+		WdfSpinLockAcquire(queueContext->Reader.Lock);
+		if (!NT_SUCCESS(status))
+		{
+			queueContext->Reader.SlotSent[slotIndex] = FALSE;
+			PacketReader_Complete(&queueContext->Reader.State, slotIndex, status, 0, 0);
+			if (!queueContext->Reader.Stopping)
+			{
+				queueContext->Reader.Error = status;
+				queueContext->Reader.Stopping = TRUE;
+			}
+		}
+	}
+
+	if (queueContext->Reader.Stopping)
+	{
+		// Slots sent before the failure are cancelled; the pump retires them as they return.
+		Xfer_ReaderCancelSent(queueContext);
+	}
+
+	queueContext->Reader.Busy = 0;
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	// Pick up completions recorded while the slots were being sent.
+	Xfer_ReaderPump(queueContext);
+}
+
+VOID Xfer_StopReader(
+    __in PQUEUE_CONTEXT queueContext)
+{
+	if (!queueContext->Reader.Lock)
+		return;
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+	queueContext->Reader.Stopping = TRUE;
+	Xfer_ReaderCancelSent(queueContext);
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	KeWaitForSingleObject(&queueContext->Reader.IdleEvent, Executive, KernelMode, FALSE, NULL);
+
+	// Cancels the waiting requests.
+	WdfIoQueuePurgeSynchronously(queueContext->Reader.DrainQueue);
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+	PacketRing_Reset(&queueContext->Reader.Ring);
+	queueContext->Reader.Running	= FALSE;
+	queueContext->Reader.Stopping	= FALSE;
+	queueContext->Reader.Error		= STATUS_SUCCESS;
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	WdfIoQueueStart(queueContext->Reader.DrainQueue);
+}
+
+VOID Xfer_ReadPackets(
+    __in WDFQUEUE Queue,
+    __in WDFREQUEST Request)
+{
+	NTSTATUS status;
+	PQUEUE_CONTEXT queueContext;
+	ULONG length = 0;
+	BOOLEAN start = FALSE;
+
+	if ((queueContext = GetQueueContext(Queue)) == NULL)
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		USBERRN("Invalid queue context");
+		goto Done;
+	}
+
+	if (!queueContext->Reader.Lock)
+	{
+		status = STATUS_INVALID_DEVICE_STATE;
+		USBERRN("PipeID=%02Xh CONTINUOUS_READER is not enabled.", queueContext->Info.EndpointAddress);
+		goto Done;
+	}
+
+	WdfSpinLockAcquire(queueContext->Reader.Lock);
+
+	if (queueContext->Reader.Ring.Packets ||
+	        (!queueContext->Reader.Running && !NT_SUCCESS(queueContext->Reader.Error)))
+	{
+		status = Xfer_ReaderFill(queueContext, Request, &length);
+		WdfSpinLockRelease(queueContext->Reader.Lock);
+		goto Done;
+	}
+
+	// Nothing to return yet; wait in the drain queue.
+	status = WdfRequestForwardToIoQueue(Request, queueContext->Reader.DrainQueue);
+	if (NT_SUCCESS(status))
+	{
+		start = (!queueContext->Reader.Running && !queueContext->Reader.Outstanding) ? TRUE : FALSE;
+		if (start)
+			Xfer_ReaderClaim(queueContext);
+	}
+	else
+	{
+		USBERRN("WdfRequestForwardToIoQueue failed. Status=%08Xh", status);
+	}
+
+	WdfSpinLockRelease(queueContext->Reader.Lock);
+
+	if (!NT_SUCCESS(status))
+		goto Done;
+
+	if (start)
+		Xfer_ReaderStart(queueContext);
+
+	return;
+
+Done:
+	Xfer_CompleteRequest(Request, status, length);
+}